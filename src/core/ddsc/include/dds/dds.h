@@ -185,6 +185,8 @@ typedef struct dds_sample_info
   uint32_t generation_rank;
   /** difference in generations between the sample and most recent sample of the same instance when read/take was called */
   uint32_t absolute_generation_rank;
+  /** time the sample was received from the network (the kernel receive timestamp if Internal/KernelReceiveTimestamps is enabled), 0 if not available, e.g., for samples from local writers and invalid samples */
+  dds_time_t reception_timestamp;
 }
 dds_sample_info_t;
 
@@ -1258,6 +1260,7 @@ enum dds_topic_filter_mode {
   DDS_TOPIC_FILTER_SAMPLE_ARG,
   DDS_TOPIC_FILTER_SAMPLEINFO_ARG,
   DDS_TOPIC_FILTER_SAMPLE_SAMPLEINFO_ARG,
+  DDS_TOPIC_FILTER_EXPRESSION /**< set by dds_set_topic_filter_expression, arg is the compiled expression */
 };
 
 /** Union of all filter function types; no guarantee of backwards compatibility */
@@ -1341,6 +1344,42 @@ dds_set_topic_filter_extended(
   dds_entity_t topic,
   const struct dds_topic_filter *filter);
 
+/**
+ * @brief Sets a filter expression on a topic.
+ *
+ * The expression uses the subset of the SQL-like syntax of DDS content-filtered
+ * topics that applies to fields of primitive, enumerated and string types: the
+ * comparison operators (=, <>, !=, <, <=, >, >=), BETWEEN, LIKE (with % and _ as
+ * wildcards), AND, OR, NOT and parentheses.  Fields of nested structs are referenced
+ * as "a.b", parameters as %0, %1, etc.
+ *
+ * The expression is compiled once and evaluated directly on the serialized
+ * representation of the samples, without deserializing them, both on data written
+ * by writers using this topic and on data received by readers using this topic.
+ *
+ * The same restrictions on concurrent use apply as for dds_set_topic_filter_extended.
+ *
+ * @param[in]  topic       The topic on which the filter is set.
+ * @param[in]  expression  The filter expression, or NULL to remove the filter.
+ * @param[in]  nparams     The number of parameters.
+ * @param[in]  params      The parameter values, each a literal as it would appear
+ *                         in the expression (string parameters may omit the quotes)
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK  Filter set successfully
+ * @retval DDS_RETCODE_BAD_PARAMETER  The topic handle is invalid, or the expression
+ *             is invalid for the type of the topic
+ * @retval DDS_RETCODE_UNSUPPORTED  The type of the topic does not support filter
+ *             expressions, or the expression references a field that can't be used
+ */
+DDS_EXPORT dds_return_t
+dds_set_topic_filter_expression(
+  dds_entity_t topic,
+  const char *expression,
+  uint32_t nparams,
+  const char * const *params);
+
 /**
  * @brief Gets the filter for a topic. To be replaced by proper filtering on readers,
  * no guarantee that this will be maintained for backwards compatibility.
@@ -1986,6 +2025,67 @@ dds_dispose_ih_ts(
   dds_instance_handle_t handle,
   dds_time_t timestamp);
 
+/**
+ * @brief Loan a sample from a writer
+ *
+ * Loaned samples live in the shared memory segment of the writer, so that
+ * readers in other processes on the same host can access them without the
+ * sample being copied.  This requires shared memory delivery to be enabled
+ * in the configuration and the type to have a fixed-size representation.
+ *
+ * Writing the loaned sample (using any of the write, dispose or unregister
+ * operations) returns the loan, regardless of the result. A sample that
+ * isn't written can be returned using dds_return_loan on the writer.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[out] sample Pointer to the loaned sample.
+ *
+ * @returns dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The operation was successful.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_UNSUPPORTED
+ *             The writer doesn't use shared memory.
+ * @retval DDS_RETCODE_OUT_OF_RESOURCES
+ *             All samples in the shared memory segment are in use.
+ */
+DDS_EXPORT dds_return_t
+dds_loan_sample(dds_entity_t writer, void **sample);
+
+/**
+ * @brief Request a loan of a sample from a writer
+ *
+ * For types with a fixed-size representation that can be serialized by
+ * copying the sample, the writer can hand out samples that are stored in
+ * pre-allocated serialized form.  Writing such a sample (using any of the
+ * write, dispose or unregister operations) avoids allocating and serializing
+ * the data and returns the loan, regardless of the result.  A sample that
+ * isn't written can be returned using dds_return_loan on the writer.
+ *
+ * The contents of the loaned sample are undefined, the application must
+ * initialize all fields.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[out] sample Pointer to the loaned sample.
+ *
+ * @returns dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The operation was successful.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_UNSUPPORTED
+ *             The writer's type can't be serialized by copying the sample.
+ */
+DDS_EXPORT dds_return_t
+dds_request_loan(dds_entity_t writer, void **sample);
+
 /**
  * @brief Write the value of a data instance
  *
@@ -2619,6 +2719,10 @@ dds_read(
  *
  * After dds_read_wl function is being called and the data has been handled, dds_return_loan function must be called to possibly free memory.
  *
+ * Loaned samples are read-only: they may point into shared memory, or, with
+ * Internal/ShareLoanedSamples enabled, to a single deserialized copy of the data
+ * shared by all readers, so modifying one changes what other readers see.
+ *
  * @param[in]  reader_or_condition Reader, readcondition or querycondition entity
  * @param[out] buf An array of pointers to samples into which data is read (pointers can be NULL)
  * @param[out] si Pointer to an array of \ref dds_sample_info_t returned for each data value
@@ -2911,6 +3015,10 @@ dds_take(
  *
  * After dds_take_wl function is being called and the data has been handled, dds_return_loan function must be called to possibly free memory
  *
+ * Loaned samples are read-only: they may point into shared memory, or, with
+ * Internal/ShareLoanedSamples enabled, to a single deserialized copy of the data
+ * shared by all readers, so modifying one changes what other readers see.
+ *
  * @param[in]  reader_or_condition Reader, readcondition or querycondition entity.
  * @param[out] buf An array of pointers to samples into which data is read (pointers can be NULL).
  * @param[out] si Pointer to an array of \ref dds_sample_info_t returned for each data value.
@@ -3384,7 +3492,13 @@ dds_read_next_wl(
  * the memory is released so that the buffer can be reused during a successive read/take operation.
  * When a condition is provided, the reader to which the condition belongs is looked up.
  *
- * @param[in] reader_or_condition Reader or condition that belongs to a reader.
+ * Samples read with a loan may point directly into shared memory or to a deserialized
+ * copy shared by all readers of the data (Internal/ShareLoanedSamples); these are
+ * read-only and remain valid until the loan is returned.  When a writer is provided, the
+ * samples must have been obtained using dds_loan_sample or dds_request_loan and not been
+ * written.
+ *
+ * @param[in] reader_or_condition Reader, writer or condition that belongs to a reader.
  * @param[in] buf An array of (pointers to) samples.
  * @param[in] bufsz The number of (pointers to) samples stored in buf.
  *
@@ -64,6 +64,9 @@ DDS_EXPORT inline dds_return_t dds_rhc_associate (struct dds_rhc *rhc, struct dd
 DDS_EXPORT inline bool dds_rhc_store (struct dds_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk) {
   return rhc->common.ops->rhc_ops.store (&rhc->common.rhc, wrinfo, sample, tk);
 }
+DDS_EXPORT inline uint32_t dds_rhc_store_batch (struct dds_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, uint32_t n, struct ddsi_serdata * const * __restrict samples, struct ddsi_tkmap_instance * const * __restrict tks) {
+  return rhc->common.ops->rhc_ops.store_batch (&rhc->common.rhc, wrinfo, n, samples, tks);
+}
 DDS_EXPORT inline void dds_rhc_unregister_wr (struct dds_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo) {
   rhc->common.ops->rhc_ops.unregister_wr (&rhc->common.rhc, wrinfo);
 }
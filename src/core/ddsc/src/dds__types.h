@@ -279,7 +279,12 @@ typedef struct dds_reader {
   bool m_loan_out;
   void *m_loan;
   uint32_t m_loan_size;
+  void *m_loan_head; /* buf[0] as returned with the outstanding loan, differs from m_loan if it points to a referenced sample */
+  struct ddsi_serdata **m_loan_refs; /* [m_loan_nrefs] serdatas referenced by the outstanding loan, may contain null pointers */
+  uint32_t m_loan_nrefs;
   unsigned m_wrapped_sertopic : 1; /* set iff reader's topic is a wrapped ddsi_sertopic for backwards compatibility */
+  unsigned m_shm_loans : 1; /* set iff samples may be loaned directly from shared memory */
+  unsigned m_shared_samples : 1; /* set iff samples may be loaned from the deserialized copy cached in the serdata */
 
   /* Status metrics */
 
@@ -298,6 +303,8 @@ typedef struct dds_writer {
   struct writer *m_wr;
   struct whc *m_whc; /* FIXME: ownership still with underlying DDSI writer (cos of DDSI built-in writers )*/
   bool whc_batch; /* FIXME: channels + latency budget */
+  struct serdatapool *m_loan_pool; /* serdatas for dds_request_loan, created on first use */
+  struct ddsrt_hh *m_loans; /* samples loaned by dds_request_loan, not yet written or returned; created with m_loan_pool */
 
   /* Status metrics */
 
@@ -13,6 +13,7 @@
 #define DDS__WHC_H
 
 #include "dds/ddsi/q_whc.h"
+#include "dds/ddsi/q_protocol.h"
 
 #if defined (__cplusplus)
 extern "C" {
@@ -22,6 +23,11 @@ struct ddsi_domaingv;
 struct whc_writer_info;
 struct dds_writer;
 
+/* Estimate of the overhead of each fragment of a sample on the wire, for accounting
+   the unacknowledged bytes: INFO_TS, DATAFRAG and inline QoS with key hash, status
+   info and sentinel */
+#define WHC_SAMPLE_OVERHEAD (sizeof (InfoTimestamp_t) + sizeof (DataFrag_t) + 3 * sizeof (nn_parameter_t) + sizeof (ddsi_keyhash_t) + sizeof (uint32_t))
+
 struct whc *whc_new (struct ddsi_domaingv *gv, const struct whc_writer_info *wrinfo);
 struct whc_writer_info *whc_make_wrinfo (struct dds_writer *wr, const dds_qos_t *qos);
 void whc_free_wrinfo (struct whc_writer_info *);
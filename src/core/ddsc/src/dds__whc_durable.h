@@ -0,0 +1,36 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDS__WHC_DURABLE_H
+#define DDS__WHC_DURABLE_H
+
+#include "dds/ddsi/q_whc.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct dds_writer;
+
+/* WHC for TRANSIENT and PERSISTENT writers: the history (the last tldepth samples
+   of each instance, all samples if tldepth = 0) is kept in an append-only log of
+   memory-mapped files in the configured store directory, and "inner", a volatile
+   WHC, holds the samples that may still need to be retransmitted.  The durable WHC
+   takes ownership of "inner".  Returns NULL if the store can't be used, in which
+   case the caller remains responsible for "inner". */
+struct whc *whc_durable_new (struct ddsi_domaingv *gv, const struct dds_writer *wr, uint32_t tldepth, struct whc *inner);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDS__WHC_DURABLE_H */
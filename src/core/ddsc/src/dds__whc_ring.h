@@ -0,0 +1,33 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDS__WHC_RING_H
+#define DDS__WHC_RING_H
+
+#include "dds/ddsi/q_whc.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+
+/* WHC for volatile, KEEP_ALL writers without deadline and lifespan: such a
+   writer only ever needs to find samples by sequence number and drop them in
+   sequence number order once acknowledged, so the samples are stored in a
+   power-of-two sized ring indexed by the sequence number. */
+struct whc *whc_ring_new (struct ddsi_domaingv *gv);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDS__WHC_RING_H */
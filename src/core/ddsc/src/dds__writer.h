@@ -24,6 +24,7 @@ struct status_cb_data;
 
 void dds_writer_status_cb (void *entity, const struct status_cb_data * data);
 DDS_EXPORT dds_return_t dds__writer_wait_for_acks (struct dds_writer *wr, ddsi_guid_t *rdguid, dds_time_t abstimeout);
+dds_return_t dds_writer_return_loan (struct dds_writer *wr, void **buf, int32_t bufsz);
 
 #if defined (__cplusplus)
 }
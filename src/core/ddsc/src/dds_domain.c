@@ -20,6 +20,7 @@
 #include "dds__builtin.h"
 #include "dds__whc_builtintopic.h"
 #include "dds__entity.h"
+#include "dds__statistics.h"
 #include "dds/ddsi/ddsi_iid.h"
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsi/ddsi_serdata.h"
@@ -28,17 +29,39 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_gc.h"
 #include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_statistics.h"
 
 static dds_return_t dds_domain_free (dds_entity *vdomain);
 
+static const struct dds_stat_keyvalue_descriptor dds_domain_statistics_kv[] = {
+  { "serdata_pool_hits", DDS_STAT_KIND_UINT64 },
+  { "serdata_pool_misses", DDS_STAT_KIND_UINT64 }
+};
+
+static const struct dds_stat_descriptor dds_domain_statistics_desc = {
+  .count = sizeof (dds_domain_statistics_kv) / sizeof (dds_domain_statistics_kv[0]),
+  .kv = dds_domain_statistics_kv
+};
+
+static struct dds_statistics *dds_domain_create_statistics (const struct dds_entity *entity)
+{
+  return dds_alloc_statistics (entity, &dds_domain_statistics_desc);
+}
+
+static void dds_domain_refresh_statistics (const struct dds_entity *entity, struct dds_statistics *stat)
+{
+  const struct dds_domain *dom = (const struct dds_domain *) entity;
+  ddsi_get_serdatapool_stats (dom->gv.serpool, &stat->kv[0].u.u64, &stat->kv[1].u.u64);
+}
+
 const struct dds_entity_deriver dds_entity_deriver_domain = {
   .interrupt = dds_entity_deriver_dummy_interrupt,
   .close = dds_entity_deriver_dummy_close,
   .delete = dds_domain_free,
   .set_qos = dds_entity_deriver_dummy_set_qos,
   .validate_status = dds_entity_deriver_dummy_validate_status,
-  .create_statistics = dds_entity_deriver_dummy_create_statistics,
-  .refresh_statistics = dds_entity_deriver_dummy_refresh_statistics
+  .create_statistics = dds_domain_create_statistics,
+  .refresh_statistics = dds_domain_refresh_statistics
 };
 
 static int dds_domain_compare (const void *va, const void *vb)
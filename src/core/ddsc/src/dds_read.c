@@ -11,8 +11,10 @@
  */
 #include <assert.h>
 #include <string.h>
+#include "dds/ddsrt/heap.h"
 #include "dds__entity.h"
 #include "dds__reader.h"
+#include "dds__writer.h"
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsc/dds_rhc.h"
 #include "dds/ddsi/q_thread.h"
@@ -21,6 +23,61 @@
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_sertype.h"
 #include "dds/ddsi/ddsi_sertopic.h" // for extern ddsi_sertopic_serdata_ops_wrap
+#include "dds/ddsi/ddsi_shm.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+
+static void dds_loan_refs_resize (struct dds_reader *rd)
+{
+  if (rd->m_loan_refs)
+    rd->m_loan_refs = ddsrt_realloc (rd->m_loan_refs, rd->m_loan_size * sizeof (*rd->m_loan_refs));
+}
+
+static void *dds_read_ref_sample (const struct dds_reader *rd, struct ddsi_serdata *d, const dds_sample_info_t *si)
+{
+  void *sample;
+  if ((sample = ddsi_serdata_shm_sample (d)) != NULL)
+    return sample;
+  else if (rd->m_shared_samples && si->valid_data)
+    return ddsi_serdata_default_shared_sample (d);
+  else
+    return NULL;
+}
+
+static int32_t dds_read_ref_loan (struct dds_reader *rd, bool take, bool lock, void **buf, dds_sample_info_t *si, uint32_t maxs, uint32_t mask, dds_instance_handle_t hand)
+{
+  /* Samples that arrived via shared memory or that have a shared deserialized copy are
+     handed out by reference, keeping the serdata (and therefore the slot or the copy)
+     alive until the loan is returned; all others are copied into the reader's loan as
+     usual */
+  const struct ddsi_sertype *st = rd->m_topic->m_stype;
+  struct ddsi_serdata **refs;
+  int32_t ret;
+
+  if (rd->m_loan_refs == NULL)
+    rd->m_loan_refs = ddsrt_malloc (rd->m_loan_size * sizeof (*rd->m_loan_refs));
+  refs = rd->m_loan_refs;
+  if (take)
+    ret = dds_rhc_takecdr (rd->m_rhc, lock, refs, si, maxs, mask & DDS_ANY_SAMPLE_STATE, mask & DDS_ANY_VIEW_STATE, mask & DDS_ANY_INSTANCE_STATE, hand);
+  else
+    ret = dds_rhc_readcdr (rd->m_rhc, lock, refs, si, maxs, mask & DDS_ANY_SAMPLE_STATE, mask & DDS_ANY_VIEW_STATE, mask & DDS_ANY_INSTANCE_STATE, hand);
+  for (int32_t i = 0; i < ret; i++)
+  {
+    void *sample;
+    if ((sample = dds_read_ref_sample (rd, refs[i], &si[i])) != NULL)
+      buf[i] = sample;
+    else
+    {
+      if (si[i].valid_data)
+        (void) ddsi_serdata_to_sample (refs[i], buf[i], NULL, NULL);
+      else
+        (void) ddsi_serdata_untyped_to_sample (st, refs[i], buf[i], NULL, NULL);
+      ddsi_serdata_unref (refs[i]);
+      refs[i] = NULL;
+    }
+  }
+  rd->m_loan_nrefs = (ret > 0) ? (uint32_t) ret : 0;
+  return ret;
+}
 
 /*
   dds_read_impl: Core read/take function. Usually maxs is size of buf and si
@@ -37,6 +94,7 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
   struct dds_reader *rd;
   struct dds_readcond *cond;
   unsigned nodata_cleanups = 0;
+  bool ref_loan = false;
 #define NC_CLEAR_LOAN_OUT 1u
 #define NC_FREE_BUF 2u
 #define NC_RESET_BUF 4u
@@ -85,16 +143,21 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
         {
           ddsi_sertype_realloc_samples (buf, rd->m_topic->m_stype, rd->m_loan, rd->m_loan_size, maxs);
           rd->m_loan_size = maxs;
+          dds_loan_refs_resize (rd);
         }
       }
       else
       {
         ddsi_sertype_realloc_samples (buf, rd->m_topic->m_stype, NULL, 0, maxs);
         rd->m_loan_size = maxs;
+        dds_loan_refs_resize (rd);
       }
       rd->m_loan = buf[0];
+      rd->m_loan_head = buf[0];
       rd->m_loan_out = true;
       nodata_cleanups = NC_RESET_BUF | NC_CLEAR_LOAN_OUT;
+      /* read conditions aren't supported by the serdata-based read/take */
+      ref_loan = ((rd->m_shm_loans || rd->m_shared_samples) && cond == NULL);
     }
     ddsrt_mutex_unlock (&rd->m_entity.m_mutex);
   }
@@ -107,7 +170,12 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
   assert (dds_entity_kind (rd->m_entity.m_parent) == DDS_KIND_SUBSCRIBER);
   dds_entity_status_reset (rd->m_entity.m_parent, DDS_DATA_ON_READERS_STATUS);
 
-  if (take)
+  if (ref_loan)
+  {
+    ret = dds_read_ref_loan (rd, take, lock, buf, si, maxs, mask, hand);
+    rd->m_loan_head = buf[0];
+  }
+  else if (take)
     ret = dds_rhc_take (rd->m_rhc, lock, buf, si, maxs, mask, hand, cond);
   else
     ret = dds_rhc_read (rd->m_rhc, lock, buf, si, maxs, mask, hand, cond);
@@ -490,6 +558,11 @@ dds_return_t dds_return_loan (dds_entity_t reader_or_condition, void **buf, int3
     return ret;
   } else if (dds_entity_kind (entity) == DDS_KIND_READER) {
     rd = (dds_reader *) entity;
+  } else if (dds_entity_kind (entity) == DDS_KIND_WRITER) {
+    /* samples loaned by dds_loan_sample that weren't written */
+    ret = (bufsz <= 0) ? DDS_RETCODE_OK : dds_writer_return_loan ((dds_writer *) entity, buf, bufsz);
+    dds_entity_unpin (entity);
+    return ret;
   } else if (dds_entity_kind (entity) != DDS_KIND_COND_READ && dds_entity_kind (entity) != DDS_KIND_COND_QUERY) {
     dds_entity_unpin (entity);
     return DDS_RETCODE_ILLEGAL_OPERATION;
@@ -515,7 +588,7 @@ dds_return_t dds_return_loan (dds_entity_t reader_or_condition, void **buf, int3
      the observer_lock), so holding it for a bit longer in return for simpler
      code is a fair trade-off. */
   ddsrt_mutex_lock (&rd->m_entity.m_mutex);
-  if (buf[0] != rd->m_loan)
+  if (buf[0] != rd->m_loan && buf[0] != rd->m_loan_head)
   {
     /* Not so much a loan as a buffer allocated by the middleware on behalf of the
        application.  So it really is no more than a sophisticated variant of "free". */
@@ -533,8 +606,25 @@ dds_return_t dds_return_loan (dds_entity_t reader_or_condition, void **buf, int3
   {
     /* Free only the memory referenced from the samples, not the samples themselves.
        Zero them to guarantee the absence of dangling pointers that might cause
-       trouble on a following operation.  FIXME: there's got to be a better way */
-    ddsi_sertype_free_samples (st, buf, (size_t) bufsz, DDS_FREE_CONTENTS);
+       trouble on a following operation.  FIXME: there's got to be a better way
+
+       Samples loaned by reference are owned by the serdatas, some of the pointers in
+       buf refer to those: only drop the references */
+    if (rd->m_loan_nrefs > 0)
+    {
+      for (uint32_t i = 0; i < rd->m_loan_nrefs; i++)
+      {
+        if (rd->m_loan_refs[i])
+          ddsi_serdata_unref (rd->m_loan_refs[i]);
+        else if (i < (uint32_t) bufsz)
+          ddsi_sertype_free_sample (st, buf[i], DDS_FREE_CONTENTS);
+      }
+      rd->m_loan_nrefs = 0;
+    }
+    else
+    {
+      ddsi_sertype_free_samples (st, buf, (size_t) bufsz, DDS_FREE_CONTENTS);
+    }
     ddsi_sertype_zero_samples (st, rd->m_loan, rd->m_loan_size);
     rd->m_loan_out = false;
     buf[0] = NULL;
@@ -15,6 +15,7 @@
 #include "dds/version.h"
 #include "dds/ddsrt/static_assert.h"
 #include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
 #include "dds__participant.h"
 #include "dds__subscriber.h"
 #include "dds__reader.h"
@@ -31,9 +32,11 @@
 #include "dds__builtin.h"
 #include "dds__statistics.h"
 #include "dds/ddsi/ddsi_sertype.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/ddsi_security_omg.h"
 #include "dds/ddsi/ddsi_statistics.h"
+#include "dds/ddsi/ddsi_cdrfilter.h"
 
 DECL_ENTITY_LOCK_UNLOCK (extern inline, dds_reader)
 
@@ -76,6 +79,13 @@ static dds_return_t dds_reader_delete (dds_entity *e)
     ddsi_sertype_free_samples (rd->m_topic->m_stype, ptrs, rd->m_loan_size, DDS_FREE_ALL);
     ddsrt_free (ptrs);
   }
+  if (rd->m_loan_refs)
+  {
+    for (uint32_t i = 0; i < rd->m_loan_nrefs; i++)
+      if (rd->m_loan_refs[i])
+        ddsi_serdata_unref (rd->m_loan_refs[i]);
+    ddsrt_free (rd->m_loan_refs);
+  }
 
   thread_state_awake (lookup_thread_state (), &e->m_domain->gv);
   dds_rhc_free (rd->m_rhc);
@@ -410,6 +420,44 @@ const struct dds_entity_deriver dds_entity_deriver_reader = {
   .refresh_statistics = dds_reader_refresh_statistics
 };
 
+/* A compiled filter expression on the topic is advertised in discovery so that remote
+   writers can apply it before sending.  The topic's filter may change at any time, so a
+   private copy is made while holding the topic lock. */
+static bool dds_reader_get_content_filter_property (dds_topic *tp, nn_content_filter_property_t *cfp)
+{
+  bool present = false;
+  ddsrt_mutex_lock (&tp->m_entity.m_mutex);
+  if (tp->m_filter.mode == DDS_TOPIC_FILTER_EXPRESSION)
+  {
+    const char *expression;
+    uint32_t nparams;
+    char * const *params;
+    ddsi_cdrfilter_get_expression (tp->m_filter.arg, &expression, &nparams, &params);
+    cfp->content_filtered_topic_name = ddsrt_strdup (tp->m_name);
+    cfp->related_topic_name = ddsrt_strdup (tp->m_name);
+    cfp->filter_class_name = ddsrt_strdup ("DDSSQL");
+    cfp->filter_expression = ddsrt_strdup (expression);
+    cfp->expression_parameters.n = nparams;
+    cfp->expression_parameters.strs = nparams ? ddsrt_malloc (nparams * sizeof (*cfp->expression_parameters.strs)) : NULL;
+    for (uint32_t i = 0; i < nparams; i++)
+      cfp->expression_parameters.strs[i] = ddsrt_strdup (params[i]);
+    present = true;
+  }
+  ddsrt_mutex_unlock (&tp->m_entity.m_mutex);
+  return present;
+}
+
+static void dds_reader_fini_content_filter_property (nn_content_filter_property_t *cfp)
+{
+  ddsrt_free (cfp->content_filtered_topic_name);
+  ddsrt_free (cfp->related_topic_name);
+  ddsrt_free (cfp->filter_class_name);
+  ddsrt_free (cfp->filter_expression);
+  for (uint32_t i = 0; i < cfp->expression_parameters.n; i++)
+    ddsrt_free (cfp->expression_parameters.strs[i]);
+  ddsrt_free (cfp->expression_parameters.strs);
+}
+
 static dds_entity_t dds_create_reader_int (dds_entity_t participant_or_subscriber, dds_entity_t topic, const dds_qos_t *qos, const dds_listener_t *listener, struct dds_rhc *rhc)
 {
   dds_qos_t *rqos;
@@ -547,8 +595,14 @@ static dds_entity_t dds_create_reader_int (dds_entity_t participant_or_subscribe
      it; and then invoke those listeners that are in the pending set */
   dds_entity_init_complete (&rd->m_entity);
 
-  rc = new_reader (&rd->m_rd, &rd->m_entity.m_guid, NULL, pp, tp->m_name, tp->m_stype, rqos, &rd->m_rhc->common.rhc, dds_reader_status_cb, rd);
+  nn_content_filter_property_t cfp;
+  const bool has_cfp = dds_reader_get_content_filter_property (tp, &cfp);
+  rc = new_reader (&rd->m_rd, &rd->m_entity.m_guid, NULL, pp, tp->m_name, tp->m_stype, rqos, &rd->m_rhc->common.rhc, dds_reader_status_cb, rd, has_cfp ? &cfp : NULL);
   assert (rc == DDS_RETCODE_OK); /* FIXME: can be out-of-resources at the very least */
+  if (has_cfp)
+    dds_reader_fini_content_filter_property (&cfp);
+  rd->m_shm_loans = rd->m_rd->shm_capable;
+  rd->m_shared_samples = rd->m_entity.m_domain->gv.config.share_loaned_samples && tp->m_stype->ops == &ddsi_sertype_ops_default;
   thread_state_asleep (lookup_thread_state ());
 
   rd->m_entity.m_iid = get_entity_instance_id (&rd->m_entity.m_domain->gv, &rd->m_entity.m_guid);
@@ -13,13 +13,6 @@
 #include <string.h>
 #include <limits.h>
 
-#if HAVE_VALGRIND && ! defined (NDEBUG)
-#include <memcheck.h>
-#define USE_VALGRIND 1
-#else
-#define USE_VALGRIND 0
-#endif
-
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
 
@@ -40,6 +33,7 @@
 #include "dds/ddsi/q_entity.h" /* proxy_writer_info */
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_cdrfilter.h"
 #ifdef DDS_HAS_LIFESPAN
 #include "dds/ddsi/ddsi_lifespan.h"
 #endif
@@ -100,11 +94,13 @@
    QOS SUPPORT
    ===========
 
-   History is implemented as a (circular) linked list, but the invalid samples
-   model implemented here allows this to trivially be changed to an array of
-   samples, and this is probably profitable for shallow histories.  Currently
-   the instance has a single sample embedded in particular to optimise the
-   KEEP_LAST with depth=1 case.
+   History is implemented as a per-instance ring buffer of samples, ordered
+   from old to new, that grows on demand up to the history depth (or without
+   bound for KEEP_ALL) and is never shrunk, so that steady-state operation
+   requires no allocations.  The instance has a single sample embedded that
+   serves as the ring in particular to optimise the KEEP_LAST with depth=1
+   case.  Taking samples that are not the oldest ones or lifespan expiry may
+   leave holes in the ring; these are squeezed out when the ring fills up.
 
    BY_SOURCE ordering is implemented differently from OpenSplice and does not
    perform back-filling of the history.  The arguments against that can be
@@ -159,6 +155,7 @@
    the tkmap data. */
 
 #define MAX_ATTACHED_QUERYCONDS (CHAR_BIT * sizeof (dds_querycond_mask_t))
+#define MAX_RHC_LOCK_STRIPES 1024u
 
 #define INCLUDE_TRACE 1
 #if INCLUDE_TRACE
@@ -240,8 +237,7 @@ void lwregs_dump (struct lwregs *rt)
  *************************/
 
 struct rhc_sample {
-  struct ddsi_serdata *sample; /* serialised data (either just_key or real data) */
-  struct rhc_sample *next;     /* next sample in time ordering, or oldest sample if most recent */
+  struct ddsi_serdata *sample; /* serialised data (either just_key or real data), null if a hole in the ring */
   uint64_t wr_iid;             /* unique id for writer of this sample (perhaps better in serdata) */
   dds_querycond_mask_t conds;  /* matching query conditions */
   bool isread;                 /* READ or NOT_READ sample state */
@@ -256,13 +252,15 @@ struct rhc_sample {
 struct rhc_instance {
   uint64_t iid;                /* unique instance id, key of table, also serves as instance handle */
   uint64_t wr_iid;             /* unique of id of writer of latest sample or 0; if wrcount = 0 it is the wr_iid that caused  */
-  struct rhc_sample *latest;   /* latest received sample; circular list old->new; null if no sample */
+  struct rhc_sample *samples;  /* ring of samples old->new; points to a_sample if ring_size = 1 */
+  uint32_t ring_size;          /* number of slots in samples */
+  uint32_t ring_head;          /* index of oldest sample */
+  uint32_t ring_n;             /* number of slots in use from ring_head on, including holes, but the oldest and latest never are */
   uint32_t nvsamples;          /* number of "valid" samples in instance */
   uint32_t nvread;             /* number of READ "valid" samples in instance (0 <= nvread <= nvsamples) */
   dds_querycond_mask_t conds;  /* matching query conditions */
   uint32_t wrcount;            /* number of live writers */
   unsigned isnew : 1;          /* NEW or NOT_NEW view state */
-  unsigned a_sample_free : 1;  /* whether or not a_sample is in use */
   unsigned isdisposed : 1;     /* DISPOSED or NOT_DISPOSED (if not disposed, wrcount determines ALIVE/NOT_ALIVE_NO_WRITERS) */
   unsigned autodispose : 1;    /* wrcount > 0 => at least one registered writer has had auto-dispose set on some update */
   unsigned wr_iid_islive : 1;  /* whether wr_iid is of a live writer */
@@ -282,12 +280,46 @@ struct rhc_instance {
   struct rhc_sample a_sample;  /* pre-allocated storage for 1 sample */
 };
 
+static struct rhc_sample *inst_sample (const struct rhc_instance *inst, uint32_t i)
+{
+  /* i-th slot of the ring, counting from the oldest sample */
+  uint32_t k = inst->ring_head + i;
+  if (k >= inst->ring_size)
+    k -= inst->ring_size;
+  return &inst->samples[k];
+}
+
+static struct rhc_sample *inst_latest_sample (const struct rhc_instance *inst)
+{
+  return (inst->ring_n == 0) ? NULL : inst_sample (inst, inst->ring_n - 1);
+}
+
 typedef enum rhc_store_result {
   RHC_STORED,
   RHC_FILTERED,
   RHC_REJECTED
 } rhc_store_result_t;
 
+/* Lock stripes (RhcLockStripes > 0): storing a sample in an alive instance that
+   needs nothing but the instance itself, and reading/taking the samples of a
+   single instance, only lock the stripe the instance maps to.  The changes to
+   the global counters are accumulated in the stripe (modulo 2**32) and folded
+   into the totals whenever the RHC as a whole gets locked, which means locking
+   "lock" and all stripes in increasing order.  The hash table and the reader-
+   wide administration are therefore stable while holding any stripe lock.  The
+   list of non-empty instances is shared and protected by "nonempty_lock", which
+   nests inside the stripe locks. */
+struct rhc_stripe {
+  ddsrt_mutex_t lock;
+  uint32_t n_nonempty_instances;
+  uint32_t n_not_alive_disposed;
+  uint32_t n_new;
+  uint32_t n_vsamples;
+  uint32_t n_vread;
+  uint32_t n_invsamples;
+  uint32_t n_invread;
+};
+
 struct dds_rhc_default {
   struct dds_rhc common;
   struct ddsrt_hh *instances;
@@ -322,6 +354,10 @@ struct dds_rhc_default {
   uint32_t history_depth;            /* depth, 1 for KEEP_LAST_1, 2**32-1 for KEEP_ALL */
 
   ddsrt_mutex_t lock;
+  uint32_t nstripes;                 /* number of lock stripes, 0 or a power of 2 */
+  struct rhc_stripe *stripes;        /* lock stripes, NULL if nstripes = 0 */
+  ddsrt_mutex_t nonempty_lock;       /* protects nonempty_instances if nstripes > 0 */
+  bool lifespan_used;                /* set once a sample with a finite lifespan is stored */
   dds_readcond * conds;              /* List of associated read conditions */
   uint32_t nconds;                   /* Number of associated read conditions */
   uint32_t nqconds;                  /* Number of associated query conditions */
@@ -410,7 +446,8 @@ static bool untyped_to_clean_invsample (const struct ddsi_sertype *type, const s
 }
 
 static uint32_t qmask_of_inst (const struct rhc_instance *inst);
-static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s);
+static void free_sample (struct dds_rhc_default *rhc, struct rhc_sample *s);
+static void trim_sample_ring (struct rhc_instance *inst);
 static void get_trigger_info_cmn (struct trigger_info_cmn *info, struct rhc_instance *inst);
 static void get_trigger_info_pre (struct trigger_info_pre *info, struct rhc_instance *inst);
 static void init_trigger_info_qcond (struct trigger_info_qcond *qc);
@@ -434,6 +471,38 @@ static int instance_iid_eq (const void *va, const void *vb)
   return (a->iid == b->iid);
 }
 
+static struct rhc_stripe *rhc_stripe_of (const struct dds_rhc_default *rhc, uint64_t iid)
+{
+  assert (rhc->nstripes > 0);
+  return &rhc->stripes[(uint32_t) (iid ^ (iid >> 32)) & (rhc->nstripes - 1)];
+}
+
+static void rhc_lock (struct dds_rhc_default *rhc)
+{
+  ddsrt_mutex_lock (&rhc->lock);
+  for (uint32_t i = 0; i < rhc->nstripes; i++)
+  {
+    struct rhc_stripe * const stripe = &rhc->stripes[i];
+    ddsrt_mutex_lock (&stripe->lock);
+    rhc->n_nonempty_instances += stripe->n_nonempty_instances;
+    rhc->n_not_alive_disposed += stripe->n_not_alive_disposed;
+    rhc->n_new += stripe->n_new;
+    rhc->n_vsamples += stripe->n_vsamples;
+    rhc->n_vread += stripe->n_vread;
+    rhc->n_invsamples += stripe->n_invsamples;
+    rhc->n_invread += stripe->n_invread;
+    stripe->n_nonempty_instances = stripe->n_not_alive_disposed = stripe->n_new = 0;
+    stripe->n_vsamples = stripe->n_vread = stripe->n_invsamples = stripe->n_invread = 0;
+  }
+}
+
+static void rhc_unlock (struct dds_rhc_default *rhc)
+{
+  for (uint32_t i = rhc->nstripes; i > 0; i--)
+    ddsrt_mutex_unlock (&rhc->stripes[i - 1].lock);
+  ddsrt_mutex_unlock (&rhc->lock);
+}
+
 static void add_inst_to_nonempty_list (struct dds_rhc_default *rhc, struct rhc_instance *inst)
 {
   ddsrt_circlist_append (&rhc->nonempty_instances, &inst->nonempty_list);
@@ -479,16 +548,6 @@ static void drop_expired_samples (struct dds_rhc_default *rhc, struct rhc_sample
   get_trigger_info_pre (&pre, inst);
   init_trigger_info_qcond (&trig_qc);
 
-  /* Find prev sample: in case of history depth of 1 this is the sample itself,
-    * (which is inst->latest). In case of larger history depth the most likely sample
-    * to be expired is the oldest, in which case inst->latest is the previous
-    * sample and inst->latest->next points to sample (circular list). We can
-    * assume that 'sample' is in the list, so a check to avoid infinite loop is not
-    * required here. */
-  struct rhc_sample *psample = inst->latest;
-  while (psample->next != sample)
-    psample = psample->next;
-
   rhc->n_vsamples--;
   if (sample->isread)
   {
@@ -496,18 +555,10 @@ static void drop_expired_samples (struct dds_rhc_default *rhc, struct rhc_sample
     rhc->n_vread--;
     trig_qc.dec_sample_read = true;
   }
-  if (--inst->nvsamples > 0)
-  {
-    if (inst->latest == sample)
-      inst->latest = psample;
-    psample->next = sample->next;
-  }
-  else
-  {
-    inst->latest = NULL;
-  }
+  inst->nvsamples--;
   trig_qc.dec_conds_sample = sample->conds;
-  free_sample (rhc, inst, sample);
+  free_sample (rhc, sample);
+  trim_sample_ring (inst);
   get_trigger_info_cmn (&post.c, inst);
   update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst);
   if (inst_is_empty (inst))
@@ -520,10 +571,10 @@ ddsrt_mtime_t dds_rhc_default_sample_expired_cb(void *hc, ddsrt_mtime_t tnow)
   struct dds_rhc_default *rhc = hc;
   struct rhc_sample *sample;
   ddsrt_mtime_t tnext;
-  ddsrt_mutex_lock (&rhc->lock);
+  rhc_lock (rhc);
   while ((tnext = lifespan_next_expired_locked (&rhc->lifespan, tnow, (void **)&sample)).v == 0)
     drop_expired_samples (rhc, sample);
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
   return tnext;
 }
 #endif /* DDS_HAS_LIFESPAN */
@@ -534,7 +585,7 @@ ddsrt_mtime_t dds_rhc_default_deadline_missed_cb(void *hc, ddsrt_mtime_t tnow)
   struct dds_rhc_default *rhc = hc;
   void *vinst;
   ddsrt_mtime_t tnext;
-  ddsrt_mutex_lock (&rhc->lock);
+  rhc_lock (rhc);
   while ((tnext = deadline_next_missed_locked (&rhc->deadline, tnow, &vinst)).v == 0)
   {
     struct rhc_instance *inst = vinst;
@@ -547,13 +598,13 @@ ddsrt_mtime_t dds_rhc_default_deadline_missed_cb(void *hc, ddsrt_mtime_t tnow)
     cb_data.extra = 0;
     cb_data.handle = inst->iid;
     cb_data.add = true;
-    ddsrt_mutex_unlock (&rhc->lock);
+    rhc_unlock (rhc);
     dds_reader_status_cb (&rhc->reader->m_entity, &cb_data);
-    ddsrt_mutex_lock (&rhc->lock);
+    rhc_lock (rhc);
 
     tnow = ddsrt_time_monotonic ();
   }
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
   return tnext;
 }
 #endif /* DDS_HAS_DEADLINE_MISSED */
@@ -566,6 +617,18 @@ struct dds_rhc *dds_rhc_default_new_xchecks (dds_reader *reader, struct ddsi_dom
 
   lwregs_init (&rhc->registrations);
   ddsrt_mutex_init (&rhc->lock);
+  if (gv->config.rhc_lock_stripes > 0)
+  {
+    uint32_t nstripes = 1;
+    while (nstripes < gv->config.rhc_lock_stripes && nstripes < MAX_RHC_LOCK_STRIPES)
+      nstripes *= 2;
+    rhc->nstripes = nstripes;
+    rhc->stripes = ddsrt_malloc (nstripes * sizeof (*rhc->stripes));
+    memset (rhc->stripes, 0, nstripes * sizeof (*rhc->stripes));
+    for (uint32_t i = 0; i < nstripes; i++)
+      ddsrt_mutex_init (&rhc->stripes[i].lock);
+    ddsrt_mutex_init (&rhc->nonempty_lock);
+  }
   rhc->instances = ddsrt_hh_new (1, instance_iid_hash, instance_iid_eq);
   ddsrt_circlist_init (&rhc->nonempty_instances);
   rhc->type = type;
@@ -629,26 +692,71 @@ static bool eval_predicate_invsample (const struct dds_rhc_default *rhc, const s
   return ret;
 }
 
-static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
+static void move_sample (struct dds_rhc_default *rhc, struct rhc_sample *dst, struct rhc_sample *src)
 {
-  if (inst->a_sample_free)
-  {
-    inst->a_sample_free = 0;
-#if USE_VALGRIND
-    VALGRIND_MAKE_MEM_UNDEFINED (&inst->a_sample, sizeof (inst->a_sample));
+  /* the lifespan administration refers to the sample by address */
+#ifdef DDS_HAS_LIFESPAN
+  lifespan_unregister_sample_locked (&rhc->lifespan, &src->lifespan);
+#else
+  DDSRT_UNUSED_ARG (rhc);
 #endif
-    return &inst->a_sample;
-  }
-  else
+  *dst = *src;
+#ifdef DDS_HAS_LIFESPAN
+  lifespan_register_sample_locked (&rhc->lifespan, &dst->lifespan);
+#endif
+}
+
+static struct rhc_sample *alloc_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst)
+{
+  if (inst->ring_n == inst->ring_size)
   {
-    /* This instead of sizeof(rhc_sample) gets us type checking */
-    struct rhc_sample *s;
-    s = ddsrt_malloc (sizeof (*s));
-    return s;
+    /* No free slot at the end, there are two options: squeezing out the holes
+       or moving the samples to a larger ring.  The ring can't grow beyond what
+       the history depth and resource limits allow, at which point there must be
+       holes.  Short of that, it only makes sense to squeeze if it frees up a
+       reasonable number of slots. */
+    const uint32_t nholes = inst->ring_n - inst->nvsamples;
+    uint32_t max_size = rhc->history_depth, i, j;
+    if (rhc->max_samples_per_instance != DDS_LENGTH_UNLIMITED && (uint32_t) rhc->max_samples_per_instance < max_size)
+      max_size = (uint32_t) rhc->max_samples_per_instance;
+    if (inst->ring_size >= max_size || (nholes > 0 && nholes >= inst->ring_size / 4))
+    {
+      assert (inst->nvsamples < inst->ring_n);
+      for (i = j = 0; i < inst->ring_n; i++)
+      {
+        struct rhc_sample * const s = inst_sample (inst, i);
+        if (s->sample == NULL)
+          continue;
+        if (i != j)
+          move_sample (rhc, inst_sample (inst, j), s);
+        j++;
+      }
+      inst->ring_n = j;
+    }
+    else
+    {
+      uint32_t size = (inst->ring_size < 2) ? 4 : 2 * inst->ring_size;
+      if (size > max_size || size < inst->ring_size)
+        size = max_size;
+      struct rhc_sample *samples = ddsrt_malloc (size * sizeof (*samples));
+      for (i = j = 0; i < inst->ring_n; i++)
+      {
+        struct rhc_sample * const s = inst_sample (inst, i);
+        if (s->sample != NULL)
+          move_sample (rhc, &samples[j++], s);
+      }
+      if (inst->samples != &inst->a_sample)
+        ddsrt_free (inst->samples);
+      inst->samples = samples;
+      inst->ring_size = size;
+      inst->ring_head = 0;
+      inst->ring_n = j;
+    }
   }
+  return inst_sample (inst, inst->ring_n++);
 }
 
-static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s)
+static void free_sample (struct dds_rhc_default *rhc, struct rhc_sample *s)
 {
 #ifndef DDS_HAS_LIFESPAN
   DDSRT_UNUSED_ARG (rhc);
@@ -657,18 +765,22 @@ static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
 #ifdef DDS_HAS_LIFESPAN
   lifespan_unregister_sample_locked (&rhc->lifespan, &s->lifespan);
 #endif
-  if (s == &inst->a_sample)
-  {
-    assert (!inst->a_sample_free);
-#if USE_VALGRIND
-    VALGRIND_MAKE_MEM_NOACCESS (&inst->a_sample, sizeof (inst->a_sample));
-#endif
-    inst->a_sample_free = 1;
-  }
-  else
+  s->sample = NULL;
+}
+
+static void trim_sample_ring (struct rhc_instance *inst)
+{
+  /* Drops the holes at either end of the ring after removing samples */
+  while (inst->ring_n > 0 && inst_sample (inst, inst->ring_n - 1)->sample == NULL)
+    inst->ring_n--;
+  while (inst->ring_n > 0 && inst->samples[inst->ring_head].sample == NULL)
   {
-    ddsrt_free (s);
+    if (++inst->ring_head == inst->ring_size)
+      inst->ring_head = 0;
+    inst->ring_n--;
   }
+  if (inst->ring_n == 0)
+    inst->ring_head = 0;
 }
 
 static void inst_clear_invsample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct trigger_info_qcond *trig_qc)
@@ -719,22 +831,26 @@ static void free_empty_instance (struct rhc_instance *inst, struct dds_rhc_defau
   if (inst->deadline_reg)
     deadline_unregister_instance_locked (&rhc->deadline, &inst->deadline);
 #endif
+  if (inst->samples != &inst->a_sample)
+    ddsrt_free (inst->samples);
   ddsrt_free (inst);
 }
 
 static void free_instance_rhc_free (struct rhc_instance *inst, struct dds_rhc_default *rhc)
 {
-  struct rhc_sample *s = inst->latest;
   const bool was_empty = inst_is_empty (inst);
   struct trigger_info_qcond dummy_trig_qc;
 
-  if (s)
+  if (inst->nvsamples > 0)
   {
-    do {
-      struct rhc_sample * const s1 = s->next;
-      free_sample (rhc, inst, s);
-      s = s1;
-    } while (s != inst->latest);
+    for (uint32_t i = 0; i < inst->ring_n; i++)
+    {
+      struct rhc_sample * const s = inst_sample (inst, i);
+      if (s->sample != NULL)
+        free_sample (rhc, s);
+    }
+    inst->ring_n = 0;
+    inst->ring_head = 0;
     rhc->n_vsamples -= inst->nvsamples;
     rhc->n_vread -= inst->nvread;
     inst->nvsamples = 0;
@@ -755,11 +871,11 @@ static uint32_t dds_rhc_default_lock_samples (struct dds_rhc *rhc_common)
 {
   struct dds_rhc_default * const rhc = (struct dds_rhc_default *) rhc_common;
   uint32_t no;
-  ddsrt_mutex_lock (&rhc->lock);
+  rhc_lock (rhc);
   no = rhc->n_vsamples + rhc->n_invsamples;
   if (no == 0)
   {
-    ddsrt_mutex_unlock (&rhc->lock);
+    rhc_unlock (rhc);
   }
   return no;
 }
@@ -788,6 +904,13 @@ static void dds_rhc_default_free (struct ddsi_rhc *rhc_common)
   lwregs_fini (&rhc->registrations);
   if (rhc->qcond_eval_samplebuf != NULL)
     ddsi_sertype_free_sample (rhc->type, rhc->qcond_eval_samplebuf, DDS_FREE_ALL);
+  if (rhc->nstripes > 0)
+  {
+    for (uint32_t i = 0; i < rhc->nstripes; i++)
+      ddsrt_mutex_destroy (&rhc->stripes[i].lock);
+    ddsrt_free (rhc->stripes);
+    ddsrt_mutex_destroy (&rhc->nonempty_lock);
+  }
   ddsrt_mutex_destroy (&rhc->lock);
   ddsrt_free (rhc);
 }
@@ -838,6 +961,30 @@ static bool trigger_info_differs (const struct dds_rhc_default *rhc, const struc
             trig_qc->dec_sample_read != trig_qc->inc_sample_read);
 }
 
+static void init_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s, const struct ddsi_writer_info *wrinfo, const struct ddsi_serdata *sample)
+{
+  s->sample = ddsi_serdata_ref (sample); /* drops const (tho refcount does change) */
+  s->wr_iid = wrinfo->iid;
+  s->isread = false;
+  s->disposed_gen = inst->disposed_gen;
+  s->no_writers_gen = inst->no_writers_gen;
+#ifdef DDS_HAS_LIFESPAN
+  s->inst = inst;
+  s->lifespan.t_expire = wrinfo->lifespan_exp;
+  if (s->lifespan.t_expire.v != DDS_NEVER)
+    rhc->lifespan_used = true;
+  lifespan_register_sample_locked (&rhc->lifespan, &s->lifespan);
+#endif
+
+  s->conds = 0;
+  if (rhc->nqconds != 0)
+  {
+    for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
+      if (rc->m_query.m_filter != 0 && eval_predicate_sample (rhc, s->sample, rc->m_query.m_filter))
+        s->conds |= rc->m_query.m_qcmask;
+  }
+}
+
 static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, const struct ddsi_writer_info *wrinfo, const struct ddsi_serdata *sample, status_cb_data_t *cb_data, struct trigger_info_qcond *trig_qc, bool * __restrict nda)
 {
   struct rhc_sample *s;
@@ -849,15 +996,17 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
 
   /* We don't do backfilling in BY_SOURCE mode -- we could, but
      choose not to -- and having already filtered out samples
-     preceding inst->latest, we can simply insert it without any
+     preceding the latest sample, we can simply insert it without any
      searching */
   if (inst->nvsamples == rhc->history_depth)
   {
-    /* replace oldest sample; latest points to the latest one, the
-       list is circular from old -> new, so latest->next is the oldest */
+    /* replace oldest sample; the ring is necessarily full and without holes,
+       and so the oldest sample's slot is the next one after the latest */
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
-    assert (inst->latest != NULL);
-    s = inst->latest->next;
+    assert (inst->ring_n == inst->nvsamples && inst->ring_n == inst->ring_size);
+    s = &inst->samples[inst->ring_head];
+    if (++inst->ring_head == inst->ring_size)
+      inst->ring_head = 0;
     assert (trig_qc->dec_conds_sample == 0);
     ddsi_serdata_unref (s->sample);
 
@@ -896,51 +1045,30 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
     }
 
     /* add new latest sample */
-    s = alloc_sample (inst);
+    s = alloc_sample (rhc, inst);
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
-    if (inst->latest == NULL)
-    {
-      s->next = s;
-    }
-    else
-    {
-      s->next = inst->latest->next;
-      inst->latest->next = s;
-    }
     inst->nvsamples++;
     rhc->n_vsamples++;
   }
 
-  s->sample = ddsi_serdata_ref (sample); /* drops const (tho refcount does change) */
-  s->wr_iid = wrinfo->iid;
-  s->isread = false;
-  s->disposed_gen = inst->disposed_gen;
-  s->no_writers_gen = inst->no_writers_gen;
-#ifdef DDS_HAS_LIFESPAN
-  s->inst = inst;
-  s->lifespan.t_expire = wrinfo->lifespan_exp;
-  lifespan_register_sample_locked (&rhc->lifespan, &s->lifespan);
-#endif
-
-  s->conds = 0;
-  if (rhc->nqconds != 0)
-  {
-    for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
-      if (rc->m_query.m_filter != 0 && eval_predicate_sample (rhc, s->sample, rc->m_query.m_filter))
-        s->conds |= rc->m_query.m_qcmask;
-  }
-
+  init_sample (rhc, inst, s, wrinfo, sample);
   trig_qc->inc_conds_sample = s->conds;
-  inst->latest = s;
   *nda = true;
   return true;
 }
 
+static dds_time_t sample_reception_timestamp (const struct ddsi_serdata *sample)
+{
+  /* Reception timestamp is only known for samples received from the network */
+  return (sample->reception_timestamp.v == INT64_MIN) ? 0 : sample->reception_timestamp.v;
+}
+
 static void content_filter_make_sampleinfo (struct dds_sample_info *si, const struct ddsi_serdata *sample, const struct rhc_instance *inst, uint64_t wr_iid, uint64_t iid)
 {
   si->sample_state = DDS_SST_NOT_READ;
   si->publication_handle = wr_iid;
   si->source_timestamp = sample->timestamp.v;
+  si->reception_timestamp = sample_reception_timestamp (sample);
   si->sample_rank = 0;
   si->generation_rank = 0;
   si->absolute_generation_rank = 0;
@@ -980,6 +1108,9 @@ static bool content_filter_accepts (const dds_reader *reader, const struct ddsi_
         ret = tp->m_filter.f.sampleinfo_arg (&si, tp->m_filter.arg);
         break;
       }
+      case DDS_TOPIC_FILTER_EXPRESSION:
+        ret = ddsi_cdrfilter_eval (tp->m_filter.arg, sample);
+        break;
       case DDS_TOPIC_FILTER_SAMPLE:
       case DDS_TOPIC_FILTER_SAMPLE_ARG:
       case DDS_TOPIC_FILTER_SAMPLE_SAMPLEINFO_ARG: {
@@ -990,6 +1121,7 @@ static bool content_filter_accepts (const dds_reader *reader, const struct ddsi_
         {
           case DDS_TOPIC_FILTER_NONE:
           case DDS_TOPIC_FILTER_SAMPLEINFO_ARG:
+          case DDS_TOPIC_FILTER_EXPRESSION:
             assert (0);
           case DDS_TOPIC_FILTER_SAMPLE:
             ret = (tp->m_filter.f.sample) (tmp);
@@ -1318,7 +1450,7 @@ static int rhc_unregister_updateinst (struct dds_rhc_default *rhc, struct rhc_in
          care.) */
       if (!inst->isdisposed)
       {
-        if (inst->latest == NULL || inst->latest->isread)
+        if (inst->nvsamples == 0 || inst_latest_sample (inst)->isread)
         {
           inst_set_invsample (rhc, inst, trig_qc, nda);
           update_inst (inst, wrinfo, false, tstamp);
@@ -1393,7 +1525,8 @@ static struct rhc_instance *alloc_new_instance (struct dds_rhc_default *rhc, con
   inst->autodispose = wrinfo->auto_dispose;
   inst->deadline_reg = 0;
   inst->isnew = 1;
-  inst->a_sample_free = 1;
+  inst->samples = &inst->a_sample;
+  inst->ring_size = 1;
   inst->conds = 0;
   inst->wr_iid = wrinfo->iid;
   inst->wr_iid_islive = (inst->wrcount != 0);
@@ -1550,14 +1683,85 @@ static void update_viewstate_and_disposedness (struct dds_rhc_default * __restri
   }
 }
 
+static bool store_striped (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk)
+{
+  /* Stores a write (without dispose or unregister) while holding only the stripe lock
+     when that can't affect anything but the instance and the counters: the writer is
+     the live writer of an existing, alive instance without an invalid sample, so
+     there are no changes to the registrations and instance state, and there are no
+     conditions, deadlines, lifespans or sample limits to take into account.  Returns
+     false without side effects if the general path must be used. */
+  struct rhc_instance dummy_instance, *inst;
+  struct rhc_stripe *stripe;
+  bool stored = false;
+
+  if (rhc->nstripes == 0 || sample->kind != SDK_DATA || sample->statusinfo != 0)
+    return false;
+#ifdef DDS_HAS_LIFESPAN
+  if (wrinfo->lifespan_exp.v != DDS_NEVER)
+    return false;
+#endif
+#ifdef DDS_HAS_DEADLINE_MISSED
+  if (rhc->deadline.dur != DDS_INFINITY)
+    return false;
+#endif
+  if (rhc->max_samples != DDS_LENGTH_UNLIMITED)
+    return false;
+
+  stripe = rhc_stripe_of (rhc, tk->m_iid);
+  dummy_instance.iid = tk->m_iid;
+  ddsrt_mutex_lock (&stripe->lock);
+  if (rhc->nconds == 0 && !rhc->lifespan_used &&
+      (inst = ddsrt_hh_lookup (rhc->instances, &dummy_instance)) != NULL &&
+      inst->wr_iid_islive && inst->wr_iid == wrinfo->iid && !inst->isdisposed && !inst->inv_exists &&
+      (inst->nvsamples == rhc->history_depth || rhc->max_samples_per_instance == DDS_LENGTH_UNLIMITED ||
+       inst->nvsamples < (uint32_t) rhc->max_samples_per_instance) &&
+      inst_accepts_sample (rhc, inst, wrinfo, sample, true))
+  {
+    const bool was_empty = inst_is_empty (inst);
+    struct rhc_sample *s;
+    assert (inst->wrcount > 0);
+    if (inst->nvsamples == rhc->history_depth)
+    {
+      s = &inst->samples[inst->ring_head];
+      if (++inst->ring_head == inst->ring_size)
+        inst->ring_head = 0;
+      ddsi_serdata_unref (s->sample);
+      if (s->isread)
+      {
+        inst->nvread--;
+        stripe->n_vread--;
+      }
+    }
+    else
+    {
+      s = alloc_sample (rhc, inst);
+      inst->nvsamples++;
+      stripe->n_vsamples++;
+    }
+    init_sample (rhc, inst, s, wrinfo, sample);
+    update_inst (inst, wrinfo, true, sample->timestamp);
+    if (was_empty)
+    {
+      ddsrt_mutex_lock (&rhc->nonempty_lock);
+      ddsrt_circlist_append (&rhc->nonempty_instances, &inst->nonempty_list);
+      ddsrt_mutex_unlock (&rhc->nonempty_lock);
+      stripe->n_nonempty_instances++;
+    }
+    TRACE ("rhc_store %"PRIx64",%"PRIx64": striped\n", tk->m_iid, wrinfo->iid);
+    stored = true;
+  }
+  ddsrt_mutex_unlock (&stripe->lock);
+  return stored;
+}
+
 /*
   dds_rhc_store: DDSI up call into read cache to store new sample. Returns whether sample
   delivered (true unless a reliable sample rejected).
 */
 
-static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk)
+static bool store_locked (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk, bool * __restrict nda, status_cb_data_t * __restrict cb_data_out)
 {
-  struct dds_rhc_default * const __restrict rhc = (struct dds_rhc_default * __restrict) rhc_common;
   const uint64_t wr_iid = wrinfo->iid;
   const uint32_t statusinfo = sample->statusinfo;
   const bool has_data = (sample->kind == SDK_DATA);
@@ -1588,8 +1792,6 @@ static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, cons
 
   init_trigger_info_qcond (&trig_qc);
 
-  ddsrt_mutex_lock (&rhc->lock);
-
   inst = ddsrt_hh_lookup (rhc->instances, &dummy_instance);
   if (inst == NULL)
   {
@@ -1627,7 +1829,7 @@ static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, cons
       dds_rhc_register (rhc, inst, wr_iid, wrinfo->auto_dispose, false, &notify_data_available);
       if (notify_data_available)
       {
-        if (inst->latest == NULL || inst->latest->isread)
+        if (inst->nvsamples == 0 || inst_latest_sample (inst)->isread)
         {
           const bool was_empty = inst_is_empty (inst);
           inst_set_invsample (rhc, inst, &trig_qc, &notify_data_available);
@@ -1691,7 +1893,7 @@ static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, cons
       }
 
       /* If instance became disposed, add an invalid sample if there are no samples left */
-      if ((bool) inst->isdisposed > old_isdisposed && (inst->latest == NULL || inst->latest->isread))
+      if ((bool) inst->isdisposed > old_isdisposed && (inst->nvsamples == 0 || inst_latest_sample (inst)->isread))
         inst_set_invsample (rhc, inst, &trig_qc, &notify_data_available);
 
       update_inst (inst, wrinfo, true, sample->timestamp);
@@ -1701,7 +1903,7 @@ static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, cons
          guaranteed that we end up with a non-empty instance: for
          example, if the instance was disposed & empty, nothing
          changes. */
-      if (inst->latest || (bool) inst->isdisposed > old_isdisposed)
+      if (inst->nvsamples > 0 || (bool) inst->isdisposed > old_isdisposed)
       {
         if (was_empty)
           account_for_empty_to_nonempty_transition (rhc, inst);
@@ -1744,7 +1946,32 @@ static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, cons
   postprocess_instance_update (rhc, &inst, &pre, &post, &trig_qc);
 
 error_or_nochange:
-  ddsrt_mutex_unlock (&rhc->lock);
+  if (notify_data_available)
+    *nda = true;
+  if (cb_data.raw_status_id >= 0)
+    *cb_data_out = cb_data;
+  return !(rhc->reliable && stored == RHC_REJECTED);
+}
+
+static bool dds_rhc_default_store (struct ddsi_rhc * __restrict rhc_common, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk)
+{
+  struct dds_rhc_default * const __restrict rhc = (struct dds_rhc_default * __restrict) rhc_common;
+  status_cb_data_t cb_data;   /* Callback data for reader status callback */
+  bool notify_data_available = false;
+  bool ret;
+
+  cb_data.raw_status_id = -1;
+  if (store_striped (rhc, wrinfo, sample, tk))
+  {
+    notify_data_available = true;
+    ret = true;
+  }
+  else
+  {
+    rhc_lock (rhc);
+    ret = store_locked (rhc, wrinfo, sample, tk, &notify_data_available, &cb_data);
+    rhc_unlock (rhc);
+  }
 
   if (rhc->reader)
   {
@@ -1753,7 +1980,43 @@ error_or_nochange:
     if (cb_data.raw_status_id >= 0)
       dds_reader_status_cb (&rhc->reader->m_entity, &cb_data);
   }
-  return !(rhc->reliable && stored == RHC_REJECTED);
+  return ret;
+}
+
+static uint32_t dds_rhc_default_store_batch (struct ddsi_rhc * __restrict rhc_common, const struct ddsi_writer_info * __restrict wrinfo, uint32_t n, struct ddsi_serdata * const * __restrict samples, struct ddsi_tkmap_instance * const * __restrict tks)
+{
+  /* Stores the samples in order under a single lock operation and raises a single
+     DATA_AVAILABLE event, except that the lock is released to invoke the listener
+     for any other status change and that with lock stripes, samples that can be
+     stored in the striped mode are stored individually (the others then each take
+     the lock for the entire RHC).  Stops at a rejected sample (which can only
+     happen for a reliable reader), returning the number of samples stored. */
+  struct dds_rhc_default * const __restrict rhc = (struct dds_rhc_default * __restrict) rhc_common;
+  bool notify_data_available = false;
+  bool ok = true;
+  uint32_t i = 0;
+  while (i < n && ok)
+  {
+    status_cb_data_t cb_data;
+    cb_data.raw_status_id = -1;
+    if (store_striped (rhc, wrinfo, samples[i], tks[i]))
+    {
+      notify_data_available = true;
+      i++;
+      continue;
+    }
+    rhc_lock (rhc);
+    do {
+      ok = store_locked (rhc, wrinfo, samples[i], tks[i], &notify_data_available, &cb_data);
+      i++;
+    } while (ok && i < n && cb_data.raw_status_id < 0 && rhc->nstripes == 0);
+    rhc_unlock (rhc);
+    if (rhc->reader && cb_data.raw_status_id >= 0)
+      dds_reader_status_cb (&rhc->reader->m_entity, &cb_data);
+  }
+  if (rhc->reader && notify_data_available)
+    dds_reader_data_available_cb (rhc->reader);
+  return ok ? i : i - 1;
 }
 
 static void dds_rhc_default_unregister_wr (struct ddsi_rhc * __restrict rhc_common, const struct ddsi_writer_info * __restrict wrinfo)
@@ -1779,7 +2042,7 @@ static void dds_rhc_default_unregister_wr (struct ddsi_rhc * __restrict rhc_comm
   struct ddsrt_hh_iter iter;
   const uint64_t wr_iid = wrinfo->iid;
 
-  ddsrt_mutex_lock (&rhc->lock);
+  rhc_lock (rhc);
   TRACE ("rhc_unregister_wr_iid %"PRIx64",%d:\n", wr_iid, wrinfo->auto_dispose);
   for (inst = ddsrt_hh_iter_first (rhc->instances, &iter); inst; inst = ddsrt_hh_iter_next (&iter))
   {
@@ -1797,7 +2060,7 @@ static void dds_rhc_default_unregister_wr (struct ddsi_rhc * __restrict rhc_comm
       TRACE ("\n");
     }
   }
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
 
   if (rhc->reader && notify_data_available)
     dds_reader_data_available_cb (rhc->reader);
@@ -1808,7 +2071,7 @@ static void dds_rhc_default_relinquish_ownership (struct ddsi_rhc * __restrict r
   struct dds_rhc_default * __restrict const rhc = (struct dds_rhc_default * __restrict) rhc_common;
   struct rhc_instance *inst;
   struct ddsrt_hh_iter iter;
-  ddsrt_mutex_lock (&rhc->lock);
+  rhc_lock (rhc);
   TRACE ("rhc_relinquish_ownership(%"PRIx64":\n", wr_iid);
   for (inst = ddsrt_hh_iter_first (rhc->instances, &iter); inst; inst = ddsrt_hh_iter_next (&iter))
   {
@@ -1819,7 +2082,7 @@ static void dds_rhc_default_relinquish_ownership (struct ddsi_rhc * __restrict r
   }
   TRACE (")\n");
   assert (rhc_check_counts_locked (rhc, true, false));
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
 }
 
 /* STATUSES:
@@ -1924,6 +2187,7 @@ static void set_sample_info (dds_sample_info_t *si, const struct rhc_instance *i
   si->absolute_generation_rank = (inst->disposed_gen + inst->no_writers_gen) - (sample->disposed_gen + sample->no_writers_gen);
   si->valid_data = true;
   si->source_timestamp = sample->sample->timestamp.v;
+  si->reception_timestamp = sample_reception_timestamp (sample->sample);
 }
 
 static void set_sample_info_invsample (dds_sample_info_t *si, const struct rhc_instance *inst)
@@ -1940,6 +2204,7 @@ static void set_sample_info_invsample (dds_sample_info_t *si, const struct rhc_i
   si->absolute_generation_rank = 0;
   si->valid_data = false;
   si->source_timestamp = inst->tstamp.v;
+  si->reception_timestamp = 0;
 }
 
 static void patch_generations (dds_sample_info_t *si, uint32_t last_of_inst)
@@ -2040,26 +2305,23 @@ static int32_t read_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
   init_trigger_info_qcond (&trig_qc);
 
   /* any valid samples precede a possible invalid sample */
-  if (inst->latest)
+  for (uint32_t i = 0; i < inst->ring_n && n < max_samples; i++)
   {
-    struct rhc_sample *sample = inst->latest->next, * const end1 = sample;
-    do {
-      if ((qmask_of_sample (sample) & qminv) == 0 && (qcmask == 0 || (sample->conds & qcmask)))
+    struct rhc_sample * const sample = inst_sample (inst, i);
+    if (sample->sample != NULL && (qmask_of_sample (sample) & qminv) == 0 && (qcmask == 0 || (sample->conds & qcmask)))
+    {
+      /* sample state matches too */
+      set_sample_info (info_seq + n, inst, sample);
+      to_sample (sample->sample, values + n, 0, 0);
+      if (!sample->isread)
       {
-        /* sample state matches too */
-        set_sample_info (info_seq + n, inst, sample);
-        to_sample (sample->sample, values + n, 0, 0);
-        if (!sample->isread)
-        {
-          read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, false);
-          sample->isread = true;
-          inst->nvread++;
-          rhc->n_vread++;
-        }
-        ++n;
+        read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, false);
+        sample->isread = true;
+        inst->nvread++;
+        rhc->n_vread++;
       }
-      sample = sample->next;
-    } while (n < max_samples && sample != end1);
+      ++n;
+    }
   }
 
   /* add an invalid sample if it exists, matches and there is room in the result */
@@ -2117,44 +2379,30 @@ static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
   get_trigger_info_pre (&pre, inst);
   init_trigger_info_qcond (&trig_qc);
 
-  if (inst->latest)
+  if (inst->nvsamples > 0)
   {
-    struct rhc_sample *psample = inst->latest;
-    struct rhc_sample *sample = psample->next;
-    uint32_t nvsamples = inst->nvsamples;
-    while (nvsamples--)
+    for (uint32_t i = 0; i < inst->ring_n && n < max_samples; i++)
     {
-      struct rhc_sample * const sample1 = sample->next;
-      if ((qmask_of_sample (sample) & qminv) != 0 || (qcmask != 0 && !(sample->conds & qcmask)))
+      struct rhc_sample * const sample = inst_sample (inst, i);
+      if (sample->sample == NULL || (qmask_of_sample (sample) & qminv) != 0 || (qcmask != 0 && !(sample->conds & qcmask)))
       {
-        /* sample mask doesn't match, or content predicate doesn't match */
-        psample = sample;
+        /* hole, sample mask doesn't match, or content predicate doesn't match */
+        continue;
       }
-      else
+      take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, sample->isread);
+      set_sample_info (info_seq + n, inst, sample);
+      to_sample (sample->sample, values + n, 0, 0);
+      rhc->n_vsamples--;
+      if (sample->isread)
       {
-        take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, sample->isread);
-        set_sample_info (info_seq + n, inst, sample);
-        to_sample (sample->sample, values + n, 0, 0);
-        rhc->n_vsamples--;
-        if (sample->isread)
-        {
-          inst->nvread--;
-          rhc->n_vread--;
-        }
-        if (--inst->nvsamples == 0)
-          inst->latest = NULL;
-        else
-        {
-          if (inst->latest == sample)
-            inst->latest = psample;
-          psample->next = sample1;
-        }
-        free_sample (rhc, inst, sample);
-        if (++n == max_samples)
-          break;
+        inst->nvread--;
+        rhc->n_vread--;
       }
-      sample = sample1;
+      inst->nvsamples--;
+      free_sample (rhc, sample);
+      ++n;
     }
+    trim_sample_ring (inst);
   }
 
   if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcmask == 0 || (inst->conds & qcmask) != 0))
@@ -2192,13 +2440,158 @@ static int32_t take_w_qminv_inst (struct dds_rhc_default * const __restrict rhc,
   return n;
 }
 
+static int32_t read_w_qminv_inst_striped (struct dds_rhc_default * const __restrict rhc, struct rhc_stripe * const __restrict stripe, struct rhc_instance * const __restrict inst, void * __restrict * __restrict values, dds_sample_info_t * __restrict info_seq, const int32_t max_samples, const uint32_t qminv, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
+{
+  /* Variant of read_w_qminv_inst for use with only the stripe lock held, there being
+     no conditions: the changes to the global counters go into the stripe */
+  int32_t n = 0;
+  assert (max_samples > 0);
+  assert (rhc->nconds == 0);
+  if (inst_is_empty (inst) || (qmask_of_inst (inst) & qminv) != 0)
+    return 0;
+
+  for (uint32_t i = 0; i < inst->ring_n && n < max_samples; i++)
+  {
+    struct rhc_sample * const sample = inst_sample (inst, i);
+    if (sample->sample != NULL && (qmask_of_sample (sample) & qminv) == 0)
+    {
+      set_sample_info (info_seq + n, inst, sample);
+      to_sample (sample->sample, values + n, 0, 0);
+      if (!sample->isread)
+      {
+        sample->isread = true;
+        inst->nvread++;
+        stripe->n_vread++;
+      }
+      ++n;
+    }
+  }
+
+  if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0)
+  {
+    set_sample_info_invsample (info_seq + n, inst);
+    to_invsample (rhc->type, inst->tk->m_sample, values + n, 0, 0);
+    if (!inst->inv_isread)
+    {
+      inst->inv_isread = 1;
+      stripe->n_invread++;
+    }
+    ++n;
+  }
+
+  if (n > 0)
+  {
+    patch_generations (info_seq, (uint32_t) n - 1);
+    if (inst->isnew)
+    {
+      inst->isnew = 0;
+      stripe->n_new--;
+    }
+  }
+  return n;
+}
+
+static int32_t take_w_qminv_inst_striped (struct dds_rhc_default * const __restrict rhc, struct rhc_stripe * const __restrict stripe, struct rhc_instance * const __restrict inst, void * __restrict * __restrict values, dds_sample_info_t * __restrict info_seq, const int32_t max_samples, const uint32_t qminv, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
+{
+  /* Variant of take_w_qminv_inst for use with only the stripe lock held, there being
+     no conditions and no samples with a finite lifespan, and the instance having at
+     least one writer so that it can't be dropped */
+  int32_t n = 0;
+  assert (max_samples > 0);
+  assert (rhc->nconds == 0 && !rhc->lifespan_used);
+  assert (inst->wrcount > 0);
+  if (inst_is_empty (inst) || (qmask_of_inst (inst) & qminv) != 0)
+    return 0;
+
+  if (inst->nvsamples > 0)
+  {
+    for (uint32_t i = 0; i < inst->ring_n && n < max_samples; i++)
+    {
+      struct rhc_sample * const sample = inst_sample (inst, i);
+      if (sample->sample == NULL || (qmask_of_sample (sample) & qminv) != 0)
+        continue;
+      set_sample_info (info_seq + n, inst, sample);
+      to_sample (sample->sample, values + n, 0, 0);
+      stripe->n_vsamples--;
+      if (sample->isread)
+      {
+        inst->nvread--;
+        stripe->n_vread--;
+      }
+      inst->nvsamples--;
+      free_sample (rhc, sample);
+      ++n;
+    }
+    trim_sample_ring (inst);
+  }
+
+  if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0)
+  {
+    set_sample_info_invsample (info_seq + n, inst);
+    to_invsample (rhc->type, inst->tk->m_sample, values + n, 0, 0);
+    inst->inv_exists = 0;
+    if (inst->inv_isread)
+      stripe->n_invread--;
+    stripe->n_invsamples--;
+    ++n;
+  }
+
+  if (n > 0)
+  {
+    patch_generations (info_seq, (uint32_t) n - 1);
+    if (inst->isnew)
+    {
+      inst->isnew = 0;
+      stripe->n_new--;
+    }
+    if (inst_is_empty (inst))
+    {
+      ddsrt_mutex_lock (&rhc->nonempty_lock);
+      ddsrt_circlist_remove (&rhc->nonempty_instances, &inst->nonempty_list);
+      ddsrt_mutex_unlock (&rhc->nonempty_lock);
+      stripe->n_nonempty_instances--;
+      if (inst->isdisposed)
+        stripe->n_not_alive_disposed--;
+    }
+  }
+  return n;
+}
+
+static struct rhc_instance *lock_stripe_for_instance (struct dds_rhc_default *rhc, dds_instance_handle_t handle, bool take, struct rhc_stripe **stripe)
+{
+  /* Returns the instance with its stripe locked if a read/take of that instance
+     can be done while holding only the stripe lock, else NULL without locking */
+  struct rhc_instance template, *inst;
+  *stripe = rhc_stripe_of (rhc, handle);
+  template.iid = handle;
+  ddsrt_mutex_lock (&(*stripe)->lock);
+  if (rhc->nconds == 0 && !(take && rhc->lifespan_used) &&
+      (inst = ddsrt_hh_lookup (rhc->instances, &template)) != NULL &&
+      !(take && inst->wrcount == 0))
+    return inst;
+  ddsrt_mutex_unlock (&(*stripe)->lock);
+  return NULL;
+}
+
 static int32_t read_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock, void * __restrict * __restrict values, dds_sample_info_t * __restrict info_seq, int32_t max_samples, uint32_t qminv, dds_instance_handle_t handle, dds_readcond * __restrict cond, read_take_to_sample_t to_sample, read_take_to_invsample_t to_invsample)
 {
   int32_t n = 0;
   assert (max_samples > 0);
+  if (lock && handle && cond == NULL && rhc->nstripes > 0)
+  {
+    struct rhc_stripe *stripe;
+    struct rhc_instance *inst;
+    if ((inst = lock_stripe_for_instance (rhc, handle, false, &stripe)) != NULL)
+    {
+      n = read_w_qminv_inst_striped (rhc, stripe, inst, values, info_seq, max_samples, qminv, to_sample, to_invsample);
+      ddsrt_mutex_unlock (&stripe->lock);
+      TRACE ("read_w_qminv(%p,%"PRIx64"): striped, returning %"PRId32"\n", (void *) rhc, handle, n);
+      return n;
+    }
+  }
   if (lock)
   {
-    ddsrt_mutex_lock (&rhc->lock);
+    rhc_lock (rhc);
   }
 
   TRACE ("read_w_qminv(%p,%p,%p,%"PRId32",%"PRIx32",%"PRIx64",%p) - inst %"PRIu32" nonempty %"PRIu32" disp %"PRIu32" nowr %"PRIu32" new %"PRIu32" samples %"PRIu32"+%"PRIu32" read %"PRIu32"+%"PRIu32"\n",
@@ -2233,7 +2626,7 @@ static int32_t read_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
   // It appears to have been introduced at some point so another language binding could lock
   // the RHC using dds_rhc_default_lock_samples to find out the number of samples present,
   // then allocate stuff and call read/take with lock=true. All that needs fixing.
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
   return n;
 }
 
@@ -2241,9 +2634,21 @@ static int32_t take_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
 {
   int32_t n = 0;
   assert (max_samples > 0);
+  if (lock && handle && cond == NULL && rhc->nstripes > 0)
+  {
+    struct rhc_stripe *stripe;
+    struct rhc_instance *inst;
+    if ((inst = lock_stripe_for_instance (rhc, handle, true, &stripe)) != NULL)
+    {
+      n = take_w_qminv_inst_striped (rhc, stripe, inst, values, info_seq, max_samples, qminv, to_sample, to_invsample);
+      ddsrt_mutex_unlock (&stripe->lock);
+      TRACE ("take_w_qminv(%p,%"PRIx64"): striped, returning %"PRId32"\n", (void *) rhc, handle, n);
+      return n;
+    }
+  }
   if (lock)
   {
-    ddsrt_mutex_lock (&rhc->lock);
+    rhc_lock (rhc);
   }
 
   TRACE ("take_w_qminv(%p,%p,%p,%"PRId32",%"PRIx32",%"PRIx64",%p) - inst %"PRIu32" nonempty %"PRIu32" disp %"PRIu32" nowr %"PRIu32" new %"PRIu32" samples %"PRIu32"+%"PRIu32" read %"PRIu32"+%"PRIu32"\n",
@@ -2280,7 +2685,7 @@ static int32_t take_w_qminv (struct dds_rhc_default * __restrict rhc, bool lock,
   // It appears to have been introduced at some point so another language binding could lock
   // the RHC using dds_rhc_default_lock_samples to find out the number of samples present,
   // then allocate stuff and call read/take with lock=true. All that needs fixing.
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
   return n;
 }
 
@@ -2369,7 +2774,7 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_r
 
   cond->m_qminv = qmask_from_dcpsquery (cond->m_sample_states, cond->m_view_states, cond->m_instance_states);
 
-  ddsrt_mutex_lock (&rhc->lock);
+  rhc_lock (rhc);
 
   /* Allocate a slot in the condition bitmasks; return an error no more slots are available */
   if (cond->m_query.m_filter != 0)
@@ -2383,7 +2788,7 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_r
     if (avail_qcmask == 0)
     {
       /* no available indices */
-      ddsrt_mutex_unlock (&rhc->lock);
+      rhc_unlock (rhc);
       return false;
     }
 
@@ -2429,15 +2834,14 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_r
       uint32_t matches = 0;
 
       inst->conds = (inst->conds & ~qcmask) | (instmatch ? qcmask : 0);
-      if (inst->latest)
+      for (uint32_t i = 0; i < inst->ring_n; i++)
       {
-        struct rhc_sample *sample = inst->latest->next, * const end = sample;
-        do {
-          const bool m = eval_predicate_sample (rhc, sample->sample, cond->m_query.m_filter);
-          sample->conds = (sample->conds & ~qcmask) | (m ? qcmask : 0);
-          matches += m;
-          sample = sample->next;
-        } while (sample != end);
+        struct rhc_sample * const sample = inst_sample (inst, i);
+        if (sample->sample == NULL)
+          continue;
+        const bool m = eval_predicate_sample (rhc, sample->sample, cond->m_query.m_filter);
+        sample->conds = (sample->conds & ~qcmask) | (m ? qcmask : 0);
+        matches += m;
       }
 
       if (!inst_is_empty (inst) && rhc_get_cond_trigger (inst, cond))
@@ -2455,7 +2859,7 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc *rhc_common, dds_r
     (void *) rhc, cond->m_sample_states, cond->m_view_states,
     cond->m_instance_states, (void *) cond, cond->m_qminv, rhc->nconds);
 
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
   return true;
 }
 
@@ -2463,7 +2867,7 @@ static void dds_rhc_default_remove_readcondition (struct dds_rhc *rhc_common, dd
 {
   struct dds_rhc_default * const rhc = (struct dds_rhc_default *) rhc_common;
   dds_readcond **ptr;
-  ddsrt_mutex_lock (&rhc->lock);
+  rhc_lock (rhc);
   ptr = &rhc->conds;
   while (*ptr != cond)
     ptr = &(*ptr)->m_next;
@@ -2481,7 +2885,7 @@ static void dds_rhc_default_remove_readcondition (struct dds_rhc *rhc_common, dd
       rhc->qcond_eval_samplebuf = NULL;
     }
   }
-  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_unlock (rhc);
 }
 
 static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_from_insert, const struct trigger_info_pre *pre, const struct trigger_info_post *post, const struct trigger_info_qcond *trig_qc, const struct rhc_instance *inst)
@@ -2636,13 +3040,11 @@ static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_f
         {
           if (inst->inv_exists)
             mcurrent += (qmask_of_invsample (inst) & iter->m_qminv) == 0 && (inst->conds & qcmask) != 0;
-          if (inst->latest)
+          for (uint32_t i = 0; i < inst->ring_n; i++)
           {
-            struct rhc_sample *sample = inst->latest->next, * const end = sample;
-            do {
+            struct rhc_sample const * const sample = inst_sample (inst, i);
+            if (sample->sample != NULL)
               mcurrent += (qmask_of_sample (sample) & iter->m_qminv) == 0 && (sample->conds & qcmask) != 0;
-              sample = sample->next;
-            } while (sample != end);
           }
         }
         if (mdelta == 0 && mcurrent == 0)
@@ -2757,7 +3159,6 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
   for (inst = ddsrt_hh_iter_first (rhc->instances, &iter); inst; inst = ddsrt_hh_iter_next (&iter))
   {
     uint32_t n_vsamples_in_instance = 0, n_read_vsamples_in_instance = 0;
-    bool a_sample_free = true;
 
     n_instances++;
     if (inst->isnew)
@@ -2771,24 +3172,21 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
     else if (inst->wrcount == 0)
       n_not_alive_no_writers++;
 
-    if (inst->latest)
+    assert ((inst->ring_size == 1) == (inst->samples == &inst->a_sample));
+    assert (inst->ring_head < inst->ring_size && inst->ring_n <= inst->ring_size);
+    assert (inst->ring_n == 0 || (inst_sample (inst, 0)->sample != NULL && inst_latest_sample (inst)->sample != NULL));
+    for (uint32_t j = 0; j < inst->ring_n; j++)
     {
-      struct rhc_sample *sample = inst->latest->next, * const end = sample;
-      do {
-        if (sample == &inst->a_sample)
-        {
-          assert (a_sample_free);
-          a_sample_free = false;
-        }
-        n_vsamples++;
-        n_vsamples_in_instance++;
-        if (sample->isread)
-        {
-          n_vread++;
-          n_read_vsamples_in_instance++;
-        }
-        sample = sample->next;
-      } while (sample != end);
+      struct rhc_sample const * const sample = inst_sample (inst, j);
+      if (sample->sample == NULL)
+        continue;
+      n_vsamples++;
+      n_vsamples_in_instance++;
+      if (sample->isread)
+      {
+        n_vread++;
+        n_read_vsamples_in_instance++;
+      }
     }
 
     if (inst->inv_exists)
@@ -2799,7 +3197,6 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
 
     assert (n_read_vsamples_in_instance == inst->nvread);
     assert (n_vsamples_in_instance == inst->nvsamples);
-    assert (a_sample_free == inst->a_sample_free);
 
     if (check_conds)
     {
@@ -2812,18 +3209,17 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
           if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
             qcmask |= rciter->m_query.m_qcmask;
         assert ((inst->conds & enabled_qcmask) == qcmask);
-        if (inst->latest)
+        for (uint32_t j = 0; j < inst->ring_n; j++)
         {
-          struct rhc_sample *sample = inst->latest->next, * const end = sample;
-          do {
-            ddsi_serdata_to_sample (sample->sample, rhc->qcond_eval_samplebuf, NULL, NULL);
-            qcmask = 0;
-            for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
-              if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
-                qcmask |= rciter->m_query.m_qcmask;
-            assert ((sample->conds & enabled_qcmask) == qcmask);
-            sample = sample->next;
-          } while (sample != end);
+          struct rhc_sample const * const sample = inst_sample (inst, j);
+          if (sample->sample == NULL)
+            continue;
+          ddsi_serdata_to_sample (sample->sample, rhc->qcond_eval_samplebuf, NULL, NULL);
+          qcmask = 0;
+          for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
+            if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
+              qcmask |= rciter->m_query.m_qcmask;
+          assert ((sample->conds & enabled_qcmask) == qcmask);
         }
       }
 
@@ -2837,13 +3233,11 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
         {
           if (inst->inv_exists)
             cond_match_count[i] += (qmask_of_invsample (inst) & rciter->m_qminv) == 0 && (inst->conds & rciter->m_query.m_qcmask) != 0;
-          if (inst->latest)
+          for (uint32_t j = 0; j < inst->ring_n; j++)
           {
-            struct rhc_sample *sample = inst->latest->next, * const end = sample;
-            do {
+            struct rhc_sample const * const sample = inst_sample (inst, j);
+            if (sample->sample != NULL)
               cond_match_count[i] += ((qmask_of_sample (sample) & rciter->m_qminv) == 0 && (sample->conds & rciter->m_query.m_qcmask) != 0);
-              sample = sample->next;
-            } while (sample != end);
           }
         }
       }
@@ -2896,6 +3290,7 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
 static const struct dds_rhc_ops dds_rhc_default_ops = {
   .rhc_ops = {
     .store = dds_rhc_default_store,
+    .store_batch = dds_rhc_default_store_batch,
     .unregister_wr = dds_rhc_default_unregister_wr,
     .relinquish_ownership = dds_rhc_default_relinquish_ownership,
     .set_qos = dds_rhc_default_set_qos,
@@ -34,6 +34,7 @@
 #include "dds/ddsi/ddsi_plist.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_cdrstream.h"
+#include "dds/ddsi/ddsi_cdrfilter.h"
 #include "dds/ddsi/ddsi_security_omg.h"
 #include "dds__serdata_builtintopic.h"
 
@@ -148,6 +149,12 @@ void dds_topic_allow_set_qos (struct dds_topic *tp)
 
 static dds_return_t dds_topic_delete (dds_entity *e) ddsrt_nonnull_all;
 
+static void dds_topic_filter_fini (struct dds_topic_filter *filter)
+{
+  if (filter->mode == DDS_TOPIC_FILTER_EXPRESSION)
+    ddsi_cdrfilter_free (filter->arg);
+}
+
 static dds_return_t dds_topic_delete (dds_entity *e)
 {
   struct dds_topic * const tp = (dds_topic *) e;
@@ -158,6 +165,7 @@ static dds_return_t dds_topic_delete (dds_entity *e)
   ddsi_tl_meta_local_unref (&pp->m_entity.m_domain->gv, NULL, tp->m_stype);
 #endif
   ddsrt_free (tp->m_name);
+  dds_topic_filter_fini (&tp->m_filter);
   ddsi_sertype_unref (tp->m_stype);
 
   ddsrt_mutex_lock (&pp->m_entity.m_mutex);
@@ -452,6 +460,8 @@ dds_entity_t dds_create_topic (dds_entity_t participant, const dds_topic_descrip
   ddsi_sertype_init (&st->c, desc->m_typename, &ddsi_sertype_ops_default, desc->m_nkeys ? &ddsi_serdata_ops_cdr : &ddsi_serdata_ops_cdr_nokey, (desc->m_nkeys == 0));
   st->native_encoding_identifier = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? CDR_LE : CDR_BE);
   st->serpool = ppent->m_domain->gv.serpool;
+  st->size_hint = ddsrt_malloc (sizeof (*st->size_hint));
+  ddsrt_atomic_st32 (st->size_hint, 0);
   st->type.size = desc->m_size;
   st->type.align = desc->m_align;
   st->type.flagset = desc->m_flagset;
@@ -461,12 +471,15 @@ dds_entity_t dds_create_topic (dds_entity_t participant, const dds_topic_descrip
     st->type.keys.keys[i] = desc->m_keys[i].m_index;
   st->type.ops.nops = dds_stream_countops (desc->m_ops);
   st->type.ops.ops = ddsrt_memdup (desc->m_ops, st->type.ops.nops * sizeof (*st->type.ops.ops));
+  st->meta = desc->m_meta ? ddsrt_strdup (desc->m_meta) : NULL;
 
   /* Check if topic cannot be optimised (memcpy marshal) */
-  if (!(st->type.flagset & DDS_TOPIC_NO_OPTIMIZE)) {
+  if (!(st->type.flagset & DDS_TOPIC_NO_OPTIMIZE))
     st->opt_size = dds_stream_check_optimize (&st->type);
-    DDS_CTRACE (&ppent->m_domain->gv.logconfig, "Marshalling for type: %s is %soptimised\n", desc->m_typename, st->opt_size ? "" : "not ");
-  }
+  if (st->opt_size == 0)
+    st->copy_plan = dds_stream_copy_plan_new (&st->type);
+  st->cdr_align = dds_stream_max_align (&st->type);
+  DDS_CTRACE (&ppent->m_domain->gv.logconfig, "Marshalling for type: %s is %soptimised\n", desc->m_typename, st->opt_size ? "" : st->copy_plan ? "partially " : "not ");
 
   ddsi_plist_init_empty (&plist);
   /* Set Topic meta data (for SEDP publication) */
@@ -572,6 +585,10 @@ dds_return_t dds_set_topic_filter_extended (dds_entity_t topic, const struct dds
         // can safely use any of the function pointers
         valid = (filter->f.sample != 0);
         break;
+      case DDS_TOPIC_FILTER_EXPRESSION:
+        // only dds_set_topic_filter_expression can set a compiled expression
+        valid = false;
+        break;
     }
     if (!valid)
     {
@@ -582,6 +599,38 @@ dds_return_t dds_set_topic_filter_extended (dds_entity_t topic, const struct dds
 
   if ((rc = dds_topic_lock (topic, &t)) != DDS_RETCODE_OK)
     return rc;
+  dds_topic_filter_fini (&t->m_filter);
+  t->m_filter = f;
+  dds_topic_unlock (t);
+  return DDS_RETCODE_OK;
+}
+
+dds_return_t dds_set_topic_filter_expression (dds_entity_t topic, const char *expression, uint32_t nparams, const char * const *params)
+{
+  struct dds_topic_filter f = { .mode = DDS_TOPIC_FILTER_NONE, .f = { .sample = 0 }, .arg = NULL };
+  dds_topic *t;
+  dds_return_t rc;
+
+  if (nparams > 0 && params == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_topic_lock (topic, &t)) != DDS_RETCODE_OK)
+    return rc;
+  if (expression != NULL)
+  {
+    struct ddsi_cdrfilter *cf;
+    if (t->m_stype->ops != &ddsi_sertype_ops_default)
+      rc = DDS_RETCODE_UNSUPPORTED;
+    else
+      rc = ddsi_cdrfilter_compile (&cf, (const struct ddsi_sertype_default *) t->m_stype, expression, nparams, params);
+    if (rc != DDS_RETCODE_OK)
+    {
+      dds_topic_unlock (t);
+      return rc;
+    }
+    f.mode = DDS_TOPIC_FILTER_EXPRESSION;
+    f.arg = cf;
+  }
+  dds_topic_filter_fini (&t->m_filter);
   t->m_filter = f;
   dds_topic_unlock (t);
   return DDS_RETCODE_OK;
@@ -650,6 +699,7 @@ dds_return_t dds_get_topic_filter_and_arg (dds_entity_t topic, dds_topic_filter_
     case DDS_TOPIC_FILTER_SAMPLE:
     case DDS_TOPIC_FILTER_SAMPLEINFO_ARG:
     case DDS_TOPIC_FILTER_SAMPLE_SAMPLEINFO_ARG:
+    case DDS_TOPIC_FILTER_EXPRESSION:
       rc = DDS_RETCODE_PRECONDITION_NOT_MET;
       break;
   }
@@ -34,6 +34,8 @@
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds__whc.h"
+#include "dds__whc_ring.h"
+#include "dds__whc_durable.h"
 #include "dds__entity.h"
 #include "dds__writer.h"
 
@@ -89,6 +91,8 @@ struct whc_writer_info {
   dds_writer * writer; /* can be NULL, eg in case of whc for built-in writers */
   unsigned is_transient_local: 1;
   unsigned has_deadline: 1;
+  unsigned has_lifespan: 1;
+  unsigned is_durable: 1; /* TRANSIENT or PERSISTENT with a durable store configured (=> is_transient_local) */
   uint32_t hdepth; /* 0 = unlimited */
   uint32_t tldepth; /* 0 = disabled/unlimited (no need to maintain an index if KEEP_ALL <=> is_transient_local + tldepth=0) */
   uint32_t idxdepth; /* = max (hdepth, tldepth) */
@@ -427,8 +431,10 @@ struct whc_writer_info *whc_make_wrinfo (struct dds_writer *wr, const dds_qos_t
   assert (qos->present & QP_DURABILITY);
   assert (qos->present & QP_DURABILITY_SERVICE);
   wrinfo->writer = wr;
-  wrinfo->is_transient_local = (qos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL);
+  wrinfo->is_durable = (qos->durability.kind > DDS_DURABILITY_TRANSIENT_LOCAL && wr != NULL && durability_handled_as_transient_local (&wr->m_entity.m_domain->gv, qos->durability.kind));
+  wrinfo->is_transient_local = (qos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL) || wrinfo->is_durable;
   wrinfo->has_deadline = (qos->deadline.deadline != DDS_INFINITY);
+  wrinfo->has_lifespan = ((qos->present & QP_LIFESPAN) && qos->lifespan.duration != DDS_INFINITY);
   wrinfo->hdepth = (qos->history.kind == DDS_HISTORY_KEEP_ALL) ? 0 : (unsigned) qos->history.depth;
   if (!wrinfo->is_transient_local)
     wrinfo->tldepth = 0;
@@ -445,12 +451,34 @@ void whc_free_wrinfo (struct whc_writer_info *wrinfo)
 
 struct whc *whc_new (struct ddsi_domaingv *gv, const struct whc_writer_info *wrinfo)
 {
-  size_t sample_overhead = 80; /* INFO_TS, DATA (estimate), inline QoS */
   struct whc_impl *whc;
   struct whc_intvnode *intv;
 
   assert ((wrinfo->hdepth == 0 || wrinfo->tldepth <= wrinfo->hdepth) || wrinfo->is_transient_local);
 
+  /* Without an instance index (and hence KEEP_ALL) and without anything that
+     requires the WHC to keep track of time, samples only ever get looked up
+     and dropped by sequence number, which the ring does more efficiently */
+  if (gv->config.whc_ring && wrinfo->idxdepth == 0 && !wrinfo->is_transient_local && !wrinfo->has_deadline && !wrinfo->has_lifespan)
+    return whc_ring_new (gv);
+
+  /* TRANSIENT and PERSISTENT history goes into the durable store, leaving only
+     the unacknowledged samples to a volatile WHC; if the store can't be used,
+     the history is kept in memory as for TRANSIENT_LOCAL */
+  if (wrinfo->is_durable && !wrinfo->has_deadline && !wrinfo->has_lifespan)
+  {
+    struct whc_writer_info inner_wrinfo = *wrinfo;
+    struct whc *inner, *durable;
+    inner_wrinfo.is_durable = 0;
+    inner_wrinfo.is_transient_local = 0;
+    inner_wrinfo.tldepth = 0;
+    inner_wrinfo.idxdepth = inner_wrinfo.hdepth;
+    inner = whc_new (gv, &inner_wrinfo);
+    if ((durable = whc_durable_new (gv, wrinfo->writer, wrinfo->tldepth, inner)) != NULL)
+      return durable;
+    whc_free (inner);
+  }
+
   whc = ddsrt_malloc (sizeof (*whc));
   whc->common.ops = &whc_ops;
   ddsrt_mutex_init (&whc->lock);
@@ -462,7 +490,7 @@ struct whc *whc_new (struct ddsi_domaingv *gv, const struct whc_writer_info *wri
   whc->max_drop_seq = 0;
   whc->unacked_bytes = 0;
   whc->total_bytes = 0;
-  whc->sample_overhead = sample_overhead;
+  whc->sample_overhead = WHC_SAMPLE_OVERHEAD;
   whc->fragment_size = gv->config.fragment_size;
   whc->idx_hash = ddsrt_hh_new (1, whc_idxnode_hash_key, whc_idxnode_eq_key);
 #if USE_EHH
@@ -165,9 +165,8 @@ static uint32_t bwhc_downgrade_to_volatile (struct whc *whc, struct whc_state *s
 
 static uint32_t bwhc_remove_acked_messages (struct whc *whc, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list)
 {
-  (void)whc;
   (void)max_drop_seq;
-  (void)whcst;
+  bwhc_get_state (whc, whcst);
   *deferred_free_list = NULL;
   return 0;
 }
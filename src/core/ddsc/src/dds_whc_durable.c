@@ -0,0 +1,1103 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include "dds/ddsrt/filesystem.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds__whc_durable.h"
+
+#if DDSRT_HAVE_FILESYSTEM && DDSRT_HAVE_FILE_MMAP
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/static_assert.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds__types.h"
+
+/* The history is stored in a directory per writer as a sequence of segment files,
+   each of which starts with a header and is followed by records, each consisting
+   of a record header and the serialized sample, padded to a multiple of 8 bytes.
+   A record header with state 0 (or the end of the file) marks the end of the data
+   in a segment: the files are created full-size and zero-filled.
+
+   New samples are always appended to the "active" segment.  When a sample is no
+   longer part of the history, its record is marked as dead in place; segments
+   without any live records are deleted, and the live records in segments that
+   are mostly dead are moved to the active segment.  Because of the moving, the
+   order of the records in the files need not be the order in which they were
+   written, and so every record carries a serial number that increases across
+   restarts.
+
+   On opening a store, all live records are read back in serial number order,
+   renumbered with sequence numbers starting at 1 and the history depth applied
+   (in case it was interrupted, or the QoS changed).  Sequence numbers in the
+   record headers are only valid while the store is open.
+
+   For PERSISTENT writers, Durability/SyncPolicy determines when the mapped
+   files are forced to disk.  With "write", a record is synchronised before it is
+   made live and again after that, so that a record that is live on disk is also
+   complete; killing a record is synchronised as well.  With "segment", only the
+   complete segments are synchronised, when a new one is started, before a
+   compacted segment is deleted and when the writer is deleted.  The directory
+   is synchronised after creating a segment file with either. */
+
+#define DSTORE_SEG_MAGIC 0x47455344u /* "DSEG" */
+#define DSTORE_SEG_VERSION 1u
+#define DSTORE_REC_LIVE 0x4556494cu /* "LIVE" */
+#define DSTORE_REC_DEAD 0x44414544u /* "DEAD" */
+#define DSTORE_ALIGN 8u
+
+struct dstore_seghdr {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t size;
+};
+
+struct dstore_rechdr {
+  uint32_t state; /* DSTORE_REC_LIVE or DSTORE_REC_DEAD, 0 marks the end */
+  uint32_t size; /* size of serialized sample following the header */
+  uint64_t serial;
+  seqno_t seq;
+  int64_t timestamp;
+  uint32_t statusinfo;
+  uint32_t kind; /* enum ddsi_serdata_kind */
+};
+
+DDSRT_STATIC_ASSERT (sizeof (struct dstore_seghdr) % DSTORE_ALIGN == 0);
+DDSRT_STATIC_ASSERT (sizeof (struct dstore_rechdr) % DSTORE_ALIGN == 0);
+
+struct dstore_segment {
+  struct dstore_segment *next;
+  uint32_t id;
+  unsigned char *base;
+  size_t size;
+  size_t used; /* offset of the end of the data */
+  uint32_t nlive; /* number of live records */
+  size_t livebytes; /* bytes occupied by live records */
+};
+
+/* Samples in the history, in sequence number order; dropping one only clears "seg"
+   and the array is compacted once half of it is dead */
+struct dstore_entry {
+  seqno_t seq;
+  struct dstore_segment *seg; /* NULL if no longer in the history */
+  size_t off;
+};
+
+/* History of an instance: ring of sequence numbers, oldest at "head", of fixed
+   size for KEEP_LAST and growing as needed for KEEP_ALL */
+struct dstore_instance {
+  uint64_t iid;
+  struct ddsi_tkmap_instance *tk;
+  uint32_t head;
+  uint32_t n;
+  uint32_t size;
+  seqno_t *seqs;
+};
+
+struct whc_durable {
+  struct whc common;
+  ddsrt_mutex_t lock;
+  struct ddsi_domaingv *gv;
+  struct whc *inner; /* unacknowledged samples */
+  const struct ddsi_sertype *type;
+  uint32_t tldepth; /* 0 = KEEP_ALL */
+  unsigned persistent: 1;
+  unsigned recovering: 1; /* defer dropping/compacting segments while reading them back */
+  unsigned append_failed: 1; /* so the failure to store samples is reported only once */
+  unsigned sync_failed: 1; /* so the failure to synchronise is reported only once */
+  enum ddsi_durable_sync sync; /* always NONE for TRANSIENT */
+  size_t pagesize;
+  char *dir;
+  int lockfd;
+  size_t segment_size;
+  uint32_t next_segid;
+  uint64_t next_serial;
+  struct dstore_segment *segments;
+  struct dstore_segment *active; /* segment to append to, may be NULL */
+  struct dstore_entry *entries;
+  uint32_t first; /* entries[first] is live (if first < nentries) */
+  uint32_t nentries; /* entries[nentries-1] is live (if first < nentries) */
+  uint32_t entries_size;
+  uint32_t nlive; /* number of live entries in [first,nentries) */
+  struct ddsrt_hh *instances;
+};
+
+struct whc_durable_sample_iter {
+  struct whc_sample_iter_base c;
+  bool first;
+};
+
+/* check that our definition of whc_sample_iter fits in the type that callers allocate */
+DDSRT_STATIC_ASSERT (sizeof (struct whc_durable_sample_iter) <= sizeof (struct whc_sample_iter));
+
+#define TRACE(...) DDS_CLOG (DDS_LC_WHC, &whc->gv->logconfig, __VA_ARGS__)
+
+static size_t dstore_recsize (uint32_t size)
+{
+  return (sizeof (struct dstore_rechdr) + size + DSTORE_ALIGN - 1) & ~(size_t) (DSTORE_ALIGN - 1);
+}
+
+static struct dstore_rechdr *dstore_rec (const struct dstore_segment *seg, size_t off)
+{
+  return (struct dstore_rechdr *) (seg->base + off);
+}
+
+static void dstore_sync_range (struct whc_durable *whc, unsigned char *base, size_t off, size_t len)
+{
+  /* msync requires a page-aligned address */
+  const size_t start = off & ~(whc->pagesize - 1);
+  if (msync (base + start, off + len - start, MS_SYNC) < 0 && !whc->sync_failed)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: failed to synchronise history to disk (%d)\n", whc->dir, errno);
+    whc->sync_failed = 1;
+  }
+}
+
+static void dstore_sync_dir (struct whc_durable *whc)
+{
+  int fd;
+  if ((fd = open (whc->dir, O_RDONLY)) < 0 || fsync (fd) < 0)
+  {
+    if (!whc->sync_failed)
+    {
+      DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: failed to synchronise directory (%d)\n", whc->dir, errno);
+      whc->sync_failed = 1;
+    }
+  }
+  if (fd >= 0)
+    (void) close (fd);
+}
+
+static char *dstore_segment_path (const struct whc_durable *whc, uint32_t id)
+{
+  char *path;
+  (void) ddsrt_asprintf (&path, "%s/%08"PRIx32".seg", whc->dir, id);
+  return path;
+}
+
+static struct dstore_segment *dstore_add_segment (struct whc_durable *whc, uint32_t id, unsigned char *base, size_t size)
+{
+  struct dstore_segment *seg = ddsrt_malloc (sizeof (*seg));
+  seg->id = id;
+  seg->base = base;
+  seg->size = size;
+  seg->used = sizeof (struct dstore_seghdr);
+  seg->nlive = 0;
+  seg->livebytes = 0;
+  seg->next = whc->segments;
+  whc->segments = seg;
+  return seg;
+}
+
+static struct dstore_segment *dstore_new_segment (struct whc_durable *whc, size_t minsize)
+{
+  const size_t size = (sizeof (struct dstore_seghdr) + minsize > whc->segment_size) ? sizeof (struct dstore_seghdr) + minsize : whc->segment_size;
+  char *path = dstore_segment_path (whc, whc->next_segid);
+  struct dstore_seghdr *hdr;
+  void *base;
+  int fd;
+  if ((fd = open (path, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+    goto err_open;
+  /* Allocate the space up front, running out of disk space while writing to a
+     mapped file is fatal */
+#if defined (__linux)
+  if (posix_fallocate (fd, 0, (off_t) size) != 0)
+    goto err_size;
+#else
+  if (ftruncate (fd, (off_t) size) < 0)
+    goto err_size;
+#endif
+  if ((base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    goto err_size;
+  (void) close (fd);
+  ddsrt_free (path);
+  hdr = base;
+  hdr->magic = DSTORE_SEG_MAGIC;
+  hdr->version = DSTORE_SEG_VERSION;
+  hdr->size = size;
+  if (whc->sync != DDSI_DURABLE_SYNC_NONE)
+  {
+    dstore_sync_range (whc, base, 0, sizeof (*hdr));
+    dstore_sync_dir (whc);
+  }
+  TRACE ("whc_durable %s: new segment %08"PRIx32" size %"PRIuSIZE"\n", whc->dir, whc->next_segid, size);
+  return dstore_add_segment (whc, whc->next_segid++, base, size);
+
+err_size:
+  (void) close (fd);
+  (void) unlink (path);
+err_open:
+  ddsrt_free (path);
+  return NULL;
+}
+
+static void dstore_unmap_segment (struct whc_durable *whc, struct dstore_segment *seg, bool remove)
+{
+  if (remove)
+  {
+    char *path = dstore_segment_path (whc, seg->id);
+    (void) unlink (path);
+    ddsrt_free (path);
+  }
+  (void) munmap (seg->base, seg->size);
+}
+
+static void dstore_drop_segment (struct whc_durable *whc, struct dstore_segment *seg)
+{
+  struct dstore_segment **pseg;
+  assert (seg->nlive == 0);
+  assert (seg != whc->active);
+  TRACE ("whc_durable %s: drop segment %08"PRIx32"\n", whc->dir, seg->id);
+  for (pseg = &whc->segments; *pseg != seg; pseg = &(*pseg)->next)
+    assert (*pseg != NULL);
+  *pseg = seg->next;
+  dstore_unmap_segment (whc, seg, true);
+  ddsrt_free (seg);
+}
+
+static struct dstore_rechdr *dstore_alloc (struct whc_durable *whc, uint32_t size, struct dstore_segment **seg, size_t *off)
+{
+  const size_t recsize = dstore_recsize (size);
+  if (whc->active == NULL || whc->active->size - whc->active->used < recsize)
+  {
+    struct dstore_segment * const old = whc->active;
+    struct dstore_segment *new;
+    if ((new = dstore_new_segment (whc, recsize)) == NULL)
+      return NULL;
+    whc->active = new;
+    if (old && old->nlive == 0)
+      dstore_drop_segment (whc, old);
+    else if (old && whc->sync == DDSI_DURABLE_SYNC_SEGMENT)
+      dstore_sync_range (whc, old->base, 0, old->used);
+  }
+  *seg = whc->active;
+  *off = whc->active->used;
+  whc->active->used += recsize;
+  return dstore_rec (*seg, *off);
+}
+
+static void dstore_commit (struct whc_durable *whc, struct dstore_segment *seg, struct dstore_rechdr *rec)
+{
+  /* Making it live last means a crash halfway through leaves the end marker in place */
+  const size_t off = (size_t) ((unsigned char *) rec - seg->base);
+  if (whc->sync == DDSI_DURABLE_SYNC_WRITE)
+    dstore_sync_range (whc, seg->base, off, dstore_recsize (rec->size));
+  rec->state = DSTORE_REC_LIVE;
+  if (whc->sync == DDSI_DURABLE_SYNC_WRITE)
+    dstore_sync_range (whc, seg->base, off, sizeof (rec->state));
+  seg->nlive++;
+  seg->livebytes += dstore_recsize (rec->size);
+}
+
+static void dstore_kill (struct whc_durable *whc, struct dstore_segment *seg, struct dstore_rechdr *rec)
+{
+  assert (rec->state == DSTORE_REC_LIVE);
+  assert (seg->nlive > 0);
+  rec->state = DSTORE_REC_DEAD;
+  if (whc->sync == DDSI_DURABLE_SYNC_WRITE)
+    dstore_sync_range (whc, seg->base, (size_t) ((unsigned char *) rec - seg->base), sizeof (rec->state));
+  seg->nlive--;
+  seg->livebytes -= dstore_recsize (rec->size);
+}
+
+static uint32_t dstore_find_entry (const struct whc_durable *whc, seqno_t seq)
+{
+  /* index of first entry with sequence number >= seq */
+  uint32_t lo = whc->first, hi = whc->nentries;
+  while (lo < hi)
+  {
+    const uint32_t m = lo + (hi - lo) / 2;
+    if (whc->entries[m].seq < seq)
+      lo = m + 1;
+    else
+      hi = m;
+  }
+  return lo;
+}
+
+static struct dstore_entry *dstore_lookup_entry (const struct whc_durable *whc, seqno_t seq)
+{
+  const uint32_t idx = dstore_find_entry (whc, seq);
+  if (idx < whc->nentries && whc->entries[idx].seq == seq && whc->entries[idx].seg != NULL)
+    return &whc->entries[idx];
+  return NULL;
+}
+
+static void dstore_add_entry (struct whc_durable *whc, seqno_t seq, struct dstore_segment *seg, size_t off)
+{
+  assert (whc->nlive == 0 || seq > whc->entries[whc->nentries - 1].seq);
+  if (whc->nentries == whc->entries_size)
+  {
+    if (whc->nlive < whc->entries_size / 2)
+    {
+      uint32_t i, j;
+      for (i = whc->first, j = 0; i < whc->nentries; i++)
+        if (whc->entries[i].seg != NULL)
+          whc->entries[j++] = whc->entries[i];
+      assert (j == whc->nlive);
+      whc->first = 0;
+      whc->nentries = j;
+    }
+    else
+    {
+      whc->entries_size = (whc->entries_size == 0) ? 256 : 2 * whc->entries_size;
+      whc->entries = ddsrt_realloc (whc->entries, whc->entries_size * sizeof (*whc->entries));
+    }
+  }
+  if (whc->nlive == 0)
+    whc->first = whc->nentries = 0;
+  whc->entries[whc->nentries].seq = seq;
+  whc->entries[whc->nentries].seg = seg;
+  whc->entries[whc->nentries].off = off;
+  whc->nentries++;
+  whc->nlive++;
+}
+
+static void dstore_compact_segment (struct whc_durable *whc, struct dstore_segment *seg)
+{
+  /* Moves the live records of a mostly dead segment to the active one, so that a
+     few samples of rarely updated instances don't keep entire files alive.  The
+     copy is made live before the original is killed, so a crash at worst leaves
+     two copies with the same serial number. */
+  size_t off = sizeof (struct dstore_seghdr);
+  TRACE ("whc_durable %s: compact segment %08"PRIx32" (%"PRIu32" live, %"PRIuSIZE" bytes)\n", whc->dir, seg->id, seg->nlive, seg->livebytes);
+  while (off < seg->used && seg->nlive > 0)
+  {
+    struct dstore_rechdr * const rec = dstore_rec (seg, off);
+    const size_t recsize = dstore_recsize (rec->size);
+    if (rec->state == DSTORE_REC_LIVE)
+    {
+      struct dstore_entry * const e = dstore_lookup_entry (whc, rec->seq);
+      struct dstore_segment *nseg;
+      struct dstore_rechdr *nrec;
+      size_t noff;
+      assert (e != NULL && e->seg == seg && e->off == off);
+      if ((nrec = dstore_alloc (whc, rec->size, &nseg, &noff)) == NULL)
+        return;
+      assert (nseg != seg);
+      memcpy ((unsigned char *) nrec + sizeof (nrec->state), (unsigned char *) rec + sizeof (rec->state), recsize - sizeof (rec->state));
+      dstore_commit (whc, nseg, nrec);
+      dstore_kill (whc, seg, rec);
+      e->seg = nseg;
+      e->off = noff;
+    }
+    off += recsize;
+  }
+  assert (seg->nlive == 0);
+  /* the copies must be on disk before the originals disappear */
+  if (whc->sync == DDSI_DURABLE_SYNC_SEGMENT)
+    dstore_sync_range (whc, whc->active->base, 0, whc->active->used);
+  dstore_drop_segment (whc, seg);
+}
+
+static void dstore_maybe_drop_segment (struct whc_durable *whc, struct dstore_segment *seg)
+{
+  if (seg == whc->active || whc->recovering)
+    return;
+  if (seg->nlive == 0)
+    dstore_drop_segment (whc, seg);
+  else if (seg->livebytes < (seg->used - sizeof (struct dstore_seghdr)) / 4)
+    dstore_compact_segment (whc, seg);
+}
+
+static void dstore_drop_entry (struct whc_durable *whc, struct dstore_entry *e)
+{
+  struct dstore_segment * const seg = e->seg;
+  assert (seg != NULL);
+  dstore_kill (whc, seg, dstore_rec (seg, e->off));
+  e->seg = NULL;
+  assert (whc->nlive > 0);
+  whc->nlive--;
+  while (whc->first < whc->nentries && whc->entries[whc->first].seg == NULL)
+    whc->first++;
+  while (whc->nentries > whc->first && whc->entries[whc->nentries - 1].seg == NULL)
+    whc->nentries--;
+  dstore_maybe_drop_segment (whc, seg);
+}
+
+static void dstore_drop_seq (struct whc_durable *whc, seqno_t seq)
+{
+  struct dstore_entry *e;
+  if ((e = dstore_lookup_entry (whc, seq)) != NULL)
+    dstore_drop_entry (whc, e);
+}
+
+static uint32_t dstore_instance_hash (const void *va)
+{
+  const struct dstore_instance *a = va;
+  return (uint32_t) a->iid;
+}
+
+static int dstore_instance_eq (const void *va, const void *vb)
+{
+  const struct dstore_instance *a = va;
+  const struct dstore_instance *b = vb;
+  return a->iid == b->iid;
+}
+
+static struct dstore_instance *dstore_lookup_instance (const struct whc_durable *whc, const struct ddsi_tkmap_instance *tk)
+{
+  struct dstore_instance template;
+  template.iid = tk->m_iid;
+  return ddsrt_hh_lookup (whc->instances, &template);
+}
+
+static struct dstore_instance *dstore_new_instance (struct whc_durable *whc, struct ddsi_tkmap_instance *tk)
+{
+  struct dstore_instance *inst = ddsrt_malloc (sizeof (*inst));
+  ddsi_tkmap_instance_ref (tk);
+  inst->iid = tk->m_iid;
+  inst->tk = tk;
+  inst->head = 0;
+  inst->n = 0;
+  inst->size = (whc->tldepth > 0) ? whc->tldepth : 1;
+  inst->seqs = ddsrt_malloc (inst->size * sizeof (*inst->seqs));
+  if (!ddsrt_hh_add (whc->instances, inst))
+    assert (0);
+  return inst;
+}
+
+static void dstore_free_instance (struct whc_durable *whc, struct dstore_instance *inst)
+{
+  ddsi_tkmap_instance_unref (whc->gv->m_tkmap, inst->tk);
+  ddsrt_free (inst->seqs);
+  ddsrt_free (inst);
+}
+
+static void dstore_drop_instance (struct whc_durable *whc, struct dstore_instance *inst)
+{
+  for (uint32_t i = 0; i < inst->n; i++)
+    dstore_drop_seq (whc, inst->seqs[(inst->head + i) % inst->size]);
+  (void) ddsrt_hh_remove (whc->instances, inst);
+  dstore_free_instance (whc, inst);
+}
+
+static void dstore_instance_push (struct whc_durable *whc, struct dstore_instance *inst, seqno_t seq)
+{
+  if (inst->n == inst->size)
+  {
+    if (whc->tldepth > 0)
+    {
+      /* KEEP_LAST: the oldest one goes */
+      dstore_drop_seq (whc, inst->seqs[inst->head]);
+      inst->head = (inst->head + 1) % inst->size;
+      inst->n--;
+    }
+    else
+    {
+      /* KEEP_ALL: grow, unwrapping the ring */
+      const uint32_t size = 2 * inst->size;
+      seqno_t *seqs = ddsrt_malloc (size * sizeof (*seqs));
+      for (uint32_t i = 0; i < inst->n; i++)
+        seqs[i] = inst->seqs[(inst->head + i) % inst->size];
+      ddsrt_free (inst->seqs);
+      inst->seqs = seqs;
+      inst->size = size;
+      inst->head = 0;
+    }
+  }
+  inst->seqs[(inst->head + inst->n) % inst->size] = seq;
+  inst->n++;
+}
+
+static void dstore_add_to_instance (struct whc_durable *whc, struct ddsi_tkmap_instance *tk, seqno_t seq)
+{
+  struct dstore_instance *inst;
+  if ((inst = dstore_lookup_instance (whc, tk)) == NULL)
+    inst = dstore_new_instance (whc, tk);
+  dstore_instance_push (whc, inst, seq);
+}
+
+static void dstore_drop_all (struct whc_durable *whc)
+{
+  struct ddsrt_hh_iter it;
+  struct dstore_instance *inst;
+  for (inst = ddsrt_hh_iter_first (whc->instances, &it); inst; inst = ddsrt_hh_iter_next (&it))
+  {
+    for (uint32_t i = 0; i < inst->n; i++)
+      dstore_drop_seq (whc, inst->seqs[(inst->head + i) % inst->size]);
+    (void) ddsrt_hh_remove (whc->instances, inst);
+    dstore_free_instance (whc, inst);
+  }
+  assert (whc->nlive == 0);
+}
+
+static struct ddsi_serdata *dstore_make_serdata (const struct whc_durable *whc, const struct dstore_rechdr *rec)
+{
+  struct ddsi_serdata *sd;
+  struct CDRHeader hdr;
+  ddsrt_iovec_t iov;
+  /* The contents of the files can't be trusted, and the deserializers assume the
+     encoding has been checked, like it is on reception */
+  if ((rec->kind != SDK_KEY && rec->kind != SDK_DATA) || rec->size < sizeof (hdr))
+    return NULL;
+  memcpy (&hdr, rec + 1, sizeof (hdr));
+  if (hdr.identifier != CDR_BE && hdr.identifier != CDR_LE && hdr.identifier != PL_CDR_BE && hdr.identifier != PL_CDR_LE)
+    return NULL;
+  iov.iov_base = (void *) (rec + 1);
+  iov.iov_len = (ddsrt_iov_len_t) rec->size;
+  if ((sd = ddsi_serdata_from_ser_iov (whc->type, (enum ddsi_serdata_kind) rec->kind, 1, &iov, rec->size)) != NULL)
+  {
+    sd->statusinfo = rec->statusinfo;
+    sd->timestamp.v = rec->timestamp;
+  }
+  return sd;
+}
+
+static void dstore_write_sample (struct whc_durable *whc, seqno_t seq, const struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  const uint32_t size = ddsi_serdata_size (serdata);
+  struct dstore_segment *seg;
+  struct dstore_rechdr *rec;
+  size_t off;
+  if ((rec = dstore_alloc (whc, size, &seg, &off)) == NULL)
+  {
+    if (!whc->append_failed)
+    {
+      DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: failed to store sample, history is incomplete\n", whc->dir);
+      whc->append_failed = 1;
+    }
+    return;
+  }
+  rec->size = size;
+  rec->serial = whc->next_serial++;
+  rec->seq = seq;
+  rec->timestamp = serdata->timestamp.v;
+  rec->statusinfo = serdata->statusinfo;
+  rec->kind = (uint32_t) serdata->kind;
+  ddsi_serdata_to_ser (serdata, 0, size, rec + 1);
+  dstore_commit (whc, seg, rec);
+  dstore_add_entry (whc, seq, seg, off);
+  dstore_add_to_instance (whc, tk, seq);
+}
+
+static void get_state_locked (const struct whc_durable *whc, struct whc_state *st)
+{
+  whc_get_state (whc->inner, st);
+  if (whc->nlive > 0)
+  {
+    const seqno_t min_seq = whc->entries[whc->first].seq;
+    const seqno_t max_seq = whc->entries[whc->nentries - 1].seq;
+    if (WHCST_ISEMPTY (st))
+    {
+      st->min_seq = min_seq;
+      st->max_seq = max_seq;
+    }
+    else
+    {
+      if (min_seq < st->min_seq)
+        st->min_seq = min_seq;
+      if (max_seq > st->max_seq)
+        st->max_seq = max_seq;
+    }
+  }
+}
+
+static void whc_durable_get_state (const struct whc *whc_generic, struct whc_state *st)
+{
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+}
+
+static int whc_durable_insert (struct whc *whc_generic, seqno_t max_drop_seq, seqno_t seq, ddsrt_mtime_t exp, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  int ret;
+  ddsrt_mutex_lock (&whc->lock);
+  TRACE ("whc_durable_insert(%p max_drop_seq %"PRId64" seq %"PRId64" serdata %p:%"PRIx32")\n", (void *) whc, max_drop_seq, seq, (void *) serdata, serdata->hash);
+  if ((ret = whc_insert (whc->inner, max_drop_seq, seq, exp, plist, serdata, tk)) >= 0 && serdata->kind != SDK_EMPTY)
+  {
+    if (!(serdata->statusinfo & NN_STATUSINFO_UNREGISTER))
+      dstore_write_sample (whc, seq, serdata, tk);
+    else
+    {
+      /* Unregistering removes the instance from the history, as for TRANSIENT_LOCAL */
+      struct dstore_instance *inst;
+      if ((inst = dstore_lookup_instance (whc, tk)) != NULL)
+        dstore_drop_instance (whc, inst);
+    }
+  }
+  ddsrt_mutex_unlock (&whc->lock);
+  return ret;
+}
+
+static uint32_t whc_durable_remove_acked_messages (struct whc *whc_generic, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  uint32_t n;
+  ddsrt_mutex_lock (&whc->lock);
+  n = whc_remove_acked_messages (whc->inner, max_drop_seq, whcst, deferred_free_list);
+  get_state_locked (whc, whcst);
+  ddsrt_mutex_unlock (&whc->lock);
+  return n;
+}
+
+static void whc_durable_free_deferred_free_list (struct whc *whc_generic, struct whc_node *deferred_free_list)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  whc_free_deferred_free_list (whc->inner, deferred_free_list);
+}
+
+static seqno_t whc_durable_next_seq (const struct whc *whc_generic, seqno_t seq)
+{
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  seqno_t nseq;
+  uint32_t idx;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  nseq = whc_next_seq (whc->inner, seq);
+  idx = dstore_find_entry (whc, seq + 1);
+  while (idx < whc->nentries && whc->entries[idx].seg == NULL)
+    idx++;
+  if (idx < whc->nentries && whc->entries[idx].seq < nseq)
+    nseq = whc->entries[idx].seq;
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return nseq;
+}
+
+static bool whc_durable_borrow_sample (const struct whc *whc_generic, seqno_t seq, struct whc_borrowed_sample *sample)
+{
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  const struct dstore_entry *e;
+  bool found;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  if ((found = whc_borrow_sample (whc->inner, seq, sample)) == false && (e = dstore_lookup_entry (whc, seq)) != NULL)
+  {
+    /* Not in the volatile WHC, hence also not in it when it gets returned, and so the
+       volatile WHC's return_sample will release it */
+    struct ddsi_serdata *sd;
+    if ((sd = dstore_make_serdata (whc, dstore_rec (e->seg, e->off))) != NULL)
+    {
+      sample->seq = seq;
+      sample->serdata = sd;
+      sample->plist = NULL;
+      sample->unacked = false;
+      sample->rexmit_count = 0;
+      sample->last_rexmit_ts.v = 0;
+      found = true;
+    }
+  }
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return found;
+}
+
+static bool whc_durable_borrow_sample_key (const struct whc *whc_generic, const struct ddsi_serdata *serdata_key, struct whc_borrowed_sample *sample)
+{
+  /* Only used for the SPDP writer */
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  return whc_borrow_sample_key (whc->inner, serdata_key, sample);
+}
+
+static void whc_durable_return_sample (struct whc *whc_generic, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  whc_return_sample (whc->inner, sample, update_retransmit_info);
+}
+
+static void whc_durable_sample_iter_init (const struct whc *whc_generic, struct whc_sample_iter *opaque_it)
+{
+  struct whc_durable_sample_iter *it = (struct whc_durable_sample_iter *) opaque_it;
+  it->c.whc = (struct whc *) whc_generic;
+  it->first = true;
+}
+
+static bool whc_durable_sample_iter_borrow_next (struct whc_sample_iter *opaque_it, struct whc_borrowed_sample *sample)
+{
+  struct whc_durable_sample_iter * const it = (struct whc_durable_sample_iter *) opaque_it;
+  struct whc * const whc = it->c.whc;
+  seqno_t seq;
+  if (it->first)
+  {
+    it->first = false;
+    seq = 0;
+  }
+  else
+  {
+    seq = sample->seq;
+    whc_durable_return_sample (whc, sample, false);
+  }
+  while ((seq = whc_durable_next_seq (whc, seq)) != MAX_SEQ_NUMBER)
+  {
+    if (whc_durable_borrow_sample (whc, seq, sample))
+      return true;
+  }
+  return false;
+}
+
+static uint32_t whc_durable_downgrade_to_volatile (struct whc *whc_generic, struct whc_state *st)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  uint32_t n;
+  ddsrt_mutex_lock (&whc->lock);
+  n = whc->nlive;
+  dstore_drop_all (whc);
+  n += whc_downgrade_to_volatile (whc->inner, st);
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock (&whc->lock);
+  return n;
+}
+
+static void whc_durable_free (struct whc *whc_generic)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  struct ddsrt_hh_iter it;
+  struct dstore_instance *inst;
+  struct dstore_segment *seg;
+  whc_free (whc->inner);
+  for (inst = ddsrt_hh_iter_first (whc->instances, &it); inst; inst = ddsrt_hh_iter_next (&it))
+    dstore_free_instance (whc, inst);
+  ddsrt_hh_free (whc->instances);
+  while ((seg = whc->segments) != NULL)
+  {
+    whc->segments = seg->next;
+    if (whc->sync == DDSI_DURABLE_SYNC_SEGMENT)
+      dstore_sync_range (whc, seg->base, 0, seg->used);
+    dstore_unmap_segment (whc, seg, !whc->persistent);
+    ddsrt_free (seg);
+  }
+  if (!whc->persistent)
+  {
+    char *path;
+    (void) ddsrt_asprintf (&path, "%s/lock", whc->dir);
+    (void) unlink (path);
+    ddsrt_free (path);
+    (void) rmdir (whc->dir);
+  }
+  (void) close (whc->lockfd);
+  ddsrt_free (whc->entries);
+  ddsrt_free (whc->dir);
+  ddsrt_mutex_destroy (&whc->lock);
+  ddsrt_free (whc);
+}
+
+static const struct whc_ops whc_durable_ops = {
+  .insert = whc_durable_insert,
+  .remove_acked_messages = whc_durable_remove_acked_messages,
+  .free_deferred_free_list = whc_durable_free_deferred_free_list,
+  .get_state = whc_durable_get_state,
+  .next_seq = whc_durable_next_seq,
+  .borrow_sample = whc_durable_borrow_sample,
+  .borrow_sample_key = whc_durable_borrow_sample_key,
+  .return_sample = whc_durable_return_sample,
+  .sample_iter_init = whc_durable_sample_iter_init,
+  .sample_iter_borrow_next = whc_durable_sample_iter_borrow_next,
+  .downgrade_to_volatile = whc_durable_downgrade_to_volatile,
+  .free = whc_durable_free
+};
+
+struct dstore_recovered {
+  uint64_t serial;
+  struct dstore_segment *seg;
+  size_t off;
+};
+
+struct dstore_recovered_vec {
+  uint32_t n, size;
+  struct dstore_recovered *xs;
+};
+
+static int dstore_recovered_cmp (const void *va, const void *vb)
+{
+  const struct dstore_recovered *a = va;
+  const struct dstore_recovered *b = vb;
+  return (a->serial == b->serial) ? 0 : (a->serial < b->serial) ? -1 : 1;
+}
+
+static bool dstore_open_segment (struct whc_durable *whc, uint32_t id, struct dstore_recovered_vec *recs)
+{
+  char *path = dstore_segment_path (whc, id);
+  const struct dstore_seghdr *hdr;
+  struct dstore_segment *seg;
+  struct stat st;
+  void *base;
+  size_t off;
+  int fd;
+  if ((fd = open (path, O_RDWR)) < 0 || fstat (fd, &st) < 0)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: can't open %s\n", whc->dir, path);
+    if (fd >= 0)
+      (void) close (fd);
+    ddsrt_free (path);
+    return false;
+  }
+  if ((size_t) st.st_size < sizeof (*hdr) ||
+      (base = mmap (NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: can't map %s\n", whc->dir, path);
+    (void) close (fd);
+    ddsrt_free (path);
+    return false;
+  }
+  (void) close (fd);
+  hdr = base;
+  if (hdr->magic != DSTORE_SEG_MAGIC || hdr->version != DSTORE_SEG_VERSION || hdr->size < (uint64_t) st.st_size)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: %s is not a valid segment\n", whc->dir, path);
+    (void) munmap (base, (size_t) st.st_size);
+    ddsrt_free (path);
+    return false;
+  }
+  if (hdr->size > (uint64_t) st.st_size)
+  {
+    /* the records that are still there are as good as they ever were */
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: %s is truncated, history may be incomplete\n", whc->dir, path);
+  }
+  ddsrt_free (path);
+
+  seg = dstore_add_segment (whc, id, base, (size_t) st.st_size);
+  off = sizeof (*hdr);
+  while (seg->size - off >= sizeof (struct dstore_rechdr))
+  {
+    struct dstore_rechdr * const rec = dstore_rec (seg, off);
+    if ((rec->state != DSTORE_REC_LIVE && rec->state != DSTORE_REC_DEAD) || rec->size > seg->size - off - sizeof (*rec))
+    {
+      if (rec->state != 0)
+        DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: ignoring invalid data in segment %08"PRIx32" from offset %"PRIuSIZE"\n", whc->dir, id, off);
+      break;
+    }
+    if (rec->state == DSTORE_REC_LIVE)
+    {
+      if (recs->n == recs->size)
+      {
+        recs->size = (recs->size == 0) ? 256 : 2 * recs->size;
+        recs->xs = ddsrt_realloc (recs->xs, recs->size * sizeof (*recs->xs));
+      }
+      recs->xs[recs->n].serial = rec->serial;
+      recs->xs[recs->n].seg = seg;
+      recs->xs[recs->n].off = off;
+      recs->n++;
+      seg->nlive++;
+      seg->livebytes += dstore_recsize (rec->size);
+    }
+    off += dstore_recsize (rec->size);
+  }
+  seg->used = off;
+  return true;
+}
+
+static uint32_t dstore_recover (struct whc_durable *whc)
+{
+  struct dstore_recovered_vec recs = { 0, 0, NULL };
+  struct dstore_segment *seg, *seg_next;
+  struct dirent *de;
+  seqno_t seq = 0;
+  DIR *dir;
+
+  if ((dir = opendir (whc->dir)) == NULL)
+    return 0;
+  while ((de = readdir (dir)) != NULL)
+  {
+    char *end;
+    unsigned long id;
+    if (strlen (de->d_name) != 12 || strcmp (de->d_name + 8, ".seg") != 0)
+      continue;
+    id = strtoul (de->d_name, &end, 16);
+    if (end != de->d_name + 8)
+      continue;
+    if (id >= whc->next_segid)
+      whc->next_segid = (uint32_t) id + 1;
+    (void) dstore_open_segment (whc, (uint32_t) id, &recs);
+  }
+  (void) closedir (dir);
+
+  whc->recovering = 1;
+  if (recs.n > 0)
+    qsort (recs.xs, recs.n, sizeof (*recs.xs), dstore_recovered_cmp);
+  for (uint32_t i = 0; i < recs.n; i++)
+  {
+    struct dstore_rechdr * const rec = dstore_rec (recs.xs[i].seg, recs.xs[i].off);
+    struct ddsi_serdata *sd;
+    struct ddsi_tkmap_instance *tk;
+    if (i > 0 && recs.xs[i].serial == recs.xs[i-1].serial)
+    {
+      /* left over from moving a record */
+      dstore_kill (whc, recs.xs[i].seg, rec);
+      continue;
+    }
+    if ((sd = dstore_make_serdata (whc, rec)) == NULL || (tk = ddsi_tkmap_lookup_instance_ref (whc->gv->m_tkmap, sd)) == NULL)
+    {
+      DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: dropping invalid sample from history\n", whc->dir);
+      if (sd)
+        ddsi_serdata_unref (sd);
+      dstore_kill (whc, recs.xs[i].seg, rec);
+      continue;
+    }
+    rec->seq = ++seq;
+    dstore_add_entry (whc, rec->seq, recs.xs[i].seg, recs.xs[i].off);
+    dstore_add_to_instance (whc, tk, rec->seq);
+    ddsi_tkmap_instance_unref (whc->gv->m_tkmap, tk);
+    ddsi_serdata_unref (sd);
+    if (rec->serial >= whc->next_serial)
+      whc->next_serial = rec->serial + 1;
+  }
+  whc->recovering = 0;
+  ddsrt_free (recs.xs);
+
+  for (seg = whc->segments; seg; seg = seg_next)
+  {
+    seg_next = seg->next;
+    if (seg->nlive == 0)
+      dstore_drop_segment (whc, seg);
+  }
+  for (seg = whc->segments; seg; seg = seg_next)
+  {
+    seg_next = seg->next;
+    dstore_maybe_drop_segment (whc, seg);
+  }
+  return whc->nlive;
+}
+
+static char *dstore_dirname (const struct dds_writer *wr, bool persistent)
+{
+  const char *base = wr->m_entity.m_domain->gv.config.durable_store_dir;
+  char *dir;
+  if (!persistent)
+  {
+    static ddsrt_atomic_uint32_t count = DDSRT_ATOMIC_UINT32_INIT (0);
+    (void) ddsrt_asprintf (&dir, "%s/transient-%"PRIdPID"-%"PRIu32, base, ddsrt_getpid (), ddsrt_atomic_inc32_nv (&count));
+  }
+  else
+  {
+    /* Identified by topic, type and partitions; the topic name is there only for the
+       benefit of a human looking at the directory */
+    const dds_qos_t *qos = wr->m_entity.m_qos;
+    const char *topic_name = wr->m_topic->m_name;
+    const char *type_name = wr->m_topic->m_stype->type_name;
+    char *name = ddsrt_strdup (topic_name);
+    uint32_t h;
+    h = ddsrt_mh3 (topic_name, strlen (topic_name) + 1, 0);
+    h = ddsrt_mh3 (type_name, strlen (type_name) + 1, h);
+    if (qos->present & QP_PARTITION)
+    {
+      for (uint32_t i = 0; i < qos->partition.n; i++)
+        h = ddsrt_mh3 (qos->partition.strs[i], strlen (qos->partition.strs[i]) + 1, h);
+    }
+    for (char *p = name; *p; p++)
+    {
+      if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_' || *p == '.'))
+        *p = '_';
+    }
+    (void) ddsrt_asprintf (&dir, "%s/%s-%08"PRIx32, base, name, h);
+    ddsrt_free (name);
+  }
+  return dir;
+}
+
+static bool dstore_lock_dir (struct whc_durable *whc)
+{
+  char *path;
+  if (mkdir (whc->gv->config.durable_store_dir, 0700) < 0 && errno != EEXIST)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable: can't create %s\n", whc->gv->config.durable_store_dir);
+    return false;
+  }
+  if (mkdir (whc->dir, 0700) < 0 && errno != EEXIST)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable: can't create %s\n", whc->dir);
+    return false;
+  }
+  (void) ddsrt_asprintf (&path, "%s/lock", whc->dir);
+  whc->lockfd = open (path, O_RDWR | O_CREAT, 0600);
+  ddsrt_free (path);
+  if (whc->lockfd < 0)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable: can't create lock file in %s\n", whc->dir);
+    return false;
+  }
+  if (flock (whc->lockfd, LOCK_EX | LOCK_NB) < 0)
+  {
+    DDS_CWARNING (&whc->gv->logconfig, "whc_durable %s: in use by another writer, keeping history in memory\n", whc->dir);
+    (void) close (whc->lockfd);
+    return false;
+  }
+  return true;
+}
+
+struct whc *whc_durable_new (struct ddsi_domaingv *gv, const struct dds_writer *wr, uint32_t tldepth, struct whc *inner)
+{
+  struct whc_durable *whc = ddsrt_malloc (sizeof (*whc));
+  uint32_t nrecovered;
+  whc->common.ops = &whc_durable_ops;
+  ddsrt_mutex_init (&whc->lock);
+  whc->gv = gv;
+  whc->inner = inner;
+  whc->type = wr->m_topic->m_stype;
+  whc->tldepth = tldepth;
+  whc->persistent = (wr->m_entity.m_qos->durability.kind == DDS_DURABILITY_PERSISTENT);
+  whc->recovering = 0;
+  whc->append_failed = 0;
+  whc->sync_failed = 0;
+  whc->sync = whc->persistent ? gv->config.durable_sync : DDSI_DURABLE_SYNC_NONE;
+  whc->pagesize = (size_t) sysconf (_SC_PAGESIZE);
+  whc->dir = dstore_dirname (wr, whc->persistent);
+  whc->lockfd = -1;
+  whc->segment_size = (gv->config.durable_segment_size > sizeof (struct dstore_seghdr)) ? gv->config.durable_segment_size : 65536;
+  whc->next_segid = 0;
+  whc->next_serial = 1;
+  whc->segments = NULL;
+  whc->active = NULL;
+  whc->entries = NULL;
+  whc->first = whc->nentries = whc->entries_size = 0;
+  whc->nlive = 0;
+  whc->instances = ddsrt_hh_new (1, dstore_instance_hash, dstore_instance_eq);
+  if (!dstore_lock_dir (whc))
+  {
+    ddsrt_hh_free (whc->instances);
+    ddsrt_free (whc->dir);
+    ddsrt_mutex_destroy (&whc->lock);
+    ddsrt_free (whc);
+    return NULL;
+  }
+
+  /* Whatever a TRANSIENT writer finds was left behind by a process that no longer
+     exists (the name includes the process id), but it might as well reuse the files */
+  nrecovered = dstore_recover (whc);
+  if (!whc->persistent)
+    dstore_drop_all (whc);
+  else if (nrecovered > 0)
+    DDS_CLOG (DDS_LC_DISCOVERY, &gv->logconfig, "whc_durable %s: %"PRIu32" samples in history\n", whc->dir, nrecovered);
+  return &whc->common;
+}
+
+#else
+
+struct whc *whc_durable_new (struct ddsi_domaingv *gv, const struct dds_writer *wr, uint32_t tldepth, struct whc *inner)
+{
+  (void) gv;
+  (void) wr;
+  (void) tldepth;
+  (void) inner;
+  return NULL;
+}
+
+#endif
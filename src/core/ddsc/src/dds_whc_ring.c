@@ -0,0 +1,551 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/static_assert.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/q_unused.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__whc.h"
+#include "dds__whc_ring.h"
+
+/* Initial number of slots, grows by doubling whenever the range of sequence
+   numbers in the WHC no longer fits; it never shrinks */
+#define WHC_RING_INITIAL_SIZE 64u
+
+struct whc_ring_slot {
+  seqno_t seq; /* 0 if slot is empty */
+  struct ddsi_serdata *serdata;
+  struct ddsi_plist *plist; /* 0 if nothing special */
+  size_t size;
+  unsigned unacked: 1; /* counted in whc::unacked_bytes iff 1 */
+  unsigned borrowed: 1; /* at most one can borrow it at any time */
+  uint32_t rexmit_count;
+  ddsrt_mtime_t last_rexmit_ts;
+};
+
+/* Deferred free list: the contents of the slots dropped in one call to
+   remove_acked_messages, so they can be freed without holding the lock.
+   Samples that are borrowed at the time they are dropped are not in it,
+   ownership of those passes to the borrower. */
+struct whc_ring_dropped {
+  struct ddsi_serdata *serdata;
+  struct ddsi_plist *plist;
+};
+
+struct whc_ring_node {
+  uint32_t n;
+  struct whc_ring_dropped s[];
+};
+
+struct whc_ring {
+  struct whc common;
+  ddsrt_mutex_t lock;
+  struct ddsi_domaingv *gv;
+  size_t sample_overhead;
+  uint32_t fragment_size;
+  unsigned xchecks: 1;
+  uint32_t mask; /* number of slots - 1, number of slots is a power of 2 */
+  uint32_t count; /* number of samples in the WHC */
+  seqno_t min_seq; /* lowest sequence number present, valid iff count > 0 */
+  seqno_t max_seq; /* highest sequence number present, valid iff count > 0 */
+  seqno_t max_drop_seq;
+  size_t unacked_bytes;
+  struct whc_ring_slot *slots;
+};
+
+struct whc_ring_sample_iter {
+  struct whc_sample_iter_base c;
+  bool first;
+};
+
+/* check that our definition of whc_sample_iter fits in the type that callers allocate */
+DDSRT_STATIC_ASSERT (sizeof (struct whc_ring_sample_iter) <= sizeof (struct whc_sample_iter));
+
+#define TRACE(...) DDS_CLOG (DDS_LC_WHC, &whc->gv->logconfig, __VA_ARGS__)
+
+static struct whc_ring_slot *whc_ring_slot (const struct whc_ring *whc, seqno_t seq)
+{
+  return &whc->slots[(uint32_t) seq & whc->mask];
+}
+
+static struct whc_ring_slot *whc_ring_findseq (const struct whc_ring *whc, seqno_t seq)
+{
+  struct whc_ring_slot *slot;
+  if (whc->count == 0 || seq < whc->min_seq || seq > whc->max_seq)
+    return NULL;
+  slot = whc_ring_slot (whc, seq);
+  return (slot->seq == seq) ? slot : NULL;
+}
+
+static void check_whc_ring (const struct whc_ring *whc)
+{
+  if (whc->count == 0)
+  {
+    assert (whc->unacked_bytes == 0);
+    return;
+  }
+  assert (whc->min_seq <= whc->max_seq);
+  assert (whc->max_seq - whc->min_seq <= (seqno_t) whc->mask);
+  assert (whc->count <= whc->max_seq - whc->min_seq + 1);
+  assert (whc_ring_slot (whc, whc->min_seq)->seq == whc->min_seq);
+  assert (whc_ring_slot (whc, whc->max_seq)->seq == whc->max_seq);
+
+#if !defined (NDEBUG)
+  if (whc->xchecks)
+  {
+    uint32_t count = 0;
+    size_t unacked_bytes = 0;
+    for (uint32_t i = 0; i <= whc->mask; i++)
+    {
+      const struct whc_ring_slot *slot = &whc->slots[i];
+      if (slot->seq == 0)
+        continue;
+      assert (slot->seq >= whc->min_seq && slot->seq <= whc->max_seq);
+      assert (((uint32_t) slot->seq & whc->mask) == i);
+      count++;
+      if (slot->unacked)
+        unacked_bytes += slot->size;
+    }
+    assert (count == whc->count);
+    assert (unacked_bytes == whc->unacked_bytes);
+  }
+#endif
+}
+
+static void get_state_locked (const struct whc_ring *whc, struct whc_state *st)
+{
+  if (whc->count == 0)
+  {
+    st->min_seq = st->max_seq = -1;
+    st->unacked_bytes = 0;
+  }
+  else
+  {
+    st->min_seq = whc->min_seq;
+    st->max_seq = whc->max_seq;
+    st->unacked_bytes = whc->unacked_bytes;
+  }
+}
+
+static void whc_ring_get_state (const struct whc *whc_generic, struct whc_state *st)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  check_whc_ring (whc);
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+}
+
+static seqno_t next_seq_locked (const struct whc_ring *whc, seqno_t seq)
+{
+  /* max_seq is always present, so this terminates, and because the range
+     [min_seq,max_seq] fits in the ring, scanning over gaps is bounded */
+  if (whc->count == 0 || seq >= whc->max_seq)
+    return MAX_SEQ_NUMBER;
+  if (++seq < whc->min_seq)
+    seq = whc->min_seq;
+  while (whc_ring_slot (whc, seq)->seq != seq)
+    seq++;
+  return seq;
+}
+
+static seqno_t whc_ring_next_seq (const struct whc *whc_generic, seqno_t seq)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  seqno_t nseq;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  check_whc_ring (whc);
+  nseq = next_seq_locked (whc, seq);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return nseq;
+}
+
+static void free_deferred_free_list (struct whc_ring_node *deferred_free_list)
+{
+  if (deferred_free_list)
+  {
+    for (uint32_t i = 0; i < deferred_free_list->n; i++)
+    {
+      ddsi_serdata_unref (deferred_free_list->s[i].serdata);
+      if (deferred_free_list->s[i].plist)
+      {
+        ddsi_plist_fini (deferred_free_list->s[i].plist);
+        ddsrt_free (deferred_free_list->s[i].plist);
+      }
+    }
+    ddsrt_free (deferred_free_list);
+  }
+}
+
+static void whc_ring_free_deferred_free_list (struct whc *whc_generic, struct whc_node *deferred_free_list)
+{
+  /* struct whc_node is opaque outside the WHC implementations, for the ring it is a whc_ring_node */
+  (void) whc_generic;
+  free_deferred_free_list ((struct whc_ring_node *) deferred_free_list);
+}
+
+static uint32_t drop_locked (struct whc_ring *whc, seqno_t max_drop_seq, struct whc_ring_node **deferred_free_list)
+{
+  struct whc_ring_node *dfl;
+  seqno_t lim, seq;
+  uint32_t ndropped = 0;
+
+  if (whc->count == 0 || max_drop_seq < whc->min_seq)
+  {
+    *deferred_free_list = NULL;
+    return 0;
+  }
+
+  lim = (max_drop_seq < whc->max_seq) ? max_drop_seq : whc->max_seq;
+  dfl = ddsrt_malloc (offsetof (struct whc_ring_node, s) + ((lim - whc->min_seq + 1 < whc->count) ? (size_t) (lim - whc->min_seq + 1) : whc->count) * sizeof (dfl->s[0]));
+  dfl->n = 0;
+  for (seq = whc->min_seq; seq <= lim; seq++)
+  {
+    struct whc_ring_slot * const slot = whc_ring_slot (whc, seq);
+    if (slot->seq != seq)
+      continue;
+    if (slot->unacked)
+    {
+      assert (whc->unacked_bytes >= slot->size);
+      whc->unacked_bytes -= slot->size;
+    }
+    /* data still borrowed => ownership of serdata, plist shifts to the borrower */
+    if (!slot->borrowed)
+    {
+      dfl->s[dfl->n].serdata = slot->serdata;
+      dfl->s[dfl->n].plist = slot->plist;
+      dfl->n++;
+    }
+    slot->seq = 0;
+    ndropped++;
+  }
+
+  assert (ndropped <= whc->count);
+  whc->count -= ndropped;
+  if (whc->count > 0)
+  {
+    whc->min_seq = lim + 1;
+    while (whc_ring_slot (whc, whc->min_seq)->seq != whc->min_seq)
+      whc->min_seq++;
+  }
+  else
+  {
+    assert (whc->unacked_bytes == 0);
+  }
+
+  if (dfl->n > 0)
+    *deferred_free_list = dfl;
+  else
+  {
+    ddsrt_free (dfl);
+    *deferred_free_list = NULL;
+  }
+  return ndropped;
+}
+
+static uint32_t whc_ring_remove_acked_messages (struct whc *whc_generic, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  struct whc_ring_node *dfl;
+  uint32_t cnt;
+
+  ddsrt_mutex_lock (&whc->lock);
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+
+  if (whc->gv->logconfig.c.mask & DDS_LC_WHC)
+  {
+    struct whc_state tmp;
+    get_state_locked (whc, &tmp);
+    TRACE ("whc_ring_remove_acked_messages(%p max_drop_seq %"PRId64")\n", (void *) whc, max_drop_seq);
+    TRACE ("  whc: [%"PRId64",%"PRId64"] max_drop_seq %"PRId64" size %"PRIu32"\n",
+           tmp.min_seq, tmp.max_seq, whc->max_drop_seq, whc->mask + 1);
+  }
+
+  check_whc_ring (whc);
+  cnt = drop_locked (whc, max_drop_seq, &dfl);
+  whc->max_drop_seq = max_drop_seq;
+  get_state_locked (whc, whcst);
+  ddsrt_mutex_unlock (&whc->lock);
+  *deferred_free_list = (struct whc_node *) dfl;
+  return cnt;
+}
+
+static void grow_locked (struct whc_ring *whc, seqno_t span)
+{
+  struct whc_ring_slot *slots;
+  uint32_t size = whc->mask + 1, mask;
+  assert (span <= (seqno_t) (UINT32_C (1) << 31));
+  while ((seqno_t) size < span)
+    size *= 2;
+  TRACE ("  grow %"PRIu32" -> %"PRIu32"\n", whc->mask + 1, size);
+  mask = size - 1;
+  slots = ddsrt_malloc (size * sizeof (*slots));
+  memset (slots, 0, size * sizeof (*slots));
+  for (seqno_t seq = whc->min_seq; seq <= whc->max_seq; seq++)
+  {
+    const struct whc_ring_slot *slot = whc_ring_slot (whc, seq);
+    if (slot->seq == seq)
+      slots[(uint32_t) seq & mask] = *slot;
+  }
+  ddsrt_free (whc->slots);
+  whc->slots = slots;
+  whc->mask = mask;
+}
+
+static size_t whc_ring_sample_size (const struct whc_ring *whc, const struct ddsi_serdata *serdata)
+{
+  size_t sz = ddsi_serdata_size (serdata);
+  return sz + ((sz + whc->fragment_size - 1) / whc->fragment_size) * whc->sample_overhead;
+}
+
+static int whc_ring_insert (struct whc *whc_generic, seqno_t max_drop_seq, seqno_t seq, ddsrt_mtime_t exp, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  struct whc_ring_slot *slot;
+
+  /* No per-instance administration, and a lifespan set after creating the
+     writer is left to the readers */
+  DDSRT_UNUSED_ARG (exp);
+  DDSRT_UNUSED_ARG (tk);
+
+  ddsrt_mutex_lock (&whc->lock);
+  check_whc_ring (whc);
+
+  if (whc->gv->logconfig.c.mask & DDS_LC_WHC)
+  {
+    struct whc_state whcst;
+    get_state_locked (whc, &whcst);
+    TRACE ("whc_ring_insert(%p max_drop_seq %"PRId64" seq %"PRId64" plist %p serdata %p:%"PRIx32")\n",
+           (void *) whc, max_drop_seq, seq, (void *) plist, (void *) serdata, serdata->hash);
+    TRACE ("  whc: [%"PRId64",%"PRId64"] max_drop_seq %"PRId64" size %"PRIu32"\n",
+           whcst.min_seq, whcst.max_seq, whc->max_drop_seq, whc->mask + 1);
+  }
+
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  assert (seq > 0);
+  assert (whc->count == 0 || seq > whc->max_seq);
+
+  if (whc->count > 0 && seq - whc->min_seq > (seqno_t) whc->mask)
+  {
+    /* Either the writer is running ahead of its readers, or there is a gap
+       in the sequence numbers because samples aren't stored while there are
+       no reliable readers.  In the latter case, what is still in here has
+       usually been acknowledged already, so only grow if dropping those
+       doesn't make it fit. */
+    struct whc_ring_node *deferred_free_list;
+    (void) drop_locked (whc, max_drop_seq, &deferred_free_list);
+    free_deferred_free_list (deferred_free_list);
+    whc->max_drop_seq = max_drop_seq;
+    if (whc->count > 0 && seq - whc->min_seq > (seqno_t) whc->mask)
+      grow_locked (whc, seq - whc->min_seq + 1);
+  }
+
+  slot = whc_ring_slot (whc, seq);
+  assert (slot->seq == 0);
+  slot->seq = seq;
+  slot->serdata = ddsi_serdata_ref (serdata);
+  slot->plist = plist;
+  slot->size = whc_ring_sample_size (whc, serdata);
+  slot->unacked = (seq > max_drop_seq);
+  slot->borrowed = 0;
+  slot->rexmit_count = 0;
+  slot->last_rexmit_ts.v = 0;
+  if (slot->unacked)
+    whc->unacked_bytes += slot->size;
+  if (whc->count++ == 0)
+    whc->min_seq = seq;
+  whc->max_seq = seq;
+  ddsrt_mutex_unlock (&whc->lock);
+  return 0;
+}
+
+static void make_borrowed_sample (struct whc_borrowed_sample *sample, struct whc_ring_slot *slot)
+{
+  assert (!slot->borrowed);
+  slot->borrowed = 1;
+  sample->seq = slot->seq;
+  sample->plist = slot->plist;
+  sample->serdata = slot->serdata;
+  sample->unacked = slot->unacked;
+  sample->rexmit_count = slot->rexmit_count;
+  sample->last_rexmit_ts = slot->last_rexmit_ts;
+}
+
+static bool whc_ring_borrow_sample (const struct whc *whc_generic, seqno_t seq, struct whc_borrowed_sample *sample)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  struct whc_ring_slot *slot;
+  bool found;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  if ((slot = whc_ring_findseq (whc, seq)) == NULL)
+    found = false;
+  else
+  {
+    make_borrowed_sample (sample, slot);
+    found = true;
+  }
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return found;
+}
+
+static bool whc_ring_borrow_sample_key (const struct whc *whc_generic, const struct ddsi_serdata *serdata_key, struct whc_borrowed_sample *sample)
+{
+  /* only used for transient-local writers, which never use this WHC */
+  (void) whc_generic;
+  (void) serdata_key;
+  (void) sample;
+  return false;
+}
+
+static void return_sample_locked (struct whc_ring *whc, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_ring_slot *slot;
+  if ((slot = whc_ring_findseq (whc, sample->seq)) == NULL)
+  {
+    /* data no longer present in WHC - that means ownership for serdata, plist shifted to the borrowed copy and "returning" it really becomes "destroying" it */
+    ddsi_serdata_unref (sample->serdata);
+    if (sample->plist)
+    {
+      ddsi_plist_fini (sample->plist);
+      ddsrt_free (sample->plist);
+    }
+  }
+  else
+  {
+    assert (slot->borrowed);
+    slot->borrowed = 0;
+    if (update_retransmit_info)
+    {
+      slot->rexmit_count = sample->rexmit_count;
+      slot->last_rexmit_ts = sample->last_rexmit_ts;
+    }
+  }
+}
+
+static void whc_ring_return_sample (struct whc *whc_generic, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  ddsrt_mutex_lock (&whc->lock);
+  return_sample_locked (whc, sample, update_retransmit_info);
+  ddsrt_mutex_unlock (&whc->lock);
+}
+
+static void whc_ring_sample_iter_init (const struct whc *whc_generic, struct whc_sample_iter *opaque_it)
+{
+  struct whc_ring_sample_iter *it = (struct whc_ring_sample_iter *) opaque_it;
+  it->c.whc = (struct whc *) whc_generic;
+  it->first = true;
+}
+
+static bool whc_ring_sample_iter_borrow_next (struct whc_sample_iter *opaque_it, struct whc_borrowed_sample *sample)
+{
+  struct whc_ring_sample_iter * const it = (struct whc_ring_sample_iter *) opaque_it;
+  struct whc_ring * const whc = (struct whc_ring *) it->c.whc;
+  seqno_t seq;
+  bool valid;
+  ddsrt_mutex_lock (&whc->lock);
+  check_whc_ring (whc);
+  if (!it->first)
+  {
+    seq = sample->seq;
+    return_sample_locked (whc, sample, false);
+  }
+  else
+  {
+    it->first = false;
+    seq = 0;
+  }
+  if ((seq = next_seq_locked (whc, seq)) == MAX_SEQ_NUMBER)
+    valid = false;
+  else
+  {
+    make_borrowed_sample (sample, whc_ring_slot (whc, seq));
+    valid = true;
+  }
+  ddsrt_mutex_unlock (&whc->lock);
+  return valid;
+}
+
+static uint32_t whc_ring_downgrade_to_volatile (struct whc *whc_generic, struct whc_state *st)
+{
+  /* never transient-local, so nothing to downgrade */
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  ddsrt_mutex_lock (&whc->lock);
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock (&whc->lock);
+  return 0;
+}
+
+static void whc_ring_free (struct whc *whc_generic)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  check_whc_ring (whc);
+  for (uint32_t i = 0; i <= whc->mask; i++)
+  {
+    struct whc_ring_slot * const slot = &whc->slots[i];
+    if (slot->seq == 0)
+      continue;
+    ddsi_serdata_unref (slot->serdata);
+    if (slot->plist)
+    {
+      ddsi_plist_fini (slot->plist);
+      ddsrt_free (slot->plist);
+    }
+  }
+  ddsrt_free (whc->slots);
+  ddsrt_mutex_destroy (&whc->lock);
+  ddsrt_free (whc);
+}
+
+static const struct whc_ops whc_ring_ops = {
+  .insert = whc_ring_insert,
+  .remove_acked_messages = whc_ring_remove_acked_messages,
+  .free_deferred_free_list = whc_ring_free_deferred_free_list,
+  .get_state = whc_ring_get_state,
+  .next_seq = whc_ring_next_seq,
+  .borrow_sample = whc_ring_borrow_sample,
+  .borrow_sample_key = whc_ring_borrow_sample_key,
+  .return_sample = whc_ring_return_sample,
+  .sample_iter_init = whc_ring_sample_iter_init,
+  .sample_iter_borrow_next = whc_ring_sample_iter_borrow_next,
+  .downgrade_to_volatile = whc_ring_downgrade_to_volatile,
+  .free = whc_ring_free
+};
+
+struct whc *whc_ring_new (struct ddsi_domaingv *gv)
+{
+  struct whc_ring *whc = ddsrt_malloc (sizeof (*whc));
+  whc->common.ops = &whc_ring_ops;
+  ddsrt_mutex_init (&whc->lock);
+  whc->gv = gv;
+  whc->sample_overhead = WHC_SAMPLE_OVERHEAD;
+  whc->fragment_size = gv->config.fragment_size;
+  whc->xchecks = (gv->config.enabled_xchecks & DDSI_XCHECK_WHC) != 0;
+  whc->mask = WHC_RING_INITIAL_SIZE - 1;
+  whc->count = 0;
+  whc->min_seq = whc->max_seq = 0;
+  whc->max_drop_seq = 0;
+  whc->unacked_bytes = 0;
+  whc->slots = ddsrt_malloc (WHC_RING_INITIAL_SIZE * sizeof (*whc->slots));
+  memset (whc->slots, 0, WHC_RING_INITIAL_SIZE * sizeof (*whc->slots));
+  return (struct whc *) whc;
+}
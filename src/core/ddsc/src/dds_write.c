@@ -11,6 +11,8 @@
  */
 #include <assert.h>
 #include <string.h>
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/hopscotch.h"
 #include "dds__writer.h"
 #include "dds__write.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -18,7 +20,9 @@
 #include "dds/ddsi/q_xmsg.h"
 #include "dds/ddsi/ddsi_rhc.h"
 #include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/ddsi_cdrstream.h"
+#include "dds/ddsi/ddsi_cdrfilter.h"
 #include "dds/ddsi/q_transmit.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/q_config.h"
@@ -26,6 +30,87 @@
 #include "dds/ddsi/q_radmin.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_deliver_locally.h"
+#include "dds/ddsi/ddsi_shm.h"
+
+dds_return_t dds_loan_sample (dds_entity_t writer, void **sample)
+{
+  dds_return_t ret;
+  dds_writer *wr;
+
+  if (sample == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return ret;
+  if (wr->m_wr->shm == NULL)
+    ret = DDS_RETCODE_UNSUPPORTED;
+  else if ((*sample = ddsi_shm_writer_loan (wr->m_wr->shm)) == NULL)
+    ret = DDS_RETCODE_OUT_OF_RESOURCES;
+  dds_writer_unlock (wr);
+  return ret;
+}
+
+static uint32_t loan_hash (const void *va)
+{
+  const uint64_t c = UINT64_C (16292676669999574021);
+  const uint64_t x = (uint64_t) (uintptr_t) va;
+  return (uint32_t) (((x >> 3) * c) >> 32);
+}
+
+static int loan_eq (const void *va, const void *vb)
+{
+  return va == vb;
+}
+
+static bool dds_writer_remove_loan (dds_writer *wr, const void *sample)
+{
+  return wr->m_loans != NULL && ddsrt_hh_remove (wr->m_loans, sample);
+}
+
+dds_return_t dds_request_loan (dds_entity_t writer, void **sample)
+{
+  const struct ddsi_sertype_default *st;
+  dds_return_t ret;
+  dds_writer *wr;
+
+  if (sample == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return ret;
+  st = (const struct ddsi_sertype_default *) wr->m_wr->type;
+  if (wr->m_wr->type->ops != &ddsi_sertype_ops_default || st->opt_size == 0)
+    ret = DDS_RETCODE_UNSUPPORTED;
+  else
+  {
+    if (wr->m_loan_pool == NULL)
+    {
+      wr->m_loan_pool = ddsi_serdatapool_new_loan (st);
+      wr->m_loans = ddsrt_hh_new (1, loan_hash, loan_eq);
+    }
+    *sample = ddsi_serdata_default_loan (wr->m_loan_pool, st);
+    ddsrt_hh_add (wr->m_loans, *sample);
+  }
+  dds_writer_unlock (wr);
+  return ret;
+}
+
+dds_return_t dds_writer_return_loan (struct dds_writer *wr, void **buf, int32_t bufsz)
+{
+  dds_return_t ret = DDS_RETCODE_OK;
+  ddsrt_mutex_lock (&wr->m_entity.m_mutex);
+  for (int32_t i = 0; i < bufsz && ret == DDS_RETCODE_OK; i++)
+  {
+    if (dds_writer_remove_loan (wr, buf[i]))
+      ddsi_serdata_default_return_loan (buf[i]);
+    else if (wr->m_wr->shm == NULL || !ddsi_shm_writer_return_loan (wr->m_wr->shm, buf[i]))
+      ret = DDS_RETCODE_BAD_PARAMETER;
+  }
+  ddsrt_mutex_unlock (&wr->m_entity.m_mutex);
+  if (ret == DDS_RETCODE_OK)
+    buf[0] = NULL;
+  return ret;
+}
 
 dds_return_t dds_write (dds_entity_t writer, const void *data)
 {
@@ -42,6 +127,26 @@ dds_return_t dds_write (dds_entity_t writer, const void *data)
   return ret;
 }
 
+/* Returns 1 if the sample passes the topic filter, 0 if it was filtered out (in which
+   case it has been consumed), or an error if the filter can't be applied */
+static dds_return_t dds_writecdr_filter (const dds_writer *wr, struct ddsi_serdata *serdata)
+{
+  switch (wr->m_topic->m_filter.mode)
+  {
+    case DDS_TOPIC_FILTER_NONE:
+      return 1;
+    case DDS_TOPIC_FILTER_EXPRESSION:
+      if (serdata->type != wr->m_topic->m_stype)
+        return DDS_RETCODE_ERROR;
+      if (ddsi_cdrfilter_eval (wr->m_topic->m_filter.arg, serdata))
+        return 1;
+      ddsi_serdata_unref (serdata);
+      return 0;
+    default:
+      return DDS_RETCODE_ERROR;
+  }
+}
+
 dds_return_t dds_writecdr (dds_entity_t writer, struct ddsi_serdata *serdata)
 {
   dds_return_t ret;
@@ -52,10 +157,10 @@ dds_return_t dds_writecdr (dds_entity_t writer, struct ddsi_serdata *serdata)
 
   if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
     return ret;
-  if (wr->m_topic->m_filter.mode != DDS_TOPIC_FILTER_NONE)
+  if ((ret = dds_writecdr_filter (wr, serdata)) <= 0)
   {
     dds_writer_unlock (wr);
-    return DDS_RETCODE_ERROR;
+    return ret;
   }
   serdata->statusinfo = 0;
   serdata->timestamp.v = dds_time ();
@@ -74,10 +179,10 @@ dds_return_t dds_forwardcdr (dds_entity_t writer, struct ddsi_serdata *serdata)
 
   if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
     return ret;
-  if (wr->m_topic->m_filter.mode != DDS_TOPIC_FILTER_NONE)
+  if ((ret = dds_writecdr_filter (wr, serdata)) <= 0)
   {
     dds_writer_unlock (wr);
-    return DDS_RETCODE_ERROR;
+    return ret;
   }
   ret = dds_writecdr_impl (wr->m_wr, wr->m_xp, serdata, !wr->whc_batch);
   dds_writer_unlock (wr);
@@ -194,6 +299,9 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
   if (data == NULL)
     return DDS_RETCODE_BAD_PARAMETER;
 
+  /* writing a sample obtained from dds_request_loan consumes the loan */
+  void *loan = dds_writer_remove_loan (wr, data) ? (void *) data : NULL;
+
   /* Check for topic filter */
   if (!writekey && wr->m_topic->m_filter.mode != DDS_TOPIC_FILTER_NONE)
   {
@@ -202,20 +310,21 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
     {
       case DDS_TOPIC_FILTER_NONE:
       case DDS_TOPIC_FILTER_SAMPLEINFO_ARG:
+      case DDS_TOPIC_FILTER_EXPRESSION: /* evaluated on the serialized sample */
         break;
       case DDS_TOPIC_FILTER_SAMPLE:
         if (!f->f.sample (data))
-          return DDS_RETCODE_OK;
+          goto filtered;
         break;
       case DDS_TOPIC_FILTER_SAMPLE_ARG:
         if (!f->f.sample_arg (data, f->arg))
-          return DDS_RETCODE_OK;
+          goto filtered;
         break;
       case DDS_TOPIC_FILTER_SAMPLE_SAMPLEINFO_ARG: {
         struct dds_sample_info si;
         memset (&si, 0, sizeof (si));
         if (!f->f.sample_sampleinfo_arg (data, &si, f->arg))
-          return DDS_RETCODE_OK;
+          goto filtered;
         break;
       }
     }
@@ -223,9 +332,20 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
 
   thread_state_awake (ts1, &wr->m_entity.m_domain->gv);
 
-  /* Serialize and write data or key */
-  if ((d = ddsi_serdata_from_sample (ddsi_wr->type, writekey ? SDK_KEY : SDK_DATA, data)) == NULL)
+  /* Serialize and write data or key; a loaned sample already is in serialized form */
+  if (loan && !writekey)
+  {
+    d = ddsi_serdata_default_from_loan ((const struct ddsi_sertype_default *) ddsi_wr->type, loan);
+    loan = NULL;
+  }
+  else
+  {
+    d = ddsi_serdata_from_sample (ddsi_wr->type, writekey ? SDK_KEY : SDK_DATA, data);
+  }
+  if (d == NULL)
     ret = DDS_RETCODE_BAD_PARAMETER;
+  else if (!writekey && wr->m_topic->m_filter.mode == DDS_TOPIC_FILTER_EXPRESSION && !ddsi_cdrfilter_eval (wr->m_topic->m_filter.arg, d))
+    ddsi_serdata_unref (d);
   else
   {
     struct ddsi_tkmap_instance *tk;
@@ -243,17 +363,30 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
       ret = DDS_RETCODE_OK;
     } else if (w_rc == DDS_RETCODE_TIMEOUT) {
       ret = DDS_RETCODE_TIMEOUT;
+    } else if (w_rc == DDS_RETCODE_OUT_OF_RESOURCES) {
+      ret = DDS_RETCODE_OUT_OF_RESOURCES;
     } else if (w_rc == DDS_RETCODE_BAD_PARAMETER) {
       ret = DDS_RETCODE_ERROR;
     } else {
       ret = DDS_RETCODE_ERROR;
     }
     if (ret == DDS_RETCODE_OK)
+    {
+      if (ddsi_wr->shm)
+        ddsi_shm_writer_publish (ddsi_wr->shm, d, data);
       ret = deliver_locally (ddsi_wr, d, tk);
+    }
     ddsi_serdata_unref (d);
     ddsi_tkmap_instance_unref (wr->m_entity.m_domain->gv.m_tkmap, tk);
   }
   thread_state_asleep (ts1);
+
+filtered:
+  /* writing a loaned sample always returns the loan */
+  if (loan)
+    ddsi_serdata_default_return_loan (loan);
+  else if (ddsi_wr->shm)
+    (void) ddsi_shm_writer_return_loan (ddsi_wr->shm, data);
   return ret;
 }
 
@@ -317,6 +450,8 @@ dds_return_t dds_writecdr_impl (struct writer *ddsi_wr, struct nn_xpack *xp, str
   {
     if (w_rc == DDS_RETCODE_TIMEOUT)
       ret = DDS_RETCODE_TIMEOUT;
+    else if (w_rc == DDS_RETCODE_OUT_OF_RESOURCES)
+      ret = DDS_RETCODE_OUT_OF_RESOURCES;
     else if (w_rc == DDS_RETCODE_BAD_PARAMETER)
       ret = DDS_RETCODE_ERROR;
     else
@@ -324,7 +459,11 @@ dds_return_t dds_writecdr_impl (struct writer *ddsi_wr, struct nn_xpack *xp, str
   }
 
   if (ret == DDS_RETCODE_OK)
+  {
+    if (ddsi_wr->shm)
+      ddsi_shm_writer_publish (ddsi_wr->shm, dact, NULL);
     ret = deliver_locally (ddsi_wr, dact, tk);
+  }
 
   // refc management at input is such that we must still consume a dinp
   // reference if it isn't identical to dact; doing it prior to dropping
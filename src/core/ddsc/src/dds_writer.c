@@ -13,6 +13,8 @@
 
 #include "dds/dds.h"
 #include "dds/version.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/hopscotch.h"
 #include "dds/ddsrt/static_assert.h"
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/ddsi_domaingv.h"
@@ -213,6 +215,14 @@ static dds_return_t dds_writer_delete (dds_entity *e)
   thread_state_awake (lookup_thread_state (), &e->m_domain->gv);
   nn_xpack_free (wr->m_xp);
   thread_state_asleep (lookup_thread_state ());
+  if (wr->m_loan_pool)
+  {
+    struct ddsrt_hh_iter it;
+    for (void *loan = ddsrt_hh_iter_first (wr->m_loans, &it); loan; loan = ddsrt_hh_iter_next (&it))
+      ddsi_serdata_default_return_loan (loan);
+    ddsrt_hh_free (wr->m_loans);
+    ddsi_serdatapool_release_loan (wr->m_loan_pool);
+  }
   dds_entity_drop_ref (&wr->m_topic->m_entity);
   return DDS_RETCODE_OK;
 }
@@ -254,7 +264,8 @@ static const struct dds_stat_keyvalue_descriptor dds_writer_statistics_kv[] = {
   { "rexmit_bytes", DDS_STAT_KIND_UINT64 },
   { "throttle_count", DDS_STAT_KIND_UINT32 },
   { "time_throttle", DDS_STAT_KIND_UINT64 },
-  { "time_rexmit", DDS_STAT_KIND_UINT64 }
+  { "time_rexmit", DDS_STAT_KIND_UINT64 },
+  { "unacked_bytes", DDS_STAT_KIND_UINT64 }
 };
 
 static const struct dds_stat_descriptor dds_writer_statistics_desc = {
@@ -271,7 +282,7 @@ static void dds_writer_refresh_statistics (const struct dds_entity *entity, stru
 {
   const struct dds_writer *wr = (const struct dds_writer *) entity;
   if (wr->m_wr)
-    ddsi_get_writer_stats (wr->m_wr, &stat->kv[0].u.u64, &stat->kv[1].u.u32, &stat->kv[2].u.u64, &stat->kv[3].u.u64);
+    ddsi_get_writer_stats (wr->m_wr, &stat->kv[0].u.u64, &stat->kv[1].u.u32, &stat->kv[2].u.u64, &stat->kv[3].u.u64, &stat->kv[4].u.u64);
 }
 
 const struct dds_entity_deriver dds_entity_deriver_writer = {
@@ -22,8 +22,10 @@
 #include "dds/dds.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_sertopic.h" // for backwards compat tests
+#include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/q_radmin.h"
 #include "dds__entity.h"
+#include "dds__topic.h"
 
 #include "test_common.h"
 
@@ -1179,3 +1181,377 @@ CU_Test(ddsc_cdr_sertopic, timeout)
 {
   cdr_timeout (&gops0);
 }
+
+/*----------------------------------------------------------------
+ *
+ * copy plan: memcpy'ing runs of fields in the default sertype
+ *
+ *----------------------------------------------------------------*/
+
+/* Types that can't be memcpy'd as a whole but that have runs of fields laid out
+   like in CDR, broken up by strings, sequences and padding; written by hand for
+   control over the layout.  The memory gets filled with 0xff before the fields
+   are set, so that padding that isn't cleared in the output shows up. */
+struct cp_a {
+  uint8_t a;
+  uint32_t b;
+  uint16_t c;
+  char *s;
+  uint8_t d;
+  uint64_t e;
+  uint16_t f[3];
+  char *t;
+  uint32_t g;
+  uint8_t h[5];
+};
+
+static const dds_topic_descriptor_t cp_a_desc =
+{
+  .m_size = sizeof (struct cp_a),
+  .m_align = sizeof (void *),
+  .m_flagset = DDS_TOPIC_NO_OPTIMIZE,
+  .m_nkeys = 0,
+  .m_typename = "ddsc_cdr_cp_a",
+  .m_keys = NULL,
+  .m_nops = 11,
+  .m_ops = (const uint32_t[]) {
+    DDS_OP_ADR | DDS_OP_TYPE_1BY, offsetof (struct cp_a, a),
+    DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_a, b),
+    DDS_OP_ADR | DDS_OP_TYPE_2BY, offsetof (struct cp_a, c),
+    DDS_OP_ADR | DDS_OP_TYPE_STR, offsetof (struct cp_a, s),
+    DDS_OP_ADR | DDS_OP_TYPE_1BY, offsetof (struct cp_a, d),
+    DDS_OP_ADR | DDS_OP_TYPE_8BY, offsetof (struct cp_a, e),
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_2BY, offsetof (struct cp_a, f), 3,
+    DDS_OP_ADR | DDS_OP_TYPE_STR, offsetof (struct cp_a, t),
+    DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_a, g),
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_1BY, offsetof (struct cp_a, h), 5,
+    DDS_OP_RTS
+  },
+  .m_meta = ""
+};
+
+struct cp_pt {
+  uint32_t x;
+  uint16_t y;
+};
+
+struct cp_pr {
+  int32_t x;
+  int32_t y;
+};
+
+struct cp_pt_seq {
+  uint32_t _maximum;
+  uint32_t _length;
+  struct cp_pt *_buffer;
+  bool _release;
+};
+
+struct cp_pr_seq {
+  uint32_t _maximum;
+  uint32_t _length;
+  struct cp_pr *_buffer;
+  bool _release;
+};
+
+struct cp_u16_seq {
+  uint32_t _maximum;
+  uint32_t _length;
+  uint16_t *_buffer;
+  bool _release;
+};
+
+struct cp_b {
+  uint16_t n;
+  struct cp_pt_seq pts; /* elements have trailing padding: copied one by one */
+  uint32_t m;
+  struct cp_pr_seq prs; /* elements without padding: copied in one go */
+  struct cp_u16_seq us;
+  uint8_t k;
+  struct cp_pr pra[2]; /* part of the run starting at k */
+  struct cp_pt pta[2];
+  uint8_t z;
+};
+
+static const dds_topic_descriptor_t cp_b_desc =
+{
+  .m_size = sizeof (struct cp_b),
+  .m_align = sizeof (void *),
+  .m_flagset = DDS_TOPIC_NO_OPTIMIZE,
+  .m_nkeys = 0,
+  .m_typename = "ddsc_cdr_cp_b",
+  .m_keys = NULL,
+  .m_nops = 22,
+  .m_ops = (const uint32_t[]) {
+    DDS_OP_ADR | DDS_OP_TYPE_2BY, offsetof (struct cp_b, n),
+    DDS_OP_ADR | DDS_OP_TYPE_SEQ | DDS_OP_SUBTYPE_STU, offsetof (struct cp_b, pts), sizeof (struct cp_pt), (9u << 16) + 4u,
+      DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_pt, x),
+      DDS_OP_ADR | DDS_OP_TYPE_2BY, offsetof (struct cp_pt, y),
+      DDS_OP_RTS,
+    DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_b, m),
+    DDS_OP_ADR | DDS_OP_TYPE_SEQ | DDS_OP_SUBTYPE_STU, offsetof (struct cp_b, prs), sizeof (struct cp_pr), (9u << 16) + 4u,
+      DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_pr, x),
+      DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_pr, y),
+      DDS_OP_RTS,
+    DDS_OP_ADR | DDS_OP_TYPE_SEQ | DDS_OP_SUBTYPE_2BY, offsetof (struct cp_b, us),
+    DDS_OP_ADR | DDS_OP_TYPE_1BY, offsetof (struct cp_b, k),
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_STU, offsetof (struct cp_b, pra), 2, (10u << 16) + 5u, sizeof (struct cp_pr),
+      DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_pr, x),
+      DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_pr, y),
+      DDS_OP_RTS,
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_STU, offsetof (struct cp_b, pta), 2, (10u << 16) + 5u, sizeof (struct cp_pt),
+      DDS_OP_ADR | DDS_OP_TYPE_4BY, offsetof (struct cp_pt, x),
+      DDS_OP_ADR | DDS_OP_TYPE_2BY, offsetof (struct cp_pt, y),
+      DDS_OP_RTS,
+    DDS_OP_ADR | DDS_OP_TYPE_1BY, offsetof (struct cp_b, z),
+    DDS_OP_RTS
+  },
+  .m_meta = ""
+};
+
+/* Reference CDR encoder: a CDR header followed by the fields in either byte order */
+struct cp_cdr {
+  unsigned char buf[1024];
+  uint32_t pos;
+  bool bswap;
+};
+
+static void cp_cdr_init (struct cp_cdr *cdr, bool bswap)
+{
+  const bool le = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) != bswap;
+  memset (cdr->buf, 0, sizeof (cdr->buf));
+  cdr->buf[1] = le ? 1 : 0;
+  cdr->pos = 0;
+  cdr->bswap = bswap;
+}
+
+static void cp_cdr_put (struct cp_cdr *cdr, const void *v, uint32_t sz)
+{
+  const unsigned char *p = v;
+  cdr->pos = (cdr->pos + sz - 1) & ~(sz - 1);
+  CU_ASSERT_FATAL (4 + cdr->pos + sz <= sizeof (cdr->buf));
+  for (uint32_t i = 0; i < sz; i++)
+    cdr->buf[4 + cdr->pos + i] = p[cdr->bswap ? sz - 1 - i : i];
+  cdr->pos += sz;
+}
+
+/* DDSI requires a multiple of 4 bytes, the padding goes in the options */
+static void cp_cdr_fini (struct cp_cdr *cdr)
+{
+  const uint32_t pad = (4 - (cdr->pos % 4)) % 4;
+  cdr->buf[3] = (unsigned char) pad;
+  cdr->pos += pad;
+}
+
+static void cp_cdr_put_string (struct cp_cdr *cdr, const char *s)
+{
+  const uint32_t len = (uint32_t) strlen (s) + 1;
+  cp_cdr_put (cdr, &len, 4);
+  CU_ASSERT_FATAL (4 + cdr->pos + len <= sizeof (cdr->buf));
+  memcpy (cdr->buf + 4 + cdr->pos, s, len);
+  cdr->pos += len;
+}
+
+static void cp_a_ser (struct cp_cdr *cdr, const void *sample)
+{
+  const struct cp_a *x = sample;
+  cp_cdr_put (cdr, &x->a, 1);
+  cp_cdr_put (cdr, &x->b, 4);
+  cp_cdr_put (cdr, &x->c, 2);
+  cp_cdr_put_string (cdr, x->s);
+  cp_cdr_put (cdr, &x->d, 1);
+  cp_cdr_put (cdr, &x->e, 8);
+  for (int i = 0; i < 3; i++)
+    cp_cdr_put (cdr, &x->f[i], 2);
+  cp_cdr_put_string (cdr, x->t);
+  cp_cdr_put (cdr, &x->g, 4);
+  for (int i = 0; i < 5; i++)
+    cp_cdr_put (cdr, &x->h[i], 1);
+}
+
+static bool cp_a_eq (const void *va, const void *vb)
+{
+  const struct cp_a *a = va, *b = vb;
+  return (a->a == b->a && a->b == b->b && a->c == b->c && strcmp (a->s, b->s) == 0 &&
+          a->d == b->d && a->e == b->e && memcmp (a->f, b->f, sizeof (a->f)) == 0 &&
+          strcmp (a->t, b->t) == 0 && a->g == b->g && memcmp (a->h, b->h, sizeof (a->h)) == 0);
+}
+
+static void cp_b_ser (struct cp_cdr *cdr, const void *sample)
+{
+  const struct cp_b *x = sample;
+  cp_cdr_put (cdr, &x->n, 2);
+  cp_cdr_put (cdr, &x->pts._length, 4);
+  for (uint32_t i = 0; i < x->pts._length; i++)
+  {
+    cp_cdr_put (cdr, &x->pts._buffer[i].x, 4);
+    cp_cdr_put (cdr, &x->pts._buffer[i].y, 2);
+  }
+  cp_cdr_put (cdr, &x->m, 4);
+  cp_cdr_put (cdr, &x->prs._length, 4);
+  for (uint32_t i = 0; i < x->prs._length; i++)
+  {
+    cp_cdr_put (cdr, &x->prs._buffer[i].x, 4);
+    cp_cdr_put (cdr, &x->prs._buffer[i].y, 4);
+  }
+  cp_cdr_put (cdr, &x->us._length, 4);
+  for (uint32_t i = 0; i < x->us._length; i++)
+    cp_cdr_put (cdr, &x->us._buffer[i], 2);
+  cp_cdr_put (cdr, &x->k, 1);
+  for (int i = 0; i < 2; i++)
+  {
+    cp_cdr_put (cdr, &x->pra[i].x, 4);
+    cp_cdr_put (cdr, &x->pra[i].y, 4);
+  }
+  for (int i = 0; i < 2; i++)
+  {
+    cp_cdr_put (cdr, &x->pta[i].x, 4);
+    cp_cdr_put (cdr, &x->pta[i].y, 2);
+  }
+  cp_cdr_put (cdr, &x->z, 1);
+}
+
+static bool cp_b_eq (const void *va, const void *vb)
+{
+  const struct cp_b *a = va, *b = vb;
+  if (a->n != b->n || a->m != b->m || a->k != b->k || a->z != b->z)
+    return false;
+  if (a->pts._length != b->pts._length || a->prs._length != b->prs._length || a->us._length != b->us._length)
+    return false;
+  for (uint32_t i = 0; i < a->pts._length; i++)
+    if (a->pts._buffer[i].x != b->pts._buffer[i].x || a->pts._buffer[i].y != b->pts._buffer[i].y)
+      return false;
+  for (uint32_t i = 0; i < a->prs._length; i++)
+    if (a->prs._buffer[i].x != b->prs._buffer[i].x || a->prs._buffer[i].y != b->prs._buffer[i].y)
+      return false;
+  for (uint32_t i = 0; i < a->us._length; i++)
+    if (a->us._buffer[i] != b->us._buffer[i])
+      return false;
+  for (int i = 0; i < 2; i++)
+    if (a->pra[i].x != b->pra[i].x || a->pra[i].y != b->pra[i].y || a->pta[i].x != b->pta[i].x || a->pta[i].y != b->pta[i].y)
+      return false;
+  return true;
+}
+
+static void cdr_copy_plan (const dds_topic_descriptor_t *desc, void (*ser) (struct cp_cdr *cdr, const void *sample), bool (*eq) (const void *a, const void *b), const void *samples, size_t nsamples)
+{
+  dds_return_t rc;
+  char topicname[100];
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  create_unique_topic_name ("ddsc_cdr_copy_plan", topicname, sizeof topicname);
+  const dds_entity_t tp = dds_create_topic (pp, desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  struct dds_topic *x;
+  rc = dds_topic_pin (tp, &x);
+  CU_ASSERT_FATAL (rc == 0);
+  struct ddsi_sertype_default * const stp = (struct ddsi_sertype_default *) x->m_stype;
+  CU_ASSERT_FATAL (stp->opt_size == 0);
+  struct dds_stream_copy_op * const plan = stp->copy_plan;
+  CU_ASSERT_FATAL (plan != NULL);
+
+  void *out = ddsrt_malloc (desc->m_size);
+  for (size_t i = 0; i < nsamples; i++)
+  {
+    const void *sample = (const char *) samples + i * desc->m_size;
+    struct cp_cdr ref[2];
+    cp_cdr_init (&ref[0], false);
+    ser (&ref[0], sample);
+    cp_cdr_fini (&ref[0]);
+    cp_cdr_init (&ref[1], true);
+    ser (&ref[1], sample);
+    cp_cdr_fini (&ref[1]);
+
+    /* serializing: plan and interpreter must both give the reference */
+    for (int p = 0; p < 2; p++)
+    {
+      stp->copy_plan = (p == 0) ? plan : NULL;
+      struct ddsi_serdata *sd = ddsi_serdata_from_sample (&stp->c, SDK_DATA, sample);
+      CU_ASSERT_FATAL (sd != NULL);
+      const uint32_t sz = ddsi_serdata_size (sd);
+      CU_ASSERT_FATAL (sz == 4 + ref[0].pos);
+      unsigned char buf[sizeof (ref[0].buf)];
+      ddsi_serdata_to_ser (sd, 0, sz, buf);
+      CU_ASSERT (memcmp (buf, ref[0].buf, sz) == 0);
+      ddsi_serdata_unref (sd);
+    }
+
+    /* deserializing native and byte-swapped input, with and without plan */
+    for (int e = 0; e < 2; e++)
+    {
+      ddsrt_iovec_t iov = { .iov_base = ref[e].buf, .iov_len = (ddsrt_iov_len_t) (4 + ref[e].pos) };
+      stp->copy_plan = plan;
+      struct ddsi_serdata *sd = ddsi_serdata_from_ser_iov (&stp->c, SDK_DATA, 1, &iov, 4 + ref[e].pos);
+      CU_ASSERT_FATAL (sd != NULL);
+      for (int p = 0; p < 2; p++)
+      {
+        stp->copy_plan = (p == 0) ? plan : NULL;
+        memset (out, 0, desc->m_size);
+        CU_ASSERT_FATAL (ddsi_serdata_to_sample (sd, out, NULL, NULL));
+        CU_ASSERT (eq (out, sample));
+        ddsi_sertype_free_sample (&stp->c, out, DDS_FREE_CONTENTS);
+      }
+      ddsi_serdata_unref (sd);
+    }
+  }
+  stp->copy_plan = plan;
+  ddsrt_free (out);
+  dds_topic_unpin (x);
+  rc = dds_delete (pp);
+  CU_ASSERT_FATAL (rc == 0);
+}
+
+CU_Test(ddsc_cdr, copy_plan_runs)
+{
+  /* string lengths chosen such that the run following "s" is at the right
+     offset modulo 8 for copying it in some cases and not in others */
+  static const char *strs[] = { "", "abc", "abcdefg", "abcdefghijklmno" };
+  struct cp_a xs[4];
+  memset (xs, 0xff, sizeof (xs));
+  for (size_t i = 0; i < sizeof (xs) / sizeof (xs[0]); i++)
+  {
+    xs[i].a = (uint8_t) (1 + i);
+    xs[i].b = 0x01020304u + (uint32_t) i;
+    xs[i].c = (uint16_t) (0x0506 + i);
+    xs[i].s = (char *) strs[i];
+    xs[i].d = (uint8_t) (7 + i);
+    xs[i].e = UINT64_C (0x08090a0b0c0d0e0f) + i;
+    for (uint32_t j = 0; j < 3; j++)
+      xs[i].f[j] = (uint16_t) (0x1011 + 0x100 * j + i);
+    xs[i].t = (char *) strs[(i + 1) % 4];
+    xs[i].g = 0x12131415u + (uint32_t) i;
+    for (uint32_t j = 0; j < 5; j++)
+      xs[i].h[j] = (uint8_t) (0x16 + j + i);
+  }
+  cdr_copy_plan (&cp_a_desc, cp_a_ser, cp_a_eq, xs, sizeof (xs) / sizeof (xs[0]));
+}
+
+CU_Test(ddsc_cdr, copy_plan_sequences)
+{
+  struct cp_pt pts[] = { { 0x01020304, 0x0506 }, { 0x0708090a, 0x0b0c }, { 0x0d0e0f10, 0x1112 } };
+  struct cp_pr prs[] = { { 0x13141516, -0x1718191a }, { -0x1b1c1d1e, 0x1f202122 } };
+  uint16_t us[] = { 0x2324, 0x2526, 0x2728 };
+  /* sequence lengths chosen to get all combinations of alignments of the elements
+     and the fields following them */
+  static const uint32_t lens[][3] = { { 0, 0, 0 }, { 1, 1, 1 }, { 3, 2, 2 }, { 2, 0, 3 }, { 0, 2, 1 } };
+  struct cp_b xs[sizeof (lens) / sizeof (lens[0])];
+  memset (xs, 0xff, sizeof (xs));
+  for (size_t i = 0; i < sizeof (xs) / sizeof (xs[0]); i++)
+  {
+    xs[i].n = (uint16_t) (0x2930 + i);
+    xs[i].pts = (struct cp_pt_seq) { ._maximum = lens[i][0], ._length = lens[i][0], ._buffer = pts, ._release = false };
+    xs[i].m = 0x31323334u + (uint32_t) i;
+    xs[i].prs = (struct cp_pr_seq) { ._maximum = lens[i][1], ._length = lens[i][1], ._buffer = prs, ._release = false };
+    xs[i].us = (struct cp_u16_seq) { ._maximum = lens[i][2], ._length = lens[i][2], ._buffer = us, ._release = false };
+    xs[i].k = (uint8_t) (0x35 + i);
+    for (int j = 0; j < 2; j++)
+    {
+      xs[i].pra[j].x = 0x36373839 + j;
+      xs[i].pra[j].y = -0x3a3b3c3d - j;
+      xs[i].pta[j].x = 0x3e3f4041u + (uint32_t) j;
+      xs[i].pta[j].y = (uint16_t) (0x4243 + i);
+    }
+    xs[i].z = (uint8_t) (0x44 + i);
+  }
+  cdr_copy_plan (&cp_b_desc, cp_b_ser, cp_b_eq, xs, sizeof (xs) / sizeof (xs[0]));
+}
@@ -0,0 +1,388 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/string.h"
+
+#include "test_common.h"
+
+/* Tests for the history of TRANSIENT and PERSISTENT writers kept in the durable
+   store (Durability/StoreDirectory).  Every test uses a store directory of its
+   own, so that whatever a test leaves behind can't affect the others. */
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+#define DDS_CONFIG_DURABLE "<Durability><StoreDirectory>%s</StoreDirectory><SyncPolicy>%s</SyncPolicy><SegmentSize>%"PRIu32" B</SegmentSize></Durability>"
+
+/* A segment file starts with a 16-byte header, a Space_Type1 sample takes 56 bytes:
+   a 40-byte record header, the 4-byte CDR header and 12 bytes of data */
+#define SEGMENT_SIZE 1024u
+#define SEGMENT_HEADER_SIZE 16u
+#define RECORD_HEADER_SIZE 40u
+#define RECORD_SIZE 56u
+#define RECORDS_PER_SEGMENT ((int32_t) ((SEGMENT_SIZE - SEGMENT_HEADER_SIZE) / RECORD_SIZE))
+
+struct durable {
+  char store[100];
+  char topic_name[100];
+  const char *sync;
+  dds_entity_t domain;
+  dds_entity_t participant;
+  dds_entity_t topic;
+  dds_entity_t writer;
+};
+
+static void durable_init (struct durable *x, const char *sync)
+{
+  create_unique_topic_name ("ddsc_durable_store", x->store, sizeof (x->store));
+  create_unique_topic_name ("ddsc_durable_test", x->topic_name, sizeof (x->topic_name));
+  x->sync = sync;
+  x->domain = x->participant = x->topic = x->writer = 0;
+}
+
+static void remove_store (const char *path)
+{
+  DIR *dir;
+  struct dirent *de;
+  if ((dir = opendir (path)) != NULL)
+  {
+    while ((de = readdir (dir)) != NULL)
+    {
+      char *sub;
+      if (strcmp (de->d_name, ".") == 0 || strcmp (de->d_name, "..") == 0)
+        continue;
+      (void) ddsrt_asprintf (&sub, "%s/%s", path, de->d_name);
+      remove_store (sub);
+      ddsrt_free (sub);
+    }
+    (void) closedir (dir);
+    (void) rmdir (path);
+  }
+  else
+  {
+    (void) unlink (path);
+  }
+}
+
+static void durable_fini (struct durable *x)
+{
+  if (x->domain > 0)
+    dds_delete (x->domain);
+  remove_store (x->store);
+}
+
+static dds_qos_t *durable_qos (dds_durability_kind_t kind, int32_t depth)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  CU_ASSERT_FATAL (qos != NULL);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_durability (qos, kind);
+  dds_qset_durability_service (qos, 0, (depth == 0) ? DDS_HISTORY_KEEP_ALL : DDS_HISTORY_KEEP_LAST, depth, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED);
+  return qos;
+}
+
+/* Starts the domain and creates the writer, which recovers the history from the
+   store; "start" and "stop" form a process restart as far as the store is concerned */
+static dds_entity_t durable_create_domain (const struct durable *x, dds_domainid_t domainid)
+{
+  /* PERSISTENT readers get the history only if the durable store is configured
+     in their domain, too */
+  char config[600];
+  (void) snprintf (config, sizeof (config), "%s" DDS_CONFIG_DURABLE, DDS_CONFIG_NO_PORT_GAIN, x->store, x->sync, SEGMENT_SIZE);
+  char *conf = ddsrt_expand_envvars (config, domainid);
+  dds_entity_t domain = dds_create_domain (domainid, conf);
+  CU_ASSERT_FATAL (domain > 0);
+  dds_free (conf);
+  return domain;
+}
+
+static void durable_start (struct durable *x, dds_durability_kind_t kind, int32_t depth)
+{
+  x->domain = durable_create_domain (x, DDS_DOMAINID_PUB);
+  x->participant = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (x->participant > 0);
+  x->topic = dds_create_topic (x->participant, &Space_Type1_desc, x->topic_name, NULL, NULL);
+  CU_ASSERT_FATAL (x->topic > 0);
+  dds_qos_t *qos = durable_qos (kind, depth);
+  x->writer = dds_create_writer (x->participant, x->topic, qos, NULL);
+  CU_ASSERT_FATAL (x->writer > 0);
+  dds_delete_qos (qos);
+}
+
+static void durable_stop (struct durable *x)
+{
+  dds_return_t ret = dds_delete (x->domain);
+  CU_ASSERT_FATAL (ret == 0);
+  x->domain = 0;
+}
+
+static void durable_write (struct durable *x, int32_t key, int32_t value)
+{
+  const Space_Type1 sample = { key, value, 0 };
+  dds_return_t ret = dds_write (x->writer, &sample);
+  CU_ASSERT_FATAL (ret == 0);
+}
+
+/* Creates a late-joining reader and returns the samples it receives in "buf",
+   waiting until it has "expected" samples (or for a short while if 0) */
+static int32_t durable_late_joiner (dds_entity_t participant, const char *topic_name, dds_durability_kind_t kind, int32_t expected, Space_Type1 *buf, int32_t bufsize)
+{
+  dds_entity_t tp = dds_create_topic (participant, &Space_Type1_desc, topic_name, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_qos_t *qos = durable_qos (kind, 0);
+  dds_entity_t rd = dds_create_reader (participant, tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+
+  int32_t n = 0;
+  dds_time_t tend = dds_time () + (expected > 0 ? DDS_SECS (10) : DDS_MSECS (500));
+  while ((expected == 0 || n < expected) && dds_time () < tend)
+  {
+    Space_Type1 s;
+    void *raw = &s;
+    dds_sample_info_t si;
+    dds_return_t ret = dds_take (rd, &raw, &si, 1, 1);
+    CU_ASSERT_FATAL (ret >= 0);
+    if (ret == 0)
+      dds_sleepfor (DDS_MSECS (10));
+    else if (si.valid_data)
+    {
+      CU_ASSERT_FATAL (n < bufsize);
+      buf[n++] = s;
+    }
+  }
+  dds_delete (rd);
+  return n;
+}
+
+/* Checks that "buf" contains the KEEP_LAST(depth) history of ninst instances after
+   writing 0 .. nwritten-1 to instance i % ninst, in order for each instance */
+static void check_keep_last (const Space_Type1 *buf, int32_t n, int32_t ninst, int32_t depth, int32_t nwritten)
+{
+  CU_ASSERT_FATAL (n == ninst * depth);
+  for (int32_t i = 0; i < n; i++)
+  {
+    CU_ASSERT (buf[i].long_2 >= nwritten - ninst * depth && buf[i].long_2 < nwritten);
+    CU_ASSERT (buf[i].long_1 == buf[i].long_2 % ninst);
+    for (int32_t j = 0; j < i; j++)
+      CU_ASSERT (buf[j].long_1 != buf[i].long_1 || buf[j].long_2 < buf[i].long_2);
+  }
+}
+
+CU_TheoryDataPoints(ddsc_durable, persistent_restart) = {
+  CU_DataPoints(const char *, "none", "segment", "write"),
+};
+
+CU_Theory((const char *sync), ddsc_durable, persistent_restart, .timeout = 60)
+{
+  const int32_t ninst = 3, nsamples = 40, depth = 2;
+  Space_Type1 buf[100];
+  struct durable x;
+  int32_t n;
+  durable_init (&x, sync);
+
+  /* enough samples to span several segments, which also causes compaction */
+  durable_start (&x, DDS_DURABILITY_PERSISTENT, depth);
+  for (int32_t i = 0; i < nsamples; i++)
+    durable_write (&x, i % ninst, i);
+  n = durable_late_joiner (x.participant, x.topic_name, DDS_DURABILITY_PERSISTENT, ninst * depth, buf, 100);
+  check_keep_last (buf, n, ninst, depth, nsamples);
+  durable_stop (&x);
+
+  /* after a restart, the history is still there, for local and remote late joiners */
+  durable_start (&x, DDS_DURABILITY_PERSISTENT, depth);
+  n = durable_late_joiner (x.participant, x.topic_name, DDS_DURABILITY_PERSISTENT, ninst * depth, buf, 100);
+  check_keep_last (buf, n, ninst, depth, nsamples);
+
+  dds_entity_t remote_domain = durable_create_domain (&x, DDS_DOMAINID_SUB);
+  dds_entity_t remote_participant = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (remote_participant > 0);
+  n = durable_late_joiner (remote_participant, x.topic_name, DDS_DURABILITY_PERSISTENT, ninst * depth, buf, 100);
+  check_keep_last (buf, n, ninst, depth, nsamples);
+  dds_delete (remote_domain);
+
+  /* writing continues where it left off, replacing the oldest sample of the instance */
+  durable_write (&x, nsamples % ninst, nsamples);
+  durable_stop (&x);
+  durable_start (&x, DDS_DURABILITY_PERSISTENT, depth);
+  n = durable_late_joiner (x.participant, x.topic_name, DDS_DURABILITY_PERSISTENT, ninst * depth, buf, 100);
+  check_keep_last (buf, n, ninst, depth, nsamples + 1);
+  durable_fini (&x);
+}
+
+CU_Test(ddsc_durable, transient_restart, .timeout = 30)
+{
+  Space_Type1 buf[10];
+  struct durable x;
+  int32_t n;
+  durable_init (&x, "write");
+
+  durable_start (&x, DDS_DURABILITY_TRANSIENT, 0);
+  for (int32_t i = 0; i < 5; i++)
+    durable_write (&x, i, i);
+  n = durable_late_joiner (x.participant, x.topic_name, DDS_DURABILITY_TRANSIENT, 5, buf, 10);
+  CU_ASSERT_FATAL (n == 5);
+  durable_stop (&x);
+
+  /* TRANSIENT data doesn't outlive the writer, and the files are gone as well */
+  DIR *dir = opendir (x.store);
+  CU_ASSERT_FATAL (dir != NULL);
+  struct dirent *de;
+  while ((de = readdir (dir)) != NULL)
+    CU_ASSERT (strcmp (de->d_name, ".") == 0 || strcmp (de->d_name, "..") == 0);
+  (void) closedir (dir);
+  durable_start (&x, DDS_DURABILITY_TRANSIENT, 0);
+  n = durable_late_joiner (x.participant, x.topic_name, DDS_DURABILITY_TRANSIENT, 0, buf, 10);
+  CU_ASSERT (n == 0);
+  durable_fini (&x);
+}
+
+/* Returns the segment files of the (only) writer in the store, in the order of
+   their numbers, which is also the order in which they were created */
+static int32_t list_segments (const struct durable *x, char **paths, int32_t maxpaths)
+{
+  DIR *dir, *wrdir;
+  struct dirent *de;
+  char *wrpath = NULL;
+  int32_t n = 0;
+  dir = opendir (x->store);
+  CU_ASSERT_FATAL (dir != NULL);
+  while ((de = readdir (dir)) != NULL)
+  {
+    if (strcmp (de->d_name, ".") != 0 && strcmp (de->d_name, "..") != 0)
+    {
+      CU_ASSERT_FATAL (wrpath == NULL);
+      (void) ddsrt_asprintf (&wrpath, "%s/%s", x->store, de->d_name);
+    }
+  }
+  (void) closedir (dir);
+  CU_ASSERT_FATAL (wrpath != NULL);
+  wrdir = opendir (wrpath);
+  CU_ASSERT_FATAL (wrdir != NULL);
+  while ((de = readdir (wrdir)) != NULL)
+  {
+    const size_t len = strlen (de->d_name);
+    if (len > 4 && strcmp (de->d_name + len - 4, ".seg") == 0)
+    {
+      CU_ASSERT_FATAL (n < maxpaths);
+      (void) ddsrt_asprintf (&paths[n++], "%s/%s", wrpath, de->d_name);
+    }
+  }
+  (void) closedir (wrdir);
+  ddsrt_free (wrpath);
+  for (int32_t i = 1; i < n; i++)
+  {
+    for (int32_t j = i; j > 0 && strcmp (paths[j - 1], paths[j]) > 0; j--)
+    {
+      char *tmp = paths[j]; paths[j] = paths[j - 1]; paths[j - 1] = tmp;
+    }
+  }
+  return n;
+}
+
+static void overwrite_file (const char *path, off_t off, const void *data, size_t size)
+{
+  int fd = open (path, O_RDWR);
+  CU_ASSERT_FATAL (fd >= 0);
+  CU_ASSERT_FATAL (pwrite (fd, data, size, off) == (ssize_t) size);
+  (void) close (fd);
+}
+
+/* Writes samples with values 0 .. nsamples-1 to a single instance, with nothing
+   ever dropped from the history so that the files are filled in order */
+static int32_t fill_store (struct durable *x, int32_t nsamples, char **segs, int32_t maxsegs)
+{
+  durable_start (x, DDS_DURABILITY_PERSISTENT, 0);
+  for (int32_t i = 0; i < nsamples; i++)
+    durable_write (x, 0, i);
+  durable_stop (x);
+  return list_segments (x, segs, maxsegs);
+}
+
+/* After recovery from a damaged store, whatever is left is the history, in the
+   original order, and the writer can continue writing */
+static void check_recovered (struct durable *x, int32_t nsamples, int32_t minlost)
+{
+  Space_Type1 buf[200];
+  int32_t n;
+  durable_start (x, DDS_DURABILITY_PERSISTENT, 0);
+  n = durable_late_joiner (x->participant, x->topic_name, DDS_DURABILITY_PERSISTENT, 0, buf, 200);
+  printf ("recovered %"PRId32" of %"PRId32" samples\n", n, nsamples);
+  CU_ASSERT (n > 0 && n <= nsamples - minlost);
+  CU_ASSERT (n > 0 && buf[n - 1].long_2 == nsamples - 1);
+  for (int32_t i = 0; i + 1 < n; i++)
+    CU_ASSERT (buf[i].long_2 < buf[i + 1].long_2);
+  durable_write (x, 0, nsamples);
+  durable_stop (x);
+  durable_start (x, DDS_DURABILITY_PERSISTENT, 0);
+  n = durable_late_joiner (x->participant, x->topic_name, DDS_DURABILITY_PERSISTENT, 0, buf, 200);
+  CU_ASSERT (n > 0 && buf[n - 1].long_2 == nsamples);
+  durable_stop (x);
+}
+
+CU_Test(ddsc_durable, recover_truncated, .timeout = 30)
+{
+  const int32_t nsamples = 60;
+  char *segs[20];
+  struct durable x;
+  int32_t nsegs;
+  durable_init (&x, "write");
+  nsegs = fill_store (&x, nsamples, segs, 20);
+  CU_ASSERT_FATAL (nsegs >= 3);
+
+  /* cut the first file halfway: the samples in the remaining half are lost, those
+     in the other files aren't */
+  CU_ASSERT_FATAL (truncate (segs[0], SEGMENT_SIZE / 2) == 0);
+  /* a file that doesn't even have a complete header is ignored altogether */
+  CU_ASSERT_FATAL (truncate (segs[1], 4) == 0);
+  check_recovered (&x, nsamples, RECORDS_PER_SEGMENT - (int32_t) ((SEGMENT_SIZE / 2 - SEGMENT_HEADER_SIZE) / RECORD_SIZE) + RECORDS_PER_SEGMENT);
+  for (int32_t i = 0; i < nsegs; i++)
+    ddsrt_free (segs[i]);
+  durable_fini (&x);
+}
+
+CU_Test(ddsc_durable, recover_corrupt, .timeout = 30)
+{
+  const int32_t nsamples = 60;
+  const uint32_t garbage[2] = { 0xdeadbeef, 0xffffffff };
+  char *segs[20];
+  struct durable x;
+  int32_t nsegs;
+  durable_init (&x, "write");
+  nsegs = fill_store (&x, nsamples, segs, 20);
+  CU_ASSERT_FATAL (nsegs >= 3);
+
+  /* a file with an invalid header is ignored, and so is everything in a file from
+     the first invalid record header onwards: here the state and size of the 5th
+     record */
+  overwrite_file (segs[0], 0, garbage, sizeof (garbage));
+  overwrite_file (segs[1], SEGMENT_HEADER_SIZE + 4 * RECORD_SIZE, garbage, sizeof (garbage));
+  /* a record with a valid header but an invalid sample is dropped by itself: here
+     the encoding in the CDR header of the first record */
+  overwrite_file (segs[2], SEGMENT_HEADER_SIZE + RECORD_HEADER_SIZE, garbage, 2);
+  check_recovered (&x, nsamples, RECORDS_PER_SEGMENT + (RECORDS_PER_SEGMENT - 4) + 1);
+  for (int32_t i = 0; i < nsegs; i++)
+    ddsrt_free (segs[i]);
+  durable_fini (&x);
+}
@@ -26,12 +26,18 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
 #include "dds/ddsrt/misc.h"
 #include "dds/ddsrt/attributes.h"
 
 #include "test_common.h"
+#include "FilterTypes.h"
 
 #define MAXSAMPLES 20
 
@@ -769,3 +775,470 @@ CU_Test (ddsc_filter, sampleinfo)
   dds_delete (dp);
 }
 
+
+/* Samples for the filter expression tests, the key ("id") equals the index, so the
+   result of a filter can be represented as a bitmask of the ids that pass it */
+static int32_t fx_values[] = { 1, 2, 3 };
+static const FilterTypes_Msg fx_msgs[] = {
+  { 0, "alpha", FilterTypes_RED, { 0, 0 }, { 0, 0, NULL, false }, { 1, { .a = 10 } }, 0.5, "t0", false, 'a', -1, 1 },
+  { 1, "beta", FilterTypes_GREEN, { 1, -1 }, { 1, 1, (uint8_t *) fx_values, false }, { 2, { .b = "bee" } }, 1.5, "t1", true, 'b', -2, UINT64_C (9223372036854775808) },
+  { 2, "gamma", FilterTypes_BLUE, { 2, -2 }, { 2, 2, (uint8_t *) fx_values, false }, { 3, { .c = 2.5 } }, 2.5, "t2", false, 'c', -3, 3 },
+  { 3, "delta", FilterTypes_RED, { 3, -3 }, { 3, 3, (uint8_t *) fx_values, false }, { 1, { .a = 11 } }, 3.5, "tag", true, 'd', INT64_C (1099511627776), 4 },
+  { 4, "alpha2", FilterTypes_GREEN, { 4, -4 }, { 0, 0, NULL, false }, { 2, { .b = "" } }, -1.0, "", false, 'e', 0, 0 },
+  { 5, "o'neil", FilterTypes_BLUE, { 5, -5 }, { 1, 1, (uint8_t *) &fx_values[2], false }, { 9, { .c = -1.0 } }, 1e10, "t5", true, 'f', INT64_MIN, UINT64_MAX }
+};
+#define FX_NMSGS ((uint32_t) (sizeof (fx_msgs) / sizeof (fx_msgs[0])))
+#define FX_ALL ((1u << FX_NMSGS) - 1)
+
+static dds_entity_t fx_dp, fx_tp, fx_wr;
+static char fx_topicname[100];
+
+static void filter_expr_init (void)
+{
+  create_unique_topic_name ("ddsc_filter_expr", fx_topicname, sizeof (fx_topicname));
+  fx_dp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (fx_dp > 0);
+  fx_tp = dds_create_topic (fx_dp, &FilterTypes_Msg_desc, fx_topicname, NULL, NULL);
+  CU_ASSERT_FATAL (fx_tp > 0);
+  fx_wr = dds_create_writer (fx_dp, fx_tp, NULL, NULL);
+  CU_ASSERT_FATAL (fx_wr > 0);
+}
+
+static void filter_expr_fini (void)
+{
+  dds_delete (fx_dp);
+}
+
+/* Writes all samples using the unfiltered writer and returns the set of ids received
+   by a reader using topic "tp"; all local, so the data is in the reader on return
+   from dds_write */
+static uint32_t fx_received (dds_entity_t tp)
+{
+  FilterTypes_Msg data[FX_NMSGS + 1];
+  void *raw[FX_NMSGS + 1];
+  dds_sample_info_t si[FX_NMSGS + 1];
+  dds_return_t ret;
+  uint32_t mask = 0;
+  dds_entity_t rd = dds_create_reader (fx_dp, tp, NULL, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  for (uint32_t i = 0; i < FX_NMSGS; i++)
+  {
+    ret = dds_write (fx_wr, &fx_msgs[i]);
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  memset (data, 0, sizeof (data));
+  for (uint32_t i = 0; i < FX_NMSGS + 1; i++)
+    raw[i] = &data[i];
+  ret = dds_take (rd, raw, si, FX_NMSGS + 1, FX_NMSGS + 1);
+  CU_ASSERT_FATAL (ret >= 0 && ret <= (dds_return_t) FX_NMSGS);
+  for (int32_t i = 0; i < ret; i++)
+  {
+    CU_ASSERT_FATAL (si[i].valid_data && data[i].id >= 0 && data[i].id < (int32_t) FX_NMSGS);
+    mask |= 1u << data[i].id;
+  }
+  for (int32_t i = 0; i < ret; i++)
+    FilterTypes_Msg_free (&data[i], DDS_FREE_CONTENTS);
+  dds_delete (rd);
+  return mask;
+}
+
+static uint32_t fx_eval (const char *expression, uint32_t nparams, const char * const *params)
+{
+  dds_entity_t tp = dds_create_topic (fx_dp, &FilterTypes_Msg_desc, fx_topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_return_t ret = dds_set_topic_filter_expression (tp, expression, nparams, params);
+  CU_ASSERT_FATAL (ret == 0);
+  const uint32_t mask = fx_received (tp);
+  dds_delete (tp);
+  return mask;
+}
+
+static dds_return_t fx_compile (const char *expression, uint32_t nparams, const char * const *params)
+{
+  dds_entity_t tp = dds_create_topic (fx_dp, &FilterTypes_Msg_desc, fx_topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_return_t ret = dds_set_topic_filter_expression (tp, expression, nparams, params);
+  dds_delete (tp);
+  return ret;
+}
+
+struct fx_case {
+  const char *expression;
+  uint32_t mask;
+};
+
+static void fx_check_cases (size_t n, const struct fx_case *cases)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    const uint32_t mask = fx_eval (cases[i].expression, 0, NULL);
+    printf ("%s: 0x%02"PRIx32" (expected 0x%02"PRIx32")\n", cases[i].expression, mask, cases[i].mask);
+    CU_ASSERT (mask == cases[i].mask);
+  }
+}
+
+CU_Test (ddsc_filter_expression, relops, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  static const struct fx_case cases[] = {
+    { "id = 2", 0x04 },
+    { "id <> 2", 0x3b },
+    { "id != 2", 0x3b },
+    { "id < 2", 0x03 },
+    { "id <= 2", 0x07 },
+    { "id > 2", 0x38 },
+    { "id >= 2", 0x3c },
+    { "2 < id", 0x38 },
+    { "id < 2.5", 0x07 },
+    { "d > 2", 0x2c },
+    { "d <= -1.0", 0x10 },
+    { "ll < 0", 0x27 },
+    { "ll < 1", 0x37 },
+    { "ll = 1099511627776", 0x08 },
+    { "ll = -9223372036854775808", 0x20 },
+    { "ull > 9223372036854775807", 0x22 },
+    { "ull = 0xffffffffffffffff", 0x20 },
+    { "ull > -1", FX_ALL },
+    { "flag = TRUE", 0x2a },
+    { "flag = false", 0x15 }
+  };
+  fx_check_cases (sizeof (cases) / sizeof (cases[0]), cases);
+}
+
+CU_Test (ddsc_filter_expression, logic, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  static const struct fx_case cases[] = {
+    { "id = 1 OR id = 4", 0x12 },
+    { "id = 1 or id = 2", 0x06 },
+    { "id > 0 AND id < 3", 0x06 },
+    { "NOT id = 1", 0x3d },
+    { "NOT NOT id = 1", 0x02 },
+    { "NOT (id < 2 OR id > 3)", 0x0c },
+    { "id < 2 OR id > 3 AND flag = TRUE", 0x23 },
+    { "(id < 2 OR id > 3) AND flag = TRUE", 0x22 },
+    { "id = 0 OR id = 1 OR id = 2 AND flag = FALSE", 0x07 },
+    { "id BETWEEN 1 AND 3", 0x0e },
+    { "id NOT BETWEEN 1 AND 3", 0x31 },
+    { "d BETWEEN 0 AND 2 AND id > 0", 0x02 },
+    { "id BETWEEN 3 AND 1", 0x00 }
+  };
+  fx_check_cases (sizeof (cases) / sizeof (cases[0]), cases);
+}
+
+CU_Test (ddsc_filter_expression, strings, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  static const struct fx_case cases[] = {
+    { "name = 'beta'", 0x02 },
+    { "name = 'o''neil'", 0x20 },
+    { "name < 'beta'", 0x11 },
+    { "name >= 'delta'", 0x2c },
+    { "'alpha' = name", 0x01 },
+    { "name LIKE 'alpha%'", 0x11 },
+    { "name LIKE '%a'", 0x0f },
+    { "name LIKE '_e%a'", 0x0a },
+    { "name LIKE 'alpha_'", 0x10 },
+    { "name LIKE '%'", FX_ALL },
+    { "name NOT LIKE '%a%'", 0x20 },
+    { "tag = 'tag'", 0x08 },
+    { "tag = ''", 0x10 },
+    { "tag LIKE 't_'", 0x27 },
+    { "ch = 'c'", 0x04 },
+    { "ch > 'd'", 0x30 }
+  };
+  fx_check_cases (sizeof (cases) / sizeof (cases[0]), cases);
+}
+
+CU_Test (ddsc_filter_expression, enums_and_nested, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  /* "color" is an enum, "pos" a nested struct; "d" and beyond follow a sequence and
+     a union that must be skipped correctly */
+  static const struct fx_case cases[] = {
+    { "color = 1", 0x12 },
+    { "color <> 0", 0x36 },
+    { "color BETWEEN 1 AND 2", 0x36 },
+    { "pos.x = 3", 0x08 },
+    { "pos.y < -3", 0x30 },
+    { "pos.x = 2 OR pos.y = -4", 0x14 },
+    { "d = 1e10 AND tag = 't5' AND flag = TRUE AND ch = 'f' AND ull = 18446744073709551615", 0x20 }
+  };
+  fx_check_cases (sizeof (cases) / sizeof (cases[0]), cases);
+}
+
+CU_Test (ddsc_filter_expression, params, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  const char *p0[] = { "3", "'beta'" };
+  CU_ASSERT (fx_eval ("id = %0 OR name = %1", 2, p0) == 0x0a);
+  /* strings need not be quoted */
+  const char *p1[] = { "3", "beta" };
+  CU_ASSERT (fx_eval ("id = %0 OR name = %1", 2, p1) == 0x0a);
+  CU_ASSERT (fx_eval ("name = %1 OR id = %0", 2, p1) == 0x0a);
+  const char *p2[] = { "1", "2" };
+  CU_ASSERT (fx_eval ("id BETWEEN %0 AND %1", 2, p2) == 0x06);
+  const char *p3[] = { "%a" };
+  CU_ASSERT (fx_eval ("name LIKE %0", 1, p3) == 0x0f);
+  const char *p4[] = { " 1e0 " };
+  CU_ASSERT (fx_eval ("d > %0", 1, p4) == 0x2e);
+  const char *p5[] = { "TRUE" };
+  CU_ASSERT (fx_eval ("flag = %0", 1, p5) == 0x2a);
+  /* parameters are copied */
+  char p6buf[] = "4";
+  const char *p6[] = { p6buf };
+  dds_entity_t tp = dds_create_topic (fx_dp, &FilterTypes_Msg_desc, fx_topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_return_t ret = dds_set_topic_filter_expression (tp, "id = %0", 1, p6);
+  CU_ASSERT_FATAL (ret == 0);
+  p6buf[0] = '5';
+  CU_ASSERT (fx_received (tp) == 0x10);
+  dds_delete (tp);
+}
+
+CU_Test (ddsc_filter_expression, clear, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  struct dds_topic_filter filter;
+  dds_return_t ret;
+  dds_entity_t tp = dds_create_topic (fx_dp, &FilterTypes_Msg_desc, fx_topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  ret = dds_set_topic_filter_expression (tp, "id = 1", 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_get_topic_filter_extended (tp, &filter);
+  CU_ASSERT_FATAL (ret == 0);
+  CU_ASSERT (filter.mode == DDS_TOPIC_FILTER_EXPRESSION);
+  CU_ASSERT (fx_received (tp) == 0x02);
+
+  /* a failure to set a new one leaves the old one in place */
+  ret = dds_set_topic_filter_expression (tp, "id =", 0, NULL);
+  CU_ASSERT (ret == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (fx_received (tp) == 0x02);
+
+  /* replacing it */
+  ret = dds_set_topic_filter_expression (tp, "id = 2", 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  CU_ASSERT (fx_received (tp) == 0x04);
+
+  /* clearing it */
+  ret = dds_set_topic_filter_expression (tp, NULL, 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_get_topic_filter_extended (tp, &filter);
+  CU_ASSERT_FATAL (ret == 0);
+  CU_ASSERT (filter.mode == DDS_TOPIC_FILTER_NONE);
+  CU_ASSERT (fx_received (tp) == FX_ALL);
+
+  /* and a filter function replaces an expression */
+  ret = dds_set_topic_filter_expression (tp, "id = 1", 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  ret = dds_set_topic_filter_and_arg (tp, 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  CU_ASSERT (fx_received (tp) == FX_ALL);
+  dds_delete (tp);
+}
+
+CU_Test (ddsc_filter_expression, writer, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  /* an expression on the writer's topic drops data for all readers */
+  dds_entity_t tp = dds_create_topic (fx_dp, &FilterTypes_Msg_desc, fx_topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_return_t ret = dds_set_topic_filter_expression (tp, "pos.x >= 4 OR name LIKE 'g%'", 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  dds_entity_t wr = dds_create_writer (fx_dp, tp, NULL, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_entity_t wrsave = fx_wr;
+  fx_wr = wr;
+  CU_ASSERT (fx_received (fx_tp) == 0x34);
+  fx_wr = wrsave;
+  dds_delete (wr);
+  dds_delete (tp);
+}
+
+CU_Test (ddsc_filter_expression, bad_parameter, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  static const char *exprs[] = {
+    "", "id", "id =", "= 1", "id = 1 AND", "id = 1 OR", "NOT", "(id = 1", "id = 1)", "()",
+    "nosuchfield = 1", "pos = 1", "pos.z = 1", "Id = 1", "id = 1 id = 2",
+    "name = 1", "id = 'x'", "flag = 'x'", "1 = 1", "'a' = 'a'",
+    "id LIKE 'x'", "'x' LIKE name", "name LIKE tag", "name LIKE 1",
+    "id BETWEEN 1 OR 2", "id BETWEEN 1", "id NOT = 1", "id ! 2", "id == 2",
+    "name = 'unterminated", "id = 12abc", "id = 1.2.3", "id = %", "id = %x", "id = %0"
+  };
+  for (size_t i = 0; i < sizeof (exprs) / sizeof (exprs[0]); i++)
+  {
+    dds_return_t ret = fx_compile (exprs[i], 0, NULL);
+    printf ("%s: %"PRId32"\n", exprs[i], ret);
+    CU_ASSERT (ret == DDS_RETCODE_BAD_PARAMETER);
+  }
+
+  const char *p0[] = { "1" };
+  CU_ASSERT (fx_compile ("id = %1", 1, p0) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (fx_compile ("id = %0", 1, NULL) == DDS_RETCODE_BAD_PARAMETER);
+  const char *p1[] = { NULL };
+  CU_ASSERT (fx_compile ("id = %0", 1, p1) == DDS_RETCODE_BAD_PARAMETER);
+  const char *p2[] = { "x" };
+  CU_ASSERT (fx_compile ("id = %0", 1, p2) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_set_topic_filter_expression (0, "id = 1", 0, NULL) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_set_topic_filter_expression (fx_wr, "id = 1", 0, NULL) == DDS_RETCODE_ILLEGAL_OPERATION);
+}
+
+/* Meta data for a copy of FilterTypes::Msg: the filter locates the fields from the
+   meta data, so it must be consistent with the marshalling instructions */
+#define FX_META_HEAD "<MetaData version=\"1.0.0\"><Module name=\"FilterTypesCopy\">" \
+  "<Enum name=\"Color\"><Element name=\"RED\" value=\"0\"/><Element name=\"GREEN\" value=\"1\"/><Element name=\"BLUE\" value=\"2\"/></Enum>" \
+  "<Struct name=\"Point\"><Member name=\"x\"><Long/></Member><Member name=\"y\"><Long/></Member></Struct>" \
+  "<Union name=\"U\"><SwitchType><Long/></SwitchType><Case name=\"a\"><Long/><Label value=\"1\"/></Case><Case name=\"b\"><String/><Label value=\"2\"/></Case><Case name=\"c\"><Double/><Default/></Case></Union>" \
+  "<Struct name=\"%s\"><Member name=\"id\"><Long/></Member><Member name=\"name\"><String/></Member><Member name=\"color\"><Type name=\"Color\"/></Member><Member name=\"pos\"><Type name=\"Point\"/></Member>"
+#define FX_META_VALUES "<Member name=\"values\"><Sequence><Long/></Sequence></Member>"
+#define FX_META_U "<Member name=\"u\"><Type name=\"U\"/></Member>"
+#define FX_META_TAIL "<Member name=\"d\"><Double/></Member><Member name=\"tag\"><String length=\"8\"/></Member><Member name=\"flag\"><Boolean/></Member><Member name=\"ch\"><Char/></Member><Member name=\"ll\"><LongLong/></Member><Member name=\"ull\"><ULongLong/></Member>"
+#define FX_META_END "</Struct></Module></MetaData>"
+
+static dds_return_t fx_compile_meta (const char *name, const char *meta, const char *expression)
+{
+  char typename[100], topicname[100], *xmeta;
+  dds_topic_descriptor_t desc = FilterTypes_Msg_desc;
+  dds_return_t ret;
+  (void) snprintf (typename, sizeof (typename), "FilterTypesCopy::%s", name);
+  create_unique_topic_name ("ddsc_filter_expr_meta", topicname, sizeof (topicname));
+  desc.m_typename = typename;
+  if (meta == NULL)
+    desc.m_meta = NULL;
+  else
+  {
+    (void) ddsrt_asprintf (&xmeta, meta, name);
+    desc.m_meta = xmeta;
+  }
+  dds_entity_t tp = dds_create_topic (fx_dp, &desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  ret = dds_set_topic_filter_expression (tp, expression, 0, NULL);
+  dds_delete (tp);
+  if (meta != NULL)
+    ddsrt_free (xmeta);
+  return ret;
+}
+
+CU_Test (ddsc_filter_expression, unsupported, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  /* sequences and unions can't be filtered on */
+  CU_ASSERT (fx_compile ("values = 1", 0, NULL) == DDS_RETCODE_UNSUPPORTED);
+  CU_ASSERT (fx_compile ("u = 1", 0, NULL) == DDS_RETCODE_UNSUPPORTED);
+  CU_ASSERT (fx_compile ("id = 1 OR u = 1", 0, NULL) == DDS_RETCODE_UNSUPPORTED);
+
+  /* nor can types without meta data */
+  CU_ASSERT (fx_compile_meta ("NoMeta", NULL, "id = 1") == DDS_RETCODE_UNSUPPORTED);
+  CU_ASSERT (fx_compile_meta ("BadMeta", "<MetaData", "id = 1") == DDS_RETCODE_UNSUPPORTED);
+}
+
+CU_Test (ddsc_filter_expression, meta_ops_mapping, .init = filter_expr_init, .fini = filter_expr_fini)
+{
+  /* consistent: same as FilterTypes::Msg */
+  CU_ASSERT (fx_compile_meta ("Same", FX_META_HEAD FX_META_VALUES FX_META_U FX_META_TAIL FX_META_END, "id = 1") == DDS_RETCODE_OK);
+  CU_ASSERT (fx_compile_meta ("Same", FX_META_HEAD FX_META_VALUES FX_META_U FX_META_TAIL FX_META_END, "ull = 1") == DDS_RETCODE_OK);
+
+  /* sequence missing from the meta data, even if the field precedes it */
+  CU_ASSERT (fx_compile_meta ("NoSeq", FX_META_HEAD FX_META_U FX_META_TAIL FX_META_END, "id = 1") == DDS_RETCODE_UNSUPPORTED);
+  CU_ASSERT (fx_compile_meta ("NoSeq", FX_META_HEAD FX_META_U FX_META_TAIL FX_META_END, "d = 1") == DDS_RETCODE_UNSUPPORTED);
+  /* union missing from the meta data */
+  CU_ASSERT (fx_compile_meta ("NoUnion", FX_META_HEAD FX_META_VALUES FX_META_TAIL FX_META_END, "id = 1") == DDS_RETCODE_UNSUPPORTED);
+  /* union and sequence swapped */
+  CU_ASSERT (fx_compile_meta ("Swapped", FX_META_HEAD FX_META_U FX_META_VALUES FX_META_TAIL FX_META_END, "id = 1") == DDS_RETCODE_UNSUPPORTED);
+  /* sequence replaced by a long */
+  CU_ASSERT (fx_compile_meta ("SeqIsLong", FX_META_HEAD "<Member name=\"values\"><Long/></Member>" FX_META_U FX_META_TAIL FX_META_END, "id = 1") == DDS_RETCODE_UNSUPPORTED);
+  /* union replaced by a sequence */
+  CU_ASSERT (fx_compile_meta ("UnionIsSeq", FX_META_HEAD FX_META_VALUES FX_META_VALUES FX_META_TAIL FX_META_END, "id = 1") == DDS_RETCODE_UNSUPPORTED);
+  /* an extra member at the end */
+  CU_ASSERT (fx_compile_meta ("Extra", FX_META_HEAD FX_META_VALUES FX_META_U FX_META_TAIL "<Member name=\"extra\"><Long/></Member>" FX_META_END, "id = 1") == DDS_RETCODE_UNSUPPORTED);
+  /* a member missing at the end */
+  CU_ASSERT (fx_compile_meta ("Short", FX_META_HEAD FX_META_VALUES FX_META_U "<Member name=\"d\"><Double/></Member>" FX_META_END, "d = 1") == DDS_RETCODE_UNSUPPORTED);
+}
+
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+CU_Test (ddsc_filter_expression, remote_reader)
+{
+  /* Two domains with the same port numbers, so that the data goes over the network
+     and the filter of the remote reader gets evaluated by the writer */
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, 0);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, 1);
+  const dds_entity_t dom_pub = dds_create_domain (0, conf_pub);
+  CU_ASSERT_FATAL (dom_pub > 0);
+  const dds_entity_t dom_sub = dds_create_domain (1, conf_sub);
+  CU_ASSERT_FATAL (dom_sub > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_filter_expr_remote", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t dp_pub = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (dp_pub > 0);
+  const dds_entity_t dp_sub = dds_create_participant (1, NULL, NULL);
+  CU_ASSERT_FATAL (dp_sub > 0);
+  const dds_entity_t tp_pub = dds_create_topic (dp_pub, &FilterTypes_Msg_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (dp_sub, &FilterTypes_Msg_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+
+  /* the reader advertises the filter set at the time of its creation; removing it
+     from the topic afterwards means the reader itself no longer filters, so all it
+     receives is what the writer let through */
+  dds_return_t ret = dds_set_topic_filter_expression (tp_sub, "id = 1 OR name LIKE 'd%'", 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  const dds_entity_t rd = dds_create_reader (dp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  ret = dds_set_topic_filter_expression (tp_sub, NULL, 0, NULL);
+  CU_ASSERT_FATAL (ret == 0);
+  const dds_entity_t wr = dds_create_writer (dp_pub, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_publication_matched_status_t pm;
+  while ((ret = dds_get_publication_matched_status (wr, &pm)) == 0 && pm.current_count < 1)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (ret == 0);
+  dds_subscription_matched_status_t sm;
+  while ((ret = dds_get_subscription_matched_status (rd, &sm)) == 0 && sm.current_count < 1)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (ret == 0);
+
+  for (uint32_t i = 0; i < FX_NMSGS; i++)
+  {
+    ret = dds_write (wr, &fx_msgs[i]);
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  /* filtered samples must be covered by gaps for the reader to acknowledge everything */
+  ret = dds_wait_for_acks (wr, DDS_SECS (10));
+  CU_ASSERT_FATAL (ret == 0);
+
+  FilterTypes_Msg data[FX_NMSGS + 1];
+  void *raw[FX_NMSGS + 1];
+  dds_sample_info_t si[FX_NMSGS + 1];
+  uint32_t mask = 0;
+  memset (data, 0, sizeof (data));
+  for (uint32_t i = 0; i < FX_NMSGS + 1; i++)
+    raw[i] = &data[i];
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (mask != 0x0a && dds_time () < tend)
+  {
+    const dds_return_t n = dds_take (rd, raw, si, FX_NMSGS + 1, FX_NMSGS + 1);
+    CU_ASSERT_FATAL (n >= 0);
+    for (int32_t i = 0; i < n; i++)
+    {
+      CU_ASSERT_FATAL (si[i].valid_data && data[i].id >= 0 && data[i].id < (int32_t) FX_NMSGS);
+      mask |= 1u << data[i].id;
+    }
+    for (int32_t i = 0; i < n; i++)
+      FilterTypes_Msg_free (&data[i], DDS_FREE_CONTENTS);
+    memset (data, 0, sizeof (data));
+    if (mask != 0x0a)
+      dds_sleepfor (DDS_MSECS (10));
+  }
+  CU_ASSERT (mask == 0x0a);
+
+  /* nothing else arrives later */
+  dds_sleepfor (DDS_MSECS (100));
+  ret = dds_take (rd, raw, si, FX_NMSGS + 1, FX_NMSGS + 1);
+  CU_ASSERT (ret == 0);
+  for (int32_t i = 0; i < ret; i++)
+    FilterTypes_Msg_free (&data[i], DDS_FREE_CONTENTS);
+
+  dds_delete (dom_pub);
+  dds_delete (dom_sub);
+}
@@ -17,6 +17,7 @@
 #include "dds/dds.h"
 #include "dds/ddsrt/string.h"
 #include "RoundTrip.h"
+#include "InstanceHandleTypes.h"
 
 #define MAX_SAMPLES 10
 
@@ -201,3 +202,69 @@ CU_Test(ddsc_instance_get_key, querycondition, .init=setup, .fini=teardown)
 
     RoundTripModule_Address_free(&key_data, DDS_FREE_CONTENTS);
 }
+
+CU_Test(ddsc_instance_get_key, key_after_skipped_members)
+{
+    /* A string key isn't part of the key hash, so the key is extracted from the
+     * serialized data, which requires skipping the members preceding it:
+     * (empty) sequences of bounded strings and of structs and arrays of bounded
+     * strings. Skipping too few or too many instructions for any of these
+     * yields the wrong key. */
+    const uint32_t bsz = sizeof (((InstanceHandleTypes_KeyAfterSkip *) 0)->sa[0]);
+    dds_instance_handle_t handles[4];
+    dds_return_t ret;
+
+    participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(participant > 0);
+    topic = dds_create_topic(participant, &InstanceHandleTypes_KeyAfterSkip_desc, "ddsc_instance_get_key_skip", NULL, NULL);
+    CU_ASSERT_FATAL(topic > 0);
+    writer = dds_create_writer(participant, topic, NULL, NULL);
+    CU_ASSERT_FATAL(writer > 0);
+    /* the reader keeps the instances alive */
+    reader = dds_create_reader(participant, topic, NULL, NULL);
+    CU_ASSERT_FATAL(reader > 0);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        InstanceHandleTypes_KeyAfterSkip sample, key_data;
+        char key[16];
+        memset(&sample, 0, sizeof(sample));
+        sample.ss._length = sample.ss._maximum = (i & 1) ? 2 : 0;
+        sample.ss._buffer = dds_alloc(2 * bsz);
+        sample.ss._release = true;
+        (void) ddsrt_strlcpy((char *) sample.ss._buffer, "ss0", bsz);
+        (void) ddsrt_strlcpy((char *) sample.ss._buffer + bsz, "ss1", bsz);
+        sample.ps._length = sample.ps._maximum = (i & 2) ? 3 : 0;
+        sample.ps._buffer = dds_alloc(3 * sizeof(*sample.ps._buffer));
+        sample.ps._release = true;
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            sample.ps._buffer[j].x = (int32_t) j;
+            sample.ps._buffer[j].y = -(int32_t) j;
+        }
+        (void) ddsrt_strlcpy(sample.sa[0], "sa0", bsz);
+        (void) ddsrt_strlcpy(sample.sa[1], "sa1", bsz);
+        (void) snprintf(key, sizeof(key), "key%u", (unsigned) i);
+        sample.k = ddsrt_strdup(key);
+
+        /* write computes the key from the data, lookup_instance from the key fields only */
+        ret = dds_write(writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+        handles[i] = dds_lookup_instance(reader, &sample);
+        CU_ASSERT_FATAL(handles[i] != DDS_HANDLE_NIL);
+        for (uint32_t j = 0; j < i; j++)
+            CU_ASSERT_FATAL(handles[j] != handles[i]);
+
+        memset(&key_data, 0, sizeof(key_data));
+        ret = dds_instance_get_key(reader, handles[i], &key_data);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(key_data.k);
+        assert (key_data.k != NULL); /* for the benefit of clang's static analyzer */
+        CU_ASSERT_STRING_EQUAL(key_data.k, key);
+
+        InstanceHandleTypes_KeyAfterSkip_free(&key_data, DDS_FREE_CONTENTS);
+        InstanceHandleTypes_KeyAfterSkip_free(&sample, DDS_FREE_CONTENTS);
+    }
+
+    dds_delete(participant);
+}
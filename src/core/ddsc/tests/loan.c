@@ -11,6 +11,8 @@
  */
 #include <stdio.h>
 #include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
 #include "test_common.h"
 
 static dds_entity_t participant, topic, reader, writer, read_condition, read_condition_unread;
@@ -323,3 +325,385 @@ CU_Test (ddsc_loan, read_cleanup, .init = create_entities, .fini = delete_entiti
   result = dds_return_loan (reader, ptrs, n);
   CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
 }
+
+#define DDS_DOMAINID_LOAN 1
+#define DDS_CONFIG_SHARE_LOANED_SAMPLES "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Internal><ShareLoanedSamples>true</ShareLoanedSamples></Internal>"
+#define DDS_CONFIG_SHARED_MEMORY "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<SharedMemory><Enable>true</Enable><SlotsPerWriter>4</SlotsPerWriter></SharedMemory>"
+
+static dds_entity_t domain, fixed_topic, fixed_writer, fixed_reader, fixed_reader2;
+
+static void create_fixed_entities (const char *config)
+{
+  char topicname[100];
+  struct dds_qos *qos;
+
+  char *conf = ddsrt_expand_envvars (config, DDS_DOMAINID_LOAN);
+  domain = dds_create_domain (DDS_DOMAINID_LOAN, conf);
+  CU_ASSERT_FATAL (domain > 0);
+  ddsrt_free (conf);
+  participant = dds_create_participant (DDS_DOMAINID_LOAN, NULL, NULL);
+  CU_ASSERT_FATAL (participant > 0);
+
+  create_unique_topic_name ("ddsc_loan_fixed_test", topicname, sizeof topicname);
+  qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 1);
+  dds_qset_writer_data_lifecycle (qos, false);
+  fixed_topic = dds_create_topic (participant, &Space_Type1_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (fixed_topic > 0);
+  fixed_writer = dds_create_writer (participant, fixed_topic, qos, NULL);
+  CU_ASSERT_FATAL (fixed_writer > 0);
+  fixed_reader = dds_create_reader (participant, fixed_topic, qos, NULL);
+  CU_ASSERT_FATAL (fixed_reader > 0);
+  fixed_reader2 = dds_create_reader (participant, fixed_topic, qos, NULL);
+  CU_ASSERT_FATAL (fixed_reader2 > 0);
+  dds_delete_qos (qos);
+}
+
+static void create_fixed_entities_default (void)
+{
+  create_fixed_entities ("${CYCLONEDDS_URI}");
+}
+
+static void create_fixed_entities_shared (void)
+{
+  create_fixed_entities (DDS_CONFIG_SHARE_LOANED_SAMPLES);
+}
+
+static void create_fixed_entities_shm (void)
+{
+  create_fixed_entities (DDS_CONFIG_SHARED_MEMORY);
+}
+
+static void delete_fixed_entities (void)
+{
+  dds_return_t result;
+  result = dds_delete (domain);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+}
+
+static bool filter_long1_nonzero (const void *vsample, void *arg)
+{
+  const Space_Type1 *sample = vsample;
+  (void) arg;
+  return sample->long_1 != 0;
+}
+
+static void write_fixed (dds_entity_t wr, int32_t k)
+{
+  Space_Type1 s = { k, k + 1, k + 2 };
+  dds_return_t result = dds_write (wr, &s);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+}
+
+static bool fixed_sample_ok (const void *vs, int32_t k)
+{
+  const Space_Type1 *s = vs;
+  return s->long_1 == k && s->long_2 == k + 1 && s->long_3 == k + 2;
+}
+
+CU_Test (ddsc_loan, writer_loan_unsupported, .init = create_entities, .fini = delete_entities)
+{
+  dds_return_t result;
+  void *sample;
+
+  /* a sequence can't be serialized by copying the sample, and there is no shared memory */
+  result = dds_request_loan (writer, &sample);
+  CU_ASSERT (result == DDS_RETCODE_UNSUPPORTED);
+  result = dds_loan_sample (writer, &sample);
+  CU_ASSERT (result == DDS_RETCODE_UNSUPPORTED);
+  result = dds_request_loan (writer, NULL);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+  result = dds_request_loan (reader, &sample);
+  CU_ASSERT (result == DDS_RETCODE_ILLEGAL_OPERATION);
+}
+
+CU_Test (ddsc_loan, writer_loan_write_consumes, .init = create_fixed_entities_default, .fini = delete_fixed_entities)
+{
+  dds_return_t result;
+  void *loans[2];
+
+  result = dds_request_loan (fixed_writer, &loans[0]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_request_loan (fixed_writer, &loans[1]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (loans[0] != loans[1]);
+  *(Space_Type1 *) loans[0] = (Space_Type1) { 1, 2, 3 };
+  *(Space_Type1 *) loans[1] = (Space_Type1) { 4, 5, 6 };
+  for (int i = 0; i < 2; i++)
+  {
+    result = dds_write (fixed_writer, loans[i]);
+    CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  }
+
+  /* both readers received the data */
+  dds_entity_t rds[] = { fixed_reader, fixed_reader2 };
+  for (size_t k = 0; k < sizeof (rds) / sizeof (rds[0]); k++)
+  {
+    Space_Type1 xs[3];
+    void *ptrs[3] = { &xs[0], &xs[1], &xs[2] };
+    dds_sample_info_t si[3];
+    int32_t n = dds_take (rds[k], ptrs, si, 3, 3);
+    CU_ASSERT_FATAL (n == 2);
+    for (int32_t i = 0; i < n; i++)
+    {
+      CU_ASSERT (si[i].valid_data);
+      CU_ASSERT (fixed_sample_ok (&xs[i], 1) || fixed_sample_ok (&xs[i], 4));
+    }
+  }
+
+  /* writing consumed the loans: they can't be returned anymore */
+  result = dds_return_loan (fixed_writer, &loans[0], 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+  result = dds_return_loan (fixed_writer, &loans[1], 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+
+  /* dispose/unregister by key also consume the loan */
+  result = dds_request_loan (fixed_writer, &loans[0]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  *(Space_Type1 *) loans[0] = (Space_Type1) { 1, 0, 0 };
+  result = dds_dispose (fixed_writer, loans[0]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_return_loan (fixed_writer, &loans[0], 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+}
+
+CU_Test (ddsc_loan, writer_loan_filtered_write, .init = create_fixed_entities_default, .fini = delete_fixed_entities)
+{
+  dds_return_t result;
+  void *loan;
+
+  result = dds_set_topic_filter_and_arg (fixed_topic, filter_long1_nonzero, NULL);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+
+  /* a sample rejected by the filter is not published, but the loan is still returned */
+  result = dds_request_loan (fixed_writer, &loan);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  *(Space_Type1 *) loan = (Space_Type1) { 0, 1, 2 };
+  result = dds_write (fixed_writer, loan);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_return_loan (fixed_writer, &loan, 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+
+  result = dds_request_loan (fixed_writer, &loan);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  *(Space_Type1 *) loan = (Space_Type1) { 1, 2, 3 };
+  result = dds_write (fixed_writer, loan);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+
+  Space_Type1 xs[2];
+  void *ptrs[2] = { &xs[0], &xs[1] };
+  dds_sample_info_t si[2];
+  int32_t n = dds_take (fixed_reader, ptrs, si, 2, 2);
+  CU_ASSERT_FATAL (n == 1);
+  CU_ASSERT (xs[0].long_1 == 1 && xs[0].long_2 == 2 && xs[0].long_3 == 3);
+}
+
+CU_Test (ddsc_loan, writer_return_loan, .init = create_fixed_entities_default, .fini = delete_fixed_entities)
+{
+  dds_return_t result;
+  void *loans[3], *copy[3];
+
+  for (int i = 0; i < 3; i++)
+  {
+    result = dds_request_loan (fixed_writer, &loans[i]);
+    CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+    copy[i] = loans[i];
+  }
+
+  /* returning unused loans releases them and resets buf[0] */
+  result = dds_return_loan (fixed_writer, loans, 2);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  CU_ASSERT (loans[0] == NULL);
+  result = dds_return_loan (fixed_writer, copy, 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+  result = dds_return_loan (fixed_writer, &copy[1], 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+
+  /* one that's not returned is released when the writer is deleted */
+  (void) copy[2];
+
+  /* a reader's loan can't be returned to a writer, nor a writer's loan to another writer */
+  Space_Type1 s = { 1, 2, 3 };
+  result = dds_write (fixed_writer, &s);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  void *ptrs[1] = { NULL };
+  dds_sample_info_t si;
+  int32_t n = dds_read (fixed_reader, ptrs, &si, 1, 1);
+  CU_ASSERT_FATAL (n == 1);
+  void *rdloan = ptrs[0];
+  result = dds_return_loan (fixed_writer, ptrs, n);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (ptrs[0] == rdloan);
+  dds_entity_t writer2 = dds_create_writer (participant, fixed_topic, NULL, NULL);
+  CU_ASSERT_FATAL (writer2 > 0);
+  result = dds_return_loan (writer2, &copy[2], 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+  result = dds_return_loan (fixed_reader, ptrs, n);
+  CU_ASSERT (result == DDS_RETCODE_OK);
+
+  /* empty return is fine, writer loans are not affected by it */
+  result = dds_return_loan (fixed_writer, ptrs, 0);
+  CU_ASSERT (result == DDS_RETCODE_OK);
+}
+
+CU_Test (ddsc_loan, reference_loan_shared, .init = create_fixed_entities_shared, .fini = delete_fixed_entities)
+{
+  dds_return_t result;
+  void *ptrs[2][2] = { { NULL } }, *copy[2];
+  dds_sample_info_t si[2];
+  int32_t n;
+
+  write_fixed (fixed_writer, 1);
+  write_fixed (fixed_writer, 4);
+
+  /* both readers hand out references to the same deserialized copy */
+  n = dds_read (fixed_reader, ptrs[0], si, 2, 2);
+  CU_ASSERT_FATAL (n == 2);
+  n = dds_read (fixed_reader2, ptrs[1], si, 2, 2);
+  CU_ASSERT_FATAL (n == 2);
+  for (int i = 0; i < 2; i++)
+  {
+    CU_ASSERT (ptrs[0][i] == ptrs[1][i]);
+    CU_ASSERT (fixed_sample_ok (ptrs[0][i], (int32_t) (1 + 3 * i)));
+    copy[i] = ptrs[0][i];
+  }
+  result = dds_return_loan (fixed_reader2, ptrs[1], 2);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  CU_ASSERT (ptrs[1][0] == NULL);
+
+  /* the copy remains valid for the other reader, and reading again yields it again */
+  for (int i = 0; i < 2; i++)
+    CU_ASSERT (fixed_sample_ok (ptrs[0][i], (int32_t) (1 + 3 * i)));
+  result = dds_return_loan (fixed_reader, ptrs[0], 2);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  n = dds_read (fixed_reader, ptrs[0], si, 2, 2);
+  CU_ASSERT_FATAL (n == 2);
+  CU_ASSERT (ptrs[0][0] == copy[0] && ptrs[0][1] == copy[1]);
+
+  /* returning it twice is an error */
+  void *again[2] = { ptrs[0][0], ptrs[0][1] };
+  result = dds_return_loan (fixed_reader, ptrs[0], 2);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_return_loan (fixed_reader, again, 2);
+  CU_ASSERT (result == DDS_RETCODE_PRECONDITION_NOT_MET);
+
+  /* a read condition copies into the loan buffer */
+  dds_entity_t rdcond = dds_create_readcondition (fixed_reader2, DDS_ANY_STATE);
+  CU_ASSERT_FATAL (rdcond > 0);
+  n = dds_take (rdcond, ptrs[1], si, 2, 2);
+  CU_ASSERT_FATAL (n == 2);
+  for (int i = 0; i < 2; i++)
+  {
+    CU_ASSERT (ptrs[1][i] != copy[i]);
+    CU_ASSERT (fixed_sample_ok (ptrs[1][i], (int32_t) (1 + 3 * i)));
+  }
+  result = dds_return_loan (rdcond, ptrs[1], n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+
+  /* taking from the first reader drops its references, the copy goes with the
+     last reference to the serdata; address sanitizer and valgrind will complain
+     if that doesn't happen */
+  n = dds_take (fixed_reader, ptrs[0], si, 2, 2);
+  CU_ASSERT_FATAL (n == 2);
+  CU_ASSERT (ptrs[0][0] == copy[0] && ptrs[0][1] == copy[1]);
+  result = dds_return_loan (fixed_reader, ptrs[0], n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+}
+
+CU_Test (ddsc_loan, reference_loan_mixed_partial, .init = create_fixed_entities_shared, .fini = delete_fixed_entities)
+{
+  dds_return_t result;
+  void *ptrs[3] = { NULL }, *refs[3];
+  dds_sample_info_t si[3];
+  int32_t n;
+
+  /* instance 4 gets an invalid sample (copied into the loan buffer), instance 1 and 7
+     a valid one (handed out by reference) */
+  write_fixed (fixed_writer, 4);
+  n = dds_take (fixed_reader, ptrs, si, 3, 3);
+  CU_ASSERT_FATAL (n == 1);
+  result = dds_return_loan (fixed_reader, ptrs, n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_dispose (fixed_writer, &(Space_Type1) { 4, 0, 0 });
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  write_fixed (fixed_writer, 1);
+  write_fixed (fixed_writer, 7);
+
+  n = dds_read (fixed_reader, ptrs, si, 3, 3);
+  CU_ASSERT_FATAL (n == 3);
+  int nvalid = 0, ninvalid = 0;
+  for (int32_t i = 0; i < n; i++)
+  {
+    const Space_Type1 *s = ptrs[i];
+    if (si[i].valid_data)
+    {
+      CU_ASSERT (s->long_1 != 4 && fixed_sample_ok (s, s->long_1));
+      nvalid++;
+    }
+    else
+    {
+      CU_ASSERT (s->long_1 == 4);
+      ninvalid++;
+    }
+    refs[i] = ptrs[i];
+  }
+  CU_ASSERT (nvalid == 2 && ninvalid == 1);
+  CU_ASSERT (refs[0] != refs[1] && refs[0] != refs[2] && refs[1] != refs[2]);
+
+  /* returning only part of the samples still returns the whole loan, including
+     the references beyond bufsz */
+  result = dds_return_loan (fixed_reader, ptrs, 1);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  CU_ASSERT (ptrs[0] == NULL);
+
+  /* and so the next read can use the loan again, yielding the same references */
+  n = dds_read (fixed_reader, ptrs, si, 3, 3);
+  CU_ASSERT_FATAL (n == 3);
+  for (int32_t i = 0; i < n; i++)
+    CU_ASSERT (ptrs[i] == refs[i]);
+  result = dds_return_loan (fixed_reader, ptrs, n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+}
+
+CU_Test (ddsc_loan, writer_loan_sample_shm, .init = create_fixed_entities_shm, .fini = delete_fixed_entities)
+{
+  dds_return_t result;
+  void *loans[4], *copy;
+
+  /* dds_loan_sample hands out slots in the writer's shared memory segment */
+  result = dds_loan_sample (fixed_writer, &loans[0]);
+  if (result == DDS_RETCODE_UNSUPPORTED)
+  {
+    /* no shared memory on this platform */
+    return;
+  }
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  *(Space_Type1 *) loans[0] = (Space_Type1) { 1, 2, 3 };
+  copy = loans[0];
+  result = dds_write (fixed_writer, loans[0]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_return_loan (fixed_writer, &copy, 1);
+  CU_ASSERT (result == DDS_RETCODE_BAD_PARAMETER);
+
+  Space_Type1 xs[2];
+  void *ptrs[2] = { &xs[0], &xs[1] };
+  dds_sample_info_t si[2];
+  int32_t n = dds_take (fixed_reader, ptrs, si, 2, 2);
+  CU_ASSERT_FATAL (n == 1);
+  CU_ASSERT (fixed_sample_ok (&xs[0], 1));
+
+  /* there are only 4 slots, returning unused ones makes them available again */
+  int nloans = 0;
+  while (nloans < 4 && dds_loan_sample (fixed_writer, &loans[nloans]) == DDS_RETCODE_OK)
+    nloans++;
+  CU_ASSERT_FATAL (nloans > 0);
+  result = dds_loan_sample (fixed_writer, &copy);
+  CU_ASSERT (result == DDS_RETCODE_OUT_OF_RESOURCES);
+  result = dds_return_loan (fixed_writer, loans, nloans);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_loan_sample (fixed_writer, &loans[0]);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_return_loan (fixed_writer, loans, 1);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+}
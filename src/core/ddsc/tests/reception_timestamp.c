@@ -0,0 +1,126 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+static dds_entity_t g_domain = 0;
+static dds_entity_t g_remote_domain = 0;
+static dds_entity_t g_participant = 0;
+static dds_entity_t g_remote_participant = 0;
+static dds_entity_t g_writer = 0;
+static dds_entity_t g_reader = 0;
+static dds_entity_t g_remote_reader = 0;
+
+static void reception_timestamp_init (void)
+{
+  char name[100];
+
+  /* Same port number for both domains, so that the reader in the second domain
+     receives the data over the network */
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  g_domain = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (g_domain > 0);
+  g_remote_domain = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (g_remote_domain > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+
+  g_participant = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (g_participant > 0);
+  g_remote_participant = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (g_remote_participant > 0);
+
+  dds_qos_t *qos = dds_create_qos ();
+  CU_ASSERT_PTR_NOT_NULL_FATAL (qos);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, DDS_LENGTH_UNLIMITED);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+
+  create_unique_topic_name ("ddsc_reception_timestamp", name, sizeof name);
+  dds_entity_t topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  dds_entity_t remote_topic = dds_create_topic (g_remote_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (remote_topic > 0);
+
+  g_writer = dds_create_writer (g_participant, topic, qos, NULL);
+  CU_ASSERT_FATAL (g_writer > 0);
+  g_reader = dds_create_reader (g_participant, topic, qos, NULL);
+  CU_ASSERT_FATAL (g_reader > 0);
+  g_remote_reader = dds_create_reader (g_remote_participant, remote_topic, qos, NULL);
+  CU_ASSERT_FATAL (g_remote_reader > 0);
+  dds_delete_qos (qos);
+
+  /* wait for the writer to have discovered both readers */
+  dds_return_t ret;
+  dds_publication_matched_status_t st;
+  while ((ret = dds_get_publication_matched_status (g_writer, &st)) == 0 && st.current_count < 2)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (ret == 0);
+}
+
+static void reception_timestamp_fini (void)
+{
+  dds_delete (g_domain);
+  dds_delete (g_remote_domain);
+}
+
+static void take_one (dds_entity_t rd, Space_Type1 *sample, dds_sample_info_t *si)
+{
+  void *raw = sample;
+  dds_return_t n;
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  while ((n = dds_take (rd, &raw, si, 1, 1)) == 0 && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (n == 1);
+}
+
+CU_Test (ddsc_reception_timestamp, local_remote_invalid, .init = reception_timestamp_init, .fini = reception_timestamp_fini)
+{
+  Space_Type1 sample = { 1, 2, 3 };
+  dds_sample_info_t si;
+  dds_return_t ret;
+
+  const dds_time_t tbefore = dds_time ();
+  ret = dds_write (g_writer, &sample);
+  CU_ASSERT_FATAL (ret == 0);
+
+  /* local writer: never received from the network */
+  take_one (g_reader, &sample, &si);
+  CU_ASSERT (si.valid_data);
+  CU_ASSERT (si.reception_timestamp == 0);
+
+  /* remote reader: stamped on reception, so after the write and not in the future */
+  take_one (g_remote_reader, &sample, &si);
+  CU_ASSERT (si.valid_data);
+  CU_ASSERT (si.reception_timestamp >= tbefore);
+  CU_ASSERT (si.reception_timestamp <= dds_time ());
+
+  /* a dispose of an instance without samples results in an invalid sample,
+     also in the remote reader */
+  ret = dds_dispose (g_writer, &sample);
+  CU_ASSERT_FATAL (ret == 0);
+  take_one (g_reader, &sample, &si);
+  CU_ASSERT (!si.valid_data);
+  CU_ASSERT (si.reception_timestamp == 0);
+  take_one (g_remote_reader, &sample, &si);
+  CU_ASSERT (!si.valid_data);
+  CU_ASSERT (si.reception_timestamp == 0);
+}
@@ -0,0 +1,626 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+/* Tests for the Linux-specific UDP features, using loopback and plain sockets
+   to send to and receive from the UDP transport */
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+static dds_entity_t create_domain (dds_domainid_t domid, const char *extra_config)
+{
+  char *conf0 = NULL;
+  (void) ddsrt_asprintf (&conf0, "%s,%s", DDS_CONFIG_NO_PORT_GAIN, extra_config);
+  char *conf = ddsrt_expand_envvars (conf0, domid);
+  const dds_entity_t dom = dds_create_domain (domid, conf);
+  CU_ASSERT_FATAL (dom > 0);
+  ddsrt_free (conf);
+  ddsrt_free (conf0);
+  return dom;
+}
+
+static struct ddsi_domaingv *get_domaingv (dds_entity_t participant)
+{
+  struct dds_entity *x;
+  CU_ASSERT_FATAL (dds_entity_pin (participant, &x) == 0);
+  struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+  return gv;
+}
+
+static ddsrt_socket_t udp_loopback_socket (struct sockaddr_in *addr)
+{
+  ddsrt_socket_t sock;
+  socklen_t addrlen = sizeof (*addr);
+  CU_ASSERT_FATAL (ddsrt_socket (&sock, AF_INET, SOCK_DGRAM, 0) == DDS_RETCODE_OK);
+  memset (addr, 0, sizeof (*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  CU_ASSERT_FATAL (ddsrt_bind (sock, (struct sockaddr *) addr, sizeof (*addr)) == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (ddsrt_getsockname (sock, (struct sockaddr *) addr, &addrlen) == DDS_RETCODE_OK);
+  return sock;
+}
+
+static void loopback_locator (ddsi_locator_t *loc, const struct ddsi_domaingv *gv, const struct sockaddr_in *addr)
+{
+  memset (loc, 0, sizeof (*loc));
+  loc->kind = NN_LOCATOR_KIND_UDPv4;
+  loc->port = ntohs (addr->sin_port);
+  memcpy (loc->address + 12, &addr->sin_addr.s_addr, 4);
+  loc->tran = gv->m_factory;
+}
+
+/* Receives a datagram, waiting a few seconds at most: returns its size, or 0 on
+   timeout; *segsize is set to the segment size if the kernel coalesced it from
+   several, 0 otherwise */
+static size_t recv_datagram (ddsrt_socket_t sock, void *buf, size_t bufsz, size_t *segsize)
+{
+  union { struct cmsghdr align; char buf[CMSG_SPACE (sizeof (int))]; } ctrl;
+  ddsrt_msghdr_t msg;
+  ddsrt_iovec_t iov;
+  ssize_t rcvd = 0;
+  fd_set rdset;
+  int32_t ready = 0;
+  FD_ZERO (&rdset);
+  FD_SET (sock, &rdset);
+  (void) ddsrt_select (sock + 1, &rdset, NULL, NULL, DDS_SECS (5), &ready);
+  if (ready == 0)
+    return 0;
+  memset (&msg, 0, sizeof (msg));
+  iov.iov_base = buf;
+  iov.iov_len = (ddsrt_iov_len_t) bufsz;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof (ctrl.buf);
+  CU_ASSERT_FATAL (ddsrt_recvmsg (sock, &msg, 0, &rcvd) == DDS_RETCODE_OK);
+  *segsize = 0;
+#if DDSRT_HAVE_UDP_GRO
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+    {
+      int gso_size;
+      memcpy (&gso_size, CMSG_DATA (cmsg), sizeof (gso_size));
+      *segsize = (size_t) gso_size;
+    }
+  }
+#endif
+  return (size_t) rcvd;
+}
+
+/* Segment i of the segments of segsize bytes has every byte set to i */
+static void init_segments (unsigned char *buf, size_t len, size_t segsize)
+{
+  for (size_t off = 0; off < len; off += segsize)
+    memset (buf + off, (int) (off / segsize), (len - off < segsize) ? len - off : segsize);
+}
+
+static bool check_segments (const unsigned char *buf, size_t len, size_t segsize, size_t first)
+{
+  for (size_t off = 0; off < len; off++)
+    if (buf[off] != (unsigned char) (first + off / segsize))
+      return false;
+  return true;
+}
+
+CU_Test (ddsc_udp, write_segmented, .init = ddsrt_init, .fini = ddsrt_fini)
+{
+  const dds_entity_t dom = create_domain (DDS_DOMAINID_PUB, "<Internal><SendSegmentationOffload>true</SendSegmentationOffload></Internal>");
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  struct ddsi_domaingv * const gv = get_domaingv (pp);
+  ddsi_tran_conn_t conn = gv->xmit_conn;
+  struct sockaddr_in rxaddr;
+  ddsrt_socket_t rx = udp_loopback_socket (&rxaddr);
+  ddsi_locator_t loc;
+  unsigned char *buf = ddsrt_malloc (4000), *rbuf = ddsrt_malloc (65536);
+  size_t sz, segsize;
+  ssize_t n;
+
+  if (!ddsi_conn_supports_write_segmented (conn))
+  {
+    CU_PASS ("UDP segmentation offload not supported");
+    goto out;
+  }
+  loopback_locator (&loc, gv, &rxaddr);
+
+  /* segment boundaries coincide with iovec boundaries, the last segment may be
+     shorter than the others */
+  init_segments (buf, 3300, 1000);
+  ddsrt_iovec_t iov[] = {
+    { .iov_base = buf, .iov_len = 400 }, { .iov_base = buf + 400, .iov_len = 600 },
+    { .iov_base = buf + 1000, .iov_len = 1000 },
+    { .iov_base = buf + 2000, .iov_len = 100 }, { .iov_base = buf + 2100, .iov_len = 900 },
+    { .iov_base = buf + 3000, .iov_len = 300 }
+  };
+  n = ddsi_conn_write_segmented (conn, &loc, sizeof (iov) / sizeof (iov[0]), iov, 0, 1000);
+  CU_ASSERT_FATAL (n == 3300);
+  for (size_t i = 0; i < 4; i++)
+  {
+    sz = recv_datagram (rx, rbuf, 65536, &segsize);
+    CU_ASSERT_FATAL (sz == ((i < 3) ? 1000 : 300));
+    CU_ASSERT (segsize == 0);
+    CU_ASSERT (check_segments (rbuf, sz, 1000, i));
+  }
+
+#if DDSRT_HAVE_UDP_GRO
+  /* a receiver that accepts coalesced datagrams gets them in one go, which only
+     happens if they were sent as one */
+  int one = 1;
+  ddsrt_close (rx);
+  rx = udp_loopback_socket (&rxaddr);
+  loopback_locator (&loc, gv, &rxaddr);
+  if (ddsrt_setsockopt (rx, SOL_UDP, UDP_GRO, &one, sizeof (one)) == DDS_RETCODE_OK)
+  {
+    n = ddsi_conn_write_segmented (conn, &loc, sizeof (iov) / sizeof (iov[0]), iov, 0, 1000);
+    CU_ASSERT_FATAL (n == 3300);
+    sz = recv_datagram (rx, rbuf, 65536, &segsize);
+    CU_ASSERT_FATAL (sz == 3300);
+    CU_ASSERT (segsize == 1000);
+    CU_ASSERT (check_segments (rbuf, sz, 1000, 0));
+  }
+#endif
+
+  /* the kernel refusing a segmented send (here because of the number of segments)
+     results in the segments being sent individually, from then on */
+  {
+    ddsrt_iovec_t iov1[200];
+    for (size_t i = 0; i < 200; i++)
+    {
+      iov1[i].iov_base = buf + 10 * i;
+      iov1[i].iov_len = 10;
+    }
+    init_segments (buf, 2000, 10);
+    n = ddsi_conn_write_segmented (conn, &loc, 200, iov1, 0, 10);
+    CU_ASSERT_FATAL (n == 2000);
+    for (size_t i = 0; i < 200; i++)
+    {
+      sz = recv_datagram (rx, rbuf, 65536, &segsize);
+      CU_ASSERT_FATAL (sz == 10);
+      CU_ASSERT (segsize == 0);
+      CU_ASSERT (check_segments (rbuf, sz, 10, i));
+    }
+  }
+  init_segments (buf, 3300, 1000);
+  n = ddsi_conn_write_segmented (conn, &loc, sizeof (iov) / sizeof (iov[0]), iov, 0, 1000);
+  CU_ASSERT_FATAL (n == 3300);
+  for (size_t i = 0; i < 4; i++)
+  {
+    sz = recv_datagram (rx, rbuf, 65536, &segsize);
+    CU_ASSERT_FATAL (sz == ((i < 3) ? 1000 : 300));
+    CU_ASSERT (segsize == 0);
+  }
+
+out:
+  ddsrt_free (rbuf);
+  ddsrt_free (buf);
+  ddsrt_close (rx);
+  dds_delete (dom);
+}
+
+static void set_payload (RoundTripModule_DataType *sample, uint32_t i)
+{
+  sample->payload._length = sample->payload._maximum = 100000 + 1000 * i;
+  sample->payload._buffer = ddsrt_malloc (sample->payload._length);
+  sample->payload._release = true;
+  for (uint32_t j = 0; j < sample->payload._length; j++)
+    sample->payload._buffer[j] = (uint8_t) (i + j);
+}
+
+static bool check_payload (const RoundTripModule_DataType *sample, uint32_t i)
+{
+  if (sample->payload._length != 100000 + 1000 * i)
+    return false;
+  for (uint32_t j = 0; j < sample->payload._length; j++)
+    if (sample->payload._buffer[j] != (uint8_t) (i + j))
+      return false;
+  return true;
+}
+
+/* Writes fragmented samples from one domain to another with the given
+   configuration additions, checking that they arrive intact */
+static void large_samples (const char *pub_config, const char *sub_config)
+{
+  const dds_entity_t dom_pub = create_domain (DDS_DOMAINID_PUB, pub_config);
+  const dds_entity_t dom_sub = create_domain (DDS_DOMAINID_SUB, sub_config);
+  const dds_entity_t pp_pub = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp_pub > 0);
+  const dds_entity_t pp_sub = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp_sub > 0);
+  char name[100];
+  create_unique_topic_name ("ddsc_udp", name, sizeof (name));
+  const dds_entity_t tp_pub = dds_create_topic (pp_pub, &RoundTripModule_DataType_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (pp_sub, &RoundTripModule_DataType_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, DDS_LENGTH_UNLIMITED);
+  const dds_entity_t wr = dds_create_writer (pp_pub, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (pp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+
+  dds_return_t rc;
+  dds_publication_matched_status_t st;
+  while ((rc = dds_get_publication_matched_status (wr, &st)) == 0 && st.current_count < 1)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (rc == 0);
+
+#define NSAMPLES 10
+  for (uint32_t i = 0; i < NSAMPLES; i++)
+  {
+    RoundTripModule_DataType sample;
+    set_payload (&sample, i);
+    rc = dds_write (wr, &sample);
+    CU_ASSERT_FATAL (rc == 0);
+    RoundTripModule_DataType_free (&sample, DDS_FREE_CONTENTS);
+  }
+
+  /* all samples are for the same (key-less) instance, and arrive in order */
+  uint32_t nrcvd = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (nrcvd < NSAMPLES && dds_time () < tend)
+  {
+    void *raw = NULL;
+    dds_sample_info_t si;
+    if ((rc = dds_take (rd, &raw, &si, 1, 1)) <= 0)
+      dds_sleepfor (DDS_MSECS (10));
+    else
+    {
+      CU_ASSERT (si.valid_data);
+      CU_ASSERT (check_payload (raw, nrcvd));
+      nrcvd++;
+      (void) dds_return_loan (rd, &raw, rc);
+    }
+  }
+  CU_ASSERT (nrcvd == NSAMPLES);
+#undef NSAMPLES
+
+  dds_delete (dom_sub);
+  dds_delete (dom_pub);
+}
+
+CU_Test (ddsc_udp, segmented_samples, .init = ddsrt_init, .fini = ddsrt_fini)
+{
+  /* the fragments of a sample have the same size, and so get sent in trains of
+     segments with padding where needed */
+  large_samples ("<Internal><SendSegmentationOffload>true</SendSegmentationOffload></Internal>", "");
+}
+
+CU_Test (ddsc_udp, coalesced_samples, .init = ddsrt_init, .fini = ddsrt_fini)
+{
+  /* the subscriber gets the fragments in coalesced buffers, the reassembled
+     samples reference several of the messages in such a buffer */
+  large_samples ("<Internal><SendSegmentationOffload>true</SendSegmentationOffload></Internal>",
+                 "<Internal><ReceiveCoalescing>true</ReceiveCoalescing></Internal>");
+}
+
+#define TRACE_CONFIG "<Tracing><Category>trace</Category><OutputFile>cyclonedds_udp_tests.${CYCLONEDDS_DOMAIN_ID}.${CYCLONEDDS_PID}.log</OutputFile></Tracing>"
+
+/* Messages sent by the tests have a GUID prefix of (PREFIX_MAGIC + k, 0, PREFIX_MAGIC),
+   so that steering by GUID prefix sends message k to shard k modulo the number
+   of shards */
+#define PREFIX_MAGIC 0xc0ffee00u
+#define MAX_MSGS 16
+
+struct received_msgs {
+  ddsrt_mutex_t lock;
+  uint32_t count[MAX_MSGS];
+  unsigned long len[MAX_MSGS];
+  char thread[MAX_MSGS][32];
+  uint32_t n_unknown;
+};
+
+static void received_msgs_sink (void *varg, const dds_log_data_t *data)
+{
+  struct received_msgs *arg = varg;
+  uint32_t p0, p1, p2;
+  unsigned long len;
+  int vmaj, vmin;
+  const char *hdr;
+  ddsrt_mutex_lock (&arg->lock);
+  if ((hdr = strstr (data->message, "HDR(")) != NULL &&
+      sscanf (hdr, "HDR(%"SCNx32":%"SCNx32":%"SCNx32" vendor %d.%d) len %lu", &p0, &p1, &p2, &vmaj, &vmin, &len) == 6 &&
+      p0 - PREFIX_MAGIC < MAX_MSGS && p1 == 0 && p2 == PREFIX_MAGIC)
+  {
+    /* the header preceding the message ends with the (right-aligned) name of
+       the thread: "... [domainid]   threadname:" */
+    const uint32_t k = p0 - PREFIX_MAGIC;
+    const char *thr = strchr (data->message - data->hdrsize, ']');
+    size_t n = 0;
+    arg->count[k]++;
+    arg->len[k] = len;
+    if (thr != NULL)
+    {
+      thr += strspn (thr + 1, " ") + 1;
+      while (n < sizeof (arg->thread[k]) - 1 && thr[n] != ':')
+        n++;
+      memcpy (arg->thread[k], thr, n);
+    }
+    arg->thread[k][n] = 0;
+  }
+  if (strstr (data->message, "received encoded rtps message from unknown participant"))
+    arg->n_unknown++;
+  ddsrt_mutex_unlock (&arg->lock);
+}
+
+/* Message k of a train of n RTPS messages of segsize bytes (the last one shorter)
+   consists of just a header and padding, or a fake SRTPS_PREFIX if k == srtps */
+static size_t init_rtps_train (unsigned char *buf, uint32_t n, size_t segsize, size_t lastsize, uint32_t srtps)
+{
+  size_t off = 0;
+  for (uint32_t k = 0; k < n; k++)
+  {
+    const size_t msz = (k < n - 1) ? segsize : lastsize;
+    const uint32_t prefix[3] = { htonl (PREFIX_MAGIC + k), 0, htonl (PREFIX_MAGIC) };
+    Header_t hdr;
+    SubmessageHeader_t sm;
+    assert (msz >= RTPS_MESSAGE_HEADER_SIZE + RTPS_SUBMESSAGE_HEADER_SIZE);
+    memset (buf + off, 0, msz);
+    memcpy (hdr.protocol.id, "RTPS", 4);
+    hdr.version.major = RTPS_MAJOR;
+    hdr.version.minor = RTPS_MINOR;
+    hdr.vendorid = NN_VENDORID_ECLIPSE;
+    memcpy (&hdr.guid_prefix, prefix, sizeof (prefix));
+    memcpy (buf + off, &hdr, sizeof (hdr));
+    sm.submessageId = (k == srtps) ? SMID_SRTPS_PREFIX : SMID_PAD;
+    sm.flags = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN) ? SMFLAG_ENDIANNESS : 0;
+    sm.octetsToNextHeader = (uint16_t) (msz - RTPS_MESSAGE_HEADER_SIZE - RTPS_SUBMESSAGE_HEADER_SIZE);
+    memcpy (buf + off + RTPS_MESSAGE_HEADER_SIZE, &sm, sizeof (sm));
+    off += msz;
+  }
+  return off;
+}
+
+#if DDSRT_HAVE_UDP_SEGMENT && DDSRT_HAVE_UDP_GRO
+static dds_return_t send_segmented (ddsrt_socket_t sock, const struct sockaddr_in *dst, const void *buf, size_t len, uint16_t segsize)
+{
+  union { struct cmsghdr align; char buf[CMSG_SPACE (sizeof (uint16_t))]; } ctrl;
+  struct cmsghdr *cmsg;
+  ddsrt_msghdr_t msg;
+  ddsrt_iovec_t iov;
+  ssize_t sent = 0;
+  memset (&msg, 0, sizeof (msg));
+  memset (&ctrl, 0, sizeof (ctrl));
+  iov.iov_base = (void *) buf;
+  iov.iov_len = (ddsrt_iov_len_t) len;
+  msg.msg_name = (void *) dst;
+  msg.msg_namelen = sizeof (*dst);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof (ctrl.buf);
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (segsize));
+  memcpy (CMSG_DATA (cmsg), &segsize, sizeof (segsize));
+  return ddsrt_sendmsg (sock, &msg, 0, &sent);
+}
+
+/* Whether a train sent over loopback arrives as one buffer at a socket with
+   receive coalescing enabled */
+static bool loopback_coalesces (ddsrt_socket_t tx)
+{
+  struct sockaddr_in rxaddr;
+  ddsrt_socket_t rx = udp_loopback_socket (&rxaddr);
+  unsigned char buf[300], rbuf[600];
+  size_t sz = 0, segsize = 0;
+  int one = 1;
+  memset (buf, 0, sizeof (buf));
+  if (ddsrt_setsockopt (rx, SOL_UDP, UDP_GRO, &one, sizeof (one)) == DDS_RETCODE_OK &&
+      send_segmented (tx, &rxaddr, buf, sizeof (buf), 100) == DDS_RETCODE_OK)
+    sz = recv_datagram (rx, rbuf, sizeof (rbuf), &segsize);
+  ddsrt_close (rx);
+  return sz == sizeof (buf) && segsize == 100;
+}
+
+static void coalesced_messages (uint32_t srtps)
+{
+#define NMSGS 6
+#define SEGSIZE 200
+  struct received_msgs rcvd;
+  memset (&rcvd, 0, sizeof (rcvd));
+  ddsrt_mutex_init (&rcvd.lock);
+  dds_set_trace_sink (received_msgs_sink, &rcvd);
+  const dds_entity_t dom = create_domain (DDS_DOMAINID_PUB, "<Internal><ReceiveCoalescing>true</ReceiveCoalescing></Internal>" TRACE_CONFIG);
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  struct ddsi_domaingv * const gv = get_domaingv (pp);
+  struct sockaddr_in txaddr, dst;
+  ddsrt_socket_t tx = udp_loopback_socket (&txaddr);
+  unsigned char buf[NMSGS * SEGSIZE];
+  int gro = 0;
+  socklen_t optlen = sizeof (gro);
+
+  if (ddsrt_getsockopt (ddsi_conn_handle (gv->data_conn_uc), SOL_UDP, UDP_GRO, &gro, &optlen) != DDS_RETCODE_OK || !gro || !loopback_coalesces (tx))
+  {
+    CU_PASS ("UDP receive coalescing not supported");
+    goto out;
+  }
+
+  /* a train of messages sent to the unicast data socket arrives as a single buffer,
+     of which each message must be processed, including the shorter last one */
+  const size_t len = init_rtps_train (buf, NMSGS, SEGSIZE, SEGSIZE / 2, srtps);
+  memset (&dst, 0, sizeof (dst));
+  dst.sin_family = AF_INET;
+  dst.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  dst.sin_port = htons ((uint16_t) gv->loc_default_uc.port);
+  CU_ASSERT_FATAL (send_segmented (tx, &dst, buf, len, SEGSIZE) == DDS_RETCODE_OK);
+
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  bool done = false;
+  while (!done && dds_time () < tend)
+  {
+    dds_sleepfor (DDS_MSECS (10));
+    ddsrt_mutex_lock (&rcvd.lock);
+    done = true;
+    for (uint32_t k = 0; k < NMSGS; k++)
+      if (rcvd.count[k] == 0)
+        done = false;
+    ddsrt_mutex_unlock (&rcvd.lock);
+  }
+  ddsrt_mutex_lock (&rcvd.lock);
+  for (uint32_t k = 0; k < NMSGS; k++)
+  {
+    CU_ASSERT (rcvd.count[k] == 1);
+    CU_ASSERT (rcvd.len[k] == ((k < NMSGS - 1) ? SEGSIZE : SEGSIZE / 2));
+  }
+#ifdef DDS_HAS_SECURITY
+  CU_ASSERT (rcvd.n_unknown == (srtps < NMSGS ? 1u : 0u));
+#else
+  CU_ASSERT (rcvd.n_unknown == 0);
+#endif
+  ddsrt_mutex_unlock (&rcvd.lock);
+
+out:
+  ddsrt_close (tx);
+  dds_delete (dom);
+  dds_set_trace_sink (NULL, NULL);
+  ddsrt_mutex_destroy (&rcvd.lock);
+#undef SEGSIZE
+#undef NMSGS
+}
+
+CU_Test (ddsc_udp, coalesced_messages, .init = ddsrt_init, .fini = ddsrt_fini)
+{
+  coalesced_messages (UINT32_MAX);
+}
+
+CU_Test (ddsc_udp, coalesced_messages_decode, .init = ddsrt_init, .fini = ddsrt_fini)
+{
+  /* with security, a message that needs decoding in the middle means it and all
+     following ones get processed from a copy, otherwise it is just a message with
+     an unknown submessage */
+  coalesced_messages (2);
+}
+#endif
+
+#if DDSRT_HAVE_REUSEPORT_CBPF
+static void sharded_receive (bool steering)
+{
+#define NSHARDS 4
+#define NMSGS (3 * NSHARDS)
+#define MSGSIZE 100
+  struct received_msgs rcvd;
+  char *config = NULL;
+  memset (&rcvd, 0, sizeof (rcvd));
+  ddsrt_mutex_init (&rcvd.lock);
+  dds_set_trace_sink (received_msgs_sink, &rcvd);
+  (void) ddsrt_asprintf (&config, "<Internal><ReceiveShards>%d</ReceiveShards><ReceiveShardSteering>%s</ReceiveShardSteering></Internal>" TRACE_CONFIG, NSHARDS, steering ? "true" : "false");
+  const dds_entity_t dom = create_domain (DDS_DOMAINID_PUB, config);
+  ddsrt_free (config);
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  struct ddsi_domaingv * const gv = get_domaingv (pp);
+  struct sockaddr_in txaddr, dst;
+  ddsrt_socket_t tx = udp_loopback_socket (&txaddr);
+  unsigned char buf[NMSGS * MSGSIZE];
+
+  /* all shards are bound to the unicast data port, the first one is the one
+     that used to be the only one */
+  CU_ASSERT_FATAL (gv->n_data_conn_uc_shards == NSHARDS);
+  CU_ASSERT (gv->data_conn_uc == gv->data_conn_uc_shards[0]);
+  for (uint32_t i = 0; i < NSHARDS; i++)
+    CU_ASSERT (ddsi_conn_port (gv->data_conn_uc_shards[i]) == gv->loc_default_uc.port);
+
+  /* messages sent as separate datagrams from a single socket, so that without
+     steering the kernel's choice of shard is the same for all of them */
+  (void) init_rtps_train (buf, NMSGS, MSGSIZE, MSGSIZE, UINT32_MAX);
+  memset (&dst, 0, sizeof (dst));
+  dst.sin_family = AF_INET;
+  dst.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  dst.sin_port = htons ((uint16_t) gv->loc_default_uc.port);
+  for (uint32_t k = 0; k < NMSGS; k++)
+  {
+    ddsrt_msghdr_t msg;
+    ddsrt_iovec_t iov = { .iov_base = buf + k * MSGSIZE, .iov_len = MSGSIZE };
+    ssize_t sent;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_name = &dst;
+    msg.msg_namelen = sizeof (dst);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    CU_ASSERT_FATAL (ddsrt_sendmsg (tx, &msg, 0, &sent) == DDS_RETCODE_OK);
+  }
+
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  bool done = false;
+  while (!done && dds_time () < tend)
+  {
+    dds_sleepfor (DDS_MSECS (10));
+    ddsrt_mutex_lock (&rcvd.lock);
+    done = true;
+    for (uint32_t k = 0; k < NMSGS; k++)
+      if (rcvd.count[k] == 0)
+        done = false;
+    ddsrt_mutex_unlock (&rcvd.lock);
+  }
+  ddsrt_mutex_lock (&rcvd.lock);
+  for (uint32_t k = 0; k < NMSGS; k++)
+  {
+    char exp[32];
+    CU_ASSERT (rcvd.count[k] == 1);
+    if (steering)
+    {
+      (void) snprintf (exp, sizeof (exp), "recvUC%"PRIu32, k % NSHARDS);
+      CU_ASSERT (strcmp (rcvd.thread[k], exp) == 0);
+    }
+    else
+    {
+      CU_ASSERT (strncmp (rcvd.thread[k], "recvUC", 6) == 0);
+      CU_ASSERT (strcmp (rcvd.thread[k], rcvd.thread[0]) == 0);
+    }
+  }
+  ddsrt_mutex_unlock (&rcvd.lock);
+
+  /* deleting the domain only completes if the trigger messages get routed to
+     each of the shard receive threads */
+  ddsrt_close (tx);
+  dds_delete (dom);
+  dds_set_trace_sink (NULL, NULL);
+  ddsrt_mutex_destroy (&rcvd.lock);
+#undef MSGSIZE
+#undef NMSGS
+#undef NSHARDS
+}
+
+CU_Test (ddsc_udp, sharded_receive, .init = ddsrt_init, .fini = ddsrt_fini)
+{
+  sharded_receive (false);
+}
+
+CU_Test (ddsc_udp, sharded_receive_steering, .init = ddsrt_init, .fini = ddsrt_fini)
+{
+  sharded_receive (true);
+}
+#endif
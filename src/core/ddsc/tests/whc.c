@@ -11,12 +11,18 @@
  */
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
 #include "dds/dds.h"
+#include "dds/ddsc/dds_statistics.h"
 #include "dds/ddsrt/process.h"
 #include "dds/ddsrt/threads.h"
 #include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
 #include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_whc.h"
 #include "dds__entity.h"
@@ -297,3 +303,496 @@ CU_Test(ddsc_whc, check_end_state, .init=whc_init, .fini=whc_fini, .timeout=30)
 #undef BE
 #undef KA
 #undef KL
+
+/* Tests operating directly on the WHC of a writer without readers, so that nothing
+   else inserts or removes samples.  KEEP_ALL volatile writers use the ring if
+   Internal/WhcRing is enabled and the general-purpose WHC otherwise. */
+
+#define DDS_DOMAINID_WHCOPS 2
+#define DDS_CONFIG_WHC_RING "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Internal><WhcRing>%s</WhcRing></Internal>"
+
+struct whcops {
+  dds_entity_t domain;
+  dds_entity_t writer;
+  struct dds_entity *wr_entity;
+  struct ddsi_domaingv *gv;
+  struct writer *wr;
+  struct whc *whc;
+};
+
+static void whcops_init (struct whcops *x, bool whc_ring)
+{
+  char config[256], name[100];
+  (void) snprintf (config, sizeof (config), DDS_CONFIG_WHC_RING, whc_ring ? "true" : "false");
+  char *conf = ddsrt_expand_envvars (config, DDS_DOMAINID_WHCOPS);
+  x->domain = dds_create_domain (DDS_DOMAINID_WHCOPS, conf);
+  CU_ASSERT_FATAL (x->domain > 0);
+  dds_free (conf);
+  dds_entity_t pp = dds_create_participant (DDS_DOMAINID_WHCOPS, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  create_unique_topic_name ("ddsc_whc_ops_test", name, sizeof name);
+  dds_entity_t tp = dds_create_topic (pp, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_durability (qos, DDS_DURABILITY_VOLATILE);
+  x->writer = dds_create_writer (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (x->writer > 0);
+  dds_delete_qos (qos);
+
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (x->writer, &x->wr_entity), 0);
+  x->gv = &x->wr_entity->m_domain->gv;
+  thread_state_awake (lookup_thread_state (), x->gv);
+  x->wr = entidx_lookup_writer_guid (x->gv->entity_index, &x->wr_entity->m_guid);
+  CU_ASSERT_FATAL (x->wr != NULL);
+  assert (x->wr != NULL); /* for Clang's static analyzer */
+  x->whc = x->wr->whc;
+}
+
+static void whcops_fini (struct whcops *x)
+{
+  thread_state_asleep (lookup_thread_state ());
+  dds_entity_unpin (x->wr_entity);
+  dds_delete (x->domain);
+}
+
+static struct ddsi_serdata *whcops_insert (struct whcops *x, seqno_t max_drop_seq, seqno_t seq)
+{
+  const Space_Type1 sample = { (int32_t) (seq % 7), (int32_t) seq, 0 };
+  struct ddsi_serdata *sd = ddsi_serdata_from_sample (x->wr->type, SDK_DATA, &sample);
+  CU_ASSERT_FATAL (sd != NULL);
+  struct ddsi_tkmap_instance *tk = ddsi_tkmap_lookup_instance_ref (x->gv->m_tkmap, sd);
+  CU_ASSERT_FATAL (whc_insert (x->whc, max_drop_seq, seq, DDSRT_MTIME_NEVER, NULL, sd, tk) == 0);
+  ddsi_tkmap_instance_unref (x->gv->m_tkmap, tk);
+  /* the WHC has its own reference, returning the pointer for comparisons only */
+  ddsi_serdata_unref (sd);
+  return sd;
+}
+
+static uint32_t whcops_ack (struct whcops *x, seqno_t max_drop_seq, struct whc_state *whcst)
+{
+  struct whc_node *deferred_free_list;
+  const uint32_t n = whc_remove_acked_messages (x->whc, max_drop_seq, whcst, &deferred_free_list);
+  whc_free_deferred_free_list (x->whc, deferred_free_list);
+  return n;
+}
+
+static void whcops_check_borrow (struct whcops *x, seqno_t seq, const struct ddsi_serdata *sd, bool unacked)
+{
+  struct whc_borrowed_sample sample;
+  CU_ASSERT_FATAL (whc_borrow_sample (x->whc, seq, &sample));
+  CU_ASSERT (sample.seq == seq);
+  CU_ASSERT (sd == NULL || sample.serdata == sd);
+  CU_ASSERT (sample.unacked == unacked);
+  whc_return_sample (x->whc, &sample, false);
+}
+
+CU_TheoryDataPoints(ddsc_whc, ops_growth) = {
+  CU_DataPoints(bool, false, true)
+};
+
+CU_Theory((bool whc_ring), ddsc_whc, ops_growth, .timeout = 30)
+{
+  /* many more unacknowledged samples than fit in the initial ring */
+  const seqno_t n = 1000;
+  struct ddsi_serdata **sds = ddsrt_malloc ((size_t) n * sizeof (*sds));
+  struct whcops x;
+  struct whc_state whcst;
+  whcops_init (&x, whc_ring);
+
+  for (seqno_t seq = 1; seq <= n; seq++)
+    sds[seq - 1] = whcops_insert (&x, 0, seq);
+  whc_get_state (x.whc, &whcst);
+  CU_ASSERT_EQUAL (whcst.min_seq, 1);
+  CU_ASSERT_EQUAL (whcst.max_seq, n);
+  CU_ASSERT (whcst.unacked_bytes > 0 && whcst.unacked_bytes % (size_t) n == 0);
+  for (seqno_t seq = 1; seq <= n; seq++)
+  {
+    whcops_check_borrow (&x, seq, sds[seq - 1], true);
+    CU_ASSERT_EQUAL (whc_next_seq (x.whc, seq - 1), seq);
+  }
+  CU_ASSERT_EQUAL (whc_next_seq (x.whc, n), MAX_SEQ_NUMBER);
+
+  CU_ASSERT_EQUAL (whcops_ack (&x, n, &whcst), (uint32_t) n);
+  CU_ASSERT_EQUAL (whcst.min_seq, -1);
+
+  /* a gap in the sequence numbers: samples not stored for lack of reliable readers */
+  (void) whcops_insert (&x, n, n + 100);
+  CU_ASSERT_EQUAL (whc_next_seq (x.whc, n), n + 100);
+  struct whc_borrowed_sample sample;
+  CU_ASSERT (!whc_borrow_sample (x.whc, n + 1, &sample));
+  whcops_check_borrow (&x, n + 100, NULL, true);
+
+  CU_ASSERT_EQUAL (whcops_ack (&x, n + 100, &whcst), 1);
+  CU_ASSERT_EQUAL (whcst.min_seq, -1);
+  CU_ASSERT_EQUAL (whcst.max_seq, -1);
+  CU_ASSERT_EQUAL (whcst.unacked_bytes, 0);
+  ddsrt_free (sds);
+  whcops_fini (&x);
+}
+
+CU_TheoryDataPoints(ddsc_whc, ops_wraparound) = {
+  CU_DataPoints(bool, false, true)
+};
+
+CU_Theory((bool whc_ring), ddsc_whc, ops_wraparound, .timeout = 30)
+{
+  /* a sliding window of unacknowledged samples: in the ring, seq & mask wraps many
+     times without the ring growing */
+  struct ddsi_serdata *sds[4];
+  struct whcops x;
+  struct whc_state whcst;
+  size_t sample_size = 0;
+  whcops_init (&x, whc_ring);
+
+  for (seqno_t seq = 1; seq <= 1000; seq++)
+  {
+    const seqno_t max_drop_seq = (seq > 3) ? seq - 3 : 0;
+    sds[seq % 4] = whcops_insert (&x, max_drop_seq, seq);
+    if (seq == 1)
+    {
+      whc_get_state (x.whc, &whcst);
+      sample_size = whcst.unacked_bytes;
+    }
+    (void) whcops_ack (&x, max_drop_seq, &whcst);
+    CU_ASSERT_EQUAL_FATAL (whcst.min_seq, max_drop_seq + 1);
+    CU_ASSERT_EQUAL_FATAL (whcst.max_seq, seq);
+    CU_ASSERT_EQUAL_FATAL (whcst.unacked_bytes, (size_t) (seq - max_drop_seq) * sample_size);
+    for (seqno_t s = max_drop_seq + 1; s <= seq; s++)
+      whcops_check_borrow (&x, s, sds[s % 4], true);
+    if (max_drop_seq > 0)
+    {
+      struct whc_borrowed_sample sample;
+      CU_ASSERT (!whc_borrow_sample (x.whc, max_drop_seq, &sample));
+    }
+  }
+
+  (void) whcops_ack (&x, 1000, &whcst);
+  CU_ASSERT_EQUAL (whcst.min_seq, -1);
+  whcops_fini (&x);
+}
+
+CU_TheoryDataPoints(ddsc_whc, ops_borrow_rexmit) = {
+  CU_DataPoints(bool, false, true)
+};
+
+CU_Theory((bool whc_ring), ddsc_whc, ops_borrow_rexmit, .timeout = 30)
+{
+  struct whcops x;
+  struct whc_state whcst;
+  struct whc_borrowed_sample sample, sample2;
+  whcops_init (&x, whc_ring);
+
+  for (seqno_t seq = 1; seq <= 10; seq++)
+    (void) whcops_insert (&x, 0, seq);
+
+  /* the retransmit info updated by the borrower is stored only if requested, as
+     is done when the sample has been retransmitted */
+  const ddsrt_mtime_t trexmit = ddsrt_time_monotonic ();
+  CU_ASSERT_FATAL (whc_borrow_sample (x.whc, 5, &sample));
+  CU_ASSERT_EQUAL (sample.rexmit_count, 0);
+  sample.rexmit_count++;
+  sample.last_rexmit_ts = trexmit;
+  whc_return_sample (x.whc, &sample, true);
+  CU_ASSERT_FATAL (whc_borrow_sample (x.whc, 5, &sample));
+  CU_ASSERT_EQUAL (sample.rexmit_count, 1);
+  CU_ASSERT_EQUAL (sample.last_rexmit_ts.v, trexmit.v);
+  sample.rexmit_count++;
+  sample.last_rexmit_ts.v++;
+  whc_return_sample (x.whc, &sample, false);
+  CU_ASSERT_FATAL (whc_borrow_sample (x.whc, 5, &sample));
+  CU_ASSERT_EQUAL (sample.rexmit_count, 1);
+  CU_ASSERT_EQUAL (sample.last_rexmit_ts.v, trexmit.v);
+  whc_return_sample (x.whc, &sample, false);
+
+  /* a sample that is acknowledged while borrowed stays valid until it is returned,
+     the others are freed; address sanitizer and valgrind catch mistakes */
+  CU_ASSERT_FATAL (whc_borrow_sample (x.whc, 3, &sample));
+  CU_ASSERT_FATAL (whc_borrow_sample (x.whc, 7, &sample2));
+  CU_ASSERT_EQUAL (whcops_ack (&x, 5, &whcst), 5);
+  CU_ASSERT_EQUAL (whcst.min_seq, 6);
+  CU_ASSERT_EQUAL (whcst.max_seq, 10);
+  CU_ASSERT_EQUAL (ddsi_serdata_size (sample.serdata), ddsi_serdata_size (sample2.serdata));
+  whc_return_sample (x.whc, &sample, true);
+  CU_ASSERT (!whc_borrow_sample (x.whc, 3, &sample));
+  sample2.rexmit_count++;
+  whc_return_sample (x.whc, &sample2, true);
+  CU_ASSERT_FATAL (whc_borrow_sample (x.whc, 7, &sample2));
+  CU_ASSERT_EQUAL (sample2.rexmit_count, 1);
+  whc_return_sample (x.whc, &sample2, false);
+
+  (void) whcops_ack (&x, 10, &whcst);
+  whcops_fini (&x);
+}
+
+CU_TheoryDataPoints(ddsc_whc, ops_ack_removal) = {
+  CU_DataPoints(bool, false, true)
+};
+
+CU_Theory((bool whc_ring), ddsc_whc, ops_ack_removal, .timeout = 30)
+{
+  struct whcops x;
+  struct whc_state whcst;
+  struct ddsi_serdata *sds[10];
+  whcops_init (&x, whc_ring);
+
+  for (seqno_t seq = 1; seq <= 10; seq++)
+    sds[seq - 1] = whcops_insert (&x, 0, seq);
+  whc_get_state (x.whc, &whcst);
+  const size_t sample_size = whcst.unacked_bytes / 10;
+  CU_ASSERT_EQUAL (whcst.unacked_bytes, 10 * sample_size);
+
+  /* acks only ever remove a prefix */
+  CU_ASSERT_EQUAL (whcops_ack (&x, 0, &whcst), 0);
+  CU_ASSERT_EQUAL (whcst.min_seq, 1);
+  CU_ASSERT_EQUAL (whcops_ack (&x, 4, &whcst), 4);
+  CU_ASSERT_EQUAL (whcst.min_seq, 5);
+  CU_ASSERT_EQUAL (whcst.max_seq, 10);
+  CU_ASSERT_EQUAL (whcst.unacked_bytes, 6 * sample_size);
+  CU_ASSERT_EQUAL (whcops_ack (&x, 4, &whcst), 0);
+  for (seqno_t seq = 5; seq <= 10; seq++)
+    whcops_check_borrow (&x, seq, sds[seq - 1], true);
+
+  CU_ASSERT_EQUAL (whcops_ack (&x, 10, &whcst), 6);
+  CU_ASSERT_EQUAL (whcst.min_seq, -1);
+  CU_ASSERT_EQUAL (whcst.max_seq, -1);
+  CU_ASSERT_EQUAL (whcst.unacked_bytes, 0);
+  whcops_fini (&x);
+}
+
+/* Tests with a writer in one domain and its readers in another, where the
+   domain of the writer has a non-default configuration */
+
+#define DDS_DOMAINID_NET_PUB 3
+#define DDS_DOMAINID_NET_SUB 4
+#define NET_PAYLOAD_SIZE 4000
+
+struct whcnet {
+  dds_entity_t domain, remote_domain;
+  dds_entity_t participant, remote_participant;
+};
+
+static void whcnet_init (struct whcnet *x, const char *pub_extra)
+{
+  char config[512];
+  (void) snprintf (config, sizeof (config), "%s%s", DDS_CONFIG_NO_PORT_GAIN, pub_extra);
+  char *conf_pub = ddsrt_expand_envvars (config, DDS_DOMAINID_NET_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_NET_SUB);
+  x->domain = dds_create_domain (DDS_DOMAINID_NET_PUB, conf_pub);
+  CU_ASSERT_FATAL (x->domain > 0);
+  x->remote_domain = dds_create_domain (DDS_DOMAINID_NET_SUB, conf_sub);
+  CU_ASSERT_FATAL (x->remote_domain > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  x->participant = dds_create_participant (DDS_DOMAINID_NET_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (x->participant > 0);
+  x->remote_participant = dds_create_participant (DDS_DOMAINID_NET_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (x->remote_participant > 0);
+}
+
+static void whcnet_fini (struct whcnet *x)
+{
+  dds_delete (x->domain);
+  dds_delete (x->remote_domain);
+}
+
+static void whcnet_create_pair (struct whcnet *x, dds_entity_t *writer, dds_entity_t *reader)
+{
+  char name[100];
+  create_unique_topic_name ("ddsc_whc_net_test", name, sizeof name);
+  dds_entity_t tp = dds_create_topic (x->participant, &RoundTripModule_DataType_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_entity_t rtp = dds_create_topic (x->remote_participant, &RoundTripModule_DataType_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (rtp > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_MSECS (100));
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_durability (qos, DDS_DURABILITY_VOLATILE);
+  *writer = dds_create_writer (x->participant, tp, qos, NULL);
+  CU_ASSERT_FATAL (*writer > 0);
+  *reader = dds_create_reader (x->remote_participant, rtp, qos, NULL);
+  CU_ASSERT_FATAL (*reader > 0);
+  dds_delete_qos (qos);
+
+  /* the reader must know the writer as well, or it can't acknowledge anything */
+  dds_publication_matched_status_t pm;
+  dds_subscription_matched_status_t sm;
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (dds_get_publication_matched_status (*writer, &pm) == 0 && dds_get_subscription_matched_status (*reader, &sm) == 0 &&
+         (pm.current_count < 1 || sm.current_count < 1) && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (pm.current_count == 1 && sm.current_count == 1);
+}
+
+static dds_return_t whcnet_write (dds_entity_t writer, uint32_t seq)
+{
+  static unsigned char buf[NET_PAYLOAD_SIZE];
+  memset (buf, (int) (seq & 0xff), sizeof (buf));
+  RoundTripModule_DataType sample = { .payload = { ._length = sizeof (buf), ._maximum = sizeof (buf), ._buffer = buf, ._release = false } };
+  return dds_write (writer, &sample);
+}
+
+static bool whcnet_wait_whc_empty (dds_entity_t writer, dds_duration_t timeout)
+{
+  struct whc_state whcst;
+  dds_time_t tend = dds_time () + timeout;
+  get_writer_whc_state (writer, &whcst);
+  while (whcst.unacked_bytes > 0 && dds_time () < tend)
+  {
+    dds_sleepfor (DDS_MSECS (10));
+    get_writer_whc_state (writer, &whcst);
+  }
+  return whcst.unacked_bytes == 0 && whcst.min_seq == -1 && whcst.max_seq == -1;
+}
+
+static uint32_t whcnet_take_all (dds_entity_t reader, uint32_t expected, dds_duration_t timeout)
+{
+  uint32_t count = 0;
+  dds_time_t tend = dds_time () + timeout;
+  while (count < expected && dds_time () < tend)
+  {
+    void *raw[16] = { NULL };
+    dds_sample_info_t si[16];
+    dds_return_t n = dds_take (reader, raw, si, 16, 16);
+    CU_ASSERT_FATAL (n >= 0);
+    for (int32_t i = 0; i < n; i++)
+      if (si[i].valid_data)
+        count++;
+    if (n > 0)
+      (void) dds_return_loan (reader, raw, n);
+    else
+      dds_sleepfor (DDS_MSECS (10));
+  }
+  return count;
+}
+
+#define WHC_BUDGET 100000
+#define DDS_CONFIG_WHC_BUDGET "<Internal><Watermarks><WhcAdaptive>false</WhcAdaptive><WhcHigh>1MB</WhcHigh><WhcHighInit>1MB</WhcHighInit><WhcBudget>100000 B</WhcBudget><WhcBudgetPolicy>%s</WhcBudgetPolicy></Watermarks></Internal>"
+
+CU_TheoryDataPoints(ddsc_whc, budget) = {
+  CU_DataPoints(bool, false, true),
+};
+
+CU_Theory((bool shed), ddsc_whc, budget, .timeout = 60)
+{
+  char extra[300];
+  struct whcnet x;
+  dds_entity_t wr[2], rd[2];
+  struct whc_state whcst;
+  dds_return_t ret;
+
+  /* the high-water mark is far above the budget, so that only the budget can stop
+     the writer; the budget is shared by (at least) the two writers */
+  (void) snprintf (extra, sizeof (extra), DDS_CONFIG_WHC_BUDGET, shed ? "shed" : "block");
+  whcnet_init (&x, extra);
+  for (int i = 0; i < 2; i++)
+    whcnet_create_pair (&x, &wr[i], &rd[i]);
+
+  /* no acks: everything written stays in the WHCs */
+  ret = dds_domain_set_deafmute (x.remote_domain, false, true, DDS_INFINITY);
+  CU_ASSERT_FATAL (ret == 0);
+  for (uint32_t i = 0; i < 2; i++)
+    CU_ASSERT_FATAL (whcnet_write (wr[1], i) == 0);
+
+  /* a writer that can't get rid of its data must hit the budget before it hits
+     the high-water mark, and then fail in the configured way */
+  uint32_t nwritten = 0;
+  while ((ret = whcnet_write (wr[0], nwritten)) == 0 && nwritten < 1000000 / NET_PAYLOAD_SIZE)
+    nwritten++;
+  CU_ASSERT_FATAL (ret == (shed ? DDS_RETCODE_OUT_OF_RESOURCES : DDS_RETCODE_TIMEOUT));
+  get_writer_whc_state (wr[0], &whcst);
+  printf ("budget %s: wrote %"PRIu32" samples, unacked %"PRIuSIZE"\n", shed ? "shed" : "block", nwritten, whcst.unacked_bytes);
+  CU_ASSERT (whcst.unacked_bytes >= WHC_BUDGET / 4);
+  CU_ASSERT (whcst.unacked_bytes <= WHC_BUDGET + 2 * NET_PAYLOAD_SIZE);
+  CU_ASSERT (whcst.max_seq == (seqno_t) nwritten);
+
+  /* it keeps failing while the readers remain silent, in the shed case without
+     any delay */
+  dds_time_t tstart = dds_time ();
+  ret = whcnet_write (wr[0], nwritten);
+  CU_ASSERT (ret == (shed ? DDS_RETCODE_OUT_OF_RESOURCES : DDS_RETCODE_TIMEOUT));
+  if (shed) {
+    CU_ASSERT (dds_time () - tstart < DDS_MSECS (100));
+  } else {
+    CU_ASSERT (dds_time () - tstart >= DDS_MSECS (100));
+  }
+
+  /* but the other writer is still within its share */
+  CU_ASSERT (whcnet_write (wr[1], 2) == 0);
+
+  /* once the acks come in, the WHC drains and writing is possible again */
+  ret = dds_domain_set_deafmute (x.remote_domain, false, false, DDS_INFINITY);
+  CU_ASSERT_FATAL (ret == 0);
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  while ((ret = whcnet_write (wr[0], nwritten)) != 0 && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (ret == 0);
+  nwritten++;
+  CU_ASSERT (whcnet_wait_whc_empty (wr[0], DDS_SECS (10)));
+  CU_ASSERT (whcnet_wait_whc_empty (wr[1], DDS_SECS (10)));
+
+  /* samples that were rejected were never sent, all others arrive */
+  CU_ASSERT (whcnet_take_all (rd[0], nwritten, DDS_SECS (10)) == nwritten);
+  CU_ASSERT (whcnet_take_all (rd[1], 3, DDS_SECS (10)) == 3);
+  whcnet_fini (&x);
+}
+
+#define DDS_CONFIG_ACK_BATCH "<Internal><AckBatchMaxSamples>%"PRIu32"</AckBatchMaxSamples></Internal>"
+
+CU_TheoryDataPoints(ddsc_whc, ack_batch) = {
+  CU_DataPoints(uint32_t, 0, 8, 1000),
+};
+
+CU_Theory((uint32_t batch), ddsc_whc, ack_batch, .timeout = 60)
+{
+  char extra[100];
+  struct whcnet x;
+  dds_entity_t wr, rd;
+  struct whc_state whcst;
+  dds_return_t ret;
+  const uint32_t nsamples = 100, nlost = 5;
+
+  (void) snprintf (extra, sizeof (extra), DDS_CONFIG_ACK_BATCH, batch);
+  whcnet_init (&x, extra);
+  whcnet_create_pair (&x, &wr, &rd);
+
+  /* however the removal of acknowledged samples is batched, the WHC must become
+     empty after the last write, even when fewer than "batch" samples have been
+     acknowledged since the previous removal */
+  for (uint32_t i = 0; i < nsamples; i++)
+    CU_ASSERT_FATAL (whcnet_write (wr, i) == 0);
+  CU_ASSERT (whcnet_take_all (rd, nsamples, DDS_SECS (10)) == nsamples);
+  CU_ASSERT (whcnet_wait_whc_empty (wr, DDS_SECS (10)));
+
+  /* samples that never arrived have to be retransmitted, and once the reader has
+     them, the WHC must drain again (few enough not to reach the initial high-water
+     mark, as the writer would block otherwise) */
+  struct dds_statistics *stat = dds_create_statistics (wr);
+  CU_ASSERT_FATAL (stat != NULL);
+  const struct dds_stat_keyvalue *rexmit_bytes = dds_lookup_statistic (stat, "rexmit_bytes");
+  CU_ASSERT_FATAL (rexmit_bytes != NULL);
+  const uint64_t rexmit_bytes_before = rexmit_bytes->u.u64;
+
+  ret = dds_domain_set_deafmute (x.remote_domain, true, false, DDS_INFINITY);
+  CU_ASSERT_FATAL (ret == 0);
+  for (uint32_t i = 0; i < nlost; i++)
+    CU_ASSERT_FATAL (whcnet_write (wr, nsamples + i) == 0);
+  get_writer_whc_state (wr, &whcst);
+  CU_ASSERT (whcst.max_seq == (seqno_t) (nsamples + nlost));
+  CU_ASSERT (whcst.unacked_bytes > 0);
+  /* give the receive threads of the deaf domain time to drop the data */
+  dds_sleepfor (DDS_MSECS (200));
+  CU_ASSERT (whcnet_take_all (rd, 1, 0) == 0);
+  ret = dds_domain_set_deafmute (x.remote_domain, false, false, DDS_INFINITY);
+  CU_ASSERT_FATAL (ret == 0);
+
+  CU_ASSERT (whcnet_take_all (rd, nlost, DDS_SECS (10)) == nlost);
+  CU_ASSERT (whcnet_wait_whc_empty (wr, DDS_SECS (10)));
+  ret = dds_refresh_statistics (stat);
+  CU_ASSERT_FATAL (ret == 0);
+  printf ("ack batch %"PRIu32": rexmit_bytes %"PRIu64" -> %"PRIu64"\n", batch, rexmit_bytes_before, rexmit_bytes->u.u64);
+  CU_ASSERT (rexmit_bytes->u.u64 > rexmit_bytes_before);
+  dds_delete_statistics (stat);
+  whcnet_fini (&x);
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/veth.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/sockets.h"
+
+#include "test_common.h"
+
+/* Smoke test of the xdp transport: two domains in this process, each on one
+   end of a veth pair with the XDP program in generic mode.  Creating the veth
+   pair and attaching XDP programs requires CAP_NET_ADMIN and CAP_BPF, without
+   those the test does nothing. */
+
+#define VETH0 "ddsxdp0"
+#define VETH1 "ddsxdp1"
+
+/* Frames are at most 4kB and the veth pair has the usual ethernet MTU, the xdp
+   transport (like raweth) doesn't limit the message size by itself */
+#define DDS_CONFIG_XDP "<General><Transport>xdp</Transport><NetworkInterfaceAddress>%s</NetworkInterfaceAddress><MaxMessageSize>1400B</MaxMessageSize><FragmentSize>1200B</FragmentSize></General><Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Internal><XdpGenericMode>true</XdpGenericMode></Internal><Tracing><OutputFile>cyclonedds_xdp_tests.${CYCLONEDDS_DOMAIN_ID}.${CYCLONEDDS_PID}.log</OutputFile><Verbosity>finest</Verbosity></Tracing>"
+
+struct nlreq {
+  struct nlmsghdr hdr;
+  struct ifinfomsg ifi;
+  unsigned char attrs[256];
+};
+
+static struct rtattr *nlreq_add (struct nlreq *req, unsigned short type, const void *data, size_t len)
+{
+  struct rtattr *rta = (struct rtattr *) ((char *) req + NLMSG_ALIGN (req->hdr.nlmsg_len));
+  rta->rta_type = type;
+  rta->rta_len = (unsigned short) RTA_LENGTH (len);
+  if (len > 0)
+    memcpy (RTA_DATA (rta), data, len);
+  req->hdr.nlmsg_len = NLMSG_ALIGN (req->hdr.nlmsg_len) + RTA_ALIGN (rta->rta_len);
+  return rta;
+}
+
+static void nlreq_end_nested (struct nlreq *req, struct rtattr *nest)
+{
+  nest->rta_len = (unsigned short) ((char *) req + req->hdr.nlmsg_len - (char *) nest);
+}
+
+static void nlreq_init (struct nlreq *req, uint16_t type, uint16_t flags)
+{
+  memset (req, 0, sizeof (*req));
+  req->hdr.nlmsg_len = NLMSG_LENGTH (sizeof (req->ifi));
+  req->hdr.nlmsg_type = type;
+  req->hdr.nlmsg_flags = (uint16_t) (NLM_F_REQUEST | NLM_F_ACK | flags);
+  req->ifi.ifi_family = AF_UNSPEC;
+}
+
+/* Sends the request over rtnetlink, returns the error from the acknowledgement
+   (0 on success, a negative errno on failure) */
+static int nlreq_send (struct nlreq *req)
+{
+  struct { struct nlmsghdr hdr; struct nlmsgerr err; unsigned char pad[256]; } ack;
+  int fd, ret = -1;
+  if ((fd = socket (AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE)) < 0)
+    return -1;
+  if (send (fd, req, req->hdr.nlmsg_len, 0) == (ssize_t) req->hdr.nlmsg_len &&
+      recv (fd, &ack, sizeof (ack), 0) >= (ssize_t) NLMSG_LENGTH (sizeof (ack.err)) &&
+      ack.hdr.nlmsg_type == NLMSG_ERROR)
+    ret = ack.err.error;
+  close (fd);
+  return ret;
+}
+
+static bool create_veth_pair (void)
+{
+  struct nlreq req;
+  struct rtattr *linkinfo, *data, *peer;
+  struct ifinfomsg peer_ifi;
+  nlreq_init (&req, RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+  (void) nlreq_add (&req, IFLA_IFNAME, VETH0, sizeof (VETH0));
+  linkinfo = nlreq_add (&req, IFLA_LINKINFO, NULL, 0);
+  (void) nlreq_add (&req, IFLA_INFO_KIND, "veth", sizeof ("veth"));
+  data = nlreq_add (&req, IFLA_INFO_DATA, NULL, 0);
+  memset (&peer_ifi, 0, sizeof (peer_ifi));
+  peer_ifi.ifi_family = AF_UNSPEC;
+  peer = nlreq_add (&req, VETH_INFO_PEER, &peer_ifi, sizeof (peer_ifi));
+  (void) nlreq_add (&req, IFLA_IFNAME, VETH1, sizeof (VETH1));
+  nlreq_end_nested (&req, peer);
+  nlreq_end_nested (&req, data);
+  nlreq_end_nested (&req, linkinfo);
+  if (nlreq_send (&req) != 0)
+    return false;
+
+  for (int i = 0; i < 2; i++)
+  {
+    nlreq_init (&req, RTM_NEWLINK, 0);
+    req.ifi.ifi_index = (int) if_nametoindex (i == 0 ? VETH0 : VETH1);
+    req.ifi.ifi_flags = IFF_UP;
+    req.ifi.ifi_change = IFF_UP;
+    CU_ASSERT_FATAL (nlreq_send (&req) == 0);
+  }
+  return true;
+}
+
+static void delete_veth_pair (void)
+{
+  /* deleting one end deletes the pair */
+  struct nlreq req;
+  nlreq_init (&req, RTM_DELLINK, 0);
+  req.ifi.ifi_index = (int) if_nametoindex (VETH0);
+  CU_ASSERT (nlreq_send (&req) == 0);
+}
+
+static dds_entity_t create_xdp_domain (dds_domainid_t domid, const char *ifname)
+{
+  char *conf0 = NULL;
+  (void) ddsrt_asprintf (&conf0, DDS_CONFIG_XDP, ifname);
+  char *conf = ddsrt_expand_envvars (conf0, domid);
+  const dds_entity_t dom = dds_create_domain (domid, conf);
+  ddsrt_free (conf);
+  ddsrt_free (conf0);
+  return dom;
+}
+
+static void set_payload (RoundTripModule_DataType *sample, uint32_t i)
+{
+  /* mostly small samples, some that need fragmenting */
+  sample->payload._length = sample->payload._maximum = (i % 100 == 0) ? 20000 : 4 + i % 50;
+  sample->payload._buffer = ddsrt_malloc (sample->payload._length);
+  sample->payload._release = true;
+  for (uint32_t j = 0; j < sample->payload._length; j++)
+    sample->payload._buffer[j] = (uint8_t) (i + j);
+}
+
+static bool check_payload (const RoundTripModule_DataType *sample, uint32_t i)
+{
+  if (sample->payload._length != ((i % 100 == 0) ? 20000 : 4 + i % 50))
+    return false;
+  for (uint32_t j = 0; j < sample->payload._length; j++)
+    if (sample->payload._buffer[j] != (uint8_t) (i + j))
+      return false;
+  return true;
+}
+
+CU_Test (ddsc_xdp, veth_generic_mode, .init = ddsrt_init, .fini = ddsrt_fini, .timeout = 60)
+{
+  if (!create_veth_pair ())
+  {
+    CU_PASS ("creating a veth pair not permitted");
+    return;
+  }
+  const dds_entity_t dom_pub = create_xdp_domain (0, VETH0);
+  if (dom_pub < 0)
+  {
+    /* most likely attaching the XDP program is not permitted */
+    delete_veth_pair ();
+    CU_PASS ("xdp transport not available");
+    return;
+  }
+  const dds_entity_t dom_sub = create_xdp_domain (1, VETH1);
+  CU_ASSERT_FATAL (dom_sub > 0);
+  const dds_entity_t pp_pub = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pp_pub > 0);
+  const dds_entity_t pp_sub = dds_create_participant (1, NULL, NULL);
+  CU_ASSERT_FATAL (pp_sub > 0);
+  char name[100];
+  create_unique_topic_name ("ddsc_xdp", name, sizeof (name));
+  const dds_entity_t tp_pub = dds_create_topic (pp_pub, &RoundTripModule_DataType_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (pp_sub, &RoundTripModule_DataType_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, DDS_LENGTH_UNLIMITED);
+  const dds_entity_t wr = dds_create_writer (pp_pub, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (pp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+
+  dds_return_t rc;
+  dds_publication_matched_status_t st;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  while ((rc = dds_get_publication_matched_status (wr, &st)) == 0 && st.current_count < 1 && dds_time () < tmatch)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (rc == 0 && st.current_count == 1);
+
+  /* more messages than there are frames for receiving and for transmitting, so
+     this only works if frames get returned to the fill ring after reception and
+     reclaimed from the completion ring after transmission */
+#define NSAMPLES 5000u
+  uint32_t nwritten = 0, nrcvd = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (30);
+  while (nrcvd < NSAMPLES && dds_time () < tend)
+  {
+    /* keep the amount in flight below what the RX ring holds */
+    if (nwritten < NSAMPLES && nwritten - nrcvd < 500)
+    {
+      RoundTripModule_DataType sample;
+      set_payload (&sample, nwritten);
+      rc = dds_write (wr, &sample);
+      CU_ASSERT_FATAL (rc == 0);
+      RoundTripModule_DataType_free (&sample, DDS_FREE_CONTENTS);
+      nwritten++;
+    }
+    void *raw = NULL;
+    dds_sample_info_t si;
+    if ((rc = dds_take (rd, &raw, &si, 1, 1)) > 0)
+    {
+      CU_ASSERT (si.valid_data);
+      CU_ASSERT (check_payload (raw, nrcvd));
+      nrcvd++;
+      (void) dds_return_loan (rd, &raw, rc);
+    }
+    else if (nwritten == NSAMPLES || nwritten - nrcvd >= 500)
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT (nrcvd == NSAMPLES);
+#undef NSAMPLES
+
+  dds_delete (dom_sub);
+  dds_delete (dom_pub);
+  delete_veth_pair ();
+}
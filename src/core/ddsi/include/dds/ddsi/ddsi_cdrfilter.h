@@ -0,0 +1,62 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_CDRFILTER_H
+#define DDSI_CDRFILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dds/export.h"
+#include "dds/ddsrt/retcode.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_sertype_default;
+struct ddsi_serdata;
+
+/* Content filter expression compiled against the marshalling program of a type, it
+   is evaluated directly on the CDR representation of a sample.
+
+   The expression syntax is the subset of the DDS content-filtered topic syntax that
+   applies to scalar fields: comparisons (=, <>, !=, <, <=, >, >=), BETWEEN, LIKE
+   (with % and _ as wildcards), AND, OR, NOT and parentheses.  Operands are field
+   names ("a.b" for member b of struct-typed member a), integer, floating-point,
+   string ('...') and boolean (TRUE, FALSE) literals and parameters (%0 .. %99) that
+   get replaced by the literal in params[n].  Referenced fields must be of primitive,
+   enumerated or string types and can't be members of a sequence, array or union.
+
+   Member names are taken from the XML type description in the sertype, so types
+   that don't have one can't be filtered this way. */
+struct ddsi_cdrfilter;
+
+/* Returns DDS_RETCODE_BAD_PARAMETER if the expression is invalid or doesn't match
+   the type, and DDS_RETCODE_UNSUPPORTED if the type has no description or it
+   references a field that can't be accessed directly */
+DDS_EXPORT dds_return_t ddsi_cdrfilter_compile (struct ddsi_cdrfilter **filter, const struct ddsi_sertype_default *type, const char *expression, uint32_t nparams, const char * const *params);
+
+/* Sample must be a ddsi_serdata_default containing data of the type the filter was
+   compiled for */
+DDS_EXPORT bool ddsi_cdrfilter_eval (const struct ddsi_cdrfilter *filter, const struct ddsi_serdata *sample);
+
+/* Returns the expression and parameters the filter was compiled from, the pointers
+   remain valid for the lifetime of the filter */
+DDS_EXPORT void ddsi_cdrfilter_get_expression (const struct ddsi_cdrfilter *filter, const char **expression, uint32_t *nparams, char * const **params);
+
+DDS_EXPORT void ddsi_cdrfilter_free (struct ddsi_cdrfilter *filter);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_CDRFILTER_H */
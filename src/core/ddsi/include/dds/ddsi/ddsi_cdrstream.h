@@ -48,6 +48,19 @@ void dds_stream_free_sample (void *data, const uint32_t * ops);
 
 uint32_t dds_stream_countops (const uint32_t * __restrict ops);
 size_t dds_stream_check_optimize (const struct ddsi_sertype_default_desc * __restrict desc);
+
+/* Returns the largest alignment (1, 2, 4 or 8) of anything in the CDR representation
+   of the type, i.e., the alignment the CDR data must have in memory to be accessed
+   in place. */
+uint32_t dds_stream_max_align (const struct ddsi_sertype_default_desc * __restrict desc);
+
+/* For types that can't be memcpy'd as a whole (dds_stream_check_optimize returns 0),
+   computes a plan for (de)serializing the runs of fields (including those in nested
+   structs, arrays and sequences of structs) that are laid out in memory like in CDR
+   with memcpy, leaving only the remainder (strings, sequences of primitives, unions,
+   misaligned parts) to the interpreter.  Returns NULL if there is nothing to gain. */
+struct dds_stream_copy_op *dds_stream_copy_plan_new (const struct ddsi_sertype_default_desc * __restrict desc);
+void dds_stream_copy_plan_free (struct dds_stream_copy_op *plan);
 void dds_istream_from_serdata_default (dds_istream_t * __restrict s, const struct ddsi_serdata_default * __restrict d);
 void dds_ostream_from_serdata_default (dds_ostream_t * __restrict s, struct ddsi_serdata_default * __restrict d);
 void dds_ostream_add_to_serdata_default (dds_ostream_t * __restrict s, struct ddsi_serdata_default ** __restrict d);
@@ -62,6 +75,13 @@ void dds_stream_extract_keyhash (dds_istream_t * __restrict is, dds_keyhash_t *
 
 void dds_stream_read_key (dds_istream_t * __restrict is, char * __restrict sample, const struct ddsi_sertype_default * __restrict type);
 
+/* Skips the member described by the DDS_OP_ADR instruction at "ops" in the stream,
+   returns a pointer to the next instruction */
+const uint32_t *dds_stream_skip_adr (dds_istream_t * __restrict is, const uint32_t * __restrict ops);
+
+/* Returns a pointer to the instruction following the DDS_OP_ADR instruction at "ops" */
+const uint32_t *dds_stream_skip_adr_insns (const uint32_t * __restrict ops);
+
 size_t dds_stream_print_key (dds_istream_t * __restrict is, const struct ddsi_sertype_default * __restrict type, char * __restrict buf, size_t size);
 
 size_t dds_stream_print_sample (dds_istream_t * __restrict is, const struct ddsi_sertype_default * __restrict type, char * __restrict buf, size_t size);
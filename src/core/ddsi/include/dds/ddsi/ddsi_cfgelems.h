@@ -142,9 +142,15 @@ static struct cfgelem general_cfgelems[] = {
     MEMBER(transport_selector),
     FUNCTIONS(0, uf_transport_selector, 0, pf_transport_selector),
     DESCRIPTION(
-      "<p>This element allows selecting the transport to be used (udp, udp6, "
-      "tcp, tcp6, raweth)</p>"),
-    VALUES("default","udp","udp6","tcp","tcp6","raweth")),
+      "<p>This element allows selecting the transport to be used (udp, "
+      "udp6, tcp, tcp6, raweth, xdp). The xdp transport uses the same wire "
+      "format as raweth, but sends and receives through AF_XDP sockets "
+      "(Linux only). It bypasses the kernel network stack, but each message "
+      "is still copied once between the UMEM frames shared with the kernel "
+      "and the buffers of Cyclone DDS. Like raweth, it does not limit the "
+      "message size to the MTU of the interface, so MaxMessageSize should "
+      "be set accordingly.</p>"),
+    VALUES("default","udp","udp6","tcp","tcp6","raweth","xdp")),
   BOOL("EnableMulticastLoopback", NULL, 1, "true",
     MEMBER(enableMulticastLoopback),
     FUNCTIONS(0, uf_boolean, 0, pf_boolean),
@@ -861,6 +867,29 @@ static struct cfgelem internal_watermarks_cfgelems[] = {
       "mark to current traffic conditions, based on retransmit requests and "
       "transmit pressure.</p>"
     )),
+  STRING("WhcBudget", NULL, 1, "0 B",
+    MEMBER(whc_budget),
+    FUNCTIONS(0, uf_memsize, 0, pf_memsize),
+    DESCRIPTION(
+      "<p>This element sets the maximum amount of unacknowledged data, "
+      "expressed in bytes, in the WHCs of all writers in the domain "
+      "combined; 0 disables the limit. Each writer subject to the "
+      "watermarks is entitled to an equal share of the budget (but at least "
+      "WhcLow). When the budget is exhausted, writers that use more than "
+      "their share are treated as specified by WhcBudgetPolicy, while the "
+      "others can continue.</p>"),
+    UNIT("memsize")),
+  ENUM("WhcBudgetPolicy", NULL, 1, "block",
+    MEMBER(whc_budget_policy),
+    FUNCTIONS(0, uf_whc_budget_policy, 0, pf_whc_budget_policy),
+    DESCRIPTION(
+      "<p>This element controls what happens to a write by a writer that "
+      "uses more than its share of an exhausted WhcBudget:</p>\n"
+      "<ul><li><i>block</i>: the write blocks as if the writer's WHC reached "
+      "the high-water mark, up to the reliability max_blocking_time;</li>\n"
+      "<li><i>shed</i>: the write fails immediately with "
+      "DDS_RETCODE_OUT_OF_RESOURCES.</li></ul>"),
+    VALUES("block","shed")),
   END_MARKER
 };
 
@@ -1256,6 +1285,22 @@ static struct cfgelem internal_cfgelems[] = {
     DESCRIPTION(
       "<p>This element sets the maximum number of extra threads for an "
       "experimental, undocumented and unsupported direct mode.</p>")),
+  BOOL("ShareLoanedSamples", NULL, 1, "false",
+    MEMBER(share_loaned_samples),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether samples obtained by reading or taking "
+      "with a loan (dds_read_wl, dds_take_wl and friends) are handed out by "
+      "reference to a single deserialized copy cached with the received or "
+      "written data, rather than deserialized into the reader's own loan "
+      "buffer on every call. Repeatedly reading the same samples, and "
+      "different readers reading the same samples, then deserializes each "
+      "sample only once. The copy is freed when the data itself is freed, "
+      "which is no earlier than when the last loan referencing it has been "
+      "returned. Loaned samples must then never be modified by the "
+      "application. It only applies to readers without a read condition and "
+      "types that use the default serializer.</p>"
+    )),
   BOOL("SquashParticipants", NULL, 1, "false",
     MEMBER(squash_participants),
     FUNCTIONS(0, uf_boolean, 0, pf_boolean),
@@ -1317,6 +1362,45 @@ static struct cfgelem internal_cfgelems[] = {
       "the application may have to use the dds_write_flush function to "
       "ensure that all samples are written.</p>"
     )),
+  BOOL("WhcRing", NULL, 1, "true",
+    MEMBER(whc_ring),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether volatile writers with a KEEP_ALL "
+      "history and neither a deadline nor a lifespan, which therefore need no "
+      "per-instance administration, store their unacknowledged samples in a "
+      "ring indexed by sequence number instead of the general-purpose writer "
+      "history cache. The ring makes inserting, looking up samples for "
+      "retransmission and dropping acknowledged samples cheap, which "
+      "benefits high-rate reliable writers.</p>"
+    )),
+  INT("AckBatchMaxSamples", NULL, 1, "32",
+    MEMBER(ack_batch_maxsamples),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the maximum number of acknowledged samples a "
+      "reliable writer may keep in its writer history cache before removing "
+      "them. Instead of removing acknowledged samples upon every incoming "
+      "ACKNACK, they are removed in a single operation once this many have "
+      "accumulated, when the application next writes or when the next "
+      "heartbeat event fires. The removal is never postponed when a writer "
+      "is blocked on a full writer history cache, retransmitting data or "
+      "has been deleted. Values of 0 and 1 disable postponing the "
+      "removal.</p>")),
+  INT("RhcLockStripes", NULL, 1, "0",
+    MEMBER(rhc_lock_stripes),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the number of locks over which the instances in "
+      "a reader history cache are distributed, rounded up to a power of two "
+      "and limited to 1024. Storing a sample in an existing, alive instance "
+      "and reading or taking the samples of a single instance then only lock "
+      "the instance's stripe, provided the reader has no read or query "
+      "conditions, no deadline, no sample limit and no samples with a "
+      "finite lifespan, allowing the receive thread and application threads "
+      "to operate on different instances concurrently. All other operations "
+      "lock the entire reader history cache. The default of 0 uses a single "
+      "lock for everything.</p>")),
   BOOL("LivelinessMonitoring", liveliness_monitoring_attrs, 1, "false",
     MEMBER(liveliness_monitoring),
     FUNCTIONS(0, uf_boolean, 0, pf_boolean),
@@ -1364,6 +1448,19 @@ static struct cfgelem internal_cfgelems[] = {
       "on the same thread that prepares them, or is done asynchronously by "
       "another thread.</p>"
     )),
+  BOOL("SendSegmentationOffload", NULL, 1, "false",
+    MEMBER(xpack_send_segmented),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether runs of packets to the same "
+      "destinations, such as the fragments of a large sample, are handed to "
+      "the transport as a single segmented send (UDP generic segmentation "
+      "offload on Linux), where the kernel or the network interface splits "
+      "it into one datagram per segment. Segments are padded to equal size "
+      "where needed. It is only effective if the transport supports it and "
+      "is best combined with a MaxMessageSize that avoids IP fragmentation."
+      "</p>"
+    )),
   STRING("RediscoveryBlacklistDuration", rediscovery_blacklist_duration_attrs, 1, "0s",
     MEMBER(prune_deleted_ppant.delay),
     FUNCTIONS(0, uf_duration_inf, 0, pf_duration),
@@ -1392,6 +1489,87 @@ static struct cfgelem internal_cfgelems[] = {
     "transport (e.g., UDP) and ManySocketsMode not set to single (the "
     "default).</p>"),
     VALUES("false","true","default")),
+  INT("ReceiveBatchSize", NULL, 1, "1",
+    MEMBER(recv_batch_size),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the maximum number of packets a receive thread "
+      "reads from a socket in a single system call (using recvmmsg where "
+      "available) and processes before waiting for new data again. Values "
+      "of 1 or less disable batching, values over 64 are treated as 64. "
+      "Batching reduces the system call overhead at high packet rates. Each "
+      "packet in a batch is received into a receive buffer of its own, so a "
+      "receive thread may use up to ReceiveBatchSize receive buffers (see "
+      "Sizing/ReceiveBufferSize) instead of one; these are allocated on "
+      "first use. It is only used for transports that support it (e.g., "
+      "UDP on Linux).</p>")),
+  BOOL("ReceiveCoalescing", NULL, 1, "false",
+    MEMBER(recv_coalescing),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether the transport may return multiple "
+      "consecutive equal-sized packets from the same source as a single "
+      "buffer (UDP generic receive offload on Linux). The packets then share "
+      "a single receive buffer allocation and are read with a single system "
+      "call, which mostly benefits the reception of large, fragmented "
+      "samples. It requires an RmsgChunkSize of at least 64kB and is only "
+      "used for transports that support it.</p>")),
+  BOOL("KernelReceiveTimestamps", NULL, 1, "false",
+    MEMBER(recv_kernel_timestamps),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether the time of reception of a packet is "
+      "taken from the kernel (SO_TIMESTAMPNS on Linux) rather than from the "
+      "clock when the receive thread starts processing it. The reception "
+      "timestamp is available to the application in the sample info and "
+      "then excludes the time the packet spent queued in the socket. It is "
+      "only used for transports that support it.</p>")),
+  INT("ReceiveShards", NULL, 1, "1",
+    MEMBER(recv_shards),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the number of sockets bound to the unicast data "
+      "port (using SO_REUSEPORT on Linux), each served by a receive thread "
+      "with its own receive buffer pool. The kernel distributes the incoming "
+      "packets over the sockets, allowing the processing of received data "
+      "to be spread over multiple cores. Values over 16 are treated as 16. "
+      "It is only used for transports that support it, with "
+      "ManySocketsMode set to single and MultipleReceiveThreads enabled. "
+      "Note that any process of the same user can bind a socket to the port "
+      "as well.</p>")),
+  BOOL("ReceiveShardSteering", NULL, 1, "false",
+    MEMBER(recv_shard_steering),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls how the packets are distributed over the "
+      "sockets if ReceiveShards is greater than 1. By default the kernel "
+      "selects a socket based on the source and destination addresses, "
+      "enabling this selects it based on the GUID prefix of the sending "
+      "participant instead, so that all traffic of a participant is handled "
+      "by the same receive thread even if it uses multiple sockets for "
+      "sending.</p>")),
+  INT("XdpQueue", NULL, 1, "0",
+    MEMBER(xdp_queue),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the receive queue of the network interface the "
+      "sockets of the xdp transport are bound to. Only frames arriving on "
+      "that queue are received, so the interface should either have a "
+      "single queue or steer the DDSI ethernet types to this queue. Only one "
+      "process can use the xdp transport on an interface at a time, and it "
+      "does not receive the frames sent by other processes on the same "
+      "interface.</p>")),
+  BOOL("XdpGenericMode", NULL, 1, "false",
+    MEMBER(xdp_generic_mode),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element forces the XDP program of the xdp transport to be "
+      "attached in generic (SKB) mode, in which the kernel copies the "
+      "frames into the UMEM. By default native mode and the zero-copy "
+      "support of the driver are tried first, falling back to generic mode "
+      "and copying if the driver does not support them. This only concerns "
+      "the kernel: the xdp transport itself always copies the messages "
+      "between the UMEM and its own buffers.</p>")),
   GROUP("ControlTopic", control_topic_cfgelems, control_topic_cfgattrs, 1,
     NOMEMBER,
     NOFUNCTIONS,
@@ -1755,6 +1933,82 @@ static struct cfgelem discovery_cfgelems[] = {
   END_MARKER
 };
 
+static struct cfgelem shm_cfgelems[] = {
+  BOOL("Enable", NULL, 1, "false",
+    MEMBER(shm_enable),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element enables the exchange of data between readers and "
+      "writers on the same host via shared memory. Writers of types with a "
+      "fixed-size representation publish their data in a shared memory "
+      "segment, and volatile readers of those types in other processes on the "
+      "same host read it from there instead of receiving it over the network. "
+      "Such writers also support loaning samples (dds_loan_sample) and those "
+      "readers hand out references to the shared memory in read/take "
+      "operations that use loans. Shared memory delivery does not retransmit: "
+      "samples can be lost if a reader falls more than SlotsPerWriter samples "
+      "behind.</p>"
+    )),
+  INT("SlotsPerWriter", NULL, 1, "256",
+    MEMBER(shm_slots),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the number of samples in the shared memory "
+      "segment of a writer. Samples that are loaned out or retained in a "
+      "reader history occupy a slot until they are returned or removed from "
+      "the history. The minimum is 2.</p>"
+    )),
+  END_MARKER
+};
+
+static struct cfgelem durability_cfgelems[] = {
+  STRING("StoreDirectory", NULL, 1, "",
+    MEMBER(durable_store_dir),
+    FUNCTIONS(0, uf_string, ff_free, pf_string),
+    DESCRIPTION(
+      "<p>This element specifies the directory in which writers with a "
+      "TRANSIENT or PERSISTENT durability QoS keep their history. If set, "
+      "such writers (and readers) are treated as TRANSIENT_LOCAL, but rather "
+      "than keeping the history in memory, only the unacknowledged samples "
+      "are kept in memory and the history is stored in memory-mapped files "
+      "in a subdirectory per writer. The files of a PERSISTENT writer are "
+      "named after its topic, type and partitions and outlive the process: a "
+      "new writer for the same topic, type and partitions continues from the "
+      "history left by the previous one. Only one writer at a time can use "
+      "these files, others keep their history in memory. The files of a "
+      "TRANSIENT writer are removed when the writer is deleted. If not set, "
+      "TRANSIENT and PERSISTENT writers are treated as VOLATILE.</p>"
+    )),
+  STRING("SegmentSize", NULL, 1, "16 MiB",
+    MEMBER(durable_segment_size),
+    FUNCTIONS(0, uf_memsize, 0, pf_memsize),
+    DESCRIPTION(
+      "<p>This element sets the size of the files in which the history of "
+      "TRANSIENT and PERSISTENT writers is stored. A file is deleted once "
+      "none of the samples in it are part of the history anymore, and the "
+      "remaining samples in files that are mostly unused are moved.</p>"
+    ),
+    UNIT("memsize")),
+  ENUM("SyncPolicy", NULL, 1, "write",
+    MEMBER(durable_sync),
+    FUNCTIONS(0, uf_durable_sync, 0, pf_durable_sync),
+    DESCRIPTION(
+      "<p>This element controls when the history of PERSISTENT writers is "
+      "forced to disk. The files are memory-mapped, so the history always "
+      "survives the process; this only matters for an operating system "
+      "crash or power failure:</p>\n"
+      "<ul><li><i>none</i>: the operating system writes the data back "
+      "whenever it sees fit;</li>\n"
+      "<li><i>segment</i>: a file is synchronised once it is full and when "
+      "the writer is deleted, so that only the most recent changes to the "
+      "history can be lost;</li>\n"
+      "<li><i>write</i>: every sample is synchronised before the write "
+      "completes, as are the removals of samples from the history.</li></ul>\n"
+      "<p>TRANSIENT writers never synchronise their files.</p>"),
+    VALUES("none","segment","write")),
+  END_MARKER
+};
+
 static struct cfgelem tracing_cfgelems[] = {
   LIST("Category|EnableCategory", NULL, 1, "",
     NOMEMBER,
@@ -1931,6 +2185,20 @@ static struct cfgelem domain_cfgelems[] = {
       "<p>The Discovery element allows specifying various parameters related "
       "to the discovery of peers.</p>"
     )),
+  GROUP("Durability", durability_cfgelems, NULL, 1,
+    NOMEMBER,
+    NOFUNCTIONS,
+    DESCRIPTION(
+      "<p>The Durability element controls how the history of writers with a "
+      "TRANSIENT or PERSISTENT durability QoS is stored.</p>"
+    )),
+  GROUP("SharedMemory", shm_cfgelems, NULL, 1,
+    NOMEMBER,
+    NOFUNCTIONS,
+    DESCRIPTION(
+      "<p>The SharedMemory element controls the exchange of data via shared "
+      "memory between processes on the same host.</p>"
+    )),
   GROUP("Tracing", tracing_cfgelems, NULL, 1,
     NOMEMBER,
     NOFUNCTIONS,
@@ -48,6 +48,17 @@ enum ddsi_besmode {
   DDSI_BESMODE_MINIMAL
 };
 
+enum ddsi_whc_budget_policy {
+  DDSI_WHC_BUDGET_BLOCK,
+  DDSI_WHC_BUDGET_SHED
+};
+
+enum ddsi_durable_sync {
+  DDSI_DURABLE_SYNC_NONE,
+  DDSI_DURABLE_SYNC_SEGMENT,
+  DDSI_DURABLE_SYNC_WRITE
+};
+
 enum ddsi_retransmit_merging {
   DDSI_REXMIT_MERGE_NEVER,
   DDSI_REXMIT_MERGE_ADAPTIVE,
@@ -156,7 +167,8 @@ enum ddsi_transport_selector {
   DDSI_TRANS_UDP6,
   DDSI_TRANS_TCP,
   DDSI_TRANS_TCP6,
-  DDSI_TRANS_RAWETH
+  DDSI_TRANS_RAWETH,
+  DDSI_TRANS_XDP
 };
 
 enum ddsi_many_sockets_mode {
@@ -251,13 +263,27 @@ struct ddsi_config
   enum ddsi_retransmit_merging retransmit_merging;
   int64_t retransmit_merging_period;
   int squash_participants;
+  int share_loaned_samples;
   int liveliness_monitoring;
   int noprogress_log_stacktraces;
   int64_t liveliness_monitoring_interval;
   int prioritize_retransmit;
   int xpack_send_async;
+  int xpack_send_segmented;
   enum ddsi_boolean_default multiple_recv_threads;
   unsigned recv_thread_stop_maxretries;
+  unsigned recv_batch_size;
+  int recv_coalescing;
+  int recv_kernel_timestamps;
+  unsigned recv_shards;
+  int recv_shard_steering;
+  unsigned xdp_queue;
+  int xdp_generic_mode;
+  int shm_enable;
+  unsigned shm_slots;
+  char *durable_store_dir;
+  uint32_t durable_segment_size;
+  enum ddsi_durable_sync durable_sync;
 
   unsigned primary_reorder_maxsamples;
   unsigned secondary_reorder_maxsamples;
@@ -324,6 +350,11 @@ struct ddsi_config
   uint32_t whc_highwater_mark;
   struct ddsi_config_maybe_uint32 whc_init_highwater_mark;
   int whc_adaptive;
+  uint32_t whc_budget;
+  enum ddsi_whc_budget_policy whc_budget_policy;
+  int whc_ring;
+  uint32_t ack_batch_maxsamples;
+  uint32_t rhc_lock_stripes;
 
   unsigned defrag_unreliable_maxsamples;
   unsigned defrag_reliable_maxsamples;
@@ -55,6 +55,19 @@ dds_return_t deliver_locally_one (struct ddsi_domaingv *gv, struct entity_common
 
 dds_return_t deliver_locally_allinsync (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, struct local_reader_ary *fastpath_rdary, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, void *vsourceinfo);
 
+/* Maximum number of samples that can be delivered in a single call to one of the
+   batch variants */
+#define DELIVER_LOCALLY_MAX_BATCH 32
+
+/* Batch variants of deliver_locally_one and deliver_locally_allinsync for samples
+   from the same source with the same writer info: each reader gets the samples in
+   one call to ddsi_rhc_store_batch.  Readers that reject a sample get the remaining
+   ones after the fast path has been processed completely, so that unlike the
+   single-sample versions, it never has to be restarted. */
+dds_return_t deliver_locally_one_batch (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, const ddsi_guid_t *rdguid, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, uint32_t n, void * const *vsourceinfos);
+
+dds_return_t deliver_locally_allinsync_batch (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, struct local_reader_ary *fastpath_rdary, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, uint32_t n, void * const *vsourceinfos);
+
 #if defined (__cplusplus)
 }
 #endif
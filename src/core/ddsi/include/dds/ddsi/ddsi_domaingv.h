@@ -50,6 +50,7 @@ struct ddsi_tkmap;
 struct dds_security_context;
 struct dds_security_match_index;
 struct ddsi_hsadmin;
+struct ddsi_shm_domain;
 
 typedef struct config_in_addr_node {
    ddsi_locator_t loc;
@@ -77,6 +78,7 @@ struct recv_thread_arg {
     struct {
       const ddsi_locator_t *loc;
       struct ddsi_tran_conn *conn;
+      uint32_t shard; /* contents of the trigger message */
     } single;
     struct {
       os_sockWaitset ws;
@@ -124,6 +126,12 @@ struct ddsi_domaingv {
   struct ddsi_tran_conn * disc_conn_uc;
   struct ddsi_tran_conn * data_conn_uc;
 
+  /* Unicast data port sharded over multiple connections (ReceiveShards),
+     each with a receive thread of its own; data_conn_uc is the first one */
+#define MAX_RECV_SHARDS 16
+  uint32_t n_data_conn_uc_shards;
+  struct ddsi_tran_conn * data_conn_uc_shards[MAX_RECV_SHARDS];
+
   /* Connection used for all output (for connectionless transports), this
      used to simply be data_conn_uc, but:
 
@@ -225,10 +233,11 @@ struct ddsi_domaingv {
      trigger socket.) Receive buffer pool is per receive thread,
      it is only a global variable because it needs to be freed way later
      than the receive thread itself terminates */
-#define MAX_RECV_THREADS 3
+#define MAX_RECV_THREADS (2 + MAX_RECV_SHARDS)
   uint32_t n_recv_threads;
   struct recv_thread {
     const char *name;
+    char namebuf[16];
     struct thread_state1 *ts;
     struct recv_thread_arg arg;
   } recv_threads[MAX_RECV_THREADS];
@@ -239,6 +248,11 @@ struct ddsi_domaingv {
   /* Flag cleared when stopping (receive threads). FIXME. */
   ddsrt_atomic_uint32_t rtps_keepgoing;
 
+  /* Domain-wide WHC budget: unacknowledged bytes in the WHCs of the
+     writers drawing from it, and the number of such writers */
+  ddsrt_atomic_uint64_t whc_budget_used;
+  ddsrt_atomic_uint32_t whc_budget_nwriters;
+
   /* Start time of the DDSI2 service, for logging relative time stamps,
      should I ever so desire. */
   ddsrt_wctime_t tstart;
@@ -284,6 +298,11 @@ struct ddsi_domaingv {
 
   struct debug_monitor *debmon;
 
+  /* Shared memory delivery between processes on the same host, NULL if
+     disabled; the host id is advertised by endpoints that can use it */
+  struct ddsi_shm_domain *shm;
+  ddsi_keyhash_t shm_hostid;
+
 #ifndef DDS_HAS_NETWORK_CHANNELS
   uint32_t networkQueueId;
   struct thread_state1 *channel_reader_ts;
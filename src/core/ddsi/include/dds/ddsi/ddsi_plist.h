@@ -64,6 +64,7 @@ extern "C" {
 #define PP_IDENTITY_STATUS_TOKEN                ((uint64_t)1 << 36)
 #define PP_DATA_TAGS                            ((uint64_t)1 << 37)
 #define PP_CYCLONE_RECEIVE_BUFFER_SIZE          ((uint64_t)1 << 38)
+#define PP_CYCLONE_SHM_HOSTID                   ((uint64_t)1 << 39)
 
 /* Set for unrecognized parameters that are in the reserved space or
    in our own vendor-specific space that have the
@@ -175,6 +176,14 @@ struct nn_security_info;
 typedef struct nn_security_info nn_security_info_t;
 #endif
 
+typedef struct nn_content_filter_property {
+  char *content_filtered_topic_name;
+  char *related_topic_name;
+  char *filter_class_name;
+  char *filter_expression;
+  ddsi_stringseq_t expression_parameters;
+} nn_content_filter_property_t;
+
 typedef struct nn_adlink_participant_version_info
 {
   uint32_t version;
@@ -202,7 +211,7 @@ typedef struct ddsi_plist {
   nn_count_t participant_manual_liveliness_count;
   uint32_t participant_builtin_endpoints;
   dds_duration_t participant_lease_duration;
-  /* nn_content_filter_property_t content_filter_property; */
+  nn_content_filter_property_t content_filter_property;
   ddsi_guid_t participant_guid;
   ddsi_guid_t endpoint_guid;
   ddsi_guid_t group_guid;
@@ -232,6 +241,7 @@ typedef struct ddsi_plist {
   uint32_t domain_id;
   char *domain_tag;
   uint32_t cyclone_receive_buffer_size;
+  ddsi_keyhash_t cyclone_shm_hostid; /* endpoint reachable via shared memory from this host, see ddsi_shm.h */
 } ddsi_plist_t;
 
 
@@ -46,12 +46,14 @@ struct ddsi_writer_info
 
 typedef void (*ddsi_rhc_free_t) (struct ddsi_rhc *rhc);
 typedef bool (*ddsi_rhc_store_t) (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk);
+typedef uint32_t (*ddsi_rhc_store_batch_t) (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, uint32_t n, struct ddsi_serdata * const * __restrict samples, struct ddsi_tkmap_instance * const * __restrict tks);
 typedef void (*ddsi_rhc_unregister_wr_t) (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo);
 typedef void (*ddsi_rhc_relinquish_ownership_t) (struct ddsi_rhc * __restrict rhc, const uint64_t wr_iid);
 typedef void (*ddsi_rhc_set_qos_t) (struct ddsi_rhc *rhc, const struct dds_qos *qos);
 
 struct ddsi_rhc_ops {
   ddsi_rhc_store_t store;
+  ddsi_rhc_store_batch_t store_batch;
   ddsi_rhc_unregister_wr_t unregister_wr;
   ddsi_rhc_relinquish_ownership_t relinquish_ownership;
   ddsi_rhc_set_qos_t set_qos;
@@ -65,6 +67,12 @@ struct ddsi_rhc {
 DDS_EXPORT inline bool ddsi_rhc_store (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk) {
   return rhc->ops->store (rhc, wrinfo, sample, tk);
 }
+/* Stores samples[0 .. n-1] from the same writer in order, as if by ddsi_rhc_store, but
+   allowing the RHC to lock once and notify the application once.  Stops at the first
+   rejected sample, returns the number of samples stored (n if none was rejected). */
+DDS_EXPORT inline uint32_t ddsi_rhc_store_batch (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, uint32_t n, struct ddsi_serdata * const * __restrict samples, struct ddsi_tkmap_instance * const * __restrict tks) {
+  return rhc->ops->store_batch (rhc, wrinfo, n, samples, tks);
+}
 DDS_EXPORT inline void ddsi_rhc_unregister_wr (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo) {
   rhc->ops->unregister_wr (rhc, wrinfo);
 }
@@ -56,6 +56,11 @@ struct ddsi_serdata {
 
   /* FIXME: can I get rid of this one? */
   ddsrt_mtime_t twrite; /* write time, not source timestamp, set post-throttling */
+
+  /* time of reception from the network: the kernel receive timestamp if the
+     transport provides one, else the time the receive thread started processing
+     the message; invalid (0 in the sample info) for locally written data */
+  ddsrt_wctime_t reception_timestamp;
 };
 
 struct ddsi_serdata_wrapper {
@@ -38,8 +38,16 @@ struct CDRHeader {
   unsigned short options;
 };
 
+struct serdatapool_class {
+  struct nn_freelist freelist; /* also counts the allocations served from it (hits) and those that required a malloc (misses) */
+};
+
 struct serdatapool {
-  struct nn_freelist freelist;
+  uint32_t loan_size; /* 0 for a general pool, else size of the samples in a pool of writer loans */
+  ddsrt_atomic_uint32_t refc; /* pools of loans only: owner + outstanding serdatas */
+  ddsrt_atomic_uint64_t oversize; /* allocations too large for any size class, rare enough for a shared counter */
+  uint32_t nclasses; /* number of size classes, 1 for a pool of loans */
+  struct serdatapool_class classes[];
 };
 
 typedef struct dds_keyhash {
@@ -57,10 +65,17 @@ typedef struct dds_keyhash {
 #define DDSI_SERDATA_DEFAULT_DEBUG_FIELDS
 #endif
 
+struct nn_rmsg;
+
 /* There is an alignment requirement on the raw data (it must be at
    offset mod 8 for the conversion to/from a dds_stream to work).
    So we define two types: one without any additional padding, and
-   one where the appropriate amount of padding is inserted */
+   one where the appropriate amount of padding is inserted.
+
+   A serdata constructed from a received message may reference the
+   payload in the message instead of copying it: then rmsg is the
+   (pinned) message and rdata points to the data following the CDR
+   header, while hdr is a copy of the CDR header and data is unused. */
 #define DDSI_SERDATA_DEFAULT_PREPAD   \
   struct ddsi_serdata c;              \
   uint32_t pos;                       \
@@ -68,6 +83,9 @@ typedef struct dds_keyhash {
   DDSI_SERDATA_DEFAULT_DEBUG_FIELDS   \
   dds_keyhash_t keyhash;              \
   struct serdatapool *serpool;        \
+  ddsrt_atomic_voidp_t shared_sample; \
+  struct nn_rmsg *rmsg;               \
+  const char *rdata;                  \
   struct ddsi_serdata_default *next /* in pool->freelist */
 #define DDSI_SERDATA_DEFAULT_POSTPAD  \
   struct CDRHeader hdr;               \
@@ -119,12 +137,18 @@ struct ddsi_sertype_default_desc {
   ddsi_sertype_default_desc_op_seq_t ops;
 };
 
+struct dds_stream_copy_op;
+
 struct ddsi_sertype_default {
   struct ddsi_sertype c;
   uint16_t native_encoding_identifier; /* (PL_)?CDR_(LE|BE) */
   struct serdatapool *serpool;
   struct ddsi_sertype_default_desc type;
   size_t opt_size;
+  char *meta; /* XML type description from the topic descriptor, may be NULL; not part of the type identity */
+  struct dds_stream_copy_op *copy_plan; /* Partial memcpy plan derived from the ops if opt_size = 0, may be NULL; not part of the type identity */
+  uint32_t cdr_align; /* Largest alignment in the CDR representation, derived from the ops; not part of the type identity */
+  ddsrt_atomic_uint32_t *size_hint; /* Size of the most recently serialized sample, for sizing the next one; allocated separately because it is updated through const pointers, may be NULL; not part of the type identity */
 };
 
 struct ddsi_plist_sample {
@@ -145,8 +169,28 @@ extern DDS_EXPORT const struct ddsi_sertype_ops ddsi_sertype_ops_default;
 extern DDS_EXPORT const struct ddsi_serdata_ops ddsi_serdata_ops_cdr;
 extern DDS_EXPORT const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey;
 
-struct serdatapool * ddsi_serdatapool_new (void);
-void ddsi_serdatapool_free (struct serdatapool * pool);
+DDS_EXPORT struct serdatapool * ddsi_serdatapool_new (void);
+DDS_EXPORT void ddsi_serdatapool_free (struct serdatapool * pool);
+
+/* Pools of loans hold serdatas pre-sized for types with a memcpy-able
+   representation (opt_size != 0), so that a writer can hand out the
+   serdata's payload as the sample and write it without allocating or
+   copying anything.  The pool remains in existence until the owner has
+   released it and all serdatas allocated from it have been freed. */
+struct serdatapool *ddsi_serdatapool_new_loan (const struct ddsi_sertype_default *tp);
+void ddsi_serdatapool_release_loan (struct serdatapool *pool);
+void *ddsi_serdata_default_loan (struct serdatapool *pool, const struct ddsi_sertype_default *tp);
+struct ddsi_serdata *ddsi_serdata_default_from_loan (const struct ddsi_sertype_default *tp, void *sample);
+void ddsi_serdata_default_return_loan (void *sample);
+
+/* Returns the sample contained in a default serdata of kind SDK_DATA,
+   deserializing it on first use and caching the result in the serdata, so
+   that all users of the serdata share a single copy.  The sample remains
+   valid while a reference to the serdata is held.  It is read-only: the same
+   copy is handed to every reader of the data, so modifying it would change the
+   data for all of them.
+   Returns NULL if the serdata is not a default serdata. */
+void *ddsi_serdata_default_shared_sample (struct ddsi_serdata *dcmn);
 
 #if defined (__cplusplus)
 }
@@ -0,0 +1,82 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_SHM_H
+#define DDSI_SHM_H
+
+#include <stdbool.h>
+
+#include "dds/ddsi/ddsi_guid.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct ddsi_sertype;
+struct ddsi_serdata;
+struct ddsi_plist;
+struct ddsi_shm_writer;
+struct ddsi_shm_attachment;
+
+/* Shared memory delivery between processes on the same host
+
+   A writer of a type with a fixed-size representation (one that
+   dds_stream_check_optimize allows to be memcpy'd) creates a POSIX shared
+   memory segment named after its GUID, holding a number of sample slots and
+   a ring mapping sequence numbers to slots.  Samples can be loaned from the
+   segment and written without copying them.
+
+   Volatile readers of such types in other processes on the same host map the
+   segment and get serdatas that reference the slots directly, so the samples
+   handed out by loaning read/take operations point into the segment.  Each
+   process listens on an abstract AF_UNIX datagram socket (the "doorbell")
+   that it registers in the segment, and the writer rings all registered
+   doorbells after publishing a sample.
+
+   Endpoints that can use shared memory advertise the host id in discovery;
+   a writer and a reader use shared memory if both advertise the same id,
+   and the writer then no longer sends the data to the reader over the
+   network.  Delivery via shared memory is best-effort: a slot is reused once
+   no-one references it anymore, and readers that fall too far behind lose
+   samples. */
+
+int ddsi_shm_init (struct ddsi_domaingv *gv);
+int ddsi_shm_start (struct ddsi_domaingv *gv);
+void ddsi_shm_stop (struct ddsi_domaingv *gv);
+void ddsi_shm_fini (struct ddsi_domaingv *gv);
+
+bool ddsi_shm_type_eligible (const struct ddsi_sertype *type);
+bool ddsi_shm_same_host (const struct ddsi_domaingv *gv, const struct ddsi_plist *plist);
+
+struct ddsi_shm_writer *ddsi_shm_writer_new (struct ddsi_domaingv *gv, const ddsi_guid_t *guid, const struct ddsi_sertype *type);
+void ddsi_shm_writer_free (struct ddsi_shm_writer *shm);
+
+/** @brief Loan a sample from the segment, or NULL if all slots are in use */
+void *ddsi_shm_writer_loan (struct ddsi_shm_writer *shm);
+
+/** @brief Return a loan, returns false if sample was not loaned from the segment */
+bool ddsi_shm_writer_return_loan (struct ddsi_shm_writer *shm, const void *sample);
+
+/** @brief Publish d to the attached readers, without copying if sample is a loan */
+void ddsi_shm_writer_publish (struct ddsi_shm_writer *shm, const struct ddsi_serdata *d, const void *sample);
+
+struct ddsi_shm_attachment *ddsi_shm_attach (struct ddsi_domaingv *gv, const ddsi_guid_t *pwr_guid, const struct ddsi_sertype *type);
+void ddsi_shm_detach (struct ddsi_domaingv *gv, struct ddsi_shm_attachment *att);
+
+/** @brief Pointer to the sample in shared memory referenced by d, or NULL if d is of another kind */
+void *ddsi_serdata_shm_sample (const struct ddsi_serdata *d);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
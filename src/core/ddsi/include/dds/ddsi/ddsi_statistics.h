@@ -14,15 +14,19 @@
 
 #include <stdint.h>
 
+#include "dds/export.h"
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
 
 struct reader;
 struct writer;
+struct serdatapool;
 
-void ddsi_get_writer_stats (struct writer *wr, uint64_t * __restrict rexmit_bytes, uint32_t * __restrict throttle_count, uint64_t * __restrict time_throttled, uint64_t * __restrict time_retransmit);
+void ddsi_get_writer_stats (struct writer *wr, uint64_t * __restrict rexmit_bytes, uint32_t * __restrict throttle_count, uint64_t * __restrict time_throttled, uint64_t * __restrict time_retransmit, uint64_t * __restrict unacked_bytes);
 void ddsi_get_reader_stats (struct reader *rd, uint64_t * __restrict discarded_bytes);
+DDS_EXPORT void ddsi_get_serdatapool_stats (struct serdatapool *pool, uint64_t * __restrict hits, uint64_t * __restrict misses);
 
 #if defined (__cplusplus)
 }
@@ -16,6 +16,7 @@
 
 #include "dds/ddsrt/ifaddrs.h"
 #include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/time.h"
 #include "dds/ddsi/ddsi_locator.h"
 
 #if defined (__cplusplus)
@@ -48,10 +49,28 @@ typedef struct ddsi_tran_listener * ddsi_tran_listener_t;
 typedef struct ddsi_tran_factory * ddsi_tran_factory_t;
 typedef struct ddsi_tran_qos ddsi_tran_qos_t;
 
+/* Buffer descriptor for reading multiple messages in one call: buf and len
+   are set by the caller, sz, segsize, timestamp and srcloc are filled in for
+   each message read.  If segsize is not 0, buf holds multiple coalesced
+   messages from the same source, each of segsize bytes except for the last
+   one.  Timestamp is the time of reception according to the kernel, or
+   DDSRT_WCTIME_INVALID if not available. */
+struct ddsi_tran_recvbuf {
+  unsigned char *buf;
+  size_t len;
+  size_t sz;
+  size_t segsize;
+  ddsrt_wctime_t timestamp;
+  ddsi_locator_t srcloc;
+};
+
 /* Function pointer types */
 
 typedef ssize_t (*ddsi_tran_read_fn_t) (ddsi_tran_conn_t, unsigned char *, size_t, bool, ddsi_locator_t *);
+typedef ssize_t (*ddsi_tran_read_multiple_fn_t) (ddsi_tran_conn_t, size_t, struct ddsi_tran_recvbuf *);
 typedef ssize_t (*ddsi_tran_write_fn_t) (ddsi_tran_conn_t, const ddsi_locator_t *, size_t, const ddsrt_iovec_t *, uint32_t);
+typedef ssize_t (*ddsi_tran_write_multiple_fn_t) (ddsi_tran_conn_t, size_t, const ddsi_locator_t *, size_t, const ddsrt_iovec_t *, uint32_t);
+typedef ssize_t (*ddsi_tran_write_segmented_fn_t) (ddsi_tran_conn_t, const ddsi_locator_t *, size_t, const ddsrt_iovec_t *, uint32_t, size_t);
 typedef int (*ddsi_tran_locator_fn_t) (ddsi_tran_factory_t, ddsi_tran_base_t, ddsi_locator_t *);
 typedef bool (*ddsi_tran_supports_fn_t) (const struct ddsi_tran_factory *, int32_t);
 typedef ddsrt_socket_t (*ddsi_tran_handle_fn_t) (ddsi_tran_base_t);
@@ -116,7 +135,10 @@ struct ddsi_tran_conn
   /* Functions */
 
   ddsi_tran_read_fn_t m_read_fn;
+  ddsi_tran_read_multiple_fn_t m_read_multiple_fn; /* optional: null if not supported */
   ddsi_tran_write_fn_t m_write_fn;
+  ddsi_tran_write_multiple_fn_t m_write_multiple_fn; /* optional: null if not supported */
+  ddsi_tran_write_segmented_fn_t m_write_segmented_fn; /* optional: null if not supported */
   ddsi_tran_peer_locator_fn_t m_peer_locator_fn;
   ddsi_tran_disable_multiplexing_fn_t m_disable_multiplexing_fn;
   ddsi_tran_locator_fn_t m_locator_fn;
@@ -125,6 +147,8 @@ struct ddsi_tran_conn
 
   bool m_server;
   bool m_connless;
+  bool m_coalesced_read; /* only read_multiple may be used: it returns coalesced messages */
+  bool m_read_timestamps; /* read_multiple returns kernel receive timestamps */
   bool m_stream;
   bool m_closed;
   ddsrt_atomic_uint32_t m_count;
@@ -183,6 +207,7 @@ struct ddsi_tran_factory
   const char *m_default_spdp_address;
   bool m_connless;
   bool m_stream;
+  bool m_supports_shards; /* unicast receive conns can be sharded (see ddsi_tran_qos) */
   struct ddsi_domaingv *gv;
 
   /* Relationships */
@@ -196,10 +221,17 @@ enum ddsi_tran_qos_purpose {
   DDSI_TRAN_QOS_RECV_MC
 };
 
+/* A unicast receive port can be sharded over m_nshards > 1 conns, each
+   receiving a subset of the incoming messages.  The shards must be created in
+   order of m_shard, the first one determining the port if none is specified.
+   A one-byte message containing the shard index is delivered to that shard,
+   which is used for waking up the receive threads. */
 struct ddsi_tran_qos
 {
   enum ddsi_tran_qos_purpose m_purpose;
   int m_diffserv;
+  uint32_t m_shard;
+  uint32_t m_nshards;
 };
 
 void ddsi_tran_factories_fini (struct ddsi_domaingv *gv);
@@ -253,6 +285,31 @@ inline ssize_t ddsi_conn_write (ddsi_tran_conn_t conn, const ddsi_locator_t *dst
 inline ssize_t ddsi_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc) {
   return conn->m_closed ? -1 : conn->m_read_fn (conn, buf, len, allow_spurious, srcloc);
 }
+inline bool ddsi_conn_supports_write_multiple (const struct ddsi_tran_conn *conn) {
+  return conn->m_write_multiple_fn != 0;
+}
+/* Sends the same message to each of the ndst destinations; returns the number
+   of destinations it was sent to, or -1 on error */
+inline ssize_t ddsi_conn_write_multiple (ddsi_tran_conn_t conn, size_t ndst, const ddsi_locator_t *dsts, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags) {
+  return conn->m_closed ? -1 : (conn->m_write_multiple_fn) (conn, ndst, dsts, niov, iov, flags);
+}
+inline bool ddsi_conn_supports_write_segmented (const struct ddsi_tran_conn *conn) {
+  return conn->m_write_segmented_fn != 0;
+}
+/* Sends a sequence of messages of segsize bytes each (except for the last one,
+   which may be shorter) to dst, with segment boundaries coinciding with iovec
+   boundaries; returns the number of bytes sent, or -1 on error */
+inline ssize_t ddsi_conn_write_segmented (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags, size_t segsize) {
+  return conn->m_closed ? -1 : (conn->m_write_segmented_fn) (conn, dst, niov, iov, flags, segsize);
+}
+inline bool ddsi_conn_supports_read_multiple (const struct ddsi_tran_conn *conn) {
+  return conn->m_read_multiple_fn != 0;
+}
+/* Reads at most nbufs messages, blocking until at least one is available;
+   returns the number of messages read, 0 on a spurious wakeup and -1 on error */
+inline ssize_t ddsi_conn_read_multiple (ddsi_tran_conn_t conn, size_t nbufs, struct ddsi_tran_recvbuf *bufs) {
+  return conn->m_closed ? -1 : conn->m_read_multiple_fn (conn, nbufs, bufs);
+}
 bool ddsi_conn_peer_locator (ddsi_tran_conn_t conn, ddsi_locator_t * loc);
 void ddsi_conn_disable_multiplexing (ddsi_tran_conn_t conn);
 void ddsi_conn_add_ref (ddsi_tran_conn_t conn);
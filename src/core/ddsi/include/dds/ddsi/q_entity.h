@@ -47,6 +47,8 @@ struct ddsi_sertype;
 struct whc;
 struct dds_qos;
 struct ddsi_plist;
+struct ddsi_shm_writer;
+struct ddsi_shm_attachment;
 struct lease;
 struct participant_sec_attributes;
 struct proxy_participant_sec_attributes;
@@ -128,6 +130,7 @@ struct wr_prd_match {
   unsigned has_replied_to_hb: 1; /* we must keep sending HBs until all readers have this set */
   unsigned all_have_replied_to_hb: 1; /* true iff 'has_replied_to_hb' for all readers in subtree */
   unsigned is_reliable: 1; /* true iff reliable proxy reader */
+  unsigned via_shm: 1; /* true iff proxy reader gets the data via shared memory */
   seqno_t min_seq; /* smallest ack'd seq nr in subtree */
   seqno_t max_seq; /* sort-of highest ack'd seq nr in subtree (see augment function) */
   seqno_t seq; /* highest acknowledged seq nr */
@@ -142,6 +145,8 @@ struct wr_prd_match {
   ddsrt_wctime_t hb_to_ack_latency_tlastlog;
   uint32_t non_responsive_count;
   uint32_t rexmit_requests;
+  struct ddsi_cdrfilter *filter; /* content filter of the proxy reader compiled for the writer's type, or NULL */
+  seqno_t filter_gapstart; /* first of the samples filtered out since the last one sent to the reader, 0 if none */
 #ifdef DDS_HAS_SECURITY
   int64_t crypto_handle;
 #endif
@@ -180,6 +185,7 @@ struct pwr_rd_match {
   unsigned directed_heartbeat : 1; /* set on receipt of a directed heartbeat, cleared on sending an ACKNACK */
   unsigned nack_sent_on_nackdelay : 1; /* set when the most recent NACK sent was because of the NackDelay  */
   unsigned filtered : 1;
+  unsigned via_shm : 1; /* set if the data is delivered from the writer's shared memory segment */
   union {
     struct {
       seqno_t end_of_tl_seq; /* when seq >= end_of_tl_seq, it's in sync, =0 when not tl */
@@ -294,6 +300,7 @@ struct writer
   seqno_t cs_seq; /* 1st seq in coherent set (or 0) */
   seq_xmit_t seq_xmit; /* last sequence number actually transmitted */
   seqno_t min_local_readers_reject_seq; /* mimum of local_readers->last_deliv_seq */
+  seqno_t whc_drop_seq; /* max_drop_seq last passed to the WHC; acks beyond it are pending */
   nn_count_t hbcount; /* last hb seq number */
   nn_count_t hbfragcount; /* last hb frag seq number */
   int throttling; /* non-zero when some thread is waiting for the WHC to shrink */
@@ -305,6 +312,7 @@ struct writer
   unsigned include_keyhash: 1; /* iff 1, this writer includes a keyhash; keyless topics => include_keyhash = 0 */
   unsigned force_md5_keyhash: 1; /* iff 1, when keyhash has to be hashed, no matter the size */
   unsigned retransmitting: 1; /* iff 1, this writer is currently retransmitting */
+  unsigned in_whc_budget: 1; /* iff 1, this writer draws from the domain-wide WHC budget */
   unsigned alive: 1; /* iff 1, the writer is alive (lease for this writer is not expired); field may be modified only when holding both wr->e.lock and wr->c.pp->e.lock */
   unsigned test_ignore_acknack : 1; /* iff 1, the writer ignores all arriving ACKNACK messages */
   unsigned test_suppress_retransmit : 1; /* iff 1, the writer does not respond to retransmit requests */
@@ -316,12 +324,14 @@ struct writer
 #endif
   uint32_t alive_vclock; /* virtual clock counting transitions between alive/not-alive */
   const struct ddsi_sertype * type; /* type of the data written by this writer */
+  struct ddsi_shm_writer *shm; /* shared memory segment for same-host readers, or NULL */
   struct addrset *as; /* set of addresses to publish to */
   struct addrset *as_group; /* alternate case, used for SPDP, when using Cloud with multiple bootstrap locators */
   struct xevent *heartbeat_xevent; /* timed event for "periodically" publishing heartbeats when unack'd data present, NULL <=> unreliable */
   struct ldur_fhnode *lease_duration; /* fibheap node to keep lease duration for this writer, NULL in case of automatic liveliness with inifite duration  */
   struct whc *whc; /* WHC tracking history, T-L durability service history + samples by sequence number for retransmit */
   uint32_t whc_low, whc_high; /* watermarks for WHC in bytes (counting only unack'd data) */
+  size_t whc_budget_bytes; /* unack'd bytes accounted in the domain-wide WHC budget */
   ddsrt_etime_t t_rexmit_start;
   ddsrt_etime_t t_rexmit_end; /* time of last 1->0 transition of "retransmitting" */
   ddsrt_etime_t t_whc_high_upd; /* time "whc_high" was last updated for controlled ramp-up of throughput */
@@ -329,6 +339,7 @@ struct writer
   uint32_t rexmit_burst_size_limit; /* derived from reader's receive_buffer_size */
   uint32_t num_readers; /* total number of matching PROXY readers */
   uint32_t num_reliable_readers; /* number of matching reliable PROXY readers */
+  uint32_t num_filtered_readers; /* number of matching PROXY readers with a content filter */
   ddsrt_avl_tree_t readers; /* all matching PROXY readers, see struct wr_prd_match */
   ddsrt_avl_tree_t local_readers; /* all matching LOCAL readers, see struct wr_rd_match */
 #ifdef DDS_HAS_NETWORK_PARTITIONS
@@ -373,6 +384,7 @@ struct reader
   struct dds_qos *xqos;
   unsigned reliable: 1; /* 1 iff reader is reliable */
   unsigned handle_as_transient_local: 1; /* 1 iff reader wants historical data from proxy writers */
+  unsigned shm_capable: 1; /* 1 iff reader can take data from shared memory segments of same-host writers */
 #ifdef DDS_HAS_SSM
   unsigned favours_ssm: 1; /* iff 1, this reader favours SSM */
 #endif
@@ -381,6 +393,7 @@ struct reader
   struct addrset *as;
 #endif
   const struct ddsi_sertype * type; /* type of the data read by this reader */
+  nn_content_filter_property_t *content_filter; /* content filter advertised to remote writers, or NULL */
   uint32_t num_writers; /* total number of matching PROXY writers */
   ddsrt_avl_tree_t writers; /* all matching PROXY writers, see struct rd_pwr_match */
   ddsrt_avl_tree_t local_writers; /* all matching LOCAL writers, see struct rd_wr_match */
@@ -448,6 +461,7 @@ struct proxy_endpoint_common
   ddsi_guid_t group_guid; /* 0:0:0:0 if not available */
   nn_vendorid_t vendor; /* cached from proxypp->vendor */
   seqno_t seq; /* sequence number of most recent SEDP message */
+  bool shm_same_host; /* advertised shared memory host id equals ours */
 #ifdef DDS_HAS_TYPE_DISCOVERY
   type_identifier_t type_id; /* type identifier for for type used by this proxy endpoint */
   const struct ddsi_sertype * type; /* sertype for data this endpoint reads/writes */
@@ -486,6 +500,8 @@ struct proxy_writer {
   struct nn_dqueue *dqueue; /* delivery queue for asynchronous delivery (historical data is always delivered asynchronously) */
   struct xeventq *evq; /* timed event queue to be used for ACK generation */
   struct local_reader_ary rdary; /* LOCAL readers for fast-pathing; if not fast-pathed, fall back to scanning local_readers */
+  struct local_reader_ary shm_rdary; /* LOCAL readers served from the writer's shared memory segment, these are not in rdary */
+  struct ddsi_shm_attachment *shm; /* mapping of the writer's shared memory segment, or NULL */
   ddsi2direct_directread_cb_t ddsi2direct_cb;
   void *ddsi2direct_cbarg;
   struct lease *lease;
@@ -505,6 +521,7 @@ struct proxy_reader {
   ddsrt_avl_tree_t writers; /* matching LOCAL writers */
   uint32_t receive_buffer_size; /* assumed receive buffer size inherited from proxypp */
   filter_fn_t filter;
+  nn_content_filter_property_t *content_filter; /* content filter advertised in discovery, or NULL */
 };
 
 DDS_EXPORT extern const ddsrt_avl_treedef_t wr_readers_treedef;
@@ -678,7 +695,7 @@ DDS_EXPORT struct writer *get_builtin_writer (const struct participant *pp, unsi
    writer/reader already known. */
 
 dds_return_t new_writer (struct writer **wr_out, struct ddsi_guid *wrguid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct whc * whc, status_cb_t status_cb, void *status_cb_arg);
-dds_return_t new_reader (struct reader **rd_out, struct ddsi_guid *rdguid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc * rhc, status_cb_t status_cb, void *status_cb_arg);
+dds_return_t new_reader (struct reader **rd_out, struct ddsi_guid *rdguid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc * rhc, status_cb_t status_cb, void *status_cb_arg, const nn_content_filter_property_t *content_filter);
 
 void update_reader_qos (struct reader *rd, const struct dds_qos *xqos);
 void update_writer_qos (struct writer *wr, const struct dds_qos *xqos);
@@ -686,10 +703,15 @@ void update_writer_qos (struct writer *wr, const struct dds_qos *xqos);
 struct whc_node;
 struct whc_state;
 unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, struct whc_node **deferred_free_list);
+unsigned remove_pending_acked_messages (struct writer *wr, struct whc_state *whcst, struct whc_node **deferred_free_list);
+bool writer_may_defer_remove_acked_messages (const struct writer *wr);
 seqno_t writer_max_drop_seq (const struct writer *wr);
+bool durability_handled_as_transient_local (const struct ddsi_domaingv *gv, dds_durability_kind_t kind);
 int writer_must_have_hb_scheduled (const struct writer *wr, const struct whc_state *whcst);
 void writer_set_retransmitting (struct writer *wr);
 void writer_clear_retransmitting (struct writer *wr);
+void writer_update_whc_budget (struct writer *wr, const struct whc_state *whcst);
+bool writer_over_whc_budget (const struct writer *wr, const struct whc_state *whcst);
 dds_return_t writer_wait_for_acks (struct writer *wr, const ddsi_guid_t *rdguid, dds_time_t abstimeout);
 
 dds_return_t unblock_throttled_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *guid);
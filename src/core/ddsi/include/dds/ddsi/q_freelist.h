@@ -36,7 +36,7 @@ extern "C" {
 #if FREELIST_TYPE == FREELIST_NONE
 
 struct nn_freelist {
-  char dummy;
+  ddsrt_atomic_uint64_t misses;
 };
 
 #elif FREELIST_TYPE == FREELIST_ATOMIC_LIFO
@@ -46,6 +46,8 @@ struct nn_freelist {
   ddsrt_atomic_uint32_t count;
   uint32_t max;
   size_t linkoff;
+  ddsrt_atomic_uint64_t hits;
+  ddsrt_atomic_uint64_t misses;
 };
 
 #elif FREELIST_TYPE == FREELIST_DOUBLE
@@ -63,6 +65,8 @@ struct nn_freelist1 {
   ddsrt_mutex_t lock;
   uint32_t count;
   struct nn_freelistM *m;
+  uint64_t hits; /* pops that returned an element, protected by lock */
+  uint64_t misses; /* pops that returned NULL, protected by lock */
 };
 
 struct nn_freelist {
@@ -73,6 +77,7 @@ struct nn_freelist {
   struct nn_freelistM *emlist;
   uint32_t count;
   uint32_t max;
+  uint32_t magsize; /* number of entries used in a magazine, less than NN_FREELIST_MAGSIZE for small max */
   size_t linkoff;
 };
 
@@ -83,6 +88,7 @@ void nn_freelist_fini (struct nn_freelist *fl, void (*free) (void *elem));
 bool nn_freelist_push (struct nn_freelist *fl, void *elem);
 void *nn_freelist_pushmany (struct nn_freelist *fl, void *first, void *last, uint32_t n);
 void *nn_freelist_pop (struct nn_freelist *fl);
+void nn_freelist_stats (struct nn_freelist *fl, uint64_t *hits, uint64_t *misses);
 
 #if defined (__cplusplus)
 }
@@ -12,6 +12,8 @@
 #ifndef Q_SOCKWAITSET_H
 #define Q_SOCKWAITSET_H
 
+#include "dds/export.h"
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
@@ -27,13 +29,13 @@ struct ddsi_tran_conn;
   the wait set using the Wait and NextEvent functions in a single handling
   loop.
 */
-os_sockWaitset os_sockWaitsetNew (void);
+DDS_EXPORT os_sockWaitset os_sockWaitsetNew (void);
 
 /*
   Frees the waitset WS. Any connections associated with it will
   be closed.
 */
-void os_sockWaitsetFree (os_sockWaitset ws);
+DDS_EXPORT void os_sockWaitsetFree (os_sockWaitset ws);
 
 /*
   Triggers the waitset, from any thread.  It is level
@@ -50,7 +52,7 @@ void os_sockWaitsetFree (os_sockWaitset ws);
   Shared state updates preceding os_sockWaitsetTrigger are visible
   following os_sockWaitsetWait.
 */
-void os_sockWaitsetTrigger (os_sockWaitset ws);
+DDS_EXPORT void os_sockWaitsetTrigger (os_sockWaitset ws);
 
 /*
   A connection may be associated with only one waitset at any time, and
@@ -62,7 +64,7 @@ void os_sockWaitsetTrigger (os_sockWaitset ws);
 
   Returns < 0 on error, 0 if already present, 1 if added
 */
-int os_sockWaitsetAdd (os_sockWaitset ws, struct ddsi_tran_conn * conn);
+DDS_EXPORT int os_sockWaitsetAdd (os_sockWaitset ws, struct ddsi_tran_conn * conn);
 
 /*
   Drops all connections from the waitset from index onwards. Index
@@ -70,7 +72,7 @@ int os_sockWaitsetAdd (os_sockWaitset ws, struct ddsi_tran_conn * conn);
   the second, etc. Behaviour is undefined when called after a successful wait
   but before all events had been enumerated.
 */
-void os_sockWaitsetPurge (os_sockWaitset ws, unsigned index);
+DDS_EXPORT void os_sockWaitsetPurge (os_sockWaitset ws, unsigned index);
 
 /*
   Waits until some of the connections in WS have data to be read.
@@ -84,7 +86,7 @@ void os_sockWaitsetPurge (os_sockWaitset ws, unsigned index);
   Shared state updates preceding os_sockWaitsetTrigger are visible
   following os_sockWaitsetWait.
 */
-os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws);
+DDS_EXPORT os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws);
 
 /*
   Returns the index of the next triggered connection in the
@@ -99,10 +101,10 @@ os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws);
   If the return value is >= 0, *conn contains the connection on which
   data is available.
 */
-int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, struct ddsi_tran_conn ** conn);
+DDS_EXPORT int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, struct ddsi_tran_conn ** conn);
 
 /* Remove connection */
-void os_sockWaitsetRemove (os_sockWaitset ws, struct ddsi_tran_conn * conn);
+DDS_EXPORT void os_sockWaitsetRemove (os_sockWaitset ws, struct ddsi_tran_conn * conn);
 
 #if defined (__cplusplus)
 }
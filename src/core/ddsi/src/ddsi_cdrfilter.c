@@ -0,0 +1,1235 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+#include <math.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/strtol.h"
+#include "dds/ddsrt/strtod.h"
+#include "dds/ddsrt/xmlparser.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_cdrstream.h"
+#include "dds/ddsi/ddsi_cdrfilter.h"
+#include "dds/ddsc/dds_public_impl.h"
+
+/* Upper bound on the number of distinct fields an expression can reference, this
+   bounds the stack space needed for evaluating it */
+#define CF_MAX_FIELDS 32
+
+/* Upper bound on the nesting depth of struct-typed members in the type description,
+   guards against reference cycles in malformed descriptions */
+#define CF_MAX_DEPTH 32
+
+/*************************************
+ **
+ ** Type description
+ **
+ *************************************/
+
+struct cf_xnode {
+  char *tag;
+  char *name;
+  struct cf_xnode *parent;
+  struct cf_xnode *children;
+  struct cf_xnode *next;
+};
+
+struct cf_xparse {
+  struct cf_xnode *root;
+};
+
+static void cf_xnode_free (struct cf_xnode *n)
+{
+  while (n)
+  {
+    struct cf_xnode *next = n->next;
+    cf_xnode_free (n->children);
+    ddsrt_free (n->tag);
+    ddsrt_free (n->name);
+    ddsrt_free (n);
+    n = next;
+  }
+}
+
+static int cf_xml_elem_open (void *varg, uintptr_t parentinfo, uintptr_t *eleminfo, const char *name, int line)
+{
+  struct cf_xparse * const xp = varg;
+  struct cf_xnode * const parent = (struct cf_xnode *) parentinfo;
+  struct cf_xnode *n = ddsrt_malloc (sizeof (*n));
+  struct cf_xnode **pp;
+  (void) line;
+  n->tag = ddsrt_strdup (name);
+  n->name = NULL;
+  n->parent = parent;
+  n->children = NULL;
+  n->next = NULL;
+  pp = parent ? &parent->children : &xp->root;
+  while (*pp)
+    pp = &(*pp)->next;
+  *pp = n;
+  *eleminfo = (uintptr_t) n;
+  return 0;
+}
+
+static int cf_xml_attr (void *varg, uintptr_t eleminfo, const char *name, const char *value, int line)
+{
+  struct cf_xnode * const n = (struct cf_xnode *) eleminfo;
+  (void) varg; (void) line;
+  if (strcmp (name, "name") == 0 && n->name == NULL)
+    n->name = ddsrt_strdup (value);
+  return 0;
+}
+
+static void cf_xml_error (void *varg, const char *msg, int line)
+{
+  (void) varg; (void) msg; (void) line;
+}
+
+static bool cf_is_named_type (const struct cf_xnode *n)
+{
+  return n->name && (strcmp (n->tag, "Struct") == 0 || strcmp (n->tag, "Union") == 0 || strcmp (n->tag, "Enum") == 0 || strcmp (n->tag, "TypeDef") == 0);
+}
+
+/* Compares the scoped name of type definition "n" with "name", which is absolute
+   (but without the leading "::") */
+static bool cf_scoped_name_eq (const struct cf_xnode *n, const char *name, size_t len)
+{
+  /* work backwards: the name of n must be a suffix of name, preceded by "::" and
+     the scoped name of the enclosing module/struct, or nothing if n is at the root */
+  while (n && n->name)
+  {
+    const size_t nl = strlen (n->name);
+    if (nl > len || memcmp (name + len - nl, n->name, nl) != 0)
+      return false;
+    len -= nl;
+    /* types defined inside a struct are nested in the member that uses it */
+    for (n = n->parent; n && strcmp (n->tag, "Member") == 0; n = n->parent)
+      ;
+    if (n && n->name)
+    {
+      if (len < 2 || memcmp (name + len - 2, "::", 2) != 0)
+        return false;
+      len -= 2;
+    }
+  }
+  return len == 0 && (n == NULL || n->name == NULL);
+}
+
+static const struct cf_xnode *cf_find_type_abs (const struct cf_xnode *n, const char *name, size_t len)
+{
+  for (; n; n = n->next)
+  {
+    const struct cf_xnode *m;
+    if (cf_is_named_type (n) && cf_scoped_name_eq (n, name, len))
+      return n;
+    if ((m = cf_find_type_abs (n->children, name, len)) != NULL)
+      return m;
+  }
+  return NULL;
+}
+
+/* Looks up a type by name as referenced from within "scope", following the IDL rule
+   that a relative name is looked up in the enclosing scopes, from the inside out */
+static const struct cf_xnode *cf_find_type (const struct cf_xnode *root, const struct cf_xnode *scope, const char *name)
+{
+  const struct cf_xnode *n;
+  char *abs;
+  if (strncmp (name, "::", 2) == 0)
+    return cf_find_type_abs (root, name + 2, strlen (name + 2));
+  for (; scope; scope = scope->parent)
+  {
+    if (scope->name == NULL || strcmp (scope->tag, "Member") == 0)
+      continue;
+    /* construct scoped name of scope (we're working from inside out, so prepend) */
+    const struct cf_xnode *s;
+    size_t sz = strlen (name) + 1;
+    for (s = scope; s && s->name; s = s->parent)
+      if (strcmp (s->tag, "Member") != 0)
+        sz += strlen (s->name) + 2;
+    abs = ddsrt_malloc (sz);
+    abs[0] = 0;
+    for (s = scope; s && s->name; s = s->parent)
+    {
+      if (strcmp (s->tag, "Member") == 0)
+        continue;
+      const size_t nl = strlen (s->name), al = strlen (abs);
+      memmove (abs + nl + 2, abs, al + 1);
+      memcpy (abs, s->name, nl);
+      memcpy (abs + nl, "::", 2);
+    }
+    (void) ddsrt_strlcat (abs, name, sz);
+    n = cf_find_type_abs (root, abs, strlen (abs));
+    ddsrt_free (abs);
+    if (n)
+      return n;
+  }
+  return cf_find_type_abs (root, name, strlen (name));
+}
+
+enum cf_ftype {
+  CFT_BOOL,
+  CFT_CHAR,
+  CFT_U8,
+  CFT_I16,
+  CFT_U16,
+  CFT_I32,
+  CFT_U32,
+  CFT_I64,
+  CFT_U64,
+  CFT_F32,
+  CFT_F64,
+  CFT_STR,
+  /* members that can't be filtered on, these only need to be skipped */
+  CFT_SEQ,
+  CFT_ARR,
+  CFT_UNI,
+  CFT_OTHER
+};
+
+struct cf_leaf {
+  char *path;
+  enum cf_ftype ftype;
+};
+
+struct cf_leaves {
+  uint32_t n, size;
+  struct cf_leaf *xs;
+};
+
+static void cf_leaves_fini (struct cf_leaves *ls)
+{
+  for (uint32_t i = 0; i < ls->n; i++)
+    ddsrt_free (ls->xs[i].path);
+  ddsrt_free (ls->xs);
+}
+
+static void cf_leaves_add (struct cf_leaves *ls, const char *prefix, const char *name, enum cf_ftype ftype)
+{
+  if (ls->n == ls->size)
+  {
+    ls->size = ls->size ? 2 * ls->size : 8;
+    ls->xs = ddsrt_realloc (ls->xs, ls->size * sizeof (*ls->xs));
+  }
+  struct cf_leaf *l = &ls->xs[ls->n++];
+  if (*prefix)
+    (void) ddsrt_asprintf (&l->path, "%s.%s", prefix, name);
+  else
+    l->path = ddsrt_strdup (name);
+  l->ftype = ftype;
+}
+
+static enum cf_ftype cf_tag_ftype (const char *tag)
+{
+  static const struct { const char *tag; enum cf_ftype ftype; } map[] = {
+    { "Boolean", CFT_BOOL }, { "Char", CFT_CHAR }, { "Octet", CFT_U8 },
+    { "Short", CFT_I16 }, { "UShort", CFT_U16 }, { "Long", CFT_I32 }, { "ULong", CFT_U32 },
+    { "LongLong", CFT_I64 }, { "ULongLong", CFT_U64 }, { "Float", CFT_F32 }, { "Double", CFT_F64 },
+    { "String", CFT_STR }, { "Enum", CFT_U32 },
+    { "Sequence", CFT_SEQ }, { "Array", CFT_ARR }, { "Union", CFT_UNI }
+  };
+  for (size_t i = 0; i < sizeof (map) / sizeof (map[0]); i++)
+    if (strcmp (tag, map[i].tag) == 0)
+      return map[i].ftype;
+  return CFT_OTHER;
+}
+
+static dds_return_t cf_flatten_struct (struct cf_leaves *ls, const struct cf_xnode *root, const struct cf_xnode *stru, const char *prefix, int depth);
+
+/* Appends the leaves for a member of type "t" (the type element in the Member, or a
+   TypeDef) to ls, struct-typed members are expanded because the IDL compiler inlines
+   the marshalling instructions for those */
+static dds_return_t cf_flatten_type (struct cf_leaves *ls, const struct cf_xnode *root, const struct cf_xnode *t, const char *prefix, const char *name, int depth)
+{
+  if (depth > CF_MAX_DEPTH)
+    return DDS_RETCODE_UNSUPPORTED;
+  while (t && strcmp (t->tag, "Type") == 0)
+  {
+    if (t->name == NULL || (t = cf_find_type (root, t->parent, t->name)) == NULL)
+      return DDS_RETCODE_UNSUPPORTED;
+    if (strcmp (t->tag, "TypeDef") == 0)
+    {
+      t = t->children;
+      if (++depth > CF_MAX_DEPTH)
+        return DDS_RETCODE_UNSUPPORTED;
+    }
+  }
+  if (t == NULL)
+    return DDS_RETCODE_UNSUPPORTED;
+  else if (strcmp (t->tag, "Struct") == 0)
+  {
+    char *p;
+    dds_return_t ret;
+    if (*prefix)
+      (void) ddsrt_asprintf (&p, "%s.%s", prefix, name);
+    else
+      p = ddsrt_strdup (name);
+    ret = cf_flatten_struct (ls, root, t, p, depth + 1);
+    ddsrt_free (p);
+    return ret;
+  }
+  else
+  {
+    cf_leaves_add (ls, prefix, name, cf_tag_ftype (t->tag));
+    return DDS_RETCODE_OK;
+  }
+}
+
+static dds_return_t cf_flatten_struct (struct cf_leaves *ls, const struct cf_xnode *root, const struct cf_xnode *stru, const char *prefix, int depth)
+{
+  for (const struct cf_xnode *m = stru->children; m; m = m->next)
+  {
+    dds_return_t ret;
+    if (strcmp (m->tag, "Member") != 0)
+      continue;
+    if (m->name == NULL)
+      return DDS_RETCODE_UNSUPPORTED;
+    if ((ret = cf_flatten_type (ls, root, m->children, prefix, m->name, depth)) != DDS_RETCODE_OK)
+      return ret;
+  }
+  return DDS_RETCODE_OK;
+}
+
+static dds_return_t cf_get_leaves (struct cf_leaves *ls, const struct ddsi_sertype_default *type)
+{
+  static const struct ddsrt_xmlp_callbacks cb = {
+    .elem_open = cf_xml_elem_open,
+    .attr = cf_xml_attr,
+    .elem_data = 0,
+    .elem_close = 0,
+    .error = cf_xml_error
+  };
+  struct cf_xparse xp = { .root = NULL };
+  struct ddsrt_xmlp_state *st;
+  const struct cf_xnode *stru;
+  dds_return_t ret;
+  int xret;
+
+  if (type->meta == NULL)
+    return DDS_RETCODE_UNSUPPORTED;
+  st = ddsrt_xmlp_new_string (type->meta, &xp, &cb);
+  xret = ddsrt_xmlp_parse (st);
+  ddsrt_xmlp_free (st);
+  if (xret < 0 || xp.root == NULL)
+    ret = DDS_RETCODE_UNSUPPORTED;
+  else if ((stru = cf_find_type (xp.root, NULL, type->c.type_name)) == NULL || strcmp (stru->tag, "Struct") != 0)
+    ret = DDS_RETCODE_UNSUPPORTED;
+  else
+    ret = cf_flatten_struct (ls, xp.root, stru, "", 0);
+  cf_xnode_free (xp.root);
+  return ret;
+}
+
+static bool cf_ftype_matches_op (enum cf_ftype ftype, uint32_t insn)
+{
+  switch (ftype)
+  {
+    case CFT_BOOL: case CFT_CHAR: case CFT_U8:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_1BY;
+    case CFT_I16: case CFT_U16:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_2BY;
+    case CFT_I32: case CFT_U32: case CFT_F32:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_4BY;
+    case CFT_I64: case CFT_U64: case CFT_F64:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_8BY;
+    case CFT_STR:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_STR || DDS_OP_TYPE (insn) == DDS_OP_VAL_BST;
+    case CFT_SEQ:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_SEQ;
+    case CFT_ARR:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_ARR;
+    case CFT_UNI:
+      return DDS_OP_TYPE (insn) == DDS_OP_VAL_UNI;
+    case CFT_OTHER:
+      return false;
+  }
+  return false;
+}
+
+/*************************************
+ **
+ ** Filter representation
+ **
+ *************************************/
+
+enum cf_vtype { CFV_INT, CFV_UINT, CFV_DBL, CFV_STR };
+
+struct cf_value {
+  enum cf_vtype vtype;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    struct { const char *p; uint32_t n; } s;
+  } u;
+};
+
+enum cf_relop { CFR_EQ, CFR_NE, CFR_LT, CFR_LE, CFR_GT, CFR_GE };
+
+enum cf_opcode {
+  CFOP_CMP,   /* acc := a relop b */
+  CFOP_LIKE,  /* acc := a LIKE b */
+  CFOP_NOT,   /* acc := !acc */
+  CFOP_JF,    /* if !acc then goto target */
+  CFOP_JT     /* if acc then goto target */
+};
+
+/* Operands with CF_CONST set refer to the constant table, otherwise to a field slot */
+#define CF_CONST 0x8000u
+
+struct cf_insn {
+  uint8_t opcode;
+  uint8_t relop;
+  uint16_t a, b;
+  uint32_t target;
+};
+
+/* Extraction step: skips the member described by the ADR instruction at "ops", or
+   loads it into field slot "slot" */
+struct cf_step {
+  const uint32_t *ops;
+  int32_t slot;
+  enum cf_ftype ftype;
+};
+
+struct ddsi_cdrfilter {
+  char *expression;
+  uint32_t nparams;
+  char **params;
+  uint32_t nsteps;
+  struct cf_step *steps;
+  uint32_t ninsns;
+  struct cf_insn *insns;
+  uint32_t nconsts;
+  struct cf_value *consts;
+};
+
+/*************************************
+ **
+ ** Compiler
+ **
+ *************************************/
+
+enum cf_tok {
+  CFTOK_END,
+  CFTOK_ERROR,
+  CFTOK_LPAREN,
+  CFTOK_RPAREN,
+  CFTOK_RELOP,
+  CFTOK_AND,
+  CFTOK_OR,
+  CFTOK_NOT,
+  CFTOK_BETWEEN,
+  CFTOK_LIKE,
+  CFTOK_FIELD,
+  CFTOK_CONST
+};
+
+struct cf_field {
+  uint32_t leaf;
+  enum cf_ftype ftype;
+};
+
+struct cf_compiler {
+  const char *src;
+  const char *pos;
+  uint32_t nparams;
+  const char * const *params;
+
+  enum cf_tok tok;
+  enum cf_relop relop;
+  uint16_t operand; /* field slot or constant index for CFTOK_FIELD/CFTOK_CONST */
+
+  const struct ddsi_sertype_default *type;
+  const struct cf_leaves *leaves;
+  uint32_t nfields;
+  struct cf_field fields[CF_MAX_FIELDS];
+
+  uint32_t ninsns, insns_size;
+  struct cf_insn *insns;
+  uint32_t nconsts, consts_size;
+  struct cf_value *consts;
+  dds_return_t ret;
+};
+
+static void cf_error (struct cf_compiler *c, dds_return_t ret)
+{
+  if (c->ret == DDS_RETCODE_OK)
+    c->ret = ret;
+  c->tok = CFTOK_ERROR;
+}
+
+static uint16_t cf_add_const (struct cf_compiler *c, const struct cf_value *v)
+{
+  if (c->nconsts == c->consts_size)
+  {
+    c->consts_size = c->consts_size ? 2 * c->consts_size : 8;
+    c->consts = ddsrt_realloc (c->consts, c->consts_size * sizeof (*c->consts));
+  }
+  c->consts[c->nconsts] = *v;
+  return (uint16_t) (CF_CONST | c->nconsts++);
+}
+
+static uint32_t cf_emit (struct cf_compiler *c, enum cf_opcode opcode, enum cf_relop relop, uint16_t a, uint16_t b)
+{
+  if (c->ninsns == c->insns_size)
+  {
+    c->insns_size = c->insns_size ? 2 * c->insns_size : 16;
+    c->insns = ddsrt_realloc (c->insns, c->insns_size * sizeof (*c->insns));
+  }
+  struct cf_insn *insn = &c->insns[c->ninsns];
+  insn->opcode = (uint8_t) opcode;
+  insn->relop = (uint8_t) relop;
+  insn->a = a;
+  insn->b = b;
+  insn->target = 0;
+  return c->ninsns++;
+}
+
+/* Parses a string literal starting at the opening quote, returns a pointer just
+   past the closing quote or NULL on error; the unescaped contents are stored in a
+   newly allocated string */
+static const char *cf_lex_string (const char *p, char **str, uint32_t *len)
+{
+  size_t n = 0;
+  char *s = ddsrt_malloc (strlen (p) + 1);
+  assert (*p == '\'');
+  p++;
+  while (*p)
+  {
+    if (*p != '\'')
+      s[n++] = *p++;
+    else if (p[1] == '\'')
+    {
+      s[n++] = '\'';
+      p += 2;
+    }
+    else
+    {
+      s[n] = 0;
+      *str = s;
+      *len = (uint32_t) n;
+      return p + 1;
+    }
+  }
+  ddsrt_free (s);
+  return NULL;
+}
+
+/* Parses a numeric literal, returns a pointer just past it or NULL on error */
+static const char *cf_lex_number (const char *p, struct cf_value *v)
+{
+  const char *q = p;
+  bool isfloat = false;
+  char *end;
+  if (*q == '-' || *q == '+')
+    q++;
+  if (q[0] == '0' && (q[1] == 'x' || q[1] == 'X'))
+  {
+    for (q += 2; isxdigit ((unsigned char) *q); q++)
+      ;
+  }
+  else
+  {
+    for (; isdigit ((unsigned char) *q); q++)
+      ;
+    if (*q == '.')
+    {
+      isfloat = true;
+      for (q++; isdigit ((unsigned char) *q); q++)
+        ;
+    }
+    if (*q == 'e' || *q == 'E')
+    {
+      isfloat = true;
+      q++;
+      if (*q == '-' || *q == '+')
+        q++;
+      for (; isdigit ((unsigned char) *q); q++)
+        ;
+    }
+  }
+  if (isalnum ((unsigned char) *q) || *q == '_')
+    return NULL;
+  if (isfloat)
+  {
+    double d;
+    if (ddsrt_strtod (p, &end, &d) != DDS_RETCODE_OK || end != q)
+      return NULL;
+    v->vtype = CFV_DBL;
+    v->u.d = d;
+  }
+  else if (*p == '-')
+  {
+    long long ll;
+    if (ddsrt_strtoll (p, &end, 0, &ll) != DDS_RETCODE_OK || end != q)
+      return NULL;
+    v->vtype = CFV_INT;
+    v->u.i = ll;
+  }
+  else
+  {
+    unsigned long long ull;
+    if (ddsrt_strtoull (p, &end, 0, &ull) != DDS_RETCODE_OK || end != q)
+      return NULL;
+    v->vtype = CFV_UINT;
+    v->u.u = ull;
+  }
+  return q;
+}
+
+/* Parses a literal that makes up the entirety of "p", returns false if it isn't one */
+static bool cf_lex_literal (const char *p, struct cf_value *v)
+{
+  const char *q;
+  char *s;
+  uint32_t n;
+  while (isspace ((unsigned char) *p))
+    p++;
+  if (*p == '\'')
+  {
+    if ((q = cf_lex_string (p, &s, &n)) == NULL)
+      return false;
+    v->vtype = CFV_STR;
+    v->u.s.p = s;
+    v->u.s.n = n;
+  }
+  else if (ddsrt_strncasecmp (p, "TRUE", 4) == 0 || ddsrt_strncasecmp (p, "FALSE", 5) == 0)
+  {
+    const bool t = (ddsrt_strncasecmp (p, "TRUE", 4) == 0);
+    q = p + (t ? 4 : 5);
+    v->vtype = CFV_UINT;
+    v->u.u = t;
+  }
+  else if ((q = cf_lex_number (p, v)) == NULL)
+    return false;
+  while (isspace ((unsigned char) *q))
+    q++;
+  if (*q == 0)
+    return true;
+  if (v->vtype == CFV_STR)
+    ddsrt_free ((char *) v->u.s.p);
+  return false;
+}
+
+static void cf_lex_field (struct cf_compiler *c, const char *p, size_t len)
+{
+  uint32_t leaf, i;
+  for (leaf = 0; leaf < c->leaves->n; leaf++)
+    if (strlen (c->leaves->xs[leaf].path) == len && memcmp (c->leaves->xs[leaf].path, p, len) == 0)
+      break;
+  if (leaf == c->leaves->n)
+  {
+    cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+    return;
+  }
+  if (c->leaves->xs[leaf].ftype >= CFT_SEQ)
+  {
+    cf_error (c, DDS_RETCODE_UNSUPPORTED);
+    return;
+  }
+  for (i = 0; i < c->nfields; i++)
+    if (c->fields[i].leaf == leaf)
+      break;
+  if (i == c->nfields)
+  {
+    if (c->nfields == CF_MAX_FIELDS)
+    {
+      cf_error (c, DDS_RETCODE_UNSUPPORTED);
+      return;
+    }
+    c->fields[i].leaf = leaf;
+    c->fields[i].ftype = c->leaves->xs[leaf].ftype;
+    c->nfields++;
+  }
+  c->tok = CFTOK_FIELD;
+  c->operand = (uint16_t) i;
+}
+
+static void cf_next (struct cf_compiler *c)
+{
+  static const struct { const char *kw; enum cf_tok tok; } kws[] = {
+    { "AND", CFTOK_AND }, { "OR", CFTOK_OR }, { "NOT", CFTOK_NOT }, { "BETWEEN", CFTOK_BETWEEN }, { "LIKE", CFTOK_LIKE }
+  };
+  const char *p = c->pos;
+  struct cf_value v;
+  if (c->tok == CFTOK_ERROR)
+    return;
+  while (isspace ((unsigned char) *p))
+    p++;
+  switch (*p)
+  {
+    case 0: c->tok = CFTOK_END; break;
+    case '(': c->tok = CFTOK_LPAREN; p++; break;
+    case ')': c->tok = CFTOK_RPAREN; p++; break;
+    case '=': c->tok = CFTOK_RELOP; c->relop = CFR_EQ; p++; break;
+    case '<':
+      c->tok = CFTOK_RELOP;
+      if (p[1] == '>') { c->relop = CFR_NE; p += 2; }
+      else if (p[1] == '=') { c->relop = CFR_LE; p += 2; }
+      else { c->relop = CFR_LT; p++; }
+      break;
+    case '>':
+      c->tok = CFTOK_RELOP;
+      if (p[1] == '=') { c->relop = CFR_GE; p += 2; }
+      else { c->relop = CFR_GT; p++; }
+      break;
+    case '!':
+      if (p[1] != '=')
+        goto err;
+      c->tok = CFTOK_RELOP;
+      c->relop = CFR_NE;
+      p += 2;
+      break;
+    case '\'': {
+      char *s;
+      uint32_t n;
+      if ((p = cf_lex_string (p, &s, &n)) == NULL)
+        goto err;
+      v.vtype = CFV_STR;
+      v.u.s.p = s;
+      v.u.s.n = n;
+      c->tok = CFTOK_CONST;
+      c->operand = cf_add_const (c, &v);
+      break;
+    }
+    case '%': {
+      char *end;
+      long long ll;
+      if (!isdigit ((unsigned char) p[1]) || ddsrt_strtoll (p + 1, &end, 10, &ll) != DDS_RETCODE_OK || ll >= (long long) c->nparams || c->params[ll] == NULL)
+        goto err;
+      p = end;
+      /* a parameter that is not a literal is taken to be an unquoted string */
+      if (!cf_lex_literal (c->params[ll], &v))
+      {
+        v.vtype = CFV_STR;
+        v.u.s.n = (uint32_t) strlen (c->params[ll]);
+        v.u.s.p = ddsrt_strdup (c->params[ll]);
+      }
+      c->tok = CFTOK_CONST;
+      c->operand = cf_add_const (c, &v);
+      break;
+    }
+    default:
+      if (isdigit ((unsigned char) *p) || ((*p == '-' || *p == '+' || *p == '.') && (isdigit ((unsigned char) p[1]) || p[1] == '.')))
+      {
+        if ((p = cf_lex_number (p, &v)) == NULL)
+          goto err;
+        c->tok = CFTOK_CONST;
+        c->operand = cf_add_const (c, &v);
+      }
+      else if (isalpha ((unsigned char) *p) || *p == '_')
+      {
+        const char *q = p;
+        while (isalnum ((unsigned char) *q) || *q == '_' || (*q == '.' && (isalpha ((unsigned char) q[1]) || q[1] == '_')))
+          q++;
+        const size_t len = (size_t) (q - p);
+        size_t i;
+        for (i = 0; i < sizeof (kws) / sizeof (kws[0]); i++)
+          if (strlen (kws[i].kw) == len && ddsrt_strncasecmp (p, kws[i].kw, len) == 0)
+            break;
+        if (i < sizeof (kws) / sizeof (kws[0]))
+          c->tok = kws[i].tok;
+        else if ((len == 4 && ddsrt_strncasecmp (p, "TRUE", 4) == 0) || (len == 5 && ddsrt_strncasecmp (p, "FALSE", 5) == 0))
+        {
+          v.vtype = CFV_UINT;
+          v.u.u = (len == 4);
+          c->tok = CFTOK_CONST;
+          c->operand = cf_add_const (c, &v);
+        }
+        else
+        {
+          cf_lex_field (c, p, len);
+        }
+        p = q;
+      }
+      else
+      {
+        goto err;
+      }
+      break;
+  }
+  c->pos = p;
+  return;
+err:
+  cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+}
+
+static bool cf_operand_is_string (const struct cf_compiler *c, uint16_t x)
+{
+  if (x & CF_CONST)
+    return c->consts[x & ~CF_CONST].vtype == CFV_STR;
+  else
+    return c->fields[x].ftype == CFT_STR || c->fields[x].ftype == CFT_CHAR;
+}
+
+static bool cf_parse_operand (struct cf_compiler *c, uint16_t *x)
+{
+  if (c->tok != CFTOK_FIELD && c->tok != CFTOK_CONST)
+  {
+    cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+    return false;
+  }
+  *x = c->operand;
+  cf_next (c);
+  return true;
+}
+
+static void cf_emit_cmp (struct cf_compiler *c, enum cf_relop relop, uint16_t a, uint16_t b)
+{
+  if (cf_operand_is_string (c, a) != cf_operand_is_string (c, b))
+    cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+  else if ((a & CF_CONST) && (b & CF_CONST))
+    cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+  else
+    (void) cf_emit (c, CFOP_CMP, relop, a, b);
+}
+
+static void cf_parse_or (struct cf_compiler *c);
+
+static void cf_parse_predicate (struct cf_compiler *c)
+{
+  uint16_t a, b, lo, hi;
+  bool neg = false;
+  if (c->tok == CFTOK_LPAREN)
+  {
+    cf_next (c);
+    cf_parse_or (c);
+    if (c->tok != CFTOK_RPAREN)
+      cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+    cf_next (c);
+    return;
+  }
+  if (!cf_parse_operand (c, &a))
+    return;
+  if (c->tok == CFTOK_RELOP)
+  {
+    const enum cf_relop relop = c->relop;
+    cf_next (c);
+    if (cf_parse_operand (c, &b))
+      cf_emit_cmp (c, relop, a, b);
+    return;
+  }
+  if (c->tok == CFTOK_NOT)
+  {
+    neg = true;
+    cf_next (c);
+  }
+  switch (c->tok)
+  {
+    case CFTOK_BETWEEN: {
+      cf_next (c);
+      if (!cf_parse_operand (c, &lo))
+        return;
+      if (c->tok != CFTOK_AND)
+      {
+        cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+        return;
+      }
+      cf_next (c);
+      if (!cf_parse_operand (c, &hi))
+        return;
+      cf_emit_cmp (c, CFR_GE, a, lo);
+      const uint32_t jf = cf_emit (c, CFOP_JF, CFR_EQ, 0, 0);
+      cf_emit_cmp (c, CFR_LE, a, hi);
+      c->insns[jf].target = c->ninsns;
+      break;
+    }
+    case CFTOK_LIKE: {
+      cf_next (c);
+      if (!cf_parse_operand (c, &b))
+        return;
+      if ((a & CF_CONST) || !cf_operand_is_string (c, a) || !(b & CF_CONST) || !cf_operand_is_string (c, b))
+        cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+      else
+        (void) cf_emit (c, CFOP_LIKE, CFR_EQ, a, b);
+      break;
+    }
+    default:
+      cf_error (c, DDS_RETCODE_BAD_PARAMETER);
+      return;
+  }
+  if (neg)
+    (void) cf_emit (c, CFOP_NOT, CFR_EQ, 0, 0);
+}
+
+static void cf_parse_not (struct cf_compiler *c)
+{
+  if (c->tok == CFTOK_NOT)
+  {
+    cf_next (c);
+    cf_parse_not (c);
+    (void) cf_emit (c, CFOP_NOT, CFR_EQ, 0, 0);
+  }
+  else
+  {
+    cf_parse_predicate (c);
+  }
+}
+
+/* AND and OR short-circuit: the accumulator holds the value of the left operand when
+   jumping to the end, and that is the value of the whole term */
+static void cf_parse_and (struct cf_compiler *c)
+{
+  uint32_t j = UINT32_MAX;
+  cf_parse_not (c);
+  while (c->tok == CFTOK_AND)
+  {
+    cf_next (c);
+    const uint32_t jf = cf_emit (c, CFOP_JF, CFR_EQ, 0, 0);
+    c->insns[jf].target = j;
+    j = jf;
+    cf_parse_not (c);
+  }
+  while (j != UINT32_MAX && c->ret == DDS_RETCODE_OK)
+  {
+    const uint32_t nj = c->insns[j].target;
+    c->insns[j].target = c->ninsns;
+    j = nj;
+  }
+}
+
+static void cf_parse_or (struct cf_compiler *c)
+{
+  uint32_t j = UINT32_MAX;
+  cf_parse_and (c);
+  while (c->tok == CFTOK_OR)
+  {
+    cf_next (c);
+    const uint32_t jt = cf_emit (c, CFOP_JT, CFR_EQ, 0, 0);
+    c->insns[jt].target = j;
+    j = jt;
+    cf_parse_and (c);
+  }
+  while (j != UINT32_MAX && c->ret == DDS_RETCODE_OK)
+  {
+    const uint32_t nj = c->insns[j].target;
+    c->insns[j].target = c->ninsns;
+    j = nj;
+  }
+}
+
+static dds_return_t cf_make_steps (struct ddsi_cdrfilter *f, const struct cf_compiler *c)
+{
+  const uint32_t *ops = c->type->type.ops.ops;
+  uint32_t last = 0, leaf;
+  for (uint32_t i = 0; i < c->nfields; i++)
+    if (c->fields[i].leaf > last)
+      last = c->fields[i].leaf;
+  f->nsteps = (c->nfields == 0) ? 0 : last + 1;
+  f->steps = ddsrt_malloc ((f->nsteps ? f->nsteps : 1) * sizeof (*f->steps));
+  /* Evaluation locates fields by position in the instruction stream, so the leaves
+     from the meta data must map 1:1 and in order onto the top-level instructions;
+     checking all of them (rather than only those up to the last referenced field)
+     catches meta data that is inconsistent with the ops */
+  for (leaf = 0; leaf < c->leaves->n; leaf++)
+  {
+    if (DDS_OP (*ops) != DDS_OP_ADR || !cf_ftype_matches_op (c->leaves->xs[leaf].ftype, *ops))
+      return DDS_RETCODE_UNSUPPORTED;
+    if (leaf < f->nsteps)
+    {
+      f->steps[leaf].ops = ops;
+      f->steps[leaf].slot = -1;
+      f->steps[leaf].ftype = c->leaves->xs[leaf].ftype;
+    }
+    ops = dds_stream_skip_adr_insns (ops);
+  }
+  if (DDS_OP (*ops) != DDS_OP_RTS)
+    return DDS_RETCODE_UNSUPPORTED;
+  for (uint32_t i = 0; i < c->nfields; i++)
+    f->steps[c->fields[i].leaf].slot = (int32_t) i;
+  return DDS_RETCODE_OK;
+}
+
+static void cf_free_consts (uint32_t n, struct cf_value *consts)
+{
+  for (uint32_t i = 0; i < n; i++)
+    if (consts[i].vtype == CFV_STR)
+      ddsrt_free ((char *) consts[i].u.s.p);
+  ddsrt_free (consts);
+}
+
+dds_return_t ddsi_cdrfilter_compile (struct ddsi_cdrfilter **filter, const struct ddsi_sertype_default *type, const char *expression, uint32_t nparams, const char * const *params)
+{
+  struct cf_leaves leaves = { .n = 0, .size = 0, .xs = NULL };
+  struct cf_compiler c;
+  struct ddsi_cdrfilter *f;
+  dds_return_t ret;
+
+  if (expression == NULL || (nparams > 0 && params == NULL))
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((ret = cf_get_leaves (&leaves, type)) != DDS_RETCODE_OK)
+  {
+    cf_leaves_fini (&leaves);
+    return ret;
+  }
+
+  memset (&c, 0, sizeof (c));
+  c.src = c.pos = expression;
+  c.nparams = nparams;
+  c.params = params;
+  c.type = type;
+  c.leaves = &leaves;
+  c.ret = DDS_RETCODE_OK;
+  c.tok = CFTOK_END;
+  cf_next (&c);
+  cf_parse_or (&c);
+  if (c.tok != CFTOK_END)
+    cf_error (&c, DDS_RETCODE_BAD_PARAMETER);
+
+  f = ddsrt_malloc (sizeof (*f));
+  f->expression = ddsrt_strdup (expression);
+  f->nparams = nparams;
+  f->params = ddsrt_malloc ((nparams ? nparams : 1) * sizeof (*f->params));
+  for (uint32_t i = 0; i < nparams; i++)
+    f->params[i] = params[i] ? ddsrt_strdup (params[i]) : NULL;
+  f->ninsns = c.ninsns;
+  f->insns = c.insns;
+  f->nconsts = c.nconsts;
+  f->consts = c.consts;
+  f->steps = NULL;
+  if ((ret = c.ret) == DDS_RETCODE_OK)
+    ret = cf_make_steps (f, &c);
+  cf_leaves_fini (&leaves);
+  if (ret != DDS_RETCODE_OK)
+  {
+    ddsi_cdrfilter_free (f);
+    return ret;
+  }
+  *filter = f;
+  return DDS_RETCODE_OK;
+}
+
+void ddsi_cdrfilter_get_expression (const struct ddsi_cdrfilter *filter, const char **expression, uint32_t *nparams, char * const **params)
+{
+  *expression = filter->expression;
+  *nparams = filter->nparams;
+  *params = filter->params;
+}
+
+void ddsi_cdrfilter_free (struct ddsi_cdrfilter *filter)
+{
+  for (uint32_t i = 0; i < filter->nparams; i++)
+    ddsrt_free (filter->params[i]);
+  ddsrt_free (filter->params);
+  ddsrt_free (filter->expression);
+  cf_free_consts (filter->nconsts, filter->consts);
+  ddsrt_free (filter->insns);
+  ddsrt_free (filter->steps);
+  ddsrt_free (filter);
+}
+
+/*************************************
+ **
+ ** Evaluation
+ **
+ *************************************/
+
+static void cf_load (dds_istream_t *is, enum cf_ftype ftype, struct cf_value *v)
+{
+  static const uint8_t sizes[] = {
+    [CFT_BOOL] = 1, [CFT_CHAR] = 1, [CFT_U8] = 1, [CFT_I16] = 2, [CFT_U16] = 2,
+    [CFT_I32] = 4, [CFT_U32] = 4, [CFT_I64] = 8, [CFT_U64] = 8, [CFT_F32] = 4, [CFT_F64] = 8,
+    [CFT_STR] = 4, [CFT_SEQ] = 1, [CFT_ARR] = 1, [CFT_UNI] = 1, [CFT_OTHER] = 1
+  };
+  const uint32_t sz = sizes[ftype];
+  union { uint8_t u8; uint16_t u16; uint32_t u32; uint64_t u64; float f; double d; } x;
+  is->m_index = (is->m_index + sz - 1) & ~(sz - 1);
+  assert (is->m_index + sz <= is->m_size);
+  memcpy (&x, is->m_buffer + is->m_index, sz);
+  is->m_index += sz;
+  switch (ftype)
+  {
+    case CFT_BOOL: case CFT_U8:
+      v->vtype = CFV_UINT; v->u.u = x.u8; break;
+    case CFT_CHAR:
+      v->vtype = CFV_STR; v->u.s.p = (const char *) is->m_buffer + is->m_index - 1; v->u.s.n = 1; break;
+    case CFT_I16:
+      v->vtype = CFV_INT; v->u.i = (int16_t) x.u16; break;
+    case CFT_U16:
+      v->vtype = CFV_UINT; v->u.u = x.u16; break;
+    case CFT_I32:
+      v->vtype = CFV_INT; v->u.i = (int32_t) x.u32; break;
+    case CFT_U32:
+      v->vtype = CFV_UINT; v->u.u = x.u32; break;
+    case CFT_I64:
+      v->vtype = CFV_INT; v->u.i = (int64_t) x.u64; break;
+    case CFT_U64:
+      v->vtype = CFV_UINT; v->u.u = x.u64; break;
+    case CFT_F32:
+      v->vtype = CFV_DBL; v->u.d = x.f; break;
+    case CFT_F64:
+      v->vtype = CFV_DBL; v->u.d = x.d; break;
+    case CFT_STR:
+      /* length includes the terminating 0 */
+      assert (x.u32 >= 1 && is->m_index + x.u32 <= is->m_size);
+      v->vtype = CFV_STR; v->u.s.p = (const char *) is->m_buffer + is->m_index; v->u.s.n = x.u32 - 1;
+      is->m_index += x.u32;
+      break;
+    case CFT_SEQ: case CFT_ARR: case CFT_UNI: case CFT_OTHER:
+      assert (0);
+      break;
+  }
+}
+
+static double cf_todouble (const struct cf_value *v)
+{
+  switch (v->vtype)
+  {
+    case CFV_INT: return (double) v->u.i;
+    case CFV_UINT: return (double) v->u.u;
+    case CFV_DBL: return v->u.d;
+    case CFV_STR: break;
+  }
+  assert (0);
+  return 0.0;
+}
+
+/* Returns -1, 0 or 1 for a < b, a = b and a > b, or 2 if a and b are unordered */
+static int cf_compare (const struct cf_value *a, const struct cf_value *b)
+{
+  if (a->vtype == CFV_STR)
+  {
+    assert (b->vtype == CFV_STR);
+    const int c = memcmp (a->u.s.p, b->u.s.p, (a->u.s.n < b->u.s.n) ? a->u.s.n : b->u.s.n);
+    if (c != 0)
+      return (c < 0) ? -1 : 1;
+    return (a->u.s.n == b->u.s.n) ? 0 : (a->u.s.n < b->u.s.n) ? -1 : 1;
+  }
+  else if (a->vtype == CFV_DBL || b->vtype == CFV_DBL)
+  {
+    const double x = cf_todouble (a), y = cf_todouble (b);
+    if (isnan (x) || isnan (y))
+      return 2;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+  }
+  else if (a->vtype == b->vtype)
+  {
+    if (a->vtype == CFV_INT)
+      return (a->u.i < b->u.i) ? -1 : (a->u.i > b->u.i) ? 1 : 0;
+    else
+      return (a->u.u < b->u.u) ? -1 : (a->u.u > b->u.u) ? 1 : 0;
+  }
+  else if (a->vtype == CFV_INT)
+  {
+    if (a->u.i < 0)
+      return -1;
+    return ((uint64_t) a->u.i < b->u.u) ? -1 : ((uint64_t) a->u.i > b->u.u) ? 1 : 0;
+  }
+  else
+  {
+    if (b->u.i < 0)
+      return 1;
+    return (a->u.u < (uint64_t) b->u.i) ? -1 : (a->u.u > (uint64_t) b->u.i) ? 1 : 0;
+  }
+}
+
+static bool cf_relop_holds (enum cf_relop relop, int c)
+{
+  if (c == 2)
+    return relop == CFR_NE;
+  switch (relop)
+  {
+    case CFR_EQ: return c == 0;
+    case CFR_NE: return c != 0;
+    case CFR_LT: return c < 0;
+    case CFR_LE: return c <= 0;
+    case CFR_GT: return c > 0;
+    case CFR_GE: return c >= 0;
+  }
+  return false;
+}
+
+/* SQL LIKE: '%' matches any sequence of characters, '_' any single character */
+static bool cf_like (const char *s, uint32_t n, const char *p, uint32_t m)
+{
+  uint32_t i = 0, j = 0, star_j = UINT32_MAX, star_i = 0;
+  while (i < n)
+  {
+    if (j < m && (p[j] == '_' || p[j] == s[i]))
+    {
+      i++; j++;
+    }
+    else if (j < m && p[j] == '%')
+    {
+      star_j = j++;
+      star_i = i;
+    }
+    else if (star_j != UINT32_MAX)
+    {
+      j = star_j + 1;
+      i = ++star_i;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  while (j < m && p[j] == '%')
+    j++;
+  return j == m;
+}
+
+bool ddsi_cdrfilter_eval (const struct ddsi_cdrfilter *filter, const struct ddsi_serdata *sample)
+{
+  struct cf_value slots[CF_MAX_FIELDS];
+  dds_istream_t is;
+  uint32_t pc;
+  bool acc = true;
+
+  /* invalid samples carry only the key and can't be filtered on content */
+  if (sample->kind != SDK_DATA)
+    return true;
+  dds_istream_from_serdata_default (&is, (const struct ddsi_serdata_default *) sample);
+  for (uint32_t i = 0; i < filter->nsteps; i++)
+  {
+    const struct cf_step * const s = &filter->steps[i];
+    if (s->slot < 0)
+      (void) dds_stream_skip_adr (&is, s->ops);
+    else
+      cf_load (&is, s->ftype, &slots[s->slot]);
+  }
+
+#define CF_OPERAND(x) (((x) & CF_CONST) ? &filter->consts[(x) & ~CF_CONST] : &slots[(x)])
+  pc = 0;
+  while (pc < filter->ninsns)
+  {
+    const struct cf_insn * const insn = &filter->insns[pc++];
+    switch ((enum cf_opcode) insn->opcode)
+    {
+      case CFOP_CMP:
+        acc = cf_relop_holds ((enum cf_relop) insn->relop, cf_compare (CF_OPERAND (insn->a), CF_OPERAND (insn->b)));
+        break;
+      case CFOP_LIKE: {
+        const struct cf_value *a = CF_OPERAND (insn->a), *b = CF_OPERAND (insn->b);
+        acc = cf_like (a->u.s.p, a->u.s.n, b->u.s.p, b->u.s.n);
+        break;
+      }
+      case CFOP_NOT:
+        acc = !acc;
+        break;
+      case CFOP_JF:
+        if (!acc)
+          pc = insn->target;
+        break;
+      case CFOP_JT:
+        if (acc)
+          pc = insn->target;
+        break;
+    }
+  }
+#undef CF_OPERAND
+  return acc;
+}
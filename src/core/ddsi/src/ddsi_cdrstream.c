@@ -257,6 +257,317 @@ size_t dds_stream_check_optimize (const struct ddsi_sertype_default_desc * __res
   return dds_stream_check_optimize1 (desc);
 }
 
+static uint32_t cdr_align_of (enum dds_stream_typecode type)
+{
+  switch (type)
+  {
+    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
+      return get_type_size (type);
+    default:
+      /* strings and sequences start with a 4-byte length */
+      return 4;
+  }
+}
+
+static uint32_t dds_stream_max_align1 (const uint32_t * __restrict ops)
+{
+  uint32_t align = 1, a, insn;
+  while ((insn = *ops) != DDS_OP_RTS)
+  {
+    switch (DDS_OP (insn))
+    {
+      case DDS_OP_ADR: {
+        switch (DDS_OP_TYPE (insn))
+        {
+          case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR:
+            switch (DDS_OP_SUBTYPE (insn))
+            {
+              case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU:
+                a = dds_stream_max_align1 (ops + DDS_OP_ADR_JSR (ops[3]));
+                break;
+              default:
+                a = cdr_align_of (DDS_OP_SUBTYPE (insn));
+                break;
+            }
+            if (DDS_OP_TYPE (insn) == DDS_OP_VAL_SEQ && a < 4)
+              a = 4;
+            break;
+          case DDS_OP_VAL_UNI: {
+            const uint32_t *jeq_op = ops + DDS_OP_ADR_JSR (ops[3]);
+            a = cdr_align_of (DDS_OP_SUBTYPE (insn));
+            for (uint32_t i = 0; i < ops[2]; i++, jeq_op += 3)
+            {
+              uint32_t b;
+              switch (DDS_JEQ_TYPE (jeq_op[0]))
+              {
+                case DDS_OP_VAL_BST: case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU:
+                  b = dds_stream_max_align1 (jeq_op + DDS_OP_ADR_JSR (jeq_op[0]));
+                  break;
+                default:
+                  b = cdr_align_of (DDS_JEQ_TYPE (jeq_op[0]));
+                  break;
+              }
+              if (b > a)
+                a = b;
+            }
+            break;
+          }
+          default:
+            a = cdr_align_of (DDS_OP_TYPE (insn));
+            break;
+        }
+        ops = dds_stream_skip_adr_insns (ops);
+        break;
+      }
+      case DDS_OP_JSR: {
+        a = (DDS_OP_JUMP (insn) > 0) ? dds_stream_max_align1 (ops + DDS_OP_JUMP (insn)) : 1;
+        ops++;
+        break;
+      }
+      default:
+        abort ();
+        break;
+    }
+    if (a > align)
+      align = a;
+  }
+  return align;
+}
+
+uint32_t dds_stream_max_align (const struct ddsi_sertype_default_desc * __restrict desc)
+{
+  return dds_stream_max_align1 (desc->ops.ops);
+}
+
+/* A copy plan is an array of these terminated by DDS_STREAM_COPY_END.  A COPY covers
+   a run of fields that is laid out in memory exactly like in CDR once the stream is
+   at the right alignment: it gets memcpy'd if the stream position (after aligning to
+   "first_align", the alignment of its first field) is congruent to the offset in the
+   sample modulo "align", else the fields are interpreted.  The ZERO entries following
+   a COPY are the padding in the run (relative to its start), which gets cleared in
+   the output.  ARR and SEQ are arrays and sequences of which the elements have a
+   plan of their own, "size" being the size of an element in memory; a SEQ is copied
+   in one go if "bulk" is set (the element plan is then a single COPY of the entire
+   element).  OPS is anything else, which gets interpreted. */
+enum dds_stream_copy_kind {
+  DDS_STREAM_COPY_END,
+  DDS_STREAM_COPY_COPY,
+  DDS_STREAM_COPY_ZERO,
+  DDS_STREAM_COPY_OPS,
+  DDS_STREAM_COPY_ARR,
+  DDS_STREAM_COPY_SEQ
+};
+
+struct dds_stream_copy_op {
+  enum dds_stream_copy_kind kind;
+  bool bulk;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t align;
+  uint32_t first_align;
+  uint32_t count;
+  const uint32_t *ops;     /* first instruction covered */
+  const uint32_t *ops_end; /* instruction following the last one covered */
+  struct dds_stream_copy_op *elem;
+};
+
+struct copy_plan_builder {
+  struct dds_stream_copy_op *plan;
+  uint32_t n, size;
+  uint32_t run;     /* index of the COPY that can be extended, UINT32_MAX if none */
+  uint32_t run_end; /* offset in the sample of the end of that run */
+  bool useful;
+};
+
+static struct dds_stream_copy_op *copy_plan_append (struct copy_plan_builder *b, enum dds_stream_copy_kind kind, const uint32_t *ops, const uint32_t *ops_end)
+{
+  if (b->n == b->size)
+  {
+    b->size = b->size ? 2 * b->size : 8;
+    b->plan = ddsrt_realloc (b->plan, b->size * sizeof (*b->plan));
+  }
+  struct dds_stream_copy_op *op = &b->plan[b->n++];
+  memset (op, 0, sizeof (*op));
+  op->kind = kind;
+  op->ops = ops;
+  op->ops_end = ops_end;
+  return op;
+}
+
+static void copy_plan_add_field (struct copy_plan_builder *b, const uint32_t *ops, const uint32_t *ops_end, uint32_t offset, uint32_t size, uint32_t first_align, uint32_t align)
+{
+  struct dds_stream_copy_op *run;
+  if (b->run != UINT32_MAX && offset == ((b->run_end + first_align - 1) & ~(first_align - 1)))
+  {
+    run = &b->plan[b->run];
+    if (offset > b->run_end)
+    {
+      struct dds_stream_copy_op * const pad = copy_plan_append (b, DDS_STREAM_COPY_ZERO, NULL, NULL);
+      run = &b->plan[b->run];
+      pad->offset = b->run_end - run->offset;
+      pad->size = offset - b->run_end;
+    }
+    run->size = offset + size - run->offset;
+    if (align > run->align)
+      run->align = align;
+    run->ops_end = ops_end;
+    b->useful = true;
+  }
+  else
+  {
+    b->run = b->n;
+    run = copy_plan_append (b, DDS_STREAM_COPY_COPY, ops, ops_end);
+    run->offset = offset;
+    run->size = size;
+    run->align = align;
+    run->first_align = first_align;
+    /* copying a single primitive is no better than interpreting it */
+    if (size > first_align)
+      b->useful = true;
+  }
+  b->run_end = offset + size;
+}
+
+static void copy_plan_add_ops (struct copy_plan_builder *b, const uint32_t *ops, const uint32_t *ops_end)
+{
+  b->run = UINT32_MAX;
+  if (b->n > 0 && b->plan[b->n - 1].kind == DDS_STREAM_COPY_OPS && b->plan[b->n - 1].ops_end == ops)
+    b->plan[b->n - 1].ops_end = ops_end;
+  else
+    (void) copy_plan_append (b, DDS_STREAM_COPY_OPS, ops, ops_end);
+}
+
+/* An element that is a single COPY without padding can be copied in bulk */
+static bool copy_plan_is_bulk (const struct dds_stream_copy_op *elem, uint32_t elem_size)
+{
+  return elem[0].kind == DDS_STREAM_COPY_COPY && elem[0].offset == 0 && elem[0].size == elem_size && elem[1].kind == DDS_STREAM_COPY_END;
+}
+
+static struct dds_stream_copy_op *copy_plan_new (const uint32_t *ops);
+
+static bool copy_plan_build (struct copy_plan_builder *b, const uint32_t *ops)
+{
+  uint32_t insn;
+  while ((insn = *ops) != DDS_OP_RTS)
+  {
+    if (DDS_OP (insn) != DDS_OP_ADR)
+      return false;
+    const uint32_t *next = dds_stream_skip_adr_insns (ops);
+    switch (DDS_OP_TYPE (insn))
+    {
+      case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: {
+        const uint32_t sz = get_type_size (DDS_OP_TYPE (insn));
+        if ((ops[1] % sz) != 0)
+          copy_plan_add_ops (b, ops, next);
+        else
+          copy_plan_add_field (b, ops, next, ops[1], sz, sz, sz);
+        break;
+      }
+      case DDS_OP_VAL_ARR:
+        switch (DDS_OP_SUBTYPE (insn))
+        {
+          case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: {
+            const uint32_t sz = get_type_size (DDS_OP_SUBTYPE (insn));
+            if ((ops[1] % sz) != 0)
+              copy_plan_add_ops (b, ops, next);
+            else
+              copy_plan_add_field (b, ops, next, ops[1], ops[2] * sz, sz, sz);
+            break;
+          }
+          case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU: {
+            struct dds_stream_copy_op *elem = copy_plan_new (ops + DDS_OP_ADR_JSR (ops[3]));
+            if (elem == NULL)
+              copy_plan_add_ops (b, ops, next);
+            else if (copy_plan_is_bulk (elem, ops[4]))
+            {
+              copy_plan_add_field (b, ops, next, ops[1], ops[2] * ops[4], elem[0].first_align, elem[0].align);
+              dds_stream_copy_plan_free (elem);
+            }
+            else
+            {
+              struct dds_stream_copy_op *arr;
+              b->run = UINT32_MAX;
+              arr = copy_plan_append (b, DDS_STREAM_COPY_ARR, ops, next);
+              arr->offset = ops[1];
+              arr->size = ops[4];
+              arr->count = ops[2];
+              arr->elem = elem;
+              b->useful = true;
+            }
+            break;
+          }
+          case DDS_OP_VAL_STR: case DDS_OP_VAL_BST:
+            copy_plan_add_ops (b, ops, next);
+            break;
+        }
+        break;
+      case DDS_OP_VAL_SEQ:
+        switch (DDS_OP_SUBTYPE (insn))
+        {
+          case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU: {
+            struct dds_stream_copy_op *elem = copy_plan_new (ops + DDS_OP_ADR_JSR (ops[3]));
+            if (elem == NULL)
+              copy_plan_add_ops (b, ops, next);
+            else
+            {
+              struct dds_stream_copy_op *seq;
+              b->run = UINT32_MAX;
+              seq = copy_plan_append (b, DDS_STREAM_COPY_SEQ, ops, next);
+              seq->offset = ops[1];
+              seq->size = ops[2];
+              seq->bulk = copy_plan_is_bulk (elem, ops[2]);
+              seq->elem = elem;
+              b->useful = true;
+            }
+            break;
+          }
+          default:
+            /* the interpreter already copies sequences of primitives in one go */
+            copy_plan_add_ops (b, ops, next);
+            break;
+        }
+        break;
+      case DDS_OP_VAL_STR: case DDS_OP_VAL_BST: case DDS_OP_VAL_UNI:
+        copy_plan_add_ops (b, ops, next);
+        break;
+      case DDS_OP_VAL_STU:
+        return false;
+    }
+    ops = next;
+  }
+  return true;
+}
+
+static struct dds_stream_copy_op *copy_plan_new (const uint32_t *ops)
+{
+  struct copy_plan_builder b = { .plan = NULL, .n = 0, .size = 0, .run = UINT32_MAX, .run_end = 0, .useful = false };
+  const bool ok = copy_plan_build (&b, ops);
+  /* a struct consisting of a single primitive is useful as an element of a sequence */
+  const bool single = (b.n == 1 && b.plan[0].kind == DDS_STREAM_COPY_COPY);
+  (void) copy_plan_append (&b, DDS_STREAM_COPY_END, NULL, NULL);
+  if (!ok || !(b.useful || single))
+  {
+    dds_stream_copy_plan_free (b.plan);
+    return NULL;
+  }
+  return b.plan;
+}
+
+struct dds_stream_copy_op *dds_stream_copy_plan_new (const struct ddsi_sertype_default_desc * __restrict desc)
+{
+  return copy_plan_new (desc->ops.ops);
+}
+
+void dds_stream_copy_plan_free (struct dds_stream_copy_op *plan)
+{
+  if (plan == NULL)
+    return;
+  for (struct dds_stream_copy_op *op = plan; op->kind != DDS_STREAM_COPY_END; op++)
+    if (op->elem)
+      dds_stream_copy_plan_free (op->elem);
+  ddsrt_free (plan);
+}
+
 static void dds_stream_countops1 (const uint32_t * __restrict ops, const uint32_t **ops_end);
 
 static const uint32_t *dds_stream_countops_seq (const uint32_t * __restrict ops, uint32_t insn, const uint32_t **ops_end)
@@ -637,6 +948,25 @@ static const uint32_t *dds_stream_write_uni (dds_ostream_t * __restrict os, cons
   return ops;
 }
 
+static const uint32_t *dds_stream_write_adr (uint32_t insn, dds_ostream_t * __restrict os, const char * __restrict data, const uint32_t * __restrict ops)
+{
+  const void *addr = data + ops[1];
+  switch (DDS_OP_TYPE (insn))
+  {
+    case DDS_OP_VAL_1BY: dds_os_put1 (os, *((const uint8_t *) addr)); return ops + 2;
+    case DDS_OP_VAL_2BY: dds_os_put2 (os, *((const uint16_t *) addr)); return ops + 2;
+    case DDS_OP_VAL_4BY: dds_os_put4 (os, *((const uint32_t *) addr)); return ops + 2;
+    case DDS_OP_VAL_8BY: dds_os_put8 (os, *((const uint64_t *) addr)); return ops + 2;
+    case DDS_OP_VAL_STR: dds_stream_write_string (os, *((const char **) addr)); return ops + 2;
+    case DDS_OP_VAL_BST: dds_stream_write_string (os, (const char *) addr); return ops + 3;
+    case DDS_OP_VAL_SEQ: return dds_stream_write_seq (os, addr, ops, insn);
+    case DDS_OP_VAL_ARR: return dds_stream_write_arr (os, addr, ops, insn);
+    case DDS_OP_VAL_UNI: return dds_stream_write_uni (os, addr, data, ops, insn);
+    case DDS_OP_VAL_STU: abort (); break;
+  }
+  return NULL;
+}
+
 static void dds_stream_write (dds_ostream_t * __restrict os, const char * __restrict data, const uint32_t * __restrict ops)
 {
   uint32_t insn;
@@ -645,20 +975,7 @@ static void dds_stream_write (dds_ostream_t * __restrict os, const char * __rest
     switch (DDS_OP (insn))
     {
       case DDS_OP_ADR: {
-        const void *addr = data + ops[1];
-        switch (DDS_OP_TYPE (insn))
-        {
-          case DDS_OP_VAL_1BY: dds_os_put1 (os, *((const uint8_t *) addr)); ops += 2; break;
-          case DDS_OP_VAL_2BY: dds_os_put2 (os, *((const uint16_t *) addr)); ops += 2; break;
-          case DDS_OP_VAL_4BY: dds_os_put4 (os, *((const uint32_t *) addr)); ops += 2; break;
-          case DDS_OP_VAL_8BY: dds_os_put8 (os, *((const uint64_t *) addr)); ops += 2; break;
-          case DDS_OP_VAL_STR: dds_stream_write_string (os, *((const char **) addr)); ops += 2; break;
-          case DDS_OP_VAL_BST: dds_stream_write_string (os, (const char *) addr); ops += 3; break;
-          case DDS_OP_VAL_SEQ: ops = dds_stream_write_seq (os, addr, ops, insn); break;
-          case DDS_OP_VAL_ARR: ops = dds_stream_write_arr (os, addr, ops, insn); break;
-          case DDS_OP_VAL_UNI: ops = dds_stream_write_uni (os, addr, data, ops, insn); break;
-          case DDS_OP_VAL_STU: abort (); break;
-        }
+        ops = dds_stream_write_adr (insn, os, data, ops);
         break;
       }
       case DDS_OP_JSR: {
@@ -827,6 +1144,25 @@ static const uint32_t *dds_stream_read_uni (dds_istream_t * __restrict is, char
   return ops;
 }
 
+static const uint32_t *dds_stream_read_adr (uint32_t insn, dds_istream_t * __restrict is, char * __restrict data, const uint32_t * __restrict ops)
+{
+  void *addr = data + ops[1];
+  switch (DDS_OP_TYPE (insn))
+  {
+    case DDS_OP_VAL_1BY: *((uint8_t *) addr) = dds_is_get1 (is); return ops + 2;
+    case DDS_OP_VAL_2BY: *((uint16_t *) addr) = dds_is_get2 (is); return ops + 2;
+    case DDS_OP_VAL_4BY: *((uint32_t *) addr) = dds_is_get4 (is); return ops + 2;
+    case DDS_OP_VAL_8BY: *((uint64_t *) addr) = dds_is_get8 (is); return ops + 2;
+    case DDS_OP_VAL_STR: *((char **) addr) = dds_stream_reuse_string (is, *((char **) addr)); return ops + 2;
+    case DDS_OP_VAL_BST: dds_stream_reuse_string_bound (is, (char *) addr, ops[2]); return ops + 3;
+    case DDS_OP_VAL_SEQ: return dds_stream_read_seq (is, addr, ops, insn);
+    case DDS_OP_VAL_ARR: return dds_stream_read_arr (is, addr, ops, insn);
+    case DDS_OP_VAL_UNI: return dds_stream_read_uni (is, addr, data, ops, insn);
+    case DDS_OP_VAL_STU: abort (); break;
+  }
+  return NULL;
+}
+
 static void dds_stream_read (dds_istream_t * __restrict is, char * __restrict data, const uint32_t * __restrict ops)
 {
   uint32_t insn;
@@ -835,20 +1171,7 @@ static void dds_stream_read (dds_istream_t * __restrict is, char * __restrict da
     switch (DDS_OP (insn))
     {
       case DDS_OP_ADR: {
-        void *addr = data + ops[1];
-        switch (DDS_OP_TYPE (insn))
-        {
-          case DDS_OP_VAL_1BY: *((uint8_t *) addr) = dds_is_get1 (is); ops += 2; break;
-          case DDS_OP_VAL_2BY: *((uint16_t *) addr) = dds_is_get2 (is); ops += 2; break;
-          case DDS_OP_VAL_4BY: *((uint32_t *) addr) = dds_is_get4 (is); ops += 2; break;
-          case DDS_OP_VAL_8BY: *((uint64_t *) addr) = dds_is_get8 (is); ops += 2; break;
-          case DDS_OP_VAL_STR: *((char **) addr) = dds_stream_reuse_string (is, *((char **) addr)); ops += 2; break;
-          case DDS_OP_VAL_BST: dds_stream_reuse_string_bound (is, (char *) addr, ops[2]); ops += 3; break;
-          case DDS_OP_VAL_SEQ: ops = dds_stream_read_seq (is, addr, ops, insn); break;
-          case DDS_OP_VAL_ARR: ops = dds_stream_read_arr (is, addr, ops, insn); break;
-          case DDS_OP_VAL_UNI: ops = dds_stream_read_uni (is, addr, data, ops, insn); break;
-          case DDS_OP_VAL_STU: abort (); break;
-        }
+        ops = dds_stream_read_adr (insn, is, data, ops);
         break;
       }
       case DDS_OP_JSR: {
@@ -979,8 +1302,7 @@ static bool normalize_primarray (char * __restrict data, uint32_t * __restrict o
       if (bswap)
       {
         uint16_t *xs = (uint16_t *) (data + *off);
-        for (uint32_t i = 0; i < num; i++)
-          xs[i] = ddsrt_bswap2u (xs[i]);
+        ddsrt_bswap2u_array (xs, xs, num);
       }
       *off += 2 * num;
       return true;
@@ -990,8 +1312,7 @@ static bool normalize_primarray (char * __restrict data, uint32_t * __restrict o
       if (bswap)
       {
         uint32_t *xs = (uint32_t *) (data + *off);
-        for (uint32_t i = 0; i < num; i++)
-          xs[i] = ddsrt_bswap4u (xs[i]);
+        ddsrt_bswap4u_array (xs, xs, num);
       }
       *off += 4 * num;
       return true;
@@ -1001,8 +1322,7 @@ static bool normalize_primarray (char * __restrict data, uint32_t * __restrict o
       if (bswap)
       {
         uint64_t *xs = (uint64_t *) (data + *off);
-        for (uint32_t i = 0; i < num; i++)
-          xs[i] = ddsrt_bswap8u (xs[i]);
+        ddsrt_bswap8u_array (xs, xs, num);
       }
       *off += 8 * num;
       return true;
@@ -1411,6 +1731,124 @@ void dds_stream_free_sample (void *vdata, const uint32_t * ops)
  **
  *******************************************************************************************/
 
+static bool copy_plan_aligned (uint32_t index, const struct dds_stream_copy_op * __restrict op)
+{
+  /* wrap-around in the subtraction is harmless because align is a power of 2 */
+  const uint32_t pos = (index + op->first_align - 1) & ~(op->first_align - 1);
+  return ((pos - op->offset) % op->align) == 0;
+}
+
+static void dds_stream_write_plan (dds_ostream_t * __restrict os, const char * __restrict data, const struct dds_stream_copy_op * __restrict op)
+{
+  for (; op->kind != DDS_STREAM_COPY_END; op++)
+  {
+    switch (op->kind)
+    {
+      case DDS_STREAM_COPY_COPY:
+        if (copy_plan_aligned (os->m_index, op))
+        {
+          (void) dds_cdr_alignto_clear_and_resize (os, op->first_align, op->size);
+          char * const dst = (char *) os->m_buffer + os->m_index;
+          memcpy (dst, data + op->offset, op->size);
+          for (const struct dds_stream_copy_op *pad = op + 1; pad->kind == DDS_STREAM_COPY_ZERO; pad++)
+            memset (dst + pad->offset, 0, pad->size);
+          os->m_index += op->size;
+          break;
+        }
+        /* fall through */
+      case DDS_STREAM_COPY_OPS:
+        for (const uint32_t *ops = op->ops; ops != op->ops_end; )
+          ops = dds_stream_write_adr (*ops, os, data, ops);
+        break;
+      case DDS_STREAM_COPY_ARR:
+        for (uint32_t i = 0; i < op->count; i++)
+          dds_stream_write_plan (os, data + op->offset + i * op->size, op->elem);
+        break;
+      case DDS_STREAM_COPY_SEQ: {
+        const dds_sequence_t * const seq = (const dds_sequence_t *) (data + op->offset);
+        const uint32_t num = seq->_length;
+        dds_os_put4 (os, num);
+        if (num == 0)
+          break;
+        if (op->bulk && copy_plan_aligned (os->m_index, op->elem))
+        {
+          (void) dds_cdr_alignto_clear_and_resize (os, op->elem->first_align, num * op->size);
+          memcpy (os->m_buffer + os->m_index, seq->_buffer, num * op->size);
+          os->m_index += num * op->size;
+        }
+        else
+        {
+          for (uint32_t i = 0; i < num; i++)
+            dds_stream_write_plan (os, (const char *) seq->_buffer + i * op->size, op->elem);
+        }
+        break;
+      }
+      case DDS_STREAM_COPY_ZERO: case DDS_STREAM_COPY_END:
+        break;
+    }
+  }
+}
+
+static void dds_stream_read_plan (dds_istream_t * __restrict is, char * __restrict data, const struct dds_stream_copy_op * __restrict op)
+{
+  for (; op->kind != DDS_STREAM_COPY_END; op++)
+  {
+    switch (op->kind)
+    {
+      case DDS_STREAM_COPY_COPY:
+        if (copy_plan_aligned (is->m_index, op))
+        {
+          dds_cdr_alignto (is, op->first_align);
+          memcpy (data + op->offset, is->m_buffer + is->m_index, op->size);
+          is->m_index += op->size;
+          break;
+        }
+        /* fall through */
+      case DDS_STREAM_COPY_OPS:
+        for (const uint32_t *ops = op->ops; ops != op->ops_end; )
+          ops = dds_stream_read_adr (*ops, is, data, ops);
+        break;
+      case DDS_STREAM_COPY_ARR:
+        for (uint32_t i = 0; i < op->count; i++)
+          dds_stream_read_plan (is, data + op->offset + i * op->size, op->elem);
+        break;
+      case DDS_STREAM_COPY_SEQ: {
+        dds_sequence_t * const seq = (dds_sequence_t *) (data + op->offset);
+        const uint32_t index = is->m_index;
+        const uint32_t num = dds_is_get4 (is);
+        if (num == 0)
+        {
+          seq->_length = 0;
+          break;
+        }
+        realloc_sequence_buffer_if_needed (seq, num, op->size, !op->bulk);
+        if (seq->_maximum < num)
+        {
+          /* doesn't fit in a buffer supplied by the application: leave it to the interpreter */
+          is->m_index = index;
+          (void) dds_stream_read_adr (*op->ops, is, data, op->ops);
+          break;
+        }
+        seq->_length = num;
+        if (op->bulk && copy_plan_aligned (is->m_index, op->elem))
+        {
+          dds_cdr_alignto (is, op->elem->first_align);
+          memcpy (seq->_buffer, is->m_buffer + is->m_index, num * op->size);
+          is->m_index += num * op->size;
+        }
+        else
+        {
+          for (uint32_t i = 0; i < num; i++)
+            dds_stream_read_plan (is, (char *) seq->_buffer + i * op->size, op->elem);
+        }
+        break;
+      }
+      case DDS_STREAM_COPY_ZERO: case DDS_STREAM_COPY_END:
+        break;
+    }
+  }
+}
+
 void dds_stream_read_sample (dds_istream_t * __restrict is, void * __restrict data, const struct ddsi_sertype_default * __restrict type)
 {
   const struct ddsi_sertype_default_desc *desc = &type->type;
@@ -1429,7 +1867,10 @@ void dds_stream_read_sample (dds_istream_t * __restrict is, void * __restrict da
       dds_stream_free_sample (data, desc->ops.ops);
       memset (data, 0, desc->size);
     }
-    dds_stream_read (is, data, desc->ops.ops);
+    if (type->copy_plan)
+      dds_stream_read_plan (is, data, type->copy_plan);
+    else
+      dds_stream_read (is, data, desc->ops.ops);
   }
 }
 
@@ -1438,6 +1879,8 @@ void dds_stream_write_sample (dds_ostream_t * __restrict os, const void * __rest
   const struct ddsi_sertype_default_desc *desc = &type->type;
   if (type->opt_size && desc->align && (os->m_index % desc->align) == 0)
     dds_os_put_bytes (os, data, desc->size);
+  else if (type->copy_plan)
+    dds_stream_write_plan (os, data, type->copy_plan);
   else
     dds_stream_write (os, data, desc->ops.ops);
 }
@@ -1507,24 +1950,15 @@ static void dds_stream_swap_insitu (void * __restrict vbuf, uint32_t size, uint3
   {
     case 1:
       break;
-    case 2: {
-      uint16_t *buf = vbuf;
-      for (uint32_t i = 0; i < num; i++)
-        buf[i] = ddsrt_bswap2u (buf[i]);
+    case 2:
+      ddsrt_bswap2u_array (vbuf, vbuf, num);
       break;
-    }
-    case 4: {
-      uint32_t *buf = vbuf;
-      for (uint32_t i = 0; i < num; i++)
-        buf[i] = ddsrt_bswap4u (buf[i]);
+    case 4:
+      ddsrt_bswap4u_array (vbuf, vbuf, num);
       break;
-    }
-    case 8: {
-      uint64_t *buf = vbuf;
-      for (uint32_t i = 0; i < num; i++)
-        buf[i] = ddsrt_bswap8u (buf[i]);
+    case 8:
+      ddsrt_bswap8u_array (vbuf, vbuf, num);
       break;
-    }
   }
 }
 
@@ -1623,27 +2057,15 @@ static void dds_stream_swap_copy (void * __restrict vdst, const void * __restric
     case 1:
       memcpy (vdst, vsrc, num);
       break;
-    case 2: {
-      const uint16_t *src = vsrc;
-      uint16_t *dst = vdst;
-      for (uint32_t i = 0; i < num; i++)
-        dst[i] = ddsrt_bswap2u (src[i]);
+    case 2:
+      ddsrt_bswap2u_array (vdst, vsrc, num);
       break;
-    }
-    case 4: {
-      const uint32_t *src = vsrc;
-      uint32_t *dst = vdst;
-      for (uint32_t i = 0; i < num; i++)
-        dst[i] = ddsrt_bswap4u (src[i]);
+    case 4:
+      ddsrt_bswap4u_array (vdst, vsrc, num);
       break;
-    }
-    case 8: {
-      const uint64_t *src = vsrc;
-      uint64_t *dst = vdst;
-      for (uint32_t i = 0; i < num; i++)
-        dst[i] = ddsrt_bswap8u (src[i]);
+    case 8:
+      ddsrt_bswap8u_array (vdst, vsrc, num);
       break;
-    }
   }
 }
 #endif
@@ -1742,31 +2164,19 @@ static const uint32_t *dds_stream_extract_key_from_data_skip_array (dds_istream_
   else
   {
     dds_stream_extract_key_from_data_skip_subtype (is, num, subtype, NULL);
-    return ops + 3;
+    return ops + (subtype == DDS_OP_VAL_BST ? 5 : 3);
   }
 }
 
 static const uint32_t *dds_stream_extract_key_from_data_skip_sequence (dds_istream_t * __restrict is, const uint32_t * __restrict ops)
 {
   const uint32_t op = *ops;
-  const enum dds_stream_typecode type = DDS_OP_TYPE (op);
-  assert (type == DDS_OP_VAL_SEQ);
+  assert (DDS_OP_TYPE (op) == DDS_OP_VAL_SEQ);
   const uint32_t subtype = DDS_OP_SUBTYPE (op);
   const uint32_t num = dds_is_get4 (is);
-  if (num == 0)
-    return ops + 2 + (type == DDS_OP_VAL_BST || type == DDS_OP_VAL_ARR);
-  else if (subtype > DDS_OP_VAL_BST)
-  {
-    const uint32_t * jsr_ops = ops + DDS_OP_ADR_JSR (ops[3]);
-    const uint32_t jmp = DDS_OP_ADR_JMP (ops[3]);
-    dds_stream_extract_key_from_data_skip_subtype (is, num, subtype, jsr_ops);
-    return ops + (jmp ? jmp : 4);
-  }
-  else
-  {
-    dds_stream_extract_key_from_data_skip_subtype (is, num, subtype, NULL);
-    return ops + 2 + (type == DDS_OP_VAL_BST || type == DDS_OP_VAL_ARR);
-  }
+  if (num > 0)
+    dds_stream_extract_key_from_data_skip_subtype (is, num, subtype, (subtype > DDS_OP_VAL_BST) ? ops + DDS_OP_ADR_JSR (ops[3]) : NULL);
+  return skip_sequence_insns (ops, op);
 }
 
 static const uint32_t *dds_stream_extract_key_from_data_skip_union (dds_istream_t * __restrict is, const uint32_t * __restrict ops)
@@ -1836,6 +2246,60 @@ static void dds_stream_extract_key_from_data1 (dds_istream_t * __restrict is, dd
   }
 }
 
+const uint32_t *dds_stream_skip_adr (dds_istream_t * __restrict is, const uint32_t * __restrict ops)
+{
+  const uint32_t type = DDS_OP_TYPE (*ops);
+  assert (DDS_OP (*ops) == DDS_OP_ADR);
+  switch (type)
+  {
+    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: case DDS_OP_VAL_STR: case DDS_OP_VAL_BST:
+      dds_stream_extract_key_from_data_skip_subtype (is, 1, type, NULL);
+      return ops + 2 + (type == DDS_OP_VAL_BST);
+    case DDS_OP_VAL_SEQ:
+      return dds_stream_extract_key_from_data_skip_sequence (is, ops);
+    case DDS_OP_VAL_ARR:
+      return dds_stream_extract_key_from_data_skip_array (is, ops);
+    case DDS_OP_VAL_UNI:
+      return dds_stream_extract_key_from_data_skip_union (is, ops);
+    case DDS_OP_VAL_STU:
+      abort ();
+  }
+  return NULL;
+}
+
+const uint32_t *dds_stream_skip_adr_insns (const uint32_t * __restrict ops)
+{
+  const uint32_t insn = *ops;
+  assert (DDS_OP (insn) == DDS_OP_ADR);
+  switch (DDS_OP_TYPE (insn))
+  {
+    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: case DDS_OP_VAL_STR:
+      return ops + 2;
+    case DDS_OP_VAL_BST:
+      return ops + 3;
+    case DDS_OP_VAL_SEQ:
+      return skip_sequence_insns (ops, insn);
+    case DDS_OP_VAL_ARR:
+      switch (DDS_OP_SUBTYPE (insn))
+      {
+        case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: case DDS_OP_VAL_STR:
+          return ops + 3;
+        case DDS_OP_VAL_BST:
+          return ops + 5;
+        case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU: {
+          const uint32_t jmp = DDS_OP_ADR_JMP (ops[3]);
+          return ops + (jmp ? jmp : 5);
+        }
+      }
+      break;
+    case DDS_OP_VAL_UNI:
+      return ops + DDS_OP_ADR_JMP (ops[3]);
+    case DDS_OP_VAL_STU:
+      abort ();
+  }
+  return NULL;
+}
+
 static void dds_stream_extract_keyBE_from_data1 (dds_istream_t * __restrict is, dds_ostreamBE_t * __restrict os, const uint32_t * __restrict ops, uint32_t * __restrict keys_remaining)
 {
   uint32_t op;
@@ -2271,9 +2735,19 @@ DDSRT_STATIC_ASSERT ((offsetof (struct ddsi_serdata_default, data) % 8) == 0);
 
 void dds_istream_from_serdata_default (dds_istream_t * __restrict s, const struct ddsi_serdata_default * __restrict d)
 {
-  s->m_buffer = (const unsigned char *) d;
-  s->m_index = (uint32_t) offsetof (struct ddsi_serdata_default, data);
-  s->m_size = d->size + s->m_index;
+  if (d->rmsg)
+  {
+    /* payload in a received message, which is aligned well enough for the type */
+    s->m_buffer = (const unsigned char *) d->rdata;
+    s->m_index = 0;
+    s->m_size = d->pos;
+  }
+  else
+  {
+    s->m_buffer = (const unsigned char *) d;
+    s->m_index = (uint32_t) offsetof (struct ddsi_serdata_default, data);
+    s->m_size = d->size + s->m_index;
+  }
 #if DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN
   assert (d->hdr.identifier == CDR_LE);
 #elif DDSRT_ENDIAN == DDSRT_BIG_ENDIAN
@@ -133,6 +133,21 @@ static void type_sample_cache_store (struct type_sample_cache * __restrict tsc,
   tsc->n++;
 }
 
+static bool wait_after_rejection (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, const ddsi_guid_t *rdguid)
+{
+  /* FIXME: why look up rd,pwr again? Their states remains valid while the thread stays
+     "awake" (although a delete can be initiated), and blocking like this is a stopgap
+     anyway -- quite possibly to abort once either is deleted */
+  if (source_entity_locked)
+    ddsrt_mutex_unlock (&source_entity->lock);
+  dds_sleepfor (DDS_MSECS (1));
+  if (source_entity_locked)
+    ddsrt_mutex_lock (&source_entity->lock);
+  /* give up when reader or proxy writer no longer accessible */
+  return (entidx_lookup_reader_guid (gv->entity_index, rdguid) != NULL &&
+          entidx_lookup_guid_untyped (gv->entity_index, &source_entity->guid) != NULL);
+}
+
 dds_return_t deliver_locally_one (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, const ddsi_guid_t *rdguid, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, void *vsourceinfo)
 {
   struct reader *rd = entidx_lookup_reader_guid (gv->entity_index, rdguid);
@@ -144,22 +159,10 @@ dds_return_t deliver_locally_one (struct ddsi_domaingv *gv, struct entity_common
   if ((payload = ops->makesample (&tk, gv, rd->type, vsourceinfo)) != NULL)
   {
     EETRACE (source_entity, " =>"PGUIDFMT"\n", PGUID (*rdguid));
-    /* FIXME: why look up rd,pwr again? Their states remains valid while the thread stays
-       "awake" (although a delete can be initiated), and blocking like this is a stopgap
-       anyway -- quite possibly to abort once either is deleted */
     while (!ddsi_rhc_store (rd->rhc, wrinfo, payload, tk))
     {
-      if (source_entity_locked)
-        ddsrt_mutex_unlock (&source_entity->lock);
-      dds_sleepfor (DDS_MSECS (1));
-      if (source_entity_locked)
-        ddsrt_mutex_lock (&source_entity->lock);
-      if (entidx_lookup_reader_guid (gv->entity_index, rdguid) == NULL ||
-          entidx_lookup_guid_untyped (gv->entity_index, &source_entity->guid) == NULL)
-      {
-        /* give up when reader or proxy writer no longer accessible */
+      if (!wait_after_rejection (gv, source_entity, source_entity_locked, rdguid))
         break;
-      }
     }
     free_sample_after_store (gv, payload, tk);
   }
@@ -267,3 +270,125 @@ dds_return_t deliver_locally_allinsync (struct ddsi_domaingv *gv, struct entity_
   } while (rc == DDS_RETCODE_TRY_AGAIN);
   return rc;
 }
+
+struct deliver_batch {
+  uint32_t n;
+  struct ddsi_serdata *payloads[DELIVER_LOCALLY_MAX_BATCH];
+  struct ddsi_tkmap_instance *tks[DELIVER_LOCALLY_MAX_BATCH];
+};
+
+struct deliver_batch_straggler {
+  struct deliver_batch_straggler *next;
+  ddsi_guid_t rdguid;
+  struct deliver_batch b;
+};
+
+static void deliver_batch_make (struct deliver_batch *b, struct ddsi_domaingv *gv, const struct ddsi_sertype *type, const struct deliver_locally_ops * __restrict ops, uint32_t n, void * const *vsourceinfos)
+{
+  /* samples that fail to deserialize are simply skipped */
+  assert (n <= DELIVER_LOCALLY_MAX_BATCH);
+  b->n = 0;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if ((b->payloads[b->n] = ops->makesample (&b->tks[b->n], gv, type, vsourceinfos[i])) != NULL)
+      b->n++;
+  }
+}
+
+static void deliver_batch_fini (struct deliver_batch *b, struct ddsi_domaingv *gv)
+{
+  for (uint32_t i = 0; i < b->n; i++)
+    free_sample_after_store (gv, b->payloads[i], b->tks[i]);
+}
+
+static void deliver_batch_to_reader (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, const ddsi_guid_t *rdguid, struct ddsi_rhc *rhc, const struct ddsi_writer_info *wrinfo, const struct deliver_batch *b)
+{
+  uint32_t i = 0;
+  while ((i += ddsi_rhc_store_batch (rhc, wrinfo, b->n - i, b->payloads + i, b->tks + i)) < b->n)
+  {
+    if (!wait_after_rejection (gv, source_entity, source_entity_locked, rdguid))
+      break;
+  }
+}
+
+dds_return_t deliver_locally_one_batch (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, const ddsi_guid_t *rdguid, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, uint32_t n, void * const *vsourceinfos)
+{
+  struct reader *rd = entidx_lookup_reader_guid (gv->entity_index, rdguid);
+  if (rd == NULL)
+    return DDS_RETCODE_OK;
+
+  struct deliver_batch b;
+  deliver_batch_make (&b, gv, rd->type, ops, n, vsourceinfos);
+  if (b.n > 0)
+  {
+    EETRACE (source_entity, " =>"PGUIDFMT" (%"PRIu32")\n", PGUID (*rdguid), b.n);
+    deliver_batch_to_reader (gv, source_entity, source_entity_locked, rdguid, rd->rhc, wrinfo, &b);
+  }
+  deliver_batch_fini (&b, gv);
+  return DDS_RETCODE_OK;
+}
+
+static struct deliver_batch_straggler *deliver_locally_fastpath_batch (struct ddsi_domaingv *gv, struct local_reader_ary *fastpath_rdary, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, uint32_t n, void * const *vsourceinfos)
+{
+  /* Readers that reject a sample can't be waited for here because the reader array
+     is locked: a list of those readers is returned with the samples they still need */
+  struct reader ** const rdary = fastpath_rdary->rdary;
+  struct deliver_batch_straggler *stragglers = NULL;
+  uint32_t i = 0;
+  while (rdary[i])
+  {
+    struct ddsi_sertype const * const type = rdary[i]->type;
+    struct deliver_batch b;
+    deliver_batch_make (&b, gv, type, ops, n, vsourceinfos);
+    do {
+      const uint32_t k = (b.n == 0) ? 0 : ddsi_rhc_store_batch (rdary[i]->rhc, wrinfo, b.n, b.payloads, b.tks);
+      if (k < b.n)
+      {
+        struct deliver_batch_straggler *s = ddsrt_malloc (sizeof (*s));
+        s->rdguid = rdary[i]->e.guid;
+        s->b.n = b.n - k;
+        for (uint32_t j = 0; j < s->b.n; j++)
+        {
+          s->b.payloads[j] = ddsi_serdata_ref (b.payloads[k + j]);
+          s->b.tks[j] = b.tks[k + j];
+          ddsi_tkmap_instance_ref (s->b.tks[j]);
+        }
+        s->next = stragglers;
+        stragglers = s;
+      }
+    } while (rdary[++i] && rdary[i]->type == type);
+    deliver_batch_fini (&b, gv);
+  }
+  return stragglers;
+}
+
+dds_return_t deliver_locally_allinsync_batch (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, struct local_reader_ary *fastpath_rdary, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, uint32_t n, void * const *vsourceinfos)
+{
+  struct deliver_batch_straggler *stragglers = NULL;
+  ddsrt_mutex_lock (&fastpath_rdary->rdary_lock);
+  if (fastpath_rdary->fastpath_ok)
+  {
+    EETRACE (source_entity, " => EVERYONE (%"PRIu32")\n", n);
+    if (fastpath_rdary->rdary[0])
+      stragglers = deliver_locally_fastpath_batch (gv, fastpath_rdary, wrinfo, ops, n, vsourceinfos);
+    ddsrt_mutex_unlock (&fastpath_rdary->rdary_lock);
+  }
+  else
+  {
+    ddsrt_mutex_unlock (&fastpath_rdary->rdary_lock);
+    for (uint32_t i = 0; i < n; i++)
+      (void) deliver_locally_slowpath (gv, source_entity, source_entity_locked, wrinfo, ops, vsourceinfos[i]);
+  }
+
+  while (stragglers)
+  {
+    struct deliver_batch_straggler *s = stragglers;
+    struct reader *rd;
+    stragglers = s->next;
+    if ((rd = entidx_lookup_reader_guid (gv->entity_index, &s->rdguid)) != NULL)
+      deliver_batch_to_reader (gv, source_entity, source_entity_locked, &s->rdguid, rd->rhc, wrinfo, &s->b);
+    deliver_batch_fini (&s->b, gv);
+    ddsrt_free (s);
+  }
+  return DDS_RETCODE_OK;
+}
@@ -29,6 +29,7 @@ void ddsi_serdata_init (struct ddsi_serdata *d, const struct ddsi_sertype *tp, e
   d->statusinfo = 0;
   d->timestamp.v = INT64_MIN;
   d->twrite.v = INT64_MIN;
+  d->reception_timestamp.v = INT64_MIN;
   ddsrt_atomic_st32 (&d->refc, 1);
 }
 
@@ -47,6 +48,7 @@ struct ddsi_serdata *ddsi_serdata_ref_as_type (const struct ddsi_sertype *type,
     {
       converted->statusinfo = serdata->statusinfo;
       converted->timestamp = serdata->timestamp;
+      converted->reception_timestamp = serdata->reception_timestamp;
     }
     ddsi_serdata_to_ser_unref (serdata, &iov);
     return converted;
@@ -26,6 +26,7 @@
 #include "dds/ddsi/q_radmin.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_statistics.h"
 
 #if DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN
 #define NATIVE_ENCODING CDR_LE
@@ -42,10 +43,25 @@
    while using large messages -- actually, it stands to reason that this would
    be the same as the WHC node pool size */
 #define MAX_POOL_SIZE 8192
-#define MAX_SIZE_FOR_POOL 256
+#define MAX_LOAN_POOL_BYTES 1048576
+#define MIN_LOAN_POOL_SIZE 16
 #define DEFAULT_NEW_SIZE 128
 #define CHUNK_SIZE 128
 
+/* The general pool has a freelist per power-of-two size class, from 256 bytes
+   to 4MB of payload; larger serdatas are allocated and freed directly.  The
+   memory retained in each freelist is bounded (with a minimum of one entry),
+   the thread-specific magazines of the freelists may hold some more. */
+#define MIN_CLASS_SIZE_LG2 8
+#define N_CLASSES 15
+#define MIN_CLASS_SIZE (1u << MIN_CLASS_SIZE_LG2)
+#define MAX_CLASS_SIZE (1u << (MIN_CLASS_SIZE_LG2 + N_CLASSES - 1))
+#define MAX_POOL_BYTES_PER_CLASS 2097152
+
+/* Samples up to this size are always copied when received, it is cheap and avoids
+   pinning receive buffers for small samples */
+#define MAX_SIZE_FOR_COPY MIN_CLASS_SIZE
+
 #ifndef NDEBUG
 static int ispowerof2_size (size_t x)
 {
@@ -55,11 +71,55 @@ static int ispowerof2_size (size_t x)
 
 static size_t alignup_size (size_t x, size_t a);
 
+static uint32_t class_size (uint32_t c)
+{
+  return MIN_CLASS_SIZE << c;
+}
+
+/* Smallest class that fits size; N_CLASSES if size exceeds the largest class */
+static uint32_t size_class_for_alloc (size_t size)
+{
+  uint32_t c = 0;
+  while (c < N_CLASSES && class_size (c) < size)
+    c++;
+  return c;
+}
+
+/* Largest class that a buffer of size bytes can serve; N_CLASSES if it
+   is too small or too large to be pooled */
+static uint32_t size_class_for_free (size_t size)
+{
+  if (size < MIN_CLASS_SIZE || size > MAX_CLASS_SIZE)
+    return N_CLASSES;
+  uint32_t c = N_CLASSES - 1;
+  while (class_size (c) > size)
+    c--;
+  return c;
+}
+
+static struct serdatapool *serdatapool_new (uint32_t nclasses, uint32_t loan_size)
+{
+  struct serdatapool *pool;
+  pool = ddsrt_malloc (sizeof (*pool) + nclasses * sizeof (pool->classes[0]));
+  pool->loan_size = loan_size;
+  ddsrt_atomic_st32 (&pool->refc, 1);
+  pool->nclasses = nclasses;
+  ddsrt_atomic_st64 (&pool->oversize, 0);
+  return pool;
+}
+
 struct serdatapool * ddsi_serdatapool_new (void)
 {
-  struct serdatapool * pool;
-  pool = ddsrt_malloc (sizeof (*pool));
-  nn_freelist_init (&pool->freelist, MAX_POOL_SIZE, offsetof (struct ddsi_serdata_default, next));
+  struct serdatapool * pool = serdatapool_new (N_CLASSES, 0);
+  for (uint32_t c = 0; c < N_CLASSES; c++)
+  {
+    uint32_t max = MAX_POOL_BYTES_PER_CLASS / class_size (c);
+    if (max == 0)
+      max = 1;
+    else if (max > MAX_POOL_SIZE)
+      max = MAX_POOL_SIZE;
+    nn_freelist_init (&pool->classes[c].freelist, max, offsetof (struct ddsi_serdata_default, next));
+  }
   return pool;
 }
 
@@ -74,10 +134,53 @@ static void serdata_free_wrap (void *elem)
 
 void ddsi_serdatapool_free (struct serdatapool * pool)
 {
-  nn_freelist_fini (&pool->freelist, serdata_free_wrap);
+  for (uint32_t c = 0; c < pool->nclasses; c++)
+    nn_freelist_fini (&pool->classes[c].freelist, serdata_free_wrap);
   ddsrt_free (pool);
 }
 
+void ddsi_get_serdatapool_stats (struct serdatapool *pool, uint64_t * __restrict hits, uint64_t * __restrict misses)
+{
+  *hits = 0;
+  *misses = ddsrt_atomic_ld64 (&pool->oversize);
+  for (uint32_t c = 0; c < pool->nclasses; c++)
+  {
+    uint64_t h, m;
+    nn_freelist_stats (&pool->classes[c].freelist, &h, &m);
+    *hits += h;
+    *misses += m;
+  }
+}
+
+struct serdatapool *ddsi_serdatapool_new_loan (const struct ddsi_sertype_default *tp)
+{
+  struct serdatapool *pool;
+  uint32_t max;
+  if (tp->opt_size == 0)
+    return NULL;
+  /* bound the memory retained in the freelist, but always allow a few */
+  max = (uint32_t) (MAX_LOAN_POOL_BYTES / tp->type.size);
+  if (max < MIN_LOAN_POOL_SIZE)
+    max = MIN_LOAN_POOL_SIZE;
+  else if (max > MAX_POOL_SIZE)
+    max = MAX_POOL_SIZE;
+  pool = serdatapool_new (1, tp->type.size);
+  nn_freelist_init (&pool->classes[0].freelist, max, offsetof (struct ddsi_serdata_default, next));
+  return pool;
+}
+
+static void serdatapool_unref_loan (struct serdatapool *pool)
+{
+  assert (pool->loan_size > 0);
+  if (ddsrt_atomic_dec32_nv (&pool->refc) == 0)
+    ddsi_serdatapool_free (pool);
+}
+
+void ddsi_serdatapool_release_loan (struct serdatapool *pool)
+{
+  serdatapool_unref_loan (pool);
+}
+
 static size_t alignup_size (size_t x, size_t a)
 {
   size_t m = a-1;
@@ -90,7 +193,10 @@ static void *serdata_default_append (struct ddsi_serdata_default **d, size_t n)
   char *p;
   if ((*d)->pos + n > (*d)->size)
   {
-    size_t size1 = alignup_size ((*d)->pos + n, CHUNK_SIZE);
+    /* grow to a size class so it can be recycled without wasting memory */
+    const size_t needed = (*d)->pos + n;
+    const uint32_t c = size_class_for_alloc (needed);
+    size_t size1 = (c < N_CLASSES) ? class_size (c) : alignup_size (needed, CHUNK_SIZE);
     *d = ddsrt_realloc (*d, offsetof (struct ddsi_serdata_default, data) + size1);
     (*d)->size = (uint32_t)size1;
   }
@@ -154,9 +260,30 @@ static bool serdata_default_eqkey_nokey (const struct ddsi_serdata *acmn, const
 static void serdata_default_free(struct ddsi_serdata *dcmn)
 {
   struct ddsi_serdata_default *d = (struct ddsi_serdata_default *)dcmn;
+  struct serdatapool * const pool = d->serpool;
+  void *sample;
   assert(ddsrt_atomic_ld32(&d->c.refc) == 0);
-  if (d->size > MAX_SIZE_FOR_POOL || !nn_freelist_push (&d->serpool->freelist, d))
-    dds_free (d);
+  if ((sample = ddsrt_atomic_ldvoidp (&d->shared_sample)) != NULL)
+  {
+    const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *) d->c.type;
+    dds_stream_free_sample (sample, tp->type.ops.ops);
+    ddsrt_free (sample);
+  }
+  if (d->rmsg)
+    nn_rmsg_unpin (d->rmsg);
+  if (pool->loan_size > 0)
+  {
+    if (!nn_freelist_push (&pool->classes[0].freelist, d))
+      dds_free (d);
+    serdatapool_unref_loan (pool);
+  }
+  else
+  {
+    /* buffers may have grown to an arbitrary size, any class that fits will do */
+    const uint32_t c = size_class_for_free (d->size);
+    if (c == N_CLASSES || !nn_freelist_push (&pool->classes[c].freelist, d))
+      dds_free (d);
+  }
 }
 
 static void serdata_default_init(struct ddsi_serdata_default *d, const struct ddsi_sertype_default *tp, enum ddsi_serdata_kind kind)
@@ -172,6 +299,8 @@ static void serdata_default_init(struct ddsi_serdata_default *d, const struct dd
   d->keyhash.m_set = 0;
   d->keyhash.m_iskey = 0;
   d->keyhash.m_keysize = 0;
+  ddsrt_atomic_stvoidp (&d->shared_sample, NULL);
+  d->rmsg = NULL;
 }
 
 static struct ddsi_serdata_default *serdata_default_allocnew (struct serdatapool *serpool, uint32_t init_size)
@@ -184,10 +313,18 @@ static struct ddsi_serdata_default *serdata_default_allocnew (struct serdatapool
 
 static struct ddsi_serdata_default *serdata_default_new_size (const struct ddsi_sertype_default *tp, enum ddsi_serdata_kind kind, uint32_t size)
 {
+  struct serdatapool * const pool = tp->serpool;
+  const uint32_t c = size_class_for_alloc (size);
   struct ddsi_serdata_default *d;
-  if (size <= MAX_SIZE_FOR_POOL && (d = nn_freelist_pop (&tp->serpool->freelist)) != NULL)
+  if (c == N_CLASSES)
+  {
+    ddsrt_atomic_inc64 (&pool->oversize);
+    if ((d = serdata_default_allocnew (pool, size)) == NULL)
+      return NULL;
+  }
+  else if ((d = nn_freelist_pop (&pool->classes[c].freelist)) != NULL)
     ddsrt_atomic_st32 (&d->c.refc, 1);
-  else if ((d = serdata_default_allocnew (tp->serpool, size)) == NULL)
+  else if ((d = serdata_default_allocnew (pool, class_size (c))) == NULL)
     return NULL;
   serdata_default_init (d, tp, kind);
   return d;
@@ -198,6 +335,48 @@ static struct ddsi_serdata_default *serdata_default_new (const struct ddsi_serty
   return serdata_default_new_size (tp, kind, DEFAULT_NEW_SIZE);
 }
 
+/* Returns the CDR header followed by the payload, either in the serdata or in the
+   received message */
+static const char *serdata_default_cdr (const struct ddsi_serdata_default *d)
+{
+  return d->rmsg ? d->rdata - sizeof (struct CDRHeader) : (const char *) &d->hdr;
+}
+
+static const char *serdata_default_payload (const struct ddsi_serdata_default *d)
+{
+  return d->rmsg ? d->rdata : d->data;
+}
+
+/* Construct a serdata referencing the payload of an unfragmented sample in the
+   received message instead of copying it, provided it is in the native byte order
+   (normalizing it then doesn't modify it, so it doesn't matter that others may be
+   reading it at the same time), it is suitably aligned for reading it in place and
+   the message can be pinned.  Small samples are always copied, as that is cheap
+   and doesn't tie up receive buffers.  Returns NULL if the payload must be copied. */
+static struct ddsi_serdata_default *serdata_default_new_rmsg (const struct ddsi_sertype_default *tp, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size)
+{
+  if (size <= MAX_SIZE_FOR_COPY || fragchain->nextfrag != NULL || fragchain->maxp1 != size)
+    return NULL;
+  const char *cdr = (const char *) NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain));
+  struct CDRHeader hdr;
+  memcpy (&hdr, cdr, sizeof (hdr));
+  if (hdr.identifier != NATIVE_ENCODING || ((uintptr_t) cdr + sizeof (hdr)) % tp->cdr_align != 0)
+    return NULL;
+  if (!nn_rmsg_pin (fragchain->rmsg))
+    return NULL;
+  struct ddsi_serdata_default *d = serdata_default_new_size (tp, kind, 0);
+  if (d == NULL)
+  {
+    nn_rmsg_unpin (fragchain->rmsg);
+    return NULL;
+  }
+  d->rmsg = fragchain->rmsg;
+  d->rdata = cdr + sizeof (hdr);
+  d->pos = (uint32_t) (size - sizeof (hdr));
+  d->hdr = hdr;
+  return d;
+}
+
 /* Construct a serdata from a fragchain received over the network */
 static struct ddsi_serdata_default *serdata_default_from_ser_common (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const struct nn_rdata *fragchain, size_t size)
 {
@@ -209,32 +388,35 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
      serdata */
   if (size > UINT32_MAX - offsetof (struct ddsi_serdata_default, hdr))
     return NULL;
-  struct ddsi_serdata_default *d = serdata_default_new_size (tp, kind, (uint32_t) size);
-  if (d == NULL)
-    return NULL;
-
-  uint32_t off = 4; /* must skip the CDR header */
 
   assert (fragchain->min == 0);
-  assert (fragchain->maxp1 >= off); /* CDR header must be in first fragment */
-
-  memcpy (&d->hdr, NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain)), sizeof (d->hdr));
-  assert (d->hdr.identifier == CDR_LE || d->hdr.identifier == CDR_BE);
+  assert (fragchain->maxp1 >= 4); /* CDR header must be in first fragment */
 
-  while (fragchain)
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_new_rmsg (tp, kind, fragchain, size)) == NULL)
   {
-    assert (fragchain->min <= off);
-    assert (fragchain->maxp1 <= size);
-    if (fragchain->maxp1 > off)
+    if ((d = serdata_default_new_size (tp, kind, (uint32_t) size)) == NULL)
+      return NULL;
+
+    uint32_t off = 4; /* must skip the CDR header */
+    memcpy (&d->hdr, NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain)), sizeof (d->hdr));
+    while (fragchain)
     {
-      /* only copy if this fragment adds data */
-      const unsigned char *payload = NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain));
-      serdata_default_append_blob (&d, fragchain->maxp1 - off, payload + off - fragchain->min);
-      off = fragchain->maxp1;
+      assert (fragchain->min <= off);
+      assert (fragchain->maxp1 <= size);
+      if (fragchain->maxp1 > off)
+      {
+        /* only copy if this fragment adds data */
+        const unsigned char *payload = NN_RMSG_PAYLOADOFF (fragchain->rmsg, NN_RDATA_PAYLOAD_OFF (fragchain));
+        serdata_default_append_blob (&d, fragchain->maxp1 - off, payload + off - fragchain->min);
+        off = fragchain->maxp1;
+      }
+      fragchain = fragchain->nextfrag;
     }
-    fragchain = fragchain->nextfrag;
   }
+  assert (d->hdr.identifier == CDR_LE || d->hdr.identifier == CDR_BE);
 
+  /* needs_bswap is always false for a referenced payload, so normalizing it leaves it untouched */
   const bool needs_bswap = (d->hdr.identifier != NATIVE_ENCODING);
   d->hdr.identifier = NATIVE_ENCODING;
   const uint32_t pad = ddsrt_fromBE2u (d->hdr.options) & 2;
@@ -243,7 +425,7 @@ static struct ddsi_serdata_default *serdata_default_from_ser_common (const struc
     ddsi_serdata_unref (&d->c);
     return NULL;
   }
-  else if (!dds_stream_normalize (d->data, d->pos - pad, needs_bswap, tp, kind == SDK_KEY))
+  else if (!dds_stream_normalize ((char *) serdata_default_payload (d), d->pos - pad, needs_bswap, tp, kind == SDK_KEY))
   {
     ddsi_serdata_unref (&d->c);
     return NULL;
@@ -412,7 +594,10 @@ static void gen_keyhash_from_sample (const struct ddsi_sertype_default *type, dd
 static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (const struct ddsi_sertype *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
   const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *)tpcmn;
-  struct ddsi_serdata_default *d = serdata_default_new(tp, kind);
+  /* start with a buffer the size of the previous sample of this type (from any writer),
+     so that typically it doesn't need to be reallocated while serializing */
+  const uint32_t size_hint = (kind == SDK_DATA && tp->size_hint) ? ddsrt_atomic_ld32 (tp->size_hint) : DEFAULT_NEW_SIZE;
+  struct ddsi_serdata_default *d = serdata_default_new_size (tp, kind, size_hint);
   if (d == NULL)
     return NULL;
   dds_ostream_t os;
@@ -430,6 +615,8 @@ static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (cons
       break;
   }
   dds_ostream_add_to_serdata_default (&os, &d);
+  if (kind == SDK_DATA && tp->size_hint && d->pos != size_hint)
+    ddsrt_atomic_st32 (tp->size_hint, d->pos);
   return d;
 }
 
@@ -449,6 +636,46 @@ static struct ddsi_serdata *serdata_default_from_sample_cdr_nokey (const struct
   return fix_serdata_default_nokey (d, tpcmn->serdata_basehash);
 }
 
+void *ddsi_serdata_default_loan (struct serdatapool *pool, const struct ddsi_sertype_default *tp)
+{
+  struct ddsi_serdata_default *d;
+  assert (pool->loan_size == tp->type.size);
+  if ((d = nn_freelist_pop (&pool->classes[0].freelist)) != NULL)
+    ddsrt_atomic_st32 (&d->c.refc, 1);
+  else
+    d = serdata_default_allocnew (pool, pool->loan_size);
+  ddsrt_atomic_inc32 (&pool->refc);
+  serdata_default_init (d, tp, SDK_DATA);
+  return d->data;
+}
+
+static struct ddsi_serdata_default *serdata_default_from_loaned_sample (void *sample)
+{
+  return (struct ddsi_serdata_default *) ((char *) sample - offsetof (struct ddsi_serdata_default, data));
+}
+
+struct ddsi_serdata *ddsi_serdata_default_from_loan (const struct ddsi_sertype_default *tp, void *sample)
+{
+  /* memcpy-able representation means the sample is its own serialised form,
+     only the key hash still needs to be computed */
+  struct ddsi_serdata_default *d = serdata_default_from_loaned_sample (sample);
+  assert (d->serpool->loan_size == tp->type.size);
+  assert (d->c.type == &tp->c && d->c.kind == SDK_DATA && d->pos == 0);
+  gen_keyhash_from_sample (tp, &d->keyhash, sample);
+  d->pos = tp->type.size;
+  if (tp->c.typekind_no_key)
+    return fix_serdata_default_nokey (d, tp->c.serdata_basehash);
+  else
+    return fix_serdata_default (d, tp->c.serdata_basehash);
+}
+
+void ddsi_serdata_default_return_loan (void *sample)
+{
+  struct ddsi_serdata_default *d = serdata_default_from_loaned_sample (sample);
+  assert (d->serpool->loan_size > 0);
+  ddsi_serdata_unref (&d->c);
+}
+
 static struct ddsi_serdata *serdata_default_to_untyped (const struct ddsi_serdata *serdata_common)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
@@ -468,7 +695,7 @@ static struct ddsi_serdata *serdata_default_to_untyped (const struct ddsi_serdat
   {
     assert (d->hdr.identifier == NATIVE_ENCODING);
     if (d->c.kind == SDK_KEY)
-      serdata_default_append_blob (&d_tl, d->pos, d->data);
+      serdata_default_append_blob (&d_tl, d->pos, serdata_default_payload (d));
     else if (d->keyhash.m_iskey)
     {
       serdata_default_append_blob (&d_tl, sizeof (d->keyhash.m_hash), d->keyhash.m_hash);
@@ -502,7 +729,7 @@ static void serdata_default_to_ser (const struct ddsi_serdata *serdata_common, s
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   assert (off < d->pos + sizeof(struct CDRHeader));
   assert (sz <= alignup_size (d->pos + sizeof(struct CDRHeader), 4) - off);
-  memcpy (buf, (char *)&d->hdr + off, sz);
+  memcpy (buf, serdata_default_cdr (d) + off, sz);
 }
 
 static struct ddsi_serdata *serdata_default_to_ser_ref (const struct ddsi_serdata *serdata_common, size_t off, size_t sz, ddsrt_iovec_t *ref)
@@ -510,7 +737,7 @@ static struct ddsi_serdata *serdata_default_to_ser_ref (const struct ddsi_serdat
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   assert (off < d->pos + sizeof(struct CDRHeader));
   assert (sz <= alignup_size (d->pos + sizeof(struct CDRHeader), 4) - off);
-  ref->iov_base = (char *)&d->hdr + off;
+  ref->iov_base = (char *) serdata_default_cdr (d) + off;
   ref->iov_len = (ddsrt_iov_len_t)sz;
   return ddsi_serdata_ref(serdata_common);
 }
@@ -536,6 +763,35 @@ static bool serdata_default_to_sample_cdr (const struct ddsi_serdata *serdata_co
   return true; /* FIXME: can't conversion to sample fail? */
 }
 
+void *ddsi_serdata_default_shared_sample (struct ddsi_serdata *dcmn)
+{
+  struct ddsi_serdata_default *d = (struct ddsi_serdata_default *) dcmn;
+  void *sample, *old;
+  if (dcmn->ops != &ddsi_serdata_ops_cdr && dcmn->ops != &ddsi_serdata_ops_cdr_nokey)
+    return NULL;
+  assert (d->c.kind == SDK_DATA);
+  if (d->serpool->loan_size > 0)
+  {
+    /* written loan: the payload is the sample */
+    return d->data;
+  }
+  if ((sample = ddsrt_atomic_ldvoidp (&d->shared_sample)) != NULL)
+    return sample;
+
+  /* concurrent readers may race to deserialize it, the loser discards its copy */
+  const struct ddsi_sertype_default *tp = (const struct ddsi_sertype_default *) d->c.type;
+  sample = ddsrt_calloc (1, tp->type.size);
+  (void) serdata_default_to_sample_cdr (dcmn, sample, NULL, NULL);
+  if (!ddsrt_atomic_casvoidp (&d->shared_sample, NULL, sample))
+  {
+    old = ddsrt_atomic_ldvoidp (&d->shared_sample);
+    dds_stream_free_sample (sample, tp->type.ops.ops);
+    ddsrt_free (sample);
+    sample = old;
+  }
+  return sample;
+}
+
 static bool serdata_default_untyped_to_sample_cdr (const struct ddsi_sertype *sertype_common, const struct ddsi_serdata *serdata_common, void *sample, void **bufptr, void *buflim)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
@@ -84,6 +84,9 @@ static void sertype_default_free (struct ddsi_sertype *tpcmn)
   struct ddsi_sertype_default *tp = (struct ddsi_sertype_default *) tpcmn;
   ddsrt_free (tp->type.keys.keys);
   ddsrt_free (tp->type.ops.ops);
+  ddsrt_free (tp->meta);
+  dds_stream_copy_plan_free (tp->copy_plan);
+  ddsrt_free (tp->size_hint);
   ddsi_sertype_fini (&tp->c);
   ddsrt_free (tp);
 }
@@ -154,10 +157,17 @@ static bool sertype_default_deserialize (struct ddsi_domaingv *gv, struct ddsi_s
   struct ddsi_sertype_default *st = (struct ddsi_sertype_default *) stc;
   st->native_encoding_identifier = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? CDR_LE : CDR_BE);
   st->serpool = gv->serpool;
+  st->meta = NULL;
+  st->copy_plan = NULL;
+  st->size_hint = ddsrt_malloc (sizeof (*st->size_hint));
+  ddsrt_atomic_st32 (st->size_hint, 0);
   st->c.serdata_ops = st->c.typekind_no_key ? &ddsi_serdata_ops_cdr_nokey : &ddsi_serdata_ops_cdr;
   if (plist_deser_generic_srcoff (&st->type, src_data, src_sz, src_offset, DDSRT_ENDIAN != DDSRT_LITTLE_ENDIAN, ddsi_sertype_default_desc_ops) < 0)
     return false;
   st->opt_size = (st->type.flagset & DDS_TOPIC_NO_OPTIMIZE) ? 0 : dds_stream_check_optimize (&st->type);
+  if (st->opt_size == 0)
+    st->copy_plan = dds_stream_copy_plan_new (&st->type);
+  st->cdr_align = dds_stream_max_align (&st->type);
   return true;
 }
 
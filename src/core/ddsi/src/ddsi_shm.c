@@ -0,0 +1,972 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsi/ddsi_shm.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/q_log.h"
+
+#if DDSRT_HAVE_SHM
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_deliver_locally.h"
+#include "dds/ddsi/ddsi_rhc.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_thread.h"
+
+/* Layout of a segment: a header, followed by the "index" ring of nslots
+   32-bit slot indices (sample with sequence number s is in the slot at
+   index[s % nslots]) and then nslots slots of slot_size bytes each.
+
+   The state of a slot is a 64-bit word combining the sequence number of the
+   sample it contains in the upper half (0 while the writer is filling it)
+   with a reference count in the lower half.  The writer claims a slot with
+   a reference count of 0, fills it and publishes it by setting the sequence
+   number, updating the index ring and finally the head.  Readers reference
+   a slot only by atomically incrementing the reference count provided the
+   sequence number is the expected one, so a slot can't be reused while
+   referenced and a reader never sees a sample other than the one it looked
+   for.  Sequence numbers are 32-bit, 0 is never published. */
+
+#define SHM_MAGIC 0x48534443u /* "CDSH" */
+#define SHM_VERSION 1u
+#define SHM_MAX_SUBSCRIBERS 32u
+#define SHM_ALIGN 64u
+
+struct shm_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nslots;
+  uint32_t slot_size;
+  uint32_t sample_size; /* size of the serialised sample, exclusive of CDR header */
+  uint32_t type_size; /* size of the sample in memory */
+  uint32_t type_hash;
+  ddsrt_atomic_uint32_t head; /* sequence number of most recently published sample */
+  ddsrt_atomic_uint32_t subscribers[SHM_MAX_SUBSCRIBERS]; /* doorbells to ring, 0 if unused */
+};
+
+struct shm_slot {
+  ddsrt_atomic_uint64_t state; /* sequence number << 32 | reference count */
+  int64_t timestamp;
+  uint32_t statusinfo;
+  uint32_t kind; /* enum ddsi_serdata_kind */
+  uint32_t size; /* serialised size, inclusive of CDR header */
+  unsigned char cdr[]; /* CDR header, followed by the sample at offset SHM_SAMPLE_OFFSET */
+};
+
+#define SHM_SAMPLE_OFFSET (offsetof (struct shm_slot, cdr) + 4)
+DDSRT_STATIC_ASSERT (SHM_SAMPLE_OFFSET % 8 == 0);
+
+struct shm_map {
+  void *base;
+  size_t size;
+  struct shm_header *hdr;
+  ddsrt_atomic_uint32_t *index;
+  unsigned char *slots;
+  uint32_t nslots;
+  uint32_t slot_size;
+};
+
+struct ddsi_shm_writer {
+  struct ddsi_domaingv *gv;
+  struct shm_map m;
+  char name[48];
+  int sock; /* for ringing the doorbells */
+  uint32_t seq; /* last published sequence number */
+  uint32_t alloc_hint; /* slot to try first when allocating */
+  bool loaned[]; /* [m.nslots] set while the slot is loaned to the application */
+};
+
+struct ddsi_shm_attachment {
+  struct ddsi_shm_attachment *next;
+  ddsrt_atomic_uint32_t refc;
+  ddsi_guid_t pwr_guid;
+  struct shm_map m;
+  uint32_t subscriber_idx; /* index of our doorbell in the subscriber table */
+  uint32_t last_seq; /* last sequence number processed, only used by the shm thread */
+};
+
+struct ddsi_shm_domain {
+  ddsrt_mutex_t lock; /* protects atts */
+  struct ddsi_shm_attachment *atts;
+  uint32_t natts;
+  int sock; /* doorbell */
+  uint32_t id; /* doorbell address */
+  ddsrt_atomic_uint32_t keepgoing;
+  struct thread_state1 *ts;
+};
+
+struct ddsi_serdata_shm {
+  struct ddsi_serdata c;
+  struct ddsi_shm_attachment *att;
+  struct shm_slot *slot;
+  struct ddsi_serdata *key; /* key-only serdata of the sertype, used for the instance lookup */
+};
+
+static const struct ddsi_serdata_ops ddsi_serdata_ops_shm;
+
+static uint32_t align_up (uint32_t x, uint32_t a)
+{
+  return (x + a - 1) & ~(a - 1);
+}
+
+static void shm_segment_name (char *name, size_t size, const ddsi_guid_t *guid)
+{
+  (void) snprintf (name, size, "/cdds.%08"PRIx32"%08"PRIx32"%08"PRIx32"%08"PRIx32, guid->prefix.u[0], guid->prefix.u[1], guid->prefix.u[2], guid->entityid.u);
+}
+
+static socklen_t shm_doorbell_addr (struct sockaddr_un *addr, uint32_t id)
+{
+  /* abstract socket address: leading nul, no terminating nul */
+  memset (addr, 0, sizeof (*addr));
+  addr->sun_family = AF_UNIX;
+  int n = snprintf (addr->sun_path + 1, sizeof (addr->sun_path) - 1, "cdds.shm.%08"PRIx32, id);
+  return (socklen_t) (offsetof (struct sockaddr_un, sun_path) + 1 + (size_t) n);
+}
+
+static struct shm_slot *shm_slot (const struct shm_map *m, uint32_t idx)
+{
+  return (struct shm_slot *) (m->slots + (size_t) idx * m->slot_size);
+}
+
+static size_t shm_map_size (uint32_t nslots, uint32_t slot_size)
+{
+  return align_up ((uint32_t) (sizeof (struct shm_header) + nslots * sizeof (uint32_t)), SHM_ALIGN) + (size_t) nslots * slot_size;
+}
+
+static void shm_map_init (struct shm_map *m, void *base, size_t size)
+{
+  m->base = base;
+  m->size = size;
+  m->hdr = base;
+  m->nslots = m->hdr->nslots;
+  m->slot_size = m->hdr->slot_size;
+  m->index = (ddsrt_atomic_uint32_t *) (m->hdr + 1);
+  m->slots = (unsigned char *) base + align_up ((uint32_t) (sizeof (struct shm_header) + m->nslots * sizeof (uint32_t)), SHM_ALIGN);
+}
+
+static uint32_t shm_type_hash (const struct ddsi_sertype *type)
+{
+  return ddsrt_mh3 (type->type_name, strlen (type->type_name), 0);
+}
+
+static bool shm_slot_pin (struct shm_slot *slot, uint32_t seq)
+{
+  uint64_t s;
+  do {
+    s = ddsrt_atomic_ld64 (&slot->state);
+    if ((uint32_t) (s >> 32) != seq)
+      return false;
+  } while (!ddsrt_atomic_cas64 (&slot->state, s, s + 1));
+  return true;
+}
+
+static void shm_slot_unpin (struct shm_slot *slot)
+{
+  assert ((uint32_t) ddsrt_atomic_ld64 (&slot->state) > 0);
+  ddsrt_atomic_dec64 (&slot->state);
+}
+
+/*************************
+ ******   WRITER    ******
+ *************************/
+
+bool ddsi_shm_type_eligible (const struct ddsi_sertype *type)
+{
+  if (type->ops != &ddsi_sertype_ops_default)
+    return false;
+  const struct ddsi_sertype_default *st = (const struct ddsi_sertype_default *) type;
+  return st->opt_size != 0 && st->opt_size <= st->type.size;
+}
+
+struct ddsi_shm_writer *ddsi_shm_writer_new (struct ddsi_domaingv *gv, const ddsi_guid_t *guid, const struct ddsi_sertype *type)
+{
+  const struct ddsi_sertype_default *st = (const struct ddsi_sertype_default *) type;
+  struct ddsi_shm_writer *wr;
+  int fd;
+  void *base;
+
+  assert (ddsi_shm_type_eligible (type));
+  const uint32_t nslots = (gv->config.shm_slots < 2) ? 2 : gv->config.shm_slots;
+  const uint32_t slot_size = align_up ((uint32_t) SHM_SAMPLE_OFFSET + st->type.size, SHM_ALIGN);
+  const size_t size = shm_map_size (nslots, slot_size);
+
+  wr = ddsrt_malloc (sizeof (*wr) + nslots * sizeof (wr->loaned[0]));
+  memset (wr->loaned, 0, nslots * sizeof (wr->loaned[0]));
+  wr->gv = gv;
+  wr->seq = 0;
+  wr->alloc_hint = 0;
+  shm_segment_name (wr->name, sizeof (wr->name), guid);
+  if ((fd = shm_open (wr->name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0 && errno == EEXIST)
+  {
+    /* left behind by a crashed process that happened to use the same GUID */
+    (void) shm_unlink (wr->name);
+    fd = shm_open (wr->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  }
+  if (fd < 0)
+  {
+    GVWARNING ("shm: writer "PGUIDFMT": can't create segment %s (errno %d)\n", PGUID (*guid), wr->name, errno);
+    goto err_open;
+  }
+  if (ftruncate (fd, (off_t) size) < 0)
+  {
+    GVWARNING ("shm: writer "PGUIDFMT": can't size segment %s (errno %d)\n", PGUID (*guid), wr->name, errno);
+    goto err_map;
+  }
+  if ((base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    GVWARNING ("shm: writer "PGUIDFMT": can't map segment %s (errno %d)\n", PGUID (*guid), wr->name, errno);
+    goto err_map;
+  }
+  (void) close (fd);
+  fd = -1;
+  if ((wr->sock = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+  {
+    GVWARNING ("shm: writer "PGUIDFMT": can't create socket (errno %d)\n", PGUID (*guid), errno);
+    goto err_sock;
+  }
+
+  /* ftruncate zero-fills it, so all slots are free and all subscriber entries unused */
+  struct shm_header *hdr = base;
+  hdr->version = SHM_VERSION;
+  hdr->nslots = nslots;
+  hdr->slot_size = slot_size;
+  hdr->sample_size = (uint32_t) st->opt_size;
+  hdr->type_size = st->type.size;
+  hdr->type_hash = shm_type_hash (type);
+  ddsrt_atomic_fence_rel ();
+  hdr->magic = SHM_MAGIC;
+  shm_map_init (&wr->m, base, size);
+  GVLOGDISC ("shm: writer "PGUIDFMT": segment %s %"PRIu32" slots of %"PRIu32" bytes\n", PGUID (*guid), wr->name, nslots, slot_size);
+  return wr;
+
+err_sock:
+  (void) munmap (base, size);
+err_map:
+  if (fd >= 0)
+    (void) close (fd);
+  (void) shm_unlink (wr->name);
+err_open:
+  ddsrt_free (wr);
+  return NULL;
+}
+
+void ddsi_shm_writer_free (struct ddsi_shm_writer *wr)
+{
+  /* readers keep their mappings until they detach */
+  (void) close (wr->sock);
+  (void) munmap (wr->m.base, wr->m.size);
+  (void) shm_unlink (wr->name);
+  ddsrt_free (wr);
+}
+
+static struct shm_slot *shm_writer_alloc (struct ddsi_shm_writer *wr)
+{
+  /* only called by the writer, and a free slot can't become referenced by anyone else */
+  for (uint32_t i = 0; i < wr->m.nslots; i++)
+  {
+    const uint32_t idx = (wr->alloc_hint + i) % wr->m.nslots;
+    struct shm_slot * const slot = shm_slot (&wr->m, idx);
+    const uint64_t s = ddsrt_atomic_ld64 (&slot->state);
+    if ((uint32_t) s == 0 && ddsrt_atomic_cas64 (&slot->state, s, 1))
+    {
+      wr->alloc_hint = idx + 1;
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static uint32_t shm_writer_slot_index (const struct ddsi_shm_writer *wr, const struct shm_slot *slot)
+{
+  return (uint32_t) (((size_t) ((const unsigned char *) slot - wr->m.slots)) / wr->m.slot_size);
+}
+
+static struct shm_slot *shm_writer_loaned_slot (const struct ddsi_shm_writer *wr, const void *sample)
+{
+  /* pointers into the segment that aren't currently loaned out (e.g., already
+     written or returned) are rejected, as they're no longer ours to unpin */
+  const unsigned char *p = sample;
+  if (p < wr->m.slots || p >= wr->m.slots + (size_t) wr->m.nslots * wr->m.slot_size)
+    return NULL;
+  const size_t off = (size_t) (p - wr->m.slots);
+  const uint32_t idx = (uint32_t) (off / wr->m.slot_size);
+  if (off % wr->m.slot_size != SHM_SAMPLE_OFFSET || !wr->loaned[idx])
+    return NULL;
+  return shm_slot (&wr->m, idx);
+}
+
+void *ddsi_shm_writer_loan (struct ddsi_shm_writer *wr)
+{
+  struct shm_slot *slot;
+  if ((slot = shm_writer_alloc (wr)) == NULL)
+    return NULL;
+  wr->loaned[shm_writer_slot_index (wr, slot)] = true;
+  return slot->cdr + 4;
+}
+
+bool ddsi_shm_writer_return_loan (struct ddsi_shm_writer *wr, const void *sample)
+{
+  struct shm_slot *slot;
+  if ((slot = shm_writer_loaned_slot (wr, sample)) == NULL)
+    return false;
+  wr->loaned[shm_writer_slot_index (wr, slot)] = false;
+  shm_slot_unpin (slot);
+  return true;
+}
+
+static bool shm_writer_has_subscribers (const struct ddsi_shm_writer *wr)
+{
+  for (uint32_t i = 0; i < SHM_MAX_SUBSCRIBERS; i++)
+    if (ddsrt_atomic_ld32 (&wr->m.hdr->subscribers[i]) != 0)
+      return true;
+  return false;
+}
+
+static void shm_writer_ring_doorbells (struct ddsi_shm_writer *wr)
+{
+  for (uint32_t i = 0; i < SHM_MAX_SUBSCRIBERS; i++)
+  {
+    const uint32_t id = ddsrt_atomic_ld32 (&wr->m.hdr->subscribers[i]);
+    struct sockaddr_un addr;
+    socklen_t addrlen;
+    if (id == 0)
+      continue;
+    addrlen = shm_doorbell_addr (&addr, id);
+    /* a full doorbell queue means it'll look anyway; no-one listening means it is gone */
+    if (sendto (wr->sock, "", 1, MSG_DONTWAIT, (struct sockaddr *) &addr, addrlen) < 0 && (errno == ECONNREFUSED || errno == ENOENT))
+      (void) ddsrt_atomic_cas32 (&wr->m.hdr->subscribers[i], id, 0);
+  }
+}
+
+void ddsi_shm_writer_publish (struct ddsi_shm_writer *wr, const struct ddsi_serdata *d, const void *sample)
+{
+  struct shm_slot *slot = shm_writer_loaned_slot (wr, sample);
+  const uint32_t size = ddsi_serdata_size (d);
+  bool copied = false;
+  if (!shm_writer_has_subscribers (wr))
+    return;
+  if (slot == NULL || d->kind != SDK_DATA)
+  {
+    /* copy the serialised form into a free slot: size of key is bounded by
+       size of sample for these types */
+    if (size > 4 + wr->m.hdr->type_size || (slot = shm_writer_alloc (wr)) == NULL)
+    {
+      struct ddsi_domaingv * const gv = wr->gv;
+      GVTRACE ("shm: %s: no free slot, sample dropped\n", wr->name);
+      return;
+    }
+    ddsi_serdata_to_ser (d, 0, size, slot->cdr);
+    copied = true;
+  }
+  else
+  {
+    /* sample is already in place, only the CDR header is missing */
+    assert (size == 4 + wr->m.hdr->sample_size);
+    ddsi_serdata_to_ser (d, 0, 4, slot->cdr);
+  }
+  slot->timestamp = d->timestamp.v;
+  slot->statusinfo = d->statusinfo;
+  slot->kind = (uint32_t) d->kind;
+  slot->size = size;
+
+  if (++wr->seq == 0)
+    wr->seq = 1;
+  const uint32_t seq = wr->seq;
+  uint64_t s;
+  ddsrt_atomic_fence_rel ();
+  do {
+    s = ddsrt_atomic_ld64 (&slot->state);
+  } while (!ddsrt_atomic_cas64 (&slot->state, s, ((uint64_t) seq << 32) | (uint32_t) s));
+  ddsrt_atomic_st32 (&wr->m.index[seq % wr->m.nslots], shm_writer_slot_index (wr, slot));
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (&wr->m.hdr->head, seq);
+  if (copied)
+    shm_slot_unpin (slot);
+  shm_writer_ring_doorbells (wr);
+}
+
+/*************************
+ ******   SERDATA   ******
+ *************************/
+
+static struct ddsi_serdata *shm_serdata_key (const struct ddsi_serdata *d)
+{
+  return (d->ops == &ddsi_serdata_ops_shm) ? ((const struct ddsi_serdata_shm *) d)->key : (struct ddsi_serdata *) d;
+}
+
+static struct ddsi_serdata *shm_serdata_new (const struct ddsi_sertype *type, struct ddsi_shm_attachment *att, struct shm_slot *slot)
+{
+  const ddsrt_iovec_t iov = { .iov_base = slot->cdr, .iov_len = slot->size };
+  struct ddsi_serdata *key;
+  if (slot->size < 4 || slot->size > 4 + att->m.hdr->type_size)
+    return NULL;
+  if (slot->kind != (uint32_t) SDK_DATA)
+  {
+    /* dispose/unregister: small enough that copying doesn't matter */
+    if ((key = ddsi_serdata_from_ser_iov (type, SDK_KEY, 1, &iov, slot->size)) == NULL)
+      return NULL;
+    key->statusinfo = slot->statusinfo;
+    key->timestamp.v = slot->timestamp;
+    return key;
+  }
+  if (slot->size != 4 + att->m.hdr->sample_size)
+    return NULL;
+  if ((key = ddsi_serdata_from_sample (type, SDK_KEY, slot->cdr + 4)) == NULL)
+    return NULL;
+  struct ddsi_serdata_shm *d = ddsrt_malloc (sizeof (*d));
+  ddsi_serdata_init (&d->c, type, SDK_DATA);
+  d->c.ops = &ddsi_serdata_ops_shm;
+  d->c.hash = key->hash;
+  d->c.statusinfo = slot->statusinfo;
+  d->c.timestamp.v = slot->timestamp;
+  ddsrt_atomic_inc64 (&slot->state);
+  ddsrt_atomic_inc32 (&att->refc);
+  d->att = att;
+  d->slot = slot;
+  d->key = key;
+  return &d->c;
+}
+
+static void shm_attachment_unref (struct ddsi_shm_attachment *att);
+
+static void serdata_shm_free (struct ddsi_serdata *dcmn)
+{
+  struct ddsi_serdata_shm *d = (struct ddsi_serdata_shm *) dcmn;
+  shm_slot_unpin (d->slot);
+  shm_attachment_unref (d->att);
+  ddsi_serdata_unref (d->key);
+  ddsrt_free (d);
+}
+
+static bool serdata_shm_eqkey (const struct ddsi_serdata *a, const struct ddsi_serdata *b)
+{
+  return ddsi_serdata_eqkey (shm_serdata_key (a), shm_serdata_key (b));
+}
+
+static uint32_t serdata_shm_get_size (const struct ddsi_serdata *dcmn)
+{
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  return d->slot->size;
+}
+
+static void serdata_shm_to_ser (const struct ddsi_serdata *dcmn, size_t off, size_t sz, void *buf)
+{
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  memcpy (buf, d->slot->cdr + off, sz);
+}
+
+static struct ddsi_serdata *serdata_shm_to_ser_ref (const struct ddsi_serdata *dcmn, size_t off, size_t sz, ddsrt_iovec_t *ref)
+{
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  ref->iov_base = d->slot->cdr + off;
+  ref->iov_len = (ddsrt_iov_len_t) sz;
+  return ddsi_serdata_ref (dcmn);
+}
+
+static void serdata_shm_to_ser_unref (struct ddsi_serdata *dcmn, const ddsrt_iovec_t *ref)
+{
+  (void) ref;
+  ddsi_serdata_unref (dcmn);
+}
+
+static bool serdata_shm_to_sample (const struct ddsi_serdata *dcmn, void *sample, void **bufptr, void *buflim)
+{
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  (void) bufptr; (void) buflim;
+  memcpy (sample, d->slot->cdr + 4, d->att->m.hdr->sample_size);
+  return true;
+}
+
+static struct ddsi_serdata *serdata_shm_to_untyped (const struct ddsi_serdata *dcmn)
+{
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  return ddsi_serdata_to_untyped (d->key);
+}
+
+static size_t serdata_shm_print (const struct ddsi_sertype *type, const struct ddsi_serdata *dcmn, char *buf, size_t size)
+{
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  const ddsrt_iovec_t iov = { .iov_base = d->slot->cdr, .iov_len = d->slot->size };
+  struct ddsi_serdata *tmp;
+  size_t n;
+  if ((tmp = ddsi_serdata_from_ser_iov (type, SDK_DATA, 1, &iov, d->slot->size)) == NULL)
+    return (size_t) snprintf (buf, size, "(unprintable)");
+  n = ddsi_serdata_print (tmp, buf, size);
+  ddsi_serdata_unref (tmp);
+  return n;
+}
+
+static void serdata_shm_get_keyhash (const struct ddsi_serdata *dcmn, struct ddsi_keyhash *buf, bool force_md5)
+{
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  ddsi_serdata_get_keyhash (d->key, buf, force_md5);
+}
+
+/* Constructing serdatas always goes through the sertype's serdata_ops,
+   so the from_xxx operations are never used for these */
+static const struct ddsi_serdata_ops ddsi_serdata_ops_shm = {
+  .eqkey = serdata_shm_eqkey,
+  .get_size = serdata_shm_get_size,
+  .from_ser = 0,
+  .from_ser_iov = 0,
+  .from_keyhash = 0,
+  .from_sample = 0,
+  .to_ser = serdata_shm_to_ser,
+  .to_ser_ref = serdata_shm_to_ser_ref,
+  .to_ser_unref = serdata_shm_to_ser_unref,
+  .to_sample = serdata_shm_to_sample,
+  .to_untyped = serdata_shm_to_untyped,
+  .untyped_to_sample = 0,
+  .free = serdata_shm_free,
+  .print = serdata_shm_print,
+  .get_keyhash = serdata_shm_get_keyhash
+};
+
+void *ddsi_serdata_shm_sample (const struct ddsi_serdata *dcmn)
+{
+  if (dcmn->ops != &ddsi_serdata_ops_shm)
+    return NULL;
+  const struct ddsi_serdata_shm *d = (const struct ddsi_serdata_shm *) dcmn;
+  return d->slot->cdr + 4;
+}
+
+/*************************
+ ******   READER    ******
+ *************************/
+
+bool ddsi_shm_same_host (const struct ddsi_domaingv *gv, const struct ddsi_plist *plist)
+{
+  return gv->shm != NULL && (plist->present & PP_CYCLONE_SHM_HOSTID) &&
+    memcmp (&plist->cyclone_shm_hostid, &gv->shm_hostid, sizeof (gv->shm_hostid)) == 0;
+}
+
+struct ddsi_shm_attachment *ddsi_shm_attach (struct ddsi_domaingv *gv, const ddsi_guid_t *pwr_guid, const struct ddsi_sertype *type)
+{
+  struct ddsi_shm_domain * const shm = gv->shm;
+  const struct ddsi_sertype_default *st = (const struct ddsi_sertype_default *) type;
+  struct ddsi_shm_attachment *att;
+  char name[48];
+  struct stat statbuf;
+  void *base;
+  int fd;
+
+  assert (shm != NULL);
+  assert (ddsi_shm_type_eligible (type));
+  shm_segment_name (name, sizeof (name), pwr_guid);
+  if ((fd = shm_open (name, O_RDWR, 0)) < 0)
+  {
+    GVERROR ("shm: proxy writer "PGUIDFMT": can't open segment %s (errno %d)\n", PGUID (*pwr_guid), name, errno);
+    return NULL;
+  }
+  if (fstat (fd, &statbuf) < 0 || (size_t) statbuf.st_size < sizeof (struct shm_header))
+  {
+    GVERROR ("shm: proxy writer "PGUIDFMT": segment %s too small\n", PGUID (*pwr_guid), name);
+    (void) close (fd);
+    return NULL;
+  }
+  base = mmap (NULL, (size_t) statbuf.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  (void) close (fd);
+  if (base == MAP_FAILED)
+  {
+    GVERROR ("shm: proxy writer "PGUIDFMT": can't map segment %s (errno %d)\n", PGUID (*pwr_guid), name, errno);
+    return NULL;
+  }
+
+  const struct shm_header *hdr = base;
+  if (hdr->magic != SHM_MAGIC || hdr->version != SHM_VERSION || hdr->nslots < 2 ||
+      hdr->slot_size < SHM_SAMPLE_OFFSET + hdr->type_size || hdr->slot_size % SHM_ALIGN != 0 ||
+      shm_map_size (hdr->nslots, hdr->slot_size) != (size_t) statbuf.st_size ||
+      hdr->type_size != st->type.size || hdr->sample_size != st->opt_size || hdr->type_hash != shm_type_hash (type))
+  {
+    GVERROR ("shm: proxy writer "PGUIDFMT": segment %s invalid or of a different type\n", PGUID (*pwr_guid), name);
+    (void) munmap (base, (size_t) statbuf.st_size);
+    return NULL;
+  }
+
+  att = ddsrt_malloc (sizeof (*att));
+  ddsrt_atomic_st32 (&att->refc, 1);
+  att->pwr_guid = *pwr_guid;
+  shm_map_init (&att->m, base, (size_t) statbuf.st_size);
+  for (att->subscriber_idx = 0; att->subscriber_idx < SHM_MAX_SUBSCRIBERS; att->subscriber_idx++)
+    if (ddsrt_atomic_cas32 (&att->m.hdr->subscribers[att->subscriber_idx], 0, shm->id))
+      break;
+  if (att->subscriber_idx == SHM_MAX_SUBSCRIBERS)
+  {
+    GVERROR ("shm: proxy writer "PGUIDFMT": segment %s has too many subscribers\n", PGUID (*pwr_guid), name);
+    (void) munmap (base, (size_t) statbuf.st_size);
+    ddsrt_free (att);
+    return NULL;
+  }
+  /* registered first, so any later sample rings our doorbell */
+  att->last_seq = ddsrt_atomic_ld32 (&att->m.hdr->head);
+
+  ddsrt_mutex_lock (&shm->lock);
+  att->next = shm->atts;
+  shm->atts = att;
+  shm->natts++;
+  ddsrt_mutex_unlock (&shm->lock);
+  GVLOGDISC ("shm: proxy writer "PGUIDFMT": attached to %s\n", PGUID (*pwr_guid), name);
+  return att;
+}
+
+static void shm_attachment_unref (struct ddsi_shm_attachment *att)
+{
+  if (ddsrt_atomic_dec32_nv (&att->refc) == 0)
+  {
+    (void) munmap (att->m.base, att->m.size);
+    ddsrt_free (att);
+  }
+}
+
+void ddsi_shm_detach (struct ddsi_domaingv *gv, struct ddsi_shm_attachment *att)
+{
+  struct ddsi_shm_domain * const shm = gv->shm;
+  struct ddsi_shm_attachment **patt;
+  ddsrt_mutex_lock (&shm->lock);
+  for (patt = &shm->atts; *patt != att; patt = &(*patt)->next)
+    assert (*patt != NULL);
+  *patt = att->next;
+  shm->natts--;
+  ddsrt_mutex_unlock (&shm->lock);
+  (void) ddsrt_atomic_cas32 (&att->m.hdr->subscribers[att->subscriber_idx], shm->id, 0);
+  shm_attachment_unref (att);
+}
+
+struct shm_sourceinfo {
+  struct ddsi_shm_attachment *att;
+  struct shm_slot *slot;
+};
+
+static struct ddsi_serdata *shm_make_sample (struct ddsi_tkmap_instance **tk, struct ddsi_domaingv *gv, struct ddsi_sertype const * const type, void *vsourceinfo)
+{
+  struct shm_sourceinfo *si = vsourceinfo;
+  struct ddsi_serdata *d;
+  if ((d = shm_serdata_new (type, si->att, si->slot)) == NULL)
+  {
+    GVWARNING ("shm: proxy writer "PGUIDFMT": invalid sample for type %s\n", PGUID (si->att->pwr_guid), type->type_name);
+    return NULL;
+  }
+  *tk = ddsi_tkmap_lookup_instance_ref (gv->m_tkmap, shm_serdata_key (d));
+  return d;
+}
+
+static struct reader *shm_first_reader (struct entity_index *entity_index, struct entity_common *pwrcmn, ddsrt_avl_iter_t *it)
+{
+  assert (pwrcmn->kind == EK_PROXY_WRITER);
+  struct proxy_writer *pwr = (struct proxy_writer *) pwrcmn;
+  struct pwr_rd_match *m;
+  struct reader *rd;
+  for (m = ddsrt_avl_iter_first (&pwr_readers_treedef, &pwr->readers, it); m != NULL; m = ddsrt_avl_iter_next (it))
+    if (m->via_shm && (rd = entidx_lookup_reader_guid (entity_index, &m->rd_guid)) != NULL)
+      return rd;
+  return NULL;
+}
+
+static struct reader *shm_next_reader (struct entity_index *entity_index, ddsrt_avl_iter_t *it)
+{
+  struct pwr_rd_match *m;
+  struct reader *rd;
+  for (m = ddsrt_avl_iter_next (it); m != NULL; m = ddsrt_avl_iter_next (it))
+    if (m->via_shm && (rd = entidx_lookup_reader_guid (entity_index, &m->rd_guid)) != NULL)
+      return rd;
+  return NULL;
+}
+
+static dds_return_t shm_on_delivery_failure_fastpath (struct entity_common *source_entity, bool source_entity_locked, struct local_reader_ary *fastpath_rdary, void *vsourceinfo)
+{
+  (void) vsourceinfo;
+  ddsrt_mutex_unlock (&fastpath_rdary->rdary_lock);
+  if (source_entity_locked)
+    ddsrt_mutex_unlock (&source_entity->lock);
+
+  dds_sleepfor (DDS_MSECS (10));
+
+  if (source_entity_locked)
+    ddsrt_mutex_lock (&source_entity->lock);
+  ddsrt_mutex_lock (&fastpath_rdary->rdary_lock);
+  return DDS_RETCODE_TRY_AGAIN;
+}
+
+static void shm_deliver (struct ddsi_domaingv *gv, struct thread_state1 *ts1, struct ddsi_shm_attachment *att)
+{
+  static const struct deliver_locally_ops deliver_locally_ops = {
+    .makesample = shm_make_sample,
+    .first_reader = shm_first_reader,
+    .next_reader = shm_next_reader,
+    .on_failure_fastpath = shm_on_delivery_failure_fastpath
+  };
+  const uint32_t head = ddsrt_atomic_ld32 (&att->m.hdr->head);
+  struct proxy_writer *pwr;
+  uint32_t seq;
+
+  if (head == att->last_seq)
+    return;
+  ddsrt_atomic_fence_acq ();
+  thread_state_awake (ts1, gv);
+  if ((pwr = entidx_lookup_proxy_writer_guid (gv->entity_index, &att->pwr_guid)) != NULL)
+  {
+    seq = att->last_seq + 1;
+    if (head - att->last_seq > att->m.nslots)
+    {
+      GVTRACE ("shm: proxy writer "PGUIDFMT": lost %"PRIu32" samples\n", PGUID (att->pwr_guid), head - att->last_seq - att->m.nslots);
+      seq = head - att->m.nslots + 1;
+    }
+    for (; seq != head + 1; seq++)
+    {
+      const uint32_t idx = ddsrt_atomic_ld32 (&att->m.index[seq % att->m.nslots]);
+      struct shm_slot *slot;
+      if (seq == 0 || idx >= att->m.nslots || !shm_slot_pin ((slot = shm_slot (&att->m, idx)), seq))
+        continue;
+      struct shm_sourceinfo sourceinfo = { .att = att, .slot = slot };
+      struct ddsi_writer_info wrinfo;
+      ddsi_make_writer_info (&wrinfo, &pwr->e, pwr->c.xqos, slot->statusinfo);
+      (void) deliver_locally_allinsync (gv, &pwr->e, false, &pwr->shm_rdary, &wrinfo, &deliver_locally_ops, &sourceinfo);
+      shm_slot_unpin (slot);
+    }
+  }
+  att->last_seq = head;
+  thread_state_asleep (ts1);
+}
+
+static uint32_t shm_thread (void *varg)
+{
+  struct ddsi_domaingv * const gv = varg;
+  struct ddsi_shm_domain * const shm = gv->shm;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ddsi_shm_attachment **atts = NULL;
+  uint32_t atts_size = 0;
+  char buf[16];
+
+  while (ddsrt_atomic_ld32 (&shm->keepgoing))
+  {
+    if (recv (shm->sock, buf, sizeof (buf), 0) < 0 && errno != EINTR)
+    {
+      GVERROR ("shm: doorbell receive failed (errno %d)\n", errno);
+      dds_sleepfor (DDS_MSECS (100));
+    }
+    while (recv (shm->sock, buf, sizeof (buf), MSG_DONTWAIT) > 0)
+      ;
+
+    /* deliver without holding the lock, listeners may end up detaching */
+    uint32_t n = 0;
+    ddsrt_mutex_lock (&shm->lock);
+    if (shm->natts > atts_size)
+    {
+      atts_size = shm->natts;
+      atts = ddsrt_realloc (atts, atts_size * sizeof (*atts));
+    }
+    for (struct ddsi_shm_attachment *att = shm->atts; att; att = att->next)
+    {
+      ddsrt_atomic_inc32 (&att->refc);
+      atts[n++] = att;
+    }
+    ddsrt_mutex_unlock (&shm->lock);
+    for (uint32_t i = 0; i < n; i++)
+    {
+      shm_deliver (gv, ts1, atts[i]);
+      shm_attachment_unref (atts[i]);
+    }
+  }
+  ddsrt_free (atts);
+  return 0;
+}
+
+/*************************
+ ******   DOMAIN    ******
+ *************************/
+
+static bool shm_make_hostid (ddsi_keyhash_t *hostid)
+{
+  /* same boot, same /dev/shm (mount namespace), same abstract socket
+     namespace (network namespace) and same user (file permissions) */
+  char buf[64];
+  struct stat statbuf;
+  ssize_t n;
+  int fd;
+  if ((fd = open ("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC)) < 0)
+    return false;
+  n = read (fd, buf, sizeof (buf) - 1);
+  (void) close (fd);
+  if (n <= 0)
+    return false;
+  buf[n] = 0;
+  memset (hostid, 0, sizeof (*hostid));
+  for (size_t i = 0, j = 0; buf[i] && j < 2 * sizeof (hostid->value); i++)
+  {
+    int v;
+    if (buf[i] >= '0' && buf[i] <= '9') v = buf[i] - '0';
+    else if (buf[i] >= 'a' && buf[i] <= 'f') v = buf[i] - 'a' + 10;
+    else continue;
+    hostid->value[j / 2] |= (unsigned char) (v << ((j % 2) ? 0 : 4));
+    j++;
+  }
+  const uint64_t ns[3] = {
+    (stat ("/proc/self/ns/mnt", &statbuf) == 0) ? (uint64_t) statbuf.st_ino : 0,
+    (stat ("/proc/self/ns/net", &statbuf) == 0) ? (uint64_t) statbuf.st_ino : 0,
+    (uint64_t) getuid ()
+  };
+  for (size_t i = 0; i < sizeof (ns) / sizeof (ns[0]); i++)
+    for (size_t j = 0; j < 8; j++)
+      hostid->value[(8 * i + j) % sizeof (hostid->value)] ^= (unsigned char) (ns[i] >> (8 * j));
+  return true;
+}
+
+int ddsi_shm_init (struct ddsi_domaingv *gv)
+{
+  struct ddsi_shm_domain *shm;
+  int sock;
+  uint32_t id = 0;
+
+  if (!shm_make_hostid (&gv->shm_hostid))
+  {
+    GVERROR ("shm: can't determine host id\n");
+    return -1;
+  }
+  if ((sock = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+  {
+    GVERROR ("shm: can't create doorbell socket (errno %d)\n", errno);
+    return -1;
+  }
+  for (int tries = 0; tries < 10; tries++)
+  {
+    struct sockaddr_un addr;
+    socklen_t addrlen;
+    if ((id = ddsrt_random ()) == 0)
+      continue;
+    addrlen = shm_doorbell_addr (&addr, id);
+    if (bind (sock, (struct sockaddr *) &addr, addrlen) == 0)
+      break;
+    id = 0;
+    if (errno != EADDRINUSE)
+      break;
+  }
+  if (id == 0)
+  {
+    GVERROR ("shm: can't bind doorbell socket (errno %d)\n", errno);
+    (void) close (sock);
+    return -1;
+  }
+  shm = ddsrt_malloc (sizeof (*shm));
+  ddsrt_mutex_init (&shm->lock);
+  shm->atts = NULL;
+  shm->natts = 0;
+  shm->sock = sock;
+  shm->id = id;
+  ddsrt_atomic_st32 (&shm->keepgoing, 1);
+  shm->ts = NULL;
+  gv->shm = shm;
+  GVLOG (DDS_LC_CONFIG, "shm: doorbell %08"PRIx32"\n", id);
+  return 0;
+}
+
+int ddsi_shm_start (struct ddsi_domaingv *gv)
+{
+  if (create_thread (&gv->shm->ts, gv, "shm", shm_thread, gv) != DDS_RETCODE_OK)
+  {
+    GVERROR ("shm: failed to create delivery thread\n");
+    return -1;
+  }
+  return 0;
+}
+
+void ddsi_shm_stop (struct ddsi_domaingv *gv)
+{
+  struct ddsi_shm_domain * const shm = gv->shm;
+  if (shm->ts == NULL)
+    return;
+  ddsrt_atomic_st32 (&shm->keepgoing, 0);
+  struct sockaddr_un addr;
+  const socklen_t addrlen = shm_doorbell_addr (&addr, shm->id);
+  (void) sendto (shm->sock, "", 1, MSG_DONTWAIT, (struct sockaddr *) &addr, addrlen);
+  join_thread (shm->ts);
+  shm->ts = NULL;
+}
+
+void ddsi_shm_fini (struct ddsi_domaingv *gv)
+{
+  struct ddsi_shm_domain * const shm = gv->shm;
+  assert (shm->ts == NULL);
+  /* all proxy writers have been deleted by now */
+  while (shm->atts)
+    ddsi_shm_detach (gv, shm->atts);
+  (void) close (shm->sock);
+  ddsrt_mutex_destroy (&shm->lock);
+  ddsrt_free (shm);
+  gv->shm = NULL;
+}
+
+#else
+
+bool ddsi_shm_type_eligible (const struct ddsi_sertype *type)
+{
+  (void) type;
+  return false;
+}
+
+bool ddsi_shm_same_host (const struct ddsi_domaingv *gv, const struct ddsi_plist *plist)
+{
+  (void) gv; (void) plist;
+  return false;
+}
+
+int ddsi_shm_init (struct ddsi_domaingv *gv)
+{
+  GVERROR ("shm: shared memory is not supported on this platform\n");
+  return -1;
+}
+
+int ddsi_shm_start (struct ddsi_domaingv *gv) { (void) gv; return 0; }
+void ddsi_shm_stop (struct ddsi_domaingv *gv) { (void) gv; }
+void ddsi_shm_fini (struct ddsi_domaingv *gv) { (void) gv; }
+
+struct ddsi_shm_writer *ddsi_shm_writer_new (struct ddsi_domaingv *gv, const ddsi_guid_t *guid, const struct ddsi_sertype *type)
+{
+  (void) gv; (void) guid; (void) type;
+  return NULL;
+}
+
+void ddsi_shm_writer_free (struct ddsi_shm_writer *shm) { (void) shm; }
+void *ddsi_shm_writer_loan (struct ddsi_shm_writer *shm) { (void) shm; return NULL; }
+bool ddsi_shm_writer_return_loan (struct ddsi_shm_writer *shm, const void *sample) { (void) shm; (void) sample; return false; }
+void ddsi_shm_writer_publish (struct ddsi_shm_writer *shm, const struct ddsi_serdata *d, const void *sample) { (void) shm; (void) d; (void) sample; }
+
+struct ddsi_shm_attachment *ddsi_shm_attach (struct ddsi_domaingv *gv, const ddsi_guid_t *pwr_guid, const struct ddsi_sertype *type)
+{
+  (void) gv; (void) pwr_guid; (void) type;
+  return NULL;
+}
+
+void ddsi_shm_detach (struct ddsi_domaingv *gv, struct ddsi_shm_attachment *att) { (void) gv; (void) att; }
+void *ddsi_serdata_shm_sample (const struct ddsi_serdata *d) { (void) d; return NULL; }
+
+#endif
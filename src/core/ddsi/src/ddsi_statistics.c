@@ -16,14 +16,18 @@
 #include "dds/ddsi/ddsi_statistics.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_whc.h"
 
-void ddsi_get_writer_stats (struct writer *wr, uint64_t * __restrict rexmit_bytes, uint32_t * __restrict throttle_count, uint64_t * __restrict time_throttled, uint64_t * __restrict time_retransmit)
+void ddsi_get_writer_stats (struct writer *wr, uint64_t * __restrict rexmit_bytes, uint32_t * __restrict throttle_count, uint64_t * __restrict time_throttled, uint64_t * __restrict time_retransmit, uint64_t * __restrict unacked_bytes)
 {
+  struct whc_state whcst;
   ddsrt_mutex_lock (&wr->e.lock);
   *rexmit_bytes = wr->rexmit_bytes;
   *throttle_count = wr->throttle_count;
   *time_throttled = wr->time_throttled;
   *time_retransmit = wr->time_retransmit;
+  whc_get_state (wr->whc, &whcst);
+  *unacked_bytes = whcst.unacked_bytes;
   ddsrt_mutex_unlock (&wr->e.lock);
 }
 
@@ -36,6 +36,12 @@ extern inline int ddsi_listener_locator (ddsi_tran_listener_t listener, ddsi_loc
 extern inline int ddsi_listener_listen (ddsi_tran_listener_t listener);
 extern inline ddsi_tran_conn_t ddsi_listener_accept (ddsi_tran_listener_t listener);
 extern inline ssize_t ddsi_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc);
+extern inline bool ddsi_conn_supports_write_multiple (const struct ddsi_tran_conn *conn);
+extern inline ssize_t ddsi_conn_write_multiple (ddsi_tran_conn_t conn, size_t ndst, const ddsi_locator_t *dsts, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags);
+extern inline bool ddsi_conn_supports_write_segmented (const struct ddsi_tran_conn *conn);
+extern inline ssize_t ddsi_conn_write_segmented (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags, size_t segsize);
+extern inline bool ddsi_conn_supports_read_multiple (const struct ddsi_tran_conn *conn);
+extern inline ssize_t ddsi_conn_read_multiple (ddsi_tran_conn_t conn, size_t nbufs, struct ddsi_tran_recvbuf *bufs);
 extern inline ssize_t ddsi_conn_write (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags);
 
 void ddsi_factory_add (struct ddsi_domaingv *gv, ddsi_tran_factory_t factory)
@@ -163,6 +169,8 @@ void ddsi_factory_conn_init (const struct ddsi_tran_factory *factory, ddsi_tran_
   ddsrt_atomic_st32 (&conn->m_count, 1);
   conn->m_connless = factory->m_connless;
   conn->m_stream = factory->m_stream;
+  conn->m_coalesced_read = false;
+  conn->m_read_timestamps = false;
   conn->m_factory = (struct ddsi_tran_factory *) factory;
   conn->m_base.gv = factory->gv;
 }
@@ -26,8 +26,13 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_pcap.h"
+#include "dds/ddsi/q_protocol.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 
+#if DDSRT_HAVE_REUSEPORT_CBPF
+#include <linux/filter.h>
+#endif
+
 union addr {
   struct sockaddr_storage x;
   struct sockaddr a;
@@ -44,6 +49,9 @@ typedef struct ddsi_udp_conn {
   WSAEVENT m_sockEvent;
 #endif
   int m_diffserv;
+#if DDSRT_HAVE_UDP_SEGMENT
+  ddsrt_atomic_uint32_t m_gso_disabled;
+#endif
 } *ddsi_udp_conn_t;
 
 typedef struct ddsi_udp_tran_factory {
@@ -59,6 +67,58 @@ static void addr_to_loc (const struct ddsi_tran_factory *tran, ddsi_locator_t *d
   ddsi_ipaddr_to_loc (tran, dst, &src->a, (src->a.sa_family == AF_INET) ? NN_LOCATOR_KIND_UDPv4 : NN_LOCATOR_KIND_UDPv6);
 }
 
+static void ddsi_udp_conn_received (ddsi_udp_conn_t conn, const union addr *src, unsigned char *buf, size_t len, size_t sz, size_t segsize, bool trunc_flag)
+{
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  if (gv->pcap_fp)
+  {
+    union addr dest;
+    socklen_t dest_len = sizeof (dest);
+    const ddsrt_wctime_t now = ddsrt_time_wallclock ();
+    if (ddsrt_getsockname (conn->m_sock, &dest.a, &dest_len) != DDS_RETCODE_OK)
+      memset (&dest, 0, sizeof (dest));
+    if (segsize == 0 || segsize >= sz)
+      write_pcap_received (gv, now, &src->x, &dest.x, buf, sz);
+    else
+    {
+      /* Log the datagrams as they appeared on the wire */
+      for (size_t off = 0; off < sz; off += segsize)
+        write_pcap_received (gv, now, &src->x, &dest.x, buf + off, (sz - off < segsize) ? sz - off : segsize);
+    }
+  }
+
+  /* Check for udp packet truncation */
+  if (sz > len || trunc_flag)
+  {
+    char addrbuf[DDSI_LOCSTRLEN];
+    ddsi_locator_t tmp;
+    addr_to_loc (conn->m_base.m_factory, &tmp, src);
+    ddsi_locator_to_string (addrbuf, sizeof (addrbuf), &tmp);
+    GVWARNING ("%s => %d truncated to %d\n", addrbuf, (int) sz, (int) len);
+  }
+}
+
+static void init_recv_msghdr (ddsrt_msghdr_t *msghdr, union addr *src, ddsrt_iovec_t *msg_iov, unsigned char *buf, size_t len)
+{
+  msg_iov->iov_base = (void *) buf;
+  msg_iov->iov_len = (ddsrt_iov_len_t) len; /* Windows uses unsigned, POSIX (except Linux) int */
+
+  msghdr->msg_name = &src->x;
+  msghdr->msg_namelen = (socklen_t) sizeof (*src);
+  msghdr->msg_iov = msg_iov;
+  msghdr->msg_iovlen = 1;
+#if defined(__sun) && !defined(_XPG4_2)
+  msghdr->msg_accrights = NULL;
+  msghdr->msg_accrightslen = 0;
+#else
+  msghdr->msg_control = NULL;
+  msghdr->msg_controllen = 0;
+#endif
+#if DDSRT_MSGHDR_FLAGS
+  msghdr->msg_flags = 0;
+#endif
+}
+
 static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc)
 {
   ddsi_udp_conn_t conn = (ddsi_udp_conn_t) conn_cmn;
@@ -68,24 +128,9 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
   ddsrt_msghdr_t msghdr;
   union addr src;
   ddsrt_iovec_t msg_iov;
-  socklen_t srclen = (socklen_t) sizeof (src);
   (void) allow_spurious;
 
-  msg_iov.iov_base = (void *) buf;
-  msg_iov.iov_len = (ddsrt_iov_len_t) len; /* Windows uses unsigned, POSIX (except Linux) int */
-
-  msghdr.msg_name = &src.x;
-  msghdr.msg_namelen = srclen;
-  msghdr.msg_iov = &msg_iov;
-  msghdr.msg_iovlen = 1;
-#if defined(__sun) && !defined(_XPG4_2)
-  msghdr.msg_accrights = NULL;
-  msghdr.msg_accrightslen = 0;
-#else
-  msghdr.msg_control = NULL;
-  msghdr.msg_controllen = 0;
-#endif
-
+  init_recv_msghdr (&msghdr, &src, &msg_iov, buf, len);
   do {
     rc = ddsrt_recvmsg (conn->m_sock, &msghdr, 0, &ret);
   } while (rc == DDS_RETCODE_INTERRUPTED);
@@ -94,30 +139,12 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
   {
     if (srcloc)
       addr_to_loc (conn->m_base.m_factory, srcloc, &src);
-
-    if (gv->pcap_fp)
-    {
-      union addr dest;
-      socklen_t dest_len = sizeof (dest);
-      if (ddsrt_getsockname (conn->m_sock, &dest.a, &dest_len) != DDS_RETCODE_OK)
-        memset (&dest, 0, sizeof (dest));
-      write_pcap_received (gv, ddsrt_time_wallclock (), &src.x, &dest.x, buf, (size_t) ret);
-    }
-
-    /* Check for udp packet truncation */
 #if DDSRT_MSGHDR_FLAGS
     const bool trunc_flag = (msghdr.msg_flags & MSG_TRUNC) != 0;
 #else
     const bool trunc_flag = false;
 #endif
-    if ((size_t) ret > len || trunc_flag)
-    {
-      char addrbuf[DDSI_LOCSTRLEN];
-      ddsi_locator_t tmp;
-      addr_to_loc (conn->m_base.m_factory, &tmp, &src);
-      ddsi_locator_to_string (addrbuf, sizeof (addrbuf), &tmp);
-      GVWARNING ("%s => %d truncated to %d\n", addrbuf, (int) ret, (int) len);
-    }
+    ddsi_udp_conn_received (conn, &src, buf, len, (size_t) ret, 0, trunc_flag);
   }
   else if (rc != DDS_RETCODE_BAD_PARAMETER && rc != DDS_RETCODE_NO_CONNECTION)
   {
@@ -127,6 +154,103 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
   return ret;
 }
 
+#if DDSRT_HAVE_RECVMMSG
+/* Upper bound on the number of messages read in one call, it bounds the
+   stack space needed for the message headers and source addresses */
+#define DDSI_UDP_MAX_READ_MULTIPLE 64
+
+/* Control messages read_multiple may need to receive: the segment size of
+   coalesced packets and the kernel receive timestamp */
+#define DDSI_UDP_RECV_CMSG (DDSRT_HAVE_UDP_GRO || DDSRT_HAVE_SO_TIMESTAMPNS)
+#if DDSRT_HAVE_UDP_GRO
+#define DDSI_UDP_RECV_CMSG_GRO_SPACE CMSG_SPACE (sizeof (int))
+#else
+#define DDSI_UDP_RECV_CMSG_GRO_SPACE 0
+#endif
+#if DDSRT_HAVE_SO_TIMESTAMPNS
+#define DDSI_UDP_RECV_CMSG_TS_SPACE CMSG_SPACE (sizeof (struct timespec))
+#else
+#define DDSI_UDP_RECV_CMSG_TS_SPACE 0
+#endif
+
+static ssize_t ddsi_udp_conn_read_multiple (ddsi_tran_conn_t conn_cmn, size_t nbufs, struct ddsi_tran_recvbuf *bufs)
+{
+  ddsi_udp_conn_t conn = (ddsi_udp_conn_t) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  ddsrt_mmsghdr_t msgs[DDSI_UDP_MAX_READ_MULTIPLE];
+  ddsrt_iovec_t msg_iovs[DDSI_UDP_MAX_READ_MULTIPLE];
+  union addr srcs[DDSI_UDP_MAX_READ_MULTIPLE];
+#if DDSI_UDP_RECV_CMSG
+  union { struct cmsghdr align; char buf[DDSI_UDP_RECV_CMSG_GRO_SPACE + DDSI_UDP_RECV_CMSG_TS_SPACE]; } ctrls[DDSI_UDP_MAX_READ_MULTIPLE];
+  const bool want_cmsg = conn->m_base.m_coalesced_read || conn->m_base.m_read_timestamps;
+#endif
+  uint32_t nmsgs = 0;
+  dds_return_t rc;
+
+  if (nbufs > DDSI_UDP_MAX_READ_MULTIPLE)
+    nbufs = DDSI_UDP_MAX_READ_MULTIPLE;
+  for (size_t i = 0; i < nbufs; i++)
+  {
+    init_recv_msghdr (&msgs[i].msg_hdr, &srcs[i], &msg_iovs[i], bufs[i].buf, bufs[i].len);
+#if DDSI_UDP_RECV_CMSG
+    if (want_cmsg)
+    {
+      msgs[i].msg_hdr.msg_control = ctrls[i].buf;
+      msgs[i].msg_hdr.msg_controllen = sizeof (ctrls[i].buf);
+    }
+#endif
+    msgs[i].msg_len = 0;
+  }
+
+  do {
+    rc = ddsrt_recvmmsg (conn->m_sock, msgs, (uint32_t) nbufs, 0, &nmsgs);
+  } while (rc == DDS_RETCODE_INTERRUPTED);
+
+  if (rc != DDS_RETCODE_OK)
+  {
+    if (rc == DDS_RETCODE_BAD_PARAMETER || rc == DDS_RETCODE_NO_CONNECTION || rc == DDS_RETCODE_TRY_AGAIN)
+      return 0;
+    GVERROR ("UDP recvmmsg sock %d: retcode %"PRId32"\n", (int) conn->m_sock, rc);
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < nmsgs; i++)
+  {
+    bufs[i].sz = msgs[i].msg_len;
+    bufs[i].segsize = 0;
+    bufs[i].timestamp = DDSRT_WCTIME_INVALID;
+#if DDSI_UDP_RECV_CMSG
+    if (want_cmsg)
+    {
+      for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR (&msgs[i].msg_hdr, cmsg))
+      {
+#if DDSRT_HAVE_UDP_GRO
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+          int gso_size;
+          memcpy (&gso_size, CMSG_DATA (cmsg), sizeof (gso_size));
+          if (gso_size > 0 && (size_t) gso_size < bufs[i].sz)
+            bufs[i].segsize = (size_t) gso_size;
+        }
+#endif
+#if DDSRT_HAVE_SO_TIMESTAMPNS
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+          struct timespec ts;
+          memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+          bufs[i].timestamp.v = DDS_SECS ((int64_t) ts.tv_sec) + (int64_t) ts.tv_nsec;
+        }
+#endif
+      }
+    }
+#endif
+    addr_to_loc (conn->m_base.m_factory, &bufs[i].srcloc, &srcs[i]);
+    ddsi_udp_conn_received (conn, &srcs[i], bufs[i].buf, bufs[i].len, bufs[i].sz, bufs[i].segsize, (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0);
+  }
+  return (ssize_t) nmsgs;
+}
+#endif
+
 static void set_msghdr_iov (ddsrt_msghdr_t *mhdr, const ddsrt_iovec_t *iov, size_t iovlen)
 {
   mhdr->msg_iov = (ddsrt_iovec_t *) iov;
@@ -190,6 +314,226 @@ static ssize_t ddsi_udp_conn_write (ddsi_tran_conn_t conn_cmn, const ddsi_locato
   return (rc == DDS_RETCODE_OK) ? ret : -1;
 }
 
+#if DDSRT_HAVE_SENDMMSG
+/* Upper bound on the number of messages sent in one call, it bounds the
+   stack space needed for the message headers and destination addresses */
+#define DDSI_UDP_MAX_WRITE_MULTIPLE 64
+
+static ssize_t ddsi_udp_conn_write_multiple (ddsi_tran_conn_t conn_cmn, size_t ndst, const ddsi_locator_t *dsts, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  ddsi_udp_conn_t conn = (ddsi_udp_conn_t) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  ddsrt_mmsghdr_t msgs[DDSI_UDP_MAX_WRITE_MULTIPLE];
+  union addr dstaddrs[DDSI_UDP_MAX_WRITE_MULTIPLE];
+  size_t done = 0, nsent = 0;
+  int sendflags = 0;
+  assert (niov <= INT_MAX);
+#if MSG_NOSIGNAL && !LWIP_SOCKET
+  sendflags |= MSG_NOSIGNAL;
+#endif
+  while (done < ndst)
+  {
+    const uint32_t n = (ndst - done < DDSI_UDP_MAX_WRITE_MULTIPLE) ? (uint32_t) (ndst - done) : DDSI_UDP_MAX_WRITE_MULTIPLE;
+    uint32_t nmsgs = 0;
+    unsigned retry = 2;
+    dds_return_t rc;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      ddsi_ipaddr_from_loc (&dstaddrs[i].x, &dsts[done + i]);
+      set_msghdr_iov (&msgs[i].msg_hdr, iov, niov);
+      msgs[i].msg_hdr.msg_name = &dstaddrs[i].x;
+      msgs[i].msg_hdr.msg_namelen = (socklen_t) ddsrt_sockaddr_get_size (&dstaddrs[i].a);
+      msgs[i].msg_hdr.msg_control = NULL;
+      msgs[i].msg_hdr.msg_controllen = 0;
+      msgs[i].msg_hdr.msg_flags = (int) flags;
+      msgs[i].msg_len = 0;
+    }
+    do {
+      rc = ddsrt_sendmmsg (conn->m_sock, msgs, n, sendflags, &nmsgs);
+    } while (rc == DDS_RETCODE_INTERRUPTED || rc == DDS_RETCODE_TRY_AGAIN || (rc == DDS_RETCODE_NOT_ALLOWED && retry-- > 0));
+    if (rc == DDS_RETCODE_OK)
+    {
+      if (gv->pcap_fp)
+      {
+        union addr sa;
+        socklen_t alen = sizeof (sa);
+        if (ddsrt_getsockname (conn->m_sock, &sa.a, &alen) != DDS_RETCODE_OK)
+          memset(&sa, 0, sizeof(sa));
+        for (uint32_t i = 0; i < nmsgs; i++)
+          write_pcap_sent (gv, ddsrt_time_wallclock (), &sa.x, &msgs[i].msg_hdr, msgs[i].msg_len);
+      }
+      done += nmsgs;
+      nsent += nmsgs;
+    }
+    else
+    {
+      /* Failure to send to the first destination: skip it, just like a
+         failing ddsi_udp_conn_write for that destination would */
+      if (rc != DDS_RETCODE_NOT_ALLOWED && rc != DDS_RETCODE_NO_CONNECTION)
+      {
+        char locbuf[DDSI_LOCSTRLEN];
+        GVERROR ("ddsi_udp_conn_write_multiple to %s failed with retcode %"PRId32"\n", ddsi_locator_to_string (locbuf, sizeof (locbuf), &dsts[done]), rc);
+      }
+      done++;
+    }
+  }
+  return (ssize_t) nsent;
+}
+#endif
+
+#if DDSRT_HAVE_UDP_SEGMENT
+static ssize_t ddsi_udp_conn_write_segments_individually (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags, size_t segsize)
+{
+  ssize_t nsent = 0;
+  size_t start = 0, len = 0;
+  bool ok = false;
+  for (size_t i = 0; i < niov; i++)
+  {
+    len += iov[i].iov_len;
+    assert (len <= segsize);
+    if (len == segsize || i == niov - 1)
+    {
+      const ssize_t n = ddsi_udp_conn_write (conn, dst, i + 1 - start, &iov[start], flags);
+      if (n > 0)
+      {
+        nsent += n;
+        ok = true;
+      }
+      start = i + 1;
+      len = 0;
+    }
+  }
+  return ok ? nsent : -1;
+}
+
+static ssize_t ddsi_udp_conn_write_segmented (ddsi_tran_conn_t conn_cmn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags, size_t segsize)
+{
+  ddsi_udp_conn_t conn = (ddsi_udp_conn_t) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  union { struct cmsghdr align; char buf[CMSG_SPACE (sizeof (uint16_t))]; } ctrl;
+  const uint16_t gso_size = (uint16_t) segsize;
+  struct cmsghdr *cmsg;
+  dds_return_t rc;
+  ssize_t ret = -1;
+  unsigned retry = 2;
+  int sendflags = 0;
+  ddsrt_msghdr_t msg;
+  union addr dstaddr;
+  assert (niov <= INT_MAX);
+  assert (segsize > 0 && segsize <= UINT16_MAX);
+
+  if (ddsrt_atomic_ld32 (&conn->m_gso_disabled))
+    return ddsi_udp_conn_write_segments_individually (conn_cmn, dst, niov, iov, flags, segsize);
+
+  ddsi_ipaddr_from_loc (&dstaddr.x, dst);
+  set_msghdr_iov (&msg, iov, niov);
+  msg.msg_name = &dstaddr.x;
+  msg.msg_namelen = (socklen_t) ddsrt_sockaddr_get_size (&dstaddr.a);
+  memset (&ctrl, 0, sizeof (ctrl));
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof (ctrl.buf);
+  msg.msg_flags = (int) flags;
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (gso_size));
+  memcpy (CMSG_DATA (cmsg), &gso_size, sizeof (gso_size));
+#if MSG_NOSIGNAL
+  sendflags |= MSG_NOSIGNAL;
+#endif
+  do {
+    rc = ddsrt_sendmsg (conn->m_sock, &msg, sendflags, &ret);
+  } while (rc == DDS_RETCODE_INTERRUPTED || rc == DDS_RETCODE_TRY_AGAIN || (rc == DDS_RETCODE_NOT_ALLOWED && retry-- > 0));
+  if (rc == DDS_RETCODE_OK)
+  {
+    if (ret > 0 && gv->pcap_fp)
+    {
+      /* Log the datagrams as they appear on the wire */
+      union addr sa;
+      socklen_t alen = sizeof (sa);
+      size_t start = 0, len = 0;
+      if (ddsrt_getsockname (conn->m_sock, &sa.a, &alen) != DDS_RETCODE_OK)
+        memset(&sa, 0, sizeof(sa));
+      for (size_t i = 0; i < niov; i++)
+      {
+        len += iov[i].iov_len;
+        if (len == segsize || i == niov - 1)
+        {
+          ddsrt_msghdr_t segmsg;
+          set_msghdr_iov (&segmsg, &iov[start], i + 1 - start);
+          write_pcap_sent (gv, ddsrt_time_wallclock (), &sa.x, &segmsg, len);
+          start = i + 1;
+          len = 0;
+        }
+      }
+    }
+    return ret;
+  }
+  else if (rc == DDS_RETCODE_NOT_ALLOWED || rc == DDS_RETCODE_NO_CONNECTION)
+  {
+    return -1;
+  }
+  else
+  {
+    /* Segmentation offload can fail at run-time, e.g., when the interface doesn't
+       support checksum offloading, so fall back to sending the segments one-by-one
+       from here on */
+    if (ddsrt_atomic_cas32 (&conn->m_gso_disabled, 0, 1))
+    {
+      char locbuf[DDSI_LOCSTRLEN];
+      GVWARNING ("ddsi_udp_conn_write_segmented to %s failed with retcode %"PRId32", disabling segmentation offload on socket %"PRIdSOCK"\n", ddsi_locator_to_string (locbuf, sizeof (locbuf), dst), rc, conn->m_sock);
+    }
+    return ddsi_udp_conn_write_segments_individually (conn_cmn, dst, niov, iov, flags, segsize);
+  }
+}
+
+static bool ddsi_udp_supports_gso (ddsrt_socket_t sock)
+{
+  int gso_size = 0;
+  socklen_t optlen = (socklen_t) sizeof (gso_size);
+  return ddsrt_getsockopt (sock, SOL_UDP, UDP_SEGMENT, &gso_size, &optlen) == DDS_RETCODE_OK;
+}
+#endif
+
+#if DDSRT_HAVE_REUSEPORT_CBPF
+static dds_return_t ddsi_udp_attach_shard_filter (ddsrt_socket_t sock, uint32_t nshards, bool steer_by_guid_prefix)
+{
+  /* The program sees the UDP payload and returns the index of the socket in the
+     SO_REUSEPORT group, sockets being indexed in the order in which they were bound.
+     One-byte messages are used for triggering the receive threads and contain the
+     shard index; RTPS messages either go to a shard determined by the GUID prefix
+     of the sender or are left to the kernel (which it does for an index that is
+     out of range). */
+  struct sock_filter code[] = {
+    BPF_STMT (BPF_LD | BPF_W | BPF_LEN, 0),
+    BPF_JUMP (BPF_JMP | BPF_JGE | BPF_K, (uint32_t) RTPS_MESSAGE_HEADER_SIZE, 2, 0),
+    BPF_STMT (BPF_LD | BPF_B | BPF_ABS, 0),
+    BPF_STMT (BPF_RET | BPF_A, 0),
+    BPF_STMT (BPF_LD | BPF_W | BPF_ABS, (uint32_t) offsetof (Header_t, guid_prefix)),
+    BPF_STMT (BPF_MISC | BPF_TAX, 0),
+    BPF_STMT (BPF_LD | BPF_W | BPF_ABS, (uint32_t) offsetof (Header_t, guid_prefix) + 4),
+    BPF_STMT (BPF_ALU | BPF_XOR | BPF_X, 0),
+    BPF_STMT (BPF_MISC | BPF_TAX, 0),
+    BPF_STMT (BPF_LD | BPF_W | BPF_ABS, (uint32_t) offsetof (Header_t, guid_prefix) + 8),
+    BPF_STMT (BPF_ALU | BPF_XOR | BPF_X, 0),
+    BPF_STMT (BPF_ALU | BPF_MOD | BPF_K, nshards),
+    BPF_STMT (BPF_RET | BPF_A, 0)
+  };
+  struct sock_fprog prog;
+  if (steer_by_guid_prefix)
+    prog.len = (unsigned short) (sizeof (code) / sizeof (code[0]));
+  else
+  {
+    /* Without steering, RTPS messages return immediately after the length check */
+    const struct sock_filter ret_out_of_range = BPF_STMT (BPF_RET | BPF_K, UINT32_MAX);
+    code[4] = ret_out_of_range;
+    prog.len = 5;
+  }
+  prog.filter = code;
+  return ddsrt_setsockopt (sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof (prog));
+}
+#endif
+
 static void ddsi_udp_disable_multiplexing (ddsi_tran_conn_t conn_cmn)
 {
 #if defined _WIN32 && !defined WINCE
@@ -513,6 +857,16 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
     }
   }
 
+#if DDSRT_HAVE_REUSEPORT_CBPF
+  if (qos->m_nshards > 1 && (rc = ddsrt_setsockopt (sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof (one))) != DDS_RETCODE_OK)
+  {
+    GVERROR ("ddsi_udp_create_conn: failed to enable port reuse for sharding: %s\n", dds_strretcode (rc));
+    goto fail_w_socket;
+  }
+#else
+  assert (qos->m_nshards <= 1);
+#endif
+
   if ((rc = set_rcvbuf (gv, sock, &gv->config.socket_min_rcvbuf_size)) < 0)
     goto fail_w_socket;
   if (rc > 0) {
@@ -547,6 +901,17 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
     goto fail_w_socket;
   }
 
+#if DDSRT_HAVE_REUSEPORT_CBPF
+  /* The filter applies to the whole group, attaching it once all shards exist
+     means the modulo operation in it uses the correct number of shards */
+  if (qos->m_nshards > 1 && qos->m_shard == qos->m_nshards - 1 &&
+      (rc = ddsi_udp_attach_shard_filter (sock, qos->m_nshards, gv->config.recv_shard_steering)) != DDS_RETCODE_OK)
+  {
+    GVERROR ("ddsi_udp_create_conn: failed to attach shard selection filter: %s\n", dds_strretcode (rc));
+    goto fail_w_socket;
+  }
+#endif
+
   rc = ipv6 ? set_mc_options_transmit_ipv6 (gv, sock) : set_mc_options_transmit_ipv4 (gv, sock);
   if (rc != DDS_RETCODE_OK)
     goto fail_w_socket;
@@ -579,7 +944,36 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
   conn->m_base.m_base.m_handle_fn = ddsi_udp_conn_handle;
 
   conn->m_base.m_read_fn = ddsi_udp_conn_read;
+#if DDSRT_HAVE_RECVMMSG
+  conn->m_base.m_read_multiple_fn = ddsi_udp_conn_read_multiple;
+#endif
   conn->m_base.m_write_fn = ddsi_udp_conn_write;
+#if DDSRT_HAVE_SENDMMSG
+  conn->m_base.m_write_multiple_fn = ddsi_udp_conn_write_multiple;
+#endif
+#if DDSRT_HAVE_UDP_SEGMENT
+  if (gv->config.xpack_send_segmented && ddsi_udp_supports_gso (sock))
+    conn->m_base.m_write_segmented_fn = ddsi_udp_conn_write_segmented;
+#endif
+#if DDSRT_HAVE_UDP_GRO && DDSRT_HAVE_RECVMMSG
+  /* Coalesced packets are up to 64kB and must fit in a receive buffer */
+  if (gv->config.recv_coalescing && qos->m_purpose != DDSI_TRAN_QOS_XMIT && gv->config.rmsg_chunk_size >= 65536)
+  {
+    if (ddsrt_setsockopt (sock, SOL_UDP, UDP_GRO, &one, sizeof (one)) == DDS_RETCODE_OK)
+      conn->m_base.m_coalesced_read = true;
+    else
+      GVLOG (DDS_LC_CONFIG, "ddsi_udp_create_conn: %s socket %"PRIdSOCK" doesn't support receive coalescing\n", purpose_str, sock);
+  }
+#endif
+#if DDSRT_HAVE_SO_TIMESTAMPNS && DDSRT_HAVE_RECVMMSG
+  if (gv->config.recv_kernel_timestamps && qos->m_purpose != DDSI_TRAN_QOS_XMIT)
+  {
+    if (ddsrt_setsockopt (sock, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof (one)) == DDS_RETCODE_OK)
+      conn->m_base.m_read_timestamps = true;
+    else
+      GVLOG (DDS_LC_CONFIG, "ddsi_udp_create_conn: %s socket %"PRIdSOCK" doesn't support kernel receive timestamps\n", purpose_str, sock);
+  }
+#endif
   conn->m_base.m_disable_multiplexing_fn = ddsi_udp_disable_multiplexing;
   conn->m_base.m_locator_fn = ddsi_udp_conn_locator;
 
@@ -860,6 +1254,7 @@ int ddsi_udp_init (struct ddsi_domaingv*gv)
   fact->fact.m_typename = "udp";
   fact->fact.m_default_spdp_address = "udp/239.255.0.1";
   fact->fact.m_connless = true;
+  fact->fact.m_supports_shards = DDSRT_HAVE_REUSEPORT_CBPF;
   fact->fact.m_supports_fn = ddsi_udp_supports;
   fact->fact.m_create_conn_fn = ddsi_udp_create_conn;
   fact->fact.m_release_conn_fn = ddsi_udp_release_conn;
@@ -0,0 +1,831 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/ddsi_xdp.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+
+#if DDSRT_HAVE_AF_XDP
+#include <linux/if_packet.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/bpf.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <errno.h>
+
+/* The AF_XDP transport uses the same wire format as the raw ethernet one:
+   RTPS messages directly in ethernet frames with the port number as
+   ethernet type, and RAWETH locators.  Instead of a packet socket, it uses
+   an AF_XDP socket per connection, all sharing a single UMEM region bound
+   to one queue of the interface, and an XDP program redirecting the frames
+   with the ethernet types of the connections to those sockets.
+
+   This is a copying transport: frames are received in the UMEM and copied
+   into the receive buffer (which is the payload of an nn_rmsg), after which
+   the frame is immediately returned to the fill ring.  Referencing the frame
+   from the nn_rmsg instead would tie up UMEM frames for as long as samples,
+   fragments and out-of-order messages retain the receive buffer, which is
+   unbounded and would starve the fill ring.  Transmitting likewise copies
+   the ethernet header and the iovecs into a free UMEM frame and posts it on
+   the TX ring.  "Zero-copy" below refers only to the socket bind mode, that
+   is, whether the driver or the kernel copies between the NIC and UMEM. */
+
+#define XDP_NFRAMES 4096u     /* frames in the UMEM region */
+#define XDP_FRAME_SIZE 4096u  /* size of a frame, bounds the message size */
+#define XDP_RING_SIZE 2048u   /* size of each of the rings, at most half the frames */
+#define XDP_MAX_CONNS 8u      /* maximum number of connections (XSKMAP size) */
+#define XDP_TX_RETRIES 100    /* attempts at getting a free frame before dropping a message */
+#define XDP_ETH_HDR_SIZE 14u
+
+struct ddsi_xdp_ring {
+  ddsrt_atomic_uint32_t *producer;
+  ddsrt_atomic_uint32_t *consumer;
+  void *descs;
+  void *map;
+  size_t mapsize;
+};
+
+typedef struct ddsi_xdp_conn {
+  struct ddsi_tran_conn m_base;
+  ddsrt_socket_t m_sock;
+  uint32_t m_slot;
+  struct ddsi_xdp_ring m_rx;
+  struct ddsi_xdp_ring m_tx;
+} *ddsi_xdp_conn_t;
+
+typedef struct ddsi_xdp_factory {
+  struct ddsi_tran_factory fact;
+  ddsrt_mutex_t lock; /* protects everything below and the TX rings */
+  uint32_t nconns;
+  struct ddsi_xdp_conn *conns[XDP_MAX_CONNS];
+  int ifindex;
+  uint32_t xdp_mode; /* XDP_FLAGS_DRV_MODE or XDP_FLAGS_SKB_MODE */
+  /* UMEM: owned by a dedicated socket that is not in the XSKMAP, all
+     connections bind to it using XDP_SHARED_UMEM */
+  ddsrt_socket_t umem_sock;
+  unsigned char *umem_area;
+  struct ddsi_xdp_ring fill;
+  struct ddsi_xdp_ring comp;
+  uint64_t *free_frames;
+  uint32_t nfree;
+  int xskmap_fd;
+  int link_fd;
+  ddsrt_socket_t mc_sock; /* packet socket for multicast memberships */
+} *ddsi_xdp_factory_t;
+
+static int xdp_bpf (enum bpf_cmd cmd, union bpf_attr *attr)
+{
+  return (int) syscall (__NR_bpf, cmd, attr, sizeof (*attr));
+}
+
+static struct bpf_insn xdp_insn (uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+{
+  struct bpf_insn insn;
+  memset (&insn, 0, sizeof (insn));
+  insn.code = code;
+  insn.dst_reg = dst & 0xfu;
+  insn.src_reg = src & 0xfu;
+  insn.off = off;
+  insn.imm = imm;
+  return insn;
+}
+
+/* Generates: if the frame is long enough to contain an ethernet header and
+   the ethernet type is the port of connection i, redirect it to the socket
+   in slot i of the XSKMAP; else pass it on to the network stack */
+static uint32_t xdp_make_prog (struct bpf_insn *prog, const struct ddsi_xdp_factory *fact)
+{
+  uint32_t slots[XDP_MAX_CONNS];
+  uint32_t n = 0, k = 0;
+  for (uint32_t i = 0; i < XDP_MAX_CONNS; i++)
+    if (fact->conns[i])
+      slots[n++] = i;
+  prog[k++] = xdp_insn (BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_1, offsetof (struct xdp_md, data), 0);
+  prog[k++] = xdp_insn (BPF_LDX | BPF_W | BPF_MEM, BPF_REG_3, BPF_REG_1, offsetof (struct xdp_md, data_end), 0);
+  prog[k++] = xdp_insn (BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+  prog[k++] = xdp_insn (BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, XDP_ETH_HDR_SIZE);
+  prog[k++] = xdp_insn (BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, (int16_t) (n + 1), 0);
+  prog[k++] = xdp_insn (BPF_LDX | BPF_H | BPF_MEM, BPF_REG_5, BPF_REG_2, 12, 0);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    const uint16_t ethtype = htons ((uint16_t) fact->conns[slots[i]]->m_base.m_base.m_port);
+    prog[k++] = xdp_insn (BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_5, 0, (int16_t) (n + 1 + 5 * i), ethtype);
+  }
+  prog[k++] = xdp_insn (BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+  prog[k++] = xdp_insn (BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    prog[k++] = xdp_insn (BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, fact->xskmap_fd);
+    prog[k++] = xdp_insn (0, 0, 0, 0, 0);
+    prog[k++] = xdp_insn (BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_2, 0, 0, (int32_t) slots[i]);
+    prog[k++] = xdp_insn (BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS);
+    prog[k++] = xdp_insn (BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+    prog[k++] = xdp_insn (BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+  }
+  return k;
+}
+
+/* Loads the program for the current set of connections and attaches it to
+   the interface, or replaces the attached one; the program is detached when
+   the link is closed, including when the process terminates */
+static dds_return_t xdp_attach_prog (ddsi_xdp_factory_t fact)
+{
+  const struct ddsi_domaingv *gv = fact->fact.gv;
+  struct bpf_insn prog[8 + 7 * XDP_MAX_CONNS];
+  union bpf_attr attr;
+  int prog_fd;
+  memset (&attr, 0, sizeof (attr));
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.expected_attach_type = BPF_XDP;
+  attr.insns = (uintptr_t) prog;
+  attr.insn_cnt = xdp_make_prog (prog, fact);
+  attr.license = (uintptr_t) "BSD";
+  if ((prog_fd = xdp_bpf (BPF_PROG_LOAD, &attr)) < 0)
+  {
+    GVERROR ("ddsi_xdp: loading XDP program failed: errno %d\n", errno);
+    return DDS_RETCODE_ERROR;
+  }
+
+  if (fact->link_fd >= 0)
+  {
+    memset (&attr, 0, sizeof (attr));
+    attr.link_update.link_fd = (uint32_t) fact->link_fd;
+    attr.link_update.new_prog_fd = (uint32_t) prog_fd;
+    if (xdp_bpf (BPF_LINK_UPDATE, &attr) < 0)
+    {
+      GVERROR ("ddsi_xdp: replacing XDP program failed: errno %d\n", errno);
+      close (prog_fd);
+      return DDS_RETCODE_ERROR;
+    }
+  }
+  else
+  {
+    /* try native mode unless generic mode is configured, generic (SKB) mode
+       is supported by any interface, including veth pairs */
+    const uint32_t modes[] = { XDP_FLAGS_DRV_MODE, XDP_FLAGS_SKB_MODE };
+    for (uint32_t i = gv->config.xdp_generic_mode ? 1 : 0; i < sizeof (modes) / sizeof (modes[0]) && fact->link_fd < 0; i++)
+    {
+      memset (&attr, 0, sizeof (attr));
+      attr.link_create.prog_fd = (uint32_t) prog_fd;
+      attr.link_create.target_ifindex = (uint32_t) fact->ifindex;
+      attr.link_create.attach_type = BPF_XDP;
+      attr.link_create.flags = modes[i];
+      if ((fact->link_fd = xdp_bpf (BPF_LINK_CREATE, &attr)) >= 0)
+        fact->xdp_mode = modes[i];
+    }
+    if (fact->link_fd < 0)
+    {
+      GVERROR ("ddsi_xdp: attaching XDP program to interface %d failed: errno %d\n", fact->ifindex, errno);
+      close (prog_fd);
+      return DDS_RETCODE_ERROR;
+    }
+  }
+  close (prog_fd);
+  return DDS_RETCODE_OK;
+}
+
+static int xdp_map_ring (struct ddsi_xdp_ring *ring, ddsrt_socket_t sock, const struct xdp_ring_offset *off, off_t pgoff, size_t descsize)
+{
+  ring->mapsize = off->desc + XDP_RING_SIZE * descsize;
+  if ((ring->map = mmap (NULL, ring->mapsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sock, pgoff)) == MAP_FAILED)
+  {
+    ring->map = NULL;
+    return -1;
+  }
+  ring->producer = (ddsrt_atomic_uint32_t *) ((char *) ring->map + off->producer);
+  ring->consumer = (ddsrt_atomic_uint32_t *) ((char *) ring->map + off->consumer);
+  ring->descs = (char *) ring->map + off->desc;
+  return 0;
+}
+
+static void xdp_unmap_ring (struct ddsi_xdp_ring *ring)
+{
+  if (ring->map)
+    munmap (ring->map, ring->mapsize);
+  ring->map = NULL;
+}
+
+static int xdp_set_ring_size (ddsrt_socket_t sock, int opt)
+{
+  const int size = XDP_RING_SIZE;
+  return setsockopt (sock, SOL_XDP, opt, &size, sizeof (size));
+}
+
+static int xdp_get_offsets (ddsrt_socket_t sock, struct xdp_mmap_offsets *offs)
+{
+  socklen_t optlen = sizeof (*offs);
+  return getsockopt (sock, SOL_XDP, XDP_MMAP_OFFSETS, offs, &optlen);
+}
+
+static bool xdp_fill_put_locked (ddsi_xdp_factory_t fact, uint64_t addr)
+{
+  const uint32_t prod = ddsrt_atomic_ld32 (fact->fill.producer);
+  if (prod - ddsrt_atomic_ld32 (fact->fill.consumer) >= XDP_RING_SIZE)
+    return false;
+  ((uint64_t *) fact->fill.descs)[prod & (XDP_RING_SIZE - 1)] = addr;
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (fact->fill.producer, prod + 1);
+  return true;
+}
+
+static void xdp_reclaim_locked (ddsi_xdp_factory_t fact)
+{
+  const uint32_t cons = ddsrt_atomic_ld32 (fact->comp.consumer);
+  const uint32_t prod = ddsrt_atomic_ld32 (fact->comp.producer);
+  ddsrt_atomic_fence_acq ();
+  for (uint32_t i = cons; i != prod; i++)
+  {
+    assert (fact->nfree < XDP_NFRAMES);
+    fact->free_frames[fact->nfree++] = ((const uint64_t *) fact->comp.descs)[i & (XDP_RING_SIZE - 1)];
+  }
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (fact->comp.consumer, prod);
+}
+
+static void xdp_umem_fini (ddsi_xdp_factory_t fact)
+{
+  if (fact->link_fd >= 0)
+    close (fact->link_fd);
+  if (fact->xskmap_fd >= 0)
+    close (fact->xskmap_fd);
+  xdp_unmap_ring (&fact->fill);
+  xdp_unmap_ring (&fact->comp);
+  if (fact->umem_sock != DDSRT_INVALID_SOCKET)
+    ddsrt_close (fact->umem_sock);
+  if (fact->umem_area)
+    munmap (fact->umem_area, (size_t) XDP_NFRAMES * XDP_FRAME_SIZE);
+  ddsrt_free (fact->free_frames);
+  fact->link_fd = fact->xskmap_fd = -1;
+  fact->umem_sock = DDSRT_INVALID_SOCKET;
+  fact->umem_area = NULL;
+  fact->free_frames = NULL;
+  fact->nfree = 0;
+}
+
+/* Sets up the UMEM region, the XSKMAP and the XDP program for the selected
+   interface; done when the first connection is created because the
+   interface is not yet known when the factory is initialized */
+static dds_return_t xdp_umem_init (ddsi_xdp_factory_t fact)
+{
+  const struct ddsi_domaingv *gv = fact->fact.gv;
+  struct xdp_umem_reg reg;
+  struct xdp_mmap_offsets offs;
+  struct sockaddr_xdp sxdp;
+  union bpf_attr attr;
+  const char *what;
+
+  fact->ifindex = (int) gv->interfaceNo;
+  fact->free_frames = ddsrt_malloc (XDP_NFRAMES * sizeof (*fact->free_frames));
+  what = "mmap UMEM";
+  if ((fact->umem_area = mmap (NULL, (size_t) XDP_NFRAMES * XDP_FRAME_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+  {
+    fact->umem_area = NULL;
+    goto err;
+  }
+  what = "socket";
+  if ((fact->umem_sock = socket (AF_XDP, SOCK_RAW, 0)) < 0)
+  {
+    fact->umem_sock = DDSRT_INVALID_SOCKET;
+    goto err;
+  }
+  memset (&reg, 0, sizeof (reg));
+  reg.addr = (uintptr_t) fact->umem_area;
+  reg.len = (uint64_t) XDP_NFRAMES * XDP_FRAME_SIZE;
+  reg.chunk_size = XDP_FRAME_SIZE;
+  reg.headroom = 0;
+  what = "register UMEM";
+  if (setsockopt (fact->umem_sock, SOL_XDP, XDP_UMEM_REG, &reg, sizeof (reg)) < 0)
+    goto err;
+  /* a socket needs an RX or a TX ring to be bound, it never transmits */
+  what = "set ring sizes";
+  if (xdp_set_ring_size (fact->umem_sock, XDP_UMEM_FILL_RING) < 0 ||
+      xdp_set_ring_size (fact->umem_sock, XDP_UMEM_COMPLETION_RING) < 0 ||
+      xdp_set_ring_size (fact->umem_sock, XDP_TX_RING) < 0)
+    goto err;
+  what = "map fill and completion rings";
+  if (xdp_get_offsets (fact->umem_sock, &offs) < 0 ||
+      xdp_map_ring (&fact->fill, fact->umem_sock, &offs.fr, (off_t) XDP_UMEM_PGOFF_FILL_RING, sizeof (uint64_t)) < 0 ||
+      xdp_map_ring (&fact->comp, fact->umem_sock, &offs.cr, (off_t) XDP_UMEM_PGOFF_COMPLETION_RING, sizeof (uint64_t)) < 0)
+    goto err;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof (uint32_t);
+  attr.value_size = sizeof (uint32_t);
+  attr.max_entries = XDP_MAX_CONNS;
+  what = "create XSKMAP";
+  if ((fact->xskmap_fd = xdp_bpf (BPF_MAP_CREATE, &attr)) < 0)
+    goto err;
+  if (xdp_attach_prog (fact) != DDS_RETCODE_OK)
+    goto err_logged;
+
+  /* zero-copy requires driver support, copy mode works everywhere */
+  memset (&sxdp, 0, sizeof (sxdp));
+  sxdp.sxdp_family = AF_XDP;
+  sxdp.sxdp_ifindex = (uint32_t) fact->ifindex;
+  sxdp.sxdp_queue_id = gv->config.xdp_queue;
+  sxdp.sxdp_flags = (fact->xdp_mode == XDP_FLAGS_DRV_MODE) ? XDP_ZEROCOPY : XDP_COPY;
+  what = "bind";
+  if (bind (fact->umem_sock, (struct sockaddr *) &sxdp, sizeof (sxdp)) < 0)
+  {
+    if (sxdp.sxdp_flags != XDP_ZEROCOPY)
+      goto err;
+    sxdp.sxdp_flags = XDP_COPY;
+    if (bind (fact->umem_sock, (struct sockaddr *) &sxdp, sizeof (sxdp)) < 0)
+      goto err;
+  }
+  GVLOG (DDS_LC_CONFIG, "ddsi_xdp: interface %d queue %"PRIu32" %s mode, %s sockets, copying to/from UMEM\n", fact->ifindex, gv->config.xdp_queue,
+         (fact->xdp_mode == XDP_FLAGS_DRV_MODE) ? "native" : "generic", (sxdp.sxdp_flags == XDP_ZEROCOPY) ? "zero-copy" : "copy");
+
+  /* half the frames for receiving, the other half for transmitting */
+  for (uint32_t i = 0; i < XDP_NFRAMES; i++)
+  {
+    const uint64_t addr = (uint64_t) i * XDP_FRAME_SIZE;
+    if (i >= XDP_RING_SIZE || !xdp_fill_put_locked (fact, addr))
+      fact->free_frames[fact->nfree++] = addr;
+  }
+  return DDS_RETCODE_OK;
+
+err:
+  GVERROR ("ddsi_xdp: %s failed: errno %d\n", what, errno);
+err_logged:
+  xdp_umem_fini (fact);
+  return DDS_RETCODE_ERROR;
+}
+
+static char *ddsi_xdp_to_string (char *dst, size_t sizeof_dst, const ddsi_locator_t *loc, int with_port)
+{
+  if (with_port)
+    (void) snprintf(dst, sizeof_dst, "[%02x:%02x:%02x:%02x:%02x:%02x]:%u",
+                    loc->address[10], loc->address[11], loc->address[12],
+                    loc->address[13], loc->address[14], loc->address[15], loc->port);
+  else
+    (void) snprintf(dst, sizeof_dst, "[%02x:%02x:%02x:%02x:%02x:%02x]",
+                    loc->address[10], loc->address[11], loc->address[12],
+                    loc->address[13], loc->address[14], loc->address[15]);
+  return dst;
+}
+
+static ssize_t ddsi_xdp_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc)
+{
+  ddsi_xdp_conn_t uc = (ddsi_xdp_conn_t) conn;
+  ddsi_xdp_factory_t fact = (ddsi_xdp_factory_t) conn->m_factory;
+  const uint32_t cons = ddsrt_atomic_ld32 (uc->m_rx.consumer);
+  struct xdp_desc desc;
+  ssize_t ret = 0;
+  (void) allow_spurious;
+
+  /* the waitset may report the socket as readable without there being a
+     frame in the RX ring, in which case there is nothing to do */
+  if (ddsrt_atomic_ld32 (uc->m_rx.producer) == cons)
+    return 0;
+  ddsrt_atomic_fence_acq ();
+  desc = ((const struct xdp_desc *) uc->m_rx.descs)[cons & (XDP_RING_SIZE - 1)];
+  if (desc.len > XDP_ETH_HDR_SIZE)
+  {
+    const unsigned char *frame = fact->umem_area + desc.addr;
+    size_t sz = desc.len - XDP_ETH_HDR_SIZE;
+    if (sz > len)
+    {
+      char addrbuf[DDSI_LOCSTRLEN];
+      (void) snprintf(addrbuf, sizeof(addrbuf), "[%02x:%02x:%02x:%02x:%02x:%02x]:%u",
+                      frame[6], frame[7], frame[8], frame[9], frame[10], frame[11], (unsigned) ((frame[12] << 8) | frame[13]));
+      DDS_CWARNING(&conn->m_base.gv->logconfig, "%s => %d truncated to %d\n", addrbuf, (int) sz, (int) len);
+      sz = len;
+    }
+    memcpy (buf, frame + XDP_ETH_HDR_SIZE, sz);
+    if (srcloc)
+    {
+      srcloc->tran = conn->m_factory;
+      srcloc->kind = NN_LOCATOR_KIND_RAWETH;
+      srcloc->port = (uint32_t) ((frame[12] << 8) | frame[13]);
+      memset(srcloc->address, 0, 10);
+      memcpy(srcloc->address + 10, frame + 6, 6);
+    }
+    ret = (ssize_t) sz;
+  }
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (uc->m_rx.consumer, cons + 1);
+
+  /* the frame has been consumed by the fill ring, so there is room for it */
+  ddsrt_mutex_lock (&fact->lock);
+  if (!xdp_fill_put_locked (fact, desc.addr & ~((uint64_t) XDP_FRAME_SIZE - 1)))
+  {
+    assert (fact->nfree < XDP_NFRAMES);
+    fact->free_frames[fact->nfree++] = desc.addr & ~((uint64_t) XDP_FRAME_SIZE - 1);
+  }
+  ddsrt_mutex_unlock (&fact->lock);
+  return ret;
+}
+
+static ssize_t ddsi_xdp_conn_write (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  ddsi_xdp_conn_t uc = (ddsi_xdp_conn_t) conn;
+  ddsi_xdp_factory_t fact = (ddsi_xdp_factory_t) conn->m_factory;
+  size_t sz = 0;
+  uint32_t prod;
+  int tries = 0;
+  (void) flags;
+  for (size_t i = 0; i < niov; i++)
+    sz += iov[i].iov_len;
+  if (sz > XDP_FRAME_SIZE - XDP_ETH_HDR_SIZE)
+  {
+    DDS_CERROR(&conn->m_base.gv->logconfig, "ddsi_xdp_conn_write: message of %"PRIuSIZE" bytes exceeds frame size\n", sz);
+    return -1;
+  }
+
+  ddsrt_mutex_lock (&fact->lock);
+  while (true)
+  {
+    xdp_reclaim_locked (fact);
+    prod = ddsrt_atomic_ld32 (uc->m_tx.producer);
+    if (fact->nfree > 0 && prod - ddsrt_atomic_ld32 (uc->m_tx.consumer) < XDP_RING_SIZE)
+      break;
+    ddsrt_mutex_unlock (&fact->lock);
+    /* out of frames: drop the message like a full socket buffer would */
+    if (++tries == XDP_TX_RETRIES)
+      return -1;
+    (void) sendto (uc->m_sock, NULL, 0, MSG_DONTWAIT, NULL, 0);
+    dds_sleepfor (DDS_USECS (10));
+    ddsrt_mutex_lock (&fact->lock);
+  }
+
+  const uint64_t addr = fact->free_frames[--fact->nfree];
+  unsigned char *frame = fact->umem_area + addr;
+  memcpy (frame, dst->address + 10, 6);
+  memcpy (frame + 6, conn->m_base.gv->ownloc.address + 10, 6);
+  frame[12] = (unsigned char) (dst->port >> 8);
+  frame[13] = (unsigned char) dst->port;
+  size_t pos = XDP_ETH_HDR_SIZE;
+  for (size_t i = 0; i < niov; i++)
+  {
+    memcpy (frame + pos, iov[i].iov_base, iov[i].iov_len);
+    pos += iov[i].iov_len;
+  }
+  struct xdp_desc *desc = &((struct xdp_desc *) uc->m_tx.descs)[prod & (XDP_RING_SIZE - 1)];
+  desc->addr = addr;
+  desc->len = (uint32_t) pos;
+  desc->options = 0;
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (uc->m_tx.producer, prod + 1);
+  ddsrt_mutex_unlock (&fact->lock);
+
+  /* transmission only starts once the kernel is notified */
+  if (sendto (uc->m_sock, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 && errno != EAGAIN && errno != EBUSY && errno != ENOBUFS)
+  {
+    DDS_CERROR(&conn->m_base.gv->logconfig, "ddsi_xdp_conn_write failed with errno %d\n", errno);
+    return -1;
+  }
+  return (ssize_t) sz;
+}
+
+static ddsrt_socket_t ddsi_xdp_conn_handle (ddsi_tran_base_t base)
+{
+  return ((ddsi_xdp_conn_t) base)->m_sock;
+}
+
+static bool ddsi_xdp_supports (const struct ddsi_tran_factory *fact, int32_t kind)
+{
+  (void) fact;
+  return (kind == NN_LOCATOR_KIND_RAWETH);
+}
+
+static int ddsi_xdp_conn_locator (ddsi_tran_factory_t fact, ddsi_tran_base_t base, ddsi_locator_t *loc)
+{
+  ddsi_xdp_conn_t uc = (ddsi_xdp_conn_t) base;
+  (void) fact;
+  loc->kind = NN_LOCATOR_KIND_RAWETH;
+  loc->port = uc->m_base.m_base.m_port;
+  memcpy(loc->address, uc->m_base.m_base.gv->extloc.address, sizeof (loc->address));
+  return 0;
+}
+
+static dds_return_t ddsi_xdp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_factory_t fact_, uint32_t port, const struct ddsi_tran_qos *qos)
+{
+  ddsi_xdp_factory_t fact = (ddsi_xdp_factory_t) fact_;
+  const struct ddsi_domaingv *gv = fact->fact.gv;
+  const bool mcast = (qos->m_purpose == DDSI_TRAN_QOS_RECV_MC);
+  struct xdp_mmap_offsets offs;
+  struct sockaddr_xdp sxdp;
+  union bpf_attr attr;
+  ddsi_xdp_conn_t uc;
+  uint32_t slot;
+  int sock;
+
+  if (port == 0 || port > 65535)
+  {
+    GVERROR ("ddsi_xdp_create_conn %s port %u - using port number as ethernet type, %u won't do\n", mcast ? "multicast" : "unicast", port, port);
+    return DDS_RETCODE_ERROR;
+  }
+
+  ddsrt_mutex_lock (&fact->lock);
+  for (slot = 0; slot < XDP_MAX_CONNS; slot++)
+    if (fact->conns[slot] == NULL)
+      break;
+  if (slot == XDP_MAX_CONNS)
+  {
+    GVERROR ("ddsi_xdp_create_conn %s port %u: too many connections\n", mcast ? "multicast" : "unicast", port);
+    goto err_slot;
+  }
+  if (fact->nconns == 0 && xdp_umem_init (fact) != DDS_RETCODE_OK)
+    goto err_slot;
+
+  if ((sock = socket (AF_XDP, SOCK_RAW, 0)) < 0)
+  {
+    GVERROR ("ddsi_xdp_create_conn %s port %u failed ... errno = %d\n", mcast ? "multicast" : "unicast", port, errno);
+    goto err_sock;
+  }
+  uc = ddsrt_malloc (sizeof (*uc));
+  memset (uc, 0, sizeof (*uc));
+  uc->m_sock = sock;
+  uc->m_slot = slot;
+  if (xdp_set_ring_size (sock, XDP_RX_RING) < 0 ||
+      xdp_set_ring_size (sock, XDP_TX_RING) < 0 ||
+      xdp_get_offsets (sock, &offs) < 0 ||
+      xdp_map_ring (&uc->m_rx, sock, &offs.rx, XDP_PGOFF_RX_RING, sizeof (struct xdp_desc)) < 0 ||
+      xdp_map_ring (&uc->m_tx, sock, &offs.tx, XDP_PGOFF_TX_RING, sizeof (struct xdp_desc)) < 0)
+  {
+    GVERROR ("ddsi_xdp_create_conn %s port %u rings failed ... errno = %d\n", mcast ? "multicast" : "unicast", port, errno);
+    goto err_rings;
+  }
+  memset (&sxdp, 0, sizeof (sxdp));
+  sxdp.sxdp_family = AF_XDP;
+  sxdp.sxdp_ifindex = (uint32_t) fact->ifindex;
+  sxdp.sxdp_queue_id = gv->config.xdp_queue;
+  sxdp.sxdp_flags = XDP_SHARED_UMEM;
+  sxdp.sxdp_shared_umem_fd = (uint32_t) fact->umem_sock;
+  if (bind (sock, (struct sockaddr *) &sxdp, sizeof (sxdp)) < 0)
+  {
+    GVERROR ("ddsi_xdp_create_conn %s bind port %u failed ... errno = %d\n", mcast ? "multicast" : "unicast", port, errno);
+    goto err_rings;
+  }
+  memset (&attr, 0, sizeof (attr));
+  attr.map_fd = (uint32_t) fact->xskmap_fd;
+  attr.key = (uintptr_t) &slot;
+  attr.value = (uintptr_t) &sock;
+  attr.flags = BPF_ANY;
+  if (xdp_bpf (BPF_MAP_UPDATE_ELEM, &attr) < 0)
+  {
+    GVERROR ("ddsi_xdp_create_conn %s port %u: XSKMAP update failed ... errno = %d\n", mcast ? "multicast" : "unicast", port, errno);
+    goto err_rings;
+  }
+
+  ddsi_factory_conn_init (&fact->fact, &uc->m_base);
+  uc->m_base.m_base.m_port = port;
+  uc->m_base.m_base.m_trantype = DDSI_TRAN_CONN;
+  uc->m_base.m_base.m_multicast = mcast;
+  uc->m_base.m_base.m_handle_fn = ddsi_xdp_conn_handle;
+  uc->m_base.m_locator_fn = ddsi_xdp_conn_locator;
+  uc->m_base.m_read_fn = ddsi_xdp_conn_read;
+  uc->m_base.m_write_fn = ddsi_xdp_conn_write;
+  uc->m_base.m_disable_multiplexing_fn = 0;
+  fact->conns[slot] = uc;
+  fact->nconns++;
+  if (xdp_attach_prog (fact) != DDS_RETCODE_OK)
+  {
+    fact->conns[slot] = NULL;
+    fact->nconns--;
+    goto err_rings;
+  }
+  ddsrt_mutex_unlock (&fact->lock);
+
+  GVTRACE ("ddsi_xdp_create_conn %s socket %d port %u\n", mcast ? "multicast" : "unicast", uc->m_sock, uc->m_base.m_base.m_port);
+  *conn_out = &uc->m_base;
+  return DDS_RETCODE_OK;
+
+err_rings:
+  xdp_unmap_ring (&uc->m_rx);
+  xdp_unmap_ring (&uc->m_tx);
+  ddsrt_free (uc);
+  close (sock);
+err_sock:
+  if (fact->nconns == 0)
+    xdp_umem_fini (fact);
+err_slot:
+  ddsrt_mutex_unlock (&fact->lock);
+  return DDS_RETCODE_ERROR;
+}
+
+static int isbroadcast(const ddsi_locator_t *loc)
+{
+  int i;
+  for(i = 0; i < 6; i++)
+    if (loc->address[10 + i] != 0xff)
+      return 0;
+  return 1;
+}
+
+/* The XDP program sees all frames accepted by the interface, the packet
+   socket only exists to make it accept the frames for the multicast group */
+static int joinleave_asm_mcgroup (ddsi_xdp_factory_t fact, int join, const ddsi_locator_t *mcloc, const struct nn_interface *interf)
+{
+  int rc;
+  struct packet_mreq mreq;
+  ddsrt_mutex_lock (&fact->lock);
+  if (fact->mc_sock == DDSRT_INVALID_SOCKET && ddsrt_socket (&fact->mc_sock, PF_PACKET, SOCK_DGRAM, 0) != DDS_RETCODE_OK)
+  {
+    fact->mc_sock = DDSRT_INVALID_SOCKET;
+    ddsrt_mutex_unlock (&fact->lock);
+    return DDS_RETCODE_ERROR;
+  }
+  mreq.mr_ifindex = (int)interf->if_index;
+  mreq.mr_type = PACKET_MR_MULTICAST;
+  mreq.mr_alen = 6;
+  memcpy(mreq.mr_address, mcloc->address + 10, 6);
+  rc = ddsrt_setsockopt(fact->mc_sock, SOL_PACKET, join ? PACKET_ADD_MEMBERSHIP : PACKET_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+  ddsrt_mutex_unlock (&fact->lock);
+  return (rc == DDS_RETCODE_OK) ? 0 : rc;
+}
+
+static int ddsi_xdp_join_mc (ddsi_tran_conn_t conn, const ddsi_locator_t *srcloc, const ddsi_locator_t *mcloc, const struct nn_interface *interf)
+{
+  (void)srcloc;
+  if (isbroadcast(mcloc))
+    return 0;
+  else
+    return joinleave_asm_mcgroup((ddsi_xdp_factory_t) conn->m_factory, 1, mcloc, interf);
+}
+
+static int ddsi_xdp_leave_mc (ddsi_tran_conn_t conn, const ddsi_locator_t *srcloc, const ddsi_locator_t *mcloc, const struct nn_interface *interf)
+{
+  (void)srcloc;
+  if (isbroadcast(mcloc))
+    return 0;
+  else
+    return joinleave_asm_mcgroup((ddsi_xdp_factory_t) conn->m_factory, 0, mcloc, interf);
+}
+
+static void ddsi_xdp_release_conn (ddsi_tran_conn_t conn)
+{
+  ddsi_xdp_conn_t uc = (ddsi_xdp_conn_t) conn;
+  ddsi_xdp_factory_t fact = (ddsi_xdp_factory_t) conn->m_factory;
+  DDS_CTRACE (&conn->m_base.gv->logconfig,
+              "ddsi_xdp_release_conn %s socket %d port %d\n",
+              conn->m_base.m_multicast ? "multicast" : "unicast",
+              uc->m_sock,
+              uc->m_base.m_base.m_port);
+  ddsrt_mutex_lock (&fact->lock);
+  fact->conns[uc->m_slot] = NULL;
+  if (--fact->nconns == 0)
+    xdp_umem_fini (fact);
+  else
+  {
+    union bpf_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    attr.map_fd = (uint32_t) fact->xskmap_fd;
+    attr.key = (uintptr_t) &uc->m_slot;
+    (void) xdp_bpf (BPF_MAP_DELETE_ELEM, &attr);
+    (void) xdp_attach_prog (fact);
+  }
+  ddsrt_mutex_unlock (&fact->lock);
+  xdp_unmap_ring (&uc->m_rx);
+  xdp_unmap_ring (&uc->m_tx);
+  ddsrt_close (uc->m_sock);
+  ddsrt_free (conn);
+}
+
+static int ddsi_xdp_is_mcaddr (const struct ddsi_tran_factory *tran, const ddsi_locator_t *loc)
+{
+  (void) tran;
+  assert (loc->kind == NN_LOCATOR_KIND_RAWETH);
+  return (loc->address[10] & 1);
+}
+
+static int ddsi_xdp_is_ssm_mcaddr (const struct ddsi_tran_factory *tran, const ddsi_locator_t *loc)
+{
+  (void) tran;
+  (void) loc;
+  return 0;
+}
+
+static enum ddsi_nearby_address_result ddsi_xdp_is_nearby_address (const ddsi_locator_t *loc, const ddsi_locator_t *ownloc, size_t ninterf, const struct nn_interface interf[])
+{
+  (void) loc;
+  (void) ownloc;
+  (void) ninterf;
+  (void) interf;
+  return DNAR_LOCAL;
+}
+
+static enum ddsi_locator_from_string_result ddsi_xdp_address_from_string (const struct ddsi_tran_factory *tran, ddsi_locator_t *loc, const char *str)
+{
+  int i = 0;
+  loc->tran = tran;
+  loc->kind = NN_LOCATOR_KIND_RAWETH;
+  loc->port = NN_LOCATOR_PORT_INVALID;
+  memset (loc->address, 0, sizeof (loc->address));
+  while (i < 6 && *str != 0)
+  {
+    unsigned o;
+    int p;
+    if (sscanf (str, "%x%n", &o, &p) != 1 || o > 255)
+      return AFSR_INVALID;
+    loc->address[10 + i++] = (unsigned char) o;
+    str += p;
+    if (i < 6)
+    {
+      if (*str != ':')
+        return AFSR_INVALID;
+      str++;
+    }
+  }
+  if (*str)
+    return AFSR_INVALID;
+  return AFSR_OK;
+}
+
+static void ddsi_xdp_deinit(ddsi_tran_factory_t fact_)
+{
+  ddsi_xdp_factory_t fact = (ddsi_xdp_factory_t) fact_;
+  assert (fact->nconns == 0);
+  DDS_CLOG (DDS_LC_CONFIG, &fact->fact.gv->logconfig, "xdp de-initialized\n");
+  if (fact->mc_sock != DDSRT_INVALID_SOCKET)
+    ddsrt_close (fact->mc_sock);
+  ddsrt_mutex_destroy (&fact->lock);
+  ddsrt_free (fact);
+}
+
+static int ddsi_xdp_enumerate_interfaces (ddsi_tran_factory_t fact, ddsrt_ifaddrs_t **ifs)
+{
+  int afs[] = { AF_PACKET, DDSRT_AF_TERM };
+  (void)fact;
+  return ddsrt_getifaddrs(ifs, afs);
+}
+
+static int ddsi_xdp_is_valid_port (const struct ddsi_tran_factory *fact, uint32_t port)
+{
+  (void) fact;
+  return (port >= 1 && port <= 65535);
+}
+
+static uint32_t ddsi_xdp_receive_buffer_size (const struct ddsi_tran_factory *fact)
+{
+  (void) fact;
+  return 0;
+}
+
+int ddsi_xdp_init (struct ddsi_domaingv *gv)
+{
+  struct ddsi_xdp_factory *fact = ddsrt_malloc (sizeof (*fact));
+  memset (fact, 0, sizeof (*fact));
+  ddsrt_mutex_init (&fact->lock);
+  fact->umem_sock = DDSRT_INVALID_SOCKET;
+  fact->mc_sock = DDSRT_INVALID_SOCKET;
+  fact->xskmap_fd = -1;
+  fact->link_fd = -1;
+  fact->fact.gv = gv;
+  fact->fact.m_free_fn = ddsi_xdp_deinit;
+  fact->fact.m_kind = NN_LOCATOR_KIND_RAWETH;
+  fact->fact.m_typename = "xdp";
+  fact->fact.m_default_spdp_address = "xdp/ff:ff:ff:ff:ff:ff";
+  fact->fact.m_connless = 1;
+  fact->fact.m_supports_fn = ddsi_xdp_supports;
+  fact->fact.m_create_conn_fn = ddsi_xdp_create_conn;
+  fact->fact.m_release_conn_fn = ddsi_xdp_release_conn;
+  fact->fact.m_join_mc_fn = ddsi_xdp_join_mc;
+  fact->fact.m_leave_mc_fn = ddsi_xdp_leave_mc;
+  fact->fact.m_is_mcaddr_fn = ddsi_xdp_is_mcaddr;
+  fact->fact.m_is_ssm_mcaddr_fn = ddsi_xdp_is_ssm_mcaddr;
+  fact->fact.m_is_nearby_address_fn = ddsi_xdp_is_nearby_address;
+  fact->fact.m_locator_from_string_fn = ddsi_xdp_address_from_string;
+  fact->fact.m_locator_to_string_fn = ddsi_xdp_to_string;
+  fact->fact.m_enumerate_interfaces_fn = ddsi_xdp_enumerate_interfaces;
+  fact->fact.m_is_valid_port_fn = ddsi_xdp_is_valid_port;
+  fact->fact.m_receive_buffer_size_fn = ddsi_xdp_receive_buffer_size;
+  ddsi_factory_add (gv, &fact->fact);
+  GVLOG (DDS_LC_CONFIG, "xdp initialized\n");
+  return 0;
+}
+
+#else
+
+int ddsi_xdp_init (struct ddsi_domaingv *gv)
+{
+  GVERROR ("xdp transport not supported on this platform\n");
+  return -1;
+}
+
+#endif /* DDSRT_HAVE_AF_XDP */
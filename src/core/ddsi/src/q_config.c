@@ -173,6 +173,8 @@ DU(duration_100ms_1hr);
 PF(duration);
 DUPF(standards_conformance);
 DUPF(besmode);
+DUPF(whc_budget_policy);
+DUPF(durable_sync);
 DUPF(retransmit_merging);
 DUPF(sched_class);
 DUPF(maybe_memsize);
@@ -915,6 +917,14 @@ static const char *en_besmode_vs[] = { "full", "writers", "minimal", NULL };
 static const enum ddsi_besmode en_besmode_ms[] = { DDSI_BESMODE_FULL, DDSI_BESMODE_WRITERS, DDSI_BESMODE_MINIMAL, 0 };
 GENERIC_ENUM_CTYPE (besmode, enum ddsi_besmode)
 
+static const char *en_whc_budget_policy_vs[] = { "block", "shed", NULL };
+static const enum ddsi_whc_budget_policy en_whc_budget_policy_ms[] = { DDSI_WHC_BUDGET_BLOCK, DDSI_WHC_BUDGET_SHED, 0 };
+GENERIC_ENUM_CTYPE (whc_budget_policy, enum ddsi_whc_budget_policy)
+
+static const char *en_durable_sync_vs[] = { "none", "segment", "write", NULL };
+static const enum ddsi_durable_sync en_durable_sync_ms[] = { DDSI_DURABLE_SYNC_NONE, DDSI_DURABLE_SYNC_SEGMENT, DDSI_DURABLE_SYNC_WRITE, 0 };
+GENERIC_ENUM_CTYPE (durable_sync, enum ddsi_durable_sync)
+
 static const char *en_retransmit_merging_vs[] = { "never", "adaptive", "always", NULL };
 static const enum ddsi_retransmit_merging en_retransmit_merging_ms[] = { DDSI_REXMIT_MERGE_NEVER, DDSI_REXMIT_MERGE_ADAPTIVE, DDSI_REXMIT_MERGE_ALWAYS, 0 };
 GENERIC_ENUM_CTYPE (retransmit_merging, enum ddsi_retransmit_merging)
@@ -923,8 +933,8 @@ static const char *en_sched_class_vs[] = { "realtime", "timeshare", "default", N
 static const ddsrt_sched_t en_sched_class_ms[] = { DDSRT_SCHED_REALTIME, DDSRT_SCHED_TIMESHARE, DDSRT_SCHED_DEFAULT, 0 };
 GENERIC_ENUM_CTYPE (sched_class, ddsrt_sched_t)
 
-static const char *en_transport_selector_vs[] = { "default", "udp", "udp6", "tcp", "tcp6", "raweth", NULL };
-static const enum ddsi_transport_selector en_transport_selector_ms[] = { DDSI_TRANS_DEFAULT, DDSI_TRANS_UDP, DDSI_TRANS_UDP6, DDSI_TRANS_TCP, DDSI_TRANS_TCP6, DDSI_TRANS_RAWETH, 0 };
+static const char *en_transport_selector_vs[] = { "default", "udp", "udp6", "tcp", "tcp6", "raweth", "xdp", NULL };
+static const enum ddsi_transport_selector en_transport_selector_ms[] = { DDSI_TRANS_DEFAULT, DDSI_TRANS_UDP, DDSI_TRANS_UDP6, DDSI_TRANS_TCP, DDSI_TRANS_TCP6, DDSI_TRANS_RAWETH, DDSI_TRANS_XDP, 0 };
 GENERIC_ENUM_CTYPE (transport_selector, enum ddsi_transport_selector)
 
 /* by putting the  "true" and "false" aliases at the end, they won't come out of the
@@ -2270,6 +2280,7 @@ struct cfgst *config_init (const char *config, struct ddsi_config *cfg, uint32_t
         ok1 = !(cfgst->cfg->compat_tcp_enable == DDSI_BOOLDEF_TRUE || cfgst->cfg->compat_use_ipv6 == DDSI_BOOLDEF_FALSE);
         break;
       case DDSI_TRANS_RAWETH:
+      case DDSI_TRANS_XDP:
         ok1 = !(cfgst->cfg->compat_tcp_enable == DDSI_BOOLDEF_TRUE || cfgst->cfg->compat_use_ipv6 == DDSI_BOOLDEF_TRUE);
         break;
     }
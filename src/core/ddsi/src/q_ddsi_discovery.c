@@ -960,6 +960,41 @@ static int sedp_write_endpoint
     }
 #endif
 
+    if (gv->shm)
+    {
+      /* Only endpoints that can actually use shared memory advertise the host */
+      bool shm;
+      if (is_writer_entityid (epguid->entityid))
+      {
+        const struct writer *wr = entidx_lookup_writer_guid (gv->entity_index, epguid);
+        shm = (wr != NULL && wr->shm != NULL);
+      }
+      else
+      {
+        const struct reader *rd = entidx_lookup_reader_guid (gv->entity_index, epguid);
+        shm = (rd != NULL && rd->shm_capable);
+      }
+      if (shm)
+      {
+        ps.present |= PP_CYCLONE_SHM_HOSTID;
+        ps.cyclone_shm_hostid = gv->shm_hostid;
+      }
+    }
+
+    /* Advertising the content filter allows remote writers to filter at the source */
+    if (!is_writer_entityid (epguid->entityid))
+    {
+      const struct reader *rd = entidx_lookup_reader_guid (gv->entity_index, epguid);
+      if (rd != NULL && rd->content_filter != NULL)
+      {
+        ddsi_plist_t cfps;
+        ddsi_plist_init_empty (&cfps);
+        cfps.present = cfps.aliased = PP_CONTENT_FILTER_PROPERTY;
+        cfps.content_filter_property = *rd->content_filter;
+        ddsi_plist_mergein_missing (&ps, &cfps, PP_CONTENT_FILTER_PROPERTY, 0);
+      }
+    }
+
     qosdiff = ddsi_xqos_delta (xqos, defqos, ~(uint64_t)0);
     if (gv->config.explicitly_publish_qos_set_to_default)
       qosdiff |= ~QP_UNRECOGNIZED_INCOMPATIBLE_MASK;
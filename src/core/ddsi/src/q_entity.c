@@ -40,6 +40,7 @@
 #include "dds/ddsi/q_protocol.h" /* NN_ENTITYID_... */
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_cdrfilter.h"
 #include "dds/ddsi/ddsi_mcgroup.h"
 #include "dds/ddsi/q_receive.h"
 #include "dds/ddsi/ddsi_udp.h" /* nn_mc4gen_address_t */
@@ -51,6 +52,7 @@
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsi/ddsi_security_omg.h"
 #include "dds/ddsi/ddsi_typelookup.h"
+#include "dds/ddsi/ddsi_shm.h"
 
 #ifdef DDS_HAS_SECURITY
 #include "dds/ddsi/ddsi_security_msg.h"
@@ -107,7 +109,7 @@ static const unsigned builtin_writers_besmask =
 ;
 
 static dds_return_t new_writer_guid (struct writer **wr_out, const struct ddsi_guid *guid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct whc *whc, status_cb_t status_cb, void *status_cbarg);
-static dds_return_t new_reader_guid (struct reader **rd_out, const struct ddsi_guid *guid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc *rhc, status_cb_t status_cb, void *status_cbarg);
+static dds_return_t new_reader_guid (struct reader **rd_out, const struct ddsi_guid *guid, const struct ddsi_guid *group_guid, struct participant *pp, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct ddsi_rhc *rhc, status_cb_t status_cb, void *status_cbarg, const nn_content_filter_property_t *content_filter);
 static struct participant *ref_participant (struct participant *pp, const struct ddsi_guid *guid_of_refing_entity);
 static void unref_participant (struct participant *pp, const struct ddsi_guid *guid_of_refing_entity);
 static struct entity_common *entity_common_from_proxy_endpoint_common (const struct proxy_endpoint_common *c);
@@ -608,11 +610,11 @@ static void add_security_builtin_endpoints(struct participant *pp, ddsi_guid_t *
   if (add_readers)
   {
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_SECURE_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_SECURE_NAME, gv->sedp_reader_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_SECURE_NAME, gv->sedp_reader_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_SUBSCRIPTION_MESSAGE_SECURE_DETECTOR;
 
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_PUBLICATIONS_SECURE_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_SECURE_NAME, gv->sedp_writer_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_SECURE_NAME, gv->sedp_writer_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_PUBLICATION_MESSAGE_SECURE_DETECTOR;
   }
 
@@ -621,19 +623,19 @@ static void add_security_builtin_endpoints(struct participant *pp, ddsi_guid_t *
    * besmode flag setting, because all participant do require authentication.
    */
   subguid->entityid = to_entityid (NN_ENTITYID_SPDP_RELIABLE_BUILTIN_PARTICIPANT_SECURE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_SECURE_NAME, gv->spdp_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_SECURE_NAME, gv->spdp_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_SECURE_DETECTOR;
 
   subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_VOLATILE_SECURE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_VOLATILE_MESSAGE_SECURE_NAME, gv->pgm_volatile_type, &gv->builtin_secure_volatile_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_VOLATILE_MESSAGE_SECURE_NAME, gv->pgm_volatile_type, &gv->builtin_secure_volatile_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_VOLATILE_SECURE_DETECTOR;
 
   subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_STATELESS_MESSAGE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_STATELESS_MESSAGE_NAME, gv->pgm_stateless_type, &gv->builtin_stateless_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_STATELESS_MESSAGE_NAME, gv->pgm_stateless_type, &gv->builtin_stateless_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_STATELESS_MESSAGE_DETECTOR;
 
   subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_MESSAGE_SECURE_READER);
-  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_SECURE_NAME, gv->pmd_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+  new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_SECURE_NAME, gv->pmd_secure_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
   pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_MESSAGE_SECURE_DETECTOR;
 }
 #endif
@@ -678,31 +680,31 @@ static void add_builtin_endpoints(struct participant *pp, ddsi_guid_t *subguid,
   {
     /* SPDP reader: */
     subguid->entityid = to_entityid (NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_NAME, gv->spdp_type, &gv->spdp_endpoint_xqos, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_NAME, gv->spdp_type, &gv->spdp_endpoint_xqos, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PARTICIPANT_DETECTOR;
 
     /* SEDP readers: */
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_NAME, gv->sedp_reader_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_SUBSCRIPTION_NAME, gv->sedp_reader_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_SUBSCRIPTION_DETECTOR;
 
     subguid->entityid = to_entityid (NN_ENTITYID_SEDP_BUILTIN_PUBLICATIONS_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_NAME, gv->sedp_writer_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PUBLICATION_NAME, gv->sedp_writer_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_DISC_BUILTIN_ENDPOINT_PUBLICATION_DETECTOR;
 
     /* PMD reader: */
     subguid->entityid = to_entityid (NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_MESSAGE_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_NAME, gv->pmd_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_PARTICIPANT_MESSAGE_NAME, gv->pmd_type, &gv->builtin_endpoint_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_PARTICIPANT_MESSAGE_DATA_READER;
 
 #ifdef DDS_HAS_TYPE_DISCOVERY
     /* TypeLookup readers: */
     subguid->entityid = to_entityid (NN_ENTITYID_TL_SVC_BUILTIN_REQUEST_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REQUEST_NAME, gv->tl_svc_request_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REQUEST_NAME, gv->tl_svc_request_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_TL_SVC_REQUEST_DATA_READER;
 
     subguid->entityid = to_entityid (NN_ENTITYID_TL_SVC_BUILTIN_REPLY_READER);
-    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REPLY_NAME, gv->tl_svc_reply_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL);
+    new_reader_guid (NULL, subguid, group_guid, pp, DDS_BUILTIN_TOPIC_TYPELOOKUP_REPLY_NAME, gv->tl_svc_reply_type, &gv->builtin_volatile_xqos_rd, NULL, NULL, NULL, NULL);
     pp->bes |= NN_BUILTIN_ENDPOINT_TL_SVC_REPLY_DATA_READER;
 #endif
   }
@@ -1522,7 +1524,7 @@ static struct addrset *rebuild_make_all_addrs (int *nreaders, struct writer *wr,
   for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
   {
     struct proxy_reader *prd;
-    if ((prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) == NULL)
+    if (m->via_shm || (prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) == NULL)
       continue;
     (*nreaders)++;
     if (prd->receive_buffer_size < *min_receive_buffer_size)
@@ -1589,7 +1591,7 @@ static void rebuild_make_covered(int8_t **covered, const struct writer *wr, int
   {
     struct proxy_reader *prd;
     struct addrset *ass[] = { NULL, NULL, NULL };
-    if ((prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) == NULL)
+    if (m->via_shm || (prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) == NULL)
       continue;
     ass[0] = prd->c.as;
 #ifdef DDS_HAS_SSM
@@ -1850,10 +1852,38 @@ void rebuild_or_clear_writer_addrsets (struct ddsi_domaingv *gv, int rebuild)
   GVLOGDISC ("rebuild_or_delete_writer_addrsets(%d) done\n", rebuild);
 }
 
+static nn_content_filter_property_t *content_filter_property_dup (const nn_content_filter_property_t *src)
+{
+  nn_content_filter_property_t *dst = ddsrt_malloc (sizeof (*dst));
+  dst->content_filtered_topic_name = ddsrt_strdup (src->content_filtered_topic_name);
+  dst->related_topic_name = ddsrt_strdup (src->related_topic_name);
+  dst->filter_class_name = ddsrt_strdup (src->filter_class_name);
+  dst->filter_expression = ddsrt_strdup (src->filter_expression);
+  dst->expression_parameters.n = src->expression_parameters.n;
+  dst->expression_parameters.strs = src->expression_parameters.n ? ddsrt_malloc (src->expression_parameters.n * sizeof (*dst->expression_parameters.strs)) : NULL;
+  for (uint32_t i = 0; i < src->expression_parameters.n; i++)
+    dst->expression_parameters.strs[i] = ddsrt_strdup (src->expression_parameters.strs[i]);
+  return dst;
+}
+
+static void content_filter_property_free (nn_content_filter_property_t *cfp)
+{
+  ddsrt_free (cfp->content_filtered_topic_name);
+  ddsrt_free (cfp->related_topic_name);
+  ddsrt_free (cfp->filter_class_name);
+  ddsrt_free (cfp->filter_expression);
+  for (uint32_t i = 0; i < cfp->expression_parameters.n; i++)
+    ddsrt_free (cfp->expression_parameters.strs[i]);
+  ddsrt_free (cfp->expression_parameters.strs);
+  ddsrt_free (cfp);
+}
+
 static void free_wr_prd_match (const struct ddsi_domaingv *gv, const ddsi_guid_t *wr_guid, struct wr_prd_match *m)
 {
   if (m)
   {
+    if (m->filter)
+      ddsi_cdrfilter_free (m->filter);
 #ifdef DDS_HAS_SECURITY
     q_omg_security_deregister_remote_reader_match (gv, wr_guid, m);
 #else
@@ -1958,6 +1988,7 @@ static void writer_drop_connection (const struct ddsi_guid *wr_guid, const struc
       remove_acked_messages (wr, &whcst, &deferred_free_list);
       wr->num_readers--;
       wr->num_reliable_readers -= m->is_reliable;
+      wr->num_filtered_readers -= (m->filter != NULL);
     }
 
     ddsrt_mutex_unlock (&wr->e.lock);
@@ -2218,14 +2249,14 @@ static void proxy_writer_drop_connection (const struct ddsi_guid *pwr_guid, stru
         if (--pwr->n_readers_out_of_sync == 0)
           local_reader_ary_setfastpath_ok (&pwr->rdary, true);
       }
-      if (rd->reliable)
+      if (rd->reliable && !m->via_shm)
         pwr->n_reliable_readers--;
       /* If no reliable readers left, there is no reason to believe the heartbeats will keep
          coming and therefore reset have_seen_heartbeat so the next reader to be created
          doesn't get initialised based on stale data */
       if (pwr->n_reliable_readers == 0)
         pwr->have_seen_heartbeat = 0;
-      local_reader_ary_remove (&pwr->rdary, rd);
+      local_reader_ary_remove (m->via_shm ? &pwr->shm_rdary : &pwr->rdary, rd);
     }
     ddsrt_mutex_unlock (&pwr->e.lock);
     if (m)
@@ -2255,18 +2286,45 @@ static void proxy_reader_drop_connection (const struct ddsi_guid *prd_guid, stru
   }
 }
 
+static void writer_compile_reader_filter (struct writer *wr, const struct proxy_reader *prd, struct wr_prd_match *m)
+{
+  /* A remote reader's content filter can only be evaluated on the writer if the data
+     is in the default representation, any failure simply means all data gets sent to
+     it and it is left to the reader to do the filtering */
+  const nn_content_filter_property_t *cfp = prd->content_filter;
+  dds_return_t rc;
+  if (wr->type->ops != &ddsi_sertype_ops_default)
+    rc = DDS_RETCODE_UNSUPPORTED;
+  else
+    rc = ddsi_cdrfilter_compile (&m->filter, (const struct ddsi_sertype_default *) wr->type, cfp->filter_expression,
+                                 cfp->expression_parameters.n, (const char * const *) cfp->expression_parameters.strs);
+  if (rc != DDS_RETCODE_OK)
+  {
+    ELOGDISC (wr, "  writer_add_connection(wr "PGUIDFMT" prd "PGUIDFMT") - content filter \"%s\" not applied: %s\n",
+              PGUID (wr->e.guid), PGUID (prd->e.guid), cfp->filter_expression, dds_strretcode (rc));
+    m->filter = NULL;
+  }
+}
+
 static void writer_add_connection (struct writer *wr, struct proxy_reader *prd, int64_t crypto_handle)
 {
   struct wr_prd_match *m = ddsrt_malloc (sizeof (*m));
   ddsrt_avl_ipath_t path;
   int pretend_everything_acked;
   m->prd_guid = prd->e.guid;
-  m->is_reliable = (prd->c.xqos->reliability.kind > DDS_RELIABILITY_BEST_EFFORT);
+  /* readers on the same host get the data via shared memory, where it is
+     best-effort regardless of QoS and doesn't involve the network */
+  m->via_shm = (wr->shm != NULL && prd->c.shm_same_host);
+  m->is_reliable = (prd->c.xqos->reliability.kind > DDS_RELIABILITY_BEST_EFFORT) && !m->via_shm;
   m->assumed_in_sync = (wr->e.gv->config.retransmit_merging == DDSI_REXMIT_MERGE_ALWAYS);
   m->has_replied_to_hb = !m->is_reliable;
   m->all_have_replied_to_hb = 0;
   m->non_responsive_count = 0;
   m->rexmit_requests = 0;
+  m->filter = NULL;
+  m->filter_gapstart = 0;
+  if (prd->content_filter && !m->via_shm)
+    writer_compile_reader_filter (wr, prd, m);
 #ifdef DDS_HAS_SECURITY
   m->crypto_handle = crypto_handle;
 #else
@@ -2309,6 +2367,8 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd,
     ELOGDISC (wr, "  writer_add_connection(wr "PGUIDFMT" prd "PGUIDFMT") - already connected\n",
               PGUID (wr->e.guid), PGUID (prd->e.guid));
     ddsrt_mutex_unlock (&wr->e.lock);
+    if (m->filter)
+      ddsi_cdrfilter_free (m->filter);
     nn_lat_estim_fini (&m->hb_to_ack_latency);
     ddsrt_free (m);
   }
@@ -2320,6 +2380,7 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd,
     rebuild_writer_addrset (wr);
     wr->num_readers++;
     wr->num_reliable_readers += m->is_reliable;
+    wr->num_filtered_readers += (m->filter != NULL);
     ddsrt_mutex_unlock (&wr->e.lock);
 
     if (wr->status_cb)
@@ -2601,10 +2662,26 @@ static void proxy_writer_add_connection (struct proxy_writer *pwr, struct reader
   DDSRT_UNUSED_ARG(crypto_handle);
 #endif
 
+  /* A writer on the same host that can use shared memory no longer sends
+     the data over the network to this reader */
+  m->via_shm = 0;
+  if (rd->shm_capable && pwr->c.shm_same_host)
+  {
+    if (pwr->shm == NULL)
+      pwr->shm = ddsi_shm_attach (pwr->e.gv, &pwr->e.guid, rd->type);
+    m->via_shm = (pwr->shm != NULL);
+  }
+
   /* These can change as a consequence of handling data and/or
      discovery activities. The safe way of dealing with them is to
      lock the proxy writer */
-  if (is_builtin_entityid (rd->e.guid.entityid, NN_VENDORID_ECLIPSE) && !ddsrt_avl_is_empty (&pwr->readers) && !pwr->filtered)
+  if (m->via_shm)
+  {
+    /* volatile, best-effort and never fed from the network */
+    ELOGDISC (pwr, " - via shm");
+    m->in_sync = PRMSS_SYNC;
+  }
+  else if (is_builtin_entityid (rd->e.guid.entityid, NN_VENDORID_ECLIPSE) && !ddsrt_avl_is_empty (&pwr->readers) && !pwr->filtered)
   {
     /* builtins really don't care about multiple copies or anything */
     m->in_sync = PRMSS_SYNC;
@@ -2657,7 +2734,7 @@ static void proxy_writer_add_connection (struct proxy_writer *pwr, struct reader
      sending pre-emptive ones until the proxy writer receives a heartbeat.
      (We really only need a pre-emptive AckNack per proxy writer, but
      hopefully it won't make that much of a difference in practice.) */
-  if (rd->reliable)
+  if (rd->reliable && !m->via_shm)
   {
     uint32_t secondary_reorder_maxsamples = pwr->e.gv->config.secondary_reorder_maxsamples;
 
@@ -2679,7 +2756,7 @@ static void proxy_writer_add_connection (struct proxy_writer *pwr, struct reader
   }
 
   ddsrt_avl_insert_ipath (&pwr_readers_treedef, &pwr->readers, m, &path);
-  local_reader_ary_insert(&pwr->rdary, rd);
+  local_reader_ary_insert(m->via_shm ? &pwr->shm_rdary : &pwr->rdary, rd);
   ddsrt_mutex_unlock (&pwr->e.lock);
   qxev_pwr_entityid (pwr, &rd->e.guid);
 
@@ -3600,6 +3677,16 @@ static void augment_wr_prd_match (void *vnode, const void *vleft, const void *vr
   }
 }
 
+bool durability_handled_as_transient_local (const struct ddsi_domaingv *gv, dds_durability_kind_t kind)
+{
+  /* TRANSIENT and PERSISTENT writers keep their history in the durable store if one is
+     configured, and otherwise there is no support for them beyond what VOLATILE offers */
+  if (kind == DDS_DURABILITY_TRANSIENT_LOCAL)
+    return true;
+  else
+    return kind > DDS_DURABILITY_TRANSIENT_LOCAL && gv->config.durable_store_dir != NULL && gv->config.durable_store_dir[0] != '\0';
+}
+
 seqno_t writer_max_drop_seq (const struct writer *wr)
 {
   const struct wr_prd_match *n;
@@ -3659,12 +3746,44 @@ void writer_clear_retransmitting (struct writer *wr)
   ddsrt_cond_broadcast (&wr->throttle_cond);
 }
 
+void writer_update_whc_budget (struct writer *wr, const struct whc_state *whcst)
+{
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (!wr->in_whc_budget || whcst->unacked_bytes == wr->whc_budget_bytes)
+    return;
+  if (whcst->unacked_bytes > wr->whc_budget_bytes)
+    ddsrt_atomic_add64 (&wr->e.gv->whc_budget_used, whcst->unacked_bytes - wr->whc_budget_bytes);
+  else
+    ddsrt_atomic_sub64 (&wr->e.gv->whc_budget_used, wr->whc_budget_bytes - whcst->unacked_bytes);
+  wr->whc_budget_bytes = whcst->unacked_bytes;
+}
+
+bool writer_over_whc_budget (const struct writer *wr, const struct whc_state *whcst)
+{
+  /* Once the domain-wide budget is exhausted, a writer may only continue if it
+     uses less than its share, so that a single writer with a stalled reader can't
+     stop all other writers. The share is never less than the low-water mark as
+     otherwise a throttled writer could never be unblocked by its own readers. */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  uint32_t nwriters;
+  size_t share;
+  if (!wr->in_whc_budget || ddsrt_atomic_ld64 (&gv->whc_budget_used) < gv->config.whc_budget)
+    return false;
+  nwriters = ddsrt_atomic_ld32 (&gv->whc_budget_nwriters);
+  share = gv->config.whc_budget / (nwriters > 0 ? nwriters : 1);
+  if (share < gv->config.whc_lowwater_mark)
+    share = gv->config.whc_lowwater_mark;
+  return whcst->unacked_bytes > share;
+}
+
 unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, struct whc_node **deferred_free_list)
 {
   unsigned n;
   assert (wr->e.guid.entityid.u != NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER);
   ASSERT_MUTEX_HELD (&wr->e.lock);
-  n = whc_remove_acked_messages (wr->whc, writer_max_drop_seq (wr), whcst, deferred_free_list);
+  wr->whc_drop_seq = writer_max_drop_seq (wr);
+  n = whc_remove_acked_messages (wr->whc, wr->whc_drop_seq, whcst, deferred_free_list);
+  writer_update_whc_budget (wr, whcst);
   /* trigger anyone waiting in throttle_writer() or wait_for_acks() */
   ddsrt_cond_broadcast (&wr->throttle_cond);
   if (wr->retransmitting && whcst->unacked_bytes == 0)
@@ -3677,6 +3796,38 @@ unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, stru
   return n;
 }
 
+unsigned remove_pending_acked_messages (struct writer *wr, struct whc_state *whcst, struct whc_node **deferred_free_list)
+{
+  /* Drops the samples that have been acknowledged by all readers but that are still
+     in the WHC because handle_AckNack postponed removing them (the SPDP writer never
+     receives acks) */
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (wr->e.guid.entityid.u != NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER && wr->whc_drop_seq < writer_max_drop_seq (wr))
+    return remove_acked_messages (wr, whcst, deferred_free_list);
+  whc_get_state (wr->whc, whcst);
+  *deferred_free_list = NULL;
+  return 0;
+}
+
+bool writer_may_defer_remove_acked_messages (const struct writer *wr)
+{
+  /* Removing acknowledged samples from the WHC costs a more-or-less fixed amount per
+     call on top of the per-sample cost, and with many readers acking at slightly
+     different times the minimum acknowledged sequence number tends to advance a few
+     samples at a time.  Postponing it until a batch of samples can be dropped (or
+     until the next write or heartbeat event) amortises that, provided no-one is
+     waiting for the WHC to shrink and the writer is not done. */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  const seqno_t max_drop_seq = writer_max_drop_seq (wr);
+  if (gv->config.ack_batch_maxsamples <= 1)
+    return false;
+  if (wr->state != WRST_OPERATIONAL || wr->throttling || wr->retransmitting || max_drop_seq >= wr->seq)
+    return false;
+  if (wr->in_whc_budget && ddsrt_atomic_ld64 (&gv->whc_budget_used) >= gv->config.whc_budget)
+    return false;
+  return max_drop_seq - wr->whc_drop_seq < (seqno_t) gv->config.ack_batch_maxsamples;
+}
+
 static void writer_notify_liveliness_change_may_unlock (struct writer *wr)
 {
   struct alive_state alive_state;
@@ -3767,6 +3918,7 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   ddsrt_cond_init (&wr->throttle_cond);
   wr->seq = 0;
   wr->cs_seq = 0;
+  wr->whc_drop_seq = 0;
   ddsrt_atomic_st64 (&wr->seq_xmit, (uint64_t) 0);
   wr->hbcount = 1;
   wr->state = WRST_OPERATIONAL;
@@ -3779,6 +3931,7 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   wr->t_whc_high_upd.v = 0;
   wr->num_readers = 0;
   wr->num_reliable_readers = 0;
+  wr->num_filtered_readers = 0;
   wr->num_acks_received = 0;
   wr->num_nacks_received = 0;
   wr->throttle_count = 0;
@@ -3833,11 +3986,15 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
     assert ((wr->xqos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL) ||
             (wr->e.guid.entityid.u == NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_STATELESS_MESSAGE_WRITER));
   }
-  wr->handle_as_transient_local = (wr->xqos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL);
+  wr->handle_as_transient_local = durability_handled_as_transient_local (wr->e.gv, wr->xqos->durability.kind);
   wr->include_keyhash =
     wr->e.gv->config.generate_keyhash &&
     ((wr->e.guid.entityid.u & NN_ENTITYID_KIND_MASK) == NN_ENTITYID_KIND_WRITER_WITH_KEY);
   wr->type = ddsi_sertype_ref (type);
+  if (wr->e.gv->shm && !is_builtin_entityid (wr->e.guid.entityid, NN_VENDORID_ECLIPSE) && ddsi_shm_type_eligible (type))
+    wr->shm = ddsi_shm_writer_new (wr->e.gv, &wr->e.guid, type);
+  else
+    wr->shm = NULL;
   wr->as = new_addrset ();
   wr->as_group = NULL;
 
@@ -3924,6 +4081,18 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   }
 
   wr->whc = whc;
+  {
+    /* A WHC backed by a durable store can start out with the history written by a
+       previous writer, numbered from 1 onwards, in which case the sequence numbers
+       continue from there */
+    struct whc_state whcst;
+    whc_get_state (wr->whc, &whcst);
+    if (!WHCST_ISEMPTY (&whcst))
+    {
+      wr->seq = whcst.max_seq;
+      ddsrt_atomic_st64 (&wr->seq_xmit, (uint64_t) whcst.max_seq);
+    }
+  }
   if (wr->xqos->history.kind == DDS_HISTORY_KEEP_LAST)
   {
     /* hdepth > 0 => "aggressive keep last", and in that case: why
@@ -3937,6 +4106,10 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
     wr->whc_low = wr->e.gv->config.whc_lowwater_mark;
     wr->whc_high = wr->e.gv->config.whc_init_highwater_mark.value;
   }
+  wr->whc_budget_bytes = 0;
+  wr->in_whc_budget = (wr->e.gv->config.whc_budget > 0 && wr->whc_low != INT32_MAX);
+  if (wr->in_whc_budget)
+    ddsrt_atomic_inc32 (&wr->e.gv->whc_budget_nwriters);
   assert (!(is_builtin_entityid(wr->e.guid.entityid, NN_VENDORID_ECLIPSE) && !is_builtin_volatile_endpoint(wr->e.guid.entityid)) ||
            (wr->whc_low == wr->whc_high && wr->whc_low == INT32_MAX));
 
@@ -4133,6 +4306,11 @@ static void gc_delete_writer (struct gcreq *gcreq)
   /* Do last gasp on SEDP and free writer. */
   if (!is_builtin_entityid (wr->e.guid.entityid, NN_VENDORID_ECLIPSE))
     sedp_dispose_unregister_writer (wr);
+  if (wr->in_whc_budget)
+  {
+    ddsrt_atomic_sub64 (&wr->e.gv->whc_budget_used, wr->whc_budget_bytes);
+    ddsrt_atomic_dec32 (&wr->e.gv->whc_budget_nwriters);
+  }
   whc_free (wr->whc);
   if (wr->status_cb)
     (wr->status_cb) (wr->status_cb_entity, NULL);
@@ -4149,6 +4327,8 @@ static void gc_delete_writer (struct gcreq *gcreq)
   ddsrt_free (wr->xqos);
   local_reader_ary_fini (&wr->rdary);
   ddsrt_cond_destroy (&wr->throttle_cond);
+  if (wr->shm)
+    ddsi_shm_writer_free (wr->shm);
 
   ddsi_sertype_unref ((struct ddsi_sertype *) wr->type);
   endpoint_common_fini (&wr->e, &wr->c);
@@ -4320,8 +4500,19 @@ dds_return_t delete_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *gu
   /* If no unack'ed data, don't waste time or resources (expected to
      be the usual case), do it immediately.  If more data is still
      coming in (which can't really happen at the moment, but might
-     again in the future) it'll potentially be discarded.  */
-  whc_get_state(wr->whc, &whcst);
+     again in the future) it'll potentially be discarded.  Acks of
+     which the processing was postponed must be taken into account
+     first, or the writer would linger for no reason.  */
+  if (wr->reliable)
+  {
+    struct whc_node *deferred_free_list;
+    (void) remove_pending_acked_messages (wr, &whcst, &deferred_free_list);
+    whc_free_deferred_free_list (wr->whc, deferred_free_list);
+  }
+  else
+  {
+    whc_get_state(wr->whc, &whcst);
+  }
   if (whcst.unacked_bytes == 0)
   {
     GVLOGDISC ("delete_writer(guid "PGUIDFMT") - no unack'ed samples\n", PGUID (*guid));
@@ -4461,7 +4652,8 @@ static dds_return_t new_reader_guid
   const struct dds_qos *xqos,
   struct ddsi_rhc *rhc,
   status_cb_t status_cb,
-  void * status_entity
+  void * status_entity,
+  const nn_content_filter_property_t *content_filter
 )
 {
   /* see new_writer_guid for commenets */
@@ -4487,6 +4679,7 @@ static dds_return_t new_reader_guid
   ddsi_xqos_mergein_missing (rd->xqos, &pp->e.gv->default_xqos_rd, ~(uint64_t)0);
   assert (rd->xqos->aliased == 0);
   set_topic_type_name (rd->xqos, topic_name, type->type_name);
+  rd->content_filter = content_filter ? content_filter_property_dup (content_filter) : NULL;
 
   if (rd->e.gv->logconfig.c.mask & DDS_LC_DISCOVERY)
   {
@@ -4504,9 +4697,11 @@ static dds_return_t new_reader_guid
    * used for this reader and reader specific out-of-order list must be used which is
    * used for handling transient local data.
    */
-  rd->handle_as_transient_local = (rd->xqos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL) ||
+  rd->handle_as_transient_local = durability_handled_as_transient_local (rd->e.gv, rd->xqos->durability.kind) ||
                                   (rd->e.guid.entityid.u == NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_VOLATILE_SECURE_READER);
   rd->type = ddsi_sertype_ref (type);
+  rd->shm_capable = (pp->e.gv->shm != NULL && !is_builtin_entityid (rd->e.guid.entityid, NN_VENDORID_ECLIPSE) &&
+                     rd->xqos->durability.kind == DDS_DURABILITY_VOLATILE && ddsi_shm_type_eligible (type));
   rd->ddsi2direct_cb = 0;
   rd->ddsi2direct_cbarg = 0;
   rd->init_acknack_count = 1;
@@ -4610,7 +4805,8 @@ dds_return_t new_reader
   const struct dds_qos *xqos,
   struct ddsi_rhc * rhc,
   status_cb_t status_cb,
-  void * status_cbarg
+  void * status_cbarg,
+  const nn_content_filter_property_t *content_filter
 )
 {
   dds_return_t rc;
@@ -4620,7 +4816,7 @@ dds_return_t new_reader
   kind = type->typekind_no_key ? NN_ENTITYID_KIND_READER_NO_KEY : NN_ENTITYID_KIND_READER_WITH_KEY;
   if ((rc = pp_allocate_entityid (&rdguid->entityid, kind, pp)) < 0)
     return rc;
-  return new_reader_guid (rd_out, rdguid, group_guid, pp, topic_name, type, xqos, rhc, status_cb, status_cbarg);
+  return new_reader_guid (rd_out, rdguid, group_guid, pp, topic_name, type, xqos, rhc, status_cb, status_cbarg, content_filter);
 }
 
 static void gc_delete_reader (struct gcreq *gcreq)
@@ -4668,6 +4864,8 @@ static void gc_delete_reader (struct gcreq *gcreq)
     (rd->status_cb) (rd->status_cb_entity, NULL);
   }
   ddsi_sertype_unref ((struct ddsi_sertype *) rd->type);
+  if (rd->content_filter)
+    content_filter_property_free (rd->content_filter);
 
   ddsi_xqos_fini (rd->xqos);
   ddsrt_free (rd->xqos);
@@ -5584,6 +5782,7 @@ static int proxy_endpoint_common_init (struct entity_common *e, struct proxy_end
   c->as = ref_addrset (as);
   c->vendor = proxypp->vendor;
   c->seq = seq;
+  c->shm_same_host = ddsi_shm_same_host (proxypp->e.gv, plist);
 #ifdef DDS_HAS_TYPE_DISCOVERY
   if ((plist->qos.present & QP_CYCLONE_TYPE_INFORMATION) && plist->qos.type_information.length == sizeof (c->type_id.hash))
   {
@@ -5751,6 +5950,8 @@ int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
   pwr->ddsi2direct_cbarg = 0;
 
   local_reader_ary_init (&pwr->rdary);
+  local_reader_ary_init (&pwr->shm_rdary);
+  pwr->shm = NULL;
 
   /* locking the entity prevents matching while the built-in topic hasn't been published yet */
   ddsrt_mutex_lock (&pwr->e.lock);
@@ -5876,6 +6077,9 @@ static void gc_delete_proxy_writer (struct gcreq *gcreq)
     free_pwr_rd_match (m);
   }
   local_reader_ary_fini (&pwr->rdary);
+  local_reader_ary_fini (&pwr->shm_rdary);
+  if (pwr->shm)
+    ddsi_shm_detach (pwr->e.gv, pwr->shm);
   if (pwr->c.xqos->liveliness.lease_duration != DDS_INFINITY)
     lease_free (pwr->lease);
 #ifdef DDS_HAS_SECURITY
@@ -5908,6 +6112,7 @@ int delete_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *guid,
      table will prevent the readers from looking up the proxy writer, and consequently
      from removing themselves from the proxy writer's rdary[]. */
   local_reader_ary_setinvalid (&pwr->rdary);
+  local_reader_ary_setinvalid (&pwr->shm_rdary);
   GVLOGDISC ("- deleting\n");
   builtintopic_write (gv->builtin_topic_interface, &pwr->e, timestamp, false);
   entidx_remove_proxy_writer_guid (gv->entity_index, pwr);
@@ -6046,6 +6251,13 @@ int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
   prd->filter = NULL;
 #endif
 
+  /* only filters in the DDS SQL subset can be evaluated by the writers */
+  if ((plist->present & PP_CONTENT_FILTER_PROPERTY) &&
+      (*plist->content_filter_property.filter_class_name == 0 || strcmp (plist->content_filter_property.filter_class_name, "DDSSQL") == 0))
+    prd->content_filter = content_filter_property_dup (&plist->content_filter_property);
+  else
+    prd->content_filter = NULL;
+
   /* locking the entity prevents matching while the built-in topic hasn't been published yet */
   ddsrt_mutex_lock (&prd->e.lock);
   entidx_insert_proxy_reader_guid (gv->entity_index, prd);
@@ -6120,6 +6332,8 @@ static void gc_delete_proxy_reader (struct gcreq *gcreq)
 #ifdef DDS_HAS_SECURITY
   q_omg_security_deregister_remote_reader(prd);
 #endif
+  if (prd->content_filter)
+    content_filter_property_free (prd->content_filter);
   proxy_endpoint_common_fini (&prd->e, &prd->c);
   ddsrt_free (prd);
 }
@@ -22,7 +22,8 @@
 
 void nn_freelist_init (struct nn_freelist *fl, uint32_t max, size_t linkoff)
 {
-  (void) fl; (void) max; (void) linkoff;
+  (void) max; (void) linkoff;
+  ddsrt_atomic_st64 (&fl->misses, 0);
 }
 
 void nn_freelist_fini (struct nn_freelist *fl, void (*free) (void *elem))
@@ -44,10 +45,16 @@ void *nn_freelist_pushmany (struct nn_freelist *fl, void *first, void *last, uin
 
 void *nn_freelist_pop (struct nn_freelist *fl)
 {
-  (void) fl;
+  ddsrt_atomic_inc64 (&fl->misses);
   return NULL;
 }
 
+void nn_freelist_stats (struct nn_freelist *fl, uint64_t *hits, uint64_t *misses)
+{
+  *hits = 0;
+  *misses = ddsrt_atomic_ld64 (&fl->misses);
+}
+
 #elif FREELIST_TYPE == FREELIST_ATOMIC_LIFO
 
 void nn_freelist_init (struct nn_freelist *fl, uint32_t max, size_t linkoff)
@@ -56,6 +63,8 @@ void nn_freelist_init (struct nn_freelist *fl, uint32_t max, size_t linkoff)
   ddsrt_atomic_st32(&fl->count, 0);
   fl->max = (max == UINT32_MAX) ? max-1 : max;
   fl->linkoff = linkoff;
+  ddsrt_atomic_st64 (&fl->hits, 0);
+  ddsrt_atomic_st64 (&fl->misses, 0);
 }
 
 void nn_freelist_fini (struct nn_freelist *fl, void (*free) (void *elem))
@@ -92,14 +101,22 @@ void *nn_freelist_pop (struct nn_freelist *fl)
   if ((e = ddsrt_atomic_lifo_pop (&fl->x, fl->linkoff)) != NULL)
   {
     ddsrt_atomic_dec32(&fl->count);
+    ddsrt_atomic_inc64 (&fl->hits);
     return e;
   }
   else
   {
+    ddsrt_atomic_inc64 (&fl->misses);
     return NULL;
   }
 }
 
+void nn_freelist_stats (struct nn_freelist *fl, uint64_t *hits, uint64_t *misses)
+{
+  *hits = ddsrt_atomic_ld64 (&fl->hits);
+  *misses = ddsrt_atomic_ld64 (&fl->misses);
+}
+
 #elif FREELIST_TYPE == FREELIST_DOUBLE
 
 static ddsrt_thread_local int freelist_inner_idx = -1;
@@ -113,12 +130,22 @@ void nn_freelist_init (struct nn_freelist *fl, uint32_t max, size_t linkoff)
     ddsrt_mutex_init (&fl->inner[i].lock);
     fl->inner[i].count = 0;
     fl->inner[i].m = ddsrt_malloc (sizeof (*fl->inner[i].m));
+    fl->inner[i].hits = 0;
+    fl->inner[i].misses = 0;
   }
   ddsrt_atomic_st32 (&fl->cc, 0);
   fl->mlist = NULL;
   fl->emlist = NULL;
   fl->count = 0;
   fl->max = (max == UINT32_MAX) ? max-1 : max;
+  /* the per-thread magazines hold elements in addition to the max in the shared
+     list, so keep them small for small freelists to bound the total */
+  if (fl->max / (2 * NN_FREELIST_NPAR) >= NN_FREELIST_MAGSIZE)
+    fl->magsize = NN_FREELIST_MAGSIZE;
+  else if (fl->max >= 2 * NN_FREELIST_NPAR)
+    fl->magsize = fl->max / (2 * NN_FREELIST_NPAR);
+  else
+    fl->magsize = 1;
   fl->linkoff = linkoff;
 }
 
@@ -146,7 +173,7 @@ void nn_freelist_fini (struct nn_freelist *fl, void (*xfree) (void *))
   while ((m = fl->mlist) != NULL)
   {
     fl->mlist = m->next;
-    for (j = 0; j < NN_FREELIST_MAGSIZE; j++)
+    for (j = 0; j < fl->magsize; j++)
       xfree (m->x[j]);
     ddsrt_free (m);
   }
@@ -194,7 +221,7 @@ static int lock_inner (struct nn_freelist *fl)
 bool nn_freelist_push (struct nn_freelist *fl, void *elem)
 {
   int k = lock_inner (fl);
-  if (fl->inner[k].count < NN_FREELIST_MAGSIZE)
+  if (fl->inner[k].count < fl->magsize)
   {
     fl->inner[k].m->x[fl->inner[k].count++] = elem;
     ddsrt_mutex_unlock (&fl->inner[k].lock);
@@ -204,7 +231,8 @@ bool nn_freelist_push (struct nn_freelist *fl, void *elem)
   {
     struct nn_freelistM *m;
     ddsrt_mutex_lock (&fl->lock);
-    if (fl->count + NN_FREELIST_MAGSIZE >= fl->max)
+    /* magsize <= max for any max > 0, so the shared list always takes at least one magazine */
+    if (fl->count + fl->magsize > fl->max)
     {
       ddsrt_mutex_unlock (&fl->lock);
       ddsrt_mutex_unlock (&fl->inner[k].lock);
@@ -213,7 +241,7 @@ bool nn_freelist_push (struct nn_freelist *fl, void *elem)
     m = fl->inner[k].m;
     m->next = fl->mlist;
     fl->mlist = m;
-    fl->count += NN_FREELIST_MAGSIZE;
+    fl->count += fl->magsize;
     fl->inner[k].count = 0;
     if (fl->emlist == NULL)
       fl->inner[k].m = ddsrt_malloc (sizeof (*fl->inner[k].m));
@@ -251,6 +279,7 @@ void *nn_freelist_pop (struct nn_freelist *fl)
   if (fl->inner[k].count > 0)
   {
     void *e = fl->inner[k].m->x[--fl->inner[k].count];
+    fl->inner[k].hits++;
     ddsrt_mutex_unlock (&fl->inner[k].lock);
     return e;
   }
@@ -260,6 +289,7 @@ void *nn_freelist_pop (struct nn_freelist *fl)
     if (fl->mlist == NULL)
     {
       ddsrt_mutex_unlock (&fl->lock);
+      fl->inner[k].misses++;
       ddsrt_mutex_unlock (&fl->inner[k].lock);
       return NULL;
     }
@@ -270,14 +300,29 @@ void *nn_freelist_pop (struct nn_freelist *fl)
       fl->emlist = fl->inner[k].m;
       fl->inner[k].m = fl->mlist;
       fl->mlist = fl->mlist->next;
-      fl->count -= NN_FREELIST_MAGSIZE;
+      fl->count -= fl->magsize;
       ddsrt_mutex_unlock (&fl->lock);
-      fl->inner[k].count = NN_FREELIST_MAGSIZE;
+      fl->inner[k].count = fl->magsize;
       e = fl->inner[k].m->x[--fl->inner[k].count];
+      fl->inner[k].hits++;
       ddsrt_mutex_unlock (&fl->inner[k].lock);
       return e;
     }
   }
 }
 
+void nn_freelist_stats (struct nn_freelist *fl, uint64_t *hits, uint64_t *misses)
+{
+  /* counted per partition while holding its lock anyway, so that pop doesn't
+     touch a cache line shared by all threads */
+  *hits = *misses = 0;
+  for (int i = 0; i < NN_FREELIST_NPAR; i++)
+  {
+    ddsrt_mutex_lock (&fl->inner[i].lock);
+    *hits += fl->inner[i].hits;
+    *misses += fl->inner[i].misses;
+    ddsrt_mutex_unlock (&fl->inner[i].lock);
+  }
+}
+
 #endif
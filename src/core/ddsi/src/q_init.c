@@ -56,6 +56,8 @@
 #include "dds/ddsi/ddsi_udp.h"
 #include "dds/ddsi/ddsi_tcp.h"
 #include "dds/ddsi/ddsi_raweth.h"
+#include "dds/ddsi/ddsi_xdp.h"
+#include "dds/ddsi/ddsi_shm.h"
 #include "dds/ddsi/ddsi_mcgroup.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/ddsi_serdata_pserop.h"
@@ -77,6 +79,67 @@ static void add_peer_addresses (const struct ddsi_domaingv *gv, struct addrset *
   }
 }
 
+static bool use_multiple_receive_threads (const struct ddsi_config *cfg)
+{
+  /* Under some unknown circumstances Windows (at least Windows 10) exhibits
+     the interesting behaviour of losing its ability to let us send packets
+     to our own sockets. When that happens, dedicated receive threads can no
+     longer be stopped and Cyclone hangs in shutdown.  So until someone
+     figures out why this happens, it is probably best have a different
+     default on Windows. */
+#if _WIN32
+  const bool def = false;
+#else
+  const bool def = true;
+#endif
+  switch (cfg->multiple_recv_threads)
+  {
+    case DDSI_BOOLDEF_FALSE:
+      return false;
+    case DDSI_BOOLDEF_TRUE:
+      return true;
+    case DDSI_BOOLDEF_DEFAULT:
+      return def;
+  }
+  assert (0);
+  return false;
+}
+
+static uint32_t recv_shard_count (const struct ddsi_domaingv *gv)
+{
+  /* Sharding the unicast data port is only done if it gets a receive thread of its own */
+  if (gv->config.recv_shards <= 1 || !gv->m_factory->m_supports_shards)
+    return 1;
+  else if (gv->config.many_sockets_mode != DDSI_MSM_SINGLE_UNICAST || !use_multiple_receive_threads (&gv->config))
+    return 1;
+  else
+    return (gv->config.recv_shards > MAX_RECV_SHARDS) ? MAX_RECV_SHARDS : gv->config.recv_shards;
+}
+
+static dds_return_t make_uc_data_shards (struct ddsi_domaingv *gv, uint32_t port, uint32_t nshards)
+{
+  /* All shards bind to the same port, the first one determines it if it is 0 */
+  dds_return_t rc = DDS_RETCODE_OK;
+  assert (gv->n_data_conn_uc_shards == 0);
+  for (uint32_t i = 0; i < nshards && rc == DDS_RETCODE_OK; i++)
+  {
+    const ddsi_tran_qos_t qos = { .m_purpose = DDSI_TRAN_QOS_RECV_UC, .m_diffserv = 0, .m_shard = i, .m_nshards = nshards };
+    if ((rc = ddsi_factory_create_conn (&gv->data_conn_uc_shards[i], gv->m_factory, port, &qos)) == DDS_RETCODE_OK)
+    {
+      port = ddsi_conn_port (gv->data_conn_uc_shards[i]);
+      gv->n_data_conn_uc_shards++;
+    }
+  }
+  if (rc != DDS_RETCODE_OK)
+  {
+    while (gv->n_data_conn_uc_shards > 0)
+      ddsi_conn_free (gv->data_conn_uc_shards[--gv->n_data_conn_uc_shards]);
+    return rc;
+  }
+  gv->data_conn_uc = gv->data_conn_uc_shards[0];
+  return DDS_RETCODE_OK;
+}
+
 enum make_uc_sockets_ret {
   MUSRET_SUCCESS,       /* unicast socket(s) created */
   MUSRET_INVALID_PORTS, /* specified port numbers are invalid */
@@ -110,7 +173,14 @@ static enum make_uc_sockets_ret make_uc_sockets (struct ddsi_domaingv *gv, uint3
   if (rc != DDS_RETCODE_OK)
     goto fail_disc;
 
-  if (*pdata == 0 || *pdata == *pdisc)
+  const uint32_t nshards = recv_shard_count (gv);
+  if (nshards > 1 && *pdata != *pdisc)
+  {
+    rc = make_uc_data_shards (gv, *pdata, nshards);
+    if (rc != DDS_RETCODE_OK)
+      goto fail_data;
+  }
+  else if (*pdata == 0 || *pdata == *pdisc)
     gv->data_conn_uc = gv->disc_conn_uc;
   else
   {
@@ -890,32 +960,6 @@ static void make_special_types (struct ddsi_domaingv *gv)
   free_special_types (gv);
 }
 
-static bool use_multiple_receive_threads (const struct ddsi_config *cfg)
-{
-  /* Under some unknown circumstances Windows (at least Windows 10) exhibits
-     the interesting behaviour of losing its ability to let us send packets
-     to our own sockets. When that happens, dedicated receive threads can no
-     longer be stopped and Cyclone hangs in shutdown.  So until someone
-     figures out why this happens, it is probably best have a different
-     default on Windows. */
-#if _WIN32
-  const bool def = false;
-#else
-  const bool def = true;
-#endif
-  switch (cfg->multiple_recv_threads)
-  {
-    case DDSI_BOOLDEF_FALSE:
-      return false;
-    case DDSI_BOOLDEF_TRUE:
-      return true;
-    case DDSI_BOOLDEF_DEFAULT:
-      return def;
-  }
-  assert (0);
-  return false;
-}
-
 static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
 {
   const bool multi_recv_thr = use_multiple_receive_threads (&gv->config);
@@ -928,7 +972,10 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     gv->recv_threads[i].arg.gv = gv;
     gv->recv_threads[i].arg.u.single.loc = NULL;
     gv->recv_threads[i].arg.u.single.conn = NULL;
+    gv->recv_threads[i].arg.u.single.shard = 0;
   }
+  if (gv->config.recv_shards > 1 && gv->n_data_conn_uc_shards == 0)
+    GVLOG (DDS_LC_CONFIG, "ReceiveShards ignored: requires transport support, a separate unicast data port, ManySocketsMode single and MultipleReceiveThreads\n");
 
   /* First thread always uses a waitset and gobbles up all sockets not handled by dedicated threads - FIXME: DDSI_MSM_NO_UNICAST mode with UDP probably doesn't even need this one to use a waitset */
   gv->n_recv_threads = 1;
@@ -946,7 +993,7 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
       ddsi_conn_disable_multiplexing (gv->data_conn_mc);
       gv->n_recv_threads++;
     }
-    if (gv->config.many_sockets_mode == DDSI_MSM_SINGLE_UNICAST)
+    if (gv->config.many_sockets_mode == DDSI_MSM_SINGLE_UNICAST && gv->n_data_conn_uc_shards == 0)
     {
       /* No per-participant sockets => handle data unicasts on a separate thread as well */
       gv->recv_threads[gv->n_recv_threads].name = "recvUC";
@@ -956,6 +1003,23 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
       ddsi_conn_disable_multiplexing (gv->data_conn_uc);
       gv->n_recv_threads++;
     }
+    else if (gv->config.many_sockets_mode == DDSI_MSM_SINGLE_UNICAST)
+    {
+      /* Sharded unicast data port => a thread per shard, all shards share the
+         locator and are triggered by the contents of the trigger message */
+      for (uint32_t i = 0; i < gv->n_data_conn_uc_shards; i++)
+      {
+        struct recv_thread * const rt = &gv->recv_threads[gv->n_recv_threads];
+        (void) snprintf (rt->namebuf, sizeof (rt->namebuf), "recvUC%"PRIu32, i);
+        rt->name = rt->namebuf;
+        rt->arg.mode = RTM_SINGLE;
+        rt->arg.u.single.conn = gv->data_conn_uc_shards[i];
+        rt->arg.u.single.loc = &gv->loc_default_uc;
+        rt->arg.u.single.shard = i;
+        ddsi_conn_disable_multiplexing (gv->data_conn_uc_shards[i]);
+        gv->n_recv_threads++;
+      }
+    }
   }
   assert (gv->n_recv_threads <= MAX_RECV_THREADS);
 
@@ -965,7 +1029,7 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     /* We create the rbufpool for the receive thread, and so we'll
        become the initial owner thread. The receive thread will change
        it before it does anything with it. */
-    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size)) == NULL)
+    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size, gv->config.recv_batch_size)) == NULL)
     {
       GVERROR ("rtps_init: can't allocate receive buffer pool for thread %s\n", gv->recv_threads[i].name);
       goto fail;
@@ -1059,6 +1123,10 @@ static void free_conns (struct ddsi_domaingv *gv)
         cs[j] = NULL;
     ddsi_conn_free (cs[i]);
   }
+  // data_conn_uc is the first shard
+  for (uint32_t i = 1; i < gv->n_data_conn_uc_shards; i++)
+    ddsi_conn_free (gv->data_conn_uc_shards[i]);
+  gv->n_data_conn_uc_shards = 0;
 }
 
 int rtps_init (struct ddsi_domaingv *gv)
@@ -1074,6 +1142,7 @@ int rtps_init (struct ddsi_domaingv *gv)
 
   gv->disc_conn_uc = NULL;
   gv->data_conn_uc = NULL;
+  gv->n_data_conn_uc_shards = 0;
   gv->disc_conn_mc = NULL;
   gv->data_conn_mc = NULL;
   gv->xmit_conn = NULL;
@@ -1131,6 +1200,15 @@ int rtps_init (struct ddsi_domaingv *gv)
         goto err_udp_tcp_init;
       gv->m_factory = ddsi_factory_find (gv, "raweth");
       break;
+    case DDSI_TRANS_XDP:
+      gv->config.publish_uc_locators = 1;
+      gv->config.enable_uc_locators = 0;
+      gv->config.participantIndex = DDSI_PARTICIPANT_INDEX_NONE;
+      gv->config.many_sockets_mode = DDSI_MSM_NO_UNICAST;
+      if (ddsi_xdp_init (gv) < 0)
+        goto err_udp_tcp_init;
+      gv->m_factory = ddsi_factory_find (gv, "xdp");
+      break;
   }
 
   if (!find_own_ip (gv, gv->config.networkAddressString))
@@ -1311,6 +1389,10 @@ int rtps_init (struct ddsi_domaingv *gv)
 
   gv->m_tkmap = ddsi_tkmap_new (gv);
 
+  gv->shm = NULL;
+  if (gv->config.shm_enable && ddsi_shm_init (gv) < 0)
+    GVWARNING ("shared memory delivery disabled\n");
+
   if (gv->m_factory->m_connless)
   {
     if (gv->config.participantIndex >= 0 || gv->config.participantIndex == DDSI_PARTICIPANT_INDEX_NONE)
@@ -1563,6 +1645,8 @@ int rtps_init (struct ddsi_domaingv *gv)
   gv->gcreq_queue = gcreq_queue_new (gv);
 
   ddsrt_atomic_st32 (&gv->rtps_keepgoing, 1);
+  ddsrt_atomic_st64 (&gv->whc_budget_used, 0);
+  ddsrt_atomic_st32 (&gv->whc_budget_nwriters, 0);
 
   if (gv->config.xpack_send_async)
   {
@@ -1570,12 +1654,12 @@ int rtps_init (struct ddsi_domaingv *gv)
     nn_xpack_sendq_start (gv);
   }
 
-  gv->builtins_dqueue = nn_dqueue_new ("builtins", gv, gv->config.delivery_queue_maxsamples, builtins_dqueue_handler, NULL);
+  gv->builtins_dqueue = nn_dqueue_new ("builtins", gv, gv->config.delivery_queue_maxsamples, builtins_dqueue_handler, NULL, NULL);
 #ifdef DDS_HAS_NETWORK_CHANNELS
   for (struct ddsi_config_channel_listelem *chptr = gv->config.channels; chptr; chptr = chptr->next)
-    chptr->dqueue = nn_dqueue_new (chptr->name, &gv->config, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
+    chptr->dqueue = nn_dqueue_new (chptr->name, &gv->config, gv->config.delivery_queue_maxsamples, user_dqueue_handler, user_dqueue_batch_handler, NULL);
 #else
-  gv->user_dqueue = nn_dqueue_new ("user", gv, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
+  gv->user_dqueue = nn_dqueue_new ("user", gv, gv->config.delivery_queue_maxsamples, user_dqueue_handler, user_dqueue_batch_handler, NULL);
 #endif
 
   if (reset_deaf_mute_time.v < DDS_NEVER)
@@ -1596,6 +1680,8 @@ err_mc_conn:
     ddsrt_mutex_destroy (&gv->pcap_lock);
   free_group_membership (gv->mship);
 err_unicast_sockets:
+  if (gv->shm)
+    ddsi_shm_fini (gv);
   ddsi_tkmap_free (gv->m_tkmap);
   nn_reorder_free (gv->spdp_reorder);
   nn_defrag_free (gv->spdp_defrag);
@@ -1703,6 +1789,11 @@ int rtps_start (struct ddsi_domaingv *gv)
     xeventq_stop (gv->xevents);
     return -1;
   }
+  if (gv->shm && ddsi_shm_start (gv) < 0)
+  {
+    rtps_stop (gv);
+    return -1;
+  }
   if (gv->listener)
   {
     if (create_thread (&gv->listen_ts, gv, "listen", (uint32_t (*) (void *)) listen_thread, gv->listener) != DDS_RETCODE_OK)
@@ -1759,6 +1850,8 @@ void rtps_stop (struct ddsi_domaingv *gv)
   /* Stop all I/O */
   rtps_term_prep (gv);
   wait_for_receive_threads (gv);
+  if (gv->shm)
+    ddsi_shm_stop (gv);
 
   if (gv->listener)
   {
@@ -1957,6 +2050,8 @@ void rtps_fini (struct ddsi_domaingv *gv)
     nn_rbufpool_free (gv->recv_threads[i].arg.rbpool);
   }
 
+  if (gv->shm)
+    ddsi_shm_fini (gv);
   ddsi_tkmap_free (gv->m_tkmap);
   entity_index_free (gv->entity_index);
   gv->entity_index = NULL;
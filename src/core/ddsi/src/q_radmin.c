@@ -187,7 +187,7 @@
          process (rmsg)
          nn_rmsg_commit (rmsg)
 
-       ... ensure no references to any buffer in rbpool exist ...
+       ... ensure no unpinned references to any buffer in rbpool exist ...
        nn_rbufpool_free (rbpool)
        ...
      }
@@ -196,6 +196,13 @@
    simply discards it and new() returns the same address next time
    round.
 
+   A receive thread that reads several messages in one system call
+   needs several uncommitted rmsgs at the same time.  For that, the
+   pool has a number of slots, each with its own current rbuf, and
+   nn_rmsg_new_multiple allocates one rmsg from each of the first n
+   slots.  There may be at most one uncommitted rmsg per slot at any
+   time; nn_rmsg_new always uses slot 0.
+
    Processing of a single message in process() is roughly as follows:
 
      for rdata in each Data/DataFrag submessage in rmsg
@@ -272,18 +279,22 @@ struct nn_rbufpool {
      only allocating rmsgs from the rbufs in the pool. Any thread may
      be releasing buffers to the pool as they become empty.
 
-     Currently, we only have maintain a current rbuf, which gets
-     replaced when allocating a new one from it fails. Any rbufs that
-     are released are freed completely if different from the current
-     one.
+     Currently, we only have maintain a current rbuf per slot, which
+     gets replaced when allocating a new one from it fails. Any rbufs
+     that are released are freed completely if different from the
+     current one.
 
      Could trivially be done lockless, except that it requires
      compare-and-swap, and we don't have that. But it hardly ever
      happens anyway. */
   ddsrt_mutex_t lock;
-  struct nn_rbuf *current;
   uint32_t rbuf_size;
   uint32_t max_rmsg_size;
+  /* Number of rbufs kept alive by pinned rmsgs (see nn_rmsg_pin) */
+  ddsrt_atomic_uint32_t n_pinned_rbufs;
+  /* One reference for the owner, one for each rbuf: pinned rmsgs may
+     outlive nn_rbufpool_free, and their rbufs still refer to the pool */
+  ddsrt_atomic_uint32_t refcount;
   const struct ddsrt_log_cfg *logcfg;
   bool trace;
 #ifndef NDEBUG
@@ -291,10 +302,15 @@ struct nn_rbufpool {
      is calling functions only the owner may use. */
   ddsrt_thread_t owner_tid;
 #endif
+  /* Current rbuf for each slot, allocated on first use for all but
+     slot 0 */
+  uint32_t nslots;
+  struct nn_rbuf *current[];
 };
 
-static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp);
+static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp, uint32_t slot);
 static void nn_rbuf_release (struct nn_rbuf *rbuf);
+static void nn_rbufpool_unref (struct nn_rbufpool *rbp);
 
 #define TRACE_CFG(obj, logcfg, ...) ((obj)->trace ? (void) DDS_CLOG (DDS_LC_RADMIN, (logcfg), __VA_ARGS__) : (void) 0)
 #define TRACE(obj, ...)             TRACE_CFG ((obj), (obj)->logcfg, __VA_ARGS__)
@@ -336,11 +352,13 @@ static uint32_t max_rmsg_size_w_hdr (uint32_t max_rmsg_size)
     + max_rmsg_size;
 }
 
-struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size)
+struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size, uint32_t max_uncommitted)
 {
   struct nn_rbufpool *rbp;
 
   assert (max_rmsg_size > 0);
+  if (max_uncommitted < 1)
+    max_uncommitted = 1;
 
   /* raise rbuf_size to minimum possible considering max_rmsg_size, there is
      no reason to bother the user with the small difference between the two
@@ -349,7 +367,7 @@ struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_
   if (rbuf_size < max_rmsg_size_w_hdr (max_rmsg_size))
     rbuf_size = max_rmsg_size_w_hdr (max_rmsg_size);
 
-  if ((rbp = ddsrt_malloc (sizeof (*rbp))) == NULL)
+  if ((rbp = ddsrt_malloc (sizeof (*rbp) + max_uncommitted * sizeof (rbp->current[0]))) == NULL)
     goto fail_rbp;
 #ifndef NDEBUG
   rbp->owner_tid = ddsrt_thread_self ();
@@ -359,14 +377,19 @@ struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_
 
   rbp->rbuf_size = rbuf_size;
   rbp->max_rmsg_size = max_rmsg_size;
+  ddsrt_atomic_st32 (&rbp->n_pinned_rbufs, 0);
+  ddsrt_atomic_st32 (&rbp->refcount, 1);
   rbp->logcfg = logcfg;
   rbp->trace = (logcfg->c.mask & DDS_LC_RADMIN) != 0;
+  rbp->nslots = max_uncommitted;
+  for (uint32_t i = 1; i < rbp->nslots; i++)
+    rbp->current[i] = NULL;
 
 #if USE_VALGRIND
   VALGRIND_CREATE_MEMPOOL (rbp, 0, 0);
 #endif
 
-  if ((rbp->current = nn_rbuf_alloc_new (rbp)) == NULL)
+  if ((rbp->current[0] = nn_rbuf_alloc_new (rbp, 0)) == NULL)
     goto fail_rbuf;
   return rbp;
 
@@ -396,20 +419,39 @@ void nn_rbufpool_free (struct nn_rbufpool *rbp)
      reference counts are all 0, as they should be. */
   ASSERT_RBUFPOOL_OWNER (rbp);
 #endif
-  nn_rbuf_release (rbp->current);
+  for (uint32_t i = 0; i < rbp->nslots; i++)
+  {
+    if (rbp->current[i])
+    {
+      struct nn_rbuf * const rbuf = rbp->current[i];
+      rbp->current[i] = NULL;
+      nn_rbuf_release (rbuf);
+    }
+  }
+  nn_rbufpool_unref (rbp);
+}
+
+static void nn_rbufpool_unref (struct nn_rbufpool *rbp)
+{
+  if (ddsrt_atomic_dec32_ov (&rbp->refcount) == 1)
+  {
+    assert (ddsrt_atomic_ld32 (&rbp->n_pinned_rbufs) == 0);
 #if USE_VALGRIND
-  VALGRIND_DESTROY_MEMPOOL (rbp);
+    VALGRIND_DESTROY_MEMPOOL (rbp);
 #endif
-  ddsrt_mutex_destroy (&rbp->lock);
-  ddsrt_free (rbp);
+    ddsrt_mutex_destroy (&rbp->lock);
+    ddsrt_free (rbp);
+  }
 }
 
 /* RBUF ---------------------------------------------------------------- */
 
 struct nn_rbuf {
   ddsrt_atomic_uint32_t n_live_rmsg_chunks;
+  ddsrt_atomic_uint32_t n_pins; /* pinned rmsgs in this rbuf */
   uint32_t size;
   uint32_t max_rmsg_size;
+  uint32_t slot;
   struct nn_rbufpool *rbufpool;
   bool trace;
 
@@ -430,7 +472,7 @@ struct nn_rbuf {
   unsigned char raw[];
 };
 
-static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp)
+static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp, uint32_t slot)
 {
   struct nn_rbuf *rb;
   ASSERT_RBUFPOOL_OWNER (rbp);
@@ -442,25 +484,30 @@ static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp)
 #endif
 
   rb->rbufpool = rbp;
+  ddsrt_atomic_inc32 (&rbp->refcount);
   ddsrt_atomic_st32 (&rb->n_live_rmsg_chunks, 1);
+  ddsrt_atomic_st32 (&rb->n_pins, 0);
   rb->size = rbp->rbuf_size;
   rb->max_rmsg_size = rbp->max_rmsg_size;
+  rb->slot = slot;
   rb->freeptr = rb->raw;
   rb->trace = rbp->trace;
   RBPTRACE ("rbuf_alloc_new(%p) = %p\n", (void *) rbp, (void *) rb);
   return rb;
 }
 
-static struct nn_rbuf *nn_rbuf_new (struct nn_rbufpool *rbp)
+static struct nn_rbuf *nn_rbuf_new (struct nn_rbufpool *rbp, uint32_t slot)
 {
   struct nn_rbuf *rb;
-  assert (rbp->current);
+  assert (slot < rbp->nslots);
+  assert (rbp->current[slot] || slot > 0);
   ASSERT_RBUFPOOL_OWNER (rbp);
-  if ((rb = nn_rbuf_alloc_new (rbp)) != NULL)
+  if ((rb = nn_rbuf_alloc_new (rbp, slot)) != NULL)
   {
     ddsrt_mutex_lock (&rbp->lock);
-    nn_rbuf_release (rbp->current);
-    rbp->current = rb;
+    if (rbp->current[slot])
+      nn_rbuf_release (rbp->current[slot]);
+    rbp->current[slot] = rb;
     ddsrt_mutex_unlock (&rbp->lock);
   }
   return rb;
@@ -469,11 +516,12 @@ static struct nn_rbuf *nn_rbuf_new (struct nn_rbufpool *rbp)
 static void nn_rbuf_release (struct nn_rbuf *rbuf)
 {
   struct nn_rbufpool *rbp = rbuf->rbufpool;
-  RBPTRACE ("rbuf_release(%p) pool %p current %p\n", (void *) rbuf, (void *) rbp, (void *) rbp->current);
+  RBPTRACE ("rbuf_release(%p) pool %p slot %"PRIu32" current %p\n", (void *) rbuf, (void *) rbp, rbuf->slot, (void *) rbp->current[rbuf->slot]);
   if (ddsrt_atomic_dec32_ov (&rbuf->n_live_rmsg_chunks) == 1)
   {
     RBPTRACE ("rbuf_release(%p) free\n", (void *) rbuf);
     ddsrt_free (rbuf);
+    nn_rbufpool_unref (rbp);
   }
 }
 
@@ -488,28 +536,32 @@ static void nn_rbuf_release (struct nn_rbuf *rbuf)
    one node to one topic/partition ... */
 #define RMSG_REFCOUNT_UNCOMMITTED_BIAS (1u << 31)
 #define RMSG_REFCOUNT_RDATA_BIAS (1u << 20)
+
+/* Pinned rmsgs (nn_rmsg_pin) may be retained indefinitely by the application,
+   this bounds the number of rbufs per pool that that can keep alive */
+#define MAX_PINNED_RBUFS 4
 #ifndef NDEBUG
 #define ASSERT_RMSG_UNCOMMITTED(rmsg) (assert (ddsrt_atomic_ld32 (&(rmsg)->refcount) >= RMSG_REFCOUNT_UNCOMMITTED_BIAS))
 #else
 #define ASSERT_RMSG_UNCOMMITTED(rmsg) ((void) 0)
 #endif
 
-static void *nn_rbuf_alloc (struct nn_rbufpool *rbp)
+static void *nn_rbuf_alloc (struct nn_rbufpool *rbp, uint32_t slot)
 {
   /* Note: only one thread calls nn_rmsg_new on a pool */
   uint32_t asize = max_rmsg_size_w_hdr (rbp->max_rmsg_size);
   struct nn_rbuf *rb;
-  RBPTRACE ("rmsg_rbuf_alloc(%p, %"PRIu32")\n", (void *) rbp, asize);
+  RBPTRACE ("rmsg_rbuf_alloc(%p, %"PRIu32", %"PRIu32")\n", (void *) rbp, slot, asize);
   ASSERT_RBUFPOOL_OWNER (rbp);
-  rb = rbp->current;
-  assert (rb != NULL);
-  assert (rb->freeptr >= rb->raw);
-  assert (rb->freeptr <= rb->raw + rb->size);
+  assert (slot < rbp->nslots);
+  rb = rbp->current[slot];
+  assert (rb == NULL || rb->freeptr >= rb->raw);
+  assert (rb == NULL || rb->freeptr <= rb->raw + rb->size);
 
-  if ((uint32_t) (rb->raw + rb->size - rb->freeptr) < asize)
+  if (rb == NULL || (uint32_t) (rb->raw + rb->size - rb->freeptr) < asize)
   {
-    /* not enough space left for new rmsg */
-    if ((rb = nn_rbuf_new (rbp)) == NULL)
+    /* not enough space left for new rmsg (or slot not used before) */
+    if ((rb = nn_rbuf_new (rbp, slot)) == NULL)
       return NULL;
 
     /* a new one should have plenty of space */
@@ -531,28 +583,48 @@ static void init_rmsg_chunk (struct nn_rmsg_chunk *chunk, struct nn_rbuf *rbuf)
   ddsrt_atomic_inc32 (&rbuf->n_live_rmsg_chunks);
 }
 
-struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbp)
+static struct nn_rmsg *nn_rmsg_new_slot (struct nn_rbufpool *rbp, uint32_t slot)
 {
   /* Note: only one thread calls nn_rmsg_new on a pool */
   struct nn_rmsg *rmsg;
-  RBPTRACE ("rmsg_new(%p)\n", (void *) rbp);
+  RBPTRACE ("rmsg_new(%p, %"PRIu32")\n", (void *) rbp, slot);
 
-  rmsg = nn_rbuf_alloc (rbp);
+  rmsg = nn_rbuf_alloc (rbp, slot);
   if (rmsg == NULL)
     return NULL;
 
   /* Reference to this rmsg, undone by rmsg_commit(). */
   ddsrt_atomic_st32 (&rmsg->refcount, RMSG_REFCOUNT_UNCOMMITTED_BIAS);
   /* Initial chunk */
-  init_rmsg_chunk (&rmsg->chunk, rbp->current);
+  init_rmsg_chunk (&rmsg->chunk, rbp->current[slot]);
   rmsg->trace = rbp->trace;
   rmsg->lastchunk = &rmsg->chunk;
   /* Incrementing freeptr happens in commit(), so that discarding the
      message is really simple. */
-  RBPTRACE ("rmsg_new(%p) = %p\n", (void *) rbp, (void *) rmsg);
+  RBPTRACE ("rmsg_new(%p, %"PRIu32") = %p\n", (void *) rbp, slot, (void *) rmsg);
   return rmsg;
 }
 
+struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbp)
+{
+  return nn_rmsg_new_slot (rbp, 0);
+}
+
+uint32_t nn_rmsg_new_multiple (struct nn_rbufpool *rbp, uint32_t n, struct nn_rmsg **rmsgs)
+{
+  /* Allocates from slots 0 .. n-1, so none of them may have an uncommitted
+     rmsg; stops at the first failure */
+  uint32_t i;
+  if (n > rbp->nslots)
+    n = rbp->nslots;
+  for (i = 0; i < n; i++)
+  {
+    if ((rmsgs[i] = nn_rmsg_new_slot (rbp, i)) == NULL)
+      break;
+  }
+  return i;
+}
+
 void nn_rmsg_setsize (struct nn_rmsg *rmsg, uint32_t size)
 {
   uint32_t size8P = align_rmsg (size);
@@ -626,7 +698,7 @@ void nn_rmsg_commit (struct nn_rmsg *rmsg)
   assert (ddsrt_atomic_ld32 (&rmsg->refcount) >= RMSG_REFCOUNT_UNCOMMITTED_BIAS);
   assert (ddsrt_atomic_ld32 (&rmsg->chunk.rbuf->n_live_rmsg_chunks) > 0);
   assert (ddsrt_atomic_ld32 (&chunk->rbuf->n_live_rmsg_chunks) > 0);
-  assert (chunk->rbuf->rbufpool->current == chunk->rbuf);
+  assert (chunk->rbuf->rbufpool->current[chunk->rbuf->slot] == chunk->rbuf);
   if (ddsrt_atomic_sub32_nv (&rmsg->refcount, RMSG_REFCOUNT_UNCOMMITTED_BIAS) == 0)
     nn_rmsg_free (rmsg);
   else
@@ -675,6 +747,55 @@ static void nn_rmsg_unref (struct nn_rmsg *rmsg)
     nn_rmsg_free (rmsg);
 }
 
+bool nn_rmsg_pin (struct nn_rmsg *rmsg)
+{
+  /* Any thread holding a reference may pin the rmsg, committed or not.  An
+     rmsg keeps its entire rbuf alive, so what gets limited is the number of
+     rbufs with pinned rmsgs in them; pinning additional rmsgs in an rbuf that
+     already has some costs nothing extra. */
+  struct nn_rbuf *rbuf = rmsg->chunk.rbuf;
+  struct nn_rbufpool *rbp = rbuf->rbufpool;
+  uint32_t n = ddsrt_atomic_ld32 (&rbuf->n_pins);
+  assert (ddsrt_atomic_ld32 (&rmsg->refcount) > 0);
+  for (;;)
+  {
+    if (n > 0)
+    {
+      if (ddsrt_atomic_cas32 (&rbuf->n_pins, n, n + 1))
+        break;
+    }
+    else
+    {
+      uint32_t m;
+      do {
+        m = ddsrt_atomic_ld32 (&rbp->n_pinned_rbufs);
+        if (m >= MAX_PINNED_RBUFS)
+        {
+          RMSGTRACE ("rmsg_pin(%p) limit hit\n", (void *) rmsg);
+          return false;
+        }
+      } while (!ddsrt_atomic_cas32 (&rbp->n_pinned_rbufs, m, m + 1));
+      if (ddsrt_atomic_cas32 (&rbuf->n_pins, 0, 1))
+        break;
+      ddsrt_atomic_dec32 (&rbp->n_pinned_rbufs);
+    }
+    n = ddsrt_atomic_ld32 (&rbuf->n_pins);
+  }
+  RMSGTRACE ("rmsg_pin(%p)\n", (void *) rmsg);
+  ddsrt_atomic_inc32 (&rmsg->refcount);
+  return true;
+}
+
+void nn_rmsg_unpin (struct nn_rmsg *rmsg)
+{
+  struct nn_rbuf *rbuf = rmsg->chunk.rbuf;
+  RMSGTRACE ("rmsg_unpin(%p)\n", (void *) rmsg);
+  assert (ddsrt_atomic_ld32 (&rbuf->n_pins) > 0);
+  if (ddsrt_atomic_dec32_nv (&rbuf->n_pins) == 0)
+    ddsrt_atomic_dec32 (&rbuf->rbufpool->n_pinned_rbufs);
+  nn_rmsg_unref (rmsg);
+}
+
 void *nn_rmsg_alloc (struct nn_rmsg *rmsg, uint32_t size)
 {
   struct nn_rmsg_chunk *chunk = rmsg->lastchunk;
@@ -693,13 +814,13 @@ void *nn_rmsg_alloc (struct nn_rmsg *rmsg, uint32_t size)
     struct nn_rmsg_chunk *newchunk;
     RMSGTRACE ("rmsg_alloc(%p, %"PRIu32") limit hit - new chunk\n", (void *) rmsg, size);
     commit_rmsg_chunk (chunk);
-    newchunk = nn_rbuf_alloc (rbp);
+    newchunk = nn_rbuf_alloc (rbp, rbuf->slot);
     if (newchunk == NULL)
     {
       DDS_CWARNING (rbp->logcfg, "nn_rmsg_alloc: can't allocate more memory (%"PRIu32" bytes) ... giving up\n", size);
       return NULL;
     }
-    init_rmsg_chunk (newchunk, rbp->current);
+    init_rmsg_chunk (newchunk, rbp->current[rbuf->slot]);
     rmsg->lastchunk = chunk->next = newchunk;
     chunk = newchunk;
   }
@@ -1819,7 +1940,10 @@ struct nn_rsample *nn_reorder_rsample_dup_first (struct nn_rmsg *rmsg, struct nn
   sce->fragchain = rsampleiv->u.reorder.sc.first->fragchain;
   sce->next = NULL;
   sce->sampleinfo = rsampleiv->u.reorder.sc.first->sampleinfo;
-  rsampleiv_new->u.reorder.min = rsampleiv->u.reorder.min;
+  /* the interval may start with a gap that got coalesced into it (e.g., the one
+     inserted for a reliable proxy writer without reliable readers), so take the
+     sequence number of the sample itself */
+  rsampleiv_new->u.reorder.min = sce->sampleinfo->seq;
   rsampleiv_new->u.reorder.maxp1 = rsampleiv_new->u.reorder.min + 1;
   rsampleiv_new->u.reorder.n_samples = 1;
   rsampleiv_new->u.reorder.sc.first = rsampleiv_new->u.reorder.sc.last = sce;
@@ -2429,6 +2553,7 @@ struct nn_dqueue {
   ddsrt_mutex_t lock;
   ddsrt_cond_t cond;
   nn_dqueue_handler_t handler;
+  nn_dqueue_batch_handler_t batch_handler;
   void *handler_arg;
 
   struct nn_rsample_chain sc;
@@ -2480,6 +2605,31 @@ static enum dqueue_elem_kind dqueue_elem_kind (const struct nn_rsample_chain_ele
     return DQEK_BUBBLE;
 }
 
+/* Maximum number of consecutive data samples passed to the batch handler in one call */
+#define DQUEUE_BATCH_MAX 32
+
+static void dqueue_flush_batch (struct nn_dqueue *q, uint32_t *n, struct nn_rsample_chain_elem **batch, const ddsi_guid_t *prdguid)
+{
+  /* The chain elements live in the receive buffers and remain valid until their
+     fragchains are released, which therefore must be done after calling the handler */
+  const struct nn_rsample_info *sampleinfos[DQUEUE_BATCH_MAX];
+  struct nn_rdata *fragchains[DQUEUE_BATCH_MAX];
+  int ret;
+  if (*n == 0)
+    return;
+  for (uint32_t i = 0; i < *n; i++)
+  {
+    sampleinfos[i] = batch[i]->sampleinfo;
+    fragchains[i] = batch[i]->fragchain;
+  }
+  ret = q->batch_handler (*n, sampleinfos, (const struct nn_rdata * const *) fragchains, prdguid, q->handler_arg);
+  (void) ret; /* eliminate set-but-not-used in NDEBUG case */
+  assert (ret == 0); /* so every handler will return 0 */
+  for (uint32_t i = 0; i < *n; i++)
+    nn_fragchain_unref (fragchains[i]);
+  *n = 0;
+}
+
 static uint32_t dqueue_thread (struct nn_dqueue *q)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
@@ -2490,6 +2640,8 @@ static uint32_t dqueue_thread (struct nn_dqueue *q)
   int keepgoing = 1;
   ddsi_guid_t rdguid, *prdguid = NULL;
   uint32_t rdguid_count = 0;
+  struct nn_rsample_chain_elem *batch[DQUEUE_BATCH_MAX];
+  uint32_t nbatch = 0;
 
   ddsrt_mutex_lock (&q->lock);
   while (keepgoing)
@@ -2514,7 +2666,27 @@ static uint32_t dqueue_thread (struct nn_dqueue *q)
         ddsrt_cond_broadcast (&q->cond);
       }
       thread_state_awake_to_awake_no_nest (ts1);
-      switch (dqueue_elem_kind (e))
+      const enum dqueue_elem_kind kind = dqueue_elem_kind (e);
+      if (kind == DQEK_DATA && q->batch_handler)
+      {
+        /* Consecutive data samples for the same reader (or for all readers) are
+           collected and delivered in one go; anything else first flushes them to
+           preserve the order */
+        batch[nbatch++] = e;
+        if (nbatch == DQUEUE_BATCH_MAX)
+          dqueue_flush_batch (q, &nbatch, batch, prdguid);
+        if (rdguid_count > 0)
+        {
+          if (--rdguid_count == 0)
+          {
+            dqueue_flush_batch (q, &nbatch, batch, prdguid);
+            prdguid = NULL;
+          }
+        }
+        continue;
+      }
+      dqueue_flush_batch (q, &nbatch, batch, prdguid);
+      switch (kind)
       {
         case DQEK_DATA:
           ret = q->handler (e->sampleinfo, e->fragchain, prdguid, q->handler_arg);
@@ -2564,6 +2736,7 @@ static uint32_t dqueue_thread (struct nn_dqueue *q)
           }
       }
     }
+    dqueue_flush_batch (q, &nbatch, batch, prdguid);
 
     thread_state_asleep (ts1);
     ddsrt_mutex_lock (&q->lock);
@@ -2572,7 +2745,7 @@ static uint32_t dqueue_thread (struct nn_dqueue *q)
   return 0;
 }
 
-struct nn_dqueue *nn_dqueue_new (const char *name, const struct ddsi_domaingv *gv, uint32_t max_samples, nn_dqueue_handler_t handler, void *arg)
+struct nn_dqueue *nn_dqueue_new (const char *name, const struct ddsi_domaingv *gv, uint32_t max_samples, nn_dqueue_handler_t handler, nn_dqueue_batch_handler_t batch_handler, void *arg)
 {
   struct nn_dqueue *q;
   char *thrname;
@@ -2585,6 +2758,7 @@ struct nn_dqueue *nn_dqueue_new (const char *name, const struct ddsi_domaingv *g
   q->max_samples = max_samples;
   ddsrt_atomic_st32 (&q->nof_samples, 0);
   q->handler = handler;
+  q->batch_handler = batch_handler;
   q->handler_arg = arg;
   q->sc.first = q->sc.last = NULL;
 
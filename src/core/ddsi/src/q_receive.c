@@ -842,8 +842,18 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
       rn->seq = wr->seq;
     }
     ddsrt_avl_augment_update (&wr_readers_treedef, rn);
-    n = remove_acked_messages (wr, &whcst, &deferred_free_list);
-    RSTTRACE (" ACK%"PRId64" RM%u", n_ack, n);
+    if (writer_may_defer_remove_acked_messages (wr))
+    {
+      /* trigger anyone waiting in wait_for_acks(), the WHC gets cleaned up later */
+      ddsrt_cond_broadcast (&wr->throttle_cond);
+      whc_get_state (wr->whc, &whcst);
+      RSTTRACE (" ACK%"PRId64" RM-deferred", n_ack);
+    }
+    else
+    {
+      n = remove_acked_messages (wr, &whcst, &deferred_free_list);
+      RSTTRACE (" ACK%"PRId64" RM%u", n_ack, n);
+    }
   }
   else
   {
@@ -971,7 +981,7 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
         if (!wr->retransmitting && sample.unacked)
           writer_set_retransmitting (wr);
 
-        if (rst->gv->config.retransmit_merging != DDSI_REXMIT_MERGE_NEVER && rn->assumed_in_sync && !prd->filter)
+        if (rst->gv->config.retransmit_merging != DDSI_REXMIT_MERGE_NEVER && rn->assumed_in_sync && !prd->filter && !rn->filter)
         {
           /* send retransmit to all receivers, but skip if recently done */
           ddsrt_mtime_t tstamp = ddsrt_time_monotonic ();
@@ -1001,9 +1011,10 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
         }
         else
         {
-          /* Is this a volatile reader with a filter?
+          /* Is this a volatile reader with a filter, or a reader with a content filter?
            * If so, call the filter to see if we should re-arrange the sequence gap when needed. */
-          if (prd->filter && !prd->filter (wr, prd, sample.serdata))
+          if ((prd->filter && !prd->filter (wr, prd, sample.serdata)) ||
+              (rn->filter && writer_content_filtered_for_participant (wr, &prd->e.guid, sample.serdata)))
             nn_gap_info_update (rst->gv, &gi, seqbase + i);
           else
           {
@@ -2017,6 +2028,7 @@ static struct ddsi_serdata *remote_make_sample (struct ddsi_tkmap_instance **tk,
   }
   else
   {
+    sample->reception_timestamp = sampleinfo->reception_timestamp;
     if ((*tk = ddsi_tkmap_lookup_instance_ref (gv->m_tkmap, sample)) == NULL)
     {
       ddsi_serdata_unref (sample);
@@ -2070,7 +2082,7 @@ static struct reader *proxy_writer_first_in_sync_reader (struct entity_index *en
   struct pwr_rd_match *m;
   struct reader *rd;
   for (m = ddsrt_avl_iter_first (&pwr_readers_treedef, &pwr->readers, it); m != NULL; m = ddsrt_avl_iter_next (it))
-    if (m->in_sync == PRMSS_SYNC && (rd = entidx_lookup_reader_guid (entity_index, &m->rd_guid)) != NULL)
+    if (m->in_sync == PRMSS_SYNC && !m->via_shm && (rd = entidx_lookup_reader_guid (entity_index, &m->rd_guid)) != NULL)
       return rd;
   return NULL;
 }
@@ -2080,7 +2092,7 @@ static struct reader *proxy_writer_next_in_sync_reader (struct entity_index *ent
   struct pwr_rd_match *m;
   struct reader *rd;
   for (m = ddsrt_avl_iter_next (it); m != NULL; m = ddsrt_avl_iter_next (it))
-    if (m->in_sync == PRMSS_SYNC && (rd = entidx_lookup_reader_guid (entity_index, &m->rd_guid)) != NULL)
+    if (m->in_sync == PRMSS_SYNC && !m->via_shm && (rd = entidx_lookup_reader_guid (entity_index, &m->rd_guid)) != NULL)
       return rd;
   return NULL;
 }
@@ -2100,29 +2112,23 @@ static dds_return_t remote_on_delivery_failure_fastpath (struct entity_common *s
   return DDS_RETCODE_TRY_AGAIN;
 }
 
-static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, int pwr_locked)
+static const struct deliver_locally_ops remote_deliver_locally_ops = {
+  .makesample = remote_make_sample,
+  .first_reader = proxy_writer_first_in_sync_reader,
+  .next_reader = proxy_writer_next_in_sync_reader,
+  .on_failure_fastpath = remote_on_delivery_failure_fastpath
+};
+
+static bool init_remote_sourceinfo (struct remote_sourceinfo *sourceinfo, ddsi_plist_t *qos, bool *qos_parsed, const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain)
 {
-  static const struct deliver_locally_ops deliver_locally_ops = {
-    .makesample = remote_make_sample,
-    .first_reader = proxy_writer_first_in_sync_reader,
-    .next_reader = proxy_writer_next_in_sync_reader,
-    .on_failure_fastpath = remote_on_delivery_failure_fastpath
-  };
   struct receiver_state const * const rst = sampleinfo->rst;
   struct ddsi_domaingv * const gv = rst->gv;
   struct proxy_writer * const pwr = sampleinfo->pwr;
   unsigned statusinfo;
   Data_DataFrag_common_t *msg;
   unsigned char data_smhdr_flags;
-  ddsi_plist_t qos;
   int need_keyhash;
 
-  if (pwr->ddsi2direct_cb)
-  {
-    pwr->ddsi2direct_cb (sampleinfo, fragchain, pwr->ddsi2direct_cbarg);
-    return 0;
-  }
-
   /* FIXME: fragments are now handled by copying the message to
      freshly malloced memory (see defragment()) ... that'll have to
      change eventually */
@@ -2150,7 +2156,7 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
   need_keyhash = (sampleinfo->size == 0 || (data_smhdr_flags & (DATA_FLAG_KEYFLAG | DATA_FLAG_DATAFLAG)) == 0);
   if (!(sampleinfo->complex_qos || need_keyhash) || !(data_smhdr_flags & DATA_FLAG_INLINE_QOS))
   {
-    ddsi_plist_init_empty (&qos);
+    *qos_parsed = false;
     statusinfo = sampleinfo->statusinfo;
   }
   else
@@ -2166,41 +2172,140 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
     src.strict = DDSI_SC_STRICT_P (gv->config);
     src.factory = gv->m_factory;
     src.logconfig = &gv->logconfig;
-    if ((plist_ret = ddsi_plist_init_frommsg (&qos, NULL, PP_STATUSINFO | PP_KEYHASH | PP_COHERENT_SET, 0, &src)) < 0)
+    if ((plist_ret = ddsi_plist_init_frommsg (qos, NULL, PP_STATUSINFO | PP_KEYHASH | PP_COHERENT_SET, 0, &src)) < 0)
     {
       if (plist_ret != DDS_RETCODE_UNSUPPORTED)
         GVWARNING ("data(application, vendor %u.%u): "PGUIDFMT" #%"PRId64": invalid inline qos\n",
                    src.vendorid.id[0], src.vendorid.id[1], PGUID (pwr->e.guid), sampleinfo->seq);
-      return 0;
+      return false;
     }
-    statusinfo = (qos.present & PP_STATUSINFO) ? qos.statusinfo : 0;
+    *qos_parsed = true;
+    statusinfo = (qos->present & PP_STATUSINFO) ? qos->statusinfo : 0;
   }
 
   /* FIXME: should it be 0, local wall clock time or INVALID? */
-  const ddsrt_wctime_t tstamp = (sampleinfo->timestamp.v != DDSRT_WCTIME_INVALID.v) ? sampleinfo->timestamp : ((ddsrt_wctime_t) {0});
+  sourceinfo->sampleinfo = sampleinfo;
+  sourceinfo->data_smhdr_flags = data_smhdr_flags;
+  sourceinfo->qos = qos;
+  sourceinfo->fragchain = fragchain;
+  sourceinfo->statusinfo = statusinfo;
+  sourceinfo->tstamp = (sampleinfo->timestamp.v != DDSRT_WCTIME_INVALID.v) ? sampleinfo->timestamp : ((ddsrt_wctime_t) {0});
+  return true;
+}
+
+static void deliver_remote_sourceinfo (struct remote_sourceinfo *sourceinfo, const ddsi_guid_t *rdguid, int pwr_locked)
+{
+  const struct nn_rsample_info *sampleinfo = sourceinfo->sampleinfo;
+  struct ddsi_domaingv * const gv = sampleinfo->rst->gv;
+  struct proxy_writer * const pwr = sampleinfo->pwr;
   struct ddsi_writer_info wrinfo;
-  ddsi_make_writer_info (&wrinfo, &pwr->e, pwr->c.xqos, statusinfo);
-
-  struct remote_sourceinfo sourceinfo = {
-    .sampleinfo = sampleinfo,
-    .data_smhdr_flags = data_smhdr_flags,
-    .qos = &qos,
-    .fragchain = fragchain,
-    .statusinfo = statusinfo,
-    .tstamp = tstamp
-  };
+  ddsi_make_writer_info (&wrinfo, &pwr->e, pwr->c.xqos, sourceinfo->statusinfo);
   if (rdguid)
-    (void) deliver_locally_one (gv, &pwr->e, pwr_locked != 0, rdguid, &wrinfo, &deliver_locally_ops, &sourceinfo);
+    (void) deliver_locally_one (gv, &pwr->e, pwr_locked != 0, rdguid, &wrinfo, &remote_deliver_locally_ops, sourceinfo);
   else
   {
-    (void) deliver_locally_allinsync (gv, &pwr->e, pwr_locked != 0, &pwr->rdary, &wrinfo, &deliver_locally_ops, &sourceinfo);
+    (void) deliver_locally_allinsync (gv, &pwr->e, pwr_locked != 0, &pwr->rdary, &wrinfo, &remote_deliver_locally_ops, sourceinfo);
     ddsrt_atomic_st32 (&pwr->next_deliv_seq_lowword, (uint32_t) (sampleinfo->seq + 1));
   }
+}
+
+static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, int pwr_locked)
+{
+  struct proxy_writer * const pwr = sampleinfo->pwr;
+  struct remote_sourceinfo sourceinfo;
+  ddsi_plist_t qos;
+  bool qos_parsed;
 
+  if (pwr->ddsi2direct_cb)
+  {
+    pwr->ddsi2direct_cb (sampleinfo, fragchain, pwr->ddsi2direct_cbarg);
+    return 0;
+  }
+  if (!init_remote_sourceinfo (&sourceinfo, &qos, &qos_parsed, sampleinfo, fragchain))
+    return 0;
+  if (!qos_parsed)
+    ddsi_plist_init_empty (&qos);
+  deliver_remote_sourceinfo (&sourceinfo, rdguid, pwr_locked);
   ddsi_plist_fini (&qos);
   return 0;
 }
 
+static void deliver_remote_sourceinfo_batch (struct proxy_writer *pwr, uint32_t n, void * const *vsourceinfos, const ddsi_guid_t *rdguid, int pwr_locked)
+{
+  struct ddsi_domaingv * const gv = pwr->e.gv;
+  const struct remote_sourceinfo *last = vsourceinfos[n - 1];
+  struct ddsi_writer_info wrinfo;
+  ddsi_make_writer_info (&wrinfo, &pwr->e, pwr->c.xqos, 0);
+  if (rdguid)
+    (void) deliver_locally_one_batch (gv, &pwr->e, pwr_locked != 0, rdguid, &wrinfo, &remote_deliver_locally_ops, n, vsourceinfos);
+  else
+  {
+    (void) deliver_locally_allinsync_batch (gv, &pwr->e, pwr_locked != 0, &pwr->rdary, &wrinfo, &remote_deliver_locally_ops, n, vsourceinfos);
+    ddsrt_atomic_st32 (&pwr->next_deliv_seq_lowword, (uint32_t) (last->sampleinfo->seq + 1));
+  }
+}
+
+static void deliver_user_data_batch (uint32_t n, const struct nn_rsample_info * const *sampleinfos, const struct nn_rdata * const *fragchains, const ddsi_guid_t *rdguid, int pwr_locked)
+{
+  /* Consecutive plain writes from the same proxy writer are delivered as a batch,
+     anything else (disposes, unregisters, samples with inline QoS, proxy writers
+     with a direct callback) flushes the batch and then gets delivered individually
+     to preserve the order.  The samples in a batch don't need an inline QoS, so
+     they can all share a single empty one. */
+  struct remote_sourceinfo sourceinfos[DELIVER_LOCALLY_MAX_BATCH];
+  void *vsourceinfos[DELIVER_LOCALLY_MAX_BATCH];
+  struct proxy_writer *batch_pwr = NULL;
+  uint32_t nbatch = 0;
+  ddsi_plist_t empty_qos;
+  ddsi_plist_init_empty (&empty_qos);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    struct proxy_writer * const pwr = sampleinfos[i]->pwr;
+    ddsi_plist_t qos;
+    bool qos_parsed;
+    if (nbatch > 0 && (pwr != batch_pwr || nbatch == DELIVER_LOCALLY_MAX_BATCH))
+    {
+      deliver_remote_sourceinfo_batch (batch_pwr, nbatch, vsourceinfos, rdguid, pwr_locked);
+      nbatch = 0;
+    }
+    struct remote_sourceinfo * const si = &sourceinfos[nbatch];
+    if (pwr->ddsi2direct_cb)
+    {
+      if (nbatch > 0)
+      {
+        deliver_remote_sourceinfo_batch (batch_pwr, nbatch, vsourceinfos, rdguid, pwr_locked);
+        nbatch = 0;
+      }
+      pwr->ddsi2direct_cb (sampleinfos[i], fragchains[i], pwr->ddsi2direct_cbarg);
+    }
+    else if (!init_remote_sourceinfo (si, &qos, &qos_parsed, sampleinfos[i], fragchains[i]))
+      ; /* invalid inline QoS: sample is dropped */
+    else if (!qos_parsed && si->statusinfo == 0)
+    {
+      si->qos = &empty_qos;
+      vsourceinfos[nbatch++] = si;
+      batch_pwr = pwr;
+    }
+    else
+    {
+      struct remote_sourceinfo single = *si;
+      if (nbatch > 0)
+      {
+        deliver_remote_sourceinfo_batch (batch_pwr, nbatch, vsourceinfos, rdguid, pwr_locked);
+        nbatch = 0;
+      }
+      if (!qos_parsed)
+        single.qos = &empty_qos;
+      deliver_remote_sourceinfo (&single, rdguid, pwr_locked);
+      if (qos_parsed)
+        ddsi_plist_fini (&qos);
+    }
+  }
+  if (nbatch > 0)
+    deliver_remote_sourceinfo_batch (batch_pwr, nbatch, vsourceinfos, rdguid, pwr_locked);
+  ddsi_plist_fini (&empty_qos);
+}
+
 int user_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, UNUSED_ARG (void *qarg))
 {
   int res;
@@ -2208,21 +2313,41 @@ int user_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct
   return res;
 }
 
+int user_dqueue_batch_handler (uint32_t n, const struct nn_rsample_info * const *sampleinfos, const struct nn_rdata * const *fragchains, const ddsi_guid_t *rdguid, UNUSED_ARG (void *qarg))
+{
+  deliver_user_data_batch (n, sampleinfos, fragchains, rdguid, 0);
+  return 0;
+}
+
 static void deliver_user_data_synchronously (struct nn_rsample_chain *sc, const ddsi_guid_t *rdguid)
 {
+  /* Must not try to deliver a gap -- possibly a FIXME for sample_lost events. Also
+     note that the synchronous path is _never_ used for historical data, and therefore
+     never has the GUID of a reader to deliver to.  The chain elements live in the
+     receive buffers, so the fragchains can only be released once the batch they are
+     in has been delivered. */
+  const struct nn_rsample_info *sampleinfos[DELIVER_LOCALLY_MAX_BATCH];
+  const struct nn_rdata *fragchains[DELIVER_LOCALLY_MAX_BATCH];
+  struct nn_rdata *unref[DELIVER_LOCALLY_MAX_BATCH];
   while (sc->first)
   {
-    struct nn_rsample_chain_elem *e = sc->first;
-    sc->first = e->next;
-    if (e->sampleinfo != NULL)
+    uint32_t n = 0, nunref = 0;
+    while (sc->first && nunref < DELIVER_LOCALLY_MAX_BATCH)
     {
-      /* Must not try to deliver a gap -- possibly a FIXME for
-         sample_lost events. Also note that the synchronous path is
-         _never_ used for historical data, and therefore never has the
-         GUID of a reader to deliver to */
-      deliver_user_data (e->sampleinfo, e->fragchain, rdguid, 1);
+      struct nn_rsample_chain_elem *e = sc->first;
+      sc->first = e->next;
+      if (e->sampleinfo != NULL)
+      {
+        sampleinfos[n] = e->sampleinfo;
+        fragchains[n] = e->fragchain;
+        n++;
+      }
+      unref[nunref++] = e->fragchain;
     }
-    nn_fragchain_unref (e->fragchain);
+    if (n > 0)
+      deliver_user_data_batch (n, sampleinfos, fragchains, rdguid, 1);
+    for (uint32_t i = 0; i < nunref; i++)
+      nn_fragchain_unref (unref[i]);
   }
 }
 
@@ -3169,6 +3294,104 @@ malformed_asleep:
   return -1;
 }
 
+static void process_rtps_message (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, struct nn_rmsg **prmsg, size_t sz, unsigned char *buff, const ddsi_locator_t *srcloc, ddsrt_wctime_t trecv)
+{
+  /* Processes a single RTPS message contained in *prmsg, the caller is responsible for
+     setting the size and committing it; *prmsg gets replaced if the message needs decoding.
+     trecv is the time of reception if the transport provided it, or invalid otherwise */
+  Header_t *hdr = (Header_t *) buff;
+  assert (thread_is_asleep ());
+
+  if (sz < RTPS_MESSAGE_HEADER_SIZE || *(uint32_t *)buff != NN_PROTOCOLID_AS_UINT32)
+  {
+    /* discard packets that are really too small or don't have magic cookie */
+  }
+  else if (hdr->version.major != RTPS_MAJOR || (hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
+  {
+    if ((hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
+      GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu\n, version mismatch: %d.%d\n",
+               PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, hdr->version.major, hdr->version.minor);
+    if (DDSI_SC_PEDANTIC_P (gv->config))
+      malformed_packet_received_nosubmsg (gv, buff, (ssize_t) sz, "header", hdr->vendorid);
+  }
+  else
+  {
+    ssize_t ssz = (ssize_t) sz;
+    hdr->guid_prefix = nn_ntoh_guid_prefix (hdr->guid_prefix);
+
+    if (gv->logconfig.c.mask & DDS_LC_TRACE)
+    {
+      char addrstr[DDSI_LOCSTRLEN];
+      ddsi_locator_to_string(addrstr, sizeof(addrstr), srcloc);
+      GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu from %s\n",
+               PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, addrstr);
+    }
+    nn_rtps_msg_state_t res = decode_rtps_message (ts1, gv, prmsg, &hdr, &buff, &ssz, rbpool, conn->m_stream);
+    if (res != NN_RTPS_MSG_STATE_ERROR)
+    {
+      handle_submsg_sequence (ts1, gv, conn, srcloc, (trecv.v != DDSRT_WCTIME_INVALID.v) ? trecv : ddsrt_time_wallclock (), ddsrt_time_elapsed (), &hdr->guid_prefix, guidprefix, buff, (size_t) ssz, buff + RTPS_MESSAGE_HEADER_SIZE, *prmsg, res == NN_RTPS_MSG_STATE_ENCODED);
+    }
+  }
+}
+
+static void handle_rtps_message (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, struct nn_rmsg *rmsg, size_t sz, unsigned char *buff, const ddsi_locator_t *srcloc, ddsrt_wctime_t trecv)
+{
+  nn_rmsg_setsize (rmsg, (uint32_t) sz);
+  process_rtps_message (ts1, gv, conn, guidprefix, rbpool, &rmsg, sz, buff, srcloc, trecv);
+  nn_rmsg_commit (rmsg);
+}
+
+static bool rtps_message_needs_decoding (const unsigned char *buff, size_t sz)
+{
+#ifdef DDS_HAS_SECURITY
+  const SubmessageHeader_t *submsg = (const SubmessageHeader_t *) (buff + RTPS_MESSAGE_HEADER_SIZE);
+  return sz >= RTPS_MESSAGE_HEADER_SIZE + RTPS_SUBMESSAGE_HEADER_SIZE && submsg->submessageId == SMID_SRTPS_PREFIX;
+#else
+  (void) buff; (void) sz;
+  return false;
+#endif
+}
+
+static void handle_coalesced_rtps_messages (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, struct nn_rmsg *rmsg, size_t sz, size_t segsize, unsigned char *buff, const ddsi_locator_t *srcloc, ddsrt_wctime_t trecv)
+{
+  /* The buffer contains a sequence of RTPS messages of segsize bytes (the last one
+     may be shorter).  They all live in the same rmsg and are processed before it
+     gets committed, so anything retained from any one of them keeps the buffer
+     alive via the usual reference counting.
+
+     Decoding a message replaces the rmsg, committing the original one, so once
+     a message needing decoding is encountered, it and all following messages
+     are copied into rmsgs of their own. */
+  size_t off;
+  assert (segsize > 0 && segsize < sz);
+  nn_rmsg_setsize (rmsg, (uint32_t) sz);
+  for (off = 0; off < sz; off += segsize)
+  {
+    const size_t msz = (sz - off < segsize) ? sz - off : segsize;
+    if (off + msz < sz && rtps_message_needs_decoding (buff + off, msz))
+      break;
+    process_rtps_message (ts1, gv, conn, guidprefix, rbpool, &rmsg, msz, buff + off, srcloc, trecv);
+  }
+  if (off >= sz)
+    nn_rmsg_commit (rmsg);
+  else
+  {
+    const size_t rest = sz - off;
+    unsigned char *copy = ddsrt_malloc (rest);
+    memcpy (copy, buff + off, rest);
+    nn_rmsg_commit (rmsg);
+    for (off = 0; off < rest; off += segsize)
+    {
+      const size_t msz = (rest - off < segsize) ? rest - off : segsize;
+      if ((rmsg = nn_rmsg_new (rbpool)) == NULL)
+        break;
+      memcpy (NN_RMSG_PAYLOAD (rmsg), copy + off, msz);
+      handle_rtps_message (ts1, gv, conn, guidprefix, rbpool, rmsg, msz, (unsigned char *) NN_RMSG_PAYLOAD (rmsg), srcloc, trecv);
+    }
+    ddsrt_free (copy);
+  }
+}
+
 static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool)
 {
   /* UDP max packet size is 64kB */
@@ -3253,47 +3476,83 @@ static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *g
   }
 
   if (sz > 0 && !gv->deaf)
+    handle_rtps_message (ts1, gv, conn, guidprefix, rbpool, rmsg, (size_t) sz, buff, &srcloc, DDSRT_WCTIME_INVALID);
+  else
+    nn_rmsg_commit (rmsg);
+  return (sz > 0);
+}
+
+struct recv_batch {
+  uint32_t n;                     /* maximum number of messages per read (>= 1) */
+  size_t bufsz;                   /* size of each receive buffer */
+  struct nn_rmsg **rmsgs;         /* rmsgs for messages 0 .. n-1 */
+  struct ddsi_tran_recvbuf *bufs; /* buffer descriptors for messages 0 .. n-1 */
+};
+
+/* Upper bound to the number of messages read in one go */
+#define MAX_RECV_BATCH_SIZE 64
+
+static void recv_batch_init (struct recv_batch *batch, const struct ddsi_domaingv *gv)
+{
+  batch->n = (gv->config.recv_batch_size < MAX_RECV_BATCH_SIZE) ? gv->config.recv_batch_size : MAX_RECV_BATCH_SIZE;
+  if (batch->n < 1)
+    batch->n = 1;
+  batch->bufsz = gv->config.rmsg_chunk_size < 65536 ? gv->config.rmsg_chunk_size : 65536;
+  batch->rmsgs = ddsrt_malloc (batch->n * sizeof (*batch->rmsgs));
+  batch->bufs = ddsrt_malloc (batch->n * sizeof (*batch->bufs));
+}
+
+static bool recv_batch_use (const struct recv_batch *batch, const struct ddsi_tran_conn *conn)
+{
+  /* Connections that coalesce messages can only be read using read_multiple,
+     and kernel receive timestamps are only returned by read_multiple */
+  if (conn->m_stream || !ddsi_conn_supports_read_multiple (conn))
+    return false;
+  return batch->n > 1 || conn->m_coalesced_read || conn->m_read_timestamps;
+}
+
+static void recv_batch_fini (struct recv_batch *batch)
+{
+  ddsrt_free (batch->bufs);
+  ddsrt_free (batch->rmsgs);
+}
+
+static bool do_packet_batch (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, struct recv_batch *batch)
+{
+  /* Every message is received directly into an rmsg of its own, just like
+     in do_packet, using a different slot of the receive buffer pool for
+     each so they can all be uncommitted at the same time.  The messages are
+     processed in order, each one getting committed before the next one is
+     processed, and all of them before returning. */
+  uint32_t nrmsgs;
+  ssize_t n;
+
+  assert (!conn->m_stream && ddsi_conn_supports_read_multiple (conn));
+  if ((nrmsgs = nn_rmsg_new_multiple (rbpool, batch->n, batch->rmsgs)) == 0)
+    return false;
+  for (uint32_t i = 0; i < nrmsgs; i++)
   {
-    nn_rmsg_setsize (rmsg, (uint32_t) sz);
-    assert (thread_is_asleep ());
+    batch->bufs[i].buf = (unsigned char *) NN_RMSG_PAYLOAD (batch->rmsgs[i]);
+    batch->bufs[i].len = batch->bufsz;
+  }
+  n = ddsi_conn_read_multiple (conn, nrmsgs, batch->bufs);
+  for (uint32_t i = (n > 0) ? (uint32_t) n : 0; i < nrmsgs; i++)
+    nn_rmsg_commit (batch->rmsgs[i]);
+  if (n <= 0)
+    return false;
 
-    if ((size_t)sz < RTPS_MESSAGE_HEADER_SIZE || *(uint32_t *)buff != NN_PROTOCOLID_AS_UINT32)
-    {
-      /* discard packets that are really too small or don't have magic cookie */
-    }
-    else if (hdr->version.major != RTPS_MAJOR || (hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
-    {
-      if ((hdr->version.major == RTPS_MAJOR && hdr->version.minor < RTPS_MINOR_MINIMUM))
-        GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu\n, version mismatch: %d.%d\n",
-                 PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, hdr->version.major, hdr->version.minor);
-      if (DDSI_SC_PEDANTIC_P (gv->config))
-        malformed_packet_received_nosubmsg (gv, buff, sz, "header", hdr->vendorid);
-    }
+  for (ssize_t i = 0; i < n; i++)
+  {
+    struct ddsi_tran_recvbuf * const rb = &batch->bufs[i];
+    struct nn_rmsg * const rmsg = batch->rmsgs[i];
+    if (rb->sz == 0 || gv->deaf)
+      nn_rmsg_commit (rmsg);
+    else if (rb->segsize > 0)
+      handle_coalesced_rtps_messages (ts1, gv, conn, guidprefix, rbpool, rmsg, rb->sz, rb->segsize, (unsigned char *) NN_RMSG_PAYLOAD (rmsg), &rb->srcloc, rb->timestamp);
     else
-    {
-      hdr->guid_prefix = nn_ntoh_guid_prefix (hdr->guid_prefix);
-
-      if (gv->logconfig.c.mask & DDS_LC_TRACE)
-      {
-        char addrstr[DDSI_LOCSTRLEN];
-        ddsi_locator_to_string(addrstr, sizeof(addrstr), &srcloc);
-        GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %lu from %s\n",
-                 PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, addrstr);
-      }
-      nn_rtps_msg_state_t res = decode_rtps_message (ts1, gv, &rmsg, &hdr, &buff, &sz, rbpool, conn->m_stream);
-      if (res != NN_RTPS_MSG_STATE_ERROR)
-      {
-        handle_submsg_sequence (ts1, gv, conn, &srcloc, ddsrt_time_wallclock (), ddsrt_time_elapsed (), &hdr->guid_prefix, guidprefix, buff, (size_t) sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg, res == NN_RTPS_MSG_STATE_ENCODED);
-      }
-      else
-      {
-        /* drop message */
-        sz = 1;
-      }
-    }
+      handle_rtps_message (ts1, gv, conn, guidprefix, rbpool, rmsg, rb->sz, (unsigned char *) NN_RMSG_PAYLOAD (rmsg), &rb->srcloc, rb->timestamp);
   }
-  nn_rmsg_commit (rmsg);
-  return (sz > 0);
+  return true;
 }
 
 struct local_participant_desc
@@ -3463,12 +3722,13 @@ void trigger_recv_threads (const struct ddsi_domaingv *gv)
     {
       case RTM_SINGLE: {
         char buf[DDSI_LOCSTRLEN];
-        char dummy = 0;
+        /* shards of a port share the locator, the shard index in the message selects the thread */
+        unsigned char dummy = (unsigned char) gv->recv_threads[i].arg.u.single.shard;
         const ddsi_locator_t *dst = gv->recv_threads[i].arg.u.single.loc;
         ddsrt_iovec_t iov;
         iov.iov_base = &dummy;
         iov.iov_len = 1;
-        GVTRACE ("trigger_recv_threads: %"PRIu32" single %s\n", i, ddsi_locator_to_string (buf, sizeof (buf), dst));
+        GVTRACE ("trigger_recv_threads: %"PRIu32" single %s shard %"PRIu32"\n", i, ddsi_locator_to_string (buf, sizeof (buf), dst), gv->recv_threads[i].arg.u.single.shard);
         ddsi_conn_write (gv->xmit_conn, dst, 1, &iov, 0);
         break;
       }
@@ -3489,15 +3749,21 @@ uint32_t recv_thread (void *vrecv_thread_arg)
   struct nn_rbufpool *rbpool = recv_thread_arg->rbpool;
   os_sockWaitset waitset = recv_thread_arg->mode == RTM_MANY ? recv_thread_arg->u.many.ws : NULL;
   ddsrt_mtime_t next_thread_cputime = { 0 };
+  struct recv_batch batch;
+  recv_batch_init (&batch, gv);
 
   nn_rbufpool_setowner (rbpool, ddsrt_thread_self ());
   if (waitset == NULL)
   {
     struct ddsi_tran_conn *conn = recv_thread_arg->u.single.conn;
+    const bool conn_batch = recv_batch_use (&batch, conn);
     while (ddsrt_atomic_ld32 (&gv->rtps_keepgoing))
     {
       LOG_THREAD_CPUTIME (&gv->logconfig, next_thread_cputime);
-      (void) do_packet (ts1, gv, conn, NULL, rbpool);
+      if (conn_batch)
+        (void) do_packet_batch (ts1, gv, conn, NULL, rbpool, &batch);
+      else
+        (void) do_packet (ts1, gv, conn, NULL, rbpool);
     }
   }
   else
@@ -3562,12 +3828,15 @@ uint32_t recv_thread (void *vrecv_thread_arg)
           else
             guid_prefix = &lps.ps[(unsigned)idx - num_fixed].guid_prefix;
           /* Process message and clean out connection if failed or closed */
-          if (!do_packet (ts1, gv, conn, guid_prefix, rbpool) && !conn->m_connless)
+          if (recv_batch_use (&batch, conn))
+            (void) do_packet_batch (ts1, gv, conn, guid_prefix, rbpool, &batch);
+          else if (!do_packet (ts1, gv, conn, guid_prefix, rbpool) && !conn->m_connless)
             ddsi_conn_free (conn);
         }
       }
     }
     local_participant_set_fini (&lps);
   }
+  recv_batch_fini (&batch);
   return 0;
 }
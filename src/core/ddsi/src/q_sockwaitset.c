@@ -27,9 +27,12 @@
 #define MODE_KQUEUE 1
 #define MODE_SELECT 2
 #define MODE_WFMEVS 3
+#define MODE_EPOLL 4
 
 #if defined __APPLE__
 #define MODE_SEL MODE_KQUEUE
+#elif defined __linux && !LWIP_SOCKET
+#define MODE_SEL MODE_EPOLL
 #elif defined WINCE
 #define MODE_SEL MODE_WFMEVS
 #else
@@ -281,6 +284,295 @@ int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, ddsi_tran_conn_t *conn)
   return -1;
 }
 
+#elif MODE_SEL == MODE_EPOLL
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+struct entry {
+  ddsi_tran_conn_t conn;
+  int fd;
+};
+
+struct ready {
+  ddsi_tran_conn_t conn;
+  int index;
+};
+
+struct os_sockWaitsetCtx
+{
+  struct epoll_event *evs;  /* events returned by epoll_wait */
+  struct ready *ready;      /* connections & indices for the events */
+  uint32_t sz;              /* size of evs and ready */
+  uint32_t nevs;            /* number of valid entries in ready */
+  uint32_t index;           /* cursor for enumerating */
+};
+
+struct os_sockWaitset
+{
+  int epoll;
+  int pipe[2];                  /* pipe used for triggering */
+  ddsrt_mutex_t lock;           /* for add/delete */
+  struct entry *entries;        /* entry 0 is the trigger pipe */
+  uint32_t sz;                  /* allocated size of entries */
+  uint32_t n;                   /* number of entries in use */
+  int32_t *fdidx;               /* maps fd to index in entries, or -1 */
+  uint32_t fdidx_sz;            /* size of fdidx */
+  struct os_sockWaitsetCtx ctx; /* set of events being handled */
+};
+
+static int32_t get_fdidx_locked (const struct os_sockWaitset *ws, int fd)
+{
+  return ((uint32_t) fd < ws->fdidx_sz) ? ws->fdidx[fd] : -1;
+}
+
+static void set_fdidx_locked (os_sockWaitset ws, int fd, int32_t idx)
+{
+  assert (fd >= 0);
+  if ((uint32_t) fd >= ws->fdidx_sz)
+  {
+    uint32_t newsz = 2 * ws->fdidx_sz;
+    if (newsz <= (uint32_t) fd)
+      newsz = (uint32_t) fd + 1;
+    ws->fdidx = ddsrt_realloc (ws->fdidx, newsz * sizeof (*ws->fdidx));
+    for (uint32_t i = ws->fdidx_sz; i < newsz; i++)
+      ws->fdidx[i] = -1;
+    ws->fdidx_sz = newsz;
+  }
+  ws->fdidx[fd] = idx;
+}
+
+static int add_entry_locked (os_sockWaitset ws, ddsi_tran_conn_t conn, int fd)
+{
+  struct epoll_event ev;
+  assert (fd >= 0);
+  for (uint32_t idx = 0; idx < ws->n; idx++)
+  {
+    if (ws->entries[idx].conn == conn)
+      return 0;
+  }
+  if (ws->n == ws->sz)
+  {
+    ws->sz += WAITSET_DELTA;
+    ws->entries = ddsrt_realloc (ws->entries, ws->sz * sizeof (*ws->entries));
+  }
+  memset (&ev, 0, sizeof (ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl (ws->epoll, EPOLL_CTL_ADD, fd, &ev) == -1)
+  {
+    DDS_WARNING("os_sockWaitsetAdd: epoll_ctl(ADD,%d) failed, errno = %d\n", fd, errno);
+    return -1;
+  }
+  ws->entries[ws->n].conn = conn;
+  ws->entries[ws->n].fd = fd;
+  set_fdidx_locked (ws, fd, (int32_t) ws->n);
+  ws->n++;
+  return 1;
+}
+
+static void remove_entry_locked (os_sockWaitset ws, uint32_t idx)
+{
+  /* The socket may have been closed already, in which case the kernel has
+     dropped it from the epoll set and the fd may even have been reused for a
+     newer entry; only the most recent entry for an fd owns the registration */
+  const int fd = ws->entries[idx].fd;
+  if (get_fdidx_locked (ws, fd) == (int32_t) idx)
+  {
+    (void) epoll_ctl (ws->epoll, EPOLL_CTL_DEL, fd, NULL);
+    ws->fdidx[fd] = -1;
+  }
+}
+
+os_sockWaitset os_sockWaitsetNew (void)
+{
+  os_sockWaitset ws;
+  if ((ws = ddsrt_malloc (sizeof (*ws))) == NULL)
+    goto fail_waitset;
+  ws->sz = WAITSET_DELTA;
+  ws->n = 0;
+  if ((ws->entries = ddsrt_malloc (ws->sz * sizeof (*ws->entries))) == NULL)
+    goto fail_entries;
+  ws->fdidx_sz = 0;
+  ws->fdidx = NULL;
+  ws->ctx.sz = WAITSET_DELTA;
+  ws->ctx.nevs = 0;
+  ws->ctx.index = 0;
+  if ((ws->ctx.evs = ddsrt_malloc (ws->ctx.sz * sizeof (*ws->ctx.evs))) == NULL)
+    goto fail_ctx_evs;
+  if ((ws->ctx.ready = ddsrt_malloc (ws->ctx.sz * sizeof (*ws->ctx.ready))) == NULL)
+    goto fail_ctx_ready;
+  if ((ws->epoll = epoll_create1 (EPOLL_CLOEXEC)) == -1)
+    goto fail_epoll;
+  if (pipe (ws->pipe) == -1)
+    goto fail_pipe;
+  if (fcntl (ws->pipe[0], F_SETFD, fcntl (ws->pipe[0], F_GETFD) | FD_CLOEXEC) == -1)
+    goto fail_fcntl;
+  if (fcntl (ws->pipe[1], F_SETFD, fcntl (ws->pipe[1], F_GETFD) | FD_CLOEXEC) == -1)
+    goto fail_fcntl;
+  if (add_entry_locked (ws, NULL, ws->pipe[0]) < 0)
+    goto fail_add_trigger;
+  assert (ws->entries[0].fd == ws->pipe[0]);
+  ddsrt_mutex_init (&ws->lock);
+  return ws;
+
+fail_add_trigger:
+  ddsrt_free (ws->fdidx);
+fail_fcntl:
+  close (ws->pipe[0]);
+  close (ws->pipe[1]);
+fail_pipe:
+  close (ws->epoll);
+fail_epoll:
+  ddsrt_free (ws->ctx.ready);
+fail_ctx_ready:
+  ddsrt_free (ws->ctx.evs);
+fail_ctx_evs:
+  ddsrt_free (ws->entries);
+fail_entries:
+  ddsrt_free (ws);
+fail_waitset:
+  return NULL;
+}
+
+void os_sockWaitsetFree (os_sockWaitset ws)
+{
+  ddsrt_mutex_destroy (&ws->lock);
+  close (ws->pipe[0]);
+  close (ws->pipe[1]);
+  close (ws->epoll);
+  ddsrt_free (ws->fdidx);
+  ddsrt_free (ws->entries);
+  ddsrt_free (ws->ctx.ready);
+  ddsrt_free (ws->ctx.evs);
+  ddsrt_free (ws);
+}
+
+void os_sockWaitsetTrigger (os_sockWaitset ws)
+{
+  char buf = 0;
+  int n;
+  n = (int) write (ws->pipe[1], &buf, 1);
+  if (n != 1)
+  {
+    DDS_WARNING("os_sockWaitsetTrigger: write failed on trigger pipe, errno = %d\n", errno);
+  }
+}
+
+int os_sockWaitsetAdd (os_sockWaitset ws, ddsi_tran_conn_t conn)
+{
+  int ret;
+  ddsrt_mutex_lock (&ws->lock);
+  ret = add_entry_locked (ws, conn, ddsi_conn_handle (conn));
+  ddsrt_mutex_unlock (&ws->lock);
+  return ret;
+}
+
+void os_sockWaitsetPurge (os_sockWaitset ws, unsigned index)
+{
+  ddsrt_mutex_lock (&ws->lock);
+  if (index + 1 <= ws->n)
+  {
+    for (uint32_t i = index + 1; i < ws->n; i++)
+      remove_entry_locked (ws, i);
+    ws->n = index + 1;
+  }
+  ddsrt_mutex_unlock (&ws->lock);
+}
+
+void os_sockWaitsetRemove (os_sockWaitset ws, ddsi_tran_conn_t conn)
+{
+  ddsrt_mutex_lock (&ws->lock);
+  for (uint32_t i = 1; i < ws->n; i++)
+  {
+    if (ws->entries[i].conn == conn)
+    {
+      remove_entry_locked (ws, i);
+      ws->n--;
+      if (i != ws->n)
+      {
+        ws->entries[i] = ws->entries[ws->n];
+        if (get_fdidx_locked (ws, ws->entries[i].fd) == (int32_t) ws->n)
+          ws->fdidx[ws->entries[i].fd] = (int32_t) i;
+      }
+      break;
+    }
+  }
+  ddsrt_mutex_unlock (&ws->lock);
+}
+
+os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws)
+{
+  /* as with kqueue, an event array smaller than the number of file descriptors
+     in the epoll set merely means that fewer events get returned at a time;
+     the sockets are level-triggered and so the remainder will show up on the
+     next call */
+  os_sockWaitsetCtx ctx = &ws->ctx;
+  uint32_t ws_n, nready;
+  int nevs;
+
+  ddsrt_mutex_lock (&ws->lock);
+  ws_n = ws->n;
+  ddsrt_mutex_unlock (&ws->lock);
+  if (ctx->sz < ws_n)
+  {
+    ctx->sz = ws_n;
+    ctx->evs = ddsrt_realloc (ctx->evs, ctx->sz * sizeof (*ctx->evs));
+    ctx->ready = ddsrt_realloc (ctx->ready, ctx->sz * sizeof (*ctx->ready));
+  }
+
+  nevs = epoll_wait (ws->epoll, ctx->evs, (int) ctx->sz, -1);
+  if (nevs < 0)
+  {
+    if (errno == EINTR)
+      nevs = 0;
+    else
+    {
+      DDS_WARNING("os_sockWaitsetWait: epoll_wait failed, errno = %d\n", errno);
+      return NULL;
+    }
+  }
+
+  /* Map the file descriptors back to connections and indices while holding
+     the lock, skipping events for anything that got removed in the meantime */
+  nready = 0;
+  ddsrt_mutex_lock (&ws->lock);
+  for (uint32_t i = 0; i < (uint32_t) nevs; i++)
+  {
+    const int fd = ctx->evs[i].data.fd;
+    const int32_t idx = get_fdidx_locked (ws, fd);
+    if (fd == ws->pipe[0])
+    {
+      char buf;
+      if (read (fd, &buf, 1) != 1)
+        DDS_WARNING("os_sockWaitsetWait: read failed on trigger pipe, errno = %d\n", errno);
+    }
+    else if (idx > 0)
+    {
+      ctx->ready[nready].conn = ws->entries[idx].conn;
+      ctx->ready[nready].index = (int) (idx - 1);
+      nready++;
+    }
+  }
+  ddsrt_mutex_unlock (&ws->lock);
+  ctx->nevs = nready;
+  ctx->index = 0;
+  return ctx;
+}
+
+int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, ddsi_tran_conn_t *conn)
+{
+  if (ctx->index < ctx->nevs)
+  {
+    const uint32_t idx = ctx->index++;
+    *conn = ctx->ready[idx].conn;
+    return ctx->ready[idx].index;
+  }
+  return -1;
+}
+
 #elif MODE_SEL == MODE_WFMEVS
 
 struct os_sockWaitsetCtx
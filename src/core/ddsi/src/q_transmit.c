@@ -38,6 +38,7 @@
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_sertype.h"
 #include "dds/ddsi/ddsi_security_omg.h"
+#include "dds/ddsi/ddsi_cdrfilter.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -789,6 +790,127 @@ static void transmit_sample_lgmsg_unlocks_wr (struct nn_xpack *xp, struct writer
   }
 }
 
+bool writer_content_filtered_for_participant (const struct writer *wr, const struct ddsi_guid *prd_guid, const struct ddsi_serdata *serdata)
+{
+  /* A sample can only be withheld from a remote reader if all readers in that
+     participant filter it out: GAPs and data are processed per proxy writer,
+     not per reader, so withholding it from one but sending it to another
+     would either lose it or not save anything */
+  const ddsi_guid_t first = { .prefix = prd_guid->prefix, .entityid = { .u = 0 } };
+  const struct wr_prd_match *m;
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  for (m = ddsrt_avl_lookup_succ_eq (&wr_readers_treedef, &wr->readers, &first);
+       m != NULL && guid_prefix_eq (&m->prd_guid.prefix, &prd_guid->prefix);
+       m = ddsrt_avl_find_succ (&wr_readers_treedef, &wr->readers, m))
+  {
+    if (!m->via_shm && (m->filter == NULL || ddsi_cdrfilter_eval (m->filter, serdata)))
+      return false;
+  }
+  return true;
+}
+
+struct filtered_dst {
+  ddsi_guid_t prd_guid;
+  seqno_t gapstart;
+  bool is_reliable;
+};
+
+static bool transmit_sample_filtered_wrlock_held (struct nn_xpack *xp, struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata)
+{
+  /* on entry and on exit: &wr->e.lock held, but it is released while
+     queueing messages.  Returns false if the sample is to be sent to all
+     readers in the normal way.
+
+     Participants where all readers have a content filter that the sample
+     doesn't pass don't get the sample, the others get it addressed to one
+     of their readers.  A reliable one gets a GAP covering all preceding
+     consecutive filtered samples once a sample is sent to it again, any
+     trailing filtered samples are covered by the GAPs sent in response to
+     an ACKNACK. */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  struct filtered_dst dsts_fixed[8], *dsts = dsts_fixed;
+  struct wr_prd_match *m;
+  ddsrt_avl_iter_t it;
+  uint32_t ndsts = 0;
+  bool all_accept = true, sent = false;
+
+  if (wr->num_readers > sizeof (dsts_fixed) / sizeof (dsts_fixed[0]))
+    dsts = ddsrt_malloc (wr->num_readers * sizeof (*dsts));
+  m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it);
+  while (m != NULL)
+  {
+    if (m->via_shm)
+    {
+      m = ddsrt_avl_iter_next (&it);
+      continue;
+    }
+    /* readers are ordered on GUID, so those of one participant are adjacent */
+    const ddsi_guid_prefix_t prefix = m->prd_guid.prefix;
+    if (writer_content_filtered_for_participant (wr, &m->prd_guid, serdata))
+    {
+      all_accept = false;
+      for (; m != NULL && guid_prefix_eq (&m->prd_guid.prefix, &prefix); m = ddsrt_avl_iter_next (&it))
+      {
+        if (m->is_reliable && m->filter_gapstart == 0)
+          m->filter_gapstart = seq;
+      }
+    }
+    else
+    {
+      dsts[ndsts].prd_guid = m->prd_guid;
+      dsts[ndsts].gapstart = 0;
+      dsts[ndsts].is_reliable = false;
+      for (; m != NULL && guid_prefix_eq (&m->prd_guid.prefix, &prefix); m = ddsrt_avl_iter_next (&it))
+      {
+        if (m->filter_gapstart != 0 && (dsts[ndsts].gapstart == 0 || m->filter_gapstart < dsts[ndsts].gapstart))
+          dsts[ndsts].gapstart = m->filter_gapstart;
+        dsts[ndsts].is_reliable = dsts[ndsts].is_reliable || m->is_reliable;
+        m->filter_gapstart = 0;
+      }
+      ndsts++;
+    }
+  }
+
+  const uint32_t sz = ddsi_serdata_size (serdata);
+  const uint32_t nfrags = (sz == 0) ? 1 : (sz + gv->config.fragment_size - 1) / gv->config.fragment_size;
+  for (uint32_t i = 0; i < ndsts; i++)
+  {
+    struct proxy_reader *prd;
+    if ((dsts[i].gapstart == 0 && all_accept) || (prd = entidx_lookup_proxy_reader_guid (gv->entity_index, &dsts[i].prd_guid)) == NULL)
+      continue;
+    if (dsts[i].gapstart != 0)
+    {
+      struct nn_gap_info gi;
+      struct nn_xmsg *gap;
+      nn_gap_info_init (&gi);
+      gi.gapstart = dsts[i].gapstart;
+      gi.gapend = seq;
+      if ((gap = nn_gap_info_create_gap (wr, prd, &gi)) != NULL)
+      {
+        ddsrt_mutex_unlock (&wr->e.lock);
+        nn_xpack_addmsg (xp, gap, 0);
+        ddsrt_mutex_lock (&wr->e.lock);
+      }
+    }
+    if (!all_accept)
+    {
+      uint32_t nfrags_lim = nfrags;
+      if (dsts[i].is_reliable && sz > wr->init_burst_size_limit)
+        nfrags_lim = (wr->init_burst_size_limit + gv->config.fragment_size - 1) / gv->config.fragment_size;
+      transmit_sample_lgmsg_unlocks_wr (xp, wr, seq, plist, serdata, prd, 1, nfrags, nfrags_lim);
+      sent = true;
+    }
+  }
+  if (dsts != dsts_fixed)
+    ddsrt_free (dsts);
+
+  /* Nothing sent means no retransmit requests can be expected unless it is
+     recorded as transmitted */
+  if (!all_accept && !sent)
+    writer_update_seq_xmit (wr, seq);
+  return !all_accept;
+}
+
 static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr, const struct whc_state *whcst, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew)
 {
   /* on entry: &wr->e.lock held; on exit: lock no longer held */
@@ -800,7 +922,11 @@ static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr,
   assert((wr->heartbeat_xevent != NULL) == (whcst != NULL));
 
   sz = ddsi_serdata_size (serdata);
-  if (sz > gv->config.fragment_size || !isnew || plist != NULL || prd != NULL || q_omg_writer_is_submessage_protected(wr))
+  if (isnew && prd == NULL && wr->num_filtered_readers > 0 && transmit_sample_filtered_wrlock_held (xp, wr, seq, plist, serdata))
+  {
+    /* sent to the readers interested in it */
+  }
+  else if (sz > gv->config.fragment_size || !isnew || plist != NULL || prd != NULL || q_omg_writer_is_submessage_protected(wr))
   {
     assert (wr->init_burst_size_limit <= UINT32_MAX - UINT16_MAX);
     assert (wr->rexmit_burst_size_limit <= UINT32_MAX - UINT16_MAX);
@@ -952,6 +1078,13 @@ static int insert_sample_in_whc (struct writer *wr, seqno_t seq, struct ddsi_pli
       whc_free_deferred_free_list (wr->whc, deferred_free_list);
     }
 #endif
+
+    if (wr->in_whc_budget)
+    {
+      struct whc_state whcst;
+      whc_get_state (wr->whc, &whcst);
+      writer_update_whc_budget (wr, &whcst);
+    }
   }
 
 #ifndef NDEBUG
@@ -970,7 +1103,7 @@ static int insert_sample_in_whc (struct writer *wr, seqno_t seq, struct ddsi_pli
 
 static int writer_may_continue (const struct writer *wr, const struct whc_state *whcst)
 {
-  return (whcst->unacked_bytes <= wr->whc_low && !wr->retransmitting) || (wr->state != WRST_OPERATIONAL);
+  return (whcst->unacked_bytes <= wr->whc_low && !wr->retransmitting && !writer_over_whc_budget (wr, whcst)) || (wr->state != WRST_OPERATIONAL);
 }
 
 static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr)
@@ -1209,8 +1342,26 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
   /* If WHC overfull, block. */
   {
     struct whc_state whcst;
-    whc_get_state(wr->whc, &whcst);
-    if (whcst.unacked_bytes > wr->whc_high)
+    bool over_budget;
+    if (!wr->reliable)
+      whc_get_state(wr->whc, &whcst);
+    else
+    {
+      /* Acknowledged samples of which handle_AckNack postponed the removal
+         must go first, they shouldn't cause the writer to block */
+      struct whc_node *deferred_free_list;
+      (void) remove_pending_acked_messages (wr, &whcst, &deferred_free_list);
+      whc_free_deferred_free_list (wr->whc, deferred_free_list);
+    }
+    over_budget = writer_over_whc_budget (wr, &whcst);
+    if (over_budget && gv->config.whc_budget_policy == DDSI_WHC_BUDGET_SHED)
+    {
+      GVLOG (DDS_LC_THROTTLE, "writer "PGUIDFMT" over WHC budget share, dropping sample (whc %"PRIuSIZE")\n", PGUID (wr->e.guid), whcst.unacked_bytes);
+      ddsrt_mutex_unlock (&wr->e.lock);
+      r = DDS_RETCODE_OUT_OF_RESOURCES;
+      goto drop;
+    }
+    if (whcst.unacked_bytes > wr->whc_high || over_budget)
     {
       dds_return_t ores;
       assert(gc_allowed); /* also see beginning of the function */
@@ -1219,7 +1370,7 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
       else
       {
         maybe_grow_whc (wr);
-        if (whcst.unacked_bytes <= wr->whc_high)
+        if (whcst.unacked_bytes <= wr->whc_high && !over_budget)
           ores = DDS_RETCODE_OK;
         else
           ores = throttle_writer (ts1, xp, wr);
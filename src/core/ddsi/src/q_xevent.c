@@ -720,6 +720,7 @@ static void handle_xevk_heartbeat (struct nn_xpack *xp, struct xevent *ev, ddsrt
   ddsrt_mtime_t t_next;
   int hbansreq = 0;
   struct whc_state whcst;
+  struct whc_node *deferred_free_list;
 
   if ((wr = entidx_lookup_writer_guid (gv->entity_index, &ev->u.heartbeat.wr_guid)) == NULL)
   {
@@ -737,7 +738,7 @@ static void handle_xevk_heartbeat (struct nn_xpack *xp, struct xevent *ev, ddsrt
 
   ddsrt_mutex_lock (&wr->e.lock);
   assert (wr->reliable);
-  whc_get_state(wr->whc, &whcst);
+  (void) remove_pending_acked_messages (wr, &whcst, &deferred_free_list);
   if (!writer_must_have_hb_scheduled (wr, &whcst))
   {
     hbansreq = 1; /* just for trace */
@@ -768,6 +769,7 @@ static void handle_xevk_heartbeat (struct nn_xpack *xp, struct xevent *ev, ddsrt
   (void) resched_xevent_if_earlier (ev, t_next);
   wr->hbcontrol.tsched = t_next;
   ddsrt_mutex_unlock (&wr->e.lock);
+  whc_free_deferred_free_list (wr->whc, deferred_free_list);
 
   /* Can't transmit synchronously with writer lock held: trying to add
      the heartbeat to the xp may cause xp to be sent out, which may
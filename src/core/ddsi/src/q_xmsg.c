@@ -132,6 +132,13 @@ struct nn_xmsg_chain {
   struct nn_xmsg_chain_elem *latest;
 };
 
+/* Limits on segmented packets (see SendSegmentationOffload): the number of
+   segments and the total size are those of Linux' UDP GSO, and at most 1/16th
+   of a segment may be padding */
+#define NN_XPACK_MAX_SEGMENTS 64
+#define NN_XPACK_MAX_SEGMENTED_SIZE 65507
+#define NN_XPACK_MAX_SEGMENT_PAD_FRACTION 16
+
 #ifdef DDS_HAS_BANDWIDTH_LIMITING
 #define NN_BW_UNLIMITED (0)
 
@@ -173,6 +180,14 @@ struct nn_xpack
   bool includes_rexmit;
   struct nn_xmsg_chain included_msgs;
 
+  /* A packet may consist of multiple complete RTPS messages ("segments") if the
+     transport supports segmented sends, all but the last one of exactly segsize
+     bytes, using PAD submessages to make up for differences */
+  uint32_t nsegs;      /* number of completed segments */
+  uint32_t segsize;    /* size of each completed segment */
+  uint32_t seg_start;  /* offset of the current (last) segment */
+  SubmessageHeader_t seg_pad[NN_XPACK_MAX_SEGMENTS];
+
 #ifdef DDS_HAS_BANDWIDTH_LIMITING
   struct nn_bw_limiter limiter;
 #endif
@@ -1071,6 +1086,9 @@ static void nn_xpack_reinit (struct nn_xpack *xp)
   xp->msg_len.length = 0;
   xp->includes_rexmit = false;
   xp->included_msgs.latest = NULL;
+  xp->nsegs = 0;
+  xp->segsize = 0;
+  xp->seg_start = 0;
   xp->maxdelay = DDS_INFINITY;
 #ifdef DDS_HAS_SECURITY
   xp->sec_info.use_rtps_encoding = 0;
@@ -1151,6 +1169,11 @@ static ssize_t nn_xpack_send_rtps(struct nn_xpack * xp, const ddsi_locator_t *lo
   }
   else
 #endif /* DDS_HAS_SECURITY */
+  if (xp->nsegs > 0)
+  {
+    ret = ddsi_conn_write_segmented (xp->conn, loc, xp->niov, xp->iov, xp->call_flags, xp->segsize);
+  }
+  else
   {
     ret = ddsi_conn_write (xp->conn, loc, xp->niov, xp->iov, xp->call_flags);
   }
@@ -1223,6 +1246,69 @@ static void nn_xpack_send1v (const ddsi_locator_t *loc, void * varg)
   (void) nn_xpack_send1 (loc, varg);
 }
 
+/* Upper bound on the number of destinations handed to the transport in a single
+   multi-destination write */
+#define NN_XPACK_MAX_MULTI_DST 64
+
+struct nn_xpack_send_multi_arg {
+  struct nn_xpack *xp;
+  size_t ndst;
+  size_t calls;
+  ddsi_locator_t dsts[NN_XPACK_MAX_MULTI_DST];
+};
+
+static void nn_xpack_send_multi_flush (struct nn_xpack_send_multi_arg *arg)
+{
+  struct nn_xpack * const xp = arg->xp;
+  ssize_t nsent;
+  if (arg->ndst == 0)
+    return;
+  if (arg->ndst == 1)
+    nsent = (ddsi_conn_write (xp->conn, &arg->dsts[0], xp->niov, xp->iov, xp->call_flags) > 0) ? 1 : 0;
+  else
+    nsent = ddsi_conn_write_multiple (xp->conn, arg->ndst, arg->dsts, xp->niov, xp->iov, xp->call_flags);
+  xp->call_flags = 0;
+#ifdef DDS_HAS_BANDWIDTH_LIMITING
+  if (nsent > 0)
+  {
+    nn_bw_limit_sleep_if_needed (xp->gv, &xp->limiter, (ssize_t) xp->msg_len.length * nsent);
+  }
+#else
+  (void) nsent;
+#endif
+  arg->calls += arg->ndst;
+  arg->ndst = 0;
+}
+
+static void nn_xpack_send_multi_add (const ddsi_locator_t *loc, void *varg)
+{
+  struct nn_xpack_send_multi_arg * const arg = varg;
+  struct ddsi_domaingv const * const gv = arg->xp->gv;
+  if (gv->logconfig.c.mask & DDS_LC_TRACE)
+  {
+    char buf[DDSI_LOCSTRLEN];
+    GVTRACE (" %s", ddsi_locator_to_string (buf, sizeof(buf), loc));
+  }
+  arg->dsts[arg->ndst++] = *loc;
+  if (arg->ndst == NN_XPACK_MAX_MULTI_DST)
+    nn_xpack_send_multi_flush (arg);
+}
+
+static bool nn_xpack_can_send_multi (const struct nn_xpack *xp)
+{
+  /* Sending the same packet to multiple destinations in one call is only
+     possible if each destination gets an identical copy: so no random drops
+     and no per-destination encoding */
+  struct ddsi_domaingv const * const gv = xp->gv;
+  if (!ddsi_conn_supports_write_multiple (xp->conn) || gv->mute || gv->config.xmit_lossiness > 0 || xp->nsegs > 0)
+    return false;
+#ifdef DDS_HAS_SECURITY
+  if (xp->sec_info.use_rtps_encoding)
+    return false;
+#endif
+  return true;
+}
+
 static void nn_xpack_send_real (struct nn_xpack *xp)
 {
   struct ddsi_domaingv const * const gv = xp->gv;
@@ -1245,6 +1331,8 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
     {
       GVTRACE (" %p:%lu", (void *) xp->iov[i].iov_base, (unsigned long) xp->iov[i].iov_len);
     }
+    if (xp->nsegs > 0)
+      GVTRACE (" segsize %"PRIu32, xp->segsize);
   }
 
   GVTRACE (" [");
@@ -1261,7 +1349,15 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
     calls = 0;
     if (xp->dstaddr.all.as)
     {
-      calls = addrset_forall_count (xp->dstaddr.all.as, nn_xpack_send1v, xp);
+      if (!nn_xpack_can_send_multi (xp))
+        calls = addrset_forall_count (xp->dstaddr.all.as, nn_xpack_send1v, xp);
+      else
+      {
+        struct nn_xpack_send_multi_arg arg = { .xp = xp, .ndst = 0, .calls = 0 };
+        addrset_forall (xp->dstaddr.all.as, nn_xpack_send_multi_add, &arg);
+        nn_xpack_send_multi_flush (&arg);
+        calls = arg.calls;
+      }
       unref_addrset (xp->dstaddr.all.as);
     }
 
@@ -1430,41 +1526,135 @@ static int nn_xmsg_is_rexmit (const struct nn_xmsg *m)
   return 0;
 }
 
-static int nn_xpack_mayaddmsg (const struct nn_xpack *xp, const struct nn_xmsg *m, const uint32_t flags)
+static uint32_t nn_xpack_max_segment_size (const struct nn_xpack *xp, uint32_t max_msg_size)
+{
+  /* Once a segment has been completed, all others must fit in the same size */
+  return (xp->nsegs > 0) ? xp->segsize : max_msg_size;
+}
+
+static bool nn_xpack_maystartsegment (const struct nn_xpack *xp, const struct nn_xmsg *m, uint32_t max_msg_size, uint32_t payload_size)
+{
+  struct ddsi_domaingv const * const gv = xp->gv;
+  const uint32_t cursize = xp->msg_len.length - xp->seg_start;
+  const uint32_t segsize = (xp->nsegs > 0) ? xp->segsize : cursize;
+  const uint32_t pad = segsize - cursize;
+  size_t newsize;
+
+  /* Queued xpacks share the iovec array and the padding with the xpack they
+     were copied from, so segmenting is restricted to synchronous sending */
+  if (!gv->config.xpack_send_segmented || xp->async_mode || !ddsi_conn_supports_write_segmented (xp->conn))
+    return false;
+#ifdef DDS_HAS_SECURITY
+  if (xp->sec_info.use_rtps_encoding)
+    return false;
+#endif
+  if (segsize > max_msg_size || xp->nsegs + 2 > NN_XPACK_MAX_SEGMENTS)
+    return false;
+  if (pad > segsize / NN_XPACK_MAX_SEGMENT_PAD_FRACTION)
+    return false;
+  /* Padding: header + body, new segment: RTPS header, InfoSRC, InfoDST, submessage */
+  if (xp->niov + 2 + 3 + NN_XMSG_MAX_SUBMESSAGE_IOVECS > NN_XMSG_MAX_MESSAGE_IOVECS)
+    return false;
+
+  /* The new segment starts with an RTPS header with the source of the first
+     segment, followed by whatever nn_xpack_addmsg adds for this message */
+  newsize = sizeof (xp->hdr) + m->sz + payload_size;
+  if (!guid_prefix_eq (&xp->hdr.guid_prefix, &m->data->src.guid_prefix))
+    newsize += sizeof (m->data->src);
+  if (m->dstmode == NN_XMSG_DST_ONE)
+    newsize += sizeof (m->data->dst);
+  if (newsize > segsize)
+    return false;
+  return (xp->nsegs + 1) * (size_t) segsize + newsize <= NN_XPACK_MAX_SEGMENTED_SIZE;
+}
+
+static void nn_xpack_startsegment (struct nn_xpack *xp, size_t *niov, size_t *sz)
+{
+  /* Only called after nn_xpack_maystartsegment, so padding fits in the zero
+     buffer and padding length in octetsToNextHeader */
+  static const unsigned char zeros[NN_XPACK_MAX_SEGMENTED_SIZE / NN_XPACK_MAX_SEGMENT_PAD_FRACTION];
+  const uint32_t cursize = (uint32_t) *sz - xp->seg_start;
+  uint32_t pad;
+
+  if (xp->nsegs == 0)
+    xp->segsize = cursize;
+  assert (cursize <= xp->segsize);
+  pad = xp->segsize - cursize;
+  if (pad > 0)
+  {
+    SubmessageHeader_t * const padhdr = &xp->seg_pad[xp->nsegs];
+    assert (pad >= RTPS_SUBMESSAGE_HEADER_SIZE && pad - RTPS_SUBMESSAGE_HEADER_SIZE <= sizeof (zeros));
+    padhdr->submessageId = SMID_PAD;
+    padhdr->flags = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? SMFLAG_ENDIANNESS : 0);
+    padhdr->octetsToNextHeader = (uint16_t) (pad - RTPS_SUBMESSAGE_HEADER_SIZE);
+    xp->iov[*niov].iov_base = (void *) padhdr;
+    xp->iov[*niov].iov_len = RTPS_SUBMESSAGE_HEADER_SIZE;
+    (*niov)++;
+    if (pad > RTPS_SUBMESSAGE_HEADER_SIZE)
+    {
+      xp->iov[*niov].iov_base = (void *) zeros;
+      xp->iov[*niov].iov_len = (ddsrt_iov_len_t) (pad - RTPS_SUBMESSAGE_HEADER_SIZE);
+      (*niov)++;
+    }
+    *sz += pad;
+  }
+  xp->nsegs++;
+  xp->seg_start = (uint32_t) *sz;
+
+  xp->iov[*niov].iov_base = (void *) &xp->hdr;
+  xp->iov[*niov].iov_len = sizeof (xp->hdr);
+  (*niov)++;
+  *sz += sizeof (xp->hdr);
+  xp->last_src = &xp->hdr.guid_prefix;
+  xp->last_dst = NULL;
+}
+
+enum nn_xpack_mayadd {
+  NN_XPACK_MAYADD_NO,
+  NN_XPACK_MAYADD_YES,
+  NN_XPACK_MAYADD_NEW_SEGMENT
+};
+
+static enum nn_xpack_mayadd nn_xpack_mayaddmsg (const struct nn_xpack *xp, const struct nn_xmsg *m, const uint32_t flags)
 {
   const bool rexmit = xp->includes_rexmit || nn_xmsg_is_rexmit (m);
   const unsigned max_msg_size = rexmit ? xp->gv->config.max_rexmit_msg_size : xp->gv->config.max_msg_size;
   unsigned payload_size;
+  bool new_segment = false;
 
   if (xp->niov == 0)
-    return 1;
+    return NN_XPACK_MAYADD_YES;
   assert (xp->included_msgs.latest != NULL);
   if (xp->niov + NN_XMSG_MAX_SUBMESSAGE_IOVECS > NN_XMSG_MAX_MESSAGE_IOVECS)
-    return 0;
+    return NN_XPACK_MAYADD_NO;
 
   payload_size = m->refd_payload ? (unsigned) m->refd_payload_iov.iov_len : 0;
 
-  /* Check if max message size exceeded */
+  /* Check if max message size exceeded, if so, perhaps it can go into a new segment */
 
-  if (xp->msg_len.length + m->sz + payload_size > max_msg_size)
+  if (xp->msg_len.length - xp->seg_start + m->sz + payload_size > nn_xpack_max_segment_size (xp, max_msg_size))
   {
-    return 0;
+    if (!nn_xpack_maystartsegment (xp, m, max_msg_size, payload_size))
+      return NN_XPACK_MAYADD_NO;
+    new_segment = true;
   }
 
   /* Check if different call semantics */
 
   if (xp->call_flags != flags)
   {
-    return 0;
+    return NN_XPACK_MAYADD_NO;
   }
 
 #ifdef DDS_HAS_SECURITY
   /* Don't mix up encoded and plain rtps messages */
   if (xp->sec_info.use_rtps_encoding != m->sec_info.use_rtps_encoding)
-    return 0;
+    return NN_XPACK_MAYADD_NO;
 #endif
 
-  return addressing_info_eq_onesidederr (xp, m);
+  if (!addressing_info_eq_onesidederr (xp, m))
+    return NN_XPACK_MAYADD_NO;
+  return new_segment ? NN_XPACK_MAYADD_NEW_SEGMENT : NN_XPACK_MAYADD_YES;
 }
 
 int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flags)
@@ -1481,6 +1671,8 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
   int result = 0;
   size_t xpo_niov = 0;
   uint32_t xpo_sz = 0;
+  uint32_t xpo_nsegs = 0, xpo_segsize = 0, xpo_seg_start = 0;
+  enum nn_xpack_mayadd mayadd;
 
   assert (m->kind != NN_XMSG_KIND_DATA_REXMIT || m->kindspecific.data.readerId_off != 0);
 
@@ -1497,11 +1689,12 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
   if (xp->iov == NULL)
     xp->iov = ddsrt_malloc (NN_XMSG_MAX_MESSAGE_IOVECS * sizeof (*xp->iov));
 
-  if (!nn_xpack_mayaddmsg (xp, m, flags))
+  if ((mayadd = nn_xpack_mayaddmsg (xp, m, flags)) == NN_XPACK_MAYADD_NO)
   {
     assert (xp->niov > 0);
     nn_xpack_send (xp, false);
-    assert (nn_xpack_mayaddmsg (xp, m, flags));
+    mayadd = nn_xpack_mayaddmsg (xp, m, flags);
+    assert (mayadd == NN_XPACK_MAYADD_YES);
     result = 1;
   }
 
@@ -1563,6 +1756,13 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
   {
     xpo_niov = xp->niov;
     xpo_sz = xp->msg_len.length;
+    xpo_nsegs = xp->nsegs;
+    xpo_segsize = xp->segsize;
+    xpo_seg_start = xp->seg_start;
+    if (mayadd == NN_XPACK_MAYADD_NEW_SEGMENT)
+    {
+      nn_xpack_startsegment (xp, &niov, &sz);
+    }
     if (!guid_prefix_eq (xp->last_src, &m->data->src.guid_prefix))
     {
       /* If m's source participant differs from that of the source
@@ -1646,13 +1846,16 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
   xp->niov = niov;
 
   const bool rexmit = xp->includes_rexmit || nn_xmsg_is_rexmit (m);
-  const uint32_t max_msg_size = rexmit ? xp->gv->config.max_rexmit_msg_size : xp->gv->config.max_msg_size;
-  if (xpo_niov > 0 && sz > max_msg_size)
+  const uint32_t max_msg_size = nn_xpack_max_segment_size (xp, rexmit ? xp->gv->config.max_rexmit_msg_size : xp->gv->config.max_msg_size);
+  if (xpo_niov > 0 && sz - xp->seg_start > max_msg_size)
   {
     GVTRACE (" => now niov %d sz %"PRIuSIZE" > max_msg_size %"PRIu32", nn_xpack_send niov %d sz %"PRIu32" now\n",
              (int) niov, sz, max_msg_size, (int) xpo_niov, xpo_sz);
     xp->msg_len.length = xpo_sz;
     xp->niov = xpo_niov;
+    xp->nsegs = xpo_nsegs;
+    xp->segsize = xpo_segsize;
+    xp->seg_start = xpo_seg_start;
     nn_xpack_send (xp, false);
     result = nn_xpack_addmsg (xp, m, flags); /* Retry on emptied xp */
   }
@@ -0,0 +1,372 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "CUnit/Test.h"
+
+#define RBUF_SIZE (1024 * 1024)
+#define MAX_RMSG_SIZE (128 * 1024)
+#define PAYLOAD_SIZE 65536
+
+static struct ddsrt_log_cfg logcfg;
+
+static void radmin_init (void)
+{
+  dds_log_cfg_init (&logcfg, 0, DDS_LC_ERROR, stderr, stderr);
+}
+
+static bool check_fill (const unsigned char *p, size_t n, unsigned char v)
+{
+  for (size_t i = 0; i < n; i++)
+    if (p[i] != v)
+      return false;
+  return true;
+}
+
+CU_Test (ddsi_radmin, multiple_uncommitted, .init = radmin_init)
+{
+  struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, RBUF_SIZE, MAX_RMSG_SIZE, 4);
+  struct nn_rmsg *rmsgs[8];
+  unsigned char *extra[4];
+  CU_ASSERT_FATAL (rbp != NULL);
+
+  /* one per slot: asking for more than there are slots yields fewer */
+  const uint32_t n = nn_rmsg_new_multiple (rbp, 8, rmsgs);
+  CU_ASSERT_FATAL (n == 4);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    memset (NN_RMSG_PAYLOAD (rmsgs[i]), (int) i, PAYLOAD_SIZE);
+    nn_rmsg_setsize (rmsgs[i], PAYLOAD_SIZE);
+  }
+
+  /* processing a message may allocate more memory from the rmsg, up to the
+     point where it needs a new chunk; none of that may touch the others */
+  for (uint32_t i = 0; i < n; i++)
+  {
+    for (uint32_t k = 0; k < 3; k++)
+    {
+      extra[i] = nn_rmsg_alloc (rmsgs[i], 32768);
+      CU_ASSERT_FATAL (extra[i] != NULL);
+      memset (extra[i], (int) (0x80 + i), 32768);
+    }
+  }
+  for (uint32_t i = 0; i < n; i++)
+  {
+    CU_ASSERT (check_fill (NN_RMSG_PAYLOAD (rmsgs[i]), PAYLOAD_SIZE, (unsigned char) i));
+    CU_ASSERT (check_fill (extra[i], 32768, (unsigned char) (0x80 + i)));
+  }
+  for (uint32_t i = 0; i < n; i++)
+    nn_rmsg_commit (rmsgs[i]);
+
+  /* all slots are free again */
+  CU_ASSERT (nn_rmsg_new_multiple (rbp, 4, rmsgs) == 4);
+  for (uint32_t i = 0; i < 4; i++)
+    nn_rmsg_commit (rmsgs[i]);
+  nn_rbufpool_free (rbp);
+}
+
+CU_Test (ddsi_radmin, slot_reuse_with_references, .init = radmin_init)
+{
+  struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, RBUF_SIZE, MAX_RMSG_SIZE, 3);
+  struct nn_rmsg *rmsgs[3], *kept;
+  CU_ASSERT_FATAL (rbp != NULL);
+
+  /* an rmsg that is still referenced after committing it must not be
+     overwritten by subsequent rmsgs from the same slot */
+  CU_ASSERT_FATAL (nn_rmsg_new_multiple (rbp, 3, rmsgs) == 3);
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    memset (NN_RMSG_PAYLOAD (rmsgs[i]), (int) i, PAYLOAD_SIZE);
+    nn_rmsg_setsize (rmsgs[i], PAYLOAD_SIZE);
+  }
+  kept = rmsgs[1];
+  CU_ASSERT_FATAL (nn_rmsg_pin (kept));
+  for (uint32_t i = 0; i < 3; i++)
+    nn_rmsg_commit (rmsgs[i]);
+
+  /* enough rounds to fill the rbuf of slot 1 a few times over */
+  for (uint32_t round = 0; round < 3 * RBUF_SIZE / PAYLOAD_SIZE; round++)
+  {
+    CU_ASSERT_FATAL (nn_rmsg_new_multiple (rbp, 3, rmsgs) == 3);
+    for (uint32_t i = 0; i < 3; i++)
+    {
+      CU_ASSERT (rmsgs[i] != kept);
+      memset (NN_RMSG_PAYLOAD (rmsgs[i]), 0xff, PAYLOAD_SIZE);
+      nn_rmsg_setsize (rmsgs[i], PAYLOAD_SIZE);
+    }
+    for (uint32_t i = 0; i < 3; i++)
+      nn_rmsg_commit (rmsgs[i]);
+  }
+  CU_ASSERT (check_fill (NN_RMSG_PAYLOAD (kept), PAYLOAD_SIZE, 1));
+  nn_rmsg_unpin (kept);
+  nn_rbufpool_free (rbp);
+}
+
+CU_Test (ddsi_radmin, single_slot, .init = radmin_init)
+{
+  /* a pool always has at least one slot, nn_rmsg_new uses slot 0 */
+  struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, RBUF_SIZE, MAX_RMSG_SIZE, 0);
+  struct nn_rmsg *rmsgs[2];
+  CU_ASSERT_FATAL (rbp != NULL);
+  CU_ASSERT_FATAL (nn_rmsg_new_multiple (rbp, 2, rmsgs) == 1);
+  nn_rmsg_commit (rmsgs[0]);
+  rmsgs[0] = nn_rmsg_new (rbp);
+  CU_ASSERT_FATAL (rmsgs[0] != NULL);
+  nn_rmsg_commit (rmsgs[0]);
+  nn_rbufpool_free (rbp);
+}
+
+static void deliver_chain (struct nn_rsample_chain *sc)
+{
+  /* what the delivery queue does after processing the samples */
+  struct nn_rsample_chain_elem *sce = sc->first;
+  while (sce)
+  {
+    struct nn_rsample_chain_elem * const next = sce->next;
+    nn_fragchain_unref (sce->fragchain);
+    sce = next;
+  }
+  sc->first = sc->last = NULL;
+}
+
+CU_Test (ddsi_radmin, reorder_dup_first_after_gap, .init = radmin_init)
+{
+  /* A reliable proxy writer without reliable readers gets a gap [1,seq) inserted
+     to force delivery of the first sample it accepts, and that gap is coalesced
+     with the interval of the sample.  The copy of the sample for a reader that is
+     not in sync must still cover just the sample's sequence number, or the
+     reader's reorder admin considers it old and drops it. */
+  struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, RBUF_SIZE, MAX_RMSG_SIZE, 1);
+  struct nn_defrag *defrag = nn_defrag_new (&logcfg, NN_DEFRAG_DROP_OLDEST, 4);
+  struct nn_reorder *reorder = nn_reorder_new (&logcfg, NN_REORDER_MODE_NORMAL, 4, false);
+  struct nn_reorder *reorder_oos = nn_reorder_new (&logcfg, NN_REORDER_MODE_NORMAL, 4, false);
+  struct nn_rsample_chain sc = { NULL, NULL }, sc_oos = { NULL, NULL };
+  struct nn_rsample_info si;
+  int refc_adjust = 0, gap_refc_adjust = 0;
+  nn_reorder_result_t rres;
+  CU_ASSERT_FATAL (rbp != NULL && defrag != NULL && reorder != NULL && reorder_oos != NULL);
+
+  struct nn_rmsg *rmsg = nn_rmsg_new (rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  memset (NN_RMSG_PAYLOAD (rmsg), 0x5a, 64);
+  nn_rmsg_setsize (rmsg, 64);
+  memset (&si, 0, sizeof (si));
+  si.seq = 5;
+  si.size = si.fragsize = 64;
+  struct nn_rdata *rdata = nn_rdata_new (rmsg, 0, 64, 0, 0);
+  CU_ASSERT_FATAL (rdata != NULL);
+  struct nn_rsample *rsample = nn_defrag_rsample (defrag, rdata, &si);
+  CU_ASSERT_FATAL (rsample != NULL);
+  struct nn_rdata *fragchain = nn_rsample_fragchain (rsample);
+
+  /* seq 5 is ahead of the expected seq 1, so it is stored, then the gap
+     [1,5) makes it deliverable */
+  rres = nn_reorder_rsample (&sc, reorder, rsample, &refc_adjust, 0);
+  CU_ASSERT_FATAL (rres == NN_REORDER_ACCEPT);
+  rres = nn_reorder_gap (&sc, reorder, rdata, 1, si.seq, &gap_refc_adjust);
+  CU_ASSERT_FATAL (rres == 1);
+  CU_ASSERT_FATAL (gap_refc_adjust == 0);
+  CU_ASSERT (sc.first->sampleinfo->seq == si.seq);
+  CU_ASSERT (nn_reorder_next_seq (reorder) == si.seq + 1);
+
+  /* the reader that is not in sync expects seq 5 next */
+  nn_reorder_set_next_seq (reorder_oos, si.seq);
+  struct nn_rsample *rsample_dup = nn_reorder_rsample_dup_first (rmsg, rsample);
+  CU_ASSERT_FATAL (rsample_dup != NULL);
+  rres = nn_reorder_rsample (&sc_oos, reorder_oos, rsample_dup, &refc_adjust, 0);
+  CU_ASSERT (rres == 1);
+  if (rres > 0)
+  {
+    CU_ASSERT (sc_oos.first->sampleinfo->seq == si.seq);
+    CU_ASSERT (nn_reorder_next_seq (reorder_oos) == si.seq + 1);
+    deliver_chain (&sc_oos);
+  }
+
+  deliver_chain (&sc);
+  nn_fragchain_adjust_refcount (fragchain, refc_adjust);
+  nn_rmsg_commit (rmsg);
+  nn_reorder_free (reorder_oos);
+  nn_reorder_free (reorder);
+  nn_defrag_free (defrag);
+  nn_rbufpool_free (rbp);
+}
+
+CU_Test (ddsi_radmin, pin_outlives_rbufpool, .init = radmin_init)
+{
+  /* a pinned rmsg may be released after the receive thread is gone */
+  struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, RBUF_SIZE, MAX_RMSG_SIZE, 1);
+  CU_ASSERT_FATAL (rbp != NULL);
+  struct nn_rmsg *rmsg = nn_rmsg_new (rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  memset (NN_RMSG_PAYLOAD (rmsg), 0x5a, PAYLOAD_SIZE);
+  nn_rmsg_setsize (rmsg, PAYLOAD_SIZE);
+  CU_ASSERT_FATAL (nn_rmsg_pin (rmsg));
+  nn_rmsg_commit (rmsg);
+  nn_rbufpool_free (rbp);
+  CU_ASSERT (check_fill (NN_RMSG_PAYLOAD (rmsg), PAYLOAD_SIZE, 0x5a));
+  nn_rmsg_unpin (rmsg);
+}
+
+/* Samples large enough for the serdata to reference the payload in the rmsg */
+#define SER_NVALUES 128
+#define SER_SIZE (4 + SER_NVALUES * 4)
+
+struct ser_sample {
+  uint32_t v[SER_NVALUES];
+};
+
+static struct ddsi_sertype_default *ser_sertype_new (struct serdatapool *serpool)
+{
+  static const uint32_t ops[] = {
+    DDS_OP_ADR | DDS_OP_TYPE_ARR | DDS_OP_SUBTYPE_4BY, 0, SER_NVALUES,
+    DDS_OP_RTS
+  };
+  struct ddsi_sertype_default *st = ddsrt_malloc (sizeof (*st));
+  memset (st, 0, sizeof (*st));
+  ddsi_sertype_init (&st->c, "ddsi_radmin_ser", &ddsi_sertype_ops_default, &ddsi_serdata_ops_cdr_nokey, true);
+  st->native_encoding_identifier = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? CDR_LE : CDR_BE);
+  st->serpool = serpool;
+  st->type.size = sizeof (struct ser_sample);
+  st->type.align = 4;
+  st->type.ops.nops = (uint32_t) (sizeof (ops) / sizeof (ops[0]));
+  st->type.ops.ops = ddsrt_memdup (ops, sizeof (ops));
+  st->opt_size = sizeof (struct ser_sample);
+  st->cdr_align = 4;
+  return st;
+}
+
+static void ser_fill (unsigned char *cdr, uint32_t seed)
+{
+  struct CDRHeader hdr = { .identifier = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? CDR_LE : CDR_BE), .options = 0 };
+  memcpy (cdr, &hdr, sizeof (hdr));
+  for (uint32_t i = 0; i < SER_NVALUES; i++)
+  {
+    const uint32_t v = seed + i;
+    memcpy (cdr + sizeof (hdr) + 4 * i, &v, 4);
+  }
+}
+
+static struct nn_rmsg *ser_rmsg_new (struct nn_rbufpool *rbp, uint32_t seed, struct nn_rdata **rdata)
+{
+  struct nn_rmsg *rmsg = nn_rmsg_new (rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  ser_fill (NN_RMSG_PAYLOAD (rmsg), seed);
+  nn_rmsg_setsize (rmsg, SER_SIZE);
+  *rdata = nn_rdata_new (rmsg, 0, SER_SIZE, 0, 0);
+  CU_ASSERT_FATAL (*rdata != NULL);
+  return rmsg;
+}
+
+static bool ser_references (struct ddsi_serdata *sd, const struct nn_rmsg *rmsg)
+{
+  ddsrt_iovec_t ref;
+  struct ddsi_serdata *sdref = ddsi_serdata_to_ser_ref (sd, 0, SER_SIZE, &ref);
+  const bool result = (ref.iov_base == (void *) NN_RMSG_PAYLOAD (rmsg));
+  ddsi_serdata_to_ser_unref (sdref, &ref);
+  return result;
+}
+
+static bool ser_check (struct ddsi_serdata *sd, uint32_t seed)
+{
+  unsigned char exp[SER_SIZE], buf[SER_SIZE];
+  struct ser_sample sample, exp_sample;
+  ser_fill (exp, seed);
+  memcpy (&exp_sample, exp + 4, sizeof (exp_sample));
+  CU_ASSERT_FATAL (ddsi_serdata_size (sd) == SER_SIZE);
+  ddsi_serdata_to_ser (sd, 0, SER_SIZE, buf);
+  if (!ddsi_serdata_to_sample (sd, &sample, NULL, NULL))
+    return false;
+  return memcmp (buf, exp, SER_SIZE) == 0 && memcmp (&sample, &exp_sample, sizeof (sample)) == 0;
+}
+
+CU_Test (ddsi_radmin, serdata_references_rmsg, .init = radmin_init)
+{
+  struct serdatapool *serpool = ddsi_serdatapool_new ();
+  struct ddsi_sertype_default *st = ser_sertype_new (serpool);
+  struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, RBUF_SIZE, MAX_RMSG_SIZE, 1);
+  struct nn_rdata *rdata;
+  CU_ASSERT_FATAL (rbp != NULL);
+
+  struct nn_rmsg *rmsg = ser_rmsg_new (rbp, 1, &rdata);
+  struct ddsi_serdata *sd = ddsi_serdata_from_ser (&st->c, SDK_DATA, rdata, SER_SIZE);
+  CU_ASSERT_FATAL (sd != NULL);
+  CU_ASSERT (ser_references (sd, rmsg));
+  CU_ASSERT (ser_check (sd, 1));
+  nn_rmsg_commit (rmsg);
+
+  /* the serdata keeps the message alive, also after the pool is gone */
+  nn_rbufpool_free (rbp);
+  CU_ASSERT (ser_check (sd, 1));
+  ddsi_serdata_unref (sd);
+
+  ddsi_sertype_unref (&st->c);
+  ddsi_serdatapool_free (serpool);
+}
+
+CU_Test (ddsi_radmin, pin_limit_copies, .init = radmin_init)
+{
+  /* the smallest possible rbufs hold one of these messages each, so every serdata
+     referencing a message pins another rbuf until the limit is reached, after which
+     the data must be copied */
+  struct serdatapool *serpool = ddsi_serdatapool_new ();
+  struct ddsi_sertype_default *st = ser_sertype_new (serpool);
+  struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, 0, 1024, 1);
+  struct ddsi_serdata *sds[16];
+  struct nn_rdata *rdata;
+  uint32_t n, npinned = 0;
+  CU_ASSERT_FATAL (rbp != NULL);
+
+  for (n = 0; n < 16; n++)
+  {
+    struct nn_rmsg *rmsg = ser_rmsg_new (rbp, n, &rdata);
+    sds[n] = ddsi_serdata_from_ser (&st->c, SDK_DATA, rdata, SER_SIZE);
+    CU_ASSERT_FATAL (sds[n] != NULL);
+    const bool ref = ser_references (sds[n], rmsg);
+    nn_rmsg_commit (rmsg);
+    if (!ref)
+      break;
+    npinned++;
+  }
+  CU_ASSERT_FATAL (n < 16);
+  CU_ASSERT (npinned > 1);
+
+  /* the message of the copied one gets reused for the next message */
+  struct nn_rmsg *rmsg = ser_rmsg_new (rbp, 100, &rdata);
+  struct ddsi_serdata *sd = ddsi_serdata_from_ser (&st->c, SDK_DATA, rdata, SER_SIZE);
+  CU_ASSERT_FATAL (sd != NULL);
+  CU_ASSERT (!ser_references (sd, rmsg));
+  nn_rmsg_commit (rmsg);
+  ddsi_serdata_unref (sd);
+  for (uint32_t i = 0; i <= n; i++)
+    CU_ASSERT (ser_check (sds[i], i));
+
+  /* dropping a reference frees up an rbuf */
+  ddsi_serdata_unref (sds[0]);
+  rmsg = ser_rmsg_new (rbp, 200, &rdata);
+  sd = ddsi_serdata_from_ser (&st->c, SDK_DATA, rdata, SER_SIZE);
+  CU_ASSERT_FATAL (sd != NULL);
+  CU_ASSERT (ser_references (sd, rmsg));
+  CU_ASSERT (ser_check (sd, 200));
+  nn_rmsg_commit (rmsg);
+
+  nn_rbufpool_free (rbp);
+  ddsi_serdata_unref (sd);
+  for (uint32_t i = 1; i <= n; i++)
+    ddsi_serdata_unref (sds[i]);
+  ddsi_sertype_unref (&st->c);
+  ddsi_serdatapool_free (serpool);
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_statistics.h"
+#include "CUnit/Test.h"
+
+/* Largest pooled size class, anything bigger is allocated and freed directly */
+#define MAX_CLASS_SIZE (4u * 1024u * 1024u)
+
+static struct serdatapool *serpool;
+static struct ddsi_sertype_default *sertype;
+static uint64_t exp_hits, exp_misses;
+
+static void serdatapool_init (void)
+{
+  /* sequence<octet>, so that the size of the serialized data is easily controlled */
+  static const uint32_t ops[] = {
+    DDS_OP_ADR | DDS_OP_TYPE_SEQ | DDS_OP_SUBTYPE_1BY, 0,
+    DDS_OP_RTS
+  };
+  serpool = ddsi_serdatapool_new ();
+  sertype = ddsrt_malloc (sizeof (*sertype));
+  memset (sertype, 0, sizeof (*sertype));
+  ddsi_sertype_init (&sertype->c, "ddsi_serdatapool", &ddsi_sertype_ops_default, &ddsi_serdata_ops_cdr_nokey, true);
+  sertype->native_encoding_identifier = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? CDR_LE : CDR_BE);
+  sertype->serpool = serpool;
+  sertype->type.size = sizeof (dds_sequence_t);
+  sertype->type.align = sizeof (void *);
+  sertype->type.ops.nops = (uint32_t) (sizeof (ops) / sizeof (ops[0]));
+  sertype->type.ops.ops = ddsrt_memdup (ops, sizeof (ops));
+  sertype->opt_size = 0;
+  sertype->cdr_align = 4;
+  exp_hits = exp_misses = 0;
+}
+
+static void serdatapool_fini (void)
+{
+  ddsi_sertype_unref (&sertype->c);
+  ddsi_serdatapool_free (serpool);
+}
+
+static bool check_stats (void)
+{
+  uint64_t hits, misses;
+  ddsi_get_serdatapool_stats (serpool, &hits, &misses);
+  return hits == exp_hits && misses == exp_misses;
+}
+
+/* Constructs a serdata from a sequence of n octets received from the network,
+   for which the pool is asked for a buffer of n + 8 bytes */
+static struct ddsi_serdata *from_ser (uint32_t n)
+{
+  const size_t size = 8 + (size_t) n;
+  unsigned char *cdr = ddsrt_malloc (size);
+  struct CDRHeader hdr = { .identifier = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? CDR_LE : CDR_BE), .options = 0 };
+  memcpy (cdr, &hdr, sizeof (hdr));
+  memcpy (cdr + 4, &n, sizeof (n));
+  memset (cdr + 8, (int) (n & 0xff), n);
+  const ddsrt_iovec_t iov = { .iov_base = cdr, .iov_len = (ddsrt_iov_len_t) size };
+  struct ddsi_serdata *sd = ddsi_serdata_from_ser_iov (&sertype->c, SDK_DATA, 1, &iov, size);
+  ddsrt_free (cdr);
+  CU_ASSERT_FATAL (sd != NULL);
+  CU_ASSERT_FATAL (ddsi_serdata_size (sd) == size);
+  return sd;
+}
+
+CU_Test (ddsi_serdatapool, size_class_reuse, .init = serdatapool_init, .fini = serdatapool_fini)
+{
+  struct ddsi_serdata *sd, *sd1;
+
+  /* an empty pool misses, a freed buffer is reused for anything in its size class */
+  sd = from_ser (100);
+  exp_misses++;
+  CU_ASSERT (check_stats ());
+  ddsi_serdata_unref (sd);
+  sd1 = from_ser (200);
+  exp_hits++;
+  CU_ASSERT (check_stats ());
+  CU_ASSERT (sd1 == sd);
+  ddsi_serdata_unref (sd1);
+
+  sd = from_ser (600);
+  exp_misses++;
+  CU_ASSERT (check_stats ());
+  ddsi_serdata_unref (sd);
+  sd1 = from_ser (1000);
+  exp_hits++;
+  CU_ASSERT (check_stats ());
+  CU_ASSERT (sd1 == sd);
+  ddsi_serdata_unref (sd1);
+
+  /* a buffer is only reused for its own class: the pooled ones are too small
+     for this one, and a larger one is not handed out for a smaller request */
+  sd = from_ser (3000);
+  exp_misses++;
+  CU_ASSERT (check_stats ());
+  ddsi_serdata_unref (sd);
+  sd = from_ser (300);
+  exp_misses++;
+  CU_ASSERT (check_stats ());
+  ddsi_serdata_unref (sd);
+}
+
+CU_Test (ddsi_serdatapool, grown_buffer_moves_class, .init = serdatapool_init, .fini = serdatapool_fini)
+{
+  /* serializing a sample without a size hint starts with a buffer from the
+     smallest class, which grows while serializing a large sample; on freeing
+     it the buffer ends up in the largest class it can serve */
+  unsigned char buf[1000];
+  memset (buf, 0x55, sizeof (buf));
+  dds_sequence_t sample = { ._maximum = sizeof (buf), ._length = sizeof (buf), ._buffer = buf, ._release = false };
+  struct ddsi_serdata *sd = ddsi_serdata_from_sample (&sertype->c, SDK_DATA, &sample);
+  CU_ASSERT_FATAL (sd != NULL);
+  CU_ASSERT (ddsi_serdata_size (sd) == 8 + sizeof (buf));
+  exp_misses++;
+  CU_ASSERT (check_stats ());
+  ddsi_serdata_unref (sd);
+
+  /* the smallest class is still empty */
+  struct ddsi_serdata *sd1 = from_ser (100);
+  exp_misses++;
+  CU_ASSERT (check_stats ());
+  CU_ASSERT (sd1 != sd);
+  ddsi_serdata_unref (sd1);
+
+  /* the grown buffer serves a request that needs well over the initial size */
+  sd1 = from_ser (1500);
+  exp_hits++;
+  CU_ASSERT (check_stats ());
+  CU_ASSERT (sd1 == sd);
+  ddsi_serdata_unref (sd1);
+}
+
+CU_Test (ddsi_serdatapool, oversize, .init = serdatapool_init, .fini = serdatapool_fini)
+{
+  /* buffers larger than the largest class are never pooled */
+  for (int i = 0; i < 2; i++)
+  {
+    struct ddsi_serdata *sd = from_ser (MAX_CLASS_SIZE);
+    exp_misses++;
+    CU_ASSERT (check_stats ());
+    ddsi_serdata_unref (sd);
+  }
+
+  /* the largest class itself is */
+  struct ddsi_serdata *sd = from_ser (MAX_CLASS_SIZE - 8);
+  exp_misses++;
+  CU_ASSERT (check_stats ());
+  ddsi_serdata_unref (sd);
+  struct ddsi_serdata *sd1 = from_ser (MAX_CLASS_SIZE - 8);
+  exp_hits++;
+  CU_ASSERT (check_stats ());
+  CU_ASSERT (sd1 == sd);
+  ddsi_serdata_unref (sd1);
+}
+
+CU_Test (ddsi_serdatapool, largest_class_magazine, .init = serdatapool_init, .fini = serdatapool_fini)
+{
+  /* the largest class retains a single entry in the freelist shared by all
+     threads, in addition to the per-thread magazine of one entry: freeing two
+     fills the magazine and then moves it to the shared list, so that both get
+     reused (and a thread other than this one could get one of them) */
+  struct ddsi_serdata *sd[2], *sd1[2];
+  for (int i = 0; i < 2; i++)
+  {
+    sd[i] = from_ser (MAX_CLASS_SIZE - 8);
+    exp_misses++;
+  }
+  CU_ASSERT (check_stats ());
+  for (int i = 0; i < 2; i++)
+    ddsi_serdata_unref (sd[i]);
+  for (int i = 0; i < 2; i++)
+  {
+    sd1[i] = from_ser (MAX_CLASS_SIZE - 8);
+    exp_hits++;
+    CU_ASSERT (check_stats ());
+  }
+  CU_ASSERT ((sd1[0] == sd[0] && sd1[1] == sd[1]) || (sd1[0] == sd[1] && sd1[1] == sd[0]));
+  for (int i = 0; i < 2; i++)
+    ddsi_serdata_unref (sd1[i]);
+}
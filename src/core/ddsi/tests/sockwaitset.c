@@ -0,0 +1,283 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/ddsrt/cdtors.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/q_sockwaitset.h"
+#include "CUnit/Test.h"
+
+/* These exercise the epoll-based implementation: the indices reported for
+   events, the mapping of file descriptors back to connections and what
+   happens when a socket is closed while still in the waitset */
+
+struct fake_conn {
+  struct ddsi_tran_conn c;
+  ddsrt_socket_t sock;
+  struct sockaddr_in addr;
+};
+
+static ddsrt_socket_t tx;
+static os_sockWaitset ws;
+
+static ddsrt_socket_t fake_conn_handle (ddsi_tran_base_t base)
+{
+  return ((struct fake_conn *) base)->sock;
+}
+
+static void open_socket (struct fake_conn *fc)
+{
+  socklen_t addrlen = sizeof (fc->addr);
+  CU_ASSERT_FATAL (ddsrt_socket (&fc->sock, AF_INET, SOCK_DGRAM, 0) == DDS_RETCODE_OK);
+  memset (&fc->addr, 0, sizeof (fc->addr));
+  fc->addr.sin_family = AF_INET;
+  fc->addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  CU_ASSERT_FATAL (ddsrt_bind (fc->sock, (struct sockaddr *) &fc->addr, sizeof (fc->addr)) == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (ddsrt_getsockname (fc->sock, (struct sockaddr *) &fc->addr, &addrlen) == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (ddsrt_setsocknonblocking (fc->sock, true) == DDS_RETCODE_OK);
+}
+
+static void fake_conn_init (struct fake_conn *fc)
+{
+  memset (&fc->c, 0, sizeof (fc->c));
+  fc->c.m_base.m_handle_fn = fake_conn_handle;
+  open_socket (fc);
+}
+
+static void fake_conn_fini (struct fake_conn *fc)
+{
+  if (fc->sock != DDSRT_INVALID_SOCKET)
+    ddsrt_close (fc->sock);
+}
+
+/* Loopback delivers synchronously, so once this returns the socket is readable */
+static void make_readable (struct fake_conn *fc)
+{
+  ddsrt_msghdr_t msg;
+  ddsrt_iovec_t iov;
+  char buf = 0;
+  ssize_t sent = 0;
+  memset (&msg, 0, sizeof (msg));
+  iov.iov_base = &buf;
+  iov.iov_len = 1;
+  msg.msg_name = &fc->addr;
+  msg.msg_namelen = sizeof (fc->addr);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  CU_ASSERT_FATAL (ddsrt_sendmsg (tx, &msg, 0, &sent) == DDS_RETCODE_OK && sent == 1);
+}
+
+static void drain (struct fake_conn *fc)
+{
+  char buf[16];
+  ssize_t rcvd;
+  while (ddsrt_recv (fc->sock, buf, sizeof (buf), 0, &rcvd) == DDS_RETCODE_OK)
+    ;
+}
+
+/* Triggering first means the wait returns immediately with whatever sockets
+   are readable; checks that exactly the connections in "exp" are reported,
+   connection exp[i] with index idx[i] */
+static void check_ready (uint32_t n, struct fake_conn * const *exp, const int *idx)
+{
+  bool seen[64];
+  os_sockWaitsetCtx ctx;
+  struct ddsi_tran_conn *conn;
+  int i;
+  CU_ASSERT_FATAL (n <= sizeof (seen) / sizeof (seen[0]));
+  memset (seen, 0, sizeof (seen));
+  os_sockWaitsetTrigger (ws);
+  ctx = os_sockWaitsetWait (ws);
+  CU_ASSERT_FATAL (ctx != NULL);
+  while ((i = os_sockWaitsetNextEvent (ctx, &conn)) >= 0)
+  {
+    uint32_t k;
+    for (k = 0; k < n; k++)
+      if (conn == &exp[k]->c)
+        break;
+    CU_ASSERT_FATAL (k < n);
+    CU_ASSERT (!seen[k]);
+    CU_ASSERT (i == idx[k]);
+    seen[k] = true;
+  }
+  for (uint32_t k = 0; k < n; k++)
+    CU_ASSERT (seen[k]);
+}
+
+static void sockwaitset_init (void)
+{
+  struct fake_conn txc;
+  ddsrt_init ();
+  open_socket (&txc);
+  tx = txc.sock;
+  ws = os_sockWaitsetNew ();
+  CU_ASSERT_FATAL (ws != NULL);
+}
+
+static void sockwaitset_fini (void)
+{
+  os_sockWaitsetFree (ws);
+  ddsrt_close (tx);
+  ddsrt_fini ();
+}
+
+CU_Test (ddsi_sockwaitset, add_remove, .init = sockwaitset_init, .fini = sockwaitset_fini)
+{
+  struct fake_conn fc[3];
+  for (int i = 0; i < 3; i++)
+  {
+    fake_conn_init (&fc[i]);
+    CU_ASSERT (os_sockWaitsetAdd (ws, &fc[i].c) == 1);
+  }
+  CU_ASSERT (os_sockWaitsetAdd (ws, &fc[1].c) == 0);
+  check_ready (0, NULL, NULL);
+
+  /* indices are in the order of adding */
+  for (int i = 0; i < 3; i++)
+    make_readable (&fc[i]);
+  check_ready (3, (struct fake_conn *[]) { &fc[0], &fc[1], &fc[2] }, (int[]) { 0, 1, 2 });
+
+  /* the last one takes the place of a removed one, and the removed one no
+     longer shows up */
+  os_sockWaitsetRemove (ws, &fc[0].c);
+  check_ready (2, (struct fake_conn *[]) { &fc[2], &fc[1] }, (int[]) { 0, 1 });
+
+  /* only readable ones are reported */
+  drain (&fc[2]);
+  check_ready (1, (struct fake_conn *[]) { &fc[1] }, (int[]) { 1 });
+
+  /* removing something that isn't in the set is harmless */
+  os_sockWaitsetRemove (ws, &fc[0].c);
+  check_ready (1, (struct fake_conn *[]) { &fc[1] }, (int[]) { 1 });
+
+  /* and it can be added again */
+  CU_ASSERT (os_sockWaitsetAdd (ws, &fc[0].c) == 1);
+  check_ready (2, (struct fake_conn *[]) { &fc[1], &fc[0] }, (int[]) { 1, 2 });
+
+  for (int i = 0; i < 3; i++)
+    fake_conn_fini (&fc[i]);
+}
+
+CU_Test (ddsi_sockwaitset, purge, .init = sockwaitset_init, .fini = sockwaitset_fini)
+{
+  struct fake_conn fc[4];
+  for (int i = 0; i < 4; i++)
+  {
+    fake_conn_init (&fc[i]);
+    CU_ASSERT (os_sockWaitsetAdd (ws, &fc[i].c) == 1);
+    make_readable (&fc[i]);
+  }
+
+  /* purging from index 1 keeps only the first */
+  os_sockWaitsetPurge (ws, 1);
+  check_ready (1, (struct fake_conn *[]) { &fc[0] }, (int[]) { 0 });
+
+  /* adding one back gives it the next index */
+  CU_ASSERT (os_sockWaitsetAdd (ws, &fc[2].c) == 1);
+  check_ready (2, (struct fake_conn *[]) { &fc[0], &fc[2] }, (int[]) { 0, 1 });
+
+  /* purging beyond the end does nothing, from index 0 drops everything */
+  os_sockWaitsetPurge (ws, 2);
+  check_ready (2, (struct fake_conn *[]) { &fc[0], &fc[2] }, (int[]) { 0, 1 });
+  os_sockWaitsetPurge (ws, 0);
+  check_ready (0, NULL, NULL);
+
+  for (int i = 0; i < 4; i++)
+    fake_conn_fini (&fc[i]);
+}
+
+CU_Test (ddsi_sockwaitset, many, .init = sockwaitset_init, .fini = sockwaitset_fini)
+{
+  /* well beyond the initial sizes of the entry, event and fd index arrays */
+#define N 40
+  struct fake_conn *fc = ddsrt_malloc (N * sizeof (*fc));
+  struct fake_conn *exp[N];
+  int idx[N];
+  for (int i = 0; i < N; i++)
+  {
+    fake_conn_init (&fc[i]);
+    CU_ASSERT (os_sockWaitsetAdd (ws, &fc[i].c) == 1);
+    make_readable (&fc[i]);
+    exp[i] = &fc[i];
+    idx[i] = i;
+  }
+  check_ready (N, exp, idx);
+
+  /* removing one moves the last one into its place, so removing the first
+     half leaves the second half in the order given by those swaps */
+  struct fake_conn *slot[N];
+  int n = N;
+  for (int i = 0; i < N; i++)
+    slot[i] = &fc[i];
+  for (int i = 0; i < N / 2; i++)
+  {
+    os_sockWaitsetRemove (ws, &fc[i].c);
+    for (int j = 0; j < n; j++)
+    {
+      if (slot[j] == &fc[i])
+      {
+        slot[j] = slot[--n];
+        break;
+      }
+    }
+  }
+  for (int j = 0; j < n; j++)
+  {
+    exp[j] = slot[j];
+    idx[j] = j;
+  }
+  check_ready ((uint32_t) n, exp, idx);
+
+  for (int i = 0; i < N; i++)
+    fake_conn_fini (&fc[i]);
+  ddsrt_free (fc);
+#undef N
+}
+
+CU_Test (ddsi_sockwaitset, fd_reuse_after_close, .init = sockwaitset_init, .fini = sockwaitset_fini)
+{
+  struct fake_conn fc[3];
+  for (int i = 0; i < 2; i++)
+  {
+    fake_conn_init (&fc[i]);
+    CU_ASSERT (os_sockWaitsetAdd (ws, &fc[i].c) == 1);
+  }
+
+  /* closing a socket while it is in the waitset implicitly removes it from
+     the epoll set, and the lowest free fd gets reused for the next one */
+  const ddsrt_socket_t oldsock = fc[0].sock;
+  ddsrt_close (fc[0].sock);
+  fc[0].sock = DDSRT_INVALID_SOCKET;
+  fake_conn_init (&fc[2]);
+  CU_ASSERT_FATAL (fc[2].sock == oldsock);
+
+  /* the new connection gets registered even though the closed one is still
+     in the waitset with the same fd */
+  CU_ASSERT (os_sockWaitsetAdd (ws, &fc[2].c) == 1);
+  make_readable (&fc[1]);
+  make_readable (&fc[2]);
+  check_ready (2, (struct fake_conn *[]) { &fc[1], &fc[2] }, (int[]) { 1, 2 });
+
+  /* removing the closed connection must not deregister the new one; the new
+     one takes its place */
+  os_sockWaitsetRemove (ws, &fc[0].c);
+  check_ready (2, (struct fake_conn *[]) { &fc[2], &fc[1] }, (int[]) { 0, 1 });
+
+  /* removing the new one does deregister it */
+  os_sockWaitsetRemove (ws, &fc[2].c);
+  check_ready (1, (struct fake_conn *[]) { &fc[1] }, (int[]) { 0 });
+
+  for (int i = 0; i < 3; i++)
+    fake_conn_fini (&fc[i]);
+}
@@ -18,6 +18,7 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/process.h"
 #include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/random.h"
 #include "dds/dds.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -28,6 +29,7 @@
 #include "dds/ddsi/q_radmin.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_gc.h"
+#include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds__topic.h"
 #include "dds/ddsc/dds_rhc.h"
@@ -59,6 +61,7 @@ static int wait_gc_cycle_trig;
 /* these are used to get a sufficiently large result buffer when takeing/reading everying */
 #define N_KEYVALS 27
 #define MAX_HIST_DEPTH 4
+#define MAX_BATCH_SIZE 4
 
 static dds_sample_info_t rres_iseq[(MAX_HIST_DEPTH + 1) * N_KEYVALS];
 static RhcTypes_T rres_mseq[sizeof (rres_iseq) / sizeof (rres_iseq[0])];
@@ -167,6 +170,64 @@ static uint64_t store (struct ddsi_tkmap *tkmap, struct dds_rhc *rhc, struct pro
   return iid;
 }
 
+static void store_batch (struct ddsi_tkmap *tkmap, struct dds_rhc *rhc, struct proxy_writer *wr, uint32_t n, struct ddsi_serdata **sds, bool print, bool lifespan_expiry)
+{
+#ifndef DDS_HAS_LIFESPAN
+  DDSRT_UNUSED_ARG (lifespan_expiry);
+#endif
+  /* beware: unrefs sds[0 .. n-1]; the writer info is shared by all samples in the batch */
+  struct ddsi_tkmap_instance *tks[MAX_BATCH_SIZE];
+  struct ddsi_writer_info pwr_info;
+  bool all_data = true;
+  assert (n > 0 && n <= MAX_BATCH_SIZE);
+  thread_state_awake_domain_ok (lookup_thread_state ());
+  for (uint32_t i = 0; i < n; i++)
+  {
+    tks[i] = ddsi_tkmap_lookup_instance_ref (tkmap, sds[i]);
+    if (sds[i]->statusinfo & (NN_STATUSINFO_UNREGISTER | NN_STATUSINFO_DISPOSE))
+      all_data = false;
+    if (print)
+    {
+      RhcTypes_T d;
+      char buf[64];
+      char si_d = (sds[i]->statusinfo & NN_STATUSINFO_DISPOSE) ? 'D' : '.';
+      char si_u = (sds[i]->statusinfo & NN_STATUSINFO_UNREGISTER) ? 'U' : '.';
+      memset (&d, 0, sizeof (d));
+      ddsi_serdata_to_sample (sds[i], &d, NULL, NULL);
+      (void) print_tstamp (buf, sizeof (buf), sds[i]->timestamp.v);
+      if (sds[i]->kind == SDK_KEY)
+        printf ("BATCH %c%c %16"PRIx64" %16"PRIx64" %2"PRId32" %6s %s\n", si_u, si_d, tks[i]->m_iid, wr->e.iid, d.k, "_", buf);
+      else
+        printf ("BATCH %c%c %16"PRIx64" %16"PRIx64" %2"PRId32" %6"PRIu32" %s\n", si_u, si_d, tks[i]->m_iid, wr->e.iid, d.k, d.x, buf);
+      ddsi_sertype_free_sample (sds[i]->type, &d, DDS_FREE_CONTENTS);
+    }
+  }
+  pwr_info.auto_dispose = wr->c.xqos->writer_data_lifecycle.autodispose_unregistered_instances;
+  pwr_info.guid = wr->e.guid;
+  pwr_info.iid = wr->e.iid;
+  pwr_info.ownership_strength = wr->c.xqos->ownership_strength.value;
+#ifdef DDS_HAS_LIFESPAN
+  if (lifespan_expiry && all_data)
+    pwr_info.lifespan_exp = rand_texp();
+  else
+    pwr_info.lifespan_exp = DDSRT_MTIME_NEVER;
+#else
+  (void) all_data;
+#endif
+  /* readers are best-effort or keep-last, neither of which ever rejects a sample */
+  const uint32_t nstored = dds_rhc_store_batch (rhc, &pwr_info, n, sds, tks);
+  if (nstored != n)
+  {
+    printf ("store_batch: stored %"PRIu32" of %"PRIu32"\n", nstored, n);
+    abort ();
+  }
+  for (uint32_t i = 0; i < n; i++)
+    ddsi_tkmap_instance_unref (tkmap, tks[i]);
+  thread_state_asleep (lookup_thread_state ());
+  for (uint32_t i = 0; i < n; i++)
+    ddsi_serdata_unref (sds[i]);
+}
+
 static struct proxy_writer *mkwr (const struct ddsi_domaingv *gv, bool auto_dispose)
 {
   struct proxy_writer *pwr;
@@ -573,8 +634,11 @@ static struct ddsi_domaingv *get_gv (dds_entity_t e)
 
 static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count, dds_entity_t (*create_cond) (dds_entity_t reader, uint32_t mask, dds_querycondition_filter_fn filter), dds_querycondition_filter_fn filter0, dds_querycondition_filter_fn filter1, bool print)
 {
+  /* samples are kept in a ring per instance, a random depth makes it wrap around at
+     varying positions relative to the reads and takes */
+  const int32_t depth = 1 + (int32_t) (ddsrt_prng_random (&prng) % MAX_HIST_DEPTH);
   dds_qos_t *qos = dds_create_qos ();
-  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, MAX_HIST_DEPTH);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, depth);
   dds_qset_destination_order (qos, DDS_DESTINATIONORDER_BY_SOURCE_TIMESTAMP);
 #ifdef DDS_HAS_DEADLINE_MISSED
   dds_qset_deadline (qos, rand_deadline());
@@ -684,7 +748,8 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     [10] = "tkc1",
     [11] = "delwr",
     [12] = "drpxp",
-    [13] = "dlmis"
+    [13] = "dlmis",
+    [14] = "wbat"
   };
   static const uint32_t opfreqs[] = {
     [0]  = 500, /* write */
@@ -705,10 +770,11 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     [12] = 0,   /* drop expired sample */
 #endif
 #ifdef DDS_HAS_DEADLINE_MISSED
-    [13] = 100  /* deadline missed */
+    [13] = 100, /* deadline missed */
 #else
-    [13] = 0    /* drop expired sample */
+    [13] = 0,   /* drop expired sample */
 #endif
+    [14] = 100  /* batch of writes, disposes & unregisters */
   };
   uint32_t opthres[sizeof (opfreqs) / sizeof (opfreqs[0])];
   {
@@ -728,6 +794,7 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
   uint32_t states_seen[2 * 2 * 3][2] = {{ 0 }};
   uint32_t opcount[sizeof (opfreqs) / sizeof (opfreqs[0])] = { 0 };
   int lastprint_pct = 0;
+  printf ("history depth %"PRId32"\n", depth);
   for (int i = 0; i < count; i++)
   {
     const int32_t keyval = (int32_t) (ddsrt_prng_random (&prng) % N_KEYVALS);
@@ -858,6 +925,35 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
 #endif
         break;
       }
+      case 14: {
+        /* a mix of the operations 0 .. 5 on random instances from a single writer, all
+           stored in one go */
+        struct ddsi_serdata *s[MAX_BATCH_SIZE];
+        const uint32_t n = 1 + ddsrt_prng_random (&prng) % MAX_BATCH_SIZE;
+        for (uint32_t j = 0; j < n; j++)
+        {
+          const int32_t kv = (j == 0) ? keyval : (int32_t) (ddsrt_prng_random (&prng) % N_KEYVALS);
+          switch (ddsrt_prng_random (&prng) % 6)
+          {
+            case 0: s[j] = mksample (kv, 0); break;
+            case 1: s[j] = mksample (kv, NN_STATUSINFO_DISPOSE); break;
+            case 2: s[j] = mkkeysample (kv, NN_STATUSINFO_DISPOSE); break;
+            case 3: s[j] = mkkeysample (kv, NN_STATUSINFO_UNREGISTER); break;
+            case 4: s[j] = mkkeysample (kv, NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER); break;
+            default: s[j] = mksample (kv, NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER); break;
+          }
+        }
+        for (size_t k = 0; k < nrd; k++)
+        {
+          struct ddsi_serdata *sk[MAX_BATCH_SIZE];
+          for (uint32_t j = 0; j < n; j++)
+            sk[j] = ddsi_serdata_ref (s[j]);
+          store_batch (tkmap, rhc[k], wr[which], n, sk, print && k == 0, true);
+        }
+        for (uint32_t j = 0; j < n; j++)
+          ddsi_serdata_unref (s[j]);
+        break;
+      }
     }
 
     if ((i % 200) == 0)
@@ -887,6 +983,234 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     fwr (wr[i]);
 }
 
+#define N_STRIPE_WRITERS 4
+
+struct stripe_writer_arg {
+  struct ddsi_tkmap *tkmap;
+  struct dds_rhc *rhc;
+  struct proxy_writer *wr;
+  int count;
+  uint32_t nkeys;
+  int32_t keys[N_KEYVALS];
+  int32_t lastseq[N_KEYVALS];
+  ddsrt_prng_t prng;
+};
+
+struct stripe_taker_arg {
+  struct dds_rhc *rhc;
+  const uint64_t *iids;
+  ddsrt_atomic_uint32_t stop;
+  uint32_t ntaken;
+  int32_t lastseq[N_KEYVALS];
+  ddsrt_prng_t prng;
+  dds_sample_info_t iseq[(MAX_HIST_DEPTH + 1) * N_KEYVALS];
+  RhcTypes_T mseq[(MAX_HIST_DEPTH + 1) * N_KEYVALS];
+  void *ptrs[(MAX_HIST_DEPTH + 1) * N_KEYVALS];
+};
+
+static uint32_t stripe_writer_thread (void *varg)
+{
+  /* writes (and occasionally write-disposes) the instances owned by this writer, with
+     strictly increasing sequence numbers per instance, partly as batches */
+  struct stripe_writer_arg * const arg = varg;
+  int i = 0;
+  while (arg->nkeys > 0 && i < arg->count)
+  {
+    struct ddsi_serdata *sds[MAX_BATCH_SIZE];
+    uint32_t n = 1;
+    if (ddsrt_prng_random (&arg->prng) % 4 == 0)
+      n += ddsrt_prng_random (&arg->prng) % MAX_BATCH_SIZE;
+    for (uint32_t j = 0; j < n; j++)
+    {
+      const int32_t k = arg->keys[ddsrt_prng_random (&arg->prng) % arg->nkeys];
+      RhcTypes_T d = { k, "A", ++arg->lastseq[k], 0, "B" };
+      sds[j] = ddsi_serdata_from_sample (mdtype, SDK_DATA, &d);
+      sds[j]->statusinfo = (ddsrt_prng_random (&arg->prng) % 64 == 0) ? NN_STATUSINFO_DISPOSE : 0;
+      sds[j]->timestamp.v = dds_time ();
+    }
+    if (n == 1)
+      (void) store (arg->tkmap, arg->rhc, arg->wr, sds[0], false, false);
+    else
+      store_batch (arg->tkmap, arg->rhc, arg->wr, n, sds, false, false);
+    i += (int) n;
+  }
+  return 0;
+}
+
+static int32_t stripe_take_check (struct stripe_taker_arg *arg, dds_instance_handle_t handle)
+{
+  /* takes the data of one instance or of all instances and checks that nothing is taken
+     twice or out of order: every instance has a single writer and so the sequence numbers
+     must be strictly increasing */
+  const uint32_t max = handle ? MAX_HIST_DEPTH + 1 : (uint32_t) (sizeof (arg->iseq) / sizeof (arg->iseq[0]));
+  int32_t n;
+  thread_state_awake_domain_ok (lookup_thread_state ());
+  n = dds_rhc_take (arg->rhc, true, arg->ptrs, arg->iseq, max, DDS_ANY_STATE, handle, NULL);
+  thread_state_asleep (lookup_thread_state ());
+  if (n == DDS_RETCODE_PRECONDITION_NOT_MET && handle)
+    return 0;
+  else if (n < 0)
+  {
+    printf ("stripe take %"PRIx64": ERROR %"PRId32"\n", handle, n);
+    abort ();
+  }
+  for (int32_t i = 0; i < n; i++)
+  {
+    const RhcTypes_T *d = &arg->mseq[i];
+    if (handle && arg->iseq[i].instance_handle != handle)
+    {
+      printf ("stripe take %"PRIx64": got instance %"PRIx64"\n", handle, arg->iseq[i].instance_handle);
+      abort ();
+    }
+    if (!arg->iseq[i].valid_data)
+      continue;
+    if (d->k < 0 || d->k >= N_KEYVALS || arg->iseq[i].instance_handle != arg->iids[d->k])
+    {
+      printf ("stripe take %"PRIx64": key %"PRId32" in instance %"PRIx64"\n", handle, d->k, arg->iseq[i].instance_handle);
+      abort ();
+    }
+    if (d->x <= arg->lastseq[d->k])
+    {
+      printf ("stripe take %"PRIx64": key %"PRId32" seq %"PRId32" after %"PRId32"\n", handle, d->k, d->x, arg->lastseq[d->k]);
+      abort ();
+    }
+    arg->lastseq[d->k] = d->x;
+    arg->ntaken++;
+  }
+  return n;
+}
+
+static uint32_t stripe_taker_thread (void *varg)
+{
+  /* mostly takes single instances, which uses the stripe locks if possible, mixed with
+     the occasional take of everything, which always locks the entire RHC */
+  struct stripe_taker_arg * const arg = varg;
+  while (!ddsrt_atomic_ld32 (&arg->stop))
+  {
+    if (ddsrt_prng_random (&arg->prng) % 16 == 0)
+      (void) stripe_take_check (arg, 0);
+    else
+      (void) stripe_take_check (arg, arg->iids[ddsrt_prng_random (&arg->prng) % N_KEYVALS]);
+  }
+  return 0;
+}
+
+static void test_stripes (dds_entity_t pp, dds_entity_t tp, const int count, bool print)
+{
+  /* Concurrent writers on disjoint sets of instances and a concurrent taker on a reader
+     without conditions, deadline, lifespan or resource limits: with lock stripes, this
+     allows storing and taking samples while holding only the locks of the stripes of
+     the instances.  Each writer owns the instances in its own stripes, so that the
+     writers really operate in parallel.  Keep-last with a small depth to also exercise
+     the replacing of the oldest sample in the ring of samples. */
+  struct ddsi_domaingv * const gv = get_gv (pp);
+  struct ddsi_tkmap * const tkmap = gv->m_tkmap;
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, MAX_HIST_DEPTH);
+  dds_entity_t rd = dds_create_reader (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  struct dds_rhc *rhc;
+  {
+    struct dds_entity *x;
+    if (dds_entity_lock (rd, DDS_KIND_READER, &x) < 0)
+      abort ();
+    rhc = ((dds_reader *) x)->m_rhc;
+    dds_entity_unlock (x);
+  }
+
+  /* mirrors the rounding up to a power of two and the mapping of instances to stripes
+     of the RHC */
+  uint32_t nstripes = 0;
+  if (gv->config.rhc_lock_stripes > 0)
+    for (nstripes = 1; nstripes < gv->config.rhc_lock_stripes; nstripes *= 2)
+      ;
+  const uint32_t nwr = (nstripes == 0 || nstripes >= N_STRIPE_WRITERS) ? N_STRIPE_WRITERS : nstripes;
+
+  struct stripe_writer_arg wrarg[N_STRIPE_WRITERS];
+  struct stripe_taker_arg *tkarg = ddsrt_malloc (sizeof (*tkarg));
+  struct ddsi_tkmap_instance *tks[N_KEYVALS];
+  uint64_t iids[N_KEYVALS];
+  memset (wrarg, 0, sizeof (wrarg));
+  memset (tkarg, 0, sizeof (*tkarg));
+  for (uint32_t w = 0; w < nwr; w++)
+  {
+    wrarg[w].tkmap = tkmap;
+    wrarg[w].rhc = rhc;
+    wrarg[w].wr = mkwr (gv, 0);
+    wrarg[w].count = count;
+    ddsrt_prng_init_simple (&wrarg[w].prng, ddsrt_prng_random (&prng));
+  }
+  thread_state_awake_domain_ok (lookup_thread_state ());
+  for (int32_t k = 0; k < N_KEYVALS; k++)
+  {
+    /* holding a reference keeps the instance handle the same throughout the test */
+    struct ddsi_serdata *sd = mkkeysample (k, 0);
+    tks[k] = ddsi_tkmap_lookup_instance_ref (tkmap, sd);
+    ddsi_serdata_unref (sd);
+    iids[k] = tks[k]->m_iid;
+    const uint32_t stripe = (nstripes == 0) ? (uint32_t) k : (uint32_t) (iids[k] ^ (iids[k] >> 32)) & (nstripes - 1);
+    struct stripe_writer_arg * const a = &wrarg[stripe % nwr];
+    a->keys[a->nkeys++] = k;
+  }
+  thread_state_asleep (lookup_thread_state ());
+  if (print)
+  {
+    for (uint32_t w = 0; w < nwr; w++)
+      printf ("stripe writer %"PRIu32": %"PRIu32" instances\n", w, wrarg[w].nkeys);
+  }
+
+  tkarg->rhc = rhc;
+  tkarg->iids = iids;
+  ddsrt_atomic_st32 (&tkarg->stop, 0);
+  ddsrt_prng_init_simple (&tkarg->prng, ddsrt_prng_random (&prng));
+  for (size_t i = 0; i < sizeof (tkarg->ptrs) / sizeof (tkarg->ptrs[0]); i++)
+    tkarg->ptrs[i] = &tkarg->mseq[i];
+
+  struct thread_state1 *wrthr[N_STRIPE_WRITERS], *tkthr;
+  if (create_thread (&tkthr, gv, "stripe_take", stripe_taker_thread, tkarg) != DDS_RETCODE_OK)
+    abort ();
+  for (uint32_t w = 0; w < nwr; w++)
+  {
+    char name[32];
+    snprintf (name, sizeof (name), "stripe_write%"PRIu32, w);
+    if (create_thread (&wrthr[w], gv, name, stripe_writer_thread, &wrarg[w]) != DDS_RETCODE_OK)
+      abort ();
+  }
+  for (uint32_t w = 0; w < nwr; w++)
+    join_thread (wrthr[w]);
+  ddsrt_atomic_st32 (&tkarg->stop, 1);
+  join_thread (tkthr);
+
+  /* the most recent sample of each instance is never pushed out, so once everything
+     has been taken, the last sequence number written must have been seen */
+  while (stripe_take_check (tkarg, 0) > 0)
+    ;
+  for (uint32_t w = 0; w < nwr; w++)
+  {
+    for (uint32_t i = 0; i < wrarg[w].nkeys; i++)
+    {
+      const int32_t k = wrarg[w].keys[i];
+      if (tkarg->lastseq[k] != wrarg[w].lastseq[k])
+      {
+        printf ("stripes: key %"PRId32" last written %"PRId32" last taken %"PRId32"\n", k, wrarg[w].lastseq[k], tkarg->lastseq[k]);
+        abort ();
+      }
+    }
+  }
+  printf ("stripes: %"PRIu32" writers %"PRIu32" stripes taken %"PRIu32"\n", nwr, nstripes, tkarg->ntaken);
+
+  thread_state_awake_domain_ok (lookup_thread_state ());
+  for (int32_t k = 0; k < N_KEYVALS; k++)
+    ddsi_tkmap_instance_unref (tkmap, tks[k]);
+  thread_state_asleep (lookup_thread_state ());
+  for (size_t i = 0; i < sizeof (tkarg->mseq) / sizeof (tkarg->mseq[0]); i++)
+    RhcTypes_T_free (&tkarg->mseq[i], DDS_FREE_CONTENTS);
+  ddsrt_free (tkarg);
+  dds_delete (rd);
+  for (uint32_t w = 0; w < nwr; w++)
+    fwr (wrarg[w].wr);
+}
+
 int main (int argc, char **argv)
 {
   dds_entity_t pp = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
@@ -895,6 +1219,7 @@ int main (int argc, char **argv)
   unsigned seed = 0;
   bool print = false;
   int xchecks = 1;
+  int stripes = 0;
   int first = 0, count = 10000;
 
   ddsrt_mutex_init (&wait_gc_cycle_lock);
@@ -911,9 +1236,11 @@ int main (int argc, char **argv)
   if (argc > 4)
     print = (atoi (argv[4]) != 0);
   if (argc > 5)
-    xchecks = atoi (argv[4]);
+    xchecks = atoi (argv[5]);
+  if (argc > 6)
+    stripes = atoi (argv[6]);
 
-  printf ("prng seed %u first %d count %d print %d xchecks %d\n", seed, first, count, print, xchecks);
+  printf ("prng seed %u first %d count %d print %d xchecks %d stripes %d\n", seed, first, count, print, xchecks, stripes);
   ddsrt_prng_init_simple (&prng, seed);
 
   if (xchecks != 0)
@@ -924,6 +1251,12 @@ int main (int argc, char **argv)
     else
       gv->config.enabled_xchecks = 0u;
   }
+  if (stripes > 0)
+  {
+    /* read at RHC creation, all RHCs are created after this point */
+    struct ddsi_domaingv *gv = get_gv (pp);
+    gv->config.rhc_lock_stripes = (uint32_t) stripes;
+  }
 
   memset (rres_mseq, 0, sizeof (rres_mseq));
   for (size_t i = 0; i < sizeof (rres_iseq) / sizeof(rres_iseq[0]); i++)
@@ -1102,6 +1435,13 @@ int main (int argc, char **argv)
       }
   }
 
+  if (5 >= first)
+  {
+    if (print)
+      printf ("************* 5 *************\n");
+    test_stripes (pp, tp, count, print);
+  }
+
   ddsrt_cond_destroy (&wait_gc_cycle_cond);
   ddsrt_mutex_destroy (&wait_gc_cycle_lock);
 
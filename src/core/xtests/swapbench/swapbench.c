@@ -0,0 +1,197 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/bswap.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds__topic.h"
+
+/* Measures the cost of converting received CDR containing a large sequence of
+   2, 4 or 8-byte primitives into a serdata, once in native byte order and once
+   in the opposite byte order, so that the difference is the cost of swapping
+   the sequence during normalization.  It also times the byte-swapping of the
+   elements by a plain scalar loop and by the ddsrt array functions, and checks
+   that the swapped data deserializes to the original values. */
+
+struct seq_sample {
+  dds_sequence_t s;
+};
+
+#define SEQ_DESC(n) { \
+  .m_size = sizeof (struct seq_sample), \
+  .m_align = sizeof (void *), \
+  .m_flagset = DDS_TOPIC_NO_OPTIMIZE, \
+  .m_nkeys = 0, \
+  .m_typename = "swapbench_seq" #n, \
+  .m_keys = NULL, \
+  .m_nops = 2, \
+  .m_ops = (const uint32_t[]) { \
+    DDS_OP_ADR | DDS_OP_TYPE_SEQ | DDS_OP_SUBTYPE_##n##BY, offsetof (struct seq_sample, s), \
+    DDS_OP_RTS \
+  }, \
+  .m_meta = "" \
+}
+
+static const dds_topic_descriptor_t seq_descs[] = { SEQ_DESC (2), SEQ_DESC (4), SEQ_DESC (8) };
+
+static void scalar_swap (void *buf, uint32_t elemsz, uint32_t n)
+{
+  switch (elemsz)
+  {
+    case 2: { uint16_t *xs = buf; for (uint32_t i = 0; i < n; i++) xs[i] = ddsrt_bswap2u (xs[i]); break; }
+    case 4: { uint32_t *xs = buf; for (uint32_t i = 0; i < n; i++) xs[i] = ddsrt_bswap4u (xs[i]); break; }
+    case 8: { uint64_t *xs = buf; for (uint32_t i = 0; i < n; i++) xs[i] = ddsrt_bswap8u (xs[i]); break; }
+  }
+}
+
+static void array_swap (void *buf, uint32_t elemsz, uint32_t n)
+{
+  switch (elemsz)
+  {
+    case 2: ddsrt_bswap2u_array (buf, buf, n); break;
+    case 4: ddsrt_bswap4u_array (buf, buf, n); break;
+    case 8: ddsrt_bswap8u_array (buf, buf, n); break;
+  }
+}
+
+/* CDR for a sequence of n elements of elemsz bytes with values, in native byte
+   order or byte-swapped; *elems is set to the offset of the elements in the
+   result */
+static unsigned char *make_cdr (uint32_t *size, uint32_t *elems, const void *values, uint32_t elemsz, uint32_t n, bool swap)
+{
+  const bool native_le = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN);
+  *elems = 4 + ((elemsz == 8) ? 8 : 4);
+  *size = *elems + n * elemsz;
+  unsigned char *cdr = ddsrt_malloc (*size);
+  memset (cdr, 0, *elems);
+  cdr[1] = (native_le != swap) ? 1 : 0;
+  const uint32_t len = swap ? ddsrt_bswap4u (n) : n;
+  memcpy (cdr + 4, &len, sizeof (len));
+  memcpy (cdr + *elems, values, n * elemsz);
+  if (swap)
+    scalar_swap (cdr + *elems, elemsz, n);
+  return cdr;
+}
+
+static double time_from_ser (const struct ddsi_sertype *st, void *cdr, uint32_t size, uint32_t iters)
+{
+  const ddsrt_iovec_t iov = { .iov_base = cdr, .iov_len = size };
+  const dds_time_t t0 = dds_time ();
+  for (uint32_t i = 0; i < iters; i++)
+  {
+    struct ddsi_serdata *sd = ddsi_serdata_from_ser_iov (st, SDK_DATA, 1, &iov, size);
+    if (sd == NULL)
+      abort ();
+    ddsi_serdata_unref (sd);
+  }
+  return (double) (dds_time () - t0) / iters;
+}
+
+static double time_swap (void (*swap) (void *buf, uint32_t elemsz, uint32_t n), void *buf, uint32_t elemsz, uint32_t n, uint32_t iters)
+{
+  const dds_time_t t0 = dds_time ();
+  for (uint32_t i = 0; i < iters; i++)
+    swap (buf, elemsz, n);
+  return (double) (dds_time () - t0) / iters;
+}
+
+static bool check_values (const struct ddsi_sertype *st, void *cdr, uint32_t size, const void *values, uint32_t elemsz, uint32_t n)
+{
+  const ddsrt_iovec_t iov = { .iov_base = cdr, .iov_len = size };
+  struct ddsi_serdata *sd = ddsi_serdata_from_ser_iov (st, SDK_DATA, 1, &iov, size);
+  struct seq_sample sample;
+  bool ok;
+  memset (&sample, 0, sizeof (sample));
+  if (sd == NULL || !ddsi_serdata_to_sample (sd, &sample, NULL, NULL))
+    ok = false;
+  else
+    ok = (sample.s._length == n && memcmp (sample.s._buffer, values, n * elemsz) == 0);
+  dds_free (sample.s._buffer);
+  if (sd)
+    ddsi_serdata_unref (sd);
+  return ok;
+}
+
+static const struct ddsi_sertype *get_sertype (dds_entity_t topic)
+{
+  struct dds_topic *tp;
+  const struct ddsi_sertype *st;
+  if (dds_topic_pin (topic, &tp) < 0)
+    abort ();
+  st = tp->m_stype;
+  dds_topic_unpin (tp);
+  return st;
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t n = 65536, iters = 1000;
+  if (argc > 1)
+    n = (uint32_t) atoi (argv[1]);
+  if (argc > 2)
+    iters = (uint32_t) atoi (argv[2]);
+  if (n == 0 || n > (1u << 24) || iters == 0)
+  {
+    fprintf (stderr, "usage: %s [elements [iterations]]\n", argv[0]);
+    return 2;
+  }
+
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  if (pp < 0)
+    abort ();
+
+  bool ok = true;
+  printf ("sequences of %"PRIu32" elements, times in us per operation\n", n);
+  for (size_t k = 0; k < sizeof (seq_descs) / sizeof (seq_descs[0]); k++)
+  {
+    const uint32_t elemsz = 2u << k;
+    const dds_entity_t tp = dds_create_topic (pp, &seq_descs[k], seq_descs[k].m_typename, NULL, NULL);
+    if (tp < 0)
+      abort ();
+    const struct ddsi_sertype *st = get_sertype (tp);
+
+    unsigned char *values = ddsrt_malloc (n * elemsz);
+    for (uint32_t i = 0; i < n * elemsz; i++)
+      values[i] = (unsigned char) (i * 7 + 1);
+
+    uint32_t native_size, swapped_size, native_elems, swapped_elems;
+    unsigned char *native = make_cdr (&native_size, &native_elems, values, elemsz, n, false);
+    unsigned char *swapped = make_cdr (&swapped_size, &swapped_elems, values, elemsz, n, true);
+    if (!check_values (st, native, native_size, values, elemsz, n) || !check_values (st, swapped, swapped_size, values, elemsz, n))
+    {
+      printf ("%"PRIu32"-byte elements: deserialized values differ from the original\n", elemsz);
+      ok = false;
+    }
+
+    /* Swapping an even number of times leaves the buffer as it was */
+    const double tnative = time_from_ser (st, native, native_size, iters);
+    const double tswapped = time_from_ser (st, swapped, swapped_size, iters);
+    const double tscalar = time_swap (scalar_swap, swapped + swapped_elems, elemsz, n, 2 * iters);
+    const double tarray = time_swap (array_swap, swapped + swapped_elems, elemsz, n, 2 * iters);
+    printf ("%"PRIu32"-byte normalize: native %9.2f swapped %9.2f | swap: scalar %9.2f array %9.2f speedup %.2f\n",
+            elemsz, tnative / 1e3, tswapped / 1e3, tscalar / 1e3, tarray / 1e3, tscalar / tarray);
+
+    ddsrt_free (native);
+    ddsrt_free (swapped);
+    ddsrt_free (values);
+  }
+
+  dds_delete (pp);
+  return ok ? 0 : 1;
+}
@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "dds/export.h"
 #include "dds/ddsrt/endian.h"
 
 #if defined (__cplusplus)
@@ -59,6 +60,14 @@ inline int64_t ddsrt_bswap8 (int64_t x)
   return (int64_t) ddsrt_bswap8u ((uint64_t) x);
 }
 
+/* Byte-swap arrays of n 2, 4 or 8-byte values from src into dst.  Source and
+   destination may be the same array to swap in place, but must not overlap
+   otherwise.  These use SIMD instructions (SSE2, AVX2 or NEON) where the CPU
+   supports them, which is determined once, on first use. */
+DDS_EXPORT void ddsrt_bswap2u_array (uint16_t *dst, const uint16_t *src, size_t n);
+DDS_EXPORT void ddsrt_bswap4u_array (uint32_t *dst, const uint32_t *src, size_t n);
+DDS_EXPORT void ddsrt_bswap8u_array (uint64_t *dst, const uint64_t *src, size_t n);
+
 #if DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN
 #define ddsrt_toBE2(x) ddsrt_bswap2 (x)
 #define ddsrt_toBE2u(x) ddsrt_bswap2u (x)
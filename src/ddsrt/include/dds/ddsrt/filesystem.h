@@ -23,6 +23,7 @@
 #define DDSRT_HAVE_FILESYSTEM (1)
 #else
 #define DDSRT_HAVE_FILESYSTEM (0)
+#define DDSRT_HAVE_FILE_MMAP 0
 #endif
 
 #if DDSRT_HAVE_FILESYSTEM
@@ -23,6 +23,9 @@ typedef mode_t ddsrt_mode_t;
 #define DDSRT_PATH_MAX PATH_MAX
 #define DDSRT_FILESEPCHAR '/'
 
+/* Files can be memory-mapped (mmap) and locked (flock) */
+#define DDSRT_HAVE_FILE_MMAP 1
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
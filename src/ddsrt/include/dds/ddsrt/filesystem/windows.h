@@ -23,6 +23,8 @@ typedef unsigned short ddsrt_mode_t;
 #define DDSRT_PATH_MAX MAX_PATH
 #define DDSRT_FILESEPCHAR '\\'
 
+#define DDSRT_HAVE_FILE_MMAP 0
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -109,6 +109,64 @@ ddsrt_recvmsg(
   int flags,
   ssize_t *rcvd);
 
+#if DDSRT_HAVE_RECVMMSG || DDSRT_HAVE_SENDMMSG
+/* Layout-compatible with struct mmsghdr, which is not always visible */
+typedef struct ddsrt_mmsghdr {
+  ddsrt_msghdr_t msg_hdr;
+  unsigned int msg_len;
+} ddsrt_mmsghdr_t;
+#endif
+
+#if DDSRT_HAVE_SENDMMSG
+/**
+ * @brief Send multiple messages on a socket in a single call.
+ *
+ * Sending stops at the first message that fails, the number of messages
+ * sent before it is returned in @nsent.  An error is only returned if the
+ * first message could not be sent.
+ *
+ * @param[in]  sock    Socket to send on.
+ * @param[in]  msgvec  Array of message headers to send.
+ * @param[in]  vlen    Number of entries in @msgvec.
+ * @param[in]  flags   Flags as for ddsrt_sendmsg.
+ * @param[out] nsent   Number of messages sent.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ */
+DDS_EXPORT dds_return_t
+ddsrt_sendmmsg(
+  ddsrt_socket_t sock,
+  ddsrt_mmsghdr_t *msgvec,
+  uint32_t vlen,
+  int flags,
+  uint32_t *nsent);
+#endif
+
+#if DDSRT_HAVE_RECVMMSG
+/**
+ * @brief Receive multiple messages from a socket in a single call.
+ *
+ * Blocks until at least one message is available (unless the socket is
+ * non-blocking), then returns as many of the messages already queued as
+ * fit in @msgvec without blocking again.
+ *
+ * @param[in]  sock    Socket to receive from.
+ * @param[in]  msgvec  Array of message headers to receive into.
+ * @param[in]  vlen    Number of entries in @msgvec.
+ * @param[in]  flags   Flags as for ddsrt_recvmsg.
+ * @param[out] nrcvd   Number of messages received.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ */
+DDS_EXPORT dds_return_t
+ddsrt_recvmmsg(
+  ddsrt_socket_t sock,
+  ddsrt_mmsghdr_t *msgvec,
+  uint32_t vlen,
+  int flags,
+  uint32_t *nrcvd);
+#endif
+
 DDS_EXPORT dds_return_t
 ddsrt_getsockopt(
   ddsrt_socket_t sock,
@@ -22,6 +22,9 @@
 #include <stddef.h>
 #include <sys/types.h>
 #include <sys/select.h>
+#if defined(__linux)
+#include <netinet/udp.h>
+#endif
 #endif
 
 #include "dds/ddsrt/iovec.h"
@@ -76,6 +79,63 @@ typedef struct msghdr ddsrt_msghdr_t;
 # define DDSRT_MSGHDR_FLAGS 1
 #endif
 
+#if defined(__linux) && !LWIP_SOCKET
+# define DDSRT_HAVE_RECVMMSG 1
+# define DDSRT_HAVE_SENDMMSG 1
+#else
+# define DDSRT_HAVE_RECVMMSG 0
+# define DDSRT_HAVE_SENDMMSG 0
+#endif
+
+/* UDP generic segmentation offload: a single send of a buffer consisting of
+   equal-sized segments that the kernel (or NIC) turns into one datagram per
+   segment */
+#if defined(__linux) && !LWIP_SOCKET && defined(UDP_SEGMENT)
+# define DDSRT_HAVE_UDP_SEGMENT 1
+#else
+# define DDSRT_HAVE_UDP_SEGMENT 0
+#endif
+
+/* UDP generic receive offload: the kernel may return multiple consecutive
+   equal-sized datagrams from the same source as a single buffer */
+#if defined(__linux) && !LWIP_SOCKET && defined(UDP_GRO)
+# define DDSRT_HAVE_UDP_GRO 1
+#else
+# define DDSRT_HAVE_UDP_GRO 0
+#endif
+
+/* Kernel receive timestamps with nanosecond resolution, returned as a control
+   message with each datagram */
+#if defined(__linux) && !LWIP_SOCKET && defined(SO_TIMESTAMPNS)
+# define DDSRT_HAVE_SO_TIMESTAMPNS 1
+#else
+# define DDSRT_HAVE_SO_TIMESTAMPNS 0
+#endif
+
+/* Sockets bound to the same port with SO_REUSEPORT, with a classic BPF
+   program selecting the socket that receives a datagram */
+#if defined(__linux) && !LWIP_SOCKET && defined(SO_REUSEPORT) && defined(SO_ATTACH_REUSEPORT_CBPF)
+# define DDSRT_HAVE_REUSEPORT_CBPF 1
+#else
+# define DDSRT_HAVE_REUSEPORT_CBPF 0
+#endif
+
+/* AF_XDP sockets receiving frames redirected by an XDP program into a
+   memory region shared with the kernel */
+#if defined(__linux) && !LWIP_SOCKET && defined(AF_XDP) && defined(SOL_XDP)
+# define DDSRT_HAVE_AF_XDP 1
+#else
+# define DDSRT_HAVE_AF_XDP 0
+#endif
+
+/* POSIX shared memory segments with datagrams on abstract AF_UNIX sockets
+   to notify the processes mapping them */
+#if defined(__linux) && !LWIP_SOCKET && defined(AF_UNIX)
+# define DDSRT_HAVE_SHM 1
+#else
+# define DDSRT_HAVE_SHM 0
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
@@ -49,6 +49,14 @@ typedef struct ddsrt_msghdr {
 } ddsrt_msghdr_t;
 
 #define DDSRT_MSGHDR_FLAGS 1
+#define DDSRT_HAVE_RECVMMSG 0
+#define DDSRT_HAVE_SENDMMSG 0
+#define DDSRT_HAVE_UDP_SEGMENT 0
+#define DDSRT_HAVE_UDP_GRO 0
+#define DDSRT_HAVE_SO_TIMESTAMPNS 0
+#define DDSRT_HAVE_REUSEPORT_CBPF 0
+#define DDSRT_HAVE_AF_XDP 0
+#define DDSRT_HAVE_SHM 0
 
 #if defined(__cplusplus)
 }
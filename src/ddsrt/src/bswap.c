@@ -9,6 +9,9 @@
  *
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
+#include <stddef.h>
+
+#include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/bswap.h"
 
 extern inline uint16_t ddsrt_bswap2u (uint16_t x);
@@ -17,3 +20,218 @@ extern inline uint64_t ddsrt_bswap8u (uint64_t x);
 extern inline int16_t ddsrt_bswap2 (int16_t x);
 extern inline int32_t ddsrt_bswap4 (int32_t x);
 extern inline int64_t ddsrt_bswap8 (int64_t x);
+
+/* Array swapping kernels: each handles as many elements as fit in whole vectors
+   and returns the number of elements it swapped, the remainder is left to the
+   scalar loop in the public functions.  SSE2 is part of the x86-64 baseline and
+   NEON of AArch64, AVX2 is used only if the CPU turns out to support it. */
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__) && defined __SSE2__
+#define BSWAP_SSE2 1
+#define BSWAP_AVX2 1
+#include <immintrin.h>
+#elif defined _MSC_VER && (defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2))
+#define BSWAP_SSE2 1
+#include <emmintrin.h>
+#elif defined __ARM_NEON
+#define BSWAP_NEON 1
+#include <arm_neon.h>
+#endif
+
+struct bswap_kernels {
+  size_t (*swap2) (uint16_t *dst, const uint16_t *src, size_t n);
+  size_t (*swap4) (uint32_t *dst, const uint32_t *src, size_t n);
+  size_t (*swap8) (uint64_t *dst, const uint64_t *src, size_t n);
+};
+
+#ifdef BSWAP_SSE2
+static __m128i bswap_sse2_16 (__m128i x)
+{
+  return _mm_or_si128 (_mm_slli_epi16 (x, 8), _mm_srli_epi16 (x, 8));
+}
+
+static size_t bswap2_sse2 (uint16_t *dst, const uint16_t *src, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 8 <= n; i += 8)
+  {
+    const __m128i x = _mm_loadu_si128 ((const __m128i *) (src + i));
+    _mm_storeu_si128 ((__m128i *) (dst + i), bswap_sse2_16 (x));
+  }
+  return i;
+}
+
+static size_t bswap4_sse2 (uint32_t *dst, const uint32_t *src, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 4 <= n; i += 4)
+  {
+    __m128i x = _mm_loadu_si128 ((const __m128i *) (src + i));
+    x = _mm_shufflelo_epi16 (x, _MM_SHUFFLE (2, 3, 0, 1));
+    x = _mm_shufflehi_epi16 (x, _MM_SHUFFLE (2, 3, 0, 1));
+    _mm_storeu_si128 ((__m128i *) (dst + i), bswap_sse2_16 (x));
+  }
+  return i;
+}
+
+static size_t bswap8_sse2 (uint64_t *dst, const uint64_t *src, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 2 <= n; i += 2)
+  {
+    __m128i x = _mm_loadu_si128 ((const __m128i *) (src + i));
+    x = _mm_shufflelo_epi16 (x, _MM_SHUFFLE (0, 1, 2, 3));
+    x = _mm_shufflehi_epi16 (x, _MM_SHUFFLE (0, 1, 2, 3));
+    _mm_storeu_si128 ((__m128i *) (dst + i), bswap_sse2_16 (x));
+  }
+  return i;
+}
+
+static const struct bswap_kernels bswap_kernels_sse2 = { bswap2_sse2, bswap4_sse2, bswap8_sse2 };
+#endif
+
+#ifdef BSWAP_AVX2
+/* Reverses the bytes in each elemsz-byte element of nbytes bytes, returns the
+   number of bytes done; the byte shuffle operates on 16-byte lanes, so the
+   same index pattern is used for both halves of the register */
+static __attribute__ ((target ("avx2"))) size_t bswap_avx2 (unsigned char *dst, const unsigned char *src, size_t nbytes, size_t elemsz)
+{
+  const __m256i mask = _mm256_xor_si256 (
+    _mm256_setr_epi8 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+    _mm256_set1_epi8 ((char) (elemsz - 1)));
+  size_t i;
+  for (i = 0; i + 64 <= nbytes; i += 64)
+  {
+    const __m256i x0 = _mm256_loadu_si256 ((const __m256i *) (src + i));
+    const __m256i x1 = _mm256_loadu_si256 ((const __m256i *) (src + i + 32));
+    _mm256_storeu_si256 ((__m256i *) (dst + i), _mm256_shuffle_epi8 (x0, mask));
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 32), _mm256_shuffle_epi8 (x1, mask));
+  }
+  if (i + 32 <= nbytes)
+  {
+    const __m256i x = _mm256_loadu_si256 ((const __m256i *) (src + i));
+    _mm256_storeu_si256 ((__m256i *) (dst + i), _mm256_shuffle_epi8 (x, mask));
+    i += 32;
+  }
+  return i;
+}
+
+static size_t bswap2_avx2 (uint16_t *dst, const uint16_t *src, size_t n)
+{
+  return bswap_avx2 ((unsigned char *) dst, (const unsigned char *) src, 2 * n, 2) / 2;
+}
+
+static size_t bswap4_avx2 (uint32_t *dst, const uint32_t *src, size_t n)
+{
+  return bswap_avx2 ((unsigned char *) dst, (const unsigned char *) src, 4 * n, 4) / 4;
+}
+
+static size_t bswap8_avx2 (uint64_t *dst, const uint64_t *src, size_t n)
+{
+  return bswap_avx2 ((unsigned char *) dst, (const unsigned char *) src, 8 * n, 8) / 8;
+}
+
+static const struct bswap_kernels bswap_kernels_avx2 = { bswap2_avx2, bswap4_avx2, bswap8_avx2 };
+#endif
+
+#ifdef BSWAP_NEON
+static size_t bswap2_neon (uint16_t *dst, const uint16_t *src, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 8 <= n; i += 8)
+    vst1q_u8 ((uint8_t *) (dst + i), vrev16q_u8 (vld1q_u8 ((const uint8_t *) (src + i))));
+  return i;
+}
+
+static size_t bswap4_neon (uint32_t *dst, const uint32_t *src, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 4 <= n; i += 4)
+    vst1q_u8 ((uint8_t *) (dst + i), vrev32q_u8 (vld1q_u8 ((const uint8_t *) (src + i))));
+  return i;
+}
+
+static size_t bswap8_neon (uint64_t *dst, const uint64_t *src, size_t n)
+{
+  size_t i;
+  for (i = 0; i + 2 <= n; i += 2)
+    vst1q_u8 ((uint8_t *) (dst + i), vrev64q_u8 (vld1q_u8 ((const uint8_t *) (src + i))));
+  return i;
+}
+
+static const struct bswap_kernels bswap_kernels_neon = { bswap2_neon, bswap4_neon, bswap8_neon };
+#endif
+
+#if !(defined BSWAP_SSE2 || defined BSWAP_NEON)
+static size_t bswap2_none (uint16_t *dst, const uint16_t *src, size_t n)
+{
+  (void) dst; (void) src; (void) n;
+  return 0;
+}
+
+static size_t bswap4_none (uint32_t *dst, const uint32_t *src, size_t n)
+{
+  (void) dst; (void) src; (void) n;
+  return 0;
+}
+
+static size_t bswap8_none (uint64_t *dst, const uint64_t *src, size_t n)
+{
+  (void) dst; (void) src; (void) n;
+  return 0;
+}
+
+static const struct bswap_kernels bswap_kernels_none = { bswap2_none, bswap4_none, bswap8_none };
+#endif
+
+static const struct bswap_kernels *bswap_select_kernels (void)
+{
+#ifdef BSWAP_AVX2
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    return &bswap_kernels_avx2;
+#endif
+#ifdef BSWAP_SSE2
+  return &bswap_kernels_sse2;
+#elif defined BSWAP_NEON
+  return &bswap_kernels_neon;
+#else
+  return &bswap_kernels_none;
+#endif
+}
+
+static ddsrt_atomic_voidp_t bswap_kernels = DDSRT_ATOMIC_VOIDP_INIT (0);
+
+static const struct bswap_kernels *bswap_get_kernels (void)
+{
+  const struct bswap_kernels *ks = ddsrt_atomic_ldvoidp (&bswap_kernels);
+  if (ks == NULL)
+  {
+    /* Threads racing to get here all select the same kernels */
+    ks = bswap_select_kernels ();
+    ddsrt_atomic_stvoidp (&bswap_kernels, (void *) ks);
+  }
+  return ks;
+}
+
+/* Below 16 bytes no vector instruction would be used */
+void ddsrt_bswap2u_array (uint16_t *dst, const uint16_t *src, size_t n)
+{
+  size_t i = (n >= 8) ? bswap_get_kernels ()->swap2 (dst, src, n) : 0;
+  for (; i < n; i++)
+    dst[i] = ddsrt_bswap2u (src[i]);
+}
+
+void ddsrt_bswap4u_array (uint32_t *dst, const uint32_t *src, size_t n)
+{
+  size_t i = (n >= 4) ? bswap_get_kernels ()->swap4 (dst, src, n) : 0;
+  for (; i < n; i++)
+    dst[i] = ddsrt_bswap4u (src[i]);
+}
+
+void ddsrt_bswap8u_array (uint64_t *dst, const uint64_t *src, size_t n)
+{
+  size_t i = (n >= 2) ? bswap_get_kernels ()->swap8 (dst, src, n) : 0;
+  for (; i < n; i++)
+    dst[i] = ddsrt_bswap8u (src[i]);
+}
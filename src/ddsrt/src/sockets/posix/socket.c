@@ -9,7 +9,9 @@
  *
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
+#define _GNU_SOURCE /* Required for recvmmsg and sendmmsg. */
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -461,6 +463,32 @@ ddsrt_recvmsg(
   return recv_error_to_retcode(errno);
 }
 
+#if DDSRT_HAVE_RECVMMSG || DDSRT_HAVE_SENDMMSG
+DDSRT_STATIC_ASSERT(sizeof(ddsrt_mmsghdr_t) == sizeof(struct mmsghdr) &&
+                    offsetof(ddsrt_mmsghdr_t, msg_len) == offsetof(struct mmsghdr, msg_len));
+#endif
+
+#if DDSRT_HAVE_RECVMMSG
+dds_return_t
+ddsrt_recvmmsg(
+  ddsrt_socket_t sock,
+  ddsrt_mmsghdr_t *msgvec,
+  uint32_t vlen,
+  int flags,
+  uint32_t *nrcvd)
+{
+  int n;
+
+  if ((n = recvmmsg(sock, (struct mmsghdr *) msgvec, vlen, flags | MSG_WAITFORONE, NULL)) != -1) {
+    assert(n >= 0);
+    *nrcvd = (uint32_t) n;
+    return DDS_RETCODE_OK;
+  }
+
+  return recv_error_to_retcode(errno);
+}
+#endif
+
 static inline dds_return_t
 send_error_to_retcode(int errnum)
 {
@@ -541,6 +569,27 @@ ddsrt_sendmsg(
   return send_error_to_retcode(errno);
 }
 
+#if DDSRT_HAVE_SENDMMSG
+dds_return_t
+ddsrt_sendmmsg(
+  ddsrt_socket_t sock,
+  ddsrt_mmsghdr_t *msgvec,
+  uint32_t vlen,
+  int flags,
+  uint32_t *nsent)
+{
+  int n;
+
+  if ((n = sendmmsg(sock, (struct mmsghdr *) msgvec, vlen, flags)) != -1) {
+    assert(n >= 0);
+    *nsent = (uint32_t) n;
+    return DDS_RETCODE_OK;
+  }
+
+  return send_error_to_retcode(errno);
+}
+#endif
+
 dds_return_t
 ddsrt_select(
   int32_t nfds,
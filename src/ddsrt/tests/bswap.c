@@ -0,0 +1,89 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/bswap.h"
+
+/* Lengths around the vector widths and a misaligned start are the interesting
+   cases for the SIMD kernels, so check all lengths up to a few vectors, both
+   copying and in place, against the scalar swap */
+#define N_ELEMS 75
+
+CU_Test(ddsrt_bswap, array2u)
+{
+  uint16_t src[N_ELEMS + 1], dst[N_ELEMS + 1], inp[N_ELEMS + 1];
+  for (size_t i = 0; i <= N_ELEMS; i++)
+    src[i] = (uint16_t) (0x0102 * (i + 1));
+  for (size_t start = 0; start <= 1; start++)
+  {
+    for (size_t n = 0; n <= N_ELEMS - start; n++)
+    {
+      memset (dst, 0, sizeof (dst));
+      memcpy (inp, src, sizeof (inp));
+      ddsrt_bswap2u_array (dst + start, src + start, n);
+      ddsrt_bswap2u_array (inp + start, inp + start, n);
+      for (size_t i = 0; i <= N_ELEMS; i++)
+      {
+        const bool swapped = (i >= start && i < start + n);
+        CU_ASSERT_EQUAL_FATAL (dst[i], swapped ? ddsrt_bswap2u (src[i]) : 0);
+        CU_ASSERT_EQUAL_FATAL (inp[i], swapped ? ddsrt_bswap2u (src[i]) : src[i]);
+      }
+    }
+  }
+}
+
+CU_Test(ddsrt_bswap, array4u)
+{
+  uint32_t src[N_ELEMS + 1], dst[N_ELEMS + 1], inp[N_ELEMS + 1];
+  for (size_t i = 0; i <= N_ELEMS; i++)
+    src[i] = (uint32_t) (0x01020304 * (i + 1));
+  for (size_t start = 0; start <= 1; start++)
+  {
+    for (size_t n = 0; n <= N_ELEMS - start; n++)
+    {
+      memset (dst, 0, sizeof (dst));
+      memcpy (inp, src, sizeof (inp));
+      ddsrt_bswap4u_array (dst + start, src + start, n);
+      ddsrt_bswap4u_array (inp + start, inp + start, n);
+      for (size_t i = 0; i <= N_ELEMS; i++)
+      {
+        const bool swapped = (i >= start && i < start + n);
+        CU_ASSERT_EQUAL_FATAL (dst[i], swapped ? ddsrt_bswap4u (src[i]) : 0);
+        CU_ASSERT_EQUAL_FATAL (inp[i], swapped ? ddsrt_bswap4u (src[i]) : src[i]);
+      }
+    }
+  }
+}
+
+CU_Test(ddsrt_bswap, array8u)
+{
+  uint64_t src[N_ELEMS + 1], dst[N_ELEMS + 1], inp[N_ELEMS + 1];
+  for (size_t i = 0; i <= N_ELEMS; i++)
+    src[i] = UINT64_C (0x0102030405060708) * (i + 1);
+  for (size_t start = 0; start <= 1; start++)
+  {
+    for (size_t n = 0; n <= N_ELEMS - start; n++)
+    {
+      memset (dst, 0, sizeof (dst));
+      memcpy (inp, src, sizeof (inp));
+      ddsrt_bswap8u_array (dst + start, src + start, n);
+      ddsrt_bswap8u_array (inp + start, inp + start, n);
+      for (size_t i = 0; i <= N_ELEMS; i++)
+      {
+        const bool swapped = (i >= start && i < start + n);
+        CU_ASSERT_EQUAL_FATAL (dst[i], swapped ? ddsrt_bswap8u (src[i]) : 0);
+        CU_ASSERT_EQUAL_FATAL (inp[i], swapped ? ddsrt_bswap8u (src[i]) : src[i]);
+      }
+    }
+  }
+}
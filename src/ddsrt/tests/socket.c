@@ -20,6 +20,9 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#if DDSRT_HAVE_REUSEPORT_CBPF
+#include <linux/filter.h>
+#endif
 
 DDSRT_WARNING_MSVC_OFF(4305)
 #if DDSRT_ENDIAN == DDSRT_BIG_ENDIAN
@@ -224,3 +227,577 @@ CU_Theory((char *name, int af, dds_return_t exp), ddsrt_gethostbyname, ipv6, .in
   CU_PASS("DNS and IPv6 are not supported");
 #endif /* DDSRT_HAVE_IPV6 */
 }
+
+#if DDSRT_HAVE_RECVMMSG || DDSRT_HAVE_SENDMMSG
+static ddsrt_socket_t udp_loopback_socket(struct sockaddr_in *addr)
+{
+  dds_return_t rc;
+  ddsrt_socket_t sock;
+  socklen_t addrlen = sizeof(*addr);
+  rc = ddsrt_socket(&sock, AF_INET, SOCK_DGRAM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  memcpy(addr, &ipv4_loopback, sizeof(*addr));
+  rc = ddsrt_bind(sock, (struct sockaddr *)addr, sizeof(*addr));
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_getsockname(sock, (struct sockaddr *)addr, &addrlen);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_setsocknonblocking(sock, true);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  return sock;
+}
+
+static void send_datagram(ddsrt_socket_t sock, const struct sockaddr_in *dst, const void *buf, size_t len)
+{
+  dds_return_t rc;
+  ddsrt_msghdr_t msg;
+  ddsrt_iovec_t iov;
+  ssize_t sent = 0;
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = (void *)buf;
+  iov.iov_len = (ddsrt_iov_len_t)len;
+  msg.msg_name = (void *)dst;
+  msg.msg_namelen = sizeof(*dst);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  rc = ddsrt_sendmsg(sock, &msg, 0, &sent);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(sent, (ssize_t)len);
+}
+
+static void wait_readable(ddsrt_socket_t sock)
+{
+  fd_set rdset;
+  int32_t ready = 0;
+  FD_ZERO(&rdset);
+  FD_SET(sock, &rdset);
+  (void)ddsrt_select(sock + 1, &rdset, NULL, NULL, DDS_SECS(5), &ready);
+  CU_ASSERT_EQUAL_FATAL(ready, 1);
+}
+
+#define MMSG_BATCH 8
+#define MMSG_BUFSZ 2048
+
+struct mmsg_bufs {
+  ddsrt_mmsghdr_t msgs[MMSG_BATCH];
+  ddsrt_iovec_t iovs[MMSG_BATCH];
+  struct sockaddr_in srcs[MMSG_BATCH];
+  unsigned char data[MMSG_BATCH][MMSG_BUFSZ];
+};
+
+static void init_recv_mmsg_bufs(struct mmsg_bufs *b, size_t bufsz)
+{
+  memset(b, 0, sizeof(*b));
+  for (uint32_t i = 0; i < MMSG_BATCH; i++) {
+    b->iovs[i].iov_base = b->data[i];
+    b->iovs[i].iov_len = (ddsrt_iov_len_t)bufsz;
+    b->msgs[i].msg_hdr.msg_name = &b->srcs[i];
+    b->msgs[i].msg_hdr.msg_namelen = sizeof(b->srcs[i]);
+    b->msgs[i].msg_hdr.msg_iov = &b->iovs[i];
+    b->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+/* Datagram i has size 100 * (i + 1) and every byte set to i */
+static void send_numbered_datagrams(ddsrt_socket_t sock, const struct sockaddr_in *dst, uint32_t n)
+{
+  unsigned char buf[MMSG_BUFSZ];
+  for (uint32_t i = 0; i < n; i++) {
+    memset(buf, (int)i, sizeof(buf));
+    send_datagram(sock, dst, buf, 100 * (i + 1));
+  }
+}
+
+static void check_numbered_datagram(const struct mmsg_bufs *b, uint32_t idx, uint32_t i, const struct sockaddr_in *src)
+{
+  CU_ASSERT_EQUAL(b->msgs[idx].msg_len, 100 * (i + 1));
+  CU_ASSERT(b->data[idx][0] == (unsigned char)i && b->data[idx][b->msgs[idx].msg_len - 1] == (unsigned char)i);
+  CU_ASSERT_EQUAL(b->srcs[idx].sin_port, src->sin_port);
+}
+#endif /* DDSRT_HAVE_RECVMMSG || DDSRT_HAVE_SENDMMSG */
+
+#if DDSRT_HAVE_RECVMMSG
+
+CU_Test(ddsrt_recvmmsg, batch, .init=setup, .fini=teardown)
+{
+  dds_return_t rc;
+  struct sockaddr_in txaddr, rxaddr;
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx = udp_loopback_socket(&rxaddr);
+  struct mmsg_bufs *b = ddsrt_malloc(sizeof(*b));
+  uint32_t nrcvd = 0;
+
+  send_numbered_datagrams(tx, &rxaddr, 5);
+  wait_readable(rx);
+  init_recv_mmsg_bufs(b, MMSG_BUFSZ);
+  rc = ddsrt_recvmmsg(rx, b->msgs, MMSG_BATCH, 0, &nrcvd);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  /* loopback delivers synchronously, so all of them are queued already */
+  CU_ASSERT_EQUAL_FATAL(nrcvd, 5);
+  for (uint32_t i = 0; i < nrcvd; i++)
+    check_numbered_datagram(b, i, i, &txaddr);
+
+  /* nothing left, and the socket is non-blocking */
+  rc = ddsrt_recvmmsg(rx, b->msgs, MMSG_BATCH, 0, &nrcvd);
+  CU_ASSERT_EQUAL(rc, DDS_RETCODE_TRY_AGAIN);
+
+  ddsrt_free(b);
+  ddsrt_close(rx);
+  ddsrt_close(tx);
+}
+
+CU_Test(ddsrt_recvmmsg, more_than_vlen, .init=setup, .fini=teardown)
+{
+  dds_return_t rc;
+  struct sockaddr_in txaddr, rxaddr;
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx = udp_loopback_socket(&rxaddr);
+  struct mmsg_bufs *b = ddsrt_malloc(sizeof(*b));
+  uint32_t nrcvd = 0;
+
+  /* messages beyond vlen stay queued for the next call, in order */
+  send_numbered_datagrams(tx, &rxaddr, 6);
+  wait_readable(rx);
+  init_recv_mmsg_bufs(b, MMSG_BUFSZ);
+  rc = ddsrt_recvmmsg(rx, b->msgs, 4, 0, &nrcvd);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nrcvd, 4);
+  for (uint32_t i = 0; i < nrcvd; i++)
+    check_numbered_datagram(b, i, i, &txaddr);
+  init_recv_mmsg_bufs(b, MMSG_BUFSZ);
+  rc = ddsrt_recvmmsg(rx, b->msgs, 4, 0, &nrcvd);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nrcvd, 2);
+  for (uint32_t i = 0; i < nrcvd; i++)
+    check_numbered_datagram(b, i, 4 + i, &txaddr);
+
+  ddsrt_free(b);
+  ddsrt_close(rx);
+  ddsrt_close(tx);
+}
+
+CU_Test(ddsrt_recvmmsg, truncated, .init=setup, .fini=teardown)
+{
+  dds_return_t rc;
+  struct sockaddr_in txaddr, rxaddr;
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx = udp_loopback_socket(&rxaddr);
+  struct mmsg_bufs *b = ddsrt_malloc(sizeof(*b));
+  uint32_t nrcvd = 0;
+
+  /* a datagram that doesn't fit is truncated to the buffer size and flagged
+     as such, without affecting the others */
+  send_numbered_datagrams(tx, &rxaddr, 3);
+  wait_readable(rx);
+  init_recv_mmsg_bufs(b, 250);
+  rc = ddsrt_recvmmsg(rx, b->msgs, MMSG_BATCH, 0, &nrcvd);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nrcvd, 3);
+  CU_ASSERT_EQUAL(b->msgs[0].msg_len, 100);
+  CU_ASSERT_EQUAL(b->msgs[1].msg_len, 200);
+  CU_ASSERT_EQUAL(b->msgs[2].msg_len, 250);
+#if DDSRT_MSGHDR_FLAGS
+  CU_ASSERT((b->msgs[0].msg_hdr.msg_flags & MSG_TRUNC) == 0);
+  CU_ASSERT((b->msgs[2].msg_hdr.msg_flags & MSG_TRUNC) != 0);
+#endif
+
+  ddsrt_free(b);
+  ddsrt_close(rx);
+  ddsrt_close(tx);
+}
+#endif /* DDSRT_HAVE_RECVMMSG */
+
+#if DDSRT_HAVE_SENDMMSG
+/* Message i goes to dsts[i % ndsts] and is numbered like those of
+   send_numbered_datagrams */
+static void init_send_mmsg_bufs(struct mmsg_bufs *b, uint32_t n, const struct sockaddr_in *dsts, uint32_t ndsts)
+{
+  memset(b, 0, sizeof(*b));
+  for (uint32_t i = 0; i < n; i++) {
+    memset(b->data[i], (int)i, MMSG_BUFSZ);
+    b->srcs[i] = dsts[i % ndsts];
+    b->iovs[i].iov_base = b->data[i];
+    b->iovs[i].iov_len = (ddsrt_iov_len_t)(100 * (i + 1));
+    b->msgs[i].msg_hdr.msg_name = &b->srcs[i];
+    b->msgs[i].msg_hdr.msg_namelen = sizeof(b->srcs[i]);
+    b->msgs[i].msg_hdr.msg_iov = &b->iovs[i];
+    b->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+/* Receives exactly n datagrams, checking they are numbered first, first+step, ... */
+static void recv_numbered_datagrams(ddsrt_socket_t sock, uint32_t n, uint32_t first, uint32_t step)
+{
+  unsigned char buf[MMSG_BUFSZ];
+  for (uint32_t k = 0; k < n; k++) {
+    const uint32_t i = first + k * step;
+    ssize_t rcvd = 0;
+    wait_readable(sock);
+    dds_return_t rc = ddsrt_recv(sock, buf, sizeof(buf), 0, &rcvd);
+    CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(rcvd, (ssize_t)(100 * (i + 1)));
+    CU_ASSERT(buf[0] == (unsigned char)i && buf[rcvd - 1] == (unsigned char)i);
+  }
+  ssize_t rcvd = 0;
+  CU_ASSERT_EQUAL(ddsrt_recv(sock, buf, sizeof(buf), 0, &rcvd), DDS_RETCODE_TRY_AGAIN);
+}
+
+CU_Test(ddsrt_sendmmsg, batch, .init=setup, .fini=teardown)
+{
+  dds_return_t rc;
+  struct sockaddr_in txaddr, rxaddrs[2];
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx[2] = { udp_loopback_socket(&rxaddrs[0]), udp_loopback_socket(&rxaddrs[1]) };
+  struct mmsg_bufs *b = ddsrt_malloc(sizeof(*b));
+  uint32_t nsent = 0;
+
+  /* one call sending to two destinations, alternating */
+  init_send_mmsg_bufs(b, 6, rxaddrs, 2);
+  rc = ddsrt_sendmmsg(tx, b->msgs, 6, 0, &nsent);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nsent, 6);
+  for (uint32_t i = 0; i < nsent; i++)
+    CU_ASSERT_EQUAL(b->msgs[i].msg_len, 100 * (i + 1));
+  recv_numbered_datagrams(rx[0], 3, 0, 2);
+  recv_numbered_datagrams(rx[1], 3, 1, 2);
+
+#if DDSRT_HAVE_RECVMMSG
+  /* and the same batch received in one call */
+  init_send_mmsg_bufs(b, 6, rxaddrs, 1);
+  rc = ddsrt_sendmmsg(tx, b->msgs, 6, 0, &nsent);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nsent, 6);
+  wait_readable(rx[0]);
+  init_recv_mmsg_bufs(b, MMSG_BUFSZ);
+  rc = ddsrt_recvmmsg(rx[0], b->msgs, MMSG_BATCH, 0, &nsent);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nsent, 6);
+  for (uint32_t i = 0; i < nsent; i++)
+    check_numbered_datagram(b, i, i, &txaddr);
+#endif
+
+  ddsrt_free(b);
+  ddsrt_close(rx[1]);
+  ddsrt_close(rx[0]);
+  ddsrt_close(tx);
+}
+
+CU_Test(ddsrt_sendmmsg, partial, .init=setup, .fini=teardown)
+{
+  dds_return_t rc;
+  struct sockaddr_in txaddr, rxaddr;
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx = udp_loopback_socket(&rxaddr);
+  struct mmsg_bufs *b = ddsrt_malloc(sizeof(*b));
+  unsigned char *big = ddsrt_malloc(70000);
+  ddsrt_iovec_t bigiov = { .iov_base = big, .iov_len = 70000 };
+  uint32_t nsent = 0;
+  memset(big, 0, 70000);
+
+  /* message 2 can't be sent (too large for UDP): sending stops there, with
+     the number of messages sent before it as result */
+  init_send_mmsg_bufs(b, 5, &rxaddr, 1);
+  b->msgs[2].msg_hdr.msg_iov = &bigiov;
+  rc = ddsrt_sendmmsg(tx, b->msgs, 5, 0, &nsent);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nsent, 2);
+  recv_numbered_datagrams(rx, 2, 0, 1);
+
+  /* retrying from the failing one returns the error for that message, which
+     is what ddsi_udp_conn_write_multiple uses to skip a destination */
+  rc = ddsrt_sendmmsg(tx, b->msgs + 2, 3, 0, &nsent);
+  CU_ASSERT_EQUAL(rc, DDS_RETCODE_NOT_ENOUGH_SPACE);
+
+  /* after which the remainder goes out as usual */
+  rc = ddsrt_sendmmsg(tx, b->msgs + 3, 2, 0, &nsent);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nsent, 2);
+  recv_numbered_datagrams(rx, 2, 3, 1);
+
+  ddsrt_free(big);
+  ddsrt_free(b);
+  ddsrt_close(rx);
+  ddsrt_close(tx);
+}
+#endif /* DDSRT_HAVE_SENDMMSG */
+
+#if DDSRT_HAVE_UDP_SEGMENT && DDSRT_HAVE_RECVMMSG
+/* Sends len bytes as one datagram for the kernel to split into datagrams of
+   segsize bytes (the last one may be shorter) */
+static dds_return_t send_segmented(ddsrt_socket_t sock, const struct sockaddr_in *dst, const void *buf, size_t len, uint16_t segsize)
+{
+  union { struct cmsghdr align; char buf[CMSG_SPACE(sizeof(uint16_t))]; } ctrl;
+  struct cmsghdr *cmsg;
+  ddsrt_msghdr_t msg;
+  ddsrt_iovec_t iov;
+  ssize_t sent = 0;
+  dds_return_t rc;
+  memset(&msg, 0, sizeof(msg));
+  memset(&ctrl, 0, sizeof(ctrl));
+  iov.iov_base = (void *)buf;
+  iov.iov_len = (ddsrt_iov_len_t)len;
+  msg.msg_name = (void *)dst;
+  msg.msg_namelen = sizeof(*dst);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof(ctrl.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(segsize));
+  memcpy(CMSG_DATA(cmsg), &segsize, sizeof(segsize));
+  if ((rc = ddsrt_sendmsg(sock, &msg, 0, &sent)) == DDS_RETCODE_OK)
+    CU_ASSERT_EQUAL(sent, (ssize_t)len);
+  return rc;
+}
+
+static bool supports_udp_segment(ddsrt_socket_t sock)
+{
+  int segsize = 0;
+  socklen_t optlen = sizeof(segsize);
+  return ddsrt_getsockopt(sock, SOL_UDP, UDP_SEGMENT, &segsize, &optlen) == DDS_RETCODE_OK;
+}
+
+/* Segment i of the n segments of segsize bytes has every byte set to i */
+static void init_segments(unsigned char *buf, size_t len, size_t segsize)
+{
+  for (size_t off = 0; off < len; off += segsize)
+    memset(buf + off, (int)(off / segsize), (len - off < segsize) ? len - off : segsize);
+}
+
+CU_Test(ddsrt_udp_segment, send, .init=setup, .fini=teardown)
+{
+  dds_return_t rc;
+  struct sockaddr_in txaddr, rxaddr;
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx = udp_loopback_socket(&rxaddr);
+  struct mmsg_bufs *b = ddsrt_malloc(sizeof(*b));
+  unsigned char *buf = ddsrt_malloc(4000);
+  uint32_t nrcvd = 0;
+
+  if (!supports_udp_segment(tx)) {
+    CU_PASS("UDP segmentation offload not supported");
+    goto out;
+  }
+
+  /* one send resulting in four datagrams, the last one shorter than the others,
+     which is what ddsi_udp_conn_write_segmented relies on */
+  init_segments(buf, 3500, 1000);
+  rc = send_segmented(tx, &rxaddr, buf, 3500, 1000);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  wait_readable(rx);
+  init_recv_mmsg_bufs(b, MMSG_BUFSZ);
+  rc = ddsrt_recvmmsg(rx, b->msgs, MMSG_BATCH, 0, &nrcvd);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nrcvd, 4);
+  for (uint32_t i = 0; i < nrcvd; i++) {
+    const uint32_t len = (i < 3) ? 1000 : 500;
+    CU_ASSERT_EQUAL(b->msgs[i].msg_len, len);
+    CU_ASSERT(b->data[i][0] == (unsigned char)i && b->data[i][len - 1] == (unsigned char)i);
+    CU_ASSERT_EQUAL(b->srcs[i].sin_port, txaddr.sin_port);
+  }
+
+  /* a single segment is just a datagram */
+  rc = send_segmented(tx, &rxaddr, buf, 700, 1000);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  wait_readable(rx);
+  init_recv_mmsg_bufs(b, MMSG_BUFSZ);
+  rc = ddsrt_recvmmsg(rx, b->msgs, MMSG_BATCH, 0, &nrcvd);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  CU_ASSERT_EQUAL_FATAL(nrcvd, 1);
+  CU_ASSERT_EQUAL(b->msgs[0].msg_len, 700);
+
+  /* too many segments fails as a whole without sending anything, which is
+     when ddsi_udp_conn_write_segmented falls back to sending them one by one */
+  rc = send_segmented(tx, &rxaddr, buf, 4000, 10);
+  CU_ASSERT_NOT_EQUAL(rc, DDS_RETCODE_OK);
+  init_recv_mmsg_bufs(b, MMSG_BUFSZ);
+  rc = ddsrt_recvmmsg(rx, b->msgs, MMSG_BATCH, 0, &nrcvd);
+  CU_ASSERT_EQUAL(rc, DDS_RETCODE_TRY_AGAIN);
+
+out:
+  ddsrt_free(buf);
+  ddsrt_free(b);
+  ddsrt_close(rx);
+  ddsrt_close(tx);
+}
+
+#if DDSRT_HAVE_UDP_GRO
+/* Receives a datagram into buf, setting *segsize to the segment size if it was
+   coalesced from several and to 0 if not */
+static size_t recv_coalesced(ddsrt_socket_t sock, void *buf, size_t bufsz, size_t *segsize)
+{
+  union { struct cmsghdr align; char buf[CMSG_SPACE(sizeof(int))]; } ctrl;
+  struct cmsghdr *cmsg;
+  ddsrt_msghdr_t msg;
+  ddsrt_iovec_t iov;
+  ssize_t rcvd = 0;
+  dds_return_t rc;
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = buf;
+  iov.iov_len = (ddsrt_iov_len_t)bufsz;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof(ctrl.buf);
+  wait_readable(sock);
+  rc = ddsrt_recvmsg(sock, &msg, 0, &rcvd);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  *segsize = 0;
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+      int gso_size;
+      memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+      *segsize = (size_t)gso_size;
+    }
+  }
+  return (size_t)rcvd;
+}
+
+CU_Test(ddsrt_udp_gro, receive, .init=setup, .fini=teardown)
+{
+  dds_return_t rc;
+  struct sockaddr_in txaddr, rxaddr;
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx = udp_loopback_socket(&rxaddr);
+  unsigned char *buf = ddsrt_malloc(4000), *rbuf = ddsrt_malloc(65536);
+  size_t sz, segsize;
+  int one = 1;
+
+  if (!supports_udp_segment(tx) || ddsrt_setsockopt(rx, SOL_UDP, UDP_GRO, &one, sizeof(one)) != DDS_RETCODE_OK) {
+    CU_PASS("UDP segmentation offload or receive coalescing not supported");
+    goto out;
+  }
+
+  /* a train of segments arrives as one buffer, with the segment size in the
+     control data; this is what handle_coalesced_rtps_messages splits again */
+  init_segments(buf, 3500, 1000);
+  rc = send_segmented(tx, &rxaddr, buf, 3500, 1000);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  sz = recv_coalesced(rx, rbuf, 65536, &segsize);
+  CU_ASSERT_EQUAL_FATAL(sz, 3500);
+  CU_ASSERT_EQUAL(segsize, 1000);
+  CU_ASSERT(memcmp(rbuf, buf, 3500) == 0);
+
+  /* separately sent datagrams are received separately, without segment size */
+  send_datagram(tx, &rxaddr, buf, 1000);
+  send_datagram(tx, &rxaddr, buf + 1000, 1000);
+  for (uint32_t i = 0; i < 2; i++) {
+    sz = recv_coalesced(rx, rbuf, 65536, &segsize);
+    CU_ASSERT_EQUAL_FATAL(sz, 1000);
+    CU_ASSERT_EQUAL(segsize, 0);
+    CU_ASSERT(rbuf[0] == (unsigned char)i && rbuf[999] == (unsigned char)i);
+  }
+
+  /* the buffer must be large enough for the entire train, else it is truncated */
+  rc = send_segmented(tx, &rxaddr, buf, 3500, 1000);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  sz = recv_coalesced(rx, rbuf, 2000, &segsize);
+  CU_ASSERT_EQUAL(sz, 2000);
+
+out:
+  ddsrt_free(rbuf);
+  ddsrt_free(buf);
+  ddsrt_close(rx);
+  ddsrt_close(tx);
+}
+#endif /* DDSRT_HAVE_UDP_GRO */
+#endif /* DDSRT_HAVE_UDP_SEGMENT && DDSRT_HAVE_RECVMMSG */
+
+#if DDSRT_HAVE_REUSEPORT_CBPF && DDSRT_HAVE_RECVMMSG
+#define NSHARDS 3
+
+/* Binds a socket to the port in addr (0 for any) with SO_REUSEPORT set,
+   updating addr with the actual address */
+static ddsrt_socket_t reuseport_socket(struct sockaddr_in *addr)
+{
+  dds_return_t rc;
+  ddsrt_socket_t sock;
+  socklen_t addrlen = sizeof(*addr);
+  int one = 1;
+  rc = ddsrt_socket(&sock, AF_INET, SOCK_DGRAM, 0);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_bind(sock, (struct sockaddr *)addr, sizeof(*addr));
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_getsockname(sock, (struct sockaddr *)addr, &addrlen);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  rc = ddsrt_setsocknonblocking(sock, true);
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+  return sock;
+}
+
+/* Returns the index of the one socket that received a datagram, checking that
+   it starts with the expected byte */
+static uint32_t receiving_shard(ddsrt_socket_t *rx, unsigned char exp)
+{
+  uint32_t shard = NSHARDS;
+  fd_set rdset;
+  int32_t ready = 0;
+  ddsrt_socket_t maxsock = 0;
+  FD_ZERO(&rdset);
+  for (uint32_t i = 0; i < NSHARDS; i++) {
+    FD_SET(rx[i], &rdset);
+    if (rx[i] > maxsock)
+      maxsock = rx[i];
+  }
+  (void)ddsrt_select(maxsock + 1, &rdset, NULL, NULL, DDS_SECS(5), &ready);
+  CU_ASSERT_EQUAL_FATAL(ready, 1);
+  for (uint32_t i = 0; i < NSHARDS; i++) {
+    unsigned char buf[16];
+    ssize_t rcvd;
+    if (ddsrt_recv(rx[i], buf, sizeof(buf), 0, &rcvd) == DDS_RETCODE_OK) {
+      CU_ASSERT_EQUAL(shard, NSHARDS);
+      CU_ASSERT(rcvd > 0 && buf[0] == exp);
+      shard = i;
+    }
+  }
+  return shard;
+}
+
+CU_Test(ddsrt_reuseport_cbpf, steering, .init=setup, .fini=teardown)
+{
+  /* returns the first byte of the payload, which is how ddsi selects the shard
+     for the one-byte messages that trigger the receive threads */
+  struct sock_filter code[] = {
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+    BPF_STMT(BPF_RET | BPF_A, 0)
+  };
+  struct sock_fprog prog = { .len = (unsigned short)(sizeof(code) / sizeof(code[0])), .filter = code };
+  struct sockaddr_in txaddr, rxaddr;
+  ddsrt_socket_t tx = udp_loopback_socket(&txaddr);
+  ddsrt_socket_t rx[NSHARDS];
+  dds_return_t rc;
+  uint32_t counts[NSHARDS] = { 0 };
+
+  /* sockets in the group are indexed in the order of binding */
+  memcpy(&rxaddr, &ipv4_loopback, sizeof(rxaddr));
+  for (uint32_t i = 0; i < NSHARDS; i++)
+    rx[i] = reuseport_socket(&rxaddr);
+  rc = ddsrt_setsockopt(rx[NSHARDS - 1], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+  CU_ASSERT_EQUAL_FATAL(rc, DDS_RETCODE_OK);
+
+  for (uint32_t i = 0; i < 2 * NSHARDS; i++) {
+    const unsigned char b = (unsigned char)(i % NSHARDS);
+    send_datagram(tx, &rxaddr, &b, 1);
+    CU_ASSERT_EQUAL(receiving_shard(rx, b), b);
+  }
+
+  /* an index out of range leaves the choice to the kernel, which is what ddsi
+     does for RTPS messages when not steering them by GUID prefix */
+  for (uint32_t i = 0; i < 20; i++) {
+    const unsigned char b = 0xff;
+    send_datagram(tx, &rxaddr, &b, 1);
+    const uint32_t shard = receiving_shard(rx, b);
+    CU_ASSERT_FATAL(shard < NSHARDS);
+    counts[shard]++;
+  }
+  CU_ASSERT_EQUAL(counts[0] + counts[1] + counts[2], 20);
+
+  for (uint32_t i = 0; i < NSHARDS; i++)
+    ddsrt_close(rx[i]);
+  ddsrt_close(tx);
+}
+#undef NSHARDS
+#endif /* DDSRT_HAVE_REUSEPORT_CBPF && DDSRT_HAVE_RECVMMSG */
@@ -47,6 +47,8 @@ void gendef_pf_participantIndex (FILE *fp, void *parent, struct cfgelem const *
 void gendef_pf_boolean (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
 void gendef_pf_boolean_default (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
 void gendef_pf_besmode (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
+void gendef_pf_whc_budget_policy (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
+void gendef_pf_durable_sync (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
 void gendef_pf_retransmit_merging (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
 void gendef_pf_sched_class (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
 void gendef_pf_transport_selector (FILE *fp, void *parent, struct cfgelem const * const cfgelem);
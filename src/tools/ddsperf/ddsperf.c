@@ -100,6 +100,11 @@ static bool substat_every_second = false;
 /* Whether to show extended statistics (currently just rexmit info) */
 static bool extended_stats = false;
 
+/* Whether to split the ping/pong roundtrip time into the time until the pong
+   was received by the kernel, the time until the reader was triggered and the
+   time it took to take it from the reader history cache */
+static bool latency_split = false;
+
 /* Size of the sequence in KeyedSeq type in bytes */
 static uint32_t baggagesize = 0;
 
@@ -234,6 +239,15 @@ struct subthread_arg_pongstat {
   uint32_t cnt;
   uint64_t totcnt;
   uint64_t *raw;
+  uint64_t sum_wire, sum_dqueue, sum_rhc;
+  uint32_t cnt_split;
+};
+
+/* Components of a roundtrip for latency splitting */
+struct latency_split {
+  uint64_t wire;   /* ping write -> pong reception */
+  uint64_t dqueue; /* pong reception -> reader triggered */
+  uint64_t rhc;    /* reader triggered -> take returned */
 };
 
 /* Pong statistics is stored in n array of npongstat entries
@@ -744,7 +758,17 @@ static dds_instance_handle_t get_pphandle_for_pubhandle (dds_instance_handle_t p
   }
 }
 
-static bool update_roundtrip (dds_instance_handle_t pubhandle, uint64_t tdelta, bool isping, uint32_t seq)
+static void update_latency_split (struct subthread_arg_pongstat *x, const struct latency_split *split)
+{
+  if (split == NULL)
+    return;
+  x->sum_wire += split->wire;
+  x->sum_dqueue += split->dqueue;
+  x->sum_rhc += split->rhc;
+  x->cnt_split++;
+}
+
+static bool update_roundtrip (dds_instance_handle_t pubhandle, uint64_t tdelta, const struct latency_split *split, bool isping, uint32_t seq)
 {
   bool allseen;
   ddsrt_mutex_lock (&pongstat_lock);
@@ -769,6 +793,7 @@ static bool update_roundtrip (dds_instance_handle_t pubhandle, uint64_t tdelta,
         x->raw[x->cnt] = tdelta;
       x->cnt++;
       x->totcnt++;
+      update_latency_split (x, split);
       ddsrt_mutex_unlock (&pongstat_lock);
       return allseen;
     }
@@ -781,6 +806,9 @@ static bool update_roundtrip (dds_instance_handle_t pubhandle, uint64_t tdelta,
   x->totcnt = 1;
   x->raw = malloc (PINGPONG_RAWSIZE * sizeof (*x->raw));
   x->raw[0] = tdelta;
+  x->sum_wire = x->sum_dqueue = x->sum_rhc = 0;
+  x->cnt_split = 0;
+  update_latency_split (x, split);
   npongstat++;
   ddsrt_mutex_unlock (&pongstat_lock);
   return allseen;
@@ -925,6 +953,7 @@ static bool process_pong (dds_entity_t rd, struct subthread_arg *arg)
   dds_sample_info_t *iseq = arg->iseq;
   void **mseq = arg->mseq;
   int32_t nread_pong;
+  const dds_time_t ttrigger = latency_split ? dds_time () : 0;
   if ((nread_pong = dds_take (rd, mseq, iseq, max_samples, max_samples)) < 0)
     error2 ("dds_take (rd_pong): %d\n", (int) nread_pong);
   else if (nread_pong > 0)
@@ -935,7 +964,18 @@ static bool process_pong (dds_entity_t rd, struct subthread_arg *arg)
       {
         uint32_t * const seq = mseq[i];
         const bool isping = (iseq[i].source_timestamp & 1) != 0;
-        const bool all = update_roundtrip (iseq[i].publication_handle, (uint64_t) (tnow - iseq[i].source_timestamp) / 2, isping, *seq);
+        struct latency_split split;
+        /* Reception timestamp is 0 if not available, and if it comes from the kernel
+           it is obtained independently of the other timestamps, so guard against
+           them being out of order */
+        const bool have_split = latency_split && iseq[i].reception_timestamp >= iseq[i].source_timestamp && iseq[i].reception_timestamp <= ttrigger;
+        if (have_split)
+        {
+          split.wire = (uint64_t) (iseq[i].reception_timestamp - iseq[i].source_timestamp);
+          split.dqueue = (uint64_t) (ttrigger - iseq[i].reception_timestamp);
+          split.rhc = (uint64_t) (tnow - ttrigger);
+        }
+        const bool all = update_roundtrip (iseq[i].publication_handle, (uint64_t) (tnow - iseq[i].source_timestamp) / 2, have_split ? &split : NULL, isping, *seq);
         if (isping && all && ping_intv == 0)
         {
           /* If it is a pong sent in response to a ping, and all known nodes have responded, send out a new ping */
@@ -1388,6 +1428,9 @@ struct dds_stats {
   const struct dds_stat_keyvalue *throttle_count;
   struct dds_statistics *substat;
   const struct dds_stat_keyvalue *discarded_bytes;
+  struct dds_statistics *domstat;
+  const struct dds_stat_keyvalue *serdata_pool_hits;
+  const struct dds_stat_keyvalue *serdata_pool_misses;
 };
 
 static bool print_stats (dds_time_t tref, dds_time_t tnow, dds_time_t tprev, struct record_cputime_state *cputime_state, struct record_netload_state *netload_state, struct dds_stats *stats)
@@ -1454,6 +1497,8 @@ static bool print_stats (dds_time_t tref, dds_time_t tnow, dds_time_t tprev, str
     x->raw = newraw;
     x->min = UINT64_MAX;
     x->max = x->sum = x->cnt = 0;
+    x->sum_wire = x->sum_dqueue = x->sum_rhc = 0;
+    x->cnt_split = 0;
     /* pongstat entries get added at the end, npongstat only grows: so can safely
        unlock the stats in between nodes for calculating percentiles */
     ddsrt_mutex_unlock (&pongstat_lock);
@@ -1480,6 +1525,15 @@ static bool print_stats (dds_time_t tref, dds_time_t tnow, dds_time_t tprev, str
               (double) y.raw[rawcnt - (rawcnt + 99) / 100] / 1e3,
               (double) y.max / 1e3,
               y.cnt);
+      if (latency_split && y.cnt_split > 0)
+      {
+        printf ("%s %s split roundtrip mean wire %.3fus dqueue %.3fus rhc %.3fus cnt %"PRIu32"\n",
+                prefix, ppinfo,
+                (double) y.sum_wire / (double) y.cnt_split / 1e3,
+                (double) y.sum_dqueue / (double) y.cnt_split / 1e3,
+                (double) y.sum_rhc / (double) y.cnt_split / 1e3,
+                y.cnt_split);
+      }
       output = true;
     }
     newraw = y.raw;
@@ -1529,7 +1583,8 @@ static bool print_stats (dds_time_t tref, dds_time_t tnow, dds_time_t tprev, str
   {
     (void) dds_refresh_statistics (stats->substat);
     (void) dds_refresh_statistics (stats->pubstat);
-    printf ("%s discarded %"PRIu64" rexmit %"PRIu64" Trexmit %"PRIu64" Tthrottle %"PRIu64" Nthrottle %"PRIu32"\n", prefix, stats->discarded_bytes->u.u64, stats->rexmit_bytes->u.u64, stats->time_rexmit->u.u64, stats->time_throttle->u.u64, stats->throttle_count->u.u32);
+    (void) dds_refresh_statistics (stats->domstat);
+    printf ("%s discarded %"PRIu64" rexmit %"PRIu64" Trexmit %"PRIu64" Tthrottle %"PRIu64" Nthrottle %"PRIu32" serpool hit %"PRIu64" miss %"PRIu64"\n", prefix, stats->discarded_bytes->u.u64, stats->rexmit_bytes->u.u64, stats->time_rexmit->u.u64, stats->time_throttle->u.u64, stats->throttle_count->u.u32, stats->serdata_pool_hits->u.u64, stats->serdata_pool_misses->u.u64);
   }
 
   fflush (stdout);
@@ -1643,6 +1698,13 @@ OPTIONS:\n\
   -1                  print \"sub\" stats every second, even when there is\n\
                       data\n\
   -X                  output extended statistics\n\
+  -l                  split the mean ping/pong roundtrip time into: \"wire\"\n\
+                      (ping written to pong received, including the time\n\
+                      spent in the peer), \"dqueue\" (pong received to pong\n\
+                      reader triggered) and \"rhc\" (time to take the pong);\n\
+                      enable Internal/KernelReceiveTimestamps to count the\n\
+                      time spent in the socket buffer as \"dqueue\" rather\n\
+                      than \"wire\"\n\
   -i ID               use domain ID instead of the default domain\n\
 \n\
 MODE... is zero or more of:\n\
@@ -1952,7 +2014,7 @@ int main (int argc, char *argv[])
 
   argv0 = argv[0];
 
-  while ((opt = getopt (argc, argv, "1cd:D:i:n:k:uLK:T:Q:R:Xh")) != EOF)
+  while ((opt = getopt (argc, argv, "1cd:D:i:n:k:luLK:T:Q:R:Xh")) != EOF)
   {
     int pos;
     switch (opt)
@@ -2009,6 +2071,7 @@ int main (int argc, char *argv[])
         break;
       }
       case 'X': extended_stats = true; break;
+      case 'l': latency_split = true; break;
       case 'R': {
         tref = 0;
         if (sscanf (optarg, "%"SCNd64"%n", &tref, &pos) != 1 || optarg[pos] != 0)
@@ -2315,6 +2378,9 @@ int main (int argc, char *argv[])
   stats.time_rexmit = dds_lookup_statistic (stats.pubstat, "time_rexmit");
   stats.time_throttle = dds_lookup_statistic (stats.pubstat, "time_throttle");
   stats.throttle_count = dds_lookup_statistic (stats.pubstat, "throttle_count");
+  stats.domstat = dds_create_statistics (dds_get_parent (dp));
+  stats.serdata_pool_hits = dds_lookup_statistic (stats.domstat, "serdata_pool_hits");
+  stats.serdata_pool_misses = dds_lookup_statistic (stats.domstat, "serdata_pool_misses");
   if (stats.discarded_bytes == NULL)
     stats.discarded_bytes = &dummy_u64;
   if (stats.rexmit_bytes == NULL)
@@ -2325,11 +2391,17 @@ int main (int argc, char *argv[])
     stats.time_throttle = &dummy_u64;
   if (stats.throttle_count == NULL)
     stats.throttle_count = &dummy_u32;
+  if (stats.serdata_pool_hits == NULL)
+    stats.serdata_pool_hits = &dummy_u64;
+  if (stats.serdata_pool_misses == NULL)
+    stats.serdata_pool_misses = &dummy_u64;
   if (stats.discarded_bytes->kind != DDS_STAT_KIND_UINT64 ||
       stats.rexmit_bytes->kind != DDS_STAT_KIND_UINT64 ||
       stats.time_rexmit->kind != DDS_STAT_KIND_UINT64 ||
       stats.time_throttle->kind != DDS_STAT_KIND_UINT64 ||
-      stats.throttle_count->kind != DDS_STAT_KIND_UINT32)
+      stats.throttle_count->kind != DDS_STAT_KIND_UINT32 ||
+      stats.serdata_pool_hits->kind != DDS_STAT_KIND_UINT64 ||
+      stats.serdata_pool_misses->kind != DDS_STAT_KIND_UINT64)
   {
     abort ();
   }
@@ -2451,6 +2523,7 @@ int main (int argc, char *argv[])
 
   dds_delete_statistics (stats.pubstat);
   dds_delete_statistics (stats.substat);
+  dds_delete_statistics (stats.domstat);
   record_netload_free (netload_state);
   record_cputime_free (cputime_state);
 